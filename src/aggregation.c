@@ -28,6 +28,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/hll/hll.h"
 #include "utils/lookup/vl_lookup.h"
 #include "utils/metadata/meta_data.h"
 #include "utils_cache.h" /* for uc_get_rate() */
@@ -36,6 +37,16 @@
 #define AGG_MATCHES_ALL(str) (strcmp("/.*/", str) == 0)
 #define AGG_FUNC_PLACEHOLDER "%{aggregation}"
 
+/* Number of partial accumulators per instance. Each thread updates one of
+ * them, so that write threads rarely contend on the same lock. */
+#ifndef AGG_STRIPES
+#define AGG_STRIPES 8
+#endif
+
+/* Precision of the HyperLogLog counter used by "CalculateDistinct". Up to
+ * 2^14/16 = 1024 distinct value lists are counted exactly. */
+#define AGG_DISTINCT_PRECISION 14
+
 struct aggregation_s /* {{{ */
 {
   lookup_identifier_t ident;
@@ -54,17 +65,17 @@ struct aggregation_s /* {{{ */
   bool calc_min;
   bool calc_max;
   bool calc_stddev;
+  bool calc_distinct;
+
+  double *percentile;
+  size_t percentile_num;
 }; /* }}} */
 typedef struct aggregation_s aggregation_t;
 
-struct agg_instance_s;
-typedef struct agg_instance_s agg_instance_t;
-struct agg_instance_s /* {{{ */
+/* Values accumulated by a subset of the threads. Merged when reading. */
+struct agg_partial_s /* {{{ */
 {
   pthread_mutex_t lock;
-  lookup_identifier_t ident;
-
-  int ds_type;
 
   derive_t num;
   gauge_t sum;
@@ -73,12 +84,38 @@ struct agg_instance_s /* {{{ */
   gauge_t min;
   gauge_t max;
 
+  /* All values, only kept if percentiles are calculated. */
+  gauge_t *values;
+  size_t values_num;
+  size_t values_size;
+
+  /* Distinct value lists, only if "CalculateDistinct" is enabled. */
+  hll_t *distinct;
+}; /* }}} */
+typedef struct agg_partial_s agg_partial_t;
+
+struct agg_instance_s;
+typedef struct agg_instance_s agg_instance_t;
+struct agg_instance_s /* {{{ */
+{
+  lookup_identifier_t ident;
+  aggregation_t const *agg;
+
+  int ds_type;
+
+  agg_partial_t partials[AGG_STRIPES];
+
+  /* Only accessed by agg_instance_read(), i.e. the read thread. */
+  agg_partial_t merged;
+
   rate_to_value_state_t *state_num;
   rate_to_value_state_t *state_sum;
   rate_to_value_state_t *state_average;
   rate_to_value_state_t *state_min;
   rate_to_value_state_t *state_max;
   rate_to_value_state_t *state_stddev;
+  rate_to_value_state_t *state_distinct;
+  rate_to_value_state_t *state_percentile; /* agg->percentile_num entries */
 
   agg_instance_t *next;
 }; /* }}} */
@@ -88,6 +125,140 @@ static lookup_t *lookup;
 static pthread_mutex_t agg_instance_list_lock = PTHREAD_MUTEX_INITIALIZER;
 static agg_instance_t *agg_instance_list_head;
 
+/* Each thread is assigned one of the AGG_STRIPES partial accumulators. */
+static pthread_key_t agg_stripe_key;
+static pthread_once_t agg_stripe_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t agg_stripe_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t agg_stripe_next;
+
+static void agg_stripe_init(void) /* {{{ */
+{
+  pthread_key_create(&agg_stripe_key, /* destructor = */ NULL);
+} /* }}} void agg_stripe_init */
+
+static size_t agg_stripe_get(void) /* {{{ */
+{
+  pthread_once(&agg_stripe_once, agg_stripe_init);
+
+  /* Zero means "not assigned yet", so indexes are stored plus one. */
+  uintptr_t stripe = (uintptr_t)pthread_getspecific(agg_stripe_key);
+  if (stripe != 0)
+    return (size_t)(stripe - 1);
+
+  pthread_mutex_lock(&agg_stripe_lock);
+  stripe = (uintptr_t)(agg_stripe_next % AGG_STRIPES) + 1;
+  agg_stripe_next++;
+  pthread_mutex_unlock(&agg_stripe_lock);
+
+  pthread_setspecific(agg_stripe_key, (void *)stripe);
+  return (size_t)(stripe - 1);
+} /* }}} size_t agg_stripe_get */
+
+static int agg_partial_init(agg_partial_t *p, /* {{{ */
+                            aggregation_t const *agg) {
+  pthread_mutex_init(&p->lock, /* attr = */ NULL);
+  p->min = NAN;
+  p->max = NAN;
+
+  if (agg->calc_distinct) {
+    p->distinct = hll_create(AGG_DISTINCT_PRECISION);
+    if (p->distinct == NULL)
+      return ENOMEM;
+  }
+
+  return 0;
+} /* }}} int agg_partial_init */
+
+static void agg_partial_destroy(agg_partial_t *p) /* {{{ */
+{
+  sfree(p->values);
+  hll_destroy(p->distinct);
+  p->distinct = NULL;
+  pthread_mutex_destroy(&p->lock);
+} /* }}} void agg_partial_destroy */
+
+/* Resets the accumulated values. Allocated memory is kept. */
+static void agg_partial_reset(agg_partial_t *p) /* {{{ */
+{
+  p->num = 0;
+  p->sum = 0.0;
+  p->squares_sum = 0.0;
+  p->min = NAN;
+  p->max = NAN;
+  p->values_num = 0;
+  hll_reset(p->distinct);
+} /* }}} void agg_partial_reset */
+
+static int agg_partial_add_values(agg_partial_t *p, /* {{{ */
+                                  gauge_t const *values, size_t values_num) {
+  if (p->values_num + values_num > p->values_size) {
+    size_t new_size = (p->values_size == 0) ? 16 : 2 * p->values_size;
+    while (new_size < p->values_num + values_num)
+      new_size *= 2;
+
+    gauge_t *tmp = realloc(p->values, new_size * sizeof(*p->values));
+    if (tmp == NULL)
+      return ENOMEM;
+    p->values = tmp;
+    p->values_size = new_size;
+  }
+
+  memcpy(p->values + p->values_num, values, values_num * sizeof(*values));
+  p->values_num += values_num;
+  return 0;
+} /* }}} int agg_partial_add_values */
+
+/* Adds the values of "src" to "dst". Both must be locked, if required. */
+static void agg_partial_merge(agg_partial_t *dst, /* {{{ */
+                              agg_partial_t const *src) {
+  if (src->num == 0)
+    return;
+
+  dst->num += src->num;
+  dst->sum += src->sum;
+  dst->squares_sum += src->squares_sum;
+
+  if (isnan(dst->min) || (dst->min > src->min))
+    dst->min = src->min;
+  if (isnan(dst->max) || (dst->max < src->max))
+    dst->max = src->max;
+
+  if (src->values_num > 0) {
+    if (agg_partial_add_values(dst, src->values, src->values_num) != 0)
+      ERROR("aggregation plugin: realloc failed.");
+  }
+
+  if ((dst->distinct != NULL) && (src->distinct != NULL))
+    hll_merge(dst->distinct, src->distinct);
+} /* }}} void agg_partial_merge */
+
+static int agg_compare_gauge(void const *a, void const *b) /* {{{ */
+{
+  gauge_t ga = *(gauge_t const *)a;
+  gauge_t gb = *(gauge_t const *)b;
+
+  if (ga < gb)
+    return -1;
+  if (ga > gb)
+    return 1;
+  return 0;
+} /* }}} int agg_compare_gauge */
+
+/* Returns the percentile of the sorted values, interpolating linearly between
+ * the two closest ranks. */
+static gauge_t agg_percentile(gauge_t const *values, /* {{{ */
+                              size_t values_num, double percent) {
+  if (values_num == 0)
+    return NAN;
+
+  double rank = (percent / 100.0) * ((double)(values_num - 1));
+  size_t lower = (size_t)floor(rank);
+  size_t upper = (size_t)ceil(rank);
+  double frac = rank - (double)lower;
+
+  return values[lower] + frac * (values[upper] - values[lower]);
+} /* }}} gauge_t agg_percentile */
+
 static bool agg_is_regex(char const *str) /* {{{ */
 {
   if (str == NULL)
@@ -105,6 +276,10 @@ static bool agg_is_regex(char const *str) /* {{{ */
 
 static void agg_destroy(aggregation_t *agg) /* {{{ */
 {
+  if (agg == NULL)
+    return;
+
+  sfree(agg->percentile);
   sfree(agg);
 } /* }}} void agg_destroy */
 
@@ -127,17 +302,21 @@ static void agg_instance_destroy(agg_instance_t *inst) /* {{{ */
   }
   pthread_mutex_unlock(&agg_instance_list_lock);
 
+  for (size_t i = 0; i < AGG_STRIPES; i++)
+    agg_partial_destroy(inst->partials + i);
+  agg_partial_destroy(&inst->merged);
+
   sfree(inst->state_num);
   sfree(inst->state_sum);
   sfree(inst->state_average);
   sfree(inst->state_min);
   sfree(inst->state_max);
   sfree(inst->state_stddev);
+  sfree(inst->state_distinct);
+  sfree(inst->state_percentile);
 
   memset(inst, 0, sizeof(*inst));
   inst->ds_type = -1;
-  inst->min = NAN;
-  inst->max = NAN;
 } /* }}} void agg_instance_destroy */
 
 static int agg_instance_create_name(agg_instance_t *inst, /* {{{ */
@@ -238,14 +417,20 @@ static agg_instance_t *agg_instance_create(data_set_t const *ds, /* {{{ */
     ERROR("aggregation plugin: calloc() failed.");
     return NULL;
   }
-  pthread_mutex_init(&inst->lock, /* attr = */ NULL);
-
+  inst->agg = agg;
   inst->ds_type = ds->ds[0].type;
 
   agg_instance_create_name(inst, vl, agg);
 
-  inst->min = NAN;
-  inst->max = NAN;
+  int status = agg_partial_init(&inst->merged, agg);
+  for (size_t i = 0; (status == 0) && (i < AGG_STRIPES); i++)
+    status = agg_partial_init(inst->partials + i, agg);
+  if (status != 0) {
+    agg_instance_destroy(inst);
+    free(inst);
+    ERROR("aggregation plugin: hll_create() failed.");
+    return NULL;
+  }
 
 #define INIT_STATE(field)                                                      \
   do {                                                                         \
@@ -267,9 +452,21 @@ static agg_instance_t *agg_instance_create(data_set_t const *ds, /* {{{ */
   INIT_STATE(min);
   INIT_STATE(max);
   INIT_STATE(stddev);
+  INIT_STATE(distinct);
 
 #undef INIT_STATE
 
+  if (agg->percentile_num > 0) {
+    inst->state_percentile =
+        calloc(agg->percentile_num, sizeof(*inst->state_percentile));
+    if (inst->state_percentile == NULL) {
+      agg_instance_destroy(inst);
+      free(inst);
+      ERROR("aggregation plugin: calloc() failed.");
+      return NULL;
+    }
+  }
+
   pthread_mutex_lock(&agg_instance_list_lock);
   inst->next = agg_instance_list_head;
   agg_instance_list_head = inst;
@@ -278,6 +475,25 @@ static agg_instance_t *agg_instance_create(data_set_t const *ds, /* {{{ */
   return inst;
 } /* }}} agg_instance_t *agg_instance_create */
 
+/* Hashes the fields of the value list's identifier that may differ between
+ * the value lists aggregated into one instance. */
+static uint64_t agg_identity_hash(value_list_t const *vl) /* {{{ */
+{
+  char buffer[4 * DATA_MAX_NAME_LEN];
+  size_t len = 0;
+
+  char const *fields[] = {vl->host, vl->plugin, vl->plugin_instance,
+                          vl->type_instance};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++) {
+    /* Include the null byte to separate the fields. */
+    size_t field_len = strnlen(fields[i], DATA_MAX_NAME_LEN - 1) + 1;
+    memcpy(buffer + len, fields[i], field_len);
+    len += field_len;
+  }
+
+  return hll_hash(buffer, len);
+} /* }}} uint64_t agg_identity_hash */
+
 /* Update the num, sum, min, max, ... fields of the aggregation instance, if
  * the rate of the value list is available. Value lists with more than one data
  * source are not supported and will return an error. Returns zero on success
@@ -292,35 +508,55 @@ static int agg_instance_update(agg_instance_t *inst, /* {{{ */
     return EINVAL;
   }
 
-  gauge_t *rate = uc_get_rate(ds, vl);
-  if (rate == NULL) {
-    char ident[6 * DATA_MAX_NAME_LEN];
-    FORMAT_VL(ident, sizeof(ident), vl);
-    ERROR("aggregation plugin: Unable to read the current rate of \"%s\".",
-          ident);
-    return ENOENT;
+  /* The rate has just been computed by the dispatching thread. Only if the
+   * value list did not come through plugin_dispatch_values(), look it up in
+   * the cache. */
+  gauge_t rate = NAN;
+  if (uc_get_rate_dispatched(vl, &rate, 1) != 0) {
+    gauge_t *cached = uc_get_rate(ds, vl);
+    if (cached == NULL) {
+      char ident[6 * DATA_MAX_NAME_LEN];
+      FORMAT_VL(ident, sizeof(ident), vl);
+      ERROR("aggregation plugin: Unable to read the current rate of \"%s\".",
+            ident);
+      return ENOENT;
+    }
+    rate = cached[0];
+    sfree(cached);
   }
 
-  if (isnan(rate[0])) {
-    sfree(rate);
+  if (isnan(rate))
     return 0;
-  }
 
-  pthread_mutex_lock(&inst->lock);
+  uint64_t identity = 0;
+  if (inst->agg->calc_distinct)
+    identity = agg_identity_hash(vl);
 
-  inst->num++;
-  inst->sum += rate[0];
-  inst->squares_sum += (rate[0] * rate[0]);
+  agg_partial_t *p = inst->partials + agg_stripe_get();
+  int status = 0;
 
-  if (isnan(inst->min) || (inst->min > rate[0]))
-    inst->min = rate[0];
-  if (isnan(inst->max) || (inst->max < rate[0]))
-    inst->max = rate[0];
+  pthread_mutex_lock(&p->lock);
 
-  pthread_mutex_unlock(&inst->lock);
+  p->num++;
+  p->sum += rate;
+  p->squares_sum += (rate * rate);
 
-  sfree(rate);
-  return 0;
+  if (isnan(p->min) || (p->min > rate))
+    p->min = rate;
+  if (isnan(p->max) || (p->max < rate))
+    p->max = rate;
+
+  if (inst->agg->percentile_num > 0)
+    status = agg_partial_add_values(p, &rate, 1);
+
+  if (p->distinct != NULL)
+    hll_add_hash(p->distinct, identity);
+
+  pthread_mutex_unlock(&p->lock);
+
+  if (status != 0)
+    ERROR("aggregation plugin: realloc failed.");
+  return status;
 } /* }}} int agg_instance_update */
 
 static int agg_instance_read_func(agg_instance_t *inst, /* {{{ */
@@ -383,6 +619,19 @@ static int agg_instance_read(agg_instance_t *inst, cdtime_t t) /* {{{ */
   sstrncpy(vl.type_instance, inst->ident.type_instance,
            sizeof(vl.type_instance));
 
+  /* Collect the partial results, holding each lock only briefly. Values are
+   * dispatched without holding any lock. */
+  agg_partial_t *m = &inst->merged;
+  agg_partial_reset(m);
+  for (size_t i = 0; i < AGG_STRIPES; i++) {
+    agg_partial_t *p = inst->partials + i;
+
+    pthread_mutex_lock(&p->lock);
+    agg_partial_merge(m, p);
+    agg_partial_reset(p);
+    pthread_mutex_unlock(&p->lock);
+  }
+
 #define READ_FUNC(func, rate)                                                  \
   do {                                                                         \
     if (inst->state_##func != NULL) {                                          \
@@ -391,30 +640,38 @@ static int agg_instance_read(agg_instance_t *inst, cdtime_t t) /* {{{ */
     }                                                                          \
   } while (0)
 
-  pthread_mutex_lock(&inst->lock);
-
-  READ_FUNC(num, (gauge_t)inst->num);
+  READ_FUNC(num, (gauge_t)m->num);
+  READ_FUNC(distinct, (gauge_t)hll_count(m->distinct));
 
   /* All other aggregations are only defined when there have been any values
    * at all. */
-  if (inst->num > 0) {
-    READ_FUNC(sum, inst->sum);
-    READ_FUNC(average, (inst->sum / ((gauge_t)inst->num)));
-    READ_FUNC(min, inst->min);
-    READ_FUNC(max, inst->max);
-    READ_FUNC(stddev, sqrt((((gauge_t)inst->num) * inst->squares_sum) -
-                           (inst->sum * inst->sum)) /
-                          ((gauge_t)inst->num));
+  if (m->num > 0) {
+    READ_FUNC(sum, m->sum);
+    READ_FUNC(average, (m->sum / ((gauge_t)m->num)));
+    READ_FUNC(min, m->min);
+    READ_FUNC(max, m->max);
+    READ_FUNC(stddev, sqrt((((gauge_t)m->num) * m->squares_sum) -
+                           (m->sum * m->sum)) /
+                          ((gauge_t)m->num));
   }
 
-  /* Reset internal state. */
-  inst->num = 0;
-  inst->sum = 0.0;
-  inst->squares_sum = 0.0;
-  inst->min = NAN;
-  inst->max = NAN;
+#undef READ_FUNC
+
+  if ((m->num > 0) && (inst->agg->percentile_num > 0)) {
+    qsort(m->values, m->values_num, sizeof(*m->values), agg_compare_gauge);
+
+    for (size_t i = 0; i < inst->agg->percentile_num; i++) {
+      char func[DATA_MAX_NAME_LEN];
+      snprintf(func, sizeof(func), "percentile-%.5g",
+               inst->agg->percentile[i]);
 
-  pthread_mutex_unlock(&inst->lock);
+      agg_instance_read_func(inst, func,
+                             agg_percentile(m->values, m->values_num,
+                                            inst->agg->percentile[i]),
+                             inst->state_percentile + i, &vl,
+                             inst->ident.plugin_instance, t);
+    }
+  }
 
   meta_data_destroy(vl.meta);
   vl.meta = NULL;
@@ -465,6 +722,8 @@ static void agg_lookup_free_obj_callback(void *user_obj) /* {{{ */
  *     CalculateMinimum true
  *     CalculateMaximum true
  *     CalculateStddev true
+ *     CalculateDistinct true
+ *     CalculatePercentile 95
  *   </Aggregation>
  * </Plugin>
  */
@@ -499,6 +758,34 @@ static int agg_config_handle_group_by(oconfig_item_t const *ci, /* {{{ */
   return 0;
 } /* }}} int agg_config_handle_group_by */
 
+static int agg_config_handle_percentile(oconfig_item_t const *ci, /* {{{ */
+                                        aggregation_t *agg) {
+  double percent = NAN;
+
+  int status = cf_util_get_double(ci, &percent);
+  if (status != 0)
+    return status;
+
+  if (!((percent > 0.0) && (percent < 100.0))) {
+    ERROR("aggregation plugin: The value for \"%s\" must be between 0 and "
+          "100, exclusively.",
+          ci->key);
+    return ERANGE;
+  }
+
+  double *tmp = realloc(agg->percentile,
+                        sizeof(*agg->percentile) * (agg->percentile_num + 1));
+  if (tmp == NULL) {
+    ERROR("aggregation plugin: realloc failed.");
+    return ENOMEM;
+  }
+  agg->percentile = tmp;
+  agg->percentile[agg->percentile_num] = percent;
+  agg->percentile_num++;
+
+  return 0;
+} /* }}} int agg_config_handle_percentile */
+
 static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
 {
   aggregation_t *agg = calloc(1, sizeof(*agg));
@@ -555,13 +842,17 @@ static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_boolean(child, &agg->calc_max);
     else if (strcasecmp("CalculateStddev", child->key) == 0)
       status = cf_util_get_boolean(child, &agg->calc_stddev);
+    else if (strcasecmp("CalculateDistinct", child->key) == 0)
+      status = cf_util_get_boolean(child, &agg->calc_distinct);
+    else if (strcasecmp("CalculatePercentile", child->key) == 0)
+      status = agg_config_handle_percentile(child, agg);
     else
       WARNING("aggregation plugin: The \"%s\" key is not allowed inside "
               "<Aggregation /> blocks and will be ignored.",
               child->key);
 
     if (status != 0) {
-      sfree(agg);
+      agg_destroy(agg);
       return status;
     }
   } /* for (int i = 0; i < ci->children_num; i++) */
@@ -620,7 +911,8 @@ static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
   } /* }}} */
 
   if (!agg->calc_num && !agg->calc_sum && !agg->calc_average /* {{{ */
-      && !agg->calc_min && !agg->calc_max && !agg->calc_stddev) {
+      && !agg->calc_min && !agg->calc_max && !agg->calc_stddev &&
+      !agg->calc_distinct && (agg->percentile_num == 0)) {
     ERROR("aggregation plugin: No aggregation function has been specified. "
           "Without this, I don't know what I should be calculating. "
           "(Host \"%s\", Plugin \"%s\", PluginInstance \"%s\", "
@@ -631,14 +923,14 @@ static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
   } /* }}} */
 
   if (!is_valid) { /* {{{ */
-    sfree(agg);
+    agg_destroy(agg);
     return -1;
   } /* }}} */
 
   int status = lookup_add(lookup, &agg->ident, agg->group_by, agg);
   if (status != 0) {
     ERROR("aggregation plugin: lookup_add failed with status %i.", status);
-    sfree(agg);
+    agg_destroy(agg);
     return -1;
   }
 
@@ -686,7 +978,12 @@ static int agg_read(void) /* {{{ */
   cdtime_t t = cdtime();
   int success = 0;
 
+  /* New instances are only ever prepended and instances are only removed on
+   * shutdown, so the list can be walked from a snapshot of the head without
+   * blocking the write threads creating new instances. */
   pthread_mutex_lock(&agg_instance_list_lock);
+  agg_instance_t *head = agg_instance_list_head;
+  pthread_mutex_unlock(&agg_instance_list_lock);
 
   /* agg_instance_list_head only holds data, after the "write" callback has
    * been called with a matching value list at least once. So on startup,
@@ -694,13 +991,10 @@ static int agg_read(void) /* {{{ */
    * the read() callback is called first, agg_instance_list_head is NULL and
    * "success" may be zero. This is expected and should not result in an error.
    * Therefore we need to handle this case separately. */
-  if (agg_instance_list_head == NULL) {
-    pthread_mutex_unlock(&agg_instance_list_lock);
+  if (head == NULL)
     return 0;
-  }
 
-  for (agg_instance_t *this = agg_instance_list_head; this != NULL;
-       this = this->next) {
+  for (agg_instance_t *this = head; this != NULL; this = this->next) {
     int status = agg_instance_read(this, t);
     if (status != 0)
       WARNING("aggregation plugin: Reading an aggregation instance "
@@ -710,8 +1004,6 @@ static int agg_read(void) /* {{{ */
       success++;
   }
 
-  pthread_mutex_unlock(&agg_instance_list_lock);
-
   return (success > 0) ? 0 : -1;
 } /* }}} int agg_read */
 
@@ -0,0 +1,200 @@
+/**
+ * collectd - src/aggregation_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#define plugin_dispatch_values plugin_dispatch_values_agg_test
+#define uc_get_rate_dispatched uc_get_rate_dispatched_agg_test
+
+#include "testing.h"
+
+#include "aggregation.c" /* sic */
+
+#define TEST_THREADS 16
+#define TEST_VALUES 100
+
+typedef struct {
+  char plugin_instance[DATA_MAX_NAME_LEN];
+  gauge_t value;
+} dispatched_t;
+
+static dispatched_t dispatched[16];
+static size_t dispatched_num;
+
+/* mock functions */
+int plugin_dispatch_values_agg_test(value_list_t const *vl) {
+  if (dispatched_num >= STATIC_ARRAY_SIZE(dispatched))
+    return ENOMEM;
+
+  dispatched_t *d = dispatched + dispatched_num;
+  sstrncpy(d->plugin_instance, vl->plugin_instance,
+           sizeof(d->plugin_instance));
+  d->value = vl->values[0].gauge;
+  dispatched_num++;
+  return 0;
+}
+
+/* All test values are gauges, so the rates are the values themselves. */
+int uc_get_rate_dispatched_agg_test(value_list_t const *vl,
+                                    gauge_t *ret_values, size_t values_num) {
+  if (vl->values_len != values_num)
+    return EINVAL;
+
+  for (size_t i = 0; i < values_num; i++)
+    ret_values[i] = vl->values[i].gauge;
+  return 0;
+}
+/* end mock functions */
+
+static data_source_t test_ds_source[] = {
+    {"value", DS_TYPE_GAUGE, NAN, NAN},
+};
+static data_set_t test_ds = {"gauge", 1, test_ds_source};
+
+static gauge_t get_dispatched(char const *plugin_instance) {
+  for (size_t i = 0; i < dispatched_num; i++)
+    if (strcmp(plugin_instance, dispatched[i].plugin_instance) == 0)
+      return dispatched[i].value;
+  return NAN;
+}
+
+DEF_TEST(percentile) {
+  gauge_t values[] = {1.0, 2.0, 3.0, 4.0, 5.0};
+  size_t values_num = STATIC_ARRAY_SIZE(values);
+
+  EXPECT_EQ_DOUBLE(1.0, agg_percentile(values, values_num, 0.0));
+  EXPECT_EQ_DOUBLE(3.0, agg_percentile(values, values_num, 50.0));
+  EXPECT_EQ_DOUBLE(5.0, agg_percentile(values, values_num, 100.0));
+  /* Interpolated between the closest ranks. */
+  EXPECT_EQ_DOUBLE(4.6, agg_percentile(values, values_num, 90.0));
+  EXPECT_EQ_DOUBLE(1.2, agg_percentile(values, values_num, 5.0));
+
+  EXPECT_EQ_DOUBLE(7.0, agg_percentile((gauge_t[]){7.0}, 1, 95.0));
+  EXPECT_EQ_DOUBLE(NAN, agg_percentile(NULL, 0, 50.0));
+  return 0;
+}
+
+typedef struct {
+  agg_instance_t *inst;
+  int index;
+  int status;
+} update_thread_t;
+
+/* Each thread updates the instance with values from a different host. */
+static void *update_thread(void *arg) {
+  update_thread_t *t = arg;
+
+  value_list_t vl = {
+      .values_len = 1,
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .plugin = "test",
+      .type = "gauge",
+  };
+  snprintf(vl.host, sizeof(vl.host), "host%d", t->index);
+
+  for (int i = 0; (t->status == 0) && (i < TEST_VALUES); i++) {
+    vl.values = &(value_t){.gauge = (gauge_t)(t->index * TEST_VALUES + i)};
+    vl.time = TIME_T_TO_CDTIME_T(i + 1);
+    t->status = agg_instance_update(t->inst, &test_ds, &vl);
+  }
+
+  return NULL;
+}
+
+DEF_TEST(stripes) {
+  double percentile[] = {50.0, 99.0};
+  aggregation_t agg = {
+      .ident = {.host = "/.*/", .plugin = "test", .type = "gauge"},
+      .set_host = "global",
+      .set_plugin_instance = AGG_FUNC_PLACEHOLDER,
+      .calc_num = true,
+      .calc_sum = true,
+      .calc_average = true,
+      .calc_min = true,
+      .calc_max = true,
+      .calc_distinct = true,
+      .percentile = percentile,
+      .percentile_num = STATIC_ARRAY_SIZE(percentile),
+  };
+  value_list_t vl = {
+      .host = "host0",
+      .plugin = "test",
+      .type = "gauge",
+  };
+
+  agg_instance_t *inst = agg_instance_create(&test_ds, &vl, &agg);
+  CHECK_NOT_NULL(inst);
+  EXPECT_EQ_STR("global", inst->ident.host);
+
+  pthread_t threads[TEST_THREADS];
+  update_thread_t args[TEST_THREADS];
+  for (int i = 0; i < TEST_THREADS; i++) {
+    args[i] = (update_thread_t){.inst = inst, .index = i};
+    CHECK_ZERO(pthread_create(threads + i, NULL, update_thread, args + i));
+  }
+  for (int i = 0; i < TEST_THREADS; i++) {
+    CHECK_ZERO(pthread_join(threads[i], NULL));
+    CHECK_ZERO(args[i].status);
+  }
+
+  /* The threads are distributed evenly across the stripes. */
+  for (size_t i = 0; i < AGG_STRIPES; i++)
+    EXPECT_EQ_INT(TEST_THREADS / AGG_STRIPES * TEST_VALUES,
+                  inst->partials[i].num);
+
+  dispatched_num = 0;
+  CHECK_ZERO(agg_instance_read(inst, TIME_T_TO_CDTIME_T(100)));
+
+  /* The values are 0 ... 1599. */
+  gauge_t num = TEST_THREADS * TEST_VALUES;
+  EXPECT_EQ_DOUBLE(num, get_dispatched("num"));
+  EXPECT_EQ_DOUBLE(num * (num - 1) / 2.0, get_dispatched("sum"));
+  EXPECT_EQ_DOUBLE((num - 1) / 2.0, get_dispatched("average"));
+  EXPECT_EQ_DOUBLE(0.0, get_dispatched("min"));
+  EXPECT_EQ_DOUBLE(num - 1, get_dispatched("max"));
+  EXPECT_EQ_DOUBLE(TEST_THREADS, get_dispatched("distinct"));
+  EXPECT_EQ_DOUBLE(799.5, get_dispatched("percentile-50"));
+  EXPECT_EQ_DOUBLE(1583.01, get_dispatched("percentile-99"));
+
+  /* Reading resets all stripes. */
+  for (size_t i = 0; i < AGG_STRIPES; i++)
+    EXPECT_EQ_INT(0, inst->partials[i].num);
+
+  dispatched_num = 0;
+  CHECK_ZERO(agg_instance_read(inst, TIME_T_TO_CDTIME_T(110)));
+  EXPECT_EQ_DOUBLE(0.0, get_dispatched("num"));
+  EXPECT_EQ_DOUBLE(0.0, get_dispatched("distinct"));
+  EXPECT_EQ_DOUBLE(NAN, get_dispatched("sum"));
+
+  agg_instance_destroy(inst);
+  free(inst);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(percentile);
+  RUN_TEST(stripes);
+
+  END_TEST;
+}
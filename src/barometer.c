@@ -374,8 +374,9 @@ static void temp_list_delete(temperature_list_t **list) {
  * nondeterministic order the temperature may not be read yet (then it fails and
  * first measurment gives only absolute air pressure reading which is
  * acceptable). Once it succedes (should be second measurement at the latest) we
- * use average of few last readings from uc_get_history_by_name. It may take few
- * readings to start filling so again we use uc_get_rate_by_name as a fallback.
+ * use average of few last readings from uc_get_history_stats_by_name. It may
+ * take few readings to start filling so again we use uc_get_rate_by_name as a
+ * fallback.
  * The idea is to use basic "noise" filtering (history averaging) across all the
  * values which given sensor provides (up to given depth). Then we get minimum
  * among the sensors.
@@ -390,8 +391,6 @@ static int get_reference_temperature(double *result) {
   gauge_t *values = NULL; /**< rate values */
   size_t values_num = 0;  /**< number of rate values */
 
-  gauge_t values_history[REF_TEMP_AVG_NUM];
-
   double avg_sum; /**< Value sum for computing average */
   int avg_num;    /**< Number of values for computing average */
   double average; /**< Resulting value average */
@@ -436,24 +435,34 @@ static int get_reference_temperature(double *result) {
 
     /* It is OK to get here the first time as well, in the worst case
        the history will full of NANs. */
-    if (uc_get_history_by_name(list->sensor_name, values_history,
-                               REF_TEMP_AVG_NUM, list->num_values)) {
+    uc_history_stats_t *stats = calloc(list->num_values, sizeof(*stats));
+    if (stats == NULL) {
+      ERROR("barometer: get_reference_temperature - calloc failed");
+      list = list->next;
+      continue;
+    }
+
+    if (uc_get_history_stats_by_name(list->sensor_name, stats,
+                                     REF_TEMP_AVG_NUM, list->num_values)) {
       ERROR("barometer: get_reference_temperature - history \"%s\" lost",
             list->sensor_name);
+      free(stats);
       list->initialized = 0;
       list->num_values = 0;
       list = list->next;
       continue;
     }
 
-    for (size_t i = 0; i < REF_TEMP_AVG_NUM * list->num_values; ++i) {
-      DEBUG("barometer: get_reference_temperature - history %" PRIsz ": %lf", i,
-            values_history[i]);
-      if (!isnan(values_history[i])) {
-        avg_sum += values_history[i];
-        ++avg_num;
+    for (size_t i = 0; i < list->num_values; ++i) {
+      DEBUG("barometer: get_reference_temperature - history %" PRIsz
+            ": %lf (%" PRIsz " values)",
+            i, stats[i].mean, stats[i].num);
+      if (stats[i].num > 0) {
+        avg_sum += stats[i].mean * (double)stats[i].num;
+        avg_num += (int)stats[i].num;
       }
     }
+    free(stats);
 
     if (avg_num == 0) /* still no history? fallback to current */
     {
@@ -33,9 +33,12 @@
 #endif
 
 #include <errno.h>
+#include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -52,22 +55,82 @@
 #define DEF_NUM_PLUGINS 20
 #define DEF_NUM_VALUES 100000
 #define DEF_INTERVAL 10.0
+#define DEF_NUM_THREADS 1
+
+/* Maximum number of data sources of a type read from types.db. */
+#define TG_MAX_DS 16
+
+/* Latencies are counted in a log-linear histogram: every power of two (in
+ * nanoseconds) is split into TG_LATENCY_SUB_BUCKETS buckets. */
+#define TG_LATENCY_SUB_BUCKETS 8
+#define TG_LATENCY_BUCKETS (64 * TG_LATENCY_SUB_BUCKETS)
+
+/* Number of values a thread sends before publishing its statistics. */
+#define TG_STATS_BATCH 256
+
+typedef struct {
+  char name[LCC_NAME_LEN];
+  size_t ds_num;
+  int ds_types[TG_MAX_DS];
+} tg_type_t;
+
+typedef struct {
+  uint64_t sent;
+  uint64_t errors;
+  uint64_t latency_num;
+  uint64_t latency[TG_LATENCY_BUCKETS];
+  double latency_sum;
+  double latency_max;
+} tg_stats_t;
+
+typedef struct {
+  pthread_t thread;
+  int index;
+  int num_values;
+  uint64_t random_state;
+
+  lcc_network_t *net;
+  lcc_connection_t *con;
+
+  /* Submission times of the value lists awaiting the daemon's response,
+   * oldest first. The responses arrive in the order of submission. */
+  double *submitted;
+  size_t submitted_head;
+  size_t submitted_num;
+  size_t submitted_size;
+
+  /* Statistics of the values sent since they were last published. Only
+   * accessed by the thread itself. */
+  tg_stats_t local;
+
+  /* Published statistics, read by the main thread. */
+  pthread_mutex_t lock;
+  tg_stats_t stats;
+} tg_thread_t;
 
 static int conf_num_hosts = DEF_NUM_HOSTS;
 static int conf_num_plugins = DEF_NUM_PLUGINS;
 static int conf_num_values = DEF_NUM_VALUES;
+static int conf_num_threads = DEF_NUM_THREADS;
 static double conf_interval = DEF_INTERVAL;
+static double conf_rate;
+static double conf_duration;
+static double conf_churn;
+static unsigned long conf_seed;
+static bool conf_seed_set;
+static const char *conf_types_file;
+static const char *conf_socket;
+static int conf_group_size = 1;
 static const char *conf_destination = NET_DEFAULT_V6_ADDR;
 static const char *conf_service = NET_DEFAULT_PORT;
 
-static lcc_network_t *net;
-
-static c_heap_t *values_heap;
+static tg_type_t *types;
+static size_t types_num;
 
 static struct sigaction sigint_action;
 static struct sigaction sigterm_action;
 
-static bool loop = true;
+static volatile bool loop = true;
 
 __attribute__((noreturn)) static void exit_usage(int exit_status) /* {{{ */
 {
@@ -82,16 +145,27 @@ __attribute__((noreturn)) static void exit_usage(int exit_status) /* {{{ */
       "    -H <number>    Number of hosts to emulate. (Default: %i)\n"
       "    -p <number>    Number of plugins to emulate. (Default: %i)\n"
       "    -i <seconds>   Interval of each value in seconds. (Default: %.3f)\n"
+      "    -T <number>    Number of sending threads. (Default: %i)\n"
+      "    -r <rate>      Send this many values per second in total instead\n"
+      "                   of one value per value list and interval.\n"
+      "    -l <seconds>   Stop after this many seconds.\n"
+      "    -c <percent>   Identifier churn: Percentage of value lists that\n"
+      "                   change their identifier each time they are sent.\n"
+      "    -t <file>      Draw types and data sources from this types.db.\n"
+      "    -s <seed>      Seed of the random number generator.\n"
       "    -d <dest>      Destination address of the network packets.\n"
       "                   (Default: %s)\n"
       "    -D <port>      Destination port of the network packets.\n"
       "                   (Default: %s)\n"
+      "    -u <path>      Send PUTVAL commands to this UNIX socket instead\n"
+      "                   of network packets.\n"
+      "    -G <number>    Value lists per PUTVAL command. (Default: 1)\n"
       "    -h             Print usage information (this output).\n"
       "\n"
       "Copyright (C) 2010-2012  Florian Forster\n"
       "Licensed under the MIT license.\n",
       DEF_NUM_VALUES, DEF_NUM_HOSTS, DEF_NUM_PLUGINS, DEF_INTERVAL,
-      NET_DEFAULT_V6_ADDR, NET_DEFAULT_PORT);
+      DEF_NUM_THREADS, NET_DEFAULT_V6_ADDR, NET_DEFAULT_PORT);
   exit(exit_status);
 } /* }}} void exit_usage */
 
@@ -123,6 +197,26 @@ static double dtime(void) /* {{{ */
 } /* }}} double dtime */
 #endif
 
+/* Sleeps until "t", in steps short enough to notice a shutdown request. */
+static void sleep_until(double t) /* {{{ */
+{
+  double now = dtime();
+
+  while (loop && (now < t)) {
+    double diff = t - now;
+    if (diff > 0.1)
+      diff = 0.1;
+
+    struct timespec ts = {
+        .tv_sec = (time_t)diff,
+    };
+    ts.tv_nsec = (long)((diff - ((double)ts.tv_sec)) * 1e9);
+
+    nanosleep(&ts, /* remaining = */ NULL);
+    now = dtime();
+  }
+} /* }}} void sleep_until */
+
 static int compare_time(const void *v0, const void *v1) /* {{{ */
 {
   const lcc_value_list_t *vl0 = v0;
@@ -136,7 +230,27 @@ static int compare_time(const void *v0, const void *v1) /* {{{ */
     return 0;
 } /* }}} int compare_time */
 
-static int get_boundet_random(int min, int max) /* {{{ */
+/* xorshift64*: Each thread has its own generator, so that the generated
+ * traffic only depends on the seed and the options. */
+static uint64_t tg_random(uint64_t *state) /* {{{ */
+{
+  uint64_t x = *state;
+
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+
+  return x * UINT64_C(2685821657736338717);
+} /* }}} uint64_t tg_random */
+
+/* Returns a random number in [0, 1). */
+static double tg_random_double(uint64_t *state) /* {{{ */
+{
+  return (double)(tg_random(state) >> 11) / 9007199254740992.0;
+} /* }}} double tg_random_double */
+
+static int get_boundet_random(uint64_t *state, int min, int max) /* {{{ */
 {
   int range;
 
@@ -147,29 +261,118 @@ static int get_boundet_random(int min, int max) /* {{{ */
 
   range = max - min;
 
-  return min + ((int)(((double)range) * ((double)random()) /
-                      (((double)RAND_MAX) + 1.0)));
+  return min + (int)(((double)range) * tg_random_double(state));
 } /* }}} int get_boundet_random */
 
-static lcc_value_list_t *create_value_list(void) /* {{{ */
+static int parse_ds_type(char const *str) /* {{{ */
+{
+  if (strcasecmp("GAUGE", str) == 0)
+    return LCC_TYPE_GAUGE;
+  else if (strcasecmp("DERIVE", str) == 0)
+    return LCC_TYPE_DERIVE;
+  else if (strcasecmp("COUNTER", str) == 0)
+    return LCC_TYPE_COUNTER;
+  else if (strcasecmp("ABSOLUTE", str) == 0)
+    return LCC_TYPE_ABSOLUTE;
+  return -1;
+} /* }}} int parse_ds_type */
+
+/* Reads types and the types of their data sources from a file in the
+ * types.db(5) format. */
+static int read_types(char const *file) /* {{{ */
+{
+  FILE *fh = fopen(file, "r");
+  if (fh == NULL) {
+    fprintf(stderr, "Opening \"%s\" failed: %s\n", file, strerror(errno));
+    return -1;
+  }
+
+  char line[4096];
+  while (fgets(line, sizeof(line), fh) != NULL) {
+    tg_type_t type = {{0}};
+    char *saveptr = NULL;
+    char *field;
+
+    field = strtok_r(line, " \t\r\n", &saveptr);
+    if ((field == NULL) || (field[0] == '#'))
+      continue;
+    snprintf(type.name, sizeof(type.name), "%s", field);
+
+    /* Data sources: "name:TYPE:min:max", separated by commas. */
+    while ((field = strtok_r(NULL, " \t\r\n,", &saveptr)) != NULL) {
+      char *ds_type = strchr(field, ':');
+      if (ds_type == NULL)
+        break;
+      ds_type++;
+
+      char *end = strchr(ds_type, ':');
+      if (end != NULL)
+        *end = 0;
+
+      int t = parse_ds_type(ds_type);
+      if ((t < 0) || (type.ds_num >= TG_MAX_DS)) {
+        type.ds_num = 0;
+        break;
+      }
+      type.ds_types[type.ds_num] = t;
+      type.ds_num++;
+    }
+
+    if (type.ds_num == 0)
+      continue;
+
+    tg_type_t *tmp = realloc(types, (types_num + 1) * sizeof(*types));
+    if (tmp == NULL) {
+      fprintf(stderr, "realloc failed.\n");
+      fclose(fh);
+      return -1;
+    }
+    types = tmp;
+    types[types_num] = type;
+    types_num++;
+  }
+
+  fclose(fh);
+
+  if (types_num == 0) {
+    fprintf(stderr, "No usable types found in \"%s\".\n", file);
+    return -1;
+  }
+  return 0;
+} /* }}} int read_types */
+
+static void set_type_instance(tg_thread_t *t, lcc_value_list_t *vl) /* {{{ */
+{
+  snprintf(vl->identifier.type_instance, sizeof(vl->identifier.type_instance),
+           "ti%" PRIu64, tg_random(&t->random_state) >> 33);
+} /* }}} void set_type_instance */
+
+static lcc_value_list_t *create_value_list(tg_thread_t *t) /* {{{ */
 {
   lcc_value_list_t *vl;
+  tg_type_t const *type = NULL;
+  size_t values_len = 1;
   int host_num;
 
+  if (types_num > 0) {
+    type = types + get_boundet_random(&t->random_state, 0, (int)types_num);
+    values_len = type->ds_num;
+  }
+
   vl = calloc(1, sizeof(*vl));
   if (vl == NULL) {
     fprintf(stderr, "calloc failed.\n");
     return NULL;
   }
 
-  vl->values = calloc(/* nmemb = */ 1, sizeof(*vl->values));
+  vl->values = calloc(values_len, sizeof(*vl->values));
   if (vl->values == NULL) {
     fprintf(stderr, "calloc failed.\n");
     free(vl);
     return NULL;
   }
 
-  vl->values_types = calloc(/* nmemb = */ 1, sizeof(*vl->values_types));
+  vl->values_types = calloc(values_len, sizeof(*vl->values_types));
   if (vl->values_types == NULL) {
     fprintf(stderr, "calloc failed.\n");
     free(vl->values);
@@ -177,28 +380,35 @@ static lcc_value_list_t *create_value_list(void) /* {{{ */
     return NULL;
   }
 
-  vl->values_len = 1;
+  vl->values_len = values_len;
 
-  host_num = get_boundet_random(0, conf_num_hosts);
+  host_num = get_boundet_random(&t->random_state, 0, conf_num_hosts);
 
   vl->interval = conf_interval;
   vl->time = 1.0 + dtime() + (host_num % (1 + (int)vl->interval));
 
-  if (get_boundet_random(0, 2) == 0)
-    vl->values_types[0] = LCC_TYPE_GAUGE;
-  else
-    vl->values_types[0] = LCC_TYPE_DERIVE;
+  if (type != NULL) {
+    memcpy(vl->values_types, type->ds_types,
+           values_len * sizeof(*vl->values_types));
+    snprintf(vl->identifier.type, sizeof(vl->identifier.type), "%s",
+             type->name);
+  } else {
+    if (get_boundet_random(&t->random_state, 0, 2) == 0)
+      vl->values_types[0] = LCC_TYPE_GAUGE;
+    else
+      vl->values_types[0] = LCC_TYPE_DERIVE;
+
+    strncpy(vl->identifier.type,
+            (vl->values_types[0] == LCC_TYPE_GAUGE) ? "gauge" : "derive",
+            sizeof(vl->identifier.type));
+    vl->identifier.type[sizeof(vl->identifier.type) - 1] = '\0';
+  }
 
   snprintf(vl->identifier.host, sizeof(vl->identifier.host), "host%04i",
            host_num);
   snprintf(vl->identifier.plugin, sizeof(vl->identifier.plugin), "plugin%03i",
-           get_boundet_random(0, conf_num_plugins));
-  strncpy(vl->identifier.type,
-          (vl->values_types[0] == LCC_TYPE_GAUGE) ? "gauge" : "derive",
-          sizeof(vl->identifier.type));
-  vl->identifier.type[sizeof(vl->identifier.type) - 1] = '\0';
-  snprintf(vl->identifier.type_instance, sizeof(vl->identifier.type_instance),
-           "ti%li", random());
+           get_boundet_random(&t->random_state, 0, conf_num_plugins));
+  set_type_instance(t, vl);
 
   return vl;
 } /* }}} int create_value_list */
@@ -213,25 +423,282 @@ static void destroy_value_list(lcc_value_list_t *vl) /* {{{ */
   free(vl);
 } /* }}} void destroy_value_list */
 
-static int send_value(lcc_value_list_t *vl) /* {{{ */
+static size_t latency_bucket(double latency) /* {{{ */
 {
-  int status;
+  int exp;
+  double frac = frexp(latency * 1e9, &exp);
 
-  if (vl->values_types[0] == LCC_TYPE_GAUGE)
-    vl->values[0].gauge =
-        100.0 * ((gauge_t)random()) / (((gauge_t)RAND_MAX) + 1.0);
-  else
-    vl->values[0].derive += (derive_t)get_boundet_random(0, 100);
+  /* frac is in [0.5, 1) for positive values. */
+  if ((frac <= 0.0) || (exp < 1))
+    return 0;
+
+  size_t bucket =
+      (size_t)exp * TG_LATENCY_SUB_BUCKETS +
+      (size_t)((frac - 0.5) * 2.0 * (double)TG_LATENCY_SUB_BUCKETS);
+  if (bucket >= TG_LATENCY_BUCKETS)
+    bucket = TG_LATENCY_BUCKETS - 1;
+  return bucket;
+} /* }}} size_t latency_bucket */
+
+/* Returns the upper bound of a latency bucket in seconds. */
+static double latency_bucket_bound(size_t bucket) /* {{{ */
+{
+  int exp = (int)(bucket / TG_LATENCY_SUB_BUCKETS);
+  size_t sub = bucket % TG_LATENCY_SUB_BUCKETS;
+
+  return ldexp(0.5 + (double)(sub + 1) / (2.0 * TG_LATENCY_SUB_BUCKETS), exp) /
+         1e9;
+} /* }}} double latency_bucket_bound */
+
+static void stats_merge(tg_stats_t *dst, tg_stats_t const *src) /* {{{ */
+{
+  dst->sent += src->sent;
+  dst->errors += src->errors;
+  dst->latency_num += src->latency_num;
+  for (size_t i = 0; i < TG_LATENCY_BUCKETS; i++)
+    dst->latency[i] += src->latency[i];
+  dst->latency_sum += src->latency_sum;
+  if (dst->latency_max < src->latency_max)
+    dst->latency_max = src->latency_max;
+} /* }}} void stats_merge */
+
+static double stats_percentile(tg_stats_t const *s, double percent) /* {{{ */
+{
+  uint64_t sum = 0;
+  uint64_t want =
+      (uint64_t)ceil(((double)s->latency_num) * percent / 100.0);
+
+  for (size_t i = 0; i < TG_LATENCY_BUCKETS; i++) {
+    sum += s->latency[i];
+    if ((sum > 0) && (sum >= want)) {
+      double bound = latency_bucket_bound(i);
+      return (bound < s->latency_max) ? bound : s->latency_max;
+    }
+  }
+  return s->latency_max;
+} /* }}} double stats_percentile */
+
+static void publish_stats(tg_thread_t *t) /* {{{ */
+{
+  pthread_mutex_lock(&t->lock);
+  stats_merge(&t->stats, &t->local);
+  pthread_mutex_unlock(&t->lock);
+
+  memset(&t->local, 0, sizeof(t->local));
+} /* }}} void publish_stats */
+
+static void record_latency(tg_thread_t *t, double latency) /* {{{ */
+{
+  t->local.latency_num++;
+  t->local.latency[latency_bucket(latency)]++;
+  t->local.latency_sum += latency;
+  if (t->local.latency_max < latency)
+    t->local.latency_max = latency;
+} /* }}} void record_latency */
+
+static int submitted_push(tg_thread_t *t, double time) /* {{{ */
+{
+  if (t->submitted_num >= t->submitted_size) {
+    size_t new_size = (t->submitted_size == 0) ? 64 : 2 * t->submitted_size;
+    double *tmp = malloc(new_size * sizeof(*tmp));
+    if (tmp == NULL)
+      return ENOMEM;
+
+    for (size_t i = 0; i < t->submitted_num; i++)
+      tmp[i] = t->submitted[(t->submitted_head + i) % t->submitted_size];
+    free(t->submitted);
+    t->submitted = tmp;
+    t->submitted_head = 0;
+    t->submitted_size = new_size;
+  }
+
+  t->submitted[(t->submitted_head + t->submitted_num) % t->submitted_size] =
+      time;
+  t->submitted_num++;
+  return 0;
+} /* }}} int submitted_push */
+
+static void putval_callback(int status, /* {{{ */
+                            const char __attribute__((unused)) * message,
+                            void *user_data) {
+  tg_thread_t *t = user_data;
+
+  if (t->submitted_num > 0) {
+    double submitted = t->submitted[t->submitted_head];
+    t->submitted_head = (t->submitted_head + 1) % t->submitted_size;
+    t->submitted_num--;
+
+    if (status == 0)
+      record_latency(t, dtime() - submitted);
+  }
 
-  status = lcc_network_values_send(net, vl);
   if (status != 0)
-    fprintf(stderr, "lcc_network_values_send failed with status %i.\n", status);
+    t->local.errors++;
+} /* }}} void putval_callback */
+
+static int send_value(tg_thread_t *t, lcc_value_list_t *vl) /* {{{ */
+{
+  int status;
+
+  for (size_t i = 0; i < vl->values_len; i++) {
+    switch (vl->values_types[i]) {
+    case LCC_TYPE_GAUGE:
+      vl->values[i].gauge = 100.0 * tg_random_double(&t->random_state);
+      break;
+    case LCC_TYPE_DERIVE:
+      vl->values[i].derive +=
+          (derive_t)get_boundet_random(&t->random_state, 0, 100);
+      break;
+    case LCC_TYPE_COUNTER:
+      vl->values[i].counter +=
+          (counter_t)get_boundet_random(&t->random_state, 0, 100);
+      break;
+    case LCC_TYPE_ABSOLUTE:
+      vl->values[i].absolute =
+          (absolute_t)get_boundet_random(&t->random_state, 0, 100);
+      break;
+    }
+  }
+
+  if ((conf_churn > 0.0) &&
+      (100.0 * tg_random_double(&t->random_state) < conf_churn))
+    set_type_instance(t, vl);
+
+  if (t->con != NULL) {
+    /* The latency is measured from here until putval_callback() receives
+     * the response, including the time the command spends buffered. */
+    status = submitted_push(t, dtime());
+    if (status == 0) {
+      status = lcc_putval_async(t->con, vl, putval_callback, t);
+      /* If the value list was not queued, its callback will not be called.
+       * Otherwise a failure has called the callbacks of all queued value
+       * lists already. */
+      if ((status != 0) && (t->submitted_num > 0))
+        t->submitted_num--;
+    }
+  } else {
+    /* Without responses, only the time to pass the value list to the
+     * library, which buffers it until a packet is full, can be measured. */
+    double begin = dtime();
+    status = lcc_network_values_send(t->net, vl);
+    record_latency(t, dtime() - begin);
+  }
+
+  if (status != 0) {
+    if (t->local.errors == 0)
+      fprintf(stderr, "Thread %i: sending a value failed with status %i.\n",
+              t->index, status);
+    t->local.errors++;
+  }
+
+  t->local.sent++;
+
+  if (t->local.sent >= TG_STATS_BATCH)
+    publish_stats(t);
 
   vl->time += vl->interval;
 
   return 0;
 } /* }}} int send_value */
 
+/* Sends each value list once per interval, at the time it is due. */
+static void send_interval_paced(tg_thread_t *t, /* {{{ */
+                                lcc_value_list_t **values) {
+  c_heap_t *values_heap = c_heap_create(compare_time);
+  if (values_heap == NULL) {
+    fprintf(stderr, "c_heap_create failed.\n");
+    return;
+  }
+
+  for (int i = 0; i < t->num_values; i++)
+    c_heap_insert(values_heap, values[i]);
+
+  while (loop) {
+    lcc_value_list_t *vl = c_heap_get_root(values_heap);
+
+    if (vl == NULL)
+      break;
+
+    sleep_until(vl->time);
+    if (!loop) {
+      c_heap_insert(values_heap, vl);
+      break;
+    }
+
+    send_value(t, vl);
+
+    c_heap_insert(values_heap, vl);
+  }
+
+  /* The value lists are owned by the caller. */
+  while (c_heap_get_root(values_heap) != NULL)
+    ;
+  c_heap_destroy(values_heap);
+} /* }}} void send_interval_paced */
+
+/* Sends the value lists round-robin at the thread's share of "-r". */
+static void send_rate_paced(tg_thread_t *t, /* {{{ */
+                            lcc_value_list_t **values) {
+  double rate = conf_rate / (double)conf_num_threads;
+  double start = dtime();
+  uint64_t count = 0;
+
+  while (loop) {
+    for (int i = 0; loop && (i < t->num_values); i++) {
+      double due = start + ((double)count) / rate;
+      /* Only sleep when ahead by more than a millisecond; sending a few
+       * values early is cheaper than many short sleeps. */
+      if (due - dtime() > 0.001)
+        sleep_until(due);
+
+      values[i]->time = dtime();
+      send_value(t, values[i]);
+      count++;
+    }
+  }
+} /* }}} void send_rate_paced */
+
+static void *sender_thread(void *arg) /* {{{ */
+{
+  tg_thread_t *t = arg;
+  lcc_value_list_t **values;
+
+  values = calloc((size_t)t->num_values, sizeof(*values));
+  if (values == NULL) {
+    fprintf(stderr, "calloc failed.\n");
+    return NULL;
+  }
+
+  for (int i = 0; i < t->num_values; i++) {
+    values[i] = create_value_list(t);
+    if (values[i] == NULL) {
+      fprintf(stderr, "create_value_list failed.\n");
+      t->num_values = i;
+      break;
+    }
+  }
+
+  if (t->num_values > 0) {
+    if (conf_rate > 0.0)
+      send_rate_paced(t, values);
+    else
+      send_interval_paced(t, values);
+  }
+
+  if ((t->con != NULL) && (lcc_wait(t->con) != 0))
+    fprintf(stderr, "Thread %i: lcc_wait failed: %s\n", t->index,
+            lcc_strerror(t->con));
+  publish_stats(t);
+
+  for (int i = 0; i < t->num_values; i++)
+    destroy_value_list(values[i]);
+  free(values);
+  free(t->submitted);
+  t->submitted = NULL;
+
+  return NULL;
+} /* }}} void *sender_thread */
+
 static int get_integer_opt(const char *str, int *ret_value) /* {{{ */
 {
   char *endptr;
@@ -284,7 +751,7 @@ static int read_options(int argc, char **argv) /* {{{ */
 {
   int opt;
 
-  while ((opt = getopt(argc, argv, "n:H:p:i:d:D:h")) != -1) {
+  while ((opt = getopt(argc, argv, "n:H:p:i:T:r:l:c:t:s:d:D:u:G:h")) != -1) {
     switch (opt) {
     case 'n':
       get_integer_opt(optarg, &conf_num_values);
@@ -302,6 +769,38 @@ static int read_options(int argc, char **argv) /* {{{ */
       get_double_opt(optarg, &conf_interval);
       break;
 
+    case 'T':
+      get_integer_opt(optarg, &conf_num_threads);
+      break;
+
+    case 'r':
+      get_double_opt(optarg, &conf_rate);
+      break;
+
+    case 'l':
+      get_double_opt(optarg, &conf_duration);
+      break;
+
+    case 'c':
+      get_double_opt(optarg, &conf_churn);
+      break;
+
+    case 't':
+      conf_types_file = optarg;
+      break;
+
+    case 's': {
+      char *endptr = NULL;
+      errno = 0;
+      conf_seed = strtoul(optarg, &endptr, /* base = */ 0);
+      if ((errno != 0) || (endptr == optarg) || (*endptr != 0)) {
+        fprintf(stderr, "Unable to parse seed: \"%s\"\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      conf_seed_set = true;
+      break;
+    }
+
     case 'd':
       conf_destination = optarg;
       break;
@@ -310,6 +809,14 @@ static int read_options(int argc, char **argv) /* {{{ */
       conf_service = optarg;
       break;
 
+    case 'u':
+      conf_socket = optarg;
+      break;
+
+    case 'G':
+      get_integer_opt(optarg, &conf_group_size);
+      break;
+
     case 'h':
       exit_usage(EXIT_SUCCESS);
 
@@ -318,109 +825,175 @@ static int read_options(int argc, char **argv) /* {{{ */
     } /* switch (opt) */
   }   /* while (getopt) */
 
+  if ((conf_num_values < 1) || (conf_num_hosts < 1) ||
+      (conf_num_plugins < 1) || (conf_num_threads < 1) ||
+      (conf_group_size < 1)) {
+    fprintf(stderr, "The number of values, hosts, plugins, threads and value "
+                    "lists per command must be positive.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (conf_num_threads > conf_num_values)
+    conf_num_threads = conf_num_values;
+
   return 0;
 } /* }}} int read_options */
 
+static int thread_connect(tg_thread_t *t) /* {{{ */
+{
+  if (conf_socket != NULL) {
+    char address[1024];
+    snprintf(address, sizeof(address), "unix:%s", conf_socket);
+
+    if (lcc_connect(address, &t->con) != 0) {
+      fprintf(stderr, "Connecting to \"%s\" failed.\n", conf_socket);
+      return -1;
+    }
+    lcc_set_putval_group_size(t->con, (size_t)conf_group_size);
+    return 0;
+  }
+
+  t->net = lcc_network_create();
+  if (t->net == NULL) {
+    fprintf(stderr, "lcc_network_create failed.\n");
+    return -1;
+  }
+
+  lcc_server_t *srv = lcc_server_create(t->net, conf_destination, conf_service);
+  if (srv == NULL) {
+    fprintf(stderr, "lcc_server_create failed.\n");
+    return -1;
+  }
+
+  lcc_server_set_ttl(srv, 42);
+#if 0
+  lcc_server_set_security_level (srv, ENCRYPT,
+      "admin", "password1");
+#endif
+  return 0;
+} /* }}} int thread_connect */
+
+static void print_summary(tg_stats_t const *s, double elapsed) /* {{{ */
+{
+  fprintf(stdout,
+          "%" PRIu64 " values sent in %.3f seconds (%.1f values/s), "
+          "%" PRIu64 " errors.\n",
+          s->sent, elapsed, (elapsed > 0.0) ? ((double)s->sent) / elapsed : 0.0,
+          s->errors);
+
+  if (s->latency_num == 0)
+    return;
+
+  fprintf(stdout,
+          "%s latency: avg %.3f us, 50%% %.3f us, 90%% %.3f us, "
+          "99%% %.3f us, 99.9%% %.3f us, max %.3f us\n",
+          (conf_socket != NULL) ? "Response" : "Submit",
+          1e6 * s->latency_sum / (double)s->latency_num,
+          1e6 * stats_percentile(s, 50.0), 1e6 * stats_percentile(s, 90.0),
+          1e6 * stats_percentile(s, 99.0), 1e6 * stats_percentile(s, 99.9),
+          1e6 * s->latency_max);
+} /* }}} void print_summary */
+
 int main(int argc, char **argv) /* {{{ */
 {
+  tg_thread_t *threads;
+  tg_stats_t total = {0};
+  uint64_t last_sent = 0;
+  double start_time;
   double last_time;
-  int values_sent = 0;
 
   read_options(argc, argv);
 
+  if ((conf_types_file != NULL) && (read_types(conf_types_file) != 0))
+    exit(EXIT_FAILURE);
+
+  if (!conf_seed_set)
+    conf_seed = (unsigned long)time(NULL);
+  fprintf(stdout, "Using seed %lu.\n", conf_seed);
+
   sigint_action.sa_handler = signal_handler;
   sigaction(SIGINT, &sigint_action, /* old = */ NULL);
 
   sigterm_action.sa_handler = signal_handler;
   sigaction(SIGTERM, &sigterm_action, /* old = */ NULL);
 
-  values_heap = c_heap_create(compare_time);
-  if (values_heap == NULL) {
-    fprintf(stderr, "c_heap_create failed.\n");
+  threads = calloc((size_t)conf_num_threads, sizeof(*threads));
+  if (threads == NULL) {
+    fprintf(stderr, "calloc failed.\n");
     exit(EXIT_FAILURE);
   }
 
-  net = lcc_network_create();
-  if (net == NULL) {
-    fprintf(stderr, "lcc_network_create failed.\n");
-    exit(EXIT_FAILURE);
-  } else {
-    lcc_server_t *srv;
-
-    srv = lcc_server_create(net, conf_destination, conf_service);
-    if (srv == NULL) {
-      fprintf(stderr, "lcc_server_create failed.\n");
+  for (int i = 0; i < conf_num_threads; i++) {
+    tg_thread_t *t = threads + i;
+
+    t->index = i;
+    t->num_values = conf_num_values / conf_num_threads +
+                    ((i < conf_num_values % conf_num_threads) ? 1 : 0);
+    /* xorshift must not be seeded with zero. */
+    t->random_state =
+        (((uint64_t)conf_seed + 1) * UINT64_C(0x9E3779B97F4A7C15)) ^
+        ((uint64_t)i + 1);
+    if (t->random_state == 0)
+      t->random_state = 1;
+    pthread_mutex_init(&t->lock, /* attr = */ NULL);
+
+    if (thread_connect(t) != 0)
       exit(EXIT_FAILURE);
-    }
-
-    lcc_server_set_ttl(srv, 42);
-#if 0
-    lcc_server_set_security_level (srv, ENCRYPT,
-        "admin", "password1");
-#endif
   }
 
-  fprintf(stdout, "Creating %i values ... ", conf_num_values);
+  fprintf(stdout, "Sending %i value lists from %i thread(s).\n",
+          conf_num_values, conf_num_threads);
   fflush(stdout);
-  for (int i = 0; i < conf_num_values; i++) {
-    lcc_value_list_t *vl;
 
-    vl = create_value_list();
-    if (vl == NULL) {
-      fprintf(stderr, "create_value_list failed.\n");
+  start_time = last_time = dtime();
+  for (int i = 0; i < conf_num_threads; i++) {
+    int status = pthread_create(&threads[i].thread, /* attr = */ NULL,
+                                sender_thread, threads + i);
+    if (status != 0) {
+      fprintf(stderr, "pthread_create failed: %s\n", strerror(status));
       exit(EXIT_FAILURE);
     }
-
-    c_heap_insert(values_heap, vl);
   }
-  fprintf(stdout, "done\n");
 
-  last_time = 0;
   while (loop) {
-    lcc_value_list_t *vl = c_heap_get_root(values_heap);
-
-    if (vl == NULL)
-      break;
-
-    if (vl->time != last_time) {
-      printf("%i values have been sent.\n", values_sent);
+    sleep_until(last_time + 1.0);
 
-      /* Check if we need to sleep */
-      double now = dtime();
+    double now = dtime();
+    if ((conf_duration > 0.0) && (now - start_time >= conf_duration))
+      loop = false;
 
-      while (now < vl->time) {
-        double diff = vl->time - now;
-        struct timespec ts = {
-            .tv_sec = (time_t)diff,
-        };
-        ts.tv_nsec = (long)((diff - ((double)ts.tv_sec)) * 1e9);
-
-        nanosleep(&ts, /* remaining = */ NULL);
-        now = dtime();
-
-        if (!loop)
-          break;
-      }
-      last_time = vl->time;
+    uint64_t sent = 0;
+    for (int i = 0; i < conf_num_threads; i++) {
+      pthread_mutex_lock(&threads[i].lock);
+      sent += threads[i].stats.sent;
+      pthread_mutex_unlock(&threads[i].lock);
     }
 
-    send_value(vl);
-    values_sent++;
-
-    c_heap_insert(values_heap, vl);
+    printf("%" PRIu64 " values have been sent (%.1f values/s).\n", sent,
+           ((double)(sent - last_sent)) / (now - last_time));
+    last_sent = sent;
+    last_time = now;
   }
 
   fprintf(stdout, "Shutting down.\n");
   fflush(stdout);
 
-  while (42) {
-    lcc_value_list_t *vl = c_heap_get_root(values_heap);
-    if (vl == NULL)
-      break;
-    destroy_value_list(vl);
+  for (int i = 0; i < conf_num_threads; i++) {
+    tg_thread_t *t = threads + i;
+
+    pthread_join(t->thread, /* retval = */ NULL);
+    stats_merge(&total, &t->stats);
+
+    if (t->con != NULL)
+      LCC_DESTROY(t->con);
+    if (t->net != NULL)
+      lcc_network_destroy(t->net);
+    pthread_mutex_destroy(&t->lock);
   }
-  c_heap_destroy(values_heap);
 
-  lcc_network_destroy(net);
+  print_summary(&total, dtime() - start_time);
+
+  free(threads);
+  free(types);
   exit(EXIT_SUCCESS);
 } /* }}} int main */
@@ -397,6 +397,18 @@ static int listval(lcc_connection_t *c, int argc, char **argv) {
 #undef BAIL_OUT
 } /* listval */
 
+/* Number of value lists the daemon rejected. Not on putval()'s stack, because
+ * responses may still be outstanding when it returns early. */
+static int putval_failed;
+
+static void putval_callback(int status, const char *message,
+                            void __attribute__((unused)) * user_data) {
+  if (status != 0) {
+    fprintf(stderr, "ERROR: Server error: %s\n", message);
+    putval_failed++;
+  }
+} /* putval_callback */
+
 static int putval(lcc_connection_t *c, int argc, char **argv) {
   lcc_value_list_t vl = LCC_VALUE_LIST_INIT;
 
@@ -528,7 +540,9 @@ static int putval(lcc_connection_t *c, int argc, char **argv) {
       assert(values_len >= 1);
       vl.values_len = values_len;
 
-      status = lcc_putval(c, &vl);
+      /* The value list is formatted right away, so "values" may be reused
+       * while the command is in flight. */
+      status = lcc_putval_async(c, &vl, putval_callback, NULL);
       if (status != 0) {
         fprintf(stderr, "ERROR: %s\n", lcc_strerror(c));
         return -1;
@@ -536,11 +550,17 @@ static int putval(lcc_connection_t *c, int argc, char **argv) {
     }
   }
 
+  status = lcc_wait(c);
+  if (status != 0) {
+    fprintf(stderr, "ERROR: %s\n", lcc_strerror(c));
+    return -1;
+  }
+
   if (values_len == 0) {
     fprintf(stderr, "ERROR: putval: Missing value list(s).\n");
     return -1;
   }
-  return 0;
+  return (putval_failed > 0) ? -1 : 0;
 } /* putval */
 
 int main(int argc, char **argv) {
@@ -146,6 +146,8 @@ static inline PyObject *cpy_string_to_unicode_or_bytes(const char *buf) {
 }
 
 void cpy_log_exception(const char *context);
+PyObject *cpy_build_meta_dict(meta_data_t *meta);
+PyObject *cpy_dispatch_batch(PyObject *self, PyObject *arg);
 
 /* Python object declarations. */
 
@@ -200,3 +202,33 @@ extern PyTypeObject SignedType;
 
 typedef PyLongObject Unsigned;
 extern PyTypeObject UnsignedType;
+
+/* A batch of value lists passed to batch write callbacks. It owns the arrays
+ * and the meta data of the value lists. */
+typedef struct {
+  // clang-format off
+  PyObject_HEAD /* No semicolon! */
+  value_list_t *vl;
+  // clang-format on
+  const data_set_t **ds;
+  value_t *values;
+  size_t vl_num;
+} ValuesBatch;
+extern PyTypeObject ValuesBatchType;
+/* Takes ownership of the arrays, even if it fails. */
+PyObject *ValuesBatch_New(value_list_t *vl, const data_set_t **ds,
+                          value_t *values, size_t vl_num);
+
+/* One value list of a ValuesBatch. Holds a reference to the batch. */
+typedef struct {
+  // clang-format off
+  PyObject_HEAD /* No semicolon! */
+  ValuesBatch *batch;
+  // clang-format on
+  const value_list_t *vl;
+  const data_set_t *ds;
+  const char *format;
+  Py_ssize_t shape;
+  Py_ssize_t stride;
+} ValuesView;
+extern PyTypeObject ValuesViewType;
@@ -247,6 +247,9 @@ typedef int uid_t;
 
 #ifndef GAUGE_FORMAT
 #define GAUGE_FORMAT "%.15g"
+/* Set when GAUGE_FORMAT has not been overridden, allowing formatters to use
+ * an equivalent conversion that does not go through snprintf(). */
+#define GAUGE_FORMAT_DEFAULT 1
 #endif
 
 #include "globals.h"
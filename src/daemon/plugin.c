@@ -734,19 +734,17 @@ plugin_value_list_clone(value_list_t const *vl_orig) /* {{{ */
   return vl;
 } /* }}} value_list_t *plugin_value_list_clone */
 
-static int plugin_write_enqueue(value_list_t const *vl) /* {{{ */
+static write_queue_t *plugin_write_queue_entry(value_list_t const *vl) /* {{{ */
 {
-  write_queue_t *q;
-
-  q = malloc(sizeof(*q));
+  write_queue_t *q = malloc(sizeof(*q));
   if (q == NULL)
-    return ENOMEM;
+    return NULL;
   q->next = NULL;
 
   q->vl = plugin_value_list_clone(vl);
   if (q->vl == NULL) {
     sfree(q);
-    return ENOMEM;
+    return NULL;
   }
 
   /* Store context of caller (read plugin); otherwise, it would not be
@@ -754,21 +752,39 @@ static int plugin_write_enqueue(value_list_t const *vl) /* {{{ */
    * value-list later on. */
   q->ctx = plugin_get_ctx();
 
+  return q;
+} /* }}} write_queue_t *plugin_write_queue_entry */
+
+/* Appends the chain of "num" entries from "head" to "tail" to the write
+ * queue. */
+static void plugin_write_enqueue_chain(write_queue_t *head, /* {{{ */
+                                       write_queue_t *tail, long num) {
   pthread_mutex_lock(&write_lock);
 
   if (write_queue_tail == NULL) {
-    write_queue_head = q;
-    write_queue_tail = q;
-    write_queue_length = 1;
+    write_queue_head = head;
+    write_queue_tail = tail;
+    write_queue_length = num;
   } else {
-    write_queue_tail->next = q;
-    write_queue_tail = q;
-    write_queue_length += 1;
+    write_queue_tail->next = head;
+    write_queue_tail = tail;
+    write_queue_length += num;
   }
 
-  pthread_cond_signal(&write_cond);
+  if (num > 1)
+    pthread_cond_broadcast(&write_cond);
+  else
+    pthread_cond_signal(&write_cond);
   pthread_mutex_unlock(&write_lock);
+} /* }}} void plugin_write_enqueue_chain */
+
+static int plugin_write_enqueue(value_list_t const *vl) /* {{{ */
+{
+  write_queue_t *q = plugin_write_queue_entry(vl);
+  if (q == NULL)
+    return ENOMEM;
 
+  plugin_write_enqueue_chain(q, q, 1);
   return 0;
 } /* }}} int plugin_write_enqueue */
 
@@ -2172,6 +2188,10 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
   } else
     fc_default_action(ds, vl);
 
+  /* The value list may live on the caller's stack, so its address is not a
+   * reliable identity once this function returns. */
+  uc_clear_rate_dispatched();
+
   if ((free_meta_data == true) && (vl->meta != NULL)) {
     meta_data_destroy(vl->meta);
     vl->meta = NULL;
@@ -2201,21 +2221,38 @@ static double get_drop_probability(void) /* {{{ */
   return (double)pos / (double)size;
 } /* }}} double get_drop_probability */
 
-static bool check_drop_value(void) /* {{{ */
+EXPORT long plugin_get_write_queue_length(long *limit_high, /* {{{ */
+                                          long *limit_low) {
+  long wql;
+
+  pthread_mutex_lock(&write_lock);
+  wql = write_queue_length;
+  pthread_mutex_unlock(&write_lock);
+
+  if (limit_high != NULL)
+    *limit_high = write_limit_high;
+  if (limit_low != NULL)
+    *limit_low = write_limit_low;
+
+  return wql;
+} /* }}} long plugin_get_write_queue_length */
+
+/* Returns the probability with which values are currently dropped and
+ * reports when values are being dropped. */
+static double check_drop_probability(void) /* {{{ */
 {
   static cdtime_t last_message_time;
   static pthread_mutex_t last_message_lock = PTHREAD_MUTEX_INITIALIZER;
 
   double p;
-  double q;
   int status;
 
   if (write_limit_high == 0)
-    return false;
+    return 0.0;
 
   p = get_drop_probability();
   if (p == 0.0)
-    return false;
+    return 0.0;
 
   status = pthread_mutex_trylock(&last_message_lock);
   if (status == 0) {
@@ -2231,14 +2268,23 @@ static bool check_drop_value(void) /* {{{ */
     pthread_mutex_unlock(&last_message_lock);
   }
 
+  return p;
+} /* }}} double check_drop_probability */
+
+/* Decides whether to drop a value, given the drop probability "p". */
+static bool drop_value(double p) /* {{{ */
+{
+  if (p == 0.0)
+    return false;
   if (p == 1.0)
     return true;
 
-  q = cdrand_d();
-  if (p > q)
-    return true;
-  else
-    return false;
+  return p > cdrand_d();
+} /* }}} bool drop_value */
+
+static bool check_drop_value(void) /* {{{ */
+{
+  return drop_value(check_drop_probability());
 } /* }}} bool check_drop_value */
 
 EXPORT int plugin_dispatch_values(value_list_t const *vl) {
@@ -2264,6 +2310,54 @@ EXPORT int plugin_dispatch_values(value_list_t const *vl) {
   return 0;
 }
 
+EXPORT int plugin_dispatch_values_batch(value_list_t const *vl, /* {{{ */
+                                        size_t vl_num) {
+  write_queue_t *head = NULL;
+  write_queue_t *tail = NULL;
+  long num = 0;
+  derive_t dropped = 0;
+
+  /* The write queue length is looked at once for the whole batch. */
+  double drop_probability = check_drop_probability();
+
+  for (size_t i = 0; i < vl_num; i++) {
+    if (drop_value(drop_probability)) {
+      dropped++;
+      continue;
+    }
+
+    write_queue_t *q = plugin_write_queue_entry(vl + i);
+    if (q == NULL) {
+      ERROR("plugin_dispatch_values_batch: plugin_write_queue_entry failed.");
+      while (head != NULL) {
+        q = head->next;
+        plugin_value_list_free(head->vl);
+        sfree(head);
+        head = q;
+      }
+      return ENOMEM;
+    }
+
+    if (tail == NULL)
+      head = q;
+    else
+      tail->next = q;
+    tail = q;
+    num++;
+  }
+
+  if ((dropped > 0) && record_statistics) {
+    pthread_mutex_lock(&statistics_lock);
+    stats_values_dropped += dropped;
+    pthread_mutex_unlock(&statistics_lock);
+  }
+
+  if (head != NULL)
+    plugin_write_enqueue_chain(head, tail, num);
+
+  return 0;
+} /* }}} int plugin_dispatch_values_batch */
+
 __attribute__((sentinel)) int
 plugin_dispatch_multivalue(value_list_t const *template, /* {{{ */
                            bool store_percentage, int store_type, ...) {
@@ -362,6 +362,35 @@ void plugin_log_available_writers(void);
  */
 int plugin_dispatch_values(value_list_t const *vl);
 
+/*
+ * NAME
+ *  plugin_dispatch_values_batch
+ *
+ * DESCRIPTION
+ *  Dispatches "vl_num" value lists like `plugin_dispatch_values', but checks
+ *  the write queue limits and adds them to the write queue while taking the
+ *  queue's lock once for each, instead of once per value list. Useful for
+ *  plugins receiving many value lists at once, e.g. from the network.
+ *
+ * ARGUMENTS
+ *  `vl'        Array of value lists.
+ *  `vl_num'    Number of elements in `vl'.
+ */
+int plugin_dispatch_values_batch(value_list_t const *vl, size_t vl_num);
+
+/*
+ * NAME
+ *  plugin_get_write_queue_length
+ *
+ * DESCRIPTION
+ *  Returns the number of value lists waiting in the write queue. If not
+ *  NULL, `limit_high' and `limit_low' are set to the configured
+ *  WriteQueueLimitHigh and WriteQueueLimitLow; zero means unlimited.
+ *  Plugins receiving values from other hosts can use this to apply
+ *  back-pressure before values are dropped.
+ */
+long plugin_get_write_queue_length(long *limit_high, long *limit_low);
+
 /*
  * NAME
  *  plugin_dispatch_multivalue
@@ -35,6 +35,7 @@ kstat_ctl_t *kc = NULL;
 #endif /* HAVE_LIBKSTAT */
 
 char *hostname_g = "example.com";
+int timeout_g = 2;
 
 void plugin_set_dir(const char *dir) { /* nop */
 }
@@ -121,11 +122,35 @@ DECLARE_UNREGISTER(notification)
 
 int plugin_dispatch_values(value_list_t const *vl) { return ENOTSUP; }
 
+int plugin_dispatch_values_batch(value_list_t const *vl, size_t vl_num) {
+  return ENOTSUP;
+}
+
+long plugin_get_write_queue_length(long *limit_high, long *limit_low) {
+  if (limit_high != NULL)
+    *limit_high = 0;
+  if (limit_low != NULL)
+    *limit_low = 0;
+  return 0;
+}
+
 int plugin_dispatch_notification(__attribute__((unused))
                                  const notification_t *notif) {
   return ENOTSUP;
 }
 
+int plugin_dispatch_missing(__attribute__((unused)) const value_list_t *vl) {
+  return ENOTSUP;
+}
+
+void plugin_dispatch_cache_event(__attribute__((unused))
+                                 enum cache_event_type_e event_type,
+                                 __attribute__((unused))
+                                 unsigned long callbacks_mask,
+                                 __attribute__((unused)) const char *name,
+                                 __attribute__((unused))
+                                 const value_list_t *vl) {}
+
 int plugin_notification_meta_add_string(__attribute__((unused))
                                         notification_t *n,
                                         __attribute__((unused))
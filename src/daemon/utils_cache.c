@@ -36,6 +36,14 @@
 
 #include <assert.h>
 
+/* Aggregates of one data source's history, updated by uc_update(). */
+typedef struct {
+  gauge_t sum;
+  gauge_t squares_sum;
+  size_t num; /* number of values in the history which are not NaN. */
+  gauge_t ewma;
+} uc_history_sum_t;
+
 typedef struct cache_entry_s {
   char name[6 * DATA_MAX_NAME_LEN];
   size_t values_num;
@@ -53,18 +61,23 @@ typedef struct cache_entry_s {
   int state;
   int hits;
 
-  /*
+  /* The history of each data source is stored contiguously, so that it can
+   * be scanned without striding:
+   *
    * +-----+-----+-----+-----+-----+-----+-----+-----+-----+----
-   * !  0  !  1  !  2  !  3  !  4  !  5  !  6  !  7  !  8  ! ...
+   * !  0  !  1  !  2  ! ... !  n  ! n+1 ! n+2 ! ... ! 2n  ! ...
    * +-----+-----+-----+-----+-----+-----+-----+-----+-----+----
-   * ! ds0 ! ds1 ! ds2 ! ds0 ! ds1 ! ds2 ! ds0 ! ds1 ! ds2 ! ...
+   * ! t=0 ! t=1 ! t=2 ! ... ! t=0 ! t=1 ! t=2 ! ... ! t=0 ! ...
    * +-----+-----+-----+-----+-----+-----+-----+-----+-----+----
-   * !      t = 0      !      t = 1      !      t = 2      ! ...
-   * +-----------------+-----------------+-----------------+----
+   * !          ds0          !          ds1          ! ds2 ! ...
+   * +-----------------------+-----------------------+-----+----
    */
   gauge_t *history;
+  cdtime_t *history_time;
   size_t history_index; /* points to the next position to write to. */
   size_t history_length;
+  /* Running aggregates of the history, one per data source. */
+  uc_history_sum_t *history_sum;
 
   meta_data_t *meta;
   unsigned long callbacks_mask;
@@ -77,9 +90,23 @@ struct uc_iter_s {
   cache_entry_t *entry;
 };
 
+/* Rates computed by the last uc_update() call of a thread. Write callbacks
+ * are called by the dispatching thread right after the cache has been
+ * updated, so they can use these instead of looking the rates up again. */
+typedef struct {
+  value_list_t const *vl;
+  cdtime_t time;
+  gauge_t *values;
+  size_t values_num;
+  size_t values_size;
+} uc_last_rate_t;
+
 static c_avl_tree_t *cache_tree;
 static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
+static pthread_key_t last_rate_key;
+static pthread_once_t last_rate_once = PTHREAD_ONCE_INIT;
+
 static int cache_compare(const cache_entry_t *a, const cache_entry_t *b) {
 #if COLLECT_DEBUG
   assert((a != NULL) && (b != NULL));
@@ -108,6 +135,8 @@ static cache_entry_t *cache_alloc(size_t values_num) {
   }
 
   ce->history = NULL;
+  ce->history_time = NULL;
+  ce->history_sum = NULL;
   ce->history_length = 0;
   ce->meta = NULL;
 
@@ -121,6 +150,8 @@ static void cache_free(cache_entry_t *ce) {
   sfree(ce->values_gauge);
   sfree(ce->values_raw);
   sfree(ce->history);
+  sfree(ce->history_time);
+  sfree(ce->history_sum);
   if (ce->meta != NULL) {
     meta_data_destroy(ce->meta);
     ce->meta = NULL;
@@ -128,6 +159,171 @@ static void cache_free(cache_entry_t *ce) {
   sfree(ce);
 } /* void cache_free */
 
+static void last_rate_destroy(void *arg) {
+  uc_last_rate_t *lr = arg;
+
+  if (lr == NULL)
+    return;
+
+  sfree(lr->values);
+  sfree(lr);
+} /* void last_rate_destroy */
+
+static void last_rate_init(void) {
+  pthread_key_create(&last_rate_key, last_rate_destroy);
+} /* void last_rate_init */
+
+static uc_last_rate_t *last_rate_get(void) {
+  pthread_once(&last_rate_once, last_rate_init);
+
+  uc_last_rate_t *lr = pthread_getspecific(last_rate_key);
+  if (lr != NULL)
+    return lr;
+
+  lr = calloc(1, sizeof(*lr));
+  if (lr == NULL)
+    return NULL;
+
+  if (pthread_setspecific(last_rate_key, lr) != 0) {
+    sfree(lr);
+    return NULL;
+  }
+  return lr;
+} /* uc_last_rate_t *last_rate_get */
+
+/* Remembers the rates of "ce" as the ones of "vl" for the calling thread.
+ * With "ce" being NULL, the rates are forgotten. */
+static void last_rate_set(const value_list_t *vl, cache_entry_t const *ce) {
+  uc_last_rate_t *lr = last_rate_get();
+  if (lr == NULL)
+    return;
+
+  lr->vl = NULL;
+  if (ce == NULL)
+    return;
+
+  if (lr->values_size < ce->values_num) {
+    gauge_t *tmp = realloc(lr->values, ce->values_num * sizeof(*lr->values));
+    if (tmp == NULL)
+      return;
+    lr->values = tmp;
+    lr->values_size = ce->values_num;
+  }
+
+  memcpy(lr->values, ce->values_gauge, ce->values_num * sizeof(*lr->values));
+  lr->values_num = ce->values_num;
+  lr->time = vl->time;
+  lr->vl = vl;
+} /* void last_rate_set */
+
+/* Recalculates the running aggregates of the history from scratch. Done
+ * whenever the ring wraps around, so that rounding errors don't add up. */
+static void history_sum_reset(cache_entry_t *ce) {
+  for (size_t i = 0; i < ce->values_num; i++) {
+    gauge_t const *row = ce->history + (i * ce->history_length);
+    uc_history_sum_t *hs = ce->history_sum + i;
+
+    hs->sum = 0.0;
+    hs->squares_sum = 0.0;
+    hs->num = 0;
+    for (size_t j = 0; j < ce->history_length; j++) {
+      if (isnan(row[j]))
+        continue;
+      hs->sum += row[j];
+      hs->squares_sum += row[j] * row[j];
+      hs->num++;
+    }
+  }
+} /* void history_sum_reset */
+
+/* Adds the current rates to the history, replacing the oldest values, and
+ * updates the running aggregates. */
+static void history_append(cache_entry_t *ce, cdtime_t t) {
+  assert(ce->history_index < ce->history_length);
+
+  /* Smoothing factor of an EWMA with the same center of mass as a simple
+   * moving average over the whole history. */
+  gauge_t alpha = 2.0 / ((gauge_t)ce->history_length + 1.0);
+
+  for (size_t i = 0; i < ce->values_num; i++) {
+    gauge_t *slot = ce->history + (i * ce->history_length) + ce->history_index;
+    uc_history_sum_t *hs = ce->history_sum + i;
+    gauge_t old = *slot;
+    gauge_t new = ce->values_gauge[i];
+
+    if (!isnan(old)) {
+      hs->sum -= old;
+      hs->squares_sum -= old * old;
+      hs->num--;
+    }
+
+    if (!isnan(new)) {
+      hs->sum += new;
+      hs->squares_sum += new * new;
+      hs->num++;
+
+      if (isnan(hs->ewma))
+        hs->ewma = new;
+      else
+        hs->ewma += alpha * (new - hs->ewma);
+    }
+
+    *slot = new;
+  }
+  ce->history_time[ce->history_index] = t;
+
+  ce->history_index = (ce->history_index + 1) % ce->history_length;
+  if (ce->history_index == 0)
+    history_sum_reset(ce);
+} /* void history_append */
+
+/* Grows the history to "num_steps" entries per data source. The existing
+ * values are kept and the new entries are the oldest ones. */
+static int history_resize(cache_entry_t *ce, size_t num_steps) {
+  size_t old_length = ce->history_length;
+
+  gauge_t *history = calloc(num_steps * ce->values_num, sizeof(*history));
+  cdtime_t *history_time = calloc(num_steps, sizeof(*history_time));
+  uc_history_sum_t *history_sum = calloc(ce->values_num, sizeof(*history_sum));
+  if ((history == NULL) || (history_time == NULL) || (history_sum == NULL)) {
+    sfree(history);
+    sfree(history_time);
+    sfree(history_sum);
+    return ENOMEM;
+  }
+
+  /* Copy the existing values from oldest to newest to the end of the new
+   * buffer, so that the next position to write to is the beginning. */
+  size_t offset = num_steps - old_length;
+  for (size_t i = 0; i < ce->values_num; i++) {
+    gauge_t *dst = history + (i * num_steps);
+    for (size_t j = 0; j < offset; j++)
+      dst[j] = NAN;
+    for (size_t j = 0; j < old_length; j++) {
+      size_t src_index = (ce->history_index + j) % old_length;
+      dst[offset + j] = ce->history[(i * old_length) + src_index];
+    }
+
+    history_sum[i].ewma =
+        (ce->history_sum != NULL) ? ce->history_sum[i].ewma : NAN;
+  }
+  for (size_t j = 0; j < old_length; j++)
+    history_time[offset + j] =
+        ce->history_time[(ce->history_index + j) % old_length];
+
+  sfree(ce->history);
+  sfree(ce->history_time);
+  sfree(ce->history_sum);
+  ce->history = history;
+  ce->history_time = history_time;
+  ce->history_sum = history_sum;
+  ce->history_index = 0;
+  ce->history_length = num_steps;
+
+  history_sum_reset(ce);
+  return 0;
+} /* int history_resize */
+
 static void uc_check_range(const data_set_t *ds, cache_entry_t *ce) {
   for (size_t i = 0; i < ds->ds_num; i++) {
     if (isnan(ce->values_gauge[i]))
@@ -211,6 +407,8 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
     return -1;
   }
 
+  last_rate_set(vl, ce);
+
   DEBUG("uc_insert: Added %s to the cache.", key);
   return 0;
 } /* int uc_insert */
@@ -324,6 +522,9 @@ int uc_check_timeout(void) {
 int uc_update(const data_set_t *ds, const value_list_t *vl) {
   char name[6 * DATA_MAX_NAME_LEN];
 
+  /* Forget the rates of the previous update in case this one fails. */
+  last_rate_set(vl, NULL);
+
   if (FORMAT_VL(name, sizeof(name), vl) != 0) {
     ERROR("uc_update: FORMAT_VL failed.");
     return -1;
@@ -397,16 +598,8 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
   } /* for (i) */
 
   /* Update the history if it exists. */
-  if (ce->history != NULL) {
-    assert(ce->history_index < ce->history_length);
-    for (size_t i = 0; i < ce->values_num; i++) {
-      size_t hist_idx = (ce->values_num * ce->history_index) + i;
-      ce->history[hist_idx] = ce->values_gauge[i];
-    }
-
-    assert(ce->history_length > 0);
-    ce->history_index = (ce->history_index + 1) % ce->history_length;
-  }
+  if (ce->history != NULL)
+    history_append(ce, vl->time);
 
   /* Prune invalid gauge data */
   uc_check_range(ds, ce);
@@ -415,6 +608,8 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
   ce->last_update = cdtime();
   ce->interval = vl->interval;
 
+  last_rate_set(vl, ce);
+
   /* Check if cache entry has registered callbacks */
   unsigned long callbacks_mask = ce->callbacks_mask;
 
@@ -512,6 +707,26 @@ gauge_t *uc_get_rate(const data_set_t *ds, const value_list_t *vl) {
   return ret;
 } /* gauge_t *uc_get_rate */
 
+int uc_get_rate_dispatched(const value_list_t *vl, gauge_t *ret_values,
+                           size_t values_num) {
+  if ((vl == NULL) || (ret_values == NULL))
+    return EINVAL;
+
+  uc_last_rate_t *lr = last_rate_get();
+  if ((lr == NULL) || (lr->vl != vl) || (lr->time != vl->time) ||
+      (lr->values_num != values_num))
+    return ENOENT;
+
+  memcpy(ret_values, lr->values, values_num * sizeof(*ret_values));
+  return 0;
+} /* int uc_get_rate_dispatched */
+
+void uc_clear_rate_dispatched(void) {
+  uc_last_rate_t *lr = last_rate_get();
+  if (lr != NULL)
+    lr->vl = NULL;
+} /* void uc_clear_rate_dispatched */
+
 int uc_get_value_by_name(const char *name, value_t **ret_values,
                          size_t *ret_values_num) {
   value_t *ret = NULL;
@@ -736,38 +951,24 @@ int uc_get_history_by_name(const char *name, gauge_t *ret_history,
   /* Check if there are enough values available. If not, increase the buffer
    * size. */
   if (ce->history_length < num_steps) {
-    gauge_t *tmp;
-
-    tmp =
-        realloc(ce->history, sizeof(*ce->history) * num_steps * ce->values_num);
-    if (tmp == NULL) {
+    if (history_resize(ce, num_steps) != 0) {
       pthread_mutex_unlock(&cache_lock);
       return -ENOMEM;
     }
+  }
 
-    for (size_t i = ce->history_length * ce->values_num;
-         i < (num_steps * ce->values_num); i++)
-      tmp[i] = NAN;
-
-    ce->history = tmp;
-    ce->history_length = num_steps;
-  } /* if (ce->history_length < num_steps) */
-
-  /* Copy the values to the output buffer. */
+  /* Copy the values to the output buffer, newest first. */
   for (size_t i = 0; i < num_steps; i++) {
     size_t src_index;
-    size_t dst_index;
 
     if (i < ce->history_index)
       src_index = ce->history_index - (i + 1);
     else
       src_index = ce->history_length + ce->history_index - (i + 1);
-    src_index = src_index * num_ds;
 
-    dst_index = i * num_ds;
-
-    memcpy(ret_history + dst_index, ce->history + src_index,
-           sizeof(*ret_history) * num_ds);
+    for (size_t j = 0; j < num_ds; j++)
+      ret_history[(i * num_ds) + j] =
+          ce->history[(j * ce->history_length) + src_index];
   }
 
   pthread_mutex_unlock(&cache_lock);
@@ -775,6 +976,124 @@ int uc_get_history_by_name(const char *name, gauge_t *ret_history,
   return 0;
 } /* int uc_get_history_by_name */
 
+/* Calculates the statistics of the newest "num_steps" values of one data
+ * source by scanning the history. Used if fewer steps than the length of the
+ * history are requested, so the running aggregates cannot be used. */
+static void history_stats_scan(cache_entry_t const *ce, size_t ds_index,
+                               size_t num_steps, uc_history_stats_t *ret) {
+  gauge_t const *row = ce->history + (ds_index * ce->history_length);
+  gauge_t sum = 0.0;
+  gauge_t squares_sum = 0.0;
+
+  ret->num = 0;
+  for (size_t i = 0; i < num_steps; i++) {
+    size_t idx = (ce->history_index + ce->history_length - (i + 1)) %
+                 ce->history_length;
+    if (isnan(row[idx]))
+      continue;
+    sum += row[idx];
+    squares_sum += row[idx] * row[idx];
+    ret->num++;
+  }
+
+  ret->mean = NAN;
+  ret->stddev = NAN;
+  if (ret->num > 0) {
+    gauge_t n = (gauge_t)ret->num;
+    ret->mean = sum / n;
+    ret->stddev = sqrt(fmax(0.0, (n * squares_sum) - (sum * sum))) / n;
+  }
+} /* void history_stats_scan */
+
+int uc_get_history_stats_by_name(const char *name,
+                                 uc_history_stats_t *ret_stats,
+                                 size_t num_steps, size_t num_ds) {
+  cache_entry_t *ce = NULL;
+
+  if ((ret_stats == NULL) || (num_steps < 1))
+    return EINVAL;
+
+  pthread_mutex_lock(&cache_lock);
+
+  if (c_avl_get(cache_tree, name, (void *)&ce) != 0) {
+    pthread_mutex_unlock(&cache_lock);
+    return ENOENT;
+  }
+
+  if (ce->values_num != num_ds) {
+    pthread_mutex_unlock(&cache_lock);
+    return EINVAL;
+  }
+
+  /* Start keeping a history of this length. Statistics become meaningful as
+   * new values are added. */
+  if (ce->history_length < num_steps) {
+    if (history_resize(ce, num_steps) != 0) {
+      pthread_mutex_unlock(&cache_lock);
+      return ENOMEM;
+    }
+  }
+
+  size_t newest = (ce->history_index + ce->history_length - 1) %
+                  ce->history_length;
+  size_t oldest = (ce->history_index + ce->history_length - num_steps) %
+                  ce->history_length;
+  cdtime_t newest_time = ce->history_time[newest];
+  cdtime_t oldest_time = ce->history_time[oldest];
+
+  for (size_t i = 0; i < num_ds; i++) {
+    uc_history_stats_t *ret = ret_stats + i;
+    gauge_t const *row = ce->history + (i * ce->history_length);
+    uc_history_sum_t const *hs = ce->history_sum + i;
+
+    if (num_steps == ce->history_length) {
+      ret->num = hs->num;
+      ret->mean = NAN;
+      ret->stddev = NAN;
+      if (hs->num > 0) {
+        gauge_t n = (gauge_t)hs->num;
+        ret->mean = hs->sum / n;
+        ret->stddev =
+            sqrt(fmax(0.0, (n * hs->squares_sum) - (hs->sum * hs->sum))) / n;
+      }
+    } else {
+      history_stats_scan(ce, i, num_steps, ret);
+    }
+
+    /* fmin() and fmax() ignore NaN arguments, which mark missing values. */
+    gauge_t min = NAN;
+    gauge_t max = NAN;
+    if (oldest < ce->history_index) {
+      for (size_t j = oldest; j < ce->history_index; j++) {
+        min = fmin(min, row[j]);
+        max = fmax(max, row[j]);
+      }
+    } else {
+      for (size_t j = oldest; j < ce->history_length; j++) {
+        min = fmin(min, row[j]);
+        max = fmax(max, row[j]);
+      }
+      for (size_t j = 0; j < ce->history_index; j++) {
+        min = fmin(min, row[j]);
+        max = fmax(max, row[j]);
+      }
+    }
+    ret->min = min;
+    ret->max = max;
+
+    ret->rate_of_change = NAN;
+    if ((oldest_time != 0) && (newest_time > oldest_time))
+      ret->rate_of_change = (row[newest] - row[oldest]) /
+                            CDTIME_T_TO_DOUBLE(newest_time - oldest_time);
+
+    ret->ewma = hs->ewma;
+  }
+
+  pthread_mutex_unlock(&cache_lock);
+
+  return 0;
+} /* int uc_get_history_stats_by_name */
+
 int uc_get_hits(const value_list_t *vl) {
   char name[6 * DATA_MAX_NAME_LEN];
   cache_entry_t *ce = NULL;
@@ -855,6 +1174,7 @@ uc_iter_t *uc_get_iterator(void) {
 
   iter->iter = c_avl_get_iterator(cache_tree);
   if (iter->iter == NULL) {
+    pthread_mutex_unlock(&cache_lock);
     free(iter);
     return NULL;
   }
@@ -887,6 +1207,15 @@ int uc_iterator_next(uc_iter_t *iter, char **ret_name) {
   return 0;
 } /* int uc_iterator_next */
 
+int uc_iterator_seek(uc_iter_t *iter, const char *name) {
+  if ((iter == NULL) || (name == NULL))
+    return -1;
+
+  iter->name = NULL;
+  iter->entry = NULL;
+  return c_avl_iterator_seek(iter->iter, name);
+} /* int uc_iterator_seek */
+
 void uc_iterator_destroy(uc_iter_t *iter) {
   if (iter == NULL)
     return;
@@ -922,6 +1251,23 @@ int uc_iterator_get_values(uc_iter_t *iter, value_t **ret_values,
   return 0;
 } /* int uc_iterator_get_values */
 
+int uc_iterator_get_rates(uc_iter_t *iter, gauge_t **ret_values,
+                          size_t *ret_num) {
+  if ((iter == NULL) || (iter->entry == NULL) || (ret_values == NULL) ||
+      (ret_num == NULL))
+    return -1;
+  *ret_values =
+      calloc(iter->entry->values_num, sizeof(*iter->entry->values_gauge));
+  if (*ret_values == NULL)
+    return -1;
+  for (size_t i = 0; i < iter->entry->values_num; ++i)
+    (*ret_values)[i] = iter->entry->values_gauge[i];
+
+  *ret_num = iter->entry->values_num;
+
+  return 0;
+} /* int uc_iterator_get_rates */
+
 int uc_iterator_get_interval(uc_iter_t *iter, cdtime_t *ret_interval) {
   if ((iter == NULL) || (iter->entry == NULL) || (ret_interval == NULL))
     return -1;
@@ -939,6 +1285,53 @@ int uc_iterator_get_meta(uc_iter_t *iter, meta_data_t **ret_meta) {
   return 0;
 } /* int uc_iterator_get_meta */
 
+int uc_iterate(char const *prefix, size_t batch_size, /* {{{ */
+               uc_iterate_callback_t callback, void *user_data) {
+  char position[6 * DATA_MAX_NAME_LEN];
+  bool skip_position = false;
+
+  if (prefix == NULL)
+    prefix = "";
+  size_t prefix_len = strlen(prefix);
+  sstrncpy(position, prefix, sizeof(position));
+
+  while (42) {
+    uc_iter_t *iter = uc_get_iterator();
+    if (iter == NULL)
+      return ENOMEM;
+    uc_iterator_seek(iter, position);
+
+    size_t visited = 0;
+    bool done = true;
+    int status = 0;
+    char *name;
+
+    while (uc_iterator_next(iter, &name) == 0) {
+      /* The entry at "position" has been visited by the previous batch. */
+      if (skip_position && (strcmp(name, position) == 0))
+        continue;
+      if (strncmp(name, prefix, prefix_len) != 0)
+        break;
+
+      status = (*callback)(iter, name, user_data);
+      if (status != 0)
+        break;
+
+      visited++;
+      if ((batch_size > 0) && (visited >= batch_size)) {
+        sstrncpy(position, name, sizeof(position));
+        skip_position = true;
+        done = false;
+        break;
+      }
+    }
+
+    uc_iterator_destroy(iter);
+    if ((status != 0) || done)
+      return status;
+  }
+} /* }}} int uc_iterate */
+
 /*
  * Meta data interface
  */
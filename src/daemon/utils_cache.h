@@ -43,6 +43,19 @@ int uc_update(const data_set_t *ds, const value_list_t *vl);
 int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
                         size_t *ret_values_num);
 gauge_t *uc_get_rate(const data_set_t *ds, const value_list_t *vl);
+
+/* uc_get_rate_dispatched copies the rates computed by the last uc_update()
+ * call of the calling thread to "ret_values", provided that call was for
+ * "vl". Write callbacks are called by the dispatching thread right after the
+ * cache has been updated, so they can use this to get the rates without
+ * another cache lookup. Returns ENOENT if the rates are not available; use
+ * uc_get_rate() in that case. */
+int uc_get_rate_dispatched(const value_list_t *vl, gauge_t *ret_values,
+                           size_t values_num);
+/* uc_clear_rate_dispatched forgets the rates of the last uc_update() call.
+ * Must be called once the value list has been handed to all write callbacks,
+ * because its memory, and thus its address, may be reused afterwards. */
+void uc_clear_rate_dispatched(void);
 int uc_get_value_by_name(const char *name, value_t **ret_values,
                          size_t *ret_values_num);
 value_t *uc_get_value(const data_set_t *ds, const value_list_t *vl);
@@ -61,6 +74,45 @@ int uc_set_callbacks_mask(const char *name, unsigned long callbacks_mask);
 int uc_get_history_by_name(const char *name, gauge_t *ret_history,
                            size_t num_steps, size_t num_ds);
 
+/* Statistics of the history of one data source. */
+typedef struct {
+  size_t num; /* number of values which are not NaN. */
+  gauge_t mean;
+  gauge_t min;
+  gauge_t max;
+  gauge_t stddev;
+  /* Change per second between the oldest and newest value. */
+  gauge_t rate_of_change;
+  /* Exponentially weighted moving average with a smoothing factor of
+   * 2 / (history length + 1). Not limited to "num_steps". */
+  gauge_t ewma;
+} uc_history_stats_t;
+
+/*
+ * NAME
+ *   uc_get_history_stats_by_name
+ *
+ * DESCRIPTION
+ *   Calculates statistics over the newest "num_steps" values of each data
+ *   source. Like uc_get_history_by_name(), this starts keeping a history of
+ *   "num_steps" values if necessary. The mean and standard deviation are
+ *   maintained by uc_update() if "num_steps" is the length of the history,
+ *   so repeated calls with the same length don't need to scan the history.
+ *
+ * PARAMETERS
+ *   `name'      Identifier of the value list.
+ *   `ret_stats' Array of "num_ds" elements receiving the statistics.
+ *   `num_steps' Number of values to consider.
+ *   `num_ds'    Number of data sources of the value list.
+ *
+ * RETURN VALUE
+ *   Zero on success, ENOENT if there is no such value list and EINVAL if
+ *   "num_ds" doesn't match.
+ */
+int uc_get_history_stats_by_name(const char *name,
+                                 uc_history_stats_t *ret_stats,
+                                 size_t num_steps, size_t num_ds);
+
 /*
  * Iterator interface
  */
@@ -101,16 +153,58 @@ uc_iter_t *uc_get_iterator(void);
 int uc_iterator_next(uc_iter_t *iter, char **ret_name);
 void uc_iterator_destroy(uc_iter_t *iter);
 
+/*
+ * NAME
+ *   uc_iterator_seek
+ *
+ * DESCRIPTION
+ *   Positions the iterator so that the next call to uc_iterator_next()
+ *   returns the first entry whose name is greater than or equal to `name'.
+ *   Entries are returned in the order of their names, so this can be used to
+ *   visit all names with a given prefix, or to continue an iteration after
+ *   the cache lock has been released.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the iterator or name is NULL.
+ */
+int uc_iterator_seek(uc_iter_t *iter, const char *name);
+
 /* Return the timestamp of the value at the current position. */
 int uc_iterator_get_time(uc_iter_t *iter, cdtime_t *ret_time);
 /* Return the (raw) value at the current position. */
 int uc_iterator_get_values(uc_iter_t *iter, value_t **ret_values,
                            size_t *ret_num);
+/* Return the rates (gauges) of the value at the current position. */
+int uc_iterator_get_rates(uc_iter_t *iter, gauge_t **ret_values,
+                          size_t *ret_num);
 /* Return the interval of the value at the current position. */
 int uc_iterator_get_interval(uc_iter_t *iter, cdtime_t *ret_interval);
 /* Return the metadata for the value at the current position. */
 int uc_iterator_get_meta(uc_iter_t *iter, meta_data_t **ret_meta);
 
+/*
+ * NAME
+ *   uc_iterate
+ *
+ * DESCRIPTION
+ *   Calls `callback' for each entry whose name starts with `prefix', or for
+ *   all entries if `prefix' is NULL, in the order of their names. The cache
+ *   lock is held while `callback' runs, but is released after every
+ *   `batch_size' entries so that a walk over a large cache does not block
+ *   other threads for long. Entries added or removed while the lock is
+ *   released may or may not be visited. `callback' may use the uc_iterator_get
+ *   functions on the iterator it is passed, but must not call other cache
+ *   functions.
+ *
+ * RETURN VALUE
+ *   Zero upon success, ENOMEM if an iterator cannot be created, or the first
+ *   non-zero value returned by `callback', which stops the walk.
+ */
+typedef int (*uc_iterate_callback_t)(uc_iter_t *iter, char const *name,
+                                     void *user_data);
+int uc_iterate(char const *prefix, size_t batch_size,
+               uc_iterate_callback_t callback, void *user_data);
+
 /*
  * Meta data interface
  */
@@ -35,15 +35,42 @@ gauge_t *uc_get_rate(__attribute__((unused)) data_set_t const *ds,
   return NULL;
 }
 
+int uc_get_rate_dispatched(__attribute__((unused)) value_list_t const *vl,
+                           __attribute__((unused)) gauge_t *ret_values,
+                           __attribute__((unused)) size_t values_num) {
+  return ENOENT;
+}
+
+void uc_clear_rate_dispatched(void) { /* nop */
+}
+
 int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
                         size_t *ret_values_num) {
   return ENOTSUP;
 }
 
+int uc_get_history_stats_by_name(const char *name,
+                                 uc_history_stats_t *ret_stats,
+                                 size_t num_steps, size_t num_ds) {
+  return ENOENT;
+}
+
 int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
   return ENOTSUP;
 }
 
+int uc_iterate(char const *prefix, size_t batch_size,
+               uc_iterate_callback_t callback, void *user_data) {
+  return ENOTSUP;
+}
+
+int uc_iterator_get_time(uc_iter_t *iter, cdtime_t *ret_time) { return -1; }
+
+int uc_iterator_get_rates(uc_iter_t *iter, gauge_t **ret_values,
+                          size_t *ret_num) {
+  return -1;
+}
+
 int uc_get_value_by_name(const char *name, value_t **ret_values,
                          size_t *ret_values_num) {
   return ENOTSUP;
@@ -0,0 +1,363 @@
+/**
+ * collectd - src/daemon/utils_cache_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include "testing.h"
+#include "utils_cache.c" /* sic */
+
+static data_source_t test_ds_source[] = {
+    {"value", DS_TYPE_GAUGE, NAN, NAN},
+};
+static data_set_t test_ds = {"gauge", 1, test_ds_source};
+
+static char const *test_name = "example.com/test/gauge";
+
+static int update(cdtime_t t, gauge_t v) {
+  value_list_t vl = {
+      .values = &(value_t){.gauge = v},
+      .values_len = 1,
+      .time = t,
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "gauge",
+  };
+
+  return uc_update(&test_ds, &vl);
+}
+
+DEF_TEST(history_stats) {
+  uc_history_stats_t stats = {0};
+
+  CHECK_ZERO(uc_init());
+
+  EXPECT_EQ_INT(ENOENT, uc_get_history_stats_by_name(test_name, &stats, 4, 1));
+
+  CHECK_ZERO(update(TIME_T_TO_CDTIME_T(10), 100.0));
+
+  EXPECT_EQ_INT(EINVAL, uc_get_history_stats_by_name(test_name, &stats, 4, 2));
+  EXPECT_EQ_INT(EINVAL, uc_get_history_stats_by_name(test_name, &stats, 0, 1));
+
+  /* The first call starts keeping the history, which is still empty. */
+  CHECK_ZERO(uc_get_history_stats_by_name(test_name, &stats, 4, 1));
+  EXPECT_EQ_UINT64(0, stats.num);
+  EXPECT_EQ_DOUBLE(NAN, stats.mean);
+  EXPECT_EQ_DOUBLE(NAN, stats.min);
+  EXPECT_EQ_DOUBLE(NAN, stats.rate_of_change);
+
+  gauge_t values[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(values); i++)
+    CHECK_ZERO(update(TIME_T_TO_CDTIME_T(20 + 10 * i), values[i]));
+
+  /* The history holds the newest four values: 3, 4, 5 and 6. */
+  CHECK_ZERO(uc_get_history_stats_by_name(test_name, &stats, 4, 1));
+  EXPECT_EQ_UINT64(4, stats.num);
+  EXPECT_EQ_DOUBLE(4.5, stats.mean);
+  EXPECT_EQ_DOUBLE(3.0, stats.min);
+  EXPECT_EQ_DOUBLE(6.0, stats.max);
+  EXPECT_EQ_DOUBLE(sqrt(1.25), stats.stddev);
+  EXPECT_EQ_DOUBLE(0.1, stats.rate_of_change);
+
+  /* alpha = 2 / (4 + 1); the EWMA starts at the first value in the history. */
+  gauge_t ewma = values[0];
+  for (size_t i = 1; i < STATIC_ARRAY_SIZE(values); i++)
+    ewma += 0.4 * (values[i] - ewma);
+  EXPECT_EQ_DOUBLE(ewma, stats.ewma);
+
+  /* Fewer steps than the history length scans the newest values. */
+  CHECK_ZERO(uc_get_history_stats_by_name(test_name, &stats, 2, 1));
+  EXPECT_EQ_UINT64(2, stats.num);
+  EXPECT_EQ_DOUBLE(5.5, stats.mean);
+  EXPECT_EQ_DOUBLE(5.0, stats.min);
+  EXPECT_EQ_DOUBLE(6.0, stats.max);
+  EXPECT_EQ_DOUBLE(0.5, stats.stddev);
+  EXPECT_EQ_DOUBLE(0.1, stats.rate_of_change);
+
+  /* Missing values are ignored. */
+  CHECK_ZERO(update(TIME_T_TO_CDTIME_T(80), NAN));
+  CHECK_ZERO(uc_get_history_stats_by_name(test_name, &stats, 4, 1));
+  EXPECT_EQ_UINT64(3, stats.num);
+  EXPECT_EQ_DOUBLE(5.0, stats.mean);
+  EXPECT_EQ_DOUBLE(4.0, stats.min);
+  EXPECT_EQ_DOUBLE(6.0, stats.max);
+  EXPECT_EQ_DOUBLE(ewma, stats.ewma);
+
+  /* Growing the history keeps the existing values. */
+  CHECK_ZERO(uc_get_history_stats_by_name(test_name, &stats, 8, 1));
+  EXPECT_EQ_UINT64(3, stats.num);
+  EXPECT_EQ_DOUBLE(5.0, stats.mean);
+  EXPECT_EQ_DOUBLE(4.0, stats.min);
+  EXPECT_EQ_DOUBLE(6.0, stats.max);
+
+  return 0;
+}
+
+DEF_TEST(rate_dispatched) {
+  gauge_t rate = NAN;
+  value_list_t vl = {
+      .values = &(value_t){.gauge = 42.0},
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T(10),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+      .plugin_instance = "rate",
+      .type = "gauge",
+  };
+
+  EXPECT_EQ_INT(EINVAL, uc_get_rate_dispatched(NULL, &rate, 1));
+
+  CHECK_ZERO(uc_update(&test_ds, &vl));
+  CHECK_ZERO(uc_get_rate_dispatched(&vl, &rate, 1));
+  EXPECT_EQ_DOUBLE(42.0, rate);
+
+  /* Only the value list passed to uc_update() matches. */
+  value_list_t copy = vl;
+  EXPECT_EQ_INT(ENOENT, uc_get_rate_dispatched(&copy, &rate, 1));
+  EXPECT_EQ_INT(ENOENT, uc_get_rate_dispatched(&vl, &rate, 2));
+
+  /* A value list that was re-used for a later update does not match either,
+   * unless the cache was updated with it. */
+  vl.time = TIME_T_TO_CDTIME_T(20);
+  EXPECT_EQ_INT(ENOENT, uc_get_rate_dispatched(&vl, &rate, 1));
+
+  vl.values = &(value_t){.gauge = 23.0};
+  CHECK_ZERO(uc_update(&test_ds, &vl));
+  CHECK_ZERO(uc_get_rate_dispatched(&vl, &rate, 1));
+  EXPECT_EQ_DOUBLE(23.0, rate);
+
+  /* After clearing, a value list at the same address with the same time,
+   * e.g. on the stack of the next dispatch, does not match. */
+  uc_clear_rate_dispatched();
+  EXPECT_EQ_INT(ENOENT, uc_get_rate_dispatched(&vl, &rate, 1));
+
+  /* A failed update does not leave the previous rates behind. */
+  vl.time = TIME_T_TO_CDTIME_T(30);
+  CHECK_ZERO(uc_update(&test_ds, &vl));
+  OK(uc_update(&test_ds, &vl) != 0);
+  EXPECT_EQ_INT(ENOENT, uc_get_rate_dispatched(&vl, &rate, 1));
+
+  return 0;
+}
+
+static int update_iterate(char const *plugin_instance, cdtime_t t) {
+  value_list_t vl = {
+      .values = &(value_t){.gauge = 1.0},
+      .values_len = 1,
+      .time = t,
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "iterate",
+      .type = "gauge",
+  };
+  sstrncpy(vl.plugin_instance, plugin_instance, sizeof(vl.plugin_instance));
+
+  return uc_update(&test_ds, &vl);
+}
+
+#define ITERATE_PREFIX "example.com/iterate-"
+#define ITERATE_MAX 64
+
+typedef struct {
+  char names[ITERATE_MAX][6 * DATA_MAX_NAME_LEN];
+  size_t num;
+  /* The callback returns non-zero when visiting the entry with this number. */
+  size_t stop_at;
+  /* Called with the cache lock held after the last entry of each batch. */
+  size_t batch_size;
+  int (*between_batches)(size_t batch);
+} iterate_result_t;
+
+static int iterate_callback(__attribute__((unused)) uc_iter_t *iter,
+                            char const *name, void *user_data) {
+  iterate_result_t *r = user_data;
+
+  if (r->num >= ITERATE_MAX)
+    return ENOMEM;
+  sstrncpy(r->names[r->num], name, sizeof(r->names[r->num]));
+  r->num++;
+
+  if (r->num == r->stop_at)
+    return 42;
+
+  /* uc_iterate() does not use the iterator after the last entry of a batch,
+   * so the cache may be modified here, except for the current entry. */
+  if ((r->between_batches != NULL) && ((r->num % r->batch_size) == 0))
+    return r->between_batches(r->num / r->batch_size);
+  return 0;
+}
+
+DEF_TEST(iterator_seek) {
+  cdtime_t t = TIME_T_TO_CDTIME_T(1000);
+  CHECK_ZERO(update_iterate("a", t));
+  CHECK_ZERO(update_iterate("c", t));
+  CHECK_ZERO(update_iterate("e", t));
+
+  uc_iter_t *iter = uc_get_iterator();
+  CHECK_NOT_NULL(iter);
+  char *name = NULL;
+
+  /* Seeking to a name which is not in the cache continues after it. */
+  CHECK_ZERO(uc_iterator_seek(iter, ITERATE_PREFIX "b"));
+  CHECK_ZERO(uc_iterator_next(iter, &name));
+  EXPECT_EQ_STR(ITERATE_PREFIX "c/gauge", name);
+
+  cdtime_t last_time = 0;
+  CHECK_ZERO(uc_iterator_get_time(iter, &last_time));
+  EXPECT_EQ_UINT64(t, last_time);
+
+  /* Seeking to an existing name returns it next. */
+  CHECK_ZERO(uc_iterator_seek(iter, ITERATE_PREFIX "a/gauge"));
+  CHECK_ZERO(uc_iterator_next(iter, &name));
+  EXPECT_EQ_STR(ITERATE_PREFIX "a/gauge", name);
+  CHECK_ZERO(uc_iterator_next(iter, &name));
+  EXPECT_EQ_STR(ITERATE_PREFIX "c/gauge", name);
+
+  /* There is no entry with the prefix after "e". */
+  CHECK_ZERO(uc_iterator_seek(iter, ITERATE_PREFIX "f"));
+  if (uc_iterator_next(iter, &name) == 0)
+    OK(strncmp(name, ITERATE_PREFIX, strlen(ITERATE_PREFIX)) != 0);
+
+  uc_iterator_destroy(iter);
+  return 0;
+}
+
+DEF_TEST(iterate_batches) {
+  iterate_result_t *r = calloc(1, sizeof(*r));
+  CHECK_NOT_NULL(r);
+
+  /* "a", "c" and "e" have been added by iterator_seek. */
+  char const *want[] = {
+      ITERATE_PREFIX "a/gauge",
+      ITERATE_PREFIX "c/gauge",
+      ITERATE_PREFIX "e/gauge",
+  };
+
+  size_t batch_sizes[] = {0, 1, 2, 3, 4};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(batch_sizes); i++) {
+    r->num = 0;
+    CHECK_ZERO(uc_iterate(ITERATE_PREFIX, batch_sizes[i], iterate_callback, r));
+    EXPECT_EQ_UINT64(STATIC_ARRAY_SIZE(want), r->num);
+    for (size_t j = 0; j < STATIC_ARRAY_SIZE(want); j++)
+      EXPECT_EQ_STR(want[j], r->names[j]);
+  }
+
+  /* A non-zero return value stops the walk, also in a later batch. */
+  r->num = 0;
+  r->stop_at = 2;
+  EXPECT_EQ_INT(42, uc_iterate(ITERATE_PREFIX, 1, iterate_callback, r));
+  EXPECT_EQ_UINT64(2, r->num);
+
+  /* Entries outside of the prefix are not visited. */
+  r->num = 0;
+  r->stop_at = 0;
+  CHECK_ZERO(uc_iterate(ITERATE_PREFIX "c", 1, iterate_callback, r));
+  EXPECT_EQ_UINT64(1, r->num);
+  EXPECT_EQ_STR(ITERATE_PREFIX "c/gauge", r->names[0]);
+
+  free(r);
+  return 0;
+}
+
+/* Adds or removes an entry while the cache lock is held. */
+static int modify_locked(char const *plugin_instance, bool add) {
+  char name[6 * DATA_MAX_NAME_LEN];
+  value_list_t vl = {
+      .values = &(value_t){.gauge = 1.0},
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T(1000),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "iterate",
+      .type = "gauge",
+  };
+  sstrncpy(vl.plugin_instance, plugin_instance, sizeof(vl.plugin_instance));
+  if (FORMAT_VL(name, sizeof(name), &vl) != 0)
+    return -1;
+
+  if (add)
+    return uc_insert(&test_ds, &vl, name);
+
+  char *key = NULL;
+  cache_entry_t *ce = NULL;
+  if (c_avl_remove(cache_tree, name, (void *)&key, (void *)&ce) != 0)
+    return -1;
+  sfree(key);
+  cache_free(ce);
+  return 0;
+}
+
+static int modify_between_batches(size_t batch) {
+  switch (batch) {
+  case 1: /* after "a" */
+    /* Entries after the position are visited, entries before are not. */
+    if (modify_locked("b", /* add = */ true) != 0)
+      return -1;
+    return modify_locked("0", /* add = */ true);
+  case 2: /* after "b" */
+    /* Removed entries are not visited. */
+    return modify_locked("c", /* add = */ false);
+  case 3: /* after "e" */
+    return modify_locked("d", /* add = */ true);
+  }
+  return 0;
+}
+
+DEF_TEST(iterate_modified) {
+  iterate_result_t *r = calloc(1, sizeof(*r));
+  CHECK_NOT_NULL(r);
+  r->batch_size = 1;
+  r->between_batches = modify_between_batches;
+
+  CHECK_ZERO(uc_iterate(ITERATE_PREFIX, r->batch_size, iterate_callback, r));
+
+  char const *want[] = {
+      ITERATE_PREFIX "a/gauge",
+      ITERATE_PREFIX "b/gauge",
+      ITERATE_PREFIX "e/gauge",
+  };
+  EXPECT_EQ_UINT64(STATIC_ARRAY_SIZE(want), r->num);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(want); i++)
+    EXPECT_EQ_STR(want[i], r->names[i]);
+
+  /* All modifications are visible to the next walk. */
+  r->num = 0;
+  r->between_batches = NULL;
+  CHECK_ZERO(uc_iterate(ITERATE_PREFIX, 2, iterate_callback, r));
+  EXPECT_EQ_UINT64(5, r->num);
+  EXPECT_EQ_STR(ITERATE_PREFIX "0/gauge", r->names[0]);
+  EXPECT_EQ_STR(ITERATE_PREFIX "a/gauge", r->names[1]);
+  EXPECT_EQ_STR(ITERATE_PREFIX "b/gauge", r->names[2]);
+  EXPECT_EQ_STR(ITERATE_PREFIX "d/gauge", r->names[3]);
+  EXPECT_EQ_STR(ITERATE_PREFIX "e/gauge", r->names[4]);
+
+  free(r);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(history_stats);
+  RUN_TEST(rate_dispatched);
+  RUN_TEST(iterator_seek);
+  RUN_TEST(iterate_batches);
+  RUN_TEST(iterate_modified);
+
+  END_TEST;
+}
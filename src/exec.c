@@ -34,9 +34,12 @@
 #include "plugin.h"
 #include "utils/common/common.h"
 
+#include "network.h"
 #include "utils/cmds/putnotif.h"
 #include "utils/cmds/putval.h"
 
+#include <arpa/inet.h>
+#include <fcntl.h>
 #include <grp.h>
 #include <poll.h>
 #include <pwd.h>
@@ -51,9 +54,19 @@ extern char **environ;
 
 #define PL_NORMAL 0x01
 #define PL_NOTIF_ACTION 0x02
+#define PL_BINARY 0x04
 
 #define PL_RUNNING 0x10
 
+/* Frames of the binary protocol start with the payload size as a 32 bit
+ * unsigned integer in network byte order. */
+#define EXEC_FRAME_HEADER_SIZE 4
+#define EXEC_FRAME_SIZE_MAX (1024 * 1024)
+#define EXEC_READ_BUFFER_SIZE 65536
+/* Time the children of programs using the binary protocol are given to exit
+ * on shutdown, first after SIGTERM, then after SIGKILL. */
+#define EXEC_SHUTDOWN_TIMEOUT TIME_T_TO_CDTIME_T(5)
+
 /*
  * Private data types
  */
@@ -64,9 +77,26 @@ extern char **environ;
  * The `pid' and `status' fields are thus unused if the `PL_NOTIF_ACTION' flag
  * is set.
  * The `PL_RUNNING' flag is set in `exec_read' and unset in `exec_read_one'.
+ *
+ * Programs using the binary protocol (`PL_BINARY') are not run by
+ * `exec_read_one'. Instead, `workers_num' long-lived children are started and
+ * each one is tracked in its own `exec_worker_t'. The `pid', `running' and
+ * `fd_in' members of the workers are protected by `pl_lock', too;
+ * `pl_cond' is signaled whenever a worker stops running.
  */
 struct program_list_s;
 typedef struct program_list_s program_list_t;
+
+typedef struct exec_worker_s {
+  program_list_t *pl;
+  int pid;
+  int status;
+  int fd_in;
+  bool running;
+  bool joinable;
+  pthread_t thread;
+} exec_worker_t;
+
 struct program_list_s {
   char *user;
   char *group;
@@ -75,6 +105,9 @@ struct program_list_s {
   int pid;
   int status;
   int flags;
+  exec_worker_t *workers;
+  size_t workers_num;
+  size_t workers_next;
   program_list_t *next;
 };
 
@@ -83,6 +116,17 @@ typedef struct program_list_and_notification_s {
   notification_t n;
 } program_list_and_notification_t;
 
+/* Value lists read from a binary worker are collected here and dispatched
+ * together once all complete frames of a read(2) have been parsed. */
+typedef struct exec_batch_s {
+  value_list_t *vl;
+  size_t vl_num;
+  size_t vl_size;
+  value_t *values;
+  size_t values_num;
+  size_t values_size;
+} exec_batch_t;
+
 /*
  * constants
  */
@@ -93,6 +137,7 @@ const long int MAX_GRBUF_SIZE = 65536;
  */
 static program_list_t *pl_head;
 static pthread_mutex_t pl_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pl_cond = PTHREAD_COND_INITIALIZER;
 
 /*
  * Functions
@@ -106,21 +151,110 @@ static void sigchld_handler(int __attribute__((unused)) signal) /* {{{ */
     for (pl = pl_head; pl != NULL; pl = pl->next)
       if (pl->pid == pid)
         break;
-    if (pl != NULL)
+    if (pl != NULL) {
       pl->status = status;
+      continue;
+    }
+
+    for (pl = pl_head; pl != NULL; pl = pl->next)
+      for (size_t i = 0; i < pl->workers_num; i++)
+        if (pl->workers[i].pid == pid)
+          pl->workers[i].status = status;
   } /* while (waitpid) */
 } /* void sigchld_handler }}} */
 
+static void exec_program_free(program_list_t *pl) /* {{{ */
+{
+  if (pl == NULL)
+    return;
+
+  for (int i = 0; pl->argv[i] != NULL; i++) {
+    sfree(pl->argv[i]);
+  }
+  sfree(pl->argv);
+  sfree(pl->workers);
+  sfree(pl->exec);
+  sfree(pl->user);
+  sfree(pl);
+} /* void exec_program_free }}} */
+
+static int exec_config_protocol(oconfig_item_t *ci, /* {{{ */
+                                program_list_t *pl) {
+  char *protocol = NULL;
+  int status = cf_util_get_string(ci, &protocol);
+  if (status != 0)
+    return status;
+
+  if (strcasecmp("Text", protocol) == 0)
+    pl->flags &= ~PL_BINARY;
+  else if (strcasecmp("Binary", protocol) == 0)
+    pl->flags |= PL_BINARY;
+  else {
+    ERROR("exec plugin: Unknown protocol `%s'. Valid values are \"Text\" and "
+          "\"Binary\".",
+          protocol);
+    status = -1;
+  }
+
+  sfree(protocol);
+  return status;
+} /* int exec_config_protocol }}} */
+
+/* Handles the options inside a <Exec /> or <NotificationExec /> block. */
+static int exec_config_exec_block(oconfig_item_t *ci, /* {{{ */
+                                  program_list_t *pl) {
+  int workers_num = 1;
+  int status = 0;
+
+  for (int i = 0; (i < ci->children_num) && (status == 0); i++) {
+    oconfig_item_t *child = ci->children + i;
+    if (strcasecmp("Protocol", child->key) == 0)
+      status = exec_config_protocol(child, pl);
+    else if (strcasecmp("Workers", child->key) == 0)
+      status = cf_util_get_int(child, &workers_num);
+    else {
+      ERROR("exec plugin: Unknown option `%s' in the `%s' block.", child->key,
+            ci->key);
+      status = -1;
+    }
+  }
+  if (status != 0)
+    return status;
+
+  if (workers_num < 1) {
+    ERROR("exec plugin: `Workers' must be at least one.");
+    return -1;
+  }
+
+  if ((pl->flags & PL_BINARY) == 0) {
+    if (workers_num != 1)
+      WARNING("exec plugin: The `Workers' option is only used with the binary "
+              "protocol and will be ignored for `%s'.",
+              pl->exec);
+    return 0;
+  }
+
+  pl->workers = calloc(workers_num, sizeof(*pl->workers));
+  if (pl->workers == NULL) {
+    ERROR("exec plugin: calloc failed.");
+    return -1;
+  }
+  pl->workers_num = (size_t)workers_num;
+
+  for (size_t i = 0; i < pl->workers_num; i++) {
+    pl->workers[i].pl = pl;
+    pl->workers[i].fd_in = -1;
+  }
+
+  return 0;
+} /* int exec_config_exec_block }}} */
+
 static int exec_config_exec(oconfig_item_t *ci) /* {{{ */
 {
   program_list_t *pl;
   char buffer[128];
   int i;
 
-  if (ci->children_num != 0) {
-    WARNING("exec plugin: The config option `%s' may not be a block.", ci->key);
-    return -1;
-  }
   if (ci->values_num < 2) {
     WARNING("exec plugin: The config option `%s' needs at least two "
             "arguments.",
@@ -230,6 +364,11 @@ static int exec_config_exec(oconfig_item_t *ci) /* {{{ */
     DEBUG("exec plugin: argv[%i] = %s", i, pl->argv[i]);
   }
 
+  if (exec_config_exec_block(ci, pl) != 0) {
+    exec_program_free(pl);
+    return -1;
+  }
+
   pl->next = pl_head;
   pl_head = pl;
 
@@ -567,6 +706,43 @@ static int parse_line(char *buffer) /* {{{ */
   }
 } /* int parse_line }}} */
 
+/* Reads from the child's STDERR and logs all complete lines. Incomplete lines
+ * are kept at the beginning of "buffer" and "*pbuffer" points behind them.
+ * Returns the number of bytes read, zero on EOF and -1 on error. */
+static int exec_read_stderr(int fd_err, char *buffer, /* {{{ */
+                            size_t buffer_size, char **pbuffer) {
+  char *pnl;
+
+  int len = read(fd_err, *pbuffer, buffer_size - 1 - (*pbuffer - buffer));
+  if (len <= 0)
+    return len;
+
+  (*pbuffer)[len] = '\0';
+
+  int ret = len;
+  len += *pbuffer - buffer;
+  *pbuffer = buffer;
+
+  while ((pnl = strchr(*pbuffer, '\n'))) {
+    *pnl = '\0';
+    if (*(pnl - 1) == '\r')
+      *(pnl - 1) = '\0';
+
+    ERROR("exec plugin: exec_read_one: error = %s", *pbuffer);
+
+    *pbuffer = ++pnl;
+  }
+  /* not completely read ? */
+  if (*pbuffer - buffer < len) {
+    len -= *pbuffer - buffer;
+    memmove(buffer, *pbuffer, len);
+    *pbuffer = buffer + len;
+  } else
+    *pbuffer = buffer;
+
+  return ret;
+} /* int exec_read_stderr }}} */
+
 static void *exec_read_one(void *arg) /* {{{ */
 {
   program_list_t *pl = (program_list_t *)arg;
@@ -642,10 +818,8 @@ static void *exec_read_one(void *arg) /* {{{ */
       ERROR("exec plugin: Failed to read pipe from `%s'.", pl->exec);
       break;
     } else if (fds[1].revents & (POLLIN | POLLHUP)) {
-      char *pnl;
-
-      len = read(fd_err, pbuffer_err,
-                 sizeof(buffer_err) - 1 - (pbuffer_err - buffer_err));
+      len = exec_read_stderr(fd_err, buffer_err, sizeof(buffer_err),
+                             &pbuffer_err);
 
       if (len < 0) {
         if (errno == EAGAIN || errno == EINTR)
@@ -662,28 +836,6 @@ static void *exec_read_one(void *arg) /* {{{ */
         fds[1].events = 0;
         continue;
       }
-
-      pbuffer_err[len] = '\0';
-
-      len += pbuffer_err - buffer_err;
-      pbuffer_err = buffer_err;
-
-      while ((pnl = strchr(pbuffer_err, '\n'))) {
-        *pnl = '\0';
-        if (*(pnl - 1) == '\r')
-          *(pnl - 1) = '\0';
-
-        ERROR("exec plugin: exec_read_one: error = %s", pbuffer_err);
-
-        pbuffer_err = ++pnl;
-      }
-      /* not completely read ? */
-      if (pbuffer_err - buffer_err < len) {
-        len -= pbuffer_err - buffer_err;
-        memmove(buffer_err, pbuffer_err, len);
-        pbuffer_err = buffer_err + len;
-      } else
-        pbuffer_err = buffer_err;
     } else if (fds[1].revents & (POLLERR | POLLNVAL)) {
       WARNING("exec plugin: Ignoring STDERR for program `%s'.", pl->exec);
       /* Clean up file descriptor */
@@ -717,6 +869,419 @@ static void *exec_read_one(void *arg) /* {{{ */
   return NULL;
 } /* void *exec_read_one }}} */
 
+static int exec_parse_number(char const *payload, /* {{{ */
+                             size_t payload_size, uint64_t *ret_value) {
+  uint64_t tmp;
+
+  if (payload_size != sizeof(tmp))
+    return EPROTO;
+
+  memcpy(&tmp, payload, sizeof(tmp));
+  *ret_value = ntohll(tmp);
+  return 0;
+} /* int exec_parse_number }}} */
+
+static int exec_parse_string(char const *payload, /* {{{ */
+                             size_t payload_size, char *output,
+                             size_t output_size) {
+  if ((payload_size == 0) || (payload_size > output_size) ||
+      (payload[payload_size - 1] != 0))
+    return EPROTO;
+
+  memcpy(output, payload, payload_size);
+  return 0;
+} /* int exec_parse_string }}} */
+
+/* Decodes a "values" part and appends it to the batch, using the identifier,
+ * time and interval from "vl". */
+static int exec_batch_add(exec_batch_t *b, value_list_t const *vl, /* {{{ */
+                          char const *payload, size_t payload_size) {
+  uint16_t tmp16;
+
+  if (payload_size < sizeof(tmp16))
+    return EPROTO;
+
+  memcpy(&tmp16, payload, sizeof(tmp16));
+  size_t values_num = (size_t)ntohs(tmp16);
+  if ((values_num == 0) ||
+      (payload_size !=
+       sizeof(tmp16) + values_num * (sizeof(uint8_t) + sizeof(value_t))))
+    return EPROTO;
+
+  if (b->vl_num == b->vl_size) {
+    size_t size = (b->vl_size == 0) ? 64 : 2 * b->vl_size;
+    value_list_t *tmp = realloc(b->vl, size * sizeof(*b->vl));
+    if (tmp == NULL)
+      return ENOMEM;
+    b->vl = tmp;
+    b->vl_size = size;
+  }
+
+  if (b->values_num + values_num > b->values_size) {
+    size_t size = (b->values_size == 0) ? 256 : 2 * b->values_size;
+    while (size < b->values_num + values_num)
+      size *= 2;
+    value_t *tmp = realloc(b->values, size * sizeof(*b->values));
+    if (tmp == NULL)
+      return ENOMEM;
+    b->values = tmp;
+    b->values_size = size;
+  }
+
+  uint8_t const *types = (uint8_t const *)payload + sizeof(tmp16);
+  value_t *values = b->values + b->values_num;
+  memcpy(values, types + values_num, values_num * sizeof(*values));
+
+  for (size_t i = 0; i < values_num; i++) {
+    switch (types[i]) {
+    case DS_TYPE_COUNTER:
+      values[i].counter = (counter_t)ntohll(values[i].counter);
+      break;
+    case DS_TYPE_GAUGE:
+      values[i].gauge = (gauge_t)ntohd(values[i].gauge);
+      break;
+    case DS_TYPE_DERIVE:
+      values[i].derive = (derive_t)ntohll(values[i].derive);
+      break;
+    case DS_TYPE_ABSOLUTE:
+      values[i].absolute = (absolute_t)ntohll(values[i].absolute);
+      break;
+    default:
+      return EPROTO;
+    }
+  }
+
+  /* The "values" pointers are set in exec_batch_dispatch(), because "values"
+   * may still be moved by realloc(). */
+  b->vl[b->vl_num] = *vl;
+  b->vl[b->vl_num].values = NULL;
+  b->vl[b->vl_num].values_len = values_num;
+  b->vl_num++;
+  b->values_num += values_num;
+
+  return 0;
+} /* int exec_batch_add }}} */
+
+static void exec_batch_dispatch(exec_batch_t *b) /* {{{ */
+{
+  if (b->vl_num == 0)
+    return;
+
+  value_t *values = b->values;
+  for (size_t i = 0; i < b->vl_num; i++) {
+    b->vl[i].values = values;
+    values += b->vl[i].values_len;
+  }
+
+  plugin_dispatch_values_batch(b->vl, b->vl_num);
+
+  b->vl_num = 0;
+  b->values_num = 0;
+} /* void exec_batch_dispatch }}} */
+
+/* Parses one frame of the binary protocol. The payload is a sequence of parts
+ * as used by the network plugin. Value lists are appended to "b",
+ * notifications are dispatched right away, after the value lists received
+ * before them. */
+static int exec_parse_frame(program_list_t *pl, exec_batch_t *b, /* {{{ */
+                            char const *buffer, size_t buffer_size) {
+  value_list_t vl = VALUE_LIST_INIT;
+  notification_t n = {0};
+
+  while (buffer_size > 0) {
+    uint16_t pkg_type;
+    uint16_t pkg_length;
+    uint64_t tmp = 0;
+    int status = 0;
+
+    if (buffer_size < 2 * sizeof(uint16_t))
+      return EPROTO;
+
+    memcpy(&pkg_type, buffer, sizeof(pkg_type));
+    memcpy(&pkg_length, buffer + sizeof(pkg_type), sizeof(pkg_length));
+    pkg_type = ntohs(pkg_type);
+    pkg_length = ntohs(pkg_length);
+
+    if ((pkg_length < 2 * sizeof(uint16_t)) || (pkg_length > buffer_size))
+      return EPROTO;
+
+    char const *payload = buffer + 2 * sizeof(uint16_t);
+    size_t payload_size = pkg_length - 2 * sizeof(uint16_t);
+
+    switch (pkg_type) {
+    case TYPE_VALUES:
+      status = exec_batch_add(b, &vl, payload, payload_size);
+      break;
+    case TYPE_TIME:
+      status = exec_parse_number(payload, payload_size, &tmp);
+      vl.time = n.time = TIME_T_TO_CDTIME_T(tmp);
+      break;
+    case TYPE_TIME_HR:
+      status = exec_parse_number(payload, payload_size, &tmp);
+      vl.time = n.time = (cdtime_t)tmp;
+      break;
+    case TYPE_INTERVAL:
+      status = exec_parse_number(payload, payload_size, &tmp);
+      vl.interval = TIME_T_TO_CDTIME_T(tmp);
+      break;
+    case TYPE_INTERVAL_HR:
+      status = exec_parse_number(payload, payload_size, &tmp);
+      vl.interval = (cdtime_t)tmp;
+      break;
+    case TYPE_HOST:
+      status = exec_parse_string(payload, payload_size, vl.host,
+                                 sizeof(vl.host));
+      sstrncpy(n.host, vl.host, sizeof(n.host));
+      break;
+    case TYPE_PLUGIN:
+      status = exec_parse_string(payload, payload_size, vl.plugin,
+                                 sizeof(vl.plugin));
+      sstrncpy(n.plugin, vl.plugin, sizeof(n.plugin));
+      break;
+    case TYPE_PLUGIN_INSTANCE:
+      status = exec_parse_string(payload, payload_size, vl.plugin_instance,
+                                 sizeof(vl.plugin_instance));
+      sstrncpy(n.plugin_instance, vl.plugin_instance,
+               sizeof(n.plugin_instance));
+      break;
+    case TYPE_TYPE:
+      status = exec_parse_string(payload, payload_size, vl.type,
+                                 sizeof(vl.type));
+      sstrncpy(n.type, vl.type, sizeof(n.type));
+      break;
+    case TYPE_TYPE_INSTANCE:
+      status = exec_parse_string(payload, payload_size, vl.type_instance,
+                                 sizeof(vl.type_instance));
+      sstrncpy(n.type_instance, vl.type_instance, sizeof(n.type_instance));
+      break;
+    case TYPE_SEVERITY:
+      status = exec_parse_number(payload, payload_size, &tmp);
+      n.severity = (int)tmp;
+      break;
+    case TYPE_MESSAGE:
+      status = exec_parse_string(payload, payload_size, n.message,
+                                 sizeof(n.message));
+      if (status != 0)
+        break;
+      if ((n.severity != NOTIF_FAILURE) && (n.severity != NOTIF_WARNING) &&
+          (n.severity != NOTIF_OKAY))
+        WARNING("exec plugin: `%s' sent a notification with unknown "
+                "severity %i.",
+                pl->exec, n.severity);
+      else if (strlen(n.message) == 0)
+        WARNING("exec plugin: `%s' sent a notification with an empty message.",
+                pl->exec);
+      else {
+        if (n.time == 0)
+          n.time = cdtime();
+        /* Keep the order in which the child reported values and
+         * notifications. */
+        exec_batch_dispatch(b);
+        plugin_dispatch_notification(&n);
+      }
+      break;
+    default:
+      DEBUG("exec plugin: Ignoring unknown part type 0x%04" PRIx16 ".",
+            pkg_type);
+    }
+
+    if (status != 0)
+      return status;
+
+    buffer += pkg_length;
+    buffer_size -= pkg_length;
+  }
+
+  return 0;
+} /* int exec_parse_frame }}} */
+
+/* Parses all complete frames in "buffer" and returns the number of bytes
+ * consumed. "*ret_need" is set to the size of the incomplete frame at the end
+ * of the buffer, so the caller can grow its buffer if necessary. */
+static ssize_t exec_parse_frames(program_list_t *pl, /* {{{ */
+                                 exec_batch_t *b, char const *buffer,
+                                 size_t buffer_size, size_t *ret_need) {
+  size_t offset = 0;
+
+  *ret_need = 0;
+  while (buffer_size - offset >= EXEC_FRAME_HEADER_SIZE) {
+    uint32_t tmp32;
+    memcpy(&tmp32, buffer + offset, sizeof(tmp32));
+    size_t frame_size = (size_t)ntohl(tmp32);
+
+    if (frame_size > EXEC_FRAME_SIZE_MAX) {
+      ERROR("exec plugin: `%s' sent a frame of %" PRIsz " bytes, the maximum "
+            "is %d bytes.",
+            pl->exec, frame_size, EXEC_FRAME_SIZE_MAX);
+      return -1;
+    }
+
+    if (buffer_size - offset < EXEC_FRAME_HEADER_SIZE + frame_size) {
+      *ret_need = EXEC_FRAME_HEADER_SIZE + frame_size;
+      break;
+    }
+
+    int status = exec_parse_frame(
+        pl, b, buffer + offset + EXEC_FRAME_HEADER_SIZE, frame_size);
+    if (status != 0) {
+      ERROR("exec plugin: Parsing a frame sent by `%s' failed: %s", pl->exec,
+            STRERROR(status));
+      return -1;
+    }
+
+    offset += EXEC_FRAME_HEADER_SIZE + frame_size;
+  }
+
+  return (ssize_t)offset;
+} /* ssize_t exec_parse_frames }}} */
+
+static void exec_worker_stopped(exec_worker_t *w) /* {{{ */
+{
+  pthread_mutex_lock(&pl_lock);
+  w->pid = 0;
+  w->running = false;
+  pthread_cond_broadcast(&pl_cond);
+  pthread_mutex_unlock(&pl_lock);
+} /* void exec_worker_stopped }}} */
+
+/* Runs one long-lived child speaking the binary protocol. Everything the
+ * child writes to STDOUT within one read(2) is dispatched as one batch. */
+static void *exec_worker_one(void *arg) /* {{{ */
+{
+  exec_worker_t *w = arg;
+  program_list_t *pl = w->pl;
+  exec_batch_t batch = {0};
+  int fd_in = -1;
+  int fd, fd_err;
+  struct pollfd fds[2] = {{0}};
+  char buffer_err[1024];
+  char *pbuffer_err = buffer_err;
+  int status;
+
+  size_t buffer_size = EXEC_READ_BUFFER_SIZE;
+  size_t buffer_len = 0;
+  char *buffer = malloc(buffer_size);
+  if (buffer == NULL) {
+    ERROR("exec plugin: malloc failed.");
+    exec_worker_stopped(w);
+    return (void *)1;
+  }
+
+  int pid = fork_child(pl, (pl->flags & PL_NOTIF_ACTION) ? &fd_in : NULL, &fd,
+                       &fd_err);
+  if (pid < 0) {
+    sfree(buffer);
+    exec_worker_stopped(w);
+    return (void *)1;
+  }
+
+  /* Notifications are written without blocking, see exec_notification(). */
+  if (fd_in >= 0)
+    fcntl(fd_in, F_SETFL, fcntl(fd_in, F_GETFL) | O_NONBLOCK);
+
+  pthread_mutex_lock(&pl_lock);
+  w->pid = pid;
+  w->fd_in = fd_in;
+  pthread_mutex_unlock(&pl_lock);
+
+  fds[0].fd = fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = fd_err;
+  fds[1].events = POLLIN;
+
+  while (1) {
+    status = poll(fds, STATIC_ARRAY_SIZE(fds), -1);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    if (fds[0].revents & (POLLIN | POLLHUP)) {
+      ssize_t len = read(fd, buffer + buffer_len, buffer_size - buffer_len);
+      if (len < 0) {
+        if (errno == EAGAIN || errno == EINTR)
+          continue;
+        break;
+      } else if (len == 0)
+        break; /* We've reached EOF */
+      buffer_len += (size_t)len;
+
+      size_t need = 0;
+      ssize_t consumed =
+          exec_parse_frames(pl, &batch, buffer, buffer_len, &need);
+      exec_batch_dispatch(&batch);
+      if (consumed < 0) {
+        kill(pid, SIGTERM);
+        break;
+      }
+
+      buffer_len -= (size_t)consumed;
+      if (buffer_len > 0)
+        memmove(buffer, buffer + consumed, buffer_len);
+
+      if (need > buffer_size) {
+        char *tmp = realloc(buffer, need);
+        if (tmp == NULL) {
+          ERROR("exec plugin: realloc failed.");
+          kill(pid, SIGTERM);
+          break;
+        }
+        buffer = tmp;
+        buffer_size = need;
+      }
+    } else if (fds[0].revents & (POLLERR | POLLNVAL)) {
+      ERROR("exec plugin: Failed to read pipe from `%s'.", pl->exec);
+      break;
+    } else if (fds[1].revents & (POLLIN | POLLHUP)) {
+      int len = exec_read_stderr(fd_err, buffer_err, sizeof(buffer_err),
+                                 &pbuffer_err);
+      if (len < 0) {
+        if (errno == EAGAIN || errno == EINTR)
+          continue;
+        break;
+      } else if (len == 0) {
+        NOTICE("exec plugin: Program `%s' has closed STDERR.", pl->exec);
+        close(fd_err);
+        fd_err = -1;
+        fds[1].fd = -1;
+        fds[1].events = 0;
+      }
+    } else if (fds[1].revents & (POLLERR | POLLNVAL)) {
+      WARNING("exec plugin: Ignoring STDERR for program `%s'.", pl->exec);
+      if ((fds[1].revents & POLLNVAL) == 0) {
+        close(fd_err);
+        fd_err = -1;
+      }
+      fds[1].fd = -1;
+      fds[1].events = 0;
+    }
+  }
+
+  pthread_mutex_lock(&pl_lock);
+  if (w->fd_in >= 0)
+    close(w->fd_in);
+  w->fd_in = -1;
+  pthread_mutex_unlock(&pl_lock);
+
+  close(fd);
+  if (fd_err >= 0)
+    close(fd_err);
+
+  DEBUG("exec plugin: exec_worker_one: Waiting for `%s' to exit.", pl->exec);
+  if (waitpid(pid, &status, 0) > 0)
+    w->status = status;
+
+  DEBUG("exec plugin: Child %i exited with status %i.", pid, w->status);
+
+  sfree(buffer);
+  sfree(batch.vl);
+  sfree(batch.values);
+
+  exec_worker_stopped(w);
+  return (void *)0;
+} /* void *exec_worker_one }}} */
+
 static void *exec_notification_one(void *arg) /* {{{ */
 {
   program_list_t *pl = ((program_list_and_notification_t *)arg)->pl;
@@ -798,6 +1363,85 @@ static void *exec_notification_one(void *arg) /* {{{ */
   return NULL;
 } /* void *exec_notification_one }}} */
 
+static void exec_write_number(char *buffer, size_t *offset, /* {{{ */
+                              uint16_t type, uint64_t value) {
+  uint16_t pkg_type = htons(type);
+  uint16_t pkg_length = htons(2 * sizeof(uint16_t) + sizeof(value));
+  value = htonll(value);
+
+  memcpy(buffer + *offset, &pkg_type, sizeof(pkg_type));
+  memcpy(buffer + *offset + 2, &pkg_length, sizeof(pkg_length));
+  memcpy(buffer + *offset + 4, &value, sizeof(value));
+  *offset += 2 * sizeof(uint16_t) + sizeof(value);
+} /* void exec_write_number }}} */
+
+static void exec_write_string(char *buffer, size_t *offset, /* {{{ */
+                              uint16_t type, char const *str) {
+  size_t str_size = strlen(str) + 1;
+  uint16_t pkg_type = htons(type);
+  uint16_t pkg_length = htons(2 * sizeof(uint16_t) + str_size);
+
+  memcpy(buffer + *offset, &pkg_type, sizeof(pkg_type));
+  memcpy(buffer + *offset + 2, &pkg_length, sizeof(pkg_length));
+  memcpy(buffer + *offset + 4, str, str_size);
+  *offset += 2 * sizeof(uint16_t) + str_size;
+} /* void exec_write_string }}} */
+
+/* Sends the notification as one frame to the next worker whose pipe is not
+ * full. The frame is smaller than PIPE_BUF, so the write(2) is atomic and
+ * either transfers the entire frame or fails with EAGAIN. */
+static int exec_notification_binary(program_list_t *pl, /* {{{ */
+                                    notification_t const *n) {
+  char buffer[EXEC_FRAME_HEADER_SIZE + 2 * (4 + sizeof(uint64_t)) +
+              5 * (4 + DATA_MAX_NAME_LEN) + 4 + NOTIF_MAX_MSG_LEN];
+  size_t offset = EXEC_FRAME_HEADER_SIZE;
+
+  exec_write_number(buffer, &offset, TYPE_TIME_HR, (uint64_t)n->time);
+  exec_write_number(buffer, &offset, TYPE_SEVERITY, (uint64_t)n->severity);
+  if (strlen(n->host) > 0)
+    exec_write_string(buffer, &offset, TYPE_HOST, n->host);
+  if (strlen(n->plugin) > 0)
+    exec_write_string(buffer, &offset, TYPE_PLUGIN, n->plugin);
+  if (strlen(n->plugin_instance) > 0)
+    exec_write_string(buffer, &offset, TYPE_PLUGIN_INSTANCE,
+                      n->plugin_instance);
+  if (strlen(n->type) > 0)
+    exec_write_string(buffer, &offset, TYPE_TYPE, n->type);
+  if (strlen(n->type_instance) > 0)
+    exec_write_string(buffer, &offset, TYPE_TYPE_INSTANCE, n->type_instance);
+  exec_write_string(buffer, &offset, TYPE_MESSAGE, n->message);
+  assert(offset <= sizeof(buffer));
+
+  uint32_t frame_size = htonl((uint32_t)(offset - EXEC_FRAME_HEADER_SIZE));
+  memcpy(buffer, &frame_size, sizeof(frame_size));
+
+  bool sent = false;
+  pthread_mutex_lock(&pl_lock);
+  for (size_t i = 0; (i < pl->workers_num) && !sent; i++) {
+    size_t idx = (pl->workers_next + i) % pl->workers_num;
+    exec_worker_t *w = pl->workers + idx;
+    if (w->fd_in < 0)
+      continue;
+
+    ssize_t status = write(w->fd_in, buffer, offset);
+    if (status == (ssize_t)offset) {
+      pl->workers_next = idx + 1;
+      sent = true;
+    } else if ((status < 0) && (errno != EAGAIN))
+      WARNING("exec plugin: Writing to `%s' (pid %i) failed: %s", pl->exec,
+              w->pid, STRERRNO);
+  }
+  pthread_mutex_unlock(&pl_lock);
+
+  if (!sent) {
+    WARNING("exec plugin: No worker of `%s' is ready, dropping notification.",
+            pl->exec);
+    return -1;
+  }
+
+  return 0;
+} /* int exec_notification_binary }}} */
+
 static int exec_init(void) /* {{{ */
 {
   struct sigaction sa = {.sa_handler = sigchld_handler};
@@ -824,11 +1468,47 @@ static int exec_init(void) /* {{{ */
   return 0;
 } /* int exec_init }}} */
 
+/* (Re-)starts all workers of a program using the binary protocol. */
+static void exec_start_workers(program_list_t *pl) /* {{{ */
+{
+  for (size_t i = 0; i < pl->workers_num; i++) {
+    exec_worker_t *w = pl->workers + i;
+
+    pthread_mutex_lock(&pl_lock);
+    if (w->running) {
+      pthread_mutex_unlock(&pl_lock);
+      continue;
+    }
+    w->running = true;
+    pthread_mutex_unlock(&pl_lock);
+
+    /* Reap the thread of the previous child, which has exited already. */
+    if (w->joinable) {
+      pthread_join(w->thread, NULL);
+      w->joinable = false;
+    }
+
+    int status =
+        plugin_thread_create(&w->thread, exec_worker_one, w, "exec worker");
+    if (status == 0) {
+      w->joinable = true;
+    } else {
+      ERROR("exec plugin: plugin_thread_create failed.");
+      exec_worker_stopped(w);
+    }
+  } /* for (i) */
+} /* void exec_start_workers }}} */
+
 static int exec_read(void) /* {{{ */
 {
   for (program_list_t *pl = pl_head; pl != NULL; pl = pl->next) {
     pthread_t t;
 
+    if ((pl->flags & PL_BINARY) != 0) {
+      exec_start_workers(pl);
+      continue;
+    }
+
     /* Only execute `normal' style executables here. */
     if ((pl->flags & PL_NORMAL) == 0)
       continue;
@@ -865,6 +1545,11 @@ static int exec_notification(const notification_t *n, /* {{{ */
     if ((pl->flags & PL_NOTIF_ACTION) == 0)
       continue;
 
+    if ((pl->flags & PL_BINARY) != 0) {
+      exec_notification_binary(pl, n);
+      continue;
+    }
+
     /* Skip if a child is already running. */
     if (pl->pid != 0)
       continue;
@@ -895,11 +1580,54 @@ static int exec_notification(const notification_t *n, /* {{{ */
   return 0;
 } /* }}} int exec_notification */
 
+/* Sends "sig" to the children of all workers and waits up to "timeout" for
+ * the workers to stop. Returns the number of workers still running. */
+static size_t exec_stop_workers(int sig, cdtime_t timeout) /* {{{ */
+{
+  struct timespec deadline = CDTIME_T_TO_TIMESPEC(cdtime() + timeout);
+  size_t running = 0;
+
+  pthread_mutex_lock(&pl_lock);
+  for (program_list_t *pl = pl_head; pl != NULL; pl = pl->next) {
+    for (size_t i = 0; i < pl->workers_num; i++) {
+      exec_worker_t *w = pl->workers + i;
+      if (w->pid > 0) {
+        kill(w->pid, sig);
+        INFO("exec plugin: Sent %s to %hu",
+             (sig == SIGKILL) ? "SIGKILL" : "SIGTERM",
+             (unsigned short int)w->pid);
+      }
+    }
+  }
+
+  while (42) {
+    running = 0;
+    for (program_list_t *pl = pl_head; pl != NULL; pl = pl->next)
+      for (size_t i = 0; i < pl->workers_num; i++)
+        if (pl->workers[i].running)
+          running++;
+
+    if ((running == 0) ||
+        (pthread_cond_timedwait(&pl_cond, &pl_lock, &deadline) == ETIMEDOUT))
+      break;
+  }
+  pthread_mutex_unlock(&pl_lock);
+
+  return running;
+} /* size_t exec_stop_workers }}} */
+
 static int exec_shutdown(void) /* {{{ */
 {
   program_list_t *pl;
   program_list_t *next;
 
+  /* The worker threads exit once their child has terminated. Children which
+   * ignore SIGTERM are killed. */
+  if ((exec_stop_workers(SIGTERM, EXEC_SHUTDOWN_TIMEOUT) > 0) &&
+      (exec_stop_workers(SIGKILL, EXEC_SHUTDOWN_TIMEOUT) > 0))
+    ERROR("exec plugin: Some workers did not stop. Their programs are "
+          "leaked.");
+
   pl = pl_head;
   while (pl != NULL) {
     next = pl->next;
@@ -909,13 +1637,23 @@ static int exec_shutdown(void) /* {{{ */
       INFO("exec plugin: Sent SIGTERM to %hu", (unsigned short int)pl->pid);
     }
 
-    for (int i = 0; pl->argv[i] != NULL; i++) {
-      sfree(pl->argv[i]);
+    /* Workers which are still running access "pl", so it is not freed. */
+    bool running = false;
+    for (size_t i = 0; i < pl->workers_num; i++) {
+      exec_worker_t *w = pl->workers + i;
+
+      pthread_mutex_lock(&pl_lock);
+      bool w_running = w->running;
+      pthread_mutex_unlock(&pl_lock);
+
+      if (w_running)
+        running = true;
+      else if (w->joinable)
+        pthread_join(w->thread, NULL);
     }
-    sfree(pl->argv);
-    sfree(pl->exec);
-    sfree(pl->user);
-    sfree(pl);
+
+    if (!running)
+      exec_program_free(pl);
 
     pl = next;
   } /* while (pl) */
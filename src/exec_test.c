@@ -0,0 +1,265 @@
+/**
+ * collectd - src/exec_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#define plugin_dispatch_values_batch plugin_dispatch_values_batch_exec_test
+#define plugin_dispatch_notification plugin_dispatch_notification_exec_test
+
+#include "exec.c" /* sic */
+#include "testing.h"
+
+/* Records the order of dispatched value lists ('v') and notifications
+ * ('n'). */
+static char dispatched[16];
+static size_t dispatched_num;
+
+/* mock functions */
+int plugin_dispatch_values_batch_exec_test(value_list_t const *vl,
+                                           size_t vl_num) {
+  for (size_t i = 0; i < vl_num; i++)
+    if (dispatched_num < sizeof(dispatched) - 1)
+      dispatched[dispatched_num++] = 'v';
+  return 0;
+}
+
+int plugin_dispatch_notification_exec_test(notification_t const *n) {
+  if (dispatched_num < sizeof(dispatched) - 1)
+    dispatched[dispatched_num++] = 'n';
+  return 0;
+}
+/* end mock functions */
+
+static program_list_t test_pl = {.exec = "test"};
+
+static void write_part_header(char *buffer, size_t *offset, uint16_t type,
+                              uint16_t length) {
+  uint16_t tmp;
+
+  tmp = htons(type);
+  memcpy(buffer + *offset, &tmp, sizeof(tmp));
+  tmp = htons(length);
+  memcpy(buffer + *offset + 2, &tmp, sizeof(tmp));
+  *offset += 2 * sizeof(uint16_t);
+}
+
+static void write_gauge(char *buffer, size_t *offset, gauge_t value) {
+  uint16_t num = htons(1);
+
+  write_part_header(buffer, offset, TYPE_VALUES,
+                    2 * sizeof(uint16_t) + sizeof(num) + 1 + sizeof(value_t));
+  memcpy(buffer + *offset, &num, sizeof(num));
+  buffer[*offset + sizeof(num)] = DS_TYPE_GAUGE;
+  value = htond(value);
+  memcpy(buffer + *offset + sizeof(num) + 1, &value, sizeof(value));
+  *offset += sizeof(num) + 1 + sizeof(value_t);
+}
+
+/* Writes the frame header for the parts written since "start". */
+static void finish_frame(char *buffer, size_t start, size_t offset) {
+  uint32_t frame_size = htonl((uint32_t)(offset - start - 4));
+  memcpy(buffer + start, &frame_size, sizeof(frame_size));
+}
+
+/* Writes a frame with one value list to "buffer" and returns its size. */
+static size_t write_frame(char *buffer, char const *host, gauge_t value) {
+  size_t offset = EXEC_FRAME_HEADER_SIZE;
+
+  exec_write_string(buffer, &offset, TYPE_HOST, host);
+  exec_write_string(buffer, &offset, TYPE_PLUGIN, "exec");
+  exec_write_string(buffer, &offset, TYPE_TYPE, "gauge");
+  exec_write_number(buffer, &offset, TYPE_TIME_HR, TIME_T_TO_CDTIME_T(1));
+  exec_write_number(buffer, &offset, TYPE_INTERVAL_HR, TIME_T_TO_CDTIME_T(10));
+  write_gauge(buffer, &offset, value);
+  finish_frame(buffer, 0, offset);
+
+  return offset;
+}
+
+static void batch_reset(exec_batch_t *b) {
+  sfree(b->vl);
+  sfree(b->values);
+  memset(b, 0, sizeof(*b));
+}
+
+DEF_TEST(complete_frames) {
+  char buffer[1024];
+  exec_batch_t b = {0};
+  size_t need = 42;
+
+  size_t size = write_frame(buffer, "host0", 1.5);
+  size += write_frame(buffer + size, "host1", 2.5);
+
+  EXPECT_EQ_INT((int)size,
+                (int)exec_parse_frames(&test_pl, &b, buffer, size, &need));
+  EXPECT_EQ_UINT64(0, need);
+  EXPECT_EQ_UINT64(2, b.vl_num);
+  EXPECT_EQ_UINT64(2, b.values_num);
+  EXPECT_EQ_STR("host0", b.vl[0].host);
+  EXPECT_EQ_STR("host1", b.vl[1].host);
+  EXPECT_EQ_STR("gauge", b.vl[1].type);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(1), b.vl[0].time);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(10), b.vl[0].interval);
+  EXPECT_EQ_UINT64(1, b.vl[0].values_len);
+  EXPECT_EQ_DOUBLE(1.5, b.values[0].gauge);
+  EXPECT_EQ_DOUBLE(2.5, b.values[1].gauge);
+
+  batch_reset(&b);
+  return 0;
+}
+
+DEF_TEST(truncated_frames) {
+  char buffer[1024];
+  exec_batch_t b = {0};
+  size_t need;
+
+  size_t first = write_frame(buffer, "host0", 1.5);
+  size_t second = write_frame(buffer + first, "host1", 2.5);
+
+  /* Only the first frame is complete. */
+  for (size_t len = first; len < first + second; len++) {
+    EXPECT_EQ_INT((int)first,
+                  (int)exec_parse_frames(&test_pl, &b, buffer, len, &need));
+    EXPECT_EQ_UINT64((len - first < EXEC_FRAME_HEADER_SIZE) ? 0 : second,
+                     need);
+    EXPECT_EQ_UINT64(1, b.vl_num);
+    b.vl_num = 0;
+    b.values_num = 0;
+  }
+
+  /* Not even a complete header. */
+  EXPECT_EQ_INT(0, (int)exec_parse_frames(&test_pl, &b, buffer, 3, &need));
+  EXPECT_EQ_UINT64(0, need);
+  EXPECT_EQ_UINT64(0, b.vl_num);
+
+  batch_reset(&b);
+  return 0;
+}
+
+DEF_TEST(oversized_frame) {
+  char buffer[EXEC_FRAME_HEADER_SIZE] = {0};
+  exec_batch_t b = {0};
+  size_t need;
+
+  uint32_t frame_size = htonl(EXEC_FRAME_SIZE_MAX);
+  memcpy(buffer, &frame_size, sizeof(frame_size));
+  EXPECT_EQ_INT(0, (int)exec_parse_frames(&test_pl, &b, buffer, sizeof(buffer),
+                                          &need));
+  EXPECT_EQ_UINT64(EXEC_FRAME_HEADER_SIZE + EXEC_FRAME_SIZE_MAX, need);
+
+  frame_size = htonl(EXEC_FRAME_SIZE_MAX + 1);
+  memcpy(buffer, &frame_size, sizeof(frame_size));
+  EXPECT_EQ_INT(-1, (int)exec_parse_frames(&test_pl, &b, buffer,
+                                           sizeof(buffer), &need));
+
+  batch_reset(&b);
+  return 0;
+}
+
+DEF_TEST(bad_part_lengths) {
+  struct {
+    uint16_t type;
+    uint16_t length;
+    size_t payload_size;
+  } cases[] = {
+      /* Shorter than the part header. */
+      {TYPE_HOST, 0, 4},
+      {TYPE_HOST, 3, 4},
+      /* Longer than the frame. */
+      {TYPE_HOST, 12, 4},
+      /* Wrong size for the part type. */
+      {TYPE_TIME_HR, 4 + 4, 4},
+      {TYPE_VALUES, 4 + 2, 2},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    char buffer[64] = {0};
+    exec_batch_t b = {0};
+    size_t offset = EXEC_FRAME_HEADER_SIZE;
+    size_t need;
+
+    printf("## Case %" PRIsz "\n", i);
+
+    write_part_header(buffer, &offset, cases[i].type, cases[i].length);
+    offset += cases[i].payload_size;
+    finish_frame(buffer, 0, offset);
+
+    EXPECT_EQ_INT(-1,
+                  (int)exec_parse_frames(&test_pl, &b, buffer, offset, &need));
+    EXPECT_EQ_UINT64(0, b.vl_num);
+    batch_reset(&b);
+  }
+
+  /* Less than a part header left in the frame. */
+  char buffer[EXEC_FRAME_HEADER_SIZE + 2] = {0};
+  exec_batch_t b = {0};
+  size_t need;
+
+  finish_frame(buffer, 0, sizeof(buffer));
+  EXPECT_EQ_INT(-1, (int)exec_parse_frames(&test_pl, &b, buffer,
+                                           sizeof(buffer), &need));
+
+  batch_reset(&b);
+  return 0;
+}
+
+DEF_TEST(notification_order) {
+  char buffer[1024];
+  exec_batch_t b = {0};
+  size_t need;
+
+  memset(dispatched, 0, sizeof(dispatched));
+  dispatched_num = 0;
+
+  size_t offset = write_frame(buffer, "host0", 1.5);
+  offset += write_frame(buffer + offset, "host1", 2.5);
+
+  size_t start = offset;
+  offset += EXEC_FRAME_HEADER_SIZE;
+  exec_write_string(buffer, &offset, TYPE_HOST, "host2");
+  exec_write_number(buffer, &offset, TYPE_SEVERITY, NOTIF_WARNING);
+  exec_write_string(buffer, &offset, TYPE_MESSAGE, "test");
+  finish_frame(buffer, start, offset);
+
+  offset += write_frame(buffer + offset, "host3", 3.5);
+
+  /* The value lists received before the notification are dispatched first,
+   * the last one is still pending. */
+  EXPECT_EQ_INT((int)offset,
+                (int)exec_parse_frames(&test_pl, &b, buffer, offset, &need));
+  EXPECT_EQ_STR("vvn", dispatched);
+  EXPECT_EQ_UINT64(1, b.vl_num);
+  EXPECT_EQ_STR("host3", b.vl[0].host);
+
+  exec_batch_dispatch(&b);
+  EXPECT_EQ_STR("vvnv", dispatched);
+
+  batch_reset(&b);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(complete_frames);
+  RUN_TEST(truncated_frames);
+  RUN_TEST(oversized_frame);
+  RUN_TEST(bad_part_lengths);
+  RUN_TEST(notification_order);
+
+  END_TEST;
+}
@@ -27,11 +27,17 @@
  **/
 
 #include <google/protobuf/util/time_util.h>
+#include <grpc++/alarm.h>
 #include <grpc++/grpc++.h>
 
 #include <fstream>
 #include <iostream>
-#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "collectd.grpc.pb.h"
@@ -45,6 +51,7 @@ extern "C" {
 #include "utils/common/common.h"
 
 #include "daemon/utils_cache.h"
+#include "utils_complain.h"
 }
 
 using collectd::Collectd;
@@ -63,6 +70,36 @@ typedef google::protobuf::Map<grpc::string, collectd::types::MetadataValue>
  * private types
  */
 
+/* Fields of the value lists returned by QueryValues. */
+enum {
+  QUERY_FIELD_TIME = 0x01,
+  QUERY_FIELD_INTERVAL = 0x02,
+  QUERY_FIELD_VALUES = 0x04,
+  QUERY_FIELD_META_DATA = 0x08,
+  QUERY_FIELD_ALL = 0x0f,
+};
+
+/* Number of cache entries QueryValues visits while holding the cache lock.
+ * The lock is released while the matching value lists are sent. */
+static const size_t query_batch_size = 1024;
+
+/* Number of threads polling the completion queues of PutValues streams. */
+static size_t polling_threads = 2;
+
+/* Delay before reading from a PutValues stream again while the write queue
+ * is too long. */
+static const int put_values_throttle_ms = 10;
+
+/* Default number of value lists sent in one PutValuesRequest. Servers
+ * predating batching only read the first value list of a request, so
+ * batching is opt-in. */
+static const size_t default_batch_size = 1;
+
+/* Delay before reconnecting to a server after an error. The delay is
+ * doubled after each failed attempt, up to reconnect_max_delay. */
+static const cdtime_t reconnect_min_delay = TIME_T_TO_CDTIME_T_STATIC(1);
+static const cdtime_t reconnect_max_delay = TIME_T_TO_CDTIME_T_STATIC(60);
+
 struct Listener {
   grpc::string addr;
   grpc::string port;
@@ -93,6 +130,57 @@ static bool ident_matches(const value_list_t *vl, const value_list_t *matcher) {
   return true;
 } /* ident_matches */
 
+static bool is_pattern(const char *s) {
+  return strpbrk(s, "*?[\\") != NULL;
+} /* is_pattern */
+
+/* Returns the prefix all cache entries matching "matcher" share. Entries are
+ * named "host/plugin[-plugin_instance]/type[-type_instance]" and sorted by
+ * name, so matching entries are found without looking at other hosts (or
+ * plugins) if these don't contain wildcards. */
+static grpc::string ident_prefix(const value_list_t *matcher) {
+  if (is_pattern(matcher->host))
+    return "";
+
+  grpc::string prefix = grpc::string(matcher->host) + "/";
+  if (is_pattern(matcher->plugin))
+    return prefix;
+
+  prefix += matcher->plugin;
+  if (is_pattern(matcher->plugin_instance))
+    return prefix;
+
+  if (matcher->plugin_instance[0] != '\0')
+    prefix += grpc::string("-") + matcher->plugin_instance;
+  return prefix + "/";
+} /* ident_prefix */
+
+static grpc::Status
+unmarshal_fields(const google::protobuf::RepeatedPtrField<grpc::string> &msg,
+                 unsigned int *fields) {
+  if (msg.empty()) {
+    *fields = QUERY_FIELD_ALL;
+    return grpc::Status::OK;
+  }
+
+  *fields = 0;
+  for (auto f : msg) {
+    if (f == "time")
+      *fields |= QUERY_FIELD_TIME;
+    else if (f == "interval")
+      *fields |= QUERY_FIELD_INTERVAL;
+    else if (f == "values")
+      *fields |= QUERY_FIELD_VALUES;
+    else if (f == "meta_data")
+      *fields |= QUERY_FIELD_META_DATA;
+    else
+      return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          grpc::string("unknown field: ") + f);
+  }
+
+  return grpc::Status::OK;
+} /* unmarshal_fields */
+
 static grpc::string read_file(const char *filename) {
   std::ifstream f;
   grpc::string s, content;
@@ -277,29 +365,37 @@ static grpc::Status unmarshal_meta_data(const grpcMetadata &rpc_metadata,
 }
 
 static grpc::Status marshal_value_list(const value_list_t *vl,
-                                       collectd::types::ValueList *msg) {
+                                       collectd::types::ValueList *msg,
+                                       unsigned int fields = QUERY_FIELD_ALL) {
   auto id = msg->mutable_identifier();
   marshal_ident(vl, id);
 
-  auto ds = plugin_get_ds(vl->type);
-  if ((ds == NULL) || (ds->ds_num != vl->values_len)) {
-    return grpc::Status(grpc::StatusCode::INTERNAL,
-                        grpc::string("failed to retrieve data-set for values"));
+  if (fields & QUERY_FIELD_TIME) {
+    auto t = TimeUtil::NanosecondsToTimestamp(CDTIME_T_TO_NS(vl->time));
+    msg->set_allocated_time(new google::protobuf::Timestamp(t));
+  }
+  if (fields & QUERY_FIELD_INTERVAL) {
+    auto d = TimeUtil::NanosecondsToDuration(CDTIME_T_TO_NS(vl->interval));
+    msg->set_allocated_interval(new google::protobuf::Duration(d));
   }
-
-  auto t = TimeUtil::NanosecondsToTimestamp(CDTIME_T_TO_NS(vl->time));
-  auto d = TimeUtil::NanosecondsToDuration(CDTIME_T_TO_NS(vl->interval));
-  msg->set_allocated_time(new google::protobuf::Timestamp(t));
-  msg->set_allocated_interval(new google::protobuf::Duration(d));
 
   msg->clear_meta_data();
-  if (vl->meta != nullptr) {
+  if ((fields & QUERY_FIELD_META_DATA) && (vl->meta != nullptr)) {
     grpc::Status status = marshal_meta_data(vl->meta, msg->mutable_meta_data());
     if (!status.ok()) {
       return status;
     }
   }
 
+  if (!(fields & QUERY_FIELD_VALUES))
+    return grpc::Status::OK;
+
+  auto ds = plugin_get_ds(vl->type);
+  if ((ds == NULL) || (ds->ds_num != vl->values_len)) {
+    return grpc::Status(grpc::StatusCode::INTERNAL,
+                        grpc::string("failed to retrieve data-set for values"));
+  }
+
   for (size_t i = 0; i < vl->values_len; ++i) {
     auto v = msg->add_values();
     int value_type = ds->ds[i].type;
@@ -393,6 +489,69 @@ static grpc::Status unmarshal_value_list(const collectd::types::ValueList &msg,
   return status;
 } /* unmarshal_value_list() */
 
+/*
+ * PutValues helpers
+ */
+/* Unmarshals all value lists of "req" and dispatches them as one batch.
+ * Returns the number of value lists in "num". */
+static grpc::Status dispatch_put_values(PutValuesRequest const &req,
+                                        uint64_t *num) {
+  std::vector<value_list_t> vls;
+  vls.reserve(req.value_lists_size() + 1);
+
+  grpc::Status status = grpc::Status::OK;
+  if (req.has_value_list()) {
+    value_list_t vl = {};
+    status = unmarshal_value_list(req.value_list(), &vl);
+    if (status.ok())
+      vls.push_back(vl);
+  }
+
+  for (int i = 0; status.ok() && (i < req.value_lists_size()); i++) {
+    value_list_t vl = {};
+    status = unmarshal_value_list(req.value_lists(i), &vl);
+    if (status.ok())
+      vls.push_back(vl);
+  }
+
+  if (status.ok() && !vls.empty() &&
+      (plugin_dispatch_values_batch(vls.data(), vls.size()) != 0))
+    status = grpc::Status(grpc::StatusCode::INTERNAL,
+                          grpc::string("failed to enqueue values for writing"));
+
+  for (auto &vl : vls) {
+    sfree(vl.values);
+    meta_data_destroy(vl.meta);
+  }
+
+  *num = (uint64_t)vls.size();
+  return status;
+} /* dispatch_put_values */
+
+/* Set while reading from PutValues streams is paused. */
+static std::atomic<bool> put_values_throttle(false);
+
+/* Returns true if received values should not be read from the network.
+ * Reading is paused once the write queue reaches WriteQueueLimitHigh and
+ * resumed once it has drained below WriteQueueLimitLow. */
+static bool put_values_throttled(void) {
+  long limit_high = 0;
+  long limit_low = 0;
+  long wql = plugin_get_write_queue_length(&limit_high, &limit_low);
+
+  if (limit_high <= 0) {
+    put_values_throttle = false;
+    return false;
+  }
+
+  if (wql >= limit_high)
+    put_values_throttle = true;
+  else if (wql < limit_low)
+    put_values_throttle = false;
+
+  return put_values_throttle;
+} /* put_values_throttled */
+
 /*
  * Collectd service
  */
@@ -407,120 +566,304 @@ public:
       return status;
     }
 
-    std::queue<value_list_t> value_lists;
-    status = this->queryValuesRead(&match, &value_lists);
-    if (status.ok()) {
-      status = this->queryValuesWrite(ctx, writer, &value_lists);
-    }
-
-    while (!value_lists.empty()) {
-      auto vl = value_lists.front();
-      value_lists.pop();
-      sfree(vl.values);
-      meta_data_destroy(vl.meta);
+    unsigned int fields = 0;
+    status = unmarshal_fields(req->fields(), &fields);
+    if (!status.ok()) {
+      return status;
     }
 
-    return status;
-  }
+    /* The cache is read in batches, holding the cache lock only while
+     * copying the matching value lists of one batch. "position" is the name
+     * of the last visited entry, i.e. where to continue. */
+    grpc::string prefix = ident_prefix(&match);
+    grpc::string position = std::max(prefix, req->page_token());
+    uint64_t remaining = req->page_size();
+
+    std::vector<value_list_t> value_lists;
+    bool done = false;
+    while (!done && status.ok()) {
+      size_t max_results = query_batch_size;
+      if ((remaining > 0) && (remaining < max_results))
+        max_results = (size_t)remaining;
+
+      status = this->queryValuesRead(&match, prefix, fields, max_results,
+                                     &position, &value_lists, &done);
+
+      bool page_done = false;
+      if (remaining > 0) {
+        remaining -= value_lists.size();
+        page_done = (remaining == 0);
+      }
 
-  grpc::Status PutValues(grpc::ServerContext *ctx,
-                         grpc::ServerReader<PutValuesRequest> *reader,
-                         PutValuesResponse *res) override {
-    PutValuesRequest req;
+      if (status.ok()) {
+        grpc::string token;
+        if (page_done && !done)
+          token = position;
+        status = this->queryValuesWrite(ctx, writer, &value_lists, fields,
+                                        token);
+      }
 
-    while (reader->Read(&req)) {
-      value_list_t vl = {0};
-      auto status = unmarshal_value_list(req.value_list(), &vl);
-      if (!status.ok())
-        return status;
+      for (auto vl : value_lists) {
+        sfree(vl.values);
+        meta_data_destroy(vl.meta);
+      }
+      value_lists.clear();
 
-      if (plugin_dispatch_values(&vl))
-        return grpc::Status(
-            grpc::StatusCode::INTERNAL,
-            grpc::string("failed to enqueue values for writing"));
+      if (page_done)
+        break;
     }
 
-    res->Clear();
-    return grpc::Status::OK;
+    return status;
   }
 
 private:
+  /* Reads up to query_batch_size cache entries following "position" and
+   * appends up to "max_results" matching value lists to "value_lists".
+   * Updates "position" to the name of the last visited entry and sets "done"
+   * if there are no more entries to visit. */
   grpc::Status queryValuesRead(value_list_t const *match,
-                               std::queue<value_list_t> *value_lists) {
+                               grpc::string const &prefix, unsigned int fields,
+                               size_t max_results, grpc::string *position,
+                               std::vector<value_list_t> *value_lists,
+                               bool *done) {
     uc_iter_t *iter;
     if ((iter = uc_get_iterator()) == NULL) {
       return grpc::Status(
           grpc::StatusCode::INTERNAL,
           grpc::string("failed to query values: cannot create iterator"));
     }
+    uc_iterator_seek(iter, position->c_str());
 
     grpc::Status status = grpc::Status::OK;
+    size_t visited = 0;
     char *name = NULL;
+
+    *done = true;
     while (uc_iterator_next(iter, &name) == 0) {
-      value_list_t vl;
+      /* The entry at "position" has been visited by the previous batch. */
+      if (*position == name)
+        continue;
+      if (strncmp(name, prefix.c_str(), prefix.size()) != 0)
+        break;
+
+      position->assign(name);
+      visited++;
+
+      value_list_t vl = {};
       if (parse_identifier_vl(name, &vl) != 0) {
         status = grpc::Status(grpc::StatusCode::INTERNAL,
                               grpc::string("failed to parse identifier"));
         break;
       }
 
-      if (!ident_matches(&vl, match))
-        continue;
-      if (uc_iterator_get_time(iter, &vl.time) < 0) {
-        status =
-            grpc::Status(grpc::StatusCode::INTERNAL,
-                         grpc::string("failed to retrieve value timestamp"));
-        break;
-      }
-      if (uc_iterator_get_interval(iter, &vl.interval) < 0) {
-        status =
-            grpc::Status(grpc::StatusCode::INTERNAL,
-                         grpc::string("failed to retrieve value interval"));
-        break;
+      if (ident_matches(&vl, match)) {
+        status = this->queryValuesCopy(iter, fields, &vl);
+        if (!status.ok())
+          break;
+        value_lists->push_back(vl);
       }
-      if (uc_iterator_get_values(iter, &vl.values, &vl.values_len) < 0) {
-        status = grpc::Status(grpc::StatusCode::INTERNAL,
-                              grpc::string("failed to retrieve values"));
+
+      if ((value_lists->size() >= max_results) ||
+          (visited >= query_batch_size)) {
+        *done = false;
         break;
       }
-      if (uc_iterator_get_meta(iter, &vl.meta) < 0) {
-        status =
-            grpc::Status(grpc::StatusCode::INTERNAL,
-                         grpc::string("failed to retrieve value metadata"));
-      }
-
-      value_lists->push(vl);
     } // while (uc_iterator_next(iter, &name) == 0)
 
     uc_iterator_destroy(iter);
     return status;
   }
 
+  /* Copies the requested fields of the entry at the iterator's position. */
+  grpc::Status queryValuesCopy(uc_iter_t *iter, unsigned int fields,
+                               value_list_t *vl) {
+    if (uc_iterator_get_time(iter, &vl->time) < 0) {
+      return grpc::Status(grpc::StatusCode::INTERNAL,
+                          grpc::string("failed to retrieve value timestamp"));
+    }
+    if (uc_iterator_get_interval(iter, &vl->interval) < 0) {
+      return grpc::Status(grpc::StatusCode::INTERNAL,
+                          grpc::string("failed to retrieve value interval"));
+    }
+    if ((fields & QUERY_FIELD_VALUES) &&
+        (uc_iterator_get_values(iter, &vl->values, &vl->values_len) < 0)) {
+      return grpc::Status(grpc::StatusCode::INTERNAL,
+                          grpc::string("failed to retrieve values"));
+    }
+    if ((fields & QUERY_FIELD_META_DATA) &&
+        (uc_iterator_get_meta(iter, &vl->meta) < 0)) {
+      sfree(vl->values);
+      return grpc::Status(grpc::StatusCode::INTERNAL,
+                          grpc::string("failed to retrieve value metadata"));
+    }
+
+    return grpc::Status::OK;
+  }
+
   grpc::Status queryValuesWrite(grpc::ServerContext *ctx,
                                 grpc::ServerWriter<QueryValuesResponse> *writer,
-                                std::queue<value_list_t> *value_lists) {
-    while (!value_lists->empty()) {
-      auto vl = value_lists->front();
+                                std::vector<value_list_t> *value_lists,
+                                unsigned int fields,
+                                grpc::string const &next_page_token) {
+    if (ctx->IsCancelled())
+      return grpc::Status::CANCELLED;
+
+    for (size_t i = 0; i < value_lists->size(); i++) {
       QueryValuesResponse res;
       res.Clear();
 
-      auto status = marshal_value_list(&vl, res.mutable_value_list());
+      auto status =
+          marshal_value_list(&value_lists->at(i), res.mutable_value_list(),
+                             fields);
       if (!status.ok()) {
         return status;
       }
 
+      if (i + 1 == value_lists->size())
+        res.set_next_page_token(next_page_token);
+
       if (!writer->Write(res)) {
         return grpc::Status::CANCELLED;
       }
-
-      value_lists->pop();
-      sfree(vl.values);
     }
 
     return grpc::Status::OK;
   }
 };
 
+typedef Collectd::WithAsyncMethod_PutValues<CollectdImpl> CollectdService;
+
+/*
+ * Asynchronous PutValues implementation
+ *
+ * Each PutValuesCall handles one client stream. It is a small state machine
+ * driven by the events of its completion queue, so a few polling threads can
+ * serve many concurrent streams. Reading from a stream is paused once the
+ * write queue reaches WriteQueueLimitHigh, until it has drained below
+ * WriteQueueLimitLow, which lets gRPC's flow control push back on clients
+ * instead of dropping values.
+ */
+class PutValuesCall final {
+public:
+  PutValuesCall(CollectdService *service, grpc::ServerCompletionQueue *cq,
+                std::atomic<bool> const *shutting_down)
+      : service_(service), cq_(cq), shutting_down_(shutting_down),
+        reader_(&ctx_) {
+    state_ = REQUEST;
+    service_->RequestPutValues(&ctx_, &reader_, cq_, cq_, this);
+  }
+
+  /* Called by the polling thread when the pending operation completed. */
+  void Proceed(bool ok) {
+    if (*shutting_down_ && (!ok || (state_ == THROTTLE))) {
+      delete this;
+      return;
+    }
+
+    switch (state_) {
+    case REQUEST:
+      if (!ok) {
+        delete this;
+        return;
+      }
+      /* Accept the next stream, unless the server is shutting down and the
+       * completion queue may already be shut down. */
+      if (!*shutting_down_)
+        new PutValuesCall(service_, cq_, shutting_down_);
+      peer_ = ctx_.peer();
+      start_ = cdtime();
+      startRead();
+      break;
+
+    case READ:
+      if (!ok) {
+        /* The client is done writing. */
+        finish(grpc::Status::OK);
+        break;
+      }
+      stats_.requests++;
+      {
+        uint64_t num = 0;
+        auto status = dispatch_put_values(req_, &num);
+        stats_.values += num;
+        if (!status.ok()) {
+          stats_.errors++;
+          finish(status);
+          break;
+        }
+      }
+      startRead();
+      break;
+
+    case THROTTLE:
+      stats_.throttled += cdtime() - throttle_start_;
+      startRead();
+      break;
+
+    case FINISH:
+      logStatistics();
+      delete this;
+      break;
+    }
+  } /* void Proceed */
+
+private:
+  enum { REQUEST, READ, THROTTLE, FINISH } state_;
+
+  struct {
+    uint64_t requests = 0;
+    uint64_t values = 0;
+    uint64_t errors = 0;
+    cdtime_t throttled = 0;
+  } stats_;
+
+  void startRead() {
+    if (put_values_throttled()) {
+      state_ = THROTTLE;
+      throttle_start_ = cdtime();
+      alarm_.Set(cq_,
+                 std::chrono::system_clock::now() +
+                     std::chrono::milliseconds(put_values_throttle_ms),
+                 this);
+      return;
+    }
+
+    state_ = READ;
+    req_.Clear();
+    reader_.Read(&req_, this);
+  } /* void startRead */
+
+  void finish(grpc::Status const &status) {
+    state_ = FINISH;
+    if (status.ok())
+      reader_.Finish(res_, status, this);
+    else
+      reader_.FinishWithError(status, this);
+  } /* void finish */
+
+  void logStatistics() {
+    INFO("grpc: Stream from %s closed after %.3f seconds: %" PRIu64
+         " requests, %" PRIu64 " value lists, %" PRIu64 " errors, "
+         "throttled for %.3f seconds.",
+         peer_.c_str(), CDTIME_T_TO_DOUBLE(cdtime() - start_), stats_.requests,
+         stats_.values, stats_.errors, CDTIME_T_TO_DOUBLE(stats_.throttled));
+  } /* void logStatistics */
+
+  CollectdService *service_;
+  grpc::ServerCompletionQueue *cq_;
+  std::atomic<bool> const *shutting_down_;
+
+  grpc::ServerContext ctx_;
+  grpc::ServerAsyncReader<PutValuesResponse, PutValuesRequest> reader_;
+  PutValuesRequest req_;
+  PutValuesResponse res_;
+  grpc::Alarm alarm_;
+
+  grpc::string peer_;
+  cdtime_t start_ = 0;
+  cdtime_t throttle_start_ = 0;
+}; /* class PutValuesCall */
+
 /*
  * gRPC server implementation
  */
@@ -552,51 +895,250 @@ public:
 
     builder.RegisterService(&collectd_service_);
 
+    for (size_t i = 0; i < polling_threads; i++)
+      cqs_.push_back(builder.AddCompletionQueue());
+
     server_ = builder.BuildAndStart();
+    if (!server_) {
+      ERROR("grpc: Failed to start server");
+      return;
+    }
+
+    shutting_down_ = false;
+    for (auto &cq : cqs_) {
+      auto c = cq.get();
+      new PutValuesCall(&collectd_service_, c, &shutting_down_);
+      threads_.push_back(std::thread([c]() {
+        void *tag;
+        bool ok;
+        while (c->Next(&tag, &ok))
+          static_cast<PutValuesCall *>(tag)->Proceed(ok);
+      }));
+    }
   } /* Start() */
 
-  void Shutdown() { server_->Shutdown(); } /* Shutdown() */
+  void Shutdown() {
+    /* Cancel all streams while the polling threads are still running, then
+     * drain and shut down the completion queues. */
+    if (!server_)
+      return;
+
+    shutting_down_ = true;
+    server_->Shutdown(std::chrono::system_clock::now() +
+                      std::chrono::seconds(1));
+
+    for (auto &cq : cqs_)
+      cq->Shutdown();
+    for (auto &t : threads_)
+      t.join();
+    threads_.clear();
+    cqs_.clear();
+  } /* Shutdown() */
 
 private:
-  CollectdImpl collectd_service_;
+  CollectdService collectd_service_;
 
   std::unique_ptr<grpc::Server> server_;
+
+  std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> cqs_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> shutting_down_;
 }; /* class CollectdServer */
 
+/*
+ * gRPC client implementation
+ *
+ * Value lists are collected into batches and sent over a single, long-lived
+ * PutValues stream. The first value list of a batch is sent in the
+ * "value_list" field, so that a batch size of one is understood by servers
+ * predating batching. A background thread sends batches which have not
+ * filled up within one interval. If the stream breaks, the client reconnects
+ * with an exponentially increasing delay.
+ */
 class CollectdClient final {
 public:
-  CollectdClient(std::shared_ptr<grpc::ChannelInterface> channel)
-      : stub_(Collectd::NewStub(channel)) {}
+  CollectdClient(std::shared_ptr<grpc::ChannelInterface> channel,
+                 grpc::string const &addr, size_t batch_size)
+      : stub_(Collectd::NewStub(channel)), addr_(addr),
+        batch_size_(batch_size), interval_(plugin_get_interval()) {
+    C_COMPLAIN_INIT(&complaint_);
+  }
+
+  ~CollectdClient() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      stopping_ = true;
+    }
+    cond_.notify_all();
+    if (flush_thread_.joinable())
+      flush_thread_.join();
+
+    std::lock_guard<std::mutex> lock(lock_);
+    sendPending();
+    closeStream();
+  }
 
   int PutValues(value_list_t const *vl) {
-    grpc::ClientContext ctx;
+    std::lock_guard<std::mutex> lock(lock_);
+
+    /* The thread is started by the first write, because threads created
+     * while the configuration is read do not survive daemonizing. */
+    if (!flush_thread_.joinable())
+      flush_thread_ = std::thread([this]() { this->flushLoop(); });
 
-    PutValuesRequest req;
-    auto status = marshal_value_list(vl, req.mutable_value_list());
+    collectd::types::ValueList *msg = pending_.has_value_list()
+                                          ? pending_.add_value_lists()
+                                          : pending_.mutable_value_list();
+    auto status = marshal_value_list(vl, msg);
     if (!status.ok()) {
+      if (pending_num_ == 0)
+        pending_.clear_value_list();
+      else
+        pending_.mutable_value_lists()->RemoveLast();
       ERROR("grpc: Marshalling value_list_t failed.");
       return -1;
     }
 
-    PutValuesResponse res;
-    auto stream = stub_->PutValues(&ctx, &res);
-    if (!stream->Write(req)) {
-      NOTICE("grpc: Broken stream.");
-      /* intentionally not returning. */
+    cdtime_t now = cdtime();
+    if (pending_num_ == 0)
+      pending_since_ = now;
+    pending_num_++;
+
+    if ((pending_num_ < batch_size_) && ((now - pending_since_) < interval_))
+      return 0;
+
+    return sendPending();
+  } /* int PutValues */
+
+  int Flush() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return sendPending();
+  } /* int Flush */
+
+private:
+  /* Sends the pending batch once it is one interval old, so that value
+   * lists are not held back if no further writes fill up the batch. */
+  void flushLoop() {
+    std::unique_lock<std::mutex> lock(lock_);
+    auto period = std::chrono::nanoseconds(CDTIME_T_TO_NS(interval_));
+
+    while (!stopping_) {
+      cond_.wait_for(lock, period);
+      if (stopping_)
+        break;
+
+      if ((pending_num_ > 0) && ((cdtime() - pending_since_) >= interval_))
+        sendPending();
+    }
+  } /* void flushLoop */
+
+  /* Sends all pending value lists. Must hold lock_ when calling. */
+  int sendPending() {
+    if (pending_num_ == 0)
+      return 0;
+
+    if (!stream_ && (openStream() != 0)) {
+      /* Keep one batch around to send after reconnecting. */
+      if (pending_num_ < batch_size_)
+        return 0;
+      dropped_ += pending_num_;
+      clearPending();
+      return -1;
     }
 
-    stream->WritesDone();
-    status = stream->Finish();
-    if (!status.ok()) {
-      ERROR("grpc: Error while closing stream.");
+    if (!stream_->Write(pending_)) {
+      closeStream();
+      /* The batch may or may not have been received, so it is sent again
+       * once the stream has been re-established. */
       return -1;
     }
 
+    clearPending();
     return 0;
-  } /* int PutValues */
+  } /* int sendPending */
+
+  void clearPending() {
+    pending_.Clear();
+    pending_num_ = 0;
+  } /* void clearPending */
+
+  /* Opens the PutValues stream, unless the reconnect delay has not yet
+   * passed. Must hold lock_ when calling. */
+  int openStream() {
+    cdtime_t now = cdtime();
+    if (now < reconnect_after_)
+      return -1;
+
+    ctx_.reset(new grpc::ClientContext());
+    res_.Clear();
+    stream_ = stub_->PutValues(ctx_.get(), &res_);
+    if (!stream_) {
+      ctx_.reset();
+      reconnectLater(now);
+      return -1;
+    }
+
+    reconnect_delay_ = 0;
+    if (dropped_ != 0) {
+      WARNING("grpc: %" PRIu64 " value lists for %s were dropped while "
+              "the server was unavailable.",
+              dropped_, addr_.c_str());
+      dropped_ = 0;
+    }
+    c_release(LOG_INFO, &complaint_, "grpc: Connected to %s.",
+              addr_.c_str());
+    return 0;
+  } /* int openStream */
+
+  /* Closes the PutValues stream and schedules reconnecting if the stream
+   * did not finish successfully. Must hold lock_ when calling. */
+  void closeStream() {
+    if (!stream_)
+      return;
+
+    stream_->WritesDone();
+    auto status = stream_->Finish();
+    stream_.reset();
+    ctx_.reset();
+
+    if (!status.ok()) {
+      c_complain(LOG_ERR, &complaint_, "grpc: Stream to %s failed: %s",
+                 addr_.c_str(), status.error_message().c_str());
+      reconnectLater(cdtime());
+    }
+  } /* void closeStream */
+
+  void reconnectLater(cdtime_t now) {
+    if (reconnect_delay_ == 0)
+      reconnect_delay_ = reconnect_min_delay;
+    else
+      reconnect_delay_ = std::min(2 * reconnect_delay_, reconnect_max_delay);
+    reconnect_after_ = now + reconnect_delay_;
+  } /* void reconnectLater */
+
+  std::mutex lock_;
 
-private:
   std::unique_ptr<Collectd::Stub> stub_;
+  grpc::string addr_;
+
+  std::unique_ptr<grpc::ClientContext> ctx_;
+  std::unique_ptr<grpc::ClientWriter<PutValuesRequest>> stream_;
+  PutValuesResponse res_;
+
+  PutValuesRequest pending_;
+  size_t pending_num_ = 0;
+  size_t batch_size_;
+  cdtime_t interval_;
+  cdtime_t pending_since_ = 0;
+  uint64_t dropped_ = 0;
+
+  std::thread flush_thread_;
+  std::condition_variable cond_;
+  bool stopping_ = false;
+
+  cdtime_t reconnect_delay_ = 0;
+  cdtime_t reconnect_after_ = 0;
+  c_complain_t complaint_;
 };
 
 static CollectdServer *server = nullptr;
@@ -615,6 +1157,13 @@ static int c_grpc_write(__attribute__((unused)) data_set_t const *ds,
   return c->PutValues(vl);
 }
 
+static int c_grpc_flush(__attribute__((unused)) cdtime_t timeout,
+                        __attribute__((unused)) char const *identifier,
+                        user_data_t *ud) {
+  CollectdClient *c = (CollectdClient *)ud->data;
+  return c->Flush();
+}
+
 static int c_grpc_config_listen(oconfig_item_t *ci) {
   if ((ci->values_num != 2) || (ci->values[0].type != OCONFIG_TYPE_STRING) ||
       (ci->values[1].type != OCONFIG_TYPE_STRING)) {
@@ -698,6 +1247,7 @@ static int c_grpc_config_server(oconfig_item_t *ci) {
 
   grpc::SslCredentialsOptions ssl_opts;
   bool use_ssl = false;
+  int batch_size = (int)default_batch_size;
 
   for (int i = 0; i < ci->children_num; i++) {
     oconfig_item_t *child = ci->children + i;
@@ -724,6 +1274,13 @@ static int c_grpc_config_server(oconfig_item_t *ci) {
         return -1;
       }
       ssl_opts.pem_cert_chain = read_file(cert);
+    } else if (!strcasecmp("BatchSize", child->key)) {
+      if (cf_util_get_int(child, &batch_size))
+        return -1;
+      if (batch_size < 1) {
+        ERROR("grpc: Option `%s` expects a positive integer", child->key);
+        return -1;
+      }
     } else {
       WARNING("grpc: Option `%s` not allowed in <%s> block.", child->key,
               ci->key);
@@ -738,11 +1295,11 @@ static int c_grpc_config_server(oconfig_item_t *ci) {
   if (use_ssl) {
     auto channel_creds = grpc::SslCredentials(ssl_opts);
     auto channel = grpc::CreateChannel(addr, channel_creds);
-    client = new CollectdClient(channel);
+    client = new CollectdClient(channel, addr, (size_t)batch_size);
   } else {
     auto channel =
         grpc::CreateChannel(addr, grpc::InsecureChannelCredentials());
-    client = new CollectdClient(channel);
+    client = new CollectdClient(channel, addr, (size_t)batch_size);
   }
 
   auto callback_name = grpc::string("grpc/") + addr;
@@ -752,6 +1309,9 @@ static int c_grpc_config_server(oconfig_item_t *ci) {
   };
 
   plugin_register_write(callback_name.c_str(), c_grpc_write, &ud);
+  ud.free_func = NULL;
+
+  plugin_register_flush(callback_name.c_str(), c_grpc_flush, &ud);
   return 0;
 } /* c_grpc_config_server() */
 
@@ -767,6 +1327,15 @@ static int c_grpc_config(oconfig_item_t *ci) {
     } else if (!strcasecmp("Server", child->key)) {
       if (c_grpc_config_server(child))
         return -1;
+    } else if (!strcasecmp("PollingThreads", child->key)) {
+      int num = 0;
+      if (cf_util_get_int(child, &num))
+        return -1;
+      if (num < 1) {
+        ERROR("grpc: Option `%s` expects a positive integer", child->key);
+        return -1;
+      }
+      polling_threads = (size_t)num;
     }
 
     else {
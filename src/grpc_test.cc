@@ -0,0 +1,308 @@
+/**
+ * collectd - src/grpc_test.cc
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#define plugin_dispatch_values_batch plugin_dispatch_values_batch_grpc_test
+#define plugin_get_write_queue_length plugin_get_write_queue_length_grpc_test
+
+/* testing.h has to be included first for the declaration of cdtime_mock. */
+#include "testing.h"
+
+#include "grpc.cc" /* sic */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static std::mutex dispatched_lock;
+static std::condition_variable dispatched_cond;
+static std::vector<grpc::string> dispatched;
+static size_t dispatched_batches;
+
+static std::atomic<long> write_queue_length(0);
+
+/* mock functions */
+extern "C" {
+int plugin_dispatch_values_batch_grpc_test(value_list_t const *vl,
+                                           size_t vl_num) {
+  std::lock_guard<std::mutex> lock(dispatched_lock);
+  for (size_t i = 0; i < vl_num; i++)
+    dispatched.push_back(vl[i].type_instance);
+  dispatched_batches++;
+  dispatched_cond.notify_all();
+  return 0;
+}
+
+long plugin_get_write_queue_length_grpc_test(long *limit_high,
+                                             long *limit_low) {
+  if (limit_high != NULL)
+    *limit_high = 10;
+  if (limit_low != NULL)
+    *limit_low = 5;
+  return write_queue_length;
+}
+}
+/* end mock functions */
+
+static void reset_dispatched(void) {
+  std::lock_guard<std::mutex> lock(dispatched_lock);
+  dispatched.clear();
+  dispatched_batches = 0;
+}
+
+/* Waits up to five seconds for "num" value lists to be dispatched. */
+static size_t wait_dispatched(size_t num) {
+  std::unique_lock<std::mutex> lock(dispatched_lock);
+  dispatched_cond.wait_for(lock, std::chrono::seconds(5),
+                           [num]() { return dispatched.size() >= num; });
+  return dispatched.size();
+}
+
+/* Returns a TCP port on the loopback interface which is currently unused. */
+static grpc::string unused_port(void) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return "";
+
+  struct sockaddr_in sa = {};
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t sa_len = sizeof(sa);
+  if ((bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) ||
+      (getsockname(fd, (struct sockaddr *)&sa, &sa_len) != 0)) {
+    close(fd);
+    return "";
+  }
+
+  close(fd);
+  return std::to_string(ntohs(sa.sin_port));
+}
+
+static grpc::string server_addr;
+
+static value_list_t make_value_list(char const *type_instance) {
+  static value_t values[] = {{.derive = 42}};
+
+  value_list_t vl = {};
+  vl.values = values;
+  vl.values_len = 1;
+  vl.time = TIME_T_TO_CDTIME_T(1);
+  vl.interval = TIME_T_TO_CDTIME_T(10);
+  sstrncpy(vl.host, "example.com", sizeof(vl.host));
+  sstrncpy(vl.plugin, "test", sizeof(vl.plugin));
+  sstrncpy(vl.type, "MAGIC", sizeof(vl.type));
+  sstrncpy(vl.type_instance, type_instance, sizeof(vl.type_instance));
+  return vl;
+}
+
+static std::shared_ptr<grpc::Channel> new_channel(void) {
+  return grpc::CreateChannel(server_addr, grpc::InsecureChannelCredentials());
+}
+
+DEF_TEST(put_values) {
+  reset_dispatched();
+  {
+    CollectdClient client(new_channel(), server_addr, /* batch_size = */ 1);
+    value_list_t vl = make_value_list("single");
+    CHECK_ZERO(client.PutValues(&vl));
+  }
+
+  EXPECT_EQ_UINT64(1, wait_dispatched(1));
+  EXPECT_EQ_STR("single", dispatched[0].c_str());
+  EXPECT_EQ_UINT64(1, dispatched_batches);
+  return 0;
+}
+
+DEF_TEST(put_values_batched) {
+  reset_dispatched();
+  {
+    CollectdClient client(new_channel(), server_addr, /* batch_size = */ 3);
+    char const *names[] = {"0", "1", "2", "3"};
+    for (size_t i = 0; i < STATIC_ARRAY_SIZE(names); i++) {
+      value_list_t vl = make_value_list(names[i]);
+      CHECK_ZERO(client.PutValues(&vl));
+    }
+    /* The first three value lists are sent as one batch, the fourth is
+     * pending until the client is flushed. */
+    EXPECT_EQ_UINT64(3, wait_dispatched(3));
+    CHECK_ZERO(client.Flush());
+  }
+
+  EXPECT_EQ_UINT64(4, wait_dispatched(4));
+  EXPECT_EQ_STR("0", dispatched[0].c_str());
+  EXPECT_EQ_STR("1", dispatched[1].c_str());
+  EXPECT_EQ_STR("2", dispatched[2].c_str());
+  EXPECT_EQ_STR("3", dispatched[3].c_str());
+  EXPECT_EQ_UINT64(2, dispatched_batches);
+  return 0;
+}
+
+DEF_TEST(put_values_flush_timer) {
+  reset_dispatched();
+
+  plugin_ctx_t ctx = plugin_get_ctx();
+  ctx.interval = MS_TO_CDTIME_T(50);
+  plugin_ctx_t old_ctx = plugin_set_ctx(ctx);
+  {
+    CollectdClient client(new_channel(), server_addr, /* batch_size = */ 10);
+    value_list_t vl = make_value_list("stale");
+    CHECK_ZERO(client.PutValues(&vl));
+
+    /* The batch is sent by the client's thread once it is one interval
+     * old, without further writes or a flush. */
+    cdtime_mock += TIME_T_TO_CDTIME_T(1);
+    EXPECT_EQ_UINT64(1, wait_dispatched(1));
+  }
+  plugin_set_ctx(old_ctx);
+
+  EXPECT_EQ_STR("stale", dispatched[0].c_str());
+  return 0;
+}
+
+DEF_TEST(throttle) {
+  write_queue_length = 7;
+  OK(!put_values_throttled());
+  write_queue_length = 10;
+  OK(put_values_throttled());
+  /* Reading stays paused until the queue drained below the low limit. */
+  write_queue_length = 7;
+  OK(put_values_throttled());
+  write_queue_length = 4;
+  OK(!put_values_throttled());
+  write_queue_length = 7;
+  OK(!put_values_throttled());
+
+  reset_dispatched();
+  write_queue_length = 10;
+  {
+    CollectdClient client(new_channel(), server_addr, /* batch_size = */ 1);
+    value_list_t vl = make_value_list("throttled");
+    CHECK_ZERO(client.PutValues(&vl));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    {
+      std::lock_guard<std::mutex> lock(dispatched_lock);
+      EXPECT_EQ_UINT64(0, dispatched.size());
+    }
+
+    write_queue_length = 0;
+    EXPECT_EQ_UINT64(1, wait_dispatched(1));
+  }
+
+  EXPECT_EQ_STR("throttled", dispatched[0].c_str());
+  return 0;
+}
+
+/* Reads one page of QueryValues results, appending the type instances to
+ * "names" and returning the next page token in "token". */
+static int query_page(Collectd::Stub *stub, uint64_t page_size,
+                      grpc::string *token, std::vector<grpc::string> *names) {
+  QueryValuesRequest req;
+  auto id = req.mutable_identifier();
+  id->set_host("example.com");
+  id->set_plugin("test");
+  id->set_plugin_instance("*");
+  id->set_type("MAGIC");
+  id->set_type_instance("*");
+  req.set_page_size(page_size);
+  req.set_page_token(*token);
+
+  grpc::ClientContext ctx;
+  auto reader = stub->QueryValues(&ctx, req);
+
+  token->clear();
+  QueryValuesResponse res;
+  while (reader->Read(&res)) {
+    names->push_back(res.value_list().identifier().type_instance());
+    if (res.value_list().values_size() != 1)
+      return -1;
+    if (res.value_list().values(0).derive() != 42)
+      return -1;
+    *token = res.next_page_token();
+  }
+
+  return reader->Finish().ok() ? 0 : -1;
+}
+
+DEF_TEST(query_values_paging) {
+  char const *names[] = {"a", "b", "c", "d", "e"};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(names); i++) {
+    value_list_t vl = make_value_list(names[i]);
+    CHECK_ZERO(uc_update(plugin_get_ds("MAGIC"), &vl));
+  }
+  /* Not matched by the query. */
+  value_list_t other = make_value_list("x");
+  sstrncpy(other.plugin, "other", sizeof(other.plugin));
+  CHECK_ZERO(uc_update(plugin_get_ds("MAGIC"), &other));
+
+  auto stub = Collectd::NewStub(new_channel());
+  std::vector<grpc::string> got;
+  grpc::string token;
+
+  CHECK_ZERO(query_page(stub.get(), 2, &token, &got));
+  EXPECT_EQ_UINT64(2, got.size());
+  OK(!token.empty());
+
+  CHECK_ZERO(query_page(stub.get(), 2, &token, &got));
+  EXPECT_EQ_UINT64(4, got.size());
+  OK(!token.empty());
+
+  CHECK_ZERO(query_page(stub.get(), 2, &token, &got));
+  EXPECT_EQ_UINT64(5, got.size());
+  OK(token.empty());
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(names); i++)
+    EXPECT_EQ_STR(names[i], got[i].c_str());
+
+  /* Without a page size, all results are returned at once. */
+  got.clear();
+  CHECK_ZERO(query_page(stub.get(), 0, &token, &got));
+  EXPECT_EQ_UINT64(5, got.size());
+  OK(token.empty());
+
+  return 0;
+}
+
+int main(void) {
+  if (uc_init() != 0)
+    return 1;
+
+  grpc::string port = unused_port();
+  if (port.empty())
+    return 1;
+  listeners.push_back(Listener{"127.0.0.1", port, nullptr});
+  server_addr = "127.0.0.1:" + port;
+  if ((c_grpc_init() != 0) || (server == nullptr))
+    return 1;
+
+  RUN_TEST(put_values);
+  RUN_TEST(put_values_batched);
+  RUN_TEST(put_values_flush_timer);
+  RUN_TEST(throttle);
+  RUN_TEST(query_values_paging);
+
+  c_grpc_shutdown();
+  END_TEST;
+}
@@ -104,12 +104,47 @@
     snprintf((c)->errbuf, sizeof((c)->errbuf), __VA_ARGS__);                   \
   } while (0)
 
+/* Maximum number of PUTVAL commands lcc_putval_async() keeps in flight
+ * before it waits for the oldest response. The responses of that many
+ * commands have to fit into the socket buffers, or client and daemon could
+ * both block in write(2). */
+#define LCC_PIPELINE_DEPTH 128
+
+/* Maximum length of one PUTVAL command carrying several value lists. */
+#define LCC_LINE_MAX 16384
+
 /*
  * Types
  */
+struct lcc_pending_s {
+  lcc_putval_callback_t callback;
+  void *user_data;
+  /* Set for the last value list of a command: one response completes all
+   * pending value lists up to and including this one. */
+  _Bool last;
+};
+typedef struct lcc_pending_s lcc_pending_t;
+
 struct lcc_connection_s {
+  /* Responses may be read ahead while further commands are being written,
+   * so reading and writing use separate streams on the same socket. */
   FILE *fh;
+  FILE *out;
   char errbuf[2048];
+
+  /* Value lists submitted with lcc_putval_async() whose responses have not
+   * been read yet, oldest first. */
+  lcc_pending_t *pending;
+  size_t pending_head;
+  size_t pending_num;
+  size_t pending_size;
+  size_t commands_in_flight;
+
+  /* PUTVAL command being assembled from up to "group_size" value lists. */
+  size_t group_size;
+  char *line;
+  size_t line_len;
+  size_t line_groups;
 };
 
 struct lcc_response_s {
@@ -268,12 +303,12 @@ static int lcc_send(lcc_connection_t *c, const char *command) /* {{{ */
 
   lcc_tracef("send:    --> %s\n", command);
 
-  status = fprintf(c->fh, "%s\r\n", command);
+  status = fprintf(c->out, "%s\r\n", command);
   if (status < 0) {
     lcc_set_errno(c, errno);
     return -1;
   }
-  fflush(c->fh);
+  fflush(c->out);
 
   return 0;
 } /* }}} int lcc_send */
@@ -368,6 +403,13 @@ static int lcc_sendreceive(lcc_connection_t *c, /* {{{ */
     return -1;
   }
 
+  /* Collect the responses to pipelined commands first. */
+  if (c->pending_num > 0) {
+    status = lcc_wait(c);
+    if (status != 0)
+      return status;
+  }
+
   status = lcc_send(c, command);
   if (status != 0)
     return status;
@@ -535,8 +577,23 @@ static int lcc_open_socket(lcc_connection_t *c, const char *addr) /* {{{ */
     status = lcc_open_unixsocket(c, addr);
   else
     status = lcc_open_netsocket(c, addr);
+  if (status != 0)
+    return status;
 
-  return status;
+  int fd = dup(fileno(c->fh));
+  if (fd < 0) {
+    lcc_set_errno(c, errno);
+    return -1;
+  }
+
+  c->out = fdopen(fd, "w");
+  if (c->out == NULL) {
+    lcc_set_errno(c, errno);
+    close(fd);
+    return -1;
+  }
+
+  return 0;
 } /* }}} int lcc_open_socket */
 
 /*
@@ -571,6 +628,7 @@ int lcc_connect(const char *address, lcc_connection_t **ret_con) /* {{{ */
   c = calloc(1, sizeof(*c));
   if (c == NULL)
     return -1;
+  c->group_size = 1;
 
   status = lcc_open_socket(c, address);
   if (status != 0) {
@@ -587,11 +645,22 @@ int lcc_disconnect(lcc_connection_t *c) /* {{{ */
   if (c == NULL)
     return -1;
 
+  /* Deliver the outstanding responses to their callbacks. */
+  if ((c->fh != NULL) && (c->out != NULL))
+    lcc_wait(c);
+
+  if (c->out != NULL) {
+    fclose(c->out);
+    c->out = NULL;
+  }
+
   if (c->fh != NULL) {
     fclose(c->fh);
     c->fh = NULL;
   }
 
+  free(c->pending);
+  free(c->line);
   free(c);
   return 0;
 } /* }}} int lcc_disconnect */
@@ -717,16 +786,18 @@ int lcc_getval(lcc_connection_t *c, lcc_identifier_t *ident, /* {{{ */
   return 0;
 } /* }}} int lcc_getval */
 
-int lcc_putval(lcc_connection_t *c, const lcc_value_list_t *vl) /* {{{ */
-{
+/* lcc_format_putval formats the identifier, options and values of "vl", i.e.
+ * the arguments of one PUTVAL command, into "buffer". */
+static int lcc_format_putval(lcc_connection_t *c, /* {{{ */
+                             const lcc_value_list_t *vl, char *buffer,
+                             size_t buffer_size) {
   char ident_str[6 * LCC_NAME_LEN];
   char ident_esc[12 * LCC_NAME_LEN];
   char command[1024] = "";
-  lcc_response_t res;
   int status;
 
-  if ((c == NULL) || (vl == NULL) || (vl->values_len < 1) ||
-      (vl->values == NULL) || (vl->values_types == NULL)) {
+  if ((vl == NULL) || (vl->values_len < 1) || (vl->values == NULL) ||
+      (vl->values_types == NULL)) {
     lcc_set_errno(c, EINVAL);
     return -1;
   }
@@ -736,8 +807,7 @@ int lcc_putval(lcc_connection_t *c, const lcc_value_list_t *vl) /* {{{ */
   if (status != 0)
     return status;
 
-  SSTRCATF(command, "PUTVAL %s",
-           lcc_strescape(ident_esc, ident_str, sizeof(ident_esc)));
+  SSTRCAT(command, lcc_strescape(ident_esc, ident_str, sizeof(ident_esc)));
 
   if (vl->interval > 0.0)
     SSTRCATF(command, " interval=%.3f", vl->interval);
@@ -762,6 +832,26 @@ int lcc_putval(lcc_connection_t *c, const lcc_value_list_t *vl) /* {{{ */
 
   } /* for (i = 0; i < vl->values_len; i++) */
 
+  snprintf(buffer, buffer_size, "%s", command);
+  return 0;
+} /* }}} int lcc_format_putval */
+
+int lcc_putval(lcc_connection_t *c, const lcc_value_list_t *vl) /* {{{ */
+{
+  char args[1024];
+  char command[sizeof("PUTVAL ") + sizeof(args)];
+  lcc_response_t res;
+  int status;
+
+  if (c == NULL)
+    return -1;
+
+  status = lcc_format_putval(c, vl, args, sizeof(args));
+  if (status != 0)
+    return status;
+
+  snprintf(command, sizeof(command), "PUTVAL %s", args);
+
   status = lcc_sendreceive(c, command, &res);
   if (status != 0)
     return status;
@@ -776,6 +866,262 @@ int lcc_putval(lcc_connection_t *c, const lcc_value_list_t *vl) /* {{{ */
   return 0;
 } /* }}} int lcc_putval */
 
+/* lcc_fail_pending reports the error in "c->errbuf" to the callbacks of all
+ * pending value lists and drops the command being assembled. */
+static void lcc_fail_pending(lcc_connection_t *c) /* {{{ */
+{
+  while (c->pending_num > 0) {
+    lcc_pending_t *p = c->pending + c->pending_head;
+    c->pending_head++;
+    c->pending_num--;
+
+    if (p->callback != NULL)
+      p->callback(-1, c->errbuf, p->user_data);
+  }
+  c->pending_head = 0;
+  c->commands_in_flight = 0;
+  c->line_len = 0;
+  c->line_groups = 0;
+} /* }}} void lcc_fail_pending */
+
+/* lcc_receive_pending reads the response to the oldest PUTVAL command in
+ * flight and calls the callbacks of the value lists it carried. */
+static int lcc_receive_pending(lcc_connection_t *c) /* {{{ */
+{
+  lcc_response_t res = {0};
+
+  assert(c->commands_in_flight > 0);
+
+  /* A no-op unless commands have been written since the last response. */
+  if (fflush(c->out) != 0) {
+    lcc_set_errno(c, errno);
+    lcc_fail_pending(c);
+    return -1;
+  }
+
+  if (lcc_receive(c, &res) != 0) {
+    lcc_fail_pending(c);
+    return -1;
+  }
+  c->commands_in_flight--;
+
+  while (c->pending_num > 0) {
+    lcc_pending_t *p = c->pending + c->pending_head;
+    c->pending_head++;
+    c->pending_num--;
+
+    if (p->callback != NULL)
+      p->callback(res.status, res.message, p->user_data);
+    if (p->last)
+      break;
+  }
+  if (c->pending_num == 0)
+    c->pending_head = 0;
+
+  lcc_response_free(&res);
+  return 0;
+} /* }}} int lcc_receive_pending */
+
+/* lcc_send_pending writes the PUTVAL command being assembled to the output
+ * stream, waiting for responses first if the pipeline is full. */
+static int lcc_send_pending(lcc_connection_t *c) /* {{{ */
+{
+  if (c->line_groups == 0)
+    return 0;
+
+  /* When the pipeline is full, collect half of the responses, so that the
+   * output is flushed once per LCC_PIPELINE_DEPTH / 2 commands. */
+  if (c->commands_in_flight >= LCC_PIPELINE_DEPTH) {
+    while (c->commands_in_flight > LCC_PIPELINE_DEPTH / 2) {
+      if (lcc_receive_pending(c) != 0)
+        return -1;
+    }
+  }
+
+  lcc_tracef("send:    --> %s\n", c->line);
+  if (fprintf(c->out, "%s\r\n", c->line) < 0) {
+    lcc_set_errno(c, errno);
+    lcc_fail_pending(c);
+    return -1;
+  }
+
+  c->pending[c->pending_head + c->pending_num - 1].last = 1;
+  c->commands_in_flight++;
+  c->line_len = 0;
+  c->line_groups = 0;
+  return 0;
+} /* }}} int lcc_send_pending */
+
+static int lcc_pending_append(lcc_connection_t *c, /* {{{ */
+                              lcc_putval_callback_t callback,
+                              void *user_data) {
+  if (c->pending_head + c->pending_num >= c->pending_size) {
+    if (c->pending_head > 0) {
+      memmove(c->pending, c->pending + c->pending_head,
+              c->pending_num * sizeof(*c->pending));
+      c->pending_head = 0;
+    } else {
+      size_t new_size = (c->pending_size == 0) ? 64 : 2 * c->pending_size;
+      lcc_pending_t *tmp = realloc(c->pending, new_size * sizeof(*tmp));
+      if (tmp == NULL) {
+        lcc_set_errno(c, ENOMEM);
+        return -1;
+      }
+      c->pending = tmp;
+      c->pending_size = new_size;
+    }
+  }
+
+  c->pending[c->pending_head + c->pending_num] = (lcc_pending_t){
+      .callback = callback,
+      .user_data = user_data,
+  };
+  c->pending_num++;
+  return 0;
+} /* }}} int lcc_pending_append */
+
+int lcc_putval_async(lcc_connection_t *c, /* {{{ */
+                     const lcc_value_list_t *vl,
+                     lcc_putval_callback_t callback, void *user_data) {
+  char args[1024];
+  size_t args_len;
+  int status;
+
+  if (c == NULL)
+    return -1;
+
+  if ((c->fh == NULL) || (c->out == NULL)) {
+    lcc_set_errno(c, EBADF);
+    return -1;
+  }
+
+  status = lcc_format_putval(c, vl, args, sizeof(args));
+  if (status != 0)
+    return status;
+  args_len = strlen(args);
+
+  if (c->line == NULL) {
+    c->line = malloc(LCC_LINE_MAX);
+    if (c->line == NULL) {
+      lcc_set_errno(c, ENOMEM);
+      return -1;
+    }
+  }
+
+  /* Send the current command if this value list does not fit in. */
+  if ((c->line_groups > 0) &&
+      (c->line_len + strlen(" ; ") + args_len >= LCC_LINE_MAX)) {
+    status = lcc_send_pending(c);
+    if (status != 0)
+      return status;
+  }
+
+  status = lcc_pending_append(c, callback, user_data);
+  if (status != 0)
+    return status;
+
+  c->line_len += snprintf(c->line + c->line_len, LCC_LINE_MAX - c->line_len,
+                          "%s%s", (c->line_groups == 0) ? "PUTVAL " : " ; ",
+                          args);
+  c->line_groups++;
+
+  if (c->line_groups >= c->group_size)
+    return lcc_send_pending(c);
+
+  return 0;
+} /* }}} int lcc_putval_async */
+
+int lcc_wait(lcc_connection_t *c) /* {{{ */
+{
+  int status;
+
+  if (c == NULL)
+    return -1;
+
+  status = lcc_send_pending(c);
+  if (status != 0)
+    return status;
+
+  while (c->commands_in_flight > 0) {
+    status = lcc_receive_pending(c);
+    if (status != 0)
+      return status;
+  }
+
+  return 0;
+} /* }}} int lcc_wait */
+
+struct lcc_batch_status_s {
+  size_t failed;
+  char message[1024];
+};
+typedef struct lcc_batch_status_s lcc_batch_status_t;
+
+static void lcc_batch_callback(int status, const char *message, /* {{{ */
+                               void *user_data) {
+  lcc_batch_status_t *bs = user_data;
+
+  if (status == 0)
+    return;
+
+  if (bs->failed == 0)
+    snprintf(bs->message, sizeof(bs->message), "%s", message);
+  bs->failed++;
+} /* }}} void lcc_batch_callback */
+
+int lcc_putval_batch(lcc_connection_t *c, /* {{{ */
+                     const lcc_value_list_t *vl, size_t vl_num) {
+  lcc_batch_status_t bs = {0};
+  int status;
+
+  if (c == NULL)
+    return -1;
+
+  if ((vl == NULL) && (vl_num > 0)) {
+    lcc_set_errno(c, EINVAL);
+    return -1;
+  }
+
+  for (size_t i = 0; i < vl_num; i++) {
+    status = lcc_putval_async(c, vl + i, lcc_batch_callback, &bs);
+    if (status != 0) {
+      /* Keep the connection usable: collect what has been sent so far, but
+       * report the error that stopped us. */
+      char errbuf[sizeof(c->errbuf)];
+      memcpy(errbuf, c->errbuf, sizeof(errbuf));
+      lcc_wait(c);
+      memcpy(c->errbuf, errbuf, sizeof(errbuf));
+      return -1;
+    }
+  }
+
+  status = lcc_wait(c);
+  if (status != 0)
+    return status;
+
+  if (bs.failed > 0) {
+    LCC_SET_ERRSTR(c, "Server error (%zu of %zu value lists): %s", bs.failed,
+                   vl_num, bs.message);
+    return -1;
+  }
+
+  return 0;
+} /* }}} int lcc_putval_batch */
+
+int lcc_set_putval_group_size(lcc_connection_t *c, /* {{{ */
+                              size_t group_size) {
+  if (c == NULL)
+    return -1;
+
+  if (group_size < 1) {
+    lcc_set_errno(c, EINVAL);
+    return -1;
+  }
+
+  c->group_size = group_size;
+  return 0;
+} /* }}} int lcc_set_putval_group_size */
+
 int lcc_flush(lcc_connection_t *c, const char *plugin, /* {{{ */
               lcc_identifier_t *ident, int timeout) {
   char command[1024] = "";
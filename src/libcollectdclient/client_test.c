@@ -0,0 +1,507 @@
+/**
+ * libcollectdclient - src/libcollectdclient/client_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include "client.c" /* sic */
+
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+
+/* Time without new commands after which the fake server answers all
+ * outstanding commands. The client only stops sending when it waits for
+ * responses, so this is when the number of commands in flight is highest. */
+#define FAKE_SERVER_IDLE_MS 200
+
+#define FAKE_SERVER_GROUPS_MAX 16
+
+/* fake_server_t is a minimal daemon on one end of a socket pair. Commands
+ * whose value lists contain "fail" are answered with an error. */
+typedef struct {
+  int fd;
+  /* If non-zero, the connection is closed without answering after this many
+   * commands. */
+  size_t hangup_after;
+
+  size_t commands_num;
+  size_t value_lists_num;
+  size_t max_in_flight;
+  /* Number of value lists of the first commands. */
+  size_t groups[FAKE_SERVER_GROUPS_MAX];
+} fake_server_t;
+
+static int fake_server_answer(fake_server_t *s, _Bool *failed,
+                              size_t failed_num) {
+  for (size_t i = 0; i < failed_num; i++) {
+    char const *res =
+        failed[i] ? "-1 Parsing the value list failed.\n" : "0 Success\n";
+    if (write(s->fd, res, strlen(res)) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+static void *fake_server(void *arg) {
+  fake_server_t *s = arg;
+  char buffer[65536];
+  size_t buffer_fill = 0;
+  _Bool failed[4 * LCC_PIPELINE_DEPTH];
+  size_t failed_num = 0;
+
+  while (1) {
+    struct pollfd pfd = {.fd = s->fd, .events = POLLIN};
+    int status = poll(&pfd, 1, (failed_num > 0) ? FAKE_SERVER_IDLE_MS : -1);
+    if (status < 0)
+      break;
+    if (status == 0) {
+      if (fake_server_answer(s, failed, failed_num) != 0)
+        break;
+      failed_num = 0;
+      continue;
+    }
+
+    ssize_t n = read(s->fd, buffer + buffer_fill,
+                     sizeof(buffer) - buffer_fill - 1);
+    if (n <= 0)
+      break;
+    buffer_fill += (size_t)n;
+    buffer[buffer_fill] = 0;
+
+    char *line = buffer;
+    char *end;
+    while ((end = strstr(line, "\r\n")) != NULL) {
+      *end = 0;
+
+      size_t groups = 1;
+      for (char *ptr = strstr(line, " ; "); ptr != NULL;
+           ptr = strstr(ptr + 1, " ; "))
+        groups++;
+
+      if (s->commands_num < FAKE_SERVER_GROUPS_MAX)
+        s->groups[s->commands_num] = groups;
+      s->commands_num++;
+      s->value_lists_num += groups;
+
+      if (failed_num >= sizeof(failed) / sizeof(failed[0]))
+        goto out;
+      failed[failed_num] = (strstr(line, "fail") != NULL);
+      failed_num++;
+      if (s->max_in_flight < failed_num)
+        s->max_in_flight = failed_num;
+
+      if ((s->hangup_after > 0) && (s->commands_num >= s->hangup_after))
+        goto out;
+
+      line = end + strlen("\r\n");
+    }
+
+    buffer_fill -= (size_t)(line - buffer);
+    memmove(buffer, line, buffer_fill);
+  }
+
+out:
+  close(s->fd);
+  return NULL;
+}
+
+/* fake_connect returns a connection to a fake server running in "thread". */
+static lcc_connection_t *fake_connect(fake_server_t *s, pthread_t *thread) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    return NULL;
+
+  lcc_connection_t *c = calloc(1, sizeof(*c));
+  assert(c != NULL);
+  c->group_size = 1;
+  c->fh = fdopen(fds[0], "r+");
+  c->out = fdopen(dup(fds[0]), "w");
+  assert((c->fh != NULL) && (c->out != NULL));
+
+  s->fd = fds[1];
+  if (pthread_create(thread, NULL, fake_server, s) != 0) {
+    close(fds[1]);
+    lcc_disconnect(c);
+    return NULL;
+  }
+
+  return c;
+}
+
+static void fake_disconnect(lcc_connection_t *c, pthread_t thread) {
+  lcc_disconnect(c);
+  pthread_join(thread, NULL);
+}
+
+static value_t test_value = {.gauge = 42.0};
+static int test_value_type = LCC_TYPE_GAUGE;
+
+static lcc_value_list_t test_vl(char const *plugin_instance) {
+  lcc_value_list_t vl = {
+      .values = &test_value,
+      .values_types = &test_value_type,
+      .values_len = 1,
+      .time = 1439980823.0,
+      .interval = 10.0,
+      .identifier = {"example.com", "test", "", "gauge", ""},
+  };
+  snprintf(vl.identifier.plugin_instance,
+           sizeof(vl.identifier.plugin_instance), "%s", plugin_instance);
+  return vl;
+}
+
+typedef struct {
+  size_t calls;
+  size_t failed;
+  /* Set if the callbacks are not called in submission order. */
+  _Bool out_of_order;
+  char message[1024];
+} callback_state_t;
+
+typedef struct {
+  callback_state_t *state;
+  size_t index;
+} callback_arg_t;
+
+static void test_callback(int status, const char *message, void *user_data) {
+  callback_arg_t *arg = user_data;
+  callback_state_t *state = arg->state;
+
+  if (arg->index != state->calls)
+    state->out_of_order = 1;
+  state->calls++;
+
+  if (status != 0) {
+    state->failed++;
+    snprintf(state->message, sizeof(state->message), "%s", message);
+  }
+}
+
+static int test_pipeline_depth() {
+  int ret = 0;
+  fake_server_t s = {0};
+  pthread_t thread;
+  lcc_connection_t *c = fake_connect(&s, &thread);
+  if (c == NULL) {
+    fprintf(stderr, "fake_connect() failed\n");
+    return -1;
+  }
+
+  lcc_value_list_t vl = test_vl("");
+  callback_state_t state = {0};
+  callback_arg_t args[5 * LCC_PIPELINE_DEPTH / 2];
+  size_t args_num = sizeof(args) / sizeof(args[0]);
+
+  for (size_t i = 0; i < args_num; i++) {
+    args[i] = (callback_arg_t){.state = &state, .index = i};
+    if (lcc_putval_async(c, &vl, test_callback, args + i) != 0) {
+      fprintf(stderr, "lcc_putval_async() failed: %s\n", lcc_strerror(c));
+      ret = -1;
+      break;
+    }
+  }
+
+  int status = lcc_wait(c);
+  if (status != 0) {
+    fprintf(stderr, "lcc_wait() = %d, want 0: %s\n", status, lcc_strerror(c));
+    ret = -1;
+  }
+
+  fake_disconnect(c, thread);
+
+  if ((state.calls != args_num) || (state.failed != 0) || state.out_of_order) {
+    fprintf(stderr,
+            "callbacks: %zu calls, %zu failed, out of order: %d; want %zu "
+            "calls, 0 failed, in order\n",
+            state.calls, state.failed, (int)state.out_of_order, args_num);
+    ret = -1;
+  }
+  if (s.commands_num != args_num) {
+    fprintf(stderr, "server received %zu commands, want %zu\n",
+            s.commands_num, args_num);
+    ret = -1;
+  }
+  if (s.max_in_flight != LCC_PIPELINE_DEPTH) {
+    fprintf(stderr, "up to %zu commands were in flight, want %d\n",
+            s.max_in_flight, LCC_PIPELINE_DEPTH);
+    ret = -1;
+  }
+
+  if (ret == 0)
+    printf("ok - pipeline depth\n");
+  return ret;
+}
+
+static int test_group_size() {
+  int ret = 0;
+  fake_server_t s = {0};
+  pthread_t thread;
+  lcc_connection_t *c = fake_connect(&s, &thread);
+  if (c == NULL) {
+    fprintf(stderr, "fake_connect() failed\n");
+    return -1;
+  }
+
+  if (lcc_set_putval_group_size(c, 0) == 0) {
+    fprintf(stderr, "lcc_set_putval_group_size(0) succeeded, want error\n");
+    ret = -1;
+  }
+  if (lcc_set_putval_group_size(c, 3) != 0) {
+    fprintf(stderr, "lcc_set_putval_group_size(3) failed\n");
+    ret = -1;
+  }
+
+  lcc_value_list_t vl = test_vl("");
+  callback_state_t state = {0};
+  callback_arg_t args[7];
+  size_t args_num = sizeof(args) / sizeof(args[0]);
+
+  for (size_t i = 0; i < args_num; i++) {
+    args[i] = (callback_arg_t){.state = &state, .index = i};
+    if (lcc_putval_async(c, &vl, test_callback, args + i) != 0) {
+      fprintf(stderr, "lcc_putval_async() failed: %s\n", lcc_strerror(c));
+      ret = -1;
+    }
+  }
+
+  /* The last, incomplete group is sent by lcc_wait(). */
+  int status = lcc_wait(c);
+  if (status != 0) {
+    fprintf(stderr, "lcc_wait() = %d, want 0: %s\n", status, lcc_strerror(c));
+    ret = -1;
+  }
+
+  fake_disconnect(c, thread);
+
+  size_t want_groups[] = {3, 3, 1};
+  size_t want_num = sizeof(want_groups) / sizeof(want_groups[0]);
+  if ((s.commands_num != want_num) || (s.value_lists_num != args_num)) {
+    fprintf(stderr,
+            "server received %zu commands with %zu value lists, want %zu "
+            "commands with %zu value lists\n",
+            s.commands_num, s.value_lists_num, want_num, args_num);
+    ret = -1;
+  } else {
+    for (size_t i = 0; i < want_num; i++) {
+      if (s.groups[i] != want_groups[i]) {
+        fprintf(stderr, "command %zu has %zu value lists, want %zu\n", i,
+                s.groups[i], want_groups[i]);
+        ret = -1;
+      }
+    }
+  }
+
+  if ((state.calls != args_num) || (state.failed != 0) || state.out_of_order) {
+    fprintf(stderr,
+            "callbacks: %zu calls, %zu failed, out of order: %d; want %zu "
+            "calls, 0 failed, in order\n",
+            state.calls, state.failed, (int)state.out_of_order, args_num);
+    ret = -1;
+  }
+
+  if (ret == 0)
+    printf("ok - group size\n");
+  return ret;
+}
+
+static int test_error_callbacks() {
+  int ret = 0;
+  fake_server_t s = {0};
+  pthread_t thread;
+  lcc_connection_t *c = fake_connect(&s, &thread);
+  if (c == NULL) {
+    fprintf(stderr, "fake_connect() failed\n");
+    return -1;
+  }
+
+  lcc_set_putval_group_size(c, 2);
+
+  /* One response covers all value lists of a command, so both value lists of
+   * the first command fail. */
+  char const *plugin_instances[] = {"ok", "fail", "ok", "ok"};
+  size_t num = sizeof(plugin_instances) / sizeof(plugin_instances[0]);
+  callback_state_t state[4] = {{0}};
+  callback_arg_t args[4];
+
+  for (size_t i = 0; i < num; i++) {
+    lcc_value_list_t vl = test_vl(plugin_instances[i]);
+    args[i] = (callback_arg_t){.state = state + i};
+    if (lcc_putval_async(c, &vl, test_callback, args + i) != 0) {
+      fprintf(stderr, "lcc_putval_async() failed: %s\n", lcc_strerror(c));
+      ret = -1;
+    }
+  }
+
+  /* Server errors are reported to the callbacks, not by lcc_wait(). */
+  int status = lcc_wait(c);
+  if (status != 0) {
+    fprintf(stderr, "lcc_wait() = %d, want 0: %s\n", status, lcc_strerror(c));
+    ret = -1;
+  }
+
+  fake_disconnect(c, thread);
+
+  size_t want_failed[] = {1, 1, 0, 0};
+  for (size_t i = 0; i < num; i++) {
+    if ((state[i].calls != 1) || (state[i].failed != want_failed[i])) {
+      fprintf(stderr,
+              "callback %zu: %zu calls, %zu failed; want 1 call, %zu failed\n",
+              i, state[i].calls, state[i].failed, want_failed[i]);
+      ret = -1;
+    }
+  }
+  if (strcmp(state[0].message, "Parsing the value list failed.") != 0) {
+    fprintf(stderr, "callback message = \"%s\", want the server's message\n",
+            state[0].message);
+    ret = -1;
+  }
+
+  if (ret == 0)
+    printf("ok - error callbacks\n");
+  return ret;
+}
+
+static int test_connection_lost() {
+  int ret = 0;
+  fake_server_t s = {.hangup_after = 1};
+  pthread_t thread;
+  lcc_connection_t *c = fake_connect(&s, &thread);
+  if (c == NULL) {
+    fprintf(stderr, "fake_connect() failed\n");
+    return -1;
+  }
+
+  lcc_value_list_t vl = test_vl("");
+  callback_state_t state = {0};
+  callback_arg_t args[2];
+  size_t args_num = sizeof(args) / sizeof(args[0]);
+
+  for (size_t i = 0; i < args_num; i++) {
+    args[i] = (callback_arg_t){.state = &state, .index = i};
+    if (lcc_putval_async(c, &vl, test_callback, args + i) != 0) {
+      fprintf(stderr, "lcc_putval_async() failed: %s\n", lcc_strerror(c));
+      ret = -1;
+    }
+  }
+
+  /* All pending value lists fail if the connection is lost. */
+  if (lcc_wait(c) == 0) {
+    fprintf(stderr, "lcc_wait() succeeded, want error\n");
+    ret = -1;
+  }
+
+  fake_disconnect(c, thread);
+
+  if ((state.calls != args_num) || (state.failed != args_num)) {
+    fprintf(stderr,
+            "callbacks: %zu calls, %zu failed; want %zu calls, all failed\n",
+            state.calls, state.failed, args_num);
+    ret = -1;
+  }
+
+  if (ret == 0)
+    printf("ok - connection lost\n");
+  return ret;
+}
+
+static int test_putval_batch() {
+  int ret = 0;
+  fake_server_t s = {0};
+  pthread_t thread;
+  lcc_connection_t *c = fake_connect(&s, &thread);
+  if (c == NULL) {
+    fprintf(stderr, "fake_connect() failed\n");
+    return -1;
+  }
+
+  lcc_value_list_t vl[5];
+  size_t vl_num = sizeof(vl) / sizeof(vl[0]);
+  for (size_t i = 0; i < vl_num; i++)
+    vl[i] = test_vl("");
+
+  int status = lcc_putval_batch(c, vl, vl_num);
+  if (status != 0) {
+    fprintf(stderr, "lcc_putval_batch() = %d, want 0: %s\n", status,
+            lcc_strerror(c));
+    ret = -1;
+  }
+
+  vl[3] = test_vl("fail");
+  status = lcc_putval_batch(c, vl, vl_num);
+  if (status == 0) {
+    fprintf(stderr, "lcc_putval_batch() succeeded, want error\n");
+    ret = -1;
+  } else if (strstr(lcc_strerror(c), "(1 of 5 value lists)") == NULL) {
+    fprintf(stderr, "lcc_strerror() = \"%s\", want the number of failed value "
+                    "lists\n",
+            lcc_strerror(c));
+    ret = -1;
+  }
+
+  /* The connection remains usable. */
+  status = lcc_putval_batch(c, vl, 3);
+  if (status != 0) {
+    fprintf(stderr, "lcc_putval_batch() = %d, want 0: %s\n", status,
+            lcc_strerror(c));
+    ret = -1;
+  }
+
+  fake_disconnect(c, thread);
+
+  if (s.value_lists_num != 2 * vl_num + 3) {
+    fprintf(stderr, "server received %zu value lists, want %zu\n",
+            s.value_lists_num, 2 * vl_num + 3);
+    ret = -1;
+  }
+
+  if (ret == 0)
+    printf("ok - lcc_putval_batch\n");
+  return ret;
+}
+
+int main(void) {
+  int ret = 0;
+
+  /* The fake server closes the connection in test_connection_lost(). */
+  signal(SIGPIPE, SIG_IGN);
+
+  int status;
+  if ((status = test_pipeline_depth())) {
+    ret = status;
+  }
+  if ((status = test_group_size())) {
+    ret = status;
+  }
+  if ((status = test_error_callbacks())) {
+    ret = status;
+  }
+  if ((status = test_connection_lost())) {
+    ret = status;
+  }
+  if ((status = test_putval_batch())) {
+    ret = status;
+  }
+
+  return ret;
+}
@@ -66,6 +66,34 @@ int lcc_getval(lcc_connection_t *c, lcc_identifier_t *ident,
 
 int lcc_putval(lcc_connection_t *c, const lcc_value_list_t *vl);
 
+/* Callback for lcc_putval_async(). "status" is zero if the daemon accepted the
+ * value list and non-zero otherwise; "message" is the daemon's response or a
+ * description of the local error. The connection must not be used from within
+ * the callback. */
+typedef void (*lcc_putval_callback_t)(int status, const char *message,
+                                      void *user_data);
+
+/* Submits a value list without waiting for the daemon's response. Commands are
+ * buffered and pipelined; responses are read when too many commands are in
+ * flight and by lcc_wait(), which is when "callback" (may be NULL) is called.
+ * Returns non-zero only if the value list could not be submitted. */
+int lcc_putval_async(lcc_connection_t *c, const lcc_value_list_t *vl,
+                     lcc_putval_callback_t callback, void *user_data);
+
+/* Sends all buffered commands and reads the outstanding responses. */
+int lcc_wait(lcc_connection_t *c);
+
+/* Submits "vl_num" value lists pipelined and waits for all responses. Returns
+ * zero if the daemon accepted all of them. */
+int lcc_putval_batch(lcc_connection_t *c, const lcc_value_list_t *vl,
+                     size_t vl_num);
+
+/* Sets how many value lists lcc_putval_async() packs into one PUTVAL command.
+ * Values greater than one require a daemon that accepts several identifiers,
+ * separated by ";", in one PUTVAL command. If the daemon rejects such a
+ * command, all of its value lists fail. Defaults to one. */
+int lcc_set_putval_group_size(lcc_connection_t *c, size_t group_size);
+
 int lcc_flush(lcc_connection_t *c, const char *plugin, lcc_identifier_t *ident,
               int timeout);
 
@@ -51,6 +51,37 @@ typedef struct {
 int lcc_network_parse(void *buffer, size_t buffer_size,
                       lcc_network_parse_options_t opts);
 
+/* lcc_network_parse_result_t holds the value lists decoded by
+ * lcc_network_parse_bulk(). The "values" and "values_types" arrays of the
+ * value lists point into storage owned by this struct. It is reused by the
+ * next call, so a consumer decoding packet after packet does not allocate
+ * memory per value list, and only needs to free it once, using
+ * lcc_network_parse_result_free(). Initialize with
+ * LCC_NETWORK_PARSE_RESULT_INIT. */
+typedef struct {
+  lcc_value_list_t *value_lists;
+  size_t value_lists_num;
+
+  /* Storage; not to be accessed directly. */
+  size_t value_lists_size;
+  value_t *values;
+  int *values_types;
+  size_t values_num;
+  size_t values_size;
+} lcc_network_parse_result_t;
+#define LCC_NETWORK_PARSE_RESULT_INIT                                          \
+  { .value_lists = NULL }
+
+/* lcc_network_parse_bulk parses data received from the network and stores all
+ * value lists in "result", replacing its previous contents. "opts.writer" is
+ * not used. If an error occurs, "result" holds the value lists decoded before
+ * the error. */
+int lcc_network_parse_bulk(void *buffer, size_t buffer_size,
+                           lcc_network_parse_result_t *result,
+                           lcc_network_parse_options_t opts);
+
+void lcc_network_parse_result_free(lcc_network_parse_result_t *result);
+
 LCC_END_DECLS
 
 #endif /* LIBCOLLECTD_NETWORK_PARSE_H */
@@ -66,7 +66,16 @@ GCRY_THREAD_OPTION_PTHREAD_IMPL;
 /* forward declaration because parse_sign_sha256()/parse_encrypt_aes256() and
  * network_parse() need to call each other. */
 static int network_parse(void *data, size_t data_size, lcc_security_level_t sl,
-                         lcc_network_parse_options_t const *opts);
+                         lcc_network_parse_options_t const *opts,
+                         lcc_network_parse_result_t *result);
+
+/* Gauges are transmitted in x86 byte order, i.e. on little endian hosts they
+ * can be copied as they are. */
+#if (defined(BYTE_ORDER) && defined(LITTLE_ENDIAN) &&                          \
+     (BYTE_ORDER == LITTLE_ENDIAN)) ||                                         \
+    (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__))
+#define GAUGE_HOST_BYTE_ORDER 1
+#endif
 
 #if HAVE_GCRYPT_H
 static int init_gcrypt(void) {
@@ -117,6 +126,19 @@ static int buffer_next(buffer_t *b, void *out, size_t n) {
   return 0;
 }
 
+/* buffer_skip returns a pointer to the next "n" bytes of the buffer without
+ * copying them. */
+static uint8_t *buffer_skip(buffer_t *b, size_t n) {
+  if (b->len < n)
+    return NULL;
+
+  uint8_t *ret = b->data;
+  b->data += n;
+  b->len -= n;
+
+  return ret;
+}
+
 static int buffer_uint16(buffer_t *b, uint16_t *out) {
   uint16_t tmp;
   if (buffer_next(b, &tmp, sizeof(tmp)) != 0)
@@ -165,31 +187,32 @@ static int parse_string(void *payload, size_t payload_size, char *out,
 
 static int parse_identifier(uint16_t type, void *payload, size_t payload_size,
                             lcc_value_list_t *state) {
-  char buf[LCC_NAME_LEN];
-
-  if (parse_string(payload, payload_size, buf, sizeof(buf)) != 0)
-    return EINVAL;
+  char *field;
 
   switch (type) {
   case TYPE_HOST:
-    memmove(state->identifier.host, buf, LCC_NAME_LEN);
+    field = state->identifier.host;
     break;
   case TYPE_PLUGIN:
-    memmove(state->identifier.plugin, buf, LCC_NAME_LEN);
+    field = state->identifier.plugin;
     break;
   case TYPE_PLUGIN_INSTANCE:
-    memmove(state->identifier.plugin_instance, buf, LCC_NAME_LEN);
+    field = state->identifier.plugin_instance;
     break;
   case TYPE_TYPE:
-    memmove(state->identifier.type, buf, LCC_NAME_LEN);
+    field = state->identifier.type;
     break;
   case TYPE_TYPE_INSTANCE:
-    memmove(state->identifier.type_instance, buf, LCC_NAME_LEN);
+    field = state->identifier.type_instance;
     break;
   default:
     return EINVAL;
   }
 
+  /* parse_string() checks the payload before writing to "field". */
+  if (parse_string(payload, payload_size, field, LCC_NAME_LEN) != 0)
+    return EINVAL;
+
   return 0;
 }
 
@@ -220,6 +243,7 @@ static int parse_time(uint16_t type, void *payload, size_t payload_size,
   return 0;
 }
 
+#if !GAUGE_HOST_BYTE_ORDER
 static double ntohd(double val) /* {{{ */
 {
   static int config;
@@ -289,9 +313,11 @@ static double ntohd(double val) /* {{{ */
     return val;
   }
 } /* }}} double ntohd */
+#endif
 
-static int parse_values(void *payload, size_t payload_size,
-                        lcc_value_list_t *state) {
+/* parse_values_num returns the number of values in a "values" part. */
+static int parse_values_num(void *payload, size_t payload_size,
+                            size_t *ret_num) {
   buffer_t *b = &(buffer_t){
       .data = payload,
       .len = payload_size,
@@ -301,53 +327,59 @@ static int parse_values(void *payload, size_t payload_size,
   if (buffer_uint16(b, &n))
     return EINVAL;
 
-  if (((size_t)n * 9) != b->len)
+  /* Value lists without values are invalid; they would also make the
+   * arrays in handle_values() zero-length. */
+  if ((n == 0) || (((size_t)n * 9) != b->len))
     return EINVAL;
 
-  state->values_len = (size_t)n;
-  state->values = calloc(state->values_len, sizeof(*state->values));
-  state->values_types = calloc(state->values_len, sizeof(*state->values_types));
-  if ((state->values == NULL) || (state->values_types == NULL)) {
-    return ENOMEM;
-  }
+  *ret_num = (size_t)n;
+  return 0;
+}
+
+/* parse_values decodes a "values" part into "state". "state->values" and
+ * "state->values_types" must have room for the number of values returned by
+ * parse_values_num(). */
+static int parse_values(void *payload, size_t payload_size,
+                        lcc_value_list_t *state) {
+  size_t n;
+  if (parse_values_num(payload, payload_size, &n))
+    return EINVAL;
 
-  for (uint16_t i = 0; i < n; i++) {
-    uint8_t tmp;
-    if (buffer_next(b, &tmp, sizeof(tmp)))
+  uint8_t const *types = (uint8_t *)payload + sizeof(uint16_t);
+  uint8_t const *raw = types + n;
+
+  for (size_t i = 0; i < n; i++) {
+    if (types[i] > LCC_TYPE_ABSOLUTE)
       return EINVAL;
-    state->values_types[i] = (int)tmp;
+    state->values_types[i] = (int)types[i];
   }
 
-  for (uint16_t i = 0; i < n; i++) {
-    uint64_t tmp;
-    if (buffer_next(b, &tmp, sizeof(tmp)))
-      return EINVAL;
+  /* Copy all values at once, then convert them in place. Counters, derives
+   * and absolutes are big endian; all values are swapped in one loop without
+   * branches, which compilers can vectorize, and gauges are fixed up after. */
+  memcpy(state->values, raw, n * sizeof(*state->values));
+
+  uint64_t *v = (uint64_t *)state->values;
+  for (size_t i = 0; i < n; i++)
+    v[i] = be64toh(v[i]);
 
-    if (state->values_types[i] == LCC_TYPE_GAUGE) {
-      union {
-        uint64_t i;
-        double d;
-      } conv = {.i = tmp};
-      state->values[i].gauge = ntohd(conv.d);
+  for (size_t i = 0; i < n; i++) {
+    if (types[i] != LCC_TYPE_GAUGE)
       continue;
-    }
 
-    tmp = be64toh(tmp);
-    switch (state->values_types[i]) {
-    case LCC_TYPE_COUNTER:
-      state->values[i].counter = (counter_t)tmp;
-      break;
-    case LCC_TYPE_DERIVE:
-      state->values[i].derive = (derive_t)tmp;
-      break;
-    case LCC_TYPE_ABSOLUTE:
-      state->values[i].absolute = (absolute_t)tmp;
-      break;
-    default:
-      return EINVAL;
-    }
+#if GAUGE_HOST_BYTE_ORDER
+    v[i] = htobe64(v[i]);
+#else
+    union {
+      uint64_t i;
+      double d;
+    } conv;
+    memcpy(&conv.i, raw + 8 * i, sizeof(conv.i));
+    state->values[i].gauge = ntohd(conv.d);
+#endif
   }
 
+  state->values_len = n;
   return 0;
 }
 
@@ -396,11 +428,12 @@ static int verify_sha256(__attribute__((unused)) void *payload,
 
 static int parse_sign_sha256(void *signature, size_t signature_len,
                              void *payload, size_t payload_size,
-                             lcc_network_parse_options_t const *opts) {
+                             lcc_network_parse_options_t const *opts,
+                             lcc_network_parse_result_t *result) {
   if (opts->password_lookup == NULL) {
     /* The sender signed the packet but we can't verify it. Handle it as if it
      * were unsigned, i.e. security level NONE. */
-    return network_parse(payload, payload_size, NONE, opts);
+    return network_parse(payload, payload_size, NONE, opts, result);
   }
 
   buffer_t *b = &(buffer_t){
@@ -420,13 +453,13 @@ static int parse_sign_sha256(void *signature, size_t signature_len,
 
   char const *password = opts->password_lookup(username);
   if (!password)
-    return network_parse(payload, payload_size, NONE, opts);
+    return network_parse(payload, payload_size, NONE, opts, result);
 
   int status = verify_sha256(payload, payload_size, username, password, hash);
   if (status != 0)
     return status;
 
-  return network_parse(payload, payload_size, SIGN, opts);
+  return network_parse(payload, payload_size, SIGN, opts, result);
 }
 
 #if HAVE_GCRYPT_H
@@ -455,7 +488,8 @@ static int decrypt_aes256(buffer_t *b, void *iv, size_t iv_size,
 }
 
 static int parse_encrypt_aes256(void *data, size_t data_size,
-                                lcc_network_parse_options_t const *opts) {
+                                lcc_network_parse_options_t const *opts,
+                                lcc_network_parse_result_t *result) {
   if (opts->password_lookup == NULL) {
     /* Without a password source it's (hopefully) impossible to decrypt the
      * network packet. */
@@ -501,19 +535,67 @@ static int parse_encrypt_aes256(void *data, size_t data_size,
     return -1;
   }
 
-  return network_parse(b->data, b->len, ENCRYPT, opts);
+  return network_parse(b->data, b->len, ENCRYPT, opts, result);
 }
 #else /* !HAVE_GCRYPT_H */
 static int parse_encrypt_aes256(__attribute__((unused)) void *data,
                                 __attribute__((unused)) size_t data_size,
                                 __attribute__((unused))
-                                lcc_network_parse_options_t const *opts) {
+                                lcc_network_parse_options_t const *opts,
+                                __attribute__((unused))
+                                lcc_network_parse_result_t *result) {
   return ENOTSUP;
 }
 #endif
 
+/* handle_values decodes a "values" part and either passes the value list to
+ * the writer or appends it to "result". */
+static int handle_values(void *payload, size_t payload_size,
+                         lcc_value_list_t const *state, lcc_security_level_t sl,
+                         lcc_network_parse_options_t const *opts,
+                         lcc_network_parse_result_t *result) {
+  size_t n;
+  if (parse_values_num(payload, payload_size, &n))
+    return EINVAL;
+
+  /* Value lists without the required security level are dropped. */
+  if (sl < opts->security_level)
+    return 0;
+
+  if (result == NULL) {
+    value_t values[n];
+    int values_types[n];
+
+    lcc_value_list_t vl = *state;
+    vl.values = values;
+    vl.values_types = values_types;
+    if (parse_values(payload, payload_size, &vl))
+      return EINVAL;
+
+    return opts->writer(&vl);
+  }
+
+  /* lcc_network_parse_bulk() reserved enough space for the whole packet, so
+   * the arrays are never reallocated while parsing. */
+  if ((result->value_lists_num >= result->value_lists_size) ||
+      (n > result->values_size - result->values_num))
+    return ENOMEM;
+
+  lcc_value_list_t *vl = result->value_lists + result->value_lists_num;
+  *vl = *state;
+  vl->values = result->values + result->values_num;
+  vl->values_types = result->values_types + result->values_num;
+  if (parse_values(payload, payload_size, vl))
+    return EINVAL;
+
+  result->value_lists_num++;
+  result->values_num += n;
+  return 0;
+}
+
 static int network_parse(void *data, size_t data_size, lcc_security_level_t sl,
-                         lcc_network_parse_options_t const *opts) {
+                         lcc_network_parse_options_t const *opts,
+                         lcc_network_parse_result_t *result) {
   buffer_t *b = &(buffer_t){
       .data = data,
       .len = data_size,
@@ -536,8 +618,10 @@ static int network_parse(void *data, size_t data_size, lcc_security_level_t sl,
     }
     sz -= 4;
 
-    uint8_t payload[sz];
-    if (buffer_next(b, payload, sizeof(payload)))
+    /* Parts are parsed in place; only encrypted parts, which are decrypted
+     * in place, are copied. */
+    uint8_t *payload = buffer_skip(b, (size_t)sz);
+    if (payload == NULL)
       return EINVAL;
 
     switch (type) {
@@ -546,7 +630,7 @@ static int network_parse(void *data, size_t data_size, lcc_security_level_t sl,
     case TYPE_PLUGIN_INSTANCE:
     case TYPE_TYPE:
     case TYPE_TYPE_INSTANCE: {
-      if (parse_identifier(type, payload, sizeof(payload), &state)) {
+      if (parse_identifier(type, payload, sz, &state)) {
         DEBUG("lcc_network_parse(): parse_identifier failed.\n");
         return EINVAL;
       }
@@ -557,7 +641,7 @@ static int network_parse(void *data, size_t data_size, lcc_security_level_t sl,
     case TYPE_INTERVAL_HR:
     case TYPE_TIME:
     case TYPE_TIME_HR: {
-      if (parse_time(type, payload, sizeof(payload), &state)) {
+      if (parse_time(type, payload, sz, &state)) {
         DEBUG("lcc_network_parse(): parse_time failed.\n");
         return EINVAL;
       }
@@ -565,23 +649,9 @@ static int network_parse(void *data, size_t data_size, lcc_security_level_t sl,
     }
 
     case TYPE_VALUES: {
-      lcc_value_list_t vl = state;
-      if (parse_values(payload, sizeof(payload), &vl)) {
-        free(vl.values);
-        free(vl.values_types);
+      int status = handle_values(payload, sz, &state, sl, opts, result);
+      if (status == EINVAL)
         DEBUG("lcc_network_parse(): parse_values failed.\n");
-        return EINVAL;
-      }
-
-      int status = 0;
-
-      /* Write metrics if they have the required security level. */
-      if (sl >= opts->security_level)
-        status = opts->writer(&vl);
-
-      free(vl.values);
-      free(vl.values_types);
-
       if (status != 0)
         return status;
       break;
@@ -589,7 +659,7 @@ static int network_parse(void *data, size_t data_size, lcc_security_level_t sl,
 
     case TYPE_SIGN_SHA256: {
       int status =
-          parse_sign_sha256(payload, sizeof(payload), b->data, b->len, opts);
+          parse_sign_sha256(payload, sz, b->data, b->len, opts, result);
       if (status != 0) {
         DEBUG("lcc_network_parse(): parse_sign_sha256() = %d\n", status);
         return -1;
@@ -601,7 +671,11 @@ static int network_parse(void *data, size_t data_size, lcc_security_level_t sl,
     }
 
     case TYPE_ENCR_AES256: {
-      int status = parse_encrypt_aes256(payload, sizeof(payload), opts);
+      uint8_t encrypted[sz];
+      memcpy(encrypted, payload, sizeof(encrypted));
+
+      int status =
+          parse_encrypt_aes256(encrypted, sizeof(encrypted), opts, result);
       if (status != 0) {
         DEBUG("lcc_network_parse(): parse_encrypt_aes256() = %d\n", status);
         return -1;
@@ -619,9 +693,8 @@ static int network_parse(void *data, size_t data_size, lcc_security_level_t sl,
   return 0;
 }
 
-int lcc_network_parse(void *data, size_t data_size,
-                      lcc_network_parse_options_t opts) {
-  if (opts.password_lookup) {
+static int init_password_lookup(lcc_network_parse_options_t const *opts) {
+  if (opts->password_lookup) {
 #if HAVE_GCRYPT_H
     int status;
     if ((status = init_gcrypt())) {
@@ -632,5 +705,69 @@ int lcc_network_parse(void *data, size_t data_size,
 #endif
   }
 
-  return network_parse(data, data_size, NONE, &opts);
+  return 0;
+}
+
+int lcc_network_parse(void *data, size_t data_size,
+                      lcc_network_parse_options_t opts) {
+  int status = init_password_lookup(&opts);
+  if (status != 0)
+    return status;
+
+  return network_parse(data, data_size, NONE, &opts, /* result = */ NULL);
+}
+
+/* reserve grows "*array" to hold at least "num" elements of "elem_size"
+ * bytes. */
+static int reserve(void **array, size_t *size, size_t num, size_t elem_size) {
+  if (*size >= num)
+    return 0;
+
+  void *tmp = realloc(*array, num * elem_size);
+  if (tmp == NULL)
+    return ENOMEM;
+
+  *array = tmp;
+  *size = num;
+  return 0;
+}
+
+int lcc_network_parse_bulk(void *data, size_t data_size,
+                           lcc_network_parse_result_t *result,
+                           lcc_network_parse_options_t opts) {
+  if (result == NULL)
+    return EINVAL;
+
+  result->value_lists_num = 0;
+  result->values_num = 0;
+
+  int status = init_password_lookup(&opts);
+  if (status != 0)
+    return status;
+
+  /* Every value takes at least nine bytes and every value list at least one
+   * "values" part header plus one value, so this is enough for any packet. */
+  size_t max_values = data_size / 9 + 1;
+  size_t max_value_lists = data_size / 15 + 1;
+
+  size_t values_types_size = result->values_size;
+  if (reserve((void **)&result->value_lists, &result->value_lists_size,
+              max_value_lists, sizeof(*result->value_lists)) ||
+      reserve((void **)&result->values_types, &values_types_size, max_values,
+              sizeof(*result->values_types)) ||
+      reserve((void **)&result->values, &result->values_size, max_values,
+              sizeof(*result->values)))
+    return ENOMEM;
+
+  return network_parse(data, data_size, NONE, &opts, result);
+}
+
+void lcc_network_parse_result_free(lcc_network_parse_result_t *result) {
+  if (result == NULL)
+    return;
+
+  free(result->value_lists);
+  free(result->values);
+  free(result->values_types);
+  *result = (lcc_network_parse_result_t){0};
 }
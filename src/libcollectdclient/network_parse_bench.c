@@ -0,0 +1,186 @@
+/**
+ * libcollectdclient - src/libcollectdclient/network_parse_bench.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+/* network_parse_bench compares decoding network packets with
+ * lcc_network_parse(), which calls a writer for every value list, with
+ * lcc_network_parse_bulk(), which decodes each packet into a reused result.
+ * It is not run as part of "make check"; build it with
+ * "make bench_network_parse" and run "./bench_network_parse [iterations]". */
+
+#include "config.h"
+
+#include "collectd/network_buffer.h"
+#include "collectd/network_parse.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_PACKETS 64
+
+static uint8_t packets[BENCH_PACKETS][LCC_NETWORK_BUFFER_SIZE_DEFAULT];
+static size_t packets_size[BENCH_PACKETS];
+
+/* The benchmarks sum up the values so that the decoding can not be optimized
+ * away. */
+static uint64_t checksum;
+
+static int sum_writer(lcc_value_list_t const *vl) {
+  for (size_t i = 0; i < vl->values_len; i++)
+    checksum += vl->values[i].counter;
+  return 0;
+}
+
+static int bench_writer(size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    size_t n = i % BENCH_PACKETS;
+    int status = lcc_network_parse(packets[n], packets_size[n],
+                                   (lcc_network_parse_options_t){
+                                       .writer = sum_writer,
+                                   });
+    if (status != 0)
+      return status;
+  }
+  return 0;
+}
+
+static int bench_bulk(size_t iterations) {
+  lcc_network_parse_result_t result = LCC_NETWORK_PARSE_RESULT_INIT;
+
+  for (size_t i = 0; i < iterations; i++) {
+    size_t n = i % BENCH_PACKETS;
+    int status = lcc_network_parse_bulk(packets[n], packets_size[n], &result,
+                                        (lcc_network_parse_options_t){0});
+    if (status != 0) {
+      lcc_network_parse_result_free(&result);
+      return status;
+    }
+
+    for (size_t j = 0; j < result.value_lists_num; j++)
+      sum_writer(result.value_lists + j);
+  }
+
+  lcc_network_parse_result_free(&result);
+  return 0;
+}
+
+static int create_packets(void) {
+  lcc_network_buffer_t *nb =
+      lcc_network_buffer_create(LCC_NETWORK_BUFFER_SIZE_DEFAULT);
+  if (nb == NULL)
+    return ENOMEM;
+
+  value_t values[4];
+  int values_types[4] = {LCC_TYPE_GAUGE, LCC_TYPE_DERIVE, LCC_TYPE_GAUGE,
+                         LCC_TYPE_COUNTER};
+  lcc_value_list_t vl = {
+      .values = values,
+      .values_types = values_types,
+      .time = 1480063672.0,
+      .interval = 10.0,
+      .identifier =
+          {
+              .plugin = "interface",
+              .type = "if_octets",
+          },
+  };
+
+  size_t vl_num = 0;
+  for (size_t i = 0; i < BENCH_PACKETS; i++) {
+    lcc_network_buffer_initialize(nb);
+
+    while (42) {
+      snprintf(vl.identifier.host, sizeof(vl.identifier.host),
+               "host%03zu.example.com", (vl_num / 16) % 100);
+      snprintf(vl.identifier.plugin_instance,
+               sizeof(vl.identifier.plugin_instance), "eth%zu", vl_num % 16);
+      vl.values_len = 1 + vl_num % 4;
+      for (size_t j = 0; j < vl.values_len; j++)
+        values[j].counter = (uint64_t)(vl_num * 4 + j);
+
+      if (lcc_network_buffer_add_value(nb, &vl) != 0)
+        break;
+      vl_num++;
+    }
+
+    lcc_network_buffer_finalize(nb);
+    packets_size[i] = sizeof(packets[i]);
+    lcc_network_buffer_get(nb, packets[i], &packets_size[i]);
+  }
+
+  lcc_network_buffer_destroy(nb);
+  return 0;
+}
+
+static double monotonic_seconds(void) {
+  struct timespec ts = {0};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  size_t iterations = 1000000;
+  if (argc > 1)
+    iterations = (size_t)strtoull(argv[1], NULL, 10);
+  if (iterations == 0) {
+    fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  if (create_packets() != 0) {
+    fprintf(stderr, "create_packets failed\n");
+    return 1;
+  }
+
+  struct {
+    char const *name;
+    int (*func)(size_t iterations);
+  } benchmarks[] = {
+      {"lcc_network_parse", bench_writer},
+      {"lcc_network_parse_bulk", bench_bulk},
+  };
+
+  for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+    checksum = 0;
+
+    double start = monotonic_seconds();
+    int status = benchmarks[i].func(iterations);
+    double elapsed = monotonic_seconds() - start;
+
+    if (status != 0) {
+      fprintf(stderr, "%s failed with status %d\n", benchmarks[i].name, status);
+      return 1;
+    }
+
+    printf("%-24s %8.1f ns/packet (checksum %" PRIu64 ")\n", benchmarks[i].name,
+           1e9 * elapsed / (double)iterations, checksum);
+  }
+
+  return 0;
+}
@@ -269,6 +269,98 @@ static int test_network_parse() {
   return ret;
 }
 
+static lcc_value_list_t written[128];
+static value_t written_values[128][4];
+static size_t written_num;
+
+static int copy_writer(lcc_value_list_t const *vl) {
+  if ((written_num >= sizeof(written) / sizeof(written[0])) ||
+      (vl->values_len > sizeof(written_values[0]) / sizeof(value_t)))
+    return ENOMEM;
+
+  written[written_num] = *vl;
+  written[written_num].values = written_values[written_num];
+  written[written_num].values_types = NULL;
+  memcpy(written_values[written_num], vl->values,
+         vl->values_len * sizeof(*vl->values));
+  written_num++;
+  return 0;
+}
+
+static int test_network_parse_bulk() {
+  int ret = 0;
+  lcc_network_parse_result_t result = LCC_NETWORK_PARSE_RESULT_INIT;
+
+  for (size_t i = 0; i < sizeof(raw_packet_data) / sizeof(raw_packet_data[0]);
+       i++) {
+    uint8_t buffer[LCC_NETWORK_BUFFER_SIZE_DEFAULT];
+    size_t buffer_size = sizeof(buffer);
+    if (decode_string(raw_packet_data[i], buffer, &buffer_size)) {
+      fprintf(stderr, "lcc_network_parse_bulk(raw_packet_data[%" PRIsz "]):"
+                      " decoding string failed\n",
+              i);
+      return -1;
+    }
+
+    written_num = 0;
+    int status = lcc_network_parse(buffer, buffer_size,
+                                   (lcc_network_parse_options_t){
+                                       .writer = copy_writer,
+                                   });
+    if (status != 0) {
+      fprintf(stderr,
+              "lcc_network_parse(raw_packet_data[%" PRIsz "]) = %d, want 0\n",
+              i, status);
+      ret = -1;
+      continue;
+    }
+
+    /* The result is reused from the previous packet. */
+    status = lcc_network_parse_bulk(buffer, buffer_size, &result,
+                                    (lcc_network_parse_options_t){0});
+    if (status != 0) {
+      fprintf(stderr,
+              "lcc_network_parse_bulk(raw_packet_data[%" PRIsz
+              "]) = %d, want 0\n",
+              i, status);
+      ret = -1;
+      continue;
+    }
+
+    if (result.value_lists_num != written_num) {
+      fprintf(stderr,
+              "lcc_network_parse_bulk(raw_packet_data[%" PRIsz "]): got %" PRIsz
+              " value lists, want %" PRIsz "\n",
+              i, result.value_lists_num, written_num);
+      ret = -1;
+      continue;
+    }
+
+    for (size_t j = 0; j < written_num; j++) {
+      lcc_value_list_t const *got = result.value_lists + j;
+      lcc_value_list_t const *want = written + j;
+
+      if ((memcmp(&got->identifier, &want->identifier,
+                  sizeof(got->identifier)) != 0) ||
+          (got->time != want->time) || (got->interval != want->interval) ||
+          (got->values_len != want->values_len) ||
+          (memcmp(got->values, want->values,
+                  got->values_len * sizeof(*got->values)) != 0)) {
+        fprintf(stderr,
+                "lcc_network_parse_bulk(raw_packet_data[%" PRIsz
+                "]): value list %" PRIsz " differs\n",
+                i, j);
+        ret = -1;
+      }
+    }
+
+    printf("ok - lcc_network_parse_bulk(raw_packet_data[%" PRIsz "])\n", i);
+  }
+
+  lcc_network_parse_result_free(&result);
+  return ret;
+}
+
 static int test_parse_time() {
   int ret = 0;
 
@@ -369,7 +461,11 @@ static int test_parse_values() {
       0, 0, 0, 0, 0, 0, 0xf8, 0x7f, // NaN
   };
 
+  value_t values[3];
+  int values_types[3];
   lcc_value_list_t vl = LCC_VALUE_LIST_INIT;
+  vl.values = values;
+  vl.values_types = values_types;
   int status = parse_values(testcase, sizeof(testcase), &vl);
   if (status != 0) {
     fprintf(stderr, "parse_values() = %d, want 0\n", status);
@@ -408,8 +504,15 @@ static int test_parse_values() {
     ret = -1;
   }
 
-  free(vl.values);
-  free(vl.values_types);
+  uint8_t empty[] = {
+      0, 0, // num values
+  };
+  status = parse_values(empty, sizeof(empty), &vl);
+  if (status != EINVAL) {
+    fprintf(stderr, "parse_values(<no values>) = %d, want %d\n", status,
+            EINVAL);
+    ret = status ? status : -1;
+  }
 
   return ret;
 }
@@ -495,6 +598,9 @@ int main(void) {
   if ((status = test_network_parse())) {
     ret = status;
   }
+  if ((status = test_network_parse_bulk())) {
+    ret = status;
+  }
   if ((status = test_parse_time())) {
     ret = status;
   }
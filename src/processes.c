@@ -99,6 +99,8 @@
 #ifndef CONFIG_HZ
 #define CONFIG_HZ 100
 #endif
+
+#include "utils/container/hashmap.h"
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKVM_GETPROCS &&                                                  \
@@ -310,6 +312,11 @@ static bool report_fd_num;
 static bool report_maps_num;
 static bool report_delay;
 static bool report_sys_ctxt_switch;
+static int read_threads = 1;
+static int max_open_files;
+#if HAVE_LIBTASKSTATS
+static bool use_taskstats;
+#endif
 
 #if HAVE_THREAD_INFO
 static mach_port_t port_host_self;
@@ -321,7 +328,69 @@ static mach_msg_type_number_t pset_list_len;
 
 #elif KERNEL_LINUX
 static long pagesize_g;
-static void ps_fill_details(const procstat_t *ps, process_entry_t *entry);
+
+/* Number of processes a read thread claims at once. */
+#define PS_SCAN_CHUNK 64
+/* Number of reads a process which matches no Process or ProcessMatch and
+ * whose "stat" file did not change is not matched again for. */
+#define PS_DETAILS_MAX_AGE 6
+/* Size of the per-thread buffer used for reading files below /proc. */
+#define PS_BUFFER_SIZE 16384
+
+/* ps_proc_t caches what is known about one process across reads. Files are
+ * opened relative to dir_fd if the process directory is held open, and by
+ * path otherwise. File descriptors that are not held are -1. */
+typedef struct {
+  long pid;
+
+  int dir_fd;
+  int stat_fd;
+  int status_fd;
+  int io_fd;
+
+  /* Hash of the "stat" file contents, used to skip matching idle processes
+   * which match nothing. */
+  uint64_t stat_hash;
+  bool has_stat;
+  unsigned char age;
+
+  bool seen;
+  bool valid;
+  char state;
+
+  /* Process matches this process is counted towards. */
+  procstat_t **matches;
+  size_t matches_num;
+  /* Only allocated for processes with at least one match. */
+  process_entry_t *entry;
+} ps_proc_t;
+
+typedef struct {
+  pthread_t thread;
+  char buffer[PS_BUFFER_SIZE];
+  char cmdline[CMDLINE_BUFFER_SIZE];
+#if HAVE_LIBTASKSTATS
+  ts_t *ts;
+#endif
+} ps_worker_t;
+
+/* ps_procs_g holds all known processes in the order they were first seen;
+ * ps_procs_by_pid_g indexes them by PID. */
+static c_hashmap_t *ps_procs_by_pid_g;
+static ps_proc_t **ps_procs_g;
+static size_t ps_procs_num_g;
+static size_t ps_procs_size_g;
+/* Index of the next process to be claimed by a read thread. */
+static size_t ps_procs_next_g;
+
+static ps_worker_t *ps_workers_g;
+static size_t ps_workers_num_g;
+
+/* Number of file descriptors held open across reads. */
+static size_t open_files_num_g;
+
+static uint64_t ps_proc_hash(const void *key);
+static int ps_proc_compare(const void *a, const void *b);
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKVM_GETPROCS &&                                                  \
@@ -349,10 +418,6 @@ int getthrds64(pid_t, void *, int, tid64_t *, int);
 int getargs(void *processBuffer, int bufferLen, char *argsBuffer, int argsLen);
 #endif /* HAVE_PROCINFO_H */
 
-#if HAVE_LIBTASKSTATS
-static ts_t *taskstats_handle;
-#endif
-
 /* put name of process from config to list_head_g tree
  * list_head_g is a list of 'procstat_t' structs with
  * processes names we want to watch */
@@ -522,99 +587,101 @@ static void ps_update_delay(procstat_t *out, procstat_entry_t *prev,
 }
 #endif
 
-/* add process entry to 'instances' of process 'name' (or refresh it) */
-static void ps_list_add(const char *name, const char *cmdline,
-                        process_entry_t *entry) {
+/* add process entry to the 'instances' of ps (or refresh it) */
+static void ps_list_add_one(procstat_t *ps, process_entry_t *entry) {
   procstat_entry_t *pse;
 
   if (entry->id == 0)
     return;
 
-  for (procstat_t *ps = list_head_g; ps != NULL; ps = ps->next) {
-    if ((ps_list_match(name, cmdline, ps)) == 0)
-      continue;
+  for (pse = ps->instances; pse != NULL; pse = pse->next)
+    if ((pse->id == entry->id) || (pse->next == NULL))
+      break;
 
-#if KERNEL_LINUX
-    ps_fill_details(ps, entry);
-#endif
+  if ((pse == NULL) || (pse->id != entry->id) ||
+      (pse->starttime != entry->starttime)) {
+    if (pse != NULL && pse->id == entry->id) {
+      WARNING("pid %lu reused between two reads, ignoring existing "
+              "procstat_entry for %s",
+              pse->id, entry->name);
+    }
+    procstat_entry_t *new;
 
-    for (pse = ps->instances; pse != NULL; pse = pse->next)
-      if ((pse->id == entry->id) || (pse->next == NULL))
-        break;
+    new = calloc(1, sizeof(*new));
+    if (new == NULL)
+      return;
+    new->id = entry->id;
+    new->starttime = entry->starttime;
 
-    if ((pse == NULL) || (pse->id != entry->id) ||
-        (pse->starttime != entry->starttime)) {
-      if (pse != NULL && pse->id == entry->id) {
-        WARNING("pid %lu reused between two reads, ignoring existing "
-                "procstat_entry for %s",
-                pse->id, name);
-      }
-      procstat_entry_t *new;
+    if (pse == NULL)
+      ps->instances = new;
+    else
+      pse->next = new;
 
-      new = calloc(1, sizeof(*new));
-      if (new == NULL)
-        return;
-      new->id = entry->id;
-      new->starttime = entry->starttime;
+    pse = new;
+  }
 
-      if (pse == NULL)
-        ps->instances = new;
-      else
-        pse->next = new;
+  pse->age = 0;
 
-      pse = new;
-    }
+  ps->num_proc += entry->num_proc;
+  ps->num_lwp += entry->num_lwp;
+  ps->num_fd += entry->num_fd;
+  ps->num_maps += entry->num_maps;
+  ps->vmem_size += entry->vmem_size;
+  ps->vmem_rss += entry->vmem_rss;
+  ps->vmem_data += entry->vmem_data;
+  ps->vmem_code += entry->vmem_code;
+  ps->stack_size += entry->stack_size;
 
-    pse->age = 0;
-
-    ps->num_proc += entry->num_proc;
-    ps->num_lwp += entry->num_lwp;
-    ps->num_fd += entry->num_fd;
-    ps->num_maps += entry->num_maps;
-    ps->vmem_size += entry->vmem_size;
-    ps->vmem_rss += entry->vmem_rss;
-    ps->vmem_data += entry->vmem_data;
-    ps->vmem_code += entry->vmem_code;
-    ps->stack_size += entry->stack_size;
-
-    if ((entry->io_rchar != -1) && (entry->io_wchar != -1)) {
-      ps_update_counter(&ps->io_rchar, &pse->io_rchar, entry->io_rchar);
-      ps_update_counter(&ps->io_wchar, &pse->io_wchar, entry->io_wchar);
-    }
+  if ((entry->io_rchar != -1) && (entry->io_wchar != -1)) {
+    ps_update_counter(&ps->io_rchar, &pse->io_rchar, entry->io_rchar);
+    ps_update_counter(&ps->io_wchar, &pse->io_wchar, entry->io_wchar);
+  }
 
-    if ((entry->io_syscr != -1) && (entry->io_syscw != -1)) {
-      ps_update_counter(&ps->io_syscr, &pse->io_syscr, entry->io_syscr);
-      ps_update_counter(&ps->io_syscw, &pse->io_syscw, entry->io_syscw);
-    }
+  if ((entry->io_syscr != -1) && (entry->io_syscw != -1)) {
+    ps_update_counter(&ps->io_syscr, &pse->io_syscr, entry->io_syscr);
+    ps_update_counter(&ps->io_syscw, &pse->io_syscw, entry->io_syscw);
+  }
 
-    if ((entry->io_diskr != -1) && (entry->io_diskw != -1)) {
-      ps_update_counter(&ps->io_diskr, &pse->io_diskr, entry->io_diskr);
-      ps_update_counter(&ps->io_diskw, &pse->io_diskw, entry->io_diskw);
-    }
+  if ((entry->io_diskr != -1) && (entry->io_diskw != -1)) {
+    ps_update_counter(&ps->io_diskr, &pse->io_diskr, entry->io_diskr);
+    ps_update_counter(&ps->io_diskw, &pse->io_diskw, entry->io_diskw);
+  }
 
-    if ((entry->cswitch_vol != -1) && (entry->cswitch_invol != -1)) {
-      ps_update_counter(&ps->cswitch_vol, &pse->cswitch_vol,
-                        entry->cswitch_vol);
-      ps_update_counter(&ps->cswitch_invol, &pse->cswitch_invol,
-                        entry->cswitch_invol);
-    }
+  if ((entry->cswitch_vol != -1) && (entry->cswitch_invol != -1)) {
+    ps_update_counter(&ps->cswitch_vol, &pse->cswitch_vol, entry->cswitch_vol);
+    ps_update_counter(&ps->cswitch_invol, &pse->cswitch_invol,
+                      entry->cswitch_invol);
+  }
 
-    ps_update_counter(&ps->vmem_minflt_counter, &pse->vmem_minflt_counter,
-                      entry->vmem_minflt_counter);
-    ps_update_counter(&ps->vmem_majflt_counter, &pse->vmem_majflt_counter,
-                      entry->vmem_majflt_counter);
+  ps_update_counter(&ps->vmem_minflt_counter, &pse->vmem_minflt_counter,
+                    entry->vmem_minflt_counter);
+  ps_update_counter(&ps->vmem_majflt_counter, &pse->vmem_majflt_counter,
+                    entry->vmem_majflt_counter);
 
-    ps_update_counter(&ps->cpu_user_counter, &pse->cpu_user_counter,
-                      entry->cpu_user_counter);
-    ps_update_counter(&ps->cpu_system_counter, &pse->cpu_system_counter,
-                      entry->cpu_system_counter);
+  ps_update_counter(&ps->cpu_user_counter, &pse->cpu_user_counter,
+                    entry->cpu_user_counter);
+  ps_update_counter(&ps->cpu_system_counter, &pse->cpu_system_counter,
+                    entry->cpu_system_counter);
 
 #if HAVE_LIBTASKSTATS
-    if (entry->has_delay)
-      ps_update_delay(ps, pse, entry);
+  if (entry->has_delay)
+    ps_update_delay(ps, pse, entry);
 #endif
+}
+
+#if !KERNEL_LINUX
+/* add process entry to 'instances' of process 'name' (or refresh it) */
+static void ps_list_add(const char *name, const char *cmdline,
+                        process_entry_t *entry) {
+  for (procstat_t *ps = list_head_g; ps != NULL; ps = ps->next) {
+    if ((ps_list_match(name, cmdline, ps)) == 0)
+      continue;
+
+    ps_list_add_one(ps, entry);
   }
 }
+#endif
 
 /* remove old entries from instances of processes in list_head_g */
 static void ps_list_reset(void) {
@@ -750,6 +817,29 @@ static int ps_config(oconfig_item_t *ci) {
 #endif
     } else if (strcasecmp(c->key, "CollectSystemContextSwitch") == 0) {
       cf_util_get_boolean(c, &report_sys_ctxt_switch);
+    } else if (strcasecmp(c->key, "ReadThreads") == 0) {
+      int tmp = read_threads;
+      if (cf_util_get_int(c, &tmp) == 0) {
+        if (tmp < 1)
+          ERROR("processes plugin: `ReadThreads' must be at least one.");
+        else
+          read_threads = tmp;
+      }
+    } else if (strcasecmp(c->key, "MaxOpenFiles") == 0) {
+      int tmp = max_open_files;
+      if (cf_util_get_int(c, &tmp) == 0) {
+        if (tmp < 0)
+          ERROR("processes plugin: `MaxOpenFiles' must not be negative.");
+        else
+          max_open_files = tmp;
+      }
+    } else if (strcasecmp(c->key, "UseTaskstats") == 0) {
+#if HAVE_LIBTASKSTATS
+      cf_util_get_boolean(c, &use_taskstats);
+#else
+      WARNING("processes plugin: The plugin has been compiled without support "
+              "for the \"UseTaskstats\" option.");
+#endif
     } else {
       ERROR("processes plugin: The `%s' configuration option is not "
             "understood and will be ignored.",
@@ -788,14 +878,35 @@ static int ps_init(void) {
   pagesize_g = sysconf(_SC_PAGESIZE);
   DEBUG("pagesize_g = %li; CONFIG_HZ = %i;", pagesize_g, CONFIG_HZ);
 
-#if HAVE_LIBTASKSTATS
-  if (taskstats_handle == NULL) {
-    taskstats_handle = ts_create();
-    if (taskstats_handle == NULL) {
-      WARNING("processes plugin: Creating taskstats handle failed.");
+
+  if (ps_procs_by_pid_g == NULL) {
+    ps_procs_by_pid_g = c_hashmap_create(ps_proc_hash, ps_proc_compare);
+    if (ps_procs_by_pid_g == NULL) {
+      ERROR("processes plugin: c_hashmap_create failed.");
+      return -1;
     }
   }
+
+  if (ps_workers_g == NULL) {
+    ps_workers_g = calloc((size_t)read_threads, sizeof(*ps_workers_g));
+    if (ps_workers_g == NULL) {
+      ERROR("processes plugin: calloc failed.");
+      return -1;
+    }
+    ps_workers_num_g = (size_t)read_threads;
+
+#if HAVE_LIBTASKSTATS
+    /* Netlink sockets can not be shared between threads, so every read thread
+     * gets its own taskstats handle. */
+    for (size_t i = 0; i < ps_workers_num_g; i++) {
+      ps_workers_g[i].ts = ts_create();
+      if (ps_workers_g[i].ts == NULL) {
+        WARNING("processes plugin: Creating taskstats handle failed.");
+        break;
+      }
+    }
 #endif
+  }
   /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKVM_GETPROCS &&                                                  \
@@ -1006,22 +1117,190 @@ static void ps_submit_global_stat(const char *type_name, derive_t value) {
 
 /* ------- additional functions for KERNEL_LINUX/HAVE_THREAD_INFO ------- */
 #if KERNEL_LINUX
-static int ps_read_tasks_status(process_entry_t *ps) {
+static uint64_t ps_proc_hash(const void *key) {
+  /* Multiplicative hashing spreads consecutive PIDs over the table. */
+  uint64_t hash = (uint64_t)(*(const long *)key) * 0x9e3779b97f4a7c15ULL;
+  return hash ^ (hash >> 32);
+}
+
+static int ps_proc_compare(const void *a, const void *b) {
+  long pid_a = *(const long *)a;
+  long pid_b = *(const long *)b;
+
+  return (pid_a > pid_b) - (pid_a < pid_b);
+}
+
+/* FNV-1a hash of the "stat" file contents. */
+static uint64_t ps_hash_buffer(const char *buffer, size_t buffer_len) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  for (size_t i = 0; i < buffer_len; i++) {
+    hash ^= (unsigned char)buffer[i];
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+/* ps_fd_reserve accounts for a file descriptor that is held open across
+ * reads. Returns false if that would exceed the "MaxOpenFiles" budget. */
+static bool ps_fd_reserve(void) {
+  if (max_open_files == 0)
+    return false;
+
+  if (__atomic_add_fetch(&open_files_num_g, 1, __ATOMIC_RELAXED) <=
+      (size_t)max_open_files)
+    return true;
+
+  __atomic_sub_fetch(&open_files_num_g, 1, __ATOMIC_RELAXED);
+  return false;
+}
+
+/* ps_fd_release closes a file descriptor reserved with ps_fd_reserve(). */
+static void ps_fd_release(int *fd) {
+  if (*fd < 0)
+    return;
+
+  close(*fd);
+  *fd = -1;
+  __atomic_sub_fetch(&open_files_num_g, 1, __ATOMIC_RELAXED);
+}
+
+/* ps_proc_open opens the directory of the process, if the budget allows. */
+static void ps_proc_open(ps_proc_t *proc) {
   char dirname[64];
+
+  if (!ps_fd_reserve())
+    return;
+
+  snprintf(dirname, sizeof(dirname), "/proc/%li", proc->pid);
+  proc->dir_fd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (proc->dir_fd < 0)
+    __atomic_sub_fetch(&open_files_num_g, 1, __ATOMIC_RELAXED);
+}
+
+static void ps_proc_close(ps_proc_t *proc) {
+  ps_fd_release(&proc->io_fd);
+  ps_fd_release(&proc->status_fd);
+  ps_fd_release(&proc->stat_fd);
+  ps_fd_release(&proc->dir_fd);
+}
+
+static ps_proc_t *ps_proc_create(long pid) {
+  ps_proc_t *proc = calloc(1, sizeof(*proc));
+  if (proc == NULL)
+    return NULL;
+
+  proc->pid = pid;
+  proc->dir_fd = -1;
+  proc->stat_fd = -1;
+  proc->status_fd = -1;
+  proc->io_fd = -1;
+
+  ps_proc_open(proc);
+  return proc;
+}
+
+static void ps_proc_destroy(ps_proc_t *proc) {
+  if (proc == NULL)
+    return;
+
+  ps_proc_close(proc);
+  sfree(proc->matches);
+  sfree(proc->entry);
+  sfree(proc);
+}
+
+/* ps_proc_openat opens the file "name" below /proc/<pid>. */
+static int ps_proc_openat(const ps_proc_t *proc, const char *name, int flags) {
+  char filename[64];
+
+  if (proc->dir_fd >= 0)
+    return openat(proc->dir_fd, name, flags | O_CLOEXEC);
+
+  snprintf(filename, sizeof(filename), "/proc/%li/%s", proc->pid, name);
+  return open(filename, flags | O_CLOEXEC);
+}
+
+/* ps_pread reads a file below /proc from its beginning. These files are
+ * generated when read, so a single read returns all of the file that fits
+ * into the buffer. */
+static ssize_t ps_pread(int fd, char *buffer, size_t buffer_size) {
+  ssize_t status;
+
+  do {
+    status = pread(fd, buffer, buffer_size, 0);
+  } while ((status < 0) && (errno == EINTR));
+
+  return status;
+}
+
+/* ps_proc_read reads the file "name" of the process into buffer and
+ * null-terminates it. If the directory of the process is held open, the file
+ * is kept open in *fd as long as the budget allows, so that the next read
+ * costs a single pread(2). Returns the number of bytes read or -1 on error. */
+static ssize_t ps_proc_read(ps_proc_t *proc, int *fd, const char *name,
+                            char *buffer, size_t buffer_size) {
+  int tmp_fd = *fd;
+
+  if (tmp_fd < 0) {
+    tmp_fd = ps_proc_openat(proc, name, O_RDONLY);
+    if (tmp_fd < 0)
+      return -1;
+  }
+
+  ssize_t len = ps_pread(tmp_fd, buffer, buffer_size - 1);
+
+  if (*fd < 0) {
+    int saved_errno = errno;
+    if ((len >= 0) && (proc->dir_fd >= 0) && ps_fd_reserve())
+      *fd = tmp_fd;
+    else
+      close(tmp_fd);
+    errno = saved_errno;
+  }
+
+  if (len < 0)
+    return -1;
+
+  buffer[len] = 0;
+  return len;
+}
+
+/* ps_next_line returns the line *ptr points to, null-terminated, and advances
+ * *ptr to the following line. Returns NULL at the end of the buffer. */
+static char *ps_next_line(char **ptr) {
+  char *line = *ptr;
+
+  if (line[0] == 0)
+    return NULL;
+
+  char *end = strchr(line, '\n');
+  if (end == NULL) {
+    *ptr = line + strlen(line);
+  } else {
+    *end = 0;
+    *ptr = end + 1;
+  }
+
+  return line;
+}
+
+static int ps_read_tasks_status(const ps_proc_t *proc, process_entry_t *ps,
+                                char *buffer, size_t buffer_size) {
   DIR *dh;
   char filename[64];
-  FILE *fh;
   struct dirent *ent;
   derive_t cswitch_vol = 0;
   derive_t cswitch_invol = 0;
-  char buffer[1024];
   char *fields[8];
   int numfields;
 
-  snprintf(dirname, sizeof(dirname), "/proc/%li/task", ps->id);
-
-  if ((dh = opendir(dirname)) == NULL) {
-    DEBUG("Failed to open directory `%s'", dirname);
+  int fd = ps_proc_openat(proc, "task", O_RDONLY | O_DIRECTORY);
+  if ((fd < 0) || ((dh = fdopendir(fd)) == NULL)) {
+    DEBUG("Failed to open directory `/proc/%li/task'", ps->id);
+    if (fd >= 0)
+      close(fd);
     return -1;
   }
 
@@ -1033,27 +1312,35 @@ static int ps_read_tasks_status(process_entry_t *ps) {
 
     tpid = ent->d_name;
 
-    int r = snprintf(filename, sizeof(filename), "/proc/%li/task/%s/status",
-                     ps->id, tpid);
+    int r = snprintf(filename, sizeof(filename), "%s/status", tpid);
     if ((size_t)r >= sizeof(filename)) {
       DEBUG("Filename too long: `%s'", filename);
       continue;
     }
 
-    if ((fh = fopen(filename, "r")) == NULL) {
-      DEBUG("Failed to open file `%s'", filename);
+    int status_fd = openat(dirfd(dh), filename, O_RDONLY | O_CLOEXEC);
+    if (status_fd < 0) {
+      DEBUG("Failed to open file `/proc/%li/task/%s'", ps->id, filename);
       continue;
     }
 
-    while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+    ssize_t len = ps_pread(status_fd, buffer, buffer_size - 1);
+    close(status_fd);
+    if (len < 0)
+      continue;
+    buffer[len] = 0;
+
+    char *ptr = buffer;
+    char *line;
+    while ((line = ps_next_line(&ptr)) != NULL) {
       derive_t tmp;
       char *endptr;
 
-      if (strncmp(buffer, "voluntary_ctxt_switches", 23) != 0 &&
-          strncmp(buffer, "nonvoluntary_ctxt_switches", 26) != 0)
+      if (strncmp(line, "voluntary_ctxt_switches", 23) != 0 &&
+          strncmp(line, "nonvoluntary_ctxt_switches", 26) != 0)
         continue;
 
-      numfields = strsplit(buffer, fields, STATIC_ARRAY_SIZE(fields));
+      numfields = strsplit(line, fields, STATIC_ARRAY_SIZE(fields));
 
       if (numfields < 2)
         continue;
@@ -1062,17 +1349,13 @@ static int ps_read_tasks_status(process_entry_t *ps) {
       endptr = NULL;
       tmp = (derive_t)strtoll(fields[1], &endptr, /* base = */ 10);
       if ((errno == 0) && (endptr != fields[1])) {
-        if (strncmp(buffer, "voluntary_ctxt_switches", 23) == 0) {
+        if (strncmp(line, "voluntary_ctxt_switches", 23) == 0) {
           cswitch_vol += tmp;
-        } else if (strncmp(buffer, "nonvoluntary_ctxt_switches", 26) == 0) {
+        } else if (strncmp(line, "nonvoluntary_ctxt_switches", 26) == 0) {
           cswitch_invol += tmp;
         }
       }
-    } /* while (fgets) */
-
-    if (fclose(fh)) {
-      WARNING("processes: fclose: %s", STRERRNO);
-    }
+    } /* while (ps_next_line) */
   }
   closedir(dh);
 
@@ -1083,10 +1366,8 @@ static int ps_read_tasks_status(process_entry_t *ps) {
 } /* int *ps_read_tasks_status */
 
 /* Read data from /proc/pid/status */
-static int ps_read_status(long pid, process_entry_t *ps) {
-  FILE *fh;
-  char buffer[1024];
-  char filename[64];
+static int ps_read_status(ps_proc_t *proc, process_entry_t *ps, char *buffer,
+                          size_t buffer_size) {
   unsigned long lib = 0;
   unsigned long exe = 0;
   unsigned long data = 0;
@@ -1094,18 +1375,19 @@ static int ps_read_status(long pid, process_entry_t *ps) {
   char *fields[8];
   int numfields;
 
-  snprintf(filename, sizeof(filename), "/proc/%li/status", pid);
-  if ((fh = fopen(filename, "r")) == NULL)
+  if (ps_proc_read(proc, &proc->status_fd, "status", buffer, buffer_size) < 0)
     return -1;
 
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  char *ptr = buffer;
+  char *line;
+  while ((line = ps_next_line(&ptr)) != NULL) {
     unsigned long tmp;
     char *endptr;
 
-    if (strncmp(buffer, "Vm", 2) != 0 && strncmp(buffer, "Threads", 7) != 0)
+    if (strncmp(line, "Vm", 2) != 0 && strncmp(line, "Threads", 7) != 0)
       continue;
 
-    numfields = strsplit(buffer, fields, STATIC_ARRAY_SIZE(fields));
+    numfields = strsplit(line, fields, STATIC_ARRAY_SIZE(fields));
 
     if (numfields < 2)
       continue;
@@ -1114,21 +1396,17 @@ static int ps_read_status(long pid, process_entry_t *ps) {
     endptr = NULL;
     tmp = strtoul(fields[1], &endptr, /* base = */ 10);
     if ((errno == 0) && (endptr != fields[1])) {
-      if (strncmp(buffer, "VmData", 6) == 0) {
+      if (strncmp(line, "VmData", 6) == 0) {
         data = tmp;
-      } else if (strncmp(buffer, "VmLib", 5) == 0) {
+      } else if (strncmp(line, "VmLib", 5) == 0) {
         lib = tmp;
-      } else if (strncmp(buffer, "VmExe", 5) == 0) {
+      } else if (strncmp(line, "VmExe", 5) == 0) {
         exe = tmp;
-      } else if (strncmp(buffer, "Threads", 7) == 0) {
+      } else if (strncmp(line, "Threads", 7) == 0) {
         threads = tmp;
       }
     }
-  } /* while (fgets) */
-
-  if (fclose(fh)) {
-    WARNING("processes: fclose: %s", STRERRNO);
-  }
+  } /* while (ps_next_line) */
 
   ps->vmem_data = data * 1024;
   ps->vmem_code = (exe + lib) * 1024;
@@ -1138,41 +1416,39 @@ static int ps_read_status(long pid, process_entry_t *ps) {
   return 0;
 } /* int *ps_read_status */
 
-static int ps_read_io(process_entry_t *ps) {
-  FILE *fh;
-  char buffer[1024];
-  char filename[64];
-
+static int ps_read_io(ps_proc_t *proc, process_entry_t *ps, char *buffer,
+                      size_t buffer_size) {
   char *fields[8];
   int numfields;
 
-  snprintf(filename, sizeof(filename), "/proc/%li/io", ps->id);
-  if ((fh = fopen(filename, "r")) == NULL) {
-    DEBUG("ps_read_io: Failed to open file `%s'", filename);
+  if (ps_proc_read(proc, &proc->io_fd, "io", buffer, buffer_size) < 0) {
+    DEBUG("ps_read_io: Failed to read file `/proc/%li/io'", ps->id);
     return -1;
   }
 
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
+  char *ptr = buffer;
+  char *line;
+  while ((line = ps_next_line(&ptr)) != NULL) {
     derive_t *val = NULL;
     long long tmp;
     char *endptr;
 
-    if (strncasecmp(buffer, "rchar:", 6) == 0)
+    if (strncasecmp(line, "rchar:", 6) == 0)
       val = &(ps->io_rchar);
-    else if (strncasecmp(buffer, "wchar:", 6) == 0)
+    else if (strncasecmp(line, "wchar:", 6) == 0)
       val = &(ps->io_wchar);
-    else if (strncasecmp(buffer, "syscr:", 6) == 0)
+    else if (strncasecmp(line, "syscr:", 6) == 0)
       val = &(ps->io_syscr);
-    else if (strncasecmp(buffer, "syscw:", 6) == 0)
+    else if (strncasecmp(line, "syscw:", 6) == 0)
       val = &(ps->io_syscw);
-    else if (strncasecmp(buffer, "read_bytes:", 11) == 0)
+    else if (strncasecmp(line, "read_bytes:", 11) == 0)
       val = &(ps->io_diskr);
-    else if (strncasecmp(buffer, "write_bytes:", 12) == 0)
+    else if (strncasecmp(line, "write_bytes:", 12) == 0)
       val = &(ps->io_diskw);
     else
       continue;
 
-    numfields = strsplit(buffer, fields, STATIC_ARRAY_SIZE(fields));
+    numfields = strsplit(line, fields, STATIC_ARRAY_SIZE(fields));
 
     if (numfields < 2)
       continue;
@@ -1184,48 +1460,67 @@ static int ps_read_io(process_entry_t *ps) {
       *val = -1;
     else
       *val = (derive_t)tmp;
-  } /* while (fgets) */
+  } /* while (ps_next_line) */
 
-  if (fclose(fh)) {
-    WARNING("processes: fclose: %s", STRERRNO);
-  }
   return 0;
 } /* int ps_read_io (...) */
 
-static int ps_count_maps(pid_t pid) {
-  FILE *fh;
-  char buffer[1024];
-  char filename[64];
+static int ps_count_maps(const ps_proc_t *proc, char *buffer,
+                         size_t buffer_size) {
   int count = 0;
 
-  snprintf(filename, sizeof(filename), "/proc/%d/maps", pid);
-  if ((fh = fopen(filename, "r")) == NULL) {
-    DEBUG("ps_count_maps: Failed to open file `%s'", filename);
+  int fd = ps_proc_openat(proc, "maps", O_RDONLY);
+  if (fd < 0) {
+    DEBUG("ps_count_maps: Failed to open file `/proc/%li/maps'", proc->pid);
     return -1;
   }
 
-  while (fgets(buffer, sizeof(buffer), fh) != NULL) {
-    if (strchr(buffer, '\n')) {
-      count++;
+  /* One line per mapping; count them without splitting the file into
+   * lines. */
+  while (42) {
+    ssize_t len = read(fd, buffer, buffer_size);
+    if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    } else if (len == 0) {
+      break;
     }
-  } /* while (fgets) */
 
-  if (fclose(fh)) {
-    WARNING("processes: fclose: %s", STRERRNO);
+    char *end = buffer + len;
+    for (char *ptr = buffer; (ptr = memchr(ptr, '\n', end - ptr)) != NULL;
+         ptr++)
+      count++;
   }
+
+  close(fd);
   return count;
 } /* int ps_count_maps (...) */
 
-static int ps_count_fd(int pid) {
+static int ps_count_fd(const ps_proc_t *proc) {
   char dirname[64];
+  struct stat statbuf;
   DIR *dh;
   struct dirent *ent;
   int count = 0;
+  int status;
 
-  snprintf(dirname, sizeof(dirname), "/proc/%i/fd", pid);
+  snprintf(dirname, sizeof(dirname), "/proc/%li/fd", proc->pid);
+
+  /* Since Linux 6.2 the size of the "fd" directory is the number of open
+   * file descriptors, which saves reading the directory. */
+  if (proc->dir_fd >= 0)
+    status = fstatat(proc->dir_fd, "fd", &statbuf, /* flags = */ 0);
+  else
+    status = stat(dirname, &statbuf);
+  if ((status == 0) && (statbuf.st_size > 0))
+    return (int)statbuf.st_size;
 
-  if ((dh = opendir(dirname)) == NULL) {
+  int fd = ps_proc_openat(proc, "fd", O_RDONLY | O_DIRECTORY);
+  if ((fd < 0) || ((dh = fdopendir(fd)) == NULL)) {
     DEBUG("Failed to open directory `%s'", dirname);
+    if (fd >= 0)
+      close(fd);
     return -1;
   }
   while ((ent = readdir(dh)) != NULL) {
@@ -1240,28 +1535,31 @@ static int ps_count_fd(int pid) {
 } /* int ps_count_fd (pid) */
 
 #if HAVE_LIBTASKSTATS
-static int ps_delay(process_entry_t *ps) {
-  if (taskstats_handle == NULL) {
+static int ps_taskstats(ts_t *ts, long pid, ts_stats_t *out) {
+  if (ts == NULL) {
     return ENOTCONN;
   }
 
-  int status = ts_delay_by_tgid(taskstats_handle, (uint32_t)ps->id, &ps->delay);
+  int status = ts_stats_by_tgid(ts, (uint32_t)pid, out);
   if (status == EPERM) {
     static c_complain_t c;
+    static pthread_mutex_t c_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    /* Called from all read threads. */
+    pthread_mutex_lock(&c_lock);
 #if defined(HAVE_SYS_CAPABILITY_H) && defined(CAP_NET_ADMIN)
     if (check_capability(CAP_NET_ADMIN) != 0) {
       if (getuid() == 0) {
-        c_complain(
-            LOG_ERR, &c,
-            "processes plugin: Reading Delay Accounting metric failed: %s. "
-            "collectd is running as root, but missing the CAP_NET_ADMIN "
-            "capability. The most common cause for this is that the init "
-            "system is dropping capabilities.",
-            STRERROR(status));
+        c_complain(LOG_ERR, &c,
+                   "processes plugin: Reading taskstats failed: %s. "
+                   "collectd is running as root, but missing the "
+                   "CAP_NET_ADMIN capability. The most common cause for "
+                   "this is that the init system is dropping capabilities.",
+                   STRERROR(status));
       } else {
         c_complain(
             LOG_ERR, &c,
-            "processes plugin: Reading Delay Accounting metric failed: %s. "
+            "processes plugin: Reading taskstats failed: %s. "
             "collectd is not running as root and missing the CAP_NET_ADMIN "
             "capability. Either run collectd as root or grant it the "
             "CAP_NET_ADMIN capability using \"setcap cap_net_admin=ep " PREFIX
@@ -1269,20 +1567,21 @@ static int ps_delay(process_entry_t *ps) {
             STRERROR(status));
       }
     } else {
-      ERROR("processes plugin: ts_delay_by_tgid failed: %s. The CAP_NET_ADMIN "
+      ERROR("processes plugin: ts_stats_by_tgid failed: %s. The CAP_NET_ADMIN "
             "capability is available (I checked), so this error is utterly "
             "unexpected.",
             STRERROR(status));
     }
 #else
     c_complain(LOG_ERR, &c,
-               "processes plugin: Reading Delay Accounting metric failed: %s. "
-               "Reading Delay Accounting metrics requires root privileges.",
+               "processes plugin: Reading taskstats failed: %s. "
+               "Reading taskstats requires root privileges.",
                STRERROR(status));
 #endif
+    pthread_mutex_unlock(&c_lock);
     return status;
   } else if (status != 0) {
-    ERROR("processes plugin: ts_delay_by_tgid failed: %s", STRERROR(status));
+    ERROR("processes plugin: ts_stats_by_tgid failed: %s", STRERROR(status));
     return status;
   }
 
@@ -1290,54 +1589,82 @@ static int ps_delay(process_entry_t *ps) {
 }
 #endif
 
-static void ps_fill_details(const procstat_t *ps, process_entry_t *entry) {
-  if (entry->has_io == false) {
-    ps_read_io(entry);
-    entry->has_io = true;
+/* ps_fill_details reads the details the process matches of proc ask for. */
+static void ps_fill_details(ps_worker_t *w, ps_proc_t *proc,
+                            process_entry_t *entry) {
+  bool want_ctx_switch = false;
+  bool want_maps_num = false;
+  bool want_fd_num = false;
+#if HAVE_LIBTASKSTATS
+  bool want_delay = false;
+#endif
+
+  for (size_t i = 0; i < proc->matches_num; i++) {
+    want_ctx_switch |= proc->matches[i]->report_ctx_switch;
+    want_maps_num |= proc->matches[i]->report_maps_num;
+    want_fd_num |= proc->matches[i]->report_fd_num;
+#if HAVE_LIBTASKSTATS
+    want_delay |= proc->matches[i]->report_delay;
+#endif
   }
 
-  if (ps->report_ctx_switch) {
-    if (entry->has_cswitch == false) {
-      ps_read_tasks_status(entry);
-      entry->has_cswitch = true;
+  /* Leave the rest at zero if this is only a zombie */
+  if ((entry->num_proc != 0) &&
+      (ps_read_status(proc, entry, w->buffer, sizeof(w->buffer)) != 0)) {
+    /* No VMem data */
+    entry->vmem_data = -1;
+    entry->vmem_code = -1;
+    DEBUG("ps_fill_details: did not get vmem data for pid %li", proc->pid);
+  }
+
+  ps_read_io(proc, entry, w->buffer, sizeof(w->buffer));
+  entry->has_io = true;
+
+#if HAVE_LIBTASKSTATS
+  /* A single taskstats query returns both the delays and the context
+   * switches of all threads. */
+  if (want_delay || (want_ctx_switch && use_taskstats)) {
+    ts_stats_t stats = {0};
+    if (ps_taskstats(w->ts, proc->pid, &stats) == 0) {
+      if (want_delay) {
+        entry->delay = stats.delay;
+        entry->has_delay = true;
+      }
+      if (want_ctx_switch && use_taskstats) {
+        entry->cswitch_vol = (derive_t)stats.cswitch_vol;
+        entry->cswitch_invol = (derive_t)stats.cswitch_invol;
+        entry->has_cswitch = true;
+      }
     }
   }
+#endif
 
-  if (ps->report_maps_num) {
-    int num_maps;
-    if (entry->has_maps == false && (num_maps = ps_count_maps(entry->id)) > 0) {
+  if (want_ctx_switch && !entry->has_cswitch) {
+    ps_read_tasks_status(proc, entry, w->buffer, sizeof(w->buffer));
+    entry->has_cswitch = true;
+  }
+
+  if (want_maps_num) {
+    int num_maps = ps_count_maps(proc, w->buffer, sizeof(w->buffer));
+    if (num_maps > 0)
       entry->num_maps = num_maps;
-    }
     entry->has_maps = true;
   }
 
-  if (ps->report_fd_num) {
-    int num_fd;
-    if (entry->has_fd == false && (num_fd = ps_count_fd(entry->id)) > 0) {
+  if (want_fd_num) {
+    int num_fd = ps_count_fd(proc);
+    if (num_fd > 0)
       entry->num_fd = num_fd;
-    }
     entry->has_fd = true;
   }
-
-#if HAVE_LIBTASKSTATS
-  if (ps->report_delay && !entry->has_delay) {
-    if (ps_delay(entry) == 0) {
-      entry->has_delay = true;
-    }
-  }
-#endif
 } /* void ps_fill_details (...) */
 
-/* ps_read_process reads process counters on Linux. */
-static int ps_read_process(long pid, process_entry_t *ps, char *state) {
-  char filename[64];
-  char buffer[1024];
-
+/* ps_parse_stat parses the contents of /proc/pid/stat on Linux. */
+static int ps_parse_stat(long pid, char *buffer, size_t buffer_len,
+                         process_entry_t *ps, char *state) {
   char *fields[64];
   char fields_len;
 
-  size_t buffer_len;
-
   char *buffer_ptr;
   size_t name_start_pos;
   size_t name_end_pos;
@@ -1349,14 +1676,8 @@ static int ps_read_process(long pid, process_entry_t *ps, char *state) {
   long long unsigned vmem_rss;
   long long unsigned stack_size;
 
-  ssize_t status;
-
-  snprintf(filename, sizeof(filename), "/proc/%li/stat", pid);
-
-  status = read_text_file_contents(filename, buffer, sizeof(buffer));
-  if (status <= 0)
+  if (buffer_len == 0)
     return -1;
-  buffer_len = (size_t)status;
 
   /* The name of the process is enclosed in parens. Since the name can
    * contain parens itself, spaces, numbers and pretty much everything
@@ -1392,9 +1713,9 @@ static int ps_read_process(long pid, process_entry_t *ps, char *state) {
 
   fields_len = strsplit(buffer_ptr, fields, STATIC_ARRAY_SIZE(fields));
   if (fields_len < 22) {
-    DEBUG("processes plugin: ps_read_process (pid = %li):"
-          " `%s' has only %i fields..",
-          pid, filename, fields_len);
+    DEBUG("processes plugin: ps_parse_stat (pid = %li):"
+          " `/proc/%li/stat' has only %i fields..",
+          pid, pid, fields_len);
     return -1;
   }
 
@@ -1405,12 +1726,6 @@ static int ps_read_process(long pid, process_entry_t *ps, char *state) {
     ps->num_proc = 0;
   } else {
     ps->num_lwp = strtoul(fields[17], /* endptr = */ NULL, /* base = */ 10);
-    if ((ps_read_status(pid, ps)) != 0) {
-      /* No VMem data */
-      ps->vmem_data = -1;
-      ps->vmem_code = -1;
-      DEBUG("ps_read_process: did not get vmem data for pid %li", pid);
-    }
     if (ps->num_lwp == 0)
       ps->num_lwp = 1;
     ps->num_proc = 1;
@@ -1464,7 +1779,8 @@ static int ps_read_process(long pid, process_entry_t *ps, char *state) {
 
   /* success */
   return 0;
-} /* int ps_read_process (...) */
+} /* int ps_parse_stat (...) */
+
 
 static int procs_running(const char *buffer) {
   char id[] = "procs_running "; /* white space terminated */
@@ -1493,7 +1809,8 @@ static int procs_running(const char *buffer) {
   return -1;
 }
 
-static char *ps_get_cmdline(long pid, char *name, char *buf, size_t buf_len) {
+static char *ps_get_cmdline(const ps_proc_t *proc, char *name, char *buf,
+                            size_t buf_len) {
   char *buf_ptr;
   size_t len;
 
@@ -1502,13 +1819,13 @@ static char *ps_get_cmdline(long pid, char *name, char *buf, size_t buf_len) {
 
   size_t n;
 
-  if ((pid < 1) || (NULL == buf) || (buf_len < 2))
+  if ((proc->pid < 1) || (NULL == buf) || (buf_len < 2))
     return NULL;
 
-  snprintf(file, sizeof(file), "/proc/%li/cmdline", pid);
+  snprintf(file, sizeof(file), "/proc/%li/cmdline", proc->pid);
 
   errno = 0;
-  fd = open(file, O_RDONLY);
+  fd = ps_proc_openat(proc, "cmdline", O_RDONLY);
   if (fd < 0) {
     /* ENOENT means the process exited while we were handling it.
      * Don't complain about this, it only fills the logs. */
@@ -1638,6 +1955,226 @@ static int read_sys_ctxt_switch(const char *buffer) {
   ps_submit_global_stat("contextswitch", value.derive);
   return 0;
 }
+
+/* ps_proc_match determines the process matches the process is counted
+ * towards. The command line is only read if a ProcessMatch needs it. */
+static int ps_proc_match(ps_worker_t *w, ps_proc_t *proc, char *name) {
+  char *cmdline = NULL;
+#if HAVE_REGEX_H
+  bool have_cmdline = false;
+#endif
+
+  proc->matches_num = 0;
+  for (procstat_t *ps = list_head_g; ps != NULL; ps = ps->next) {
+#if HAVE_REGEX_H
+    if ((ps->re != NULL) && !have_cmdline) {
+      cmdline = ps_get_cmdline(proc, name, w->cmdline, sizeof(w->cmdline));
+      have_cmdline = true;
+    }
+#endif
+
+    if ((ps_list_match(name, cmdline, ps)) == 0)
+      continue;
+
+    procstat_t **tmp = realloc(proc->matches, (proc->matches_num + 1) *
+                                                  sizeof(*proc->matches));
+    if (tmp == NULL) {
+      ERROR("processes plugin: realloc failed.");
+      return ENOMEM;
+    }
+    proc->matches = tmp;
+    proc->matches[proc->matches_num] = ps;
+    proc->matches_num++;
+  }
+
+  return 0;
+} /* int ps_proc_match */
+
+/* ps_proc_update reads the "stat" file of the process, matches the process
+ * and reads the details its matches ask for. A process which matches nothing
+ * only contributes its state, so if its "stat" file did not change, it is not
+ * matched again for up to PS_DETAILS_MAX_AGE reads. The details of matched
+ * processes are always read again: the I/O, context switch and file
+ * descriptor counters may change even if the "stat" file does not.
+ * Every process is updated by exactly one read thread. */
+static void ps_proc_update(ps_worker_t *w, ps_proc_t *proc) {
+  process_entry_t entry = {.id = proc->pid};
+  char state;
+
+  proc->valid = false;
+
+  ssize_t len = ps_proc_read(proc, &proc->stat_fd, "stat", w->buffer,
+                             sizeof(w->buffer));
+  if ((len < 0) && ((errno == ESRCH) || (errno == ENOENT)) &&
+      (proc->dir_fd >= 0)) {
+    /* The process exited and its PID may have been reused. The directory and
+     * files held open still refer to the old process: reading from them fails
+     * with ESRCH, opening a file in the stale directory with ENOENT. */
+    ps_proc_close(proc);
+    proc->has_stat = false;
+    ps_proc_open(proc);
+    len = ps_proc_read(proc, &proc->stat_fd, "stat", w->buffer,
+                       sizeof(w->buffer));
+  }
+  if (len <= 0)
+    return;
+
+  uint64_t stat_hash = ps_hash_buffer(w->buffer, (size_t)len);
+  if (proc->has_stat && (proc->matches_num == 0) &&
+      (proc->stat_hash == stat_hash) && (proc->age < PS_DETAILS_MAX_AGE)) {
+    proc->age++;
+    proc->valid = true;
+    return;
+  }
+
+  proc->has_stat = false;
+  if (ps_parse_stat(proc->pid, w->buffer, (size_t)len, &entry, &state) != 0) {
+    DEBUG("ps_parse_stat failed for pid %li", proc->pid);
+    return;
+  }
+
+  if (ps_proc_match(w, proc, entry.name) != 0)
+    return;
+
+  if (proc->matches_num == 0) {
+    sfree(proc->entry);
+  } else {
+    if ((proc->entry == NULL) &&
+        ((proc->entry = malloc(sizeof(*proc->entry))) == NULL)) {
+      ERROR("processes plugin: malloc failed.");
+      return;
+    }
+    *proc->entry = entry;
+    ps_fill_details(w, proc, proc->entry);
+  }
+
+  proc->stat_hash = stat_hash;
+  proc->has_stat = true;
+  proc->age = 0;
+  proc->state = state;
+  proc->valid = true;
+} /* void ps_proc_update */
+
+static void *ps_scan_worker(void *arg) {
+  ps_worker_t *w = arg;
+
+  while (42) {
+    size_t begin = __atomic_fetch_add(&ps_procs_next_g, PS_SCAN_CHUNK,
+                                      __ATOMIC_RELAXED);
+    if (begin >= ps_procs_num_g)
+      break;
+
+    size_t end = begin + PS_SCAN_CHUNK;
+    if (end > ps_procs_num_g)
+      end = ps_procs_num_g;
+
+    for (size_t i = begin; i < end; i++)
+      ps_proc_update(w, ps_procs_g[i]);
+  }
+
+  return NULL;
+} /* void *ps_scan_worker */
+
+/* ps_scan_proc_dir updates ps_procs_g to the processes listed in /proc.
+ * Processes that went away are removed and their files are closed. */
+static int ps_scan_proc_dir(void) {
+  struct dirent *ent;
+  DIR *proc;
+  long pid;
+
+  if ((proc = opendir("/proc")) == NULL) {
+    ERROR("Cannot open `/proc': %s", STRERRNO);
+    return -1;
+  }
+
+  for (size_t i = 0; i < ps_procs_num_g; i++)
+    ps_procs_g[i]->seen = false;
+
+  while ((ent = readdir(proc)) != NULL) {
+    ps_proc_t *p = NULL;
+
+    if (!isdigit(ent->d_name[0]))
+      continue;
+
+    if ((pid = atol(ent->d_name)) < 1)
+      continue;
+
+    if (c_hashmap_get(ps_procs_by_pid_g, &pid, (void *)&p) != 0) {
+      if (ps_procs_num_g == ps_procs_size_g) {
+        size_t size = (ps_procs_size_g == 0) ? 256 : 2 * ps_procs_size_g;
+        ps_proc_t **tmp = realloc(ps_procs_g, size * sizeof(*ps_procs_g));
+        if (tmp == NULL) {
+          ERROR("processes plugin: realloc failed.");
+          break;
+        }
+        ps_procs_g = tmp;
+        ps_procs_size_g = size;
+      }
+
+      if ((p = ps_proc_create(pid)) == NULL) {
+        ERROR("processes plugin: calloc failed.");
+        break;
+      }
+
+      if (c_hashmap_insert(ps_procs_by_pid_g, &p->pid, p) != 0) {
+        ERROR("processes plugin: c_hashmap_insert failed.");
+        ps_proc_destroy(p);
+        break;
+      }
+
+      ps_procs_g[ps_procs_num_g] = p;
+      ps_procs_num_g++;
+    }
+
+    p->seen = true;
+  }
+
+  closedir(proc);
+
+  size_t procs_num = 0;
+  for (size_t i = 0; i < ps_procs_num_g; i++) {
+    ps_proc_t *p = ps_procs_g[i];
+
+    if (!p->seen) {
+      c_hashmap_remove(ps_procs_by_pid_g, &p->pid, NULL, NULL);
+      ps_proc_destroy(p);
+      continue;
+    }
+
+    ps_procs_g[procs_num] = p;
+    procs_num++;
+  }
+  ps_procs_num_g = procs_num;
+
+  return 0;
+} /* int ps_scan_proc_dir */
+
+/* ps_scan_procs updates all processes, spreading them over "ReadThreads"
+ * threads. The thread calling this function is one of them. */
+static void ps_scan_procs(void) {
+  size_t threads_num = (ps_procs_num_g + PS_SCAN_CHUNK - 1) / PS_SCAN_CHUNK;
+  if (threads_num > ps_workers_num_g)
+    threads_num = ps_workers_num_g;
+
+  ps_procs_next_g = 0;
+
+  size_t started = 1;
+  for (; started < threads_num; started++) {
+    int status = plugin_thread_create(&ps_workers_g[started].thread,
+                                      ps_scan_worker, ps_workers_g + started,
+                                      "processes");
+    if (status != 0) {
+      ERROR("processes plugin: plugin_thread_create failed: %s",
+            STRERROR(status));
+      break;
+    }
+  }
+
+  ps_scan_worker(ps_workers_g);
+
+  for (size_t i = 1; i < started; i++)
+    pthread_join(ps_workers_g[i].thread, /* retval = */ NULL);
+} /* void ps_scan_procs */
 #endif /*KERNEL_LINUX */
 
 #if KERNEL_SOLARIS
@@ -2104,42 +2641,23 @@ static int ps_read(void) {
   int paging = 0;
   int blocked = 0;
 
-  struct dirent *ent;
-  DIR *proc;
-  long pid;
-
   char buffer[65536] = {};
-  char cmdline[CMDLINE_BUFFER_SIZE];
-
-  int status;
-  process_entry_t pse;
-  char state;
 
   running = sleeping = zombies = stopped = paging = blocked = 0;
   ps_list_reset();
 
-  if ((proc = opendir("/proc")) == NULL) {
-    ERROR("Cannot open `/proc': %s", STRERRNO);
+  if (ps_scan_proc_dir() != 0)
     return -1;
-  }
-
-  while ((ent = readdir(proc)) != NULL) {
-    if (!isdigit(ent->d_name[0]))
-      continue;
 
-    if ((pid = atol(ent->d_name)) < 1)
-      continue;
+  ps_scan_procs();
 
-    memset(&pse, 0, sizeof(pse));
-    pse.id = pid;
+  for (size_t i = 0; i < ps_procs_num_g; i++) {
+    ps_proc_t *proc = ps_procs_g[i];
 
-    status = ps_read_process(pid, &pse, &state);
-    if (status != 0) {
-      DEBUG("ps_read_process failed: %i", status);
+    if (!proc->valid)
       continue;
-    }
 
-    switch (state) {
+    switch (proc->state) {
     case 'S':
       sleeping++;
       break;
@@ -2157,12 +2675,10 @@ static int ps_read(void) {
       break;
     }
 
-    ps_list_add(pse.name,
-                ps_get_cmdline(pid, pse.name, cmdline, sizeof(cmdline)), &pse);
+    for (size_t j = 0; j < proc->matches_num; j++)
+      ps_list_add_one(proc->matches[j], proc->entry);
   }
 
-  closedir(proc);
-
   if (read_file_contents("/proc/stat", buffer, sizeof(buffer) - 1) <= 0) {
     ERROR("Cannot read `/proc/stat`");
     return -1;
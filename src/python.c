@@ -176,6 +176,39 @@ static char reg_write_doc[] =
     "data: The optional data parameter passed to the register function.\n"
     "    If the parameter was omitted it will be omitted here, too.";
 
+static char reg_write_batch_doc[] =
+    "register_write_batch(callback[, data][, name][, size][, timeout])\n"
+    "    -> identifier\n"
+    "\n"
+    "Register a callback function to receive values dispatched by other "
+    "plugins\n"
+    "in batches.\n"
+    "'callback' is a callable object that will be called with a batch of\n"
+    "    value lists.\n"
+    "'data' is an optional object that will be passed back to the callback\n"
+    "    function every time it is called.\n"
+    "'name' is an optional identifier for this callback. The default name\n"
+    "    is 'python.<module>'.\n"
+    "'size' is the number of value lists after which the callback is called.\n"
+    "    The default is 512.\n"
+    "'timeout' is the age in seconds of the oldest value list after which\n"
+    "    the callback is called even if the batch is not full. It defaults to\n"
+    "    the plugin's interval. Pending values are also passed on when the\n"
+    "    plugin is flushed.\n"
+    "'identifier' is the full identifier assigned to this callback.\n"
+    "\n"
+    "The callback function will be called with one or two parameters:\n"
+    "values: A ValuesBatch object, a sequence of ValuesView objects.\n"
+    "data: The optional data parameter passed to the register function.\n"
+    "    If the parameter was omitted it will be omitted here, too.";
+
+static char dispatch_batch_doc[] =
+    "dispatch_batch(values) -> None.  Dispatch several value lists at once.\n"
+    "\n"
+    "'values' is a sequence of Values objects. All of them are converted\n"
+    "before any of them is dispatched, so if one of them is invalid, an\n"
+    "exception is raised and nothing is dispatched.";
+
 static char reg_notification_doc[] =
     "register_notification(callback[, data][, name]) -> identifier\n"
     "\n"
@@ -406,7 +439,7 @@ static int cpy_write_callback(const data_set_t *ds,
                               const value_list_t *value_list,
                               user_data_t *data) {
   cpy_callback_t *c = data->data;
-  PyObject *ret, *list, *temp, *dict = NULL;
+  PyObject *ret, *list, *dict = NULL;
   Values *v;
 
   CPY_LOCK_THREADS
@@ -440,64 +473,7 @@ static int cpy_write_callback(const data_set_t *ds,
       CPY_RETURN_FROM_THREADS 0;
     }
   }
-  dict = PyDict_New(); /* New reference. */
-  if (value_list->meta) {
-    char **table = NULL;
-    meta_data_t *meta = value_list->meta;
-
-    int num = meta_data_toc(meta, &table);
-    for (int i = 0; i < num; ++i) {
-      int type;
-      char *string;
-      int64_t si;
-      uint64_t ui;
-      double d;
-      bool b;
-
-      type = meta_data_type(meta, table[i]);
-      if (type == MD_TYPE_STRING) {
-        if (meta_data_get_string(meta, table[i], &string))
-          continue;
-        temp = cpy_string_to_unicode_or_bytes(string); /* New reference. */
-        free(string);
-        PyDict_SetItemString(dict, table[i], temp);
-        Py_XDECREF(temp);
-      } else if (type == MD_TYPE_SIGNED_INT) {
-        if (meta_data_get_signed_int(meta, table[i], &si))
-          continue;
-        PyObject *sival = PyLong_FromLongLong(si); /* New reference */
-        temp = PyObject_CallFunctionObjArgs((void *)&SignedType, sival,
-                                            (void *)0); /* New reference. */
-        PyDict_SetItemString(dict, table[i], temp);
-        Py_XDECREF(temp);
-        Py_XDECREF(sival);
-      } else if (type == MD_TYPE_UNSIGNED_INT) {
-        if (meta_data_get_unsigned_int(meta, table[i], &ui))
-          continue;
-        PyObject *uval = PyLong_FromUnsignedLongLong(ui); /* New reference */
-        temp = PyObject_CallFunctionObjArgs((void *)&UnsignedType, uval,
-                                            (void *)0); /* New reference. */
-        PyDict_SetItemString(dict, table[i], temp);
-        Py_XDECREF(temp);
-        Py_XDECREF(uval);
-      } else if (type == MD_TYPE_DOUBLE) {
-        if (meta_data_get_double(meta, table[i], &d))
-          continue;
-        temp = PyFloat_FromDouble(d); /* New reference. */
-        PyDict_SetItemString(dict, table[i], temp);
-        Py_XDECREF(temp);
-      } else if (type == MD_TYPE_BOOLEAN) {
-        if (meta_data_get_boolean(meta, table[i], &b))
-          continue;
-        if (b)
-          PyDict_SetItemString(dict, table[i], Py_True);
-        else
-          PyDict_SetItemString(dict, table[i], Py_False);
-      }
-      free(table[i]);
-    }
-    free(table);
-  }
+  dict = cpy_build_meta_dict(value_list->meta); /* New reference. */
   v = (Values *)Values_New(); /* New reference. */
   sstrncpy(v->data.host, value_list->host, sizeof(v->data.host));
   sstrncpy(v->data.type, value_list->type, sizeof(v->data.type));
@@ -524,6 +500,191 @@ static int cpy_write_callback(const data_set_t *ds,
   return 0;
 }
 
+/* Value lists passed to a batch write callback are collected here until
+ * "size" value lists are pending or the oldest one is older than "timeout".
+ * A read callback running every "timeout" passes on value lists that would
+ * otherwise wait for the next write. */
+typedef struct cpy_write_batch_s {
+  cpy_callback_t *c;
+  size_t size;
+  cdtime_t timeout;
+
+  pthread_mutex_t lock;
+  /* Shared by the write and the read callback; freed by the last one. */
+  int refs;
+  value_list_t *vl;
+  const data_set_t **ds;
+  size_t vl_num;
+  value_t *values;
+  size_t values_num;
+  size_t values_size;
+  cdtime_t first;
+} cpy_write_batch_t;
+
+/* Hands the pending value lists to the Python callback. Must be called
+ * without holding the GIL or the lock of the batch. */
+static void cpy_write_batch_call(cpy_callback_t *c, value_list_t *vl,
+                                 const data_set_t **ds, value_t *values,
+                                 size_t vl_num) {
+  PyObject *ret, *batch;
+
+  CPY_LOCK_THREADS
+  batch = ValuesBatch_New(vl, ds, values, vl_num); /* New reference. */
+  if (batch == NULL) {
+    cpy_log_exception("batch write callback");
+    CPY_RETURN_FROM_THREADS;
+  }
+  ret = PyObject_CallFunctionObjArgs(c->callback, batch, c->data,
+                                     (void *)0); /* New reference. */
+  Py_DECREF(batch);
+  if (ret == NULL) {
+    cpy_log_exception("batch write callback");
+  } else {
+    Py_DECREF(ret);
+  }
+  CPY_RELEASE_THREADS
+}
+
+/* Takes the pending value lists out of "b" if "force" is set or the batch is
+ * full or too old. Returns the number of value lists taken. Must be called
+ * with the lock of the batch held. */
+static size_t cpy_write_batch_take(cpy_write_batch_t *b, bool force,
+                                   value_list_t **vl, const data_set_t ***ds,
+                                   value_t **values) {
+  size_t vl_num = b->vl_num;
+
+  if (vl_num == 0)
+    return 0;
+  if (!force && (vl_num < b->size) && (cdtime() - b->first < b->timeout))
+    return 0;
+
+  *vl = b->vl;
+  *ds = b->ds;
+  *values = b->values;
+
+  b->vl = NULL;
+  b->ds = NULL;
+  b->values = NULL;
+  b->vl_num = 0;
+  b->values_num = 0;
+  b->values_size = 0;
+  return vl_num;
+}
+
+static int cpy_write_batch_callback(const data_set_t *ds,
+                                    const value_list_t *value_list,
+                                    user_data_t *data) {
+  cpy_write_batch_t *b = data->data;
+  value_list_t *vl = NULL;
+  const data_set_t **vl_ds = NULL;
+  value_t *values = NULL;
+  size_t vl_num;
+
+  pthread_mutex_lock(&b->lock);
+  if (b->vl == NULL) {
+    b->vl = calloc(b->size, sizeof(*b->vl));
+    b->ds = calloc(b->size, sizeof(*b->ds));
+    if ((b->vl == NULL) || (b->ds == NULL)) {
+      sfree(b->vl);
+      sfree(b->ds);
+      pthread_mutex_unlock(&b->lock);
+      ERROR("python plugin: calloc failed.");
+      return ENOMEM;
+    }
+  }
+
+  if (b->values_num + value_list->values_len > b->values_size) {
+    size_t size = (b->values_size == 0) ? 4 * b->size : 2 * b->values_size;
+    while (size < b->values_num + value_list->values_len)
+      size *= 2;
+    value_t *tmp = realloc(b->values, size * sizeof(*b->values));
+    if (tmp == NULL) {
+      pthread_mutex_unlock(&b->lock);
+      ERROR("python plugin: realloc failed.");
+      return ENOMEM;
+    }
+    b->values = tmp;
+    b->values_size = size;
+  }
+
+  if (b->vl_num == 0)
+    b->first = cdtime();
+
+  /* The "values" pointers are set by ValuesBatch_New(). */
+  b->vl[b->vl_num] = *value_list;
+  b->vl[b->vl_num].values = NULL;
+  b->vl[b->vl_num].meta = meta_data_clone(value_list->meta);
+  b->ds[b->vl_num] = ds;
+  memcpy(b->values + b->values_num, value_list->values,
+         value_list->values_len * sizeof(*b->values));
+  b->values_num += value_list->values_len;
+  b->vl_num++;
+
+  vl_num = cpy_write_batch_take(b, /* force = */ false, &vl, &vl_ds, &values);
+  pthread_mutex_unlock(&b->lock);
+
+  if (vl_num > 0)
+    cpy_write_batch_call(b->c, vl, vl_ds, values, vl_num);
+  return 0;
+}
+
+static int cpy_write_batch_flush(cdtime_t timeout, const char *identifier,
+                                 user_data_t *data) {
+  cpy_write_batch_t *b = data->data;
+  value_list_t *vl = NULL;
+  const data_set_t **ds = NULL;
+  value_t *values = NULL;
+  size_t vl_num = 0;
+
+  pthread_mutex_lock(&b->lock);
+  if ((timeout == 0) || (cdtime() - b->first >= timeout))
+    vl_num = cpy_write_batch_take(b, /* force = */ true, &vl, &ds, &values);
+  pthread_mutex_unlock(&b->lock);
+
+  if (vl_num > 0)
+    cpy_write_batch_call(b->c, vl, ds, values, vl_num);
+  return 0;
+}
+
+static int cpy_write_batch_read(user_data_t *data) {
+  cpy_write_batch_t *b = data->data;
+  value_list_t *vl = NULL;
+  const data_set_t **ds = NULL;
+  value_t *values = NULL;
+  size_t vl_num;
+
+  pthread_mutex_lock(&b->lock);
+  vl_num = cpy_write_batch_take(b, /* force = */ true, &vl, &ds, &values);
+  pthread_mutex_unlock(&b->lock);
+
+  if (vl_num > 0)
+    cpy_write_batch_call(b->c, vl, ds, values, vl_num);
+  return 0;
+}
+
+static void cpy_write_batch_destroy(void *data) {
+  cpy_write_batch_t *b = data;
+
+  pthread_mutex_lock(&b->lock);
+  int refs = --b->refs;
+  pthread_mutex_unlock(&b->lock);
+  if (refs > 0)
+    return;
+
+  /* The daemon flushes all plugins before shutting down, so only value lists
+   * written after that are dropped here. */
+  for (size_t i = 0; i < b->vl_num; i++)
+    meta_data_destroy(b->vl[i].meta);
+  sfree(b->vl);
+  sfree(b->ds);
+  sfree(b->values);
+  pthread_mutex_destroy(&b->lock);
+
+  cpy_callback_t *c = b->c;
+  free(b);
+  cpy_destroy_user_data(c);
+}
+
 static int cpy_notification_callback(const notification_t *notification,
                                      user_data_t *data) {
   cpy_callback_t *c = data->data;
@@ -842,6 +1003,81 @@ static PyObject *cpy_register_write(PyObject *self, PyObject *args,
                                        (void *)cpy_write_callback, args, kwds);
 }
 
+static PyObject *cpy_register_write_batch(PyObject *self, PyObject *args,
+                                          PyObject *kwds) {
+  char buf[512];
+  char flush_name[sizeof(buf) + 6];
+  cpy_callback_t *c = NULL;
+  cpy_write_batch_t *b = NULL;
+  Py_ssize_t size = 512;
+  double timeout = 0;
+  char *name = NULL;
+  PyObject *callback = NULL, *data = NULL;
+  static char *kwlist[] = {"callback", "data", "name", "size", "timeout", NULL};
+
+  if (PyArg_ParseTupleAndKeywords(args, kwds, "O|Oetnd", kwlist, &callback,
+                                  &data, NULL, &name, &size, &timeout) == 0)
+    return NULL;
+  if (PyCallable_Check(callback) == 0) {
+    PyMem_Free(name);
+    PyErr_SetString(PyExc_TypeError, "callback needs a be a callable object.");
+    return NULL;
+  }
+  if (size < 1) {
+    PyMem_Free(name);
+    PyErr_SetString(PyExc_ValueError, "size must be at least 1.");
+    return NULL;
+  }
+  cpy_build_name(buf, sizeof(buf), callback, name);
+  PyMem_Free(name);
+
+  c = calloc(1, sizeof(*c));
+  b = calloc(1, sizeof(*b));
+  if ((c == NULL) || (b == NULL)) {
+    free(c);
+    free(b);
+    return PyErr_NoMemory();
+  }
+
+  Py_INCREF(callback);
+  Py_XINCREF(data);
+
+  c->name = strdup(buf);
+  c->callback = callback;
+  c->data = data;
+  c->next = NULL;
+
+  b->c = c;
+  b->size = (size_t)size;
+  b->timeout = (timeout > 0) ? DOUBLE_TO_CDTIME_T(timeout)
+                             : plugin_get_interval();
+  pthread_mutex_init(&b->lock, NULL);
+  b->refs = 2;
+
+  /* The flush and read callbacks share the user data with the write
+   * callback. They use their own name so that they do not replace callbacks
+   * registered by the same module. */
+  ssnprintf(flush_name, sizeof(flush_name), "%s.batch", buf);
+  plugin_register_flush(flush_name, cpy_write_batch_flush,
+                        &(user_data_t){
+                            .data = b,
+                        });
+  plugin_register_complex_read(/* group = */ "python", flush_name,
+                               cpy_write_batch_read, b->timeout,
+                               &(user_data_t){
+                                   .data = b,
+                                   .free_func = cpy_write_batch_destroy,
+                               });
+  plugin_register_write(buf, cpy_write_batch_callback,
+                        &(user_data_t){
+                            .data = b,
+                            .free_func = cpy_write_batch_destroy,
+                        });
+
+  ++cpy_num_callbacks;
+  return cpy_string_to_unicode_or_bytes(buf);
+}
+
 static PyObject *cpy_register_notification(PyObject *self, PyObject *args,
                                            PyObject *kwds) {
   return cpy_register_generic_userdata((void *)plugin_register_notification,
@@ -1014,8 +1250,20 @@ static PyObject *cpy_unregister_read(PyObject *self, PyObject *arg) {
   return cpy_unregister_generic_userdata(plugin_unregister_read, arg, "read");
 }
 
+/* Batch write callbacks have flush and read callbacks sharing their user
+ * data. The flush callback does not hold a reference and has to go first. */
+static int cpy_unregister_write_and_flush(const char *name) {
+  char flush_name[strlen(name) + sizeof(".batch")];
+
+  ssnprintf(flush_name, sizeof(flush_name), "%s.batch", name);
+  plugin_unregister_flush(flush_name);
+  plugin_unregister_read(flush_name);
+  return plugin_unregister_write(name);
+}
+
 static PyObject *cpy_unregister_write(PyObject *self, PyObject *arg) {
-  return cpy_unregister_generic_userdata(plugin_unregister_write, arg, "write");
+  return cpy_unregister_generic_userdata(cpy_unregister_write_and_flush, arg,
+                                         "write");
 }
 
 static PyObject *cpy_unregister_notification(PyObject *self, PyObject *arg) {
@@ -1049,6 +1297,9 @@ static PyMethodDef cpy_methods[] = {
      METH_VARARGS | METH_KEYWORDS, reg_read_doc},
     {"register_write", (PyCFunction)cpy_register_write,
      METH_VARARGS | METH_KEYWORDS, reg_write_doc},
+    {"register_write_batch", (PyCFunction)cpy_register_write_batch,
+     METH_VARARGS | METH_KEYWORDS, reg_write_batch_doc},
+    {"dispatch_batch", cpy_dispatch_batch, METH_O, dispatch_batch_doc},
     {"register_notification", (PyCFunction)cpy_register_notification,
      METH_VARARGS | METH_KEYWORDS, reg_notification_doc},
     {"register_flush", (PyCFunction)cpy_register_flush,
@@ -1309,6 +1560,14 @@ static int cpy_init_python(void) {
     cpy_log_exception("python initialization: NotificationType");
     return 1;
   }
+  if (PyType_Ready(&ValuesBatchType) == -1) {
+    cpy_log_exception("python initialization: ValuesBatchType");
+    return 1;
+  }
+  if (PyType_Ready(&ValuesViewType) == -1) {
+    cpy_log_exception("python initialization: ValuesViewType");
+    return 1;
+  }
   SignedType.tp_base = &PyLong_Type;
   if (PyType_Ready(&SignedType) == -1) {
     cpy_log_exception("python initialization: SignedType");
@@ -1357,6 +1616,10 @@ static int cpy_init_python(void) {
                      (void *)&ConfigType); /* Steals a reference. */
   PyModule_AddObject(module, "Values",
                      (void *)&ValuesType); /* Steals a reference. */
+  PyModule_AddObject(module, "ValuesBatch",
+                     (void *)&ValuesBatchType); /* Steals a reference. */
+  PyModule_AddObject(module, "ValuesView",
+                     (void *)&ValuesViewType); /* Steals a reference. */
   PyModule_AddObject(module, "Notification",
                      (void *)&NotificationType); /* Steals a reference. */
   PyModule_AddObject(module, "Signed",
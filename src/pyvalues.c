@@ -586,64 +586,36 @@ static void cpy_build_notification_meta(notification_t *n, PyObject *meta) {
   cpy_build_meta_generic(meta, &cpy_plugin_notification_meta, (void *)n);
 }
 
-static PyObject *Values_dispatch(Values *self, PyObject *args, PyObject *kwds) {
-  int ret;
+/* Converts "values", "meta", "time" and "interval" and stores them in "vl",
+ * whose identifier must already be set. On success, "vl->values" and
+ * "vl->meta" have to be freed by the caller. On failure, a Python exception is
+ * set and -1 is returned. */
+static int cpy_build_value_list(value_list_t *vl, PyObject *values,
+                                PyObject *meta, double time, double interval) {
   const data_set_t *ds;
   size_t size;
   value_t *value;
-  value_list_t value_list = VALUE_LIST_INIT;
-  PyObject *values = self->values, *meta = self->meta;
-  double time = self->data.time, interval = self->interval;
-  char *host = NULL, *plugin = NULL, *plugin_instance = NULL, *type = NULL,
-       *type_instance = NULL;
 
-  static char *kwlist[] = {
-      "type", "values", "plugin_instance", "type_instance", "plugin",
-      "host", "time",   "interval",        "meta",          NULL};
-  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|etOetetetetddO", kwlist, NULL,
-                                   &type, &values, NULL, &plugin_instance, NULL,
-                                   &type_instance, NULL, &plugin, NULL, &host,
-                                   &time, &interval, &meta))
-    return NULL;
-
-  sstrncpy(value_list.host, host ? host : self->data.host,
-           sizeof(value_list.host));
-  sstrncpy(value_list.plugin, plugin ? plugin : self->data.plugin,
-           sizeof(value_list.plugin));
-  sstrncpy(value_list.plugin_instance,
-           plugin_instance ? plugin_instance : self->data.plugin_instance,
-           sizeof(value_list.plugin_instance));
-  sstrncpy(value_list.type, type ? type : self->data.type,
-           sizeof(value_list.type));
-  sstrncpy(value_list.type_instance,
-           type_instance ? type_instance : self->data.type_instance,
-           sizeof(value_list.type_instance));
-  FreeAll();
-  if (value_list.type[0] == 0) {
-    PyErr_SetString(PyExc_RuntimeError, "type not set");
-    FreeAll();
-    return NULL;
-  }
-  ds = plugin_get_ds(value_list.type);
+  ds = plugin_get_ds(vl->type);
   if (ds == NULL) {
-    PyErr_Format(PyExc_TypeError, "Dataset %s not found", value_list.type);
-    return NULL;
+    PyErr_Format(PyExc_TypeError, "Dataset %s not found", vl->type);
+    return -1;
   }
   if (values == NULL ||
       (PyTuple_Check(values) == 0 && PyList_Check(values) == 0)) {
     PyErr_Format(PyExc_TypeError, "values must be list or tuple");
-    return NULL;
+    return -1;
   }
   if (meta != NULL && meta != Py_None && !PyDict_Check(meta)) {
     PyErr_Format(PyExc_TypeError, "meta must be a dict");
-    return NULL;
+    return -1;
   }
   size = (size_t)PySequence_Length(values);
   if (size != ds->ds_num) {
     PyErr_Format(PyExc_RuntimeError,
                  "type %s needs %" PRIsz " values, got %" PRIsz,
-                 value_list.type, ds->ds_num, size);
-    return NULL;
+                 vl->type, ds->ds_num, size);
+    return -1;
   }
   value = calloc(size, sizeof(*value));
   for (size_t i = 0; i < size; ++i) {
@@ -685,28 +657,131 @@ static PyObject *Values_dispatch(Values *self, PyObject *args, PyObject *kwds) {
     default:
       free(value);
       PyErr_Format(PyExc_RuntimeError, "unknown data type %d for %s",
-                   ds->ds[i].type, value_list.type);
-      return NULL;
+                   ds->ds[i].type, vl->type);
+      return -1;
     }
     if (PyErr_Occurred() != NULL) {
       free(value);
-      return NULL;
+      return -1;
     }
   }
-  value_list.values = value;
-  value_list.meta = cpy_build_meta(meta);
-  value_list.values_len = size;
-  value_list.time = DOUBLE_TO_CDTIME_T(time);
-  value_list.interval = DOUBLE_TO_CDTIME_T(interval);
-  if (value_list.host[0] == 0)
-    sstrncpy(value_list.host, hostname_g, sizeof(value_list.host));
-  if (value_list.plugin[0] == 0)
-    sstrncpy(value_list.plugin, "python", sizeof(value_list.plugin));
+  vl->values = value;
+  vl->meta = cpy_build_meta(meta);
+  vl->values_len = size;
+  vl->time = DOUBLE_TO_CDTIME_T(time);
+  vl->interval = DOUBLE_TO_CDTIME_T(interval);
+  if (vl->host[0] == 0)
+    sstrncpy(vl->host, hostname_g, sizeof(vl->host));
+  if (vl->plugin[0] == 0)
+    sstrncpy(vl->plugin, "python", sizeof(vl->plugin));
+  return 0;
+}
+
+/* Returns a new dict holding the entries of "meta", which may be NULL. Integers
+ * are stored as Signed or Unsigned objects. */
+PyObject *cpy_build_meta_dict(meta_data_t *meta) {
+  PyObject *temp, *dict = PyDict_New(); /* New reference. */
+  if (dict != NULL && meta != NULL) {
+    char **table = NULL;
+
+    int num = meta_data_toc(meta, &table);
+    for (int i = 0; i < num; ++i) {
+      int type;
+      char *string;
+      int64_t si;
+      uint64_t ui;
+      double d;
+      bool b;
+
+      type = meta_data_type(meta, table[i]);
+      if (type == MD_TYPE_STRING) {
+        if (meta_data_get_string(meta, table[i], &string))
+          continue;
+        temp = cpy_string_to_unicode_or_bytes(string); /* New reference. */
+        free(string);
+        PyDict_SetItemString(dict, table[i], temp);
+        Py_XDECREF(temp);
+      } else if (type == MD_TYPE_SIGNED_INT) {
+        if (meta_data_get_signed_int(meta, table[i], &si))
+          continue;
+        PyObject *sival = PyLong_FromLongLong(si); /* New reference */
+        temp = PyObject_CallFunctionObjArgs((void *)&SignedType, sival,
+                                            (void *)0); /* New reference. */
+        PyDict_SetItemString(dict, table[i], temp);
+        Py_XDECREF(temp);
+        Py_XDECREF(sival);
+      } else if (type == MD_TYPE_UNSIGNED_INT) {
+        if (meta_data_get_unsigned_int(meta, table[i], &ui))
+          continue;
+        PyObject *uval = PyLong_FromUnsignedLongLong(ui); /* New reference */
+        temp = PyObject_CallFunctionObjArgs((void *)&UnsignedType, uval,
+                                            (void *)0); /* New reference. */
+        PyDict_SetItemString(dict, table[i], temp);
+        Py_XDECREF(temp);
+        Py_XDECREF(uval);
+      } else if (type == MD_TYPE_DOUBLE) {
+        if (meta_data_get_double(meta, table[i], &d))
+          continue;
+        temp = PyFloat_FromDouble(d); /* New reference. */
+        PyDict_SetItemString(dict, table[i], temp);
+        Py_XDECREF(temp);
+      } else if (type == MD_TYPE_BOOLEAN) {
+        if (meta_data_get_boolean(meta, table[i], &b))
+          continue;
+        if (b)
+          PyDict_SetItemString(dict, table[i], Py_True);
+        else
+          PyDict_SetItemString(dict, table[i], Py_False);
+      }
+      free(table[i]);
+    }
+    free(table);
+  }
+  return dict;
+}
+
+static PyObject *Values_dispatch(Values *self, PyObject *args, PyObject *kwds) {
+  int ret;
+  value_list_t value_list = VALUE_LIST_INIT;
+  PyObject *values = self->values, *meta = self->meta;
+  double time = self->data.time, interval = self->interval;
+  char *host = NULL, *plugin = NULL, *plugin_instance = NULL, *type = NULL,
+       *type_instance = NULL;
+
+  static char *kwlist[] = {
+      "type", "values", "plugin_instance", "type_instance", "plugin",
+      "host", "time",   "interval",        "meta",          NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|etOetetetetddO", kwlist, NULL,
+                                   &type, &values, NULL, &plugin_instance, NULL,
+                                   &type_instance, NULL, &plugin, NULL, &host,
+                                   &time, &interval, &meta))
+    return NULL;
+
+  sstrncpy(value_list.host, host ? host : self->data.host,
+           sizeof(value_list.host));
+  sstrncpy(value_list.plugin, plugin ? plugin : self->data.plugin,
+           sizeof(value_list.plugin));
+  sstrncpy(value_list.plugin_instance,
+           plugin_instance ? plugin_instance : self->data.plugin_instance,
+           sizeof(value_list.plugin_instance));
+  sstrncpy(value_list.type, type ? type : self->data.type,
+           sizeof(value_list.type));
+  sstrncpy(value_list.type_instance,
+           type_instance ? type_instance : self->data.type_instance,
+           sizeof(value_list.type_instance));
+  FreeAll();
+  if (value_list.type[0] == 0) {
+    PyErr_SetString(PyExc_RuntimeError, "type not set");
+    FreeAll();
+    return NULL;
+  }
+  if (cpy_build_value_list(&value_list, values, meta, time, interval) != 0)
+    return NULL;
   Py_BEGIN_ALLOW_THREADS;
   ret = plugin_dispatch_values(&value_list);
   Py_END_ALLOW_THREADS;
   meta_data_destroy(value_list.meta);
-  free(value);
+  free(value_list.values);
   if (ret != 0) {
     PyErr_SetString(PyExc_RuntimeError,
                     "error dispatching values, read the logs");
@@ -1309,3 +1384,356 @@ PyTypeObject UnsignedType = {
     Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /* tp_flags */
     Unsigned_doc                              /* tp_doc */
 };
+
+PyObject *cpy_dispatch_batch(PyObject *self, PyObject *arg) {
+  PyObject *seq;
+  value_list_t *vl;
+  Py_ssize_t num;
+  Py_ssize_t i;
+  int ret;
+
+  seq = PySequence_Fast(arg, "values must be a sequence"); /* New reference. */
+  if (seq == NULL)
+    return NULL;
+
+  num = PySequence_Fast_GET_SIZE(seq);
+  vl = calloc(num > 0 ? num : 1, sizeof(*vl));
+  if (vl == NULL) {
+    Py_DECREF(seq);
+    return PyErr_NoMemory();
+  }
+
+  for (i = 0; i < num; i++) {
+    Values *v =
+        (Values *)PySequence_Fast_GET_ITEM(seq, i); /* Borrowed reference. */
+
+    if (!PyObject_TypeCheck(v, &ValuesType)) {
+      PyErr_Format(PyExc_TypeError, "item %zd is not a Values object", i);
+      break;
+    }
+    if (v->data.type[0] == 0) {
+      PyErr_Format(PyExc_RuntimeError, "type of item %zd not set", i);
+      break;
+    }
+
+    vl[i] = (value_list_t)VALUE_LIST_INIT;
+    sstrncpy(vl[i].host, v->data.host, sizeof(vl[i].host));
+    sstrncpy(vl[i].plugin, v->data.plugin, sizeof(vl[i].plugin));
+    sstrncpy(vl[i].plugin_instance, v->data.plugin_instance,
+             sizeof(vl[i].plugin_instance));
+    sstrncpy(vl[i].type, v->data.type, sizeof(vl[i].type));
+    sstrncpy(vl[i].type_instance, v->data.type_instance,
+             sizeof(vl[i].type_instance));
+    if (cpy_build_value_list(vl + i, v->values, v->meta, v->data.time,
+                             v->interval) != 0)
+      break;
+  }
+
+  ret = 0;
+  if (i == num) {
+    Py_BEGIN_ALLOW_THREADS;
+    ret = plugin_dispatch_values_batch(vl, (size_t)num);
+    Py_END_ALLOW_THREADS;
+  }
+
+  for (Py_ssize_t j = 0; j < i; j++) {
+    meta_data_destroy(vl[j].meta);
+    free(vl[j].values);
+  }
+  free(vl);
+  Py_DECREF(seq);
+
+  if (i != num)
+    return NULL;
+  if (ret != 0) {
+    PyErr_SetString(PyExc_RuntimeError,
+                    "error dispatching values, read the logs");
+    return NULL;
+  }
+  Py_RETURN_NONE;
+}
+
+static char ValuesBatch_doc[] =
+    "A read-only sequence of ValuesView objects passed to batch write\n"
+    "callbacks. The value lists are only converted to Python objects when an\n"
+    "item is accessed.";
+
+static char ValuesView_doc[] =
+    "A read-only view of one value list in a ValuesBatch. The identifier,\n"
+    "time, interval and meta attributes are created when they are accessed.\n"
+    "The object supports the buffer protocol: memoryview(view) exposes the\n"
+    "values without copying them, if all data sources of the type have the\n"
+    "same data source type.";
+
+static char view_values_doc[] =
+    "The values of this value list. This is a read-only memoryview if all\n"
+    "data sources have the same type (format 'd' for gauges, 'q' for derives\n"
+    "and 'Q' for counters and absolutes), and a list otherwise.";
+
+PyObject *ValuesBatch_New(value_list_t *vl, const data_set_t **ds,
+                          value_t *values, size_t vl_num) {
+  ValuesBatch *self;
+
+  self = PyObject_New(ValuesBatch, &ValuesBatchType);
+  if (self == NULL) {
+    for (size_t i = 0; i < vl_num; i++)
+      meta_data_destroy(vl[i].meta);
+    free(vl);
+    free(ds);
+    free(values);
+    return NULL;
+  }
+
+  /* The values of all value lists are stored back to back in "values". */
+  value_t *v = values;
+  for (size_t i = 0; i < vl_num; i++) {
+    vl[i].values = v;
+    v += vl[i].values_len;
+  }
+
+  self->vl = vl;
+  self->ds = ds;
+  self->values = values;
+  self->vl_num = vl_num;
+  return (PyObject *)self;
+}
+
+static void ValuesBatch_dealloc(PyObject *s) {
+  ValuesBatch *self = (ValuesBatch *)s;
+
+  for (size_t i = 0; i < self->vl_num; i++)
+    meta_data_destroy(self->vl[i].meta);
+  free(self->values);
+  free(self->vl);
+  free(self->ds);
+  PyObject_Del(s);
+}
+
+static Py_ssize_t ValuesBatch_length(PyObject *s) {
+  return (Py_ssize_t)((ValuesBatch *)s)->vl_num;
+}
+
+/* Returns the buffer protocol format character for the data sources of "ds"
+ * or NULL if they don't share one. */
+static const char *cpy_ds_format(const data_set_t *ds) {
+  const char *format = NULL;
+
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    const char *f;
+    if (ds->ds[i].type == DS_TYPE_GAUGE)
+      f = "d";
+    else if (ds->ds[i].type == DS_TYPE_DERIVE)
+      f = "q";
+    else
+      f = "Q";
+
+    if (format == NULL)
+      format = f;
+    else if (format[0] != f[0])
+      return NULL;
+  }
+  return format;
+}
+
+static PyObject *ValuesBatch_item(PyObject *s, Py_ssize_t i) {
+  ValuesBatch *batch = (ValuesBatch *)s;
+  ValuesView *self;
+
+  if ((i < 0) || ((size_t)i >= batch->vl_num)) {
+    PyErr_SetString(PyExc_IndexError, "ValuesBatch index out of range");
+    return NULL;
+  }
+
+  self = PyObject_New(ValuesView, &ValuesViewType);
+  if (self == NULL)
+    return NULL;
+
+  Py_INCREF(s);
+  self->batch = batch;
+  self->vl = batch->vl + i;
+  self->ds = batch->ds[i];
+  self->format = cpy_ds_format(self->ds);
+  self->shape = (Py_ssize_t)self->vl->values_len;
+  self->stride = (Py_ssize_t)sizeof(value_t);
+  return (PyObject *)self;
+}
+
+static PySequenceMethods ValuesBatch_as_sequence = {
+    .sq_length = ValuesBatch_length,
+    .sq_item = ValuesBatch_item,
+};
+
+PyTypeObject ValuesBatchType = {
+    CPY_INIT_TYPE "collectd.ValuesBatch", /* tp_name */
+    sizeof(ValuesBatch),                  /* tp_basicsize */
+    0,                                    /* Will be filled in later */
+    ValuesBatch_dealloc,                  /* tp_dealloc */
+    0,                                    /* tp_print */
+    0,                                    /* tp_getattr */
+    0,                                    /* tp_setattr */
+    0,                                    /* tp_compare */
+    0,                                    /* tp_repr */
+    0,                                    /* tp_as_number */
+    &ValuesBatch_as_sequence,             /* tp_as_sequence */
+    0,                                    /* tp_as_mapping */
+    0,                                    /* tp_hash */
+    0,                                    /* tp_call */
+    0,                                    /* tp_str */
+    0,                                    /* tp_getattro */
+    0,                                    /* tp_setattro */
+    0,                                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                   /* tp_flags */
+    ValuesBatch_doc,                      /* tp_doc */
+};
+
+static void ValuesView_dealloc(PyObject *s) {
+  ValuesView *self = (ValuesView *)s;
+
+  Py_DECREF(self->batch);
+  PyObject_Del(s);
+}
+
+static PyObject *ValuesView_getstring(PyObject *s, void *data) {
+  const char *value = ((char *)((ValuesView *)s)->vl) + (intptr_t)data;
+
+  return cpy_string_to_unicode_or_bytes(value);
+}
+
+static PyObject *ValuesView_gettime(PyObject *s, void *data) {
+  const cdtime_t *t =
+      (const cdtime_t *)(((char *)((ValuesView *)s)->vl) + (intptr_t)data);
+
+  return PyFloat_FromDouble(CDTIME_T_TO_DOUBLE(*t));
+}
+
+static PyObject *ValuesView_getvalues(PyObject *s, void *data) {
+  ValuesView *self = (ValuesView *)s;
+  const value_list_t *vl = self->vl;
+  PyObject *list;
+
+  if (self->format != NULL)
+    return PyMemoryView_FromObject(s);
+
+  list = PyList_New(vl->values_len); /* New reference. */
+  if (list == NULL)
+    return NULL;
+  for (size_t i = 0; i < vl->values_len; i++) {
+    PyObject *v;
+    if (self->ds->ds[i].type == DS_TYPE_GAUGE)
+      v = PyFloat_FromDouble(vl->values[i].gauge);
+    else if (self->ds->ds[i].type == DS_TYPE_DERIVE)
+      v = PyLong_FromLongLong(vl->values[i].derive);
+    else if (self->ds->ds[i].type == DS_TYPE_COUNTER)
+      v = PyLong_FromUnsignedLongLong(vl->values[i].counter);
+    else
+      v = PyLong_FromUnsignedLongLong(vl->values[i].absolute);
+    if (v == NULL) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    PyList_SET_ITEM(list, i, v);
+  }
+  return list;
+}
+
+static PyObject *ValuesView_getmeta(PyObject *s, void *data) {
+  return cpy_build_meta_dict(((ValuesView *)s)->vl->meta);
+}
+
+static PyObject *ValuesView_repr(PyObject *s) {
+  const value_list_t *vl = ((ValuesView *)s)->vl;
+
+  return PyUnicode_FromFormat("collectd.ValuesView(host=%s,plugin=%s,"
+                              "plugin_instance=%s,type=%s,type_instance=%s)",
+                              vl->host, vl->plugin, vl->plugin_instance,
+                              vl->type, vl->type_instance);
+}
+
+static int ValuesView_getbuffer(PyObject *s, Py_buffer *view, int flags) {
+  ValuesView *self = (ValuesView *)s;
+
+  if (self->format == NULL) {
+    PyErr_Format(PyExc_BufferError,
+                 "the data sources of type %s differ in their types",
+                 self->vl->type);
+    view->obj = NULL;
+    return -1;
+  }
+  if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "ValuesView is read-only");
+    view->obj = NULL;
+    return -1;
+  }
+
+  Py_INCREF(s);
+  view->obj = s;
+  view->buf = self->vl->values;
+  view->len = self->shape * self->stride;
+  view->readonly = 1;
+  view->itemsize = self->stride;
+  view->format = ((flags & PyBUF_FORMAT) == PyBUF_FORMAT)
+                     ? (char *)self->format
+                     : NULL;
+  view->ndim = 1;
+  view->shape = ((flags & PyBUF_ND) == PyBUF_ND) ? &self->shape : NULL;
+  view->strides =
+      ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? &self->stride : NULL;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+  return 0;
+}
+
+static PyBufferProcs ValuesView_as_buffer = {
+    .bf_getbuffer = ValuesView_getbuffer,
+};
+
+static PyGetSetDef ValuesView_getseters[] = {
+    {"host", ValuesView_getstring, NULL, host_doc,
+     (void *)offsetof(value_list_t, host)},
+    {"plugin", ValuesView_getstring, NULL, plugin_doc,
+     (void *)offsetof(value_list_t, plugin)},
+    {"plugin_instance", ValuesView_getstring, NULL, plugin_instance_doc,
+     (void *)offsetof(value_list_t, plugin_instance)},
+    {"type", ValuesView_getstring, NULL, type_doc,
+     (void *)offsetof(value_list_t, type)},
+    {"type_instance", ValuesView_getstring, NULL, type_instance_doc,
+     (void *)offsetof(value_list_t, type_instance)},
+    {"time", ValuesView_gettime, NULL, time_doc,
+     (void *)offsetof(value_list_t, time)},
+    {"interval", ValuesView_gettime, NULL, interval_doc,
+     (void *)offsetof(value_list_t, interval)},
+    {"values", ValuesView_getvalues, NULL, view_values_doc, NULL},
+    {"meta", ValuesView_getmeta, NULL, meta_doc, NULL},
+    {NULL}};
+
+PyTypeObject ValuesViewType = {
+    CPY_INIT_TYPE "collectd.ValuesView", /* tp_name */
+    sizeof(ValuesView),                  /* tp_basicsize */
+    0,                                   /* Will be filled in later */
+    ValuesView_dealloc,                  /* tp_dealloc */
+    0,                                   /* tp_print */
+    0,                                   /* tp_getattr */
+    0,                                   /* tp_setattr */
+    0,                                   /* tp_compare */
+    ValuesView_repr,                     /* tp_repr */
+    0,                                   /* tp_as_number */
+    0,                                   /* tp_as_sequence */
+    0,                                   /* tp_as_mapping */
+    0,                                   /* tp_hash */
+    0,                                   /* tp_call */
+    0,                                   /* tp_str */
+    0,                                   /* tp_getattro */
+    0,                                   /* tp_setattro */
+    &ValuesView_as_buffer,               /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                  /* tp_flags */
+    ValuesView_doc,                      /* tp_doc */
+    0,                                   /* tp_traverse */
+    0,                                   /* tp_clear */
+    0,                                   /* tp_richcompare */
+    0,                                   /* tp_weaklistoffset */
+    0,                                   /* tp_iter */
+    0,                                   /* tp_iternext */
+    0,                                   /* tp_methods */
+    0,                                   /* tp_members */
+    ValuesView_getseters,                /* tp_getset */
+};
@@ -0,0 +1,801 @@
+/**
+ * collectd - src/rollup.c
+ * Copyright (C) 2026 The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/avltree/avltree.h"
+#include "utils/common/common.h"
+#include "utils/lookup/vl_lookup.h"
+#include "utils/metadata/meta_data.h"
+#include "utils_cache.h" /* for uc_get_rate() */
+
+/* Number of rates kept on the stack. Types with more data sources fall back
+ * to the heap. */
+#define RU_RATES_STATIC 16
+
+typedef enum {
+  RU_MIN = 0,
+  RU_MAX,
+  RU_AVERAGE,
+  RU_SUM,
+  RU_COUNT,
+  RU_LAST,
+  RU_FUNC_NUM
+} ru_func_t;
+
+static char const *const ru_func_names[RU_FUNC_NUM] = {
+    "min", "max", "average", "sum", "count", "last",
+};
+
+struct rollup_s /* {{{ */
+{
+  lookup_identifier_t ident;
+
+  cdtime_t *resolution;
+  char (*resolution_name)[DATA_MAX_NAME_LEN];
+  size_t resolution_num;
+
+  bool calc[RU_FUNC_NUM];
+
+  /* Protects the "series" tree, not the series themselves. */
+  pthread_mutex_t lock;
+  c_avl_tree_t *series;
+
+  struct rollup_s *next;
+}; /* }}} */
+typedef struct rollup_s rollup_t;
+
+/* Values of one time window. All arrays have one entry per data source. */
+struct ru_window_s /* {{{ */
+{
+  /* Start of the window, aligned to a multiple of the resolution. Zero if
+   * the window has not received any values yet. */
+  cdtime_t start;
+  /* End of the last emitted window. Values before it arrived too late. */
+  cdtime_t emitted_end;
+
+  size_t *num;
+  gauge_t *sum;
+  gauge_t *min;
+  gauge_t *max;
+  gauge_t *last;
+
+  /* RU_FUNC_NUM * ds_num entries, indexed by "func * ds_num + ds_index". */
+  rate_to_value_state_t *state;
+}; /* }}} */
+typedef struct ru_window_s ru_window_t;
+
+struct ru_series_s /* {{{ */
+{
+  pthread_mutex_t lock;
+
+  /* Identifier of the emitted value lists. */
+  value_list_t vl;
+
+  size_t ds_num;
+  int *ds_type;
+
+  cdtime_t last_update;
+
+  /* One window per resolution of the rollup. */
+  ru_window_t *window;
+}; /* }}} */
+typedef struct ru_series_s ru_series_t;
+
+static lookup_t *lookup;
+
+static pthread_mutex_t rollup_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static rollup_t *rollup_list_head;
+
+static void ru_window_reset(ru_window_t *w, size_t ds_num) /* {{{ */
+{
+  w->start = 0;
+  for (size_t i = 0; i < ds_num; i++) {
+    w->num[i] = 0;
+    w->sum[i] = 0.0;
+    w->min[i] = NAN;
+    w->max[i] = NAN;
+    w->last[i] = NAN;
+  }
+} /* }}} void ru_window_reset */
+
+static void ru_series_destroy(ru_series_t *s, size_t resolution_num) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  if (s->window != NULL) {
+    for (size_t i = 0; i < resolution_num; i++) {
+      ru_window_t *w = s->window + i;
+      sfree(w->num);
+      sfree(w->sum);
+      sfree(w->min);
+      sfree(w->max);
+      sfree(w->last);
+      sfree(w->state);
+    }
+    sfree(s->window);
+  }
+
+  sfree(s->ds_type);
+  pthread_mutex_destroy(&s->lock);
+  sfree(s);
+} /* }}} void ru_series_destroy */
+
+static ru_series_t *ru_series_create(rollup_t const *ru, /* {{{ */
+                                     data_set_t const *ds,
+                                     value_list_t const *vl) {
+  ru_series_t *s = calloc(1, sizeof(*s));
+  if (s == NULL)
+    return NULL;
+
+  pthread_mutex_init(&s->lock, /* attr = */ NULL);
+
+  sstrncpy(s->vl.host, vl->host, sizeof(s->vl.host));
+  sstrncpy(s->vl.plugin, vl->plugin, sizeof(s->vl.plugin));
+  sstrncpy(s->vl.plugin_instance, vl->plugin_instance,
+           sizeof(s->vl.plugin_instance));
+  sstrncpy(s->vl.type, vl->type, sizeof(s->vl.type));
+  sstrncpy(s->vl.type_instance, vl->type_instance,
+           sizeof(s->vl.type_instance));
+
+  s->vl.interval = vl->interval;
+
+  s->ds_num = ds->ds_num;
+  s->ds_type = calloc(ds->ds_num, sizeof(*s->ds_type));
+  s->window = calloc(ru->resolution_num, sizeof(*s->window));
+  if ((s->ds_type == NULL) || (s->window == NULL)) {
+    ru_series_destroy(s, ru->resolution_num);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < ds->ds_num; i++)
+    s->ds_type[i] = ds->ds[i].type;
+
+  for (size_t i = 0; i < ru->resolution_num; i++) {
+    ru_window_t *w = s->window + i;
+
+    w->num = calloc(ds->ds_num, sizeof(*w->num));
+    w->sum = calloc(ds->ds_num, sizeof(*w->sum));
+    w->min = calloc(ds->ds_num, sizeof(*w->min));
+    w->max = calloc(ds->ds_num, sizeof(*w->max));
+    w->last = calloc(ds->ds_num, sizeof(*w->last));
+    w->state = calloc(RU_FUNC_NUM * ds->ds_num, sizeof(*w->state));
+    if ((w->num == NULL) || (w->sum == NULL) || (w->min == NULL) ||
+        (w->max == NULL) || (w->last == NULL) || (w->state == NULL)) {
+      ru_series_destroy(s, ru->resolution_num);
+      return NULL;
+    }
+
+    ru_window_reset(w, ds->ds_num);
+  }
+
+  return s;
+} /* }}} ru_series_t *ru_series_create */
+
+static void ru_destroy(rollup_t *ru) /* {{{ */
+{
+  if (ru == NULL)
+    return;
+
+  if (ru->series != NULL) {
+    char *key = NULL;
+    ru_series_t *s = NULL;
+    while (c_avl_pick(ru->series, (void *)&key, (void *)&s) == 0) {
+      sfree(key);
+      ru_series_destroy(s, ru->resolution_num);
+    }
+    c_avl_destroy(ru->series);
+  }
+
+  pthread_mutex_destroy(&ru->lock);
+  sfree(ru->resolution);
+  sfree(ru->resolution_name);
+  sfree(ru);
+} /* }}} void ru_destroy */
+
+/* Formats a resolution as "30s", "5m", "1h", ... */
+static void ru_resolution_name(char *buffer, size_t buffer_size, /* {{{ */
+                               cdtime_t resolution) {
+  if ((resolution % TIME_T_TO_CDTIME_T(3600)) == 0)
+    snprintf(buffer, buffer_size, "%" PRIu64 "h",
+             (uint64_t)(CDTIME_T_TO_TIME_T(resolution) / 3600));
+  else if ((resolution % TIME_T_TO_CDTIME_T(60)) == 0)
+    snprintf(buffer, buffer_size, "%" PRIu64 "m",
+             (uint64_t)(CDTIME_T_TO_TIME_T(resolution) / 60));
+  else
+    snprintf(buffer, buffer_size, "%.6gs", CDTIME_T_TO_DOUBLE(resolution));
+} /* }}} void ru_resolution_name */
+
+/* Dispatches the values of a completed window and resets it. Must be called
+ * with the series' lock held. */
+static void ru_window_emit(rollup_t const *ru, ru_series_t *s, /* {{{ */
+                           size_t resolution_index) {
+  ru_window_t *w = s->window + resolution_index;
+  cdtime_t resolution = ru->resolution[resolution_index];
+  cdtime_t end = w->start + resolution;
+
+  w->emitted_end = end;
+
+  value_list_t vl = s->vl;
+  value_t *values = calloc(s->ds_num, sizeof(*values));
+
+  vl.values = values;
+  vl.values_len = s->ds_num;
+  vl.time = end;
+  vl.interval = resolution;
+
+  vl.meta = meta_data_create();
+  if ((values == NULL) || (vl.meta == NULL)) {
+    ERROR("rollup plugin: Allocating the value list failed.");
+    meta_data_destroy(vl.meta);
+    sfree(values);
+    ru_window_reset(w, s->ds_num);
+    return;
+  }
+  meta_data_add_boolean(vl.meta, "rollup:created", true);
+  meta_data_add_string(vl.meta, "rollup:resolution",
+                       ru->resolution_name[resolution_index]);
+
+  for (int func = 0; func < RU_FUNC_NUM; func++) {
+    if (!ru->calc[func])
+      continue;
+
+    bool complete = true;
+    for (size_t i = 0; i < s->ds_num; i++) {
+      gauge_t rate = NAN;
+      switch (func) {
+      case RU_MIN:
+        rate = w->min[i];
+        break;
+      case RU_MAX:
+        rate = w->max[i];
+        break;
+      case RU_AVERAGE:
+        if (w->num[i] > 0)
+          rate = w->sum[i] / (gauge_t)w->num[i];
+        break;
+      case RU_SUM:
+        rate = w->sum[i];
+        break;
+      case RU_COUNT:
+        rate = (gauge_t)w->num[i];
+        break;
+      case RU_LAST:
+        rate = w->last[i];
+        break;
+      }
+
+      if (isnan(rate) && (s->ds_type[i] != DS_TYPE_GAUGE)) {
+        complete = false;
+        break;
+      }
+
+      int status = rate_to_value(values + i, rate,
+                                 w->state + (func * s->ds_num) + i,
+                                 s->ds_type[i], end);
+      /* For the first window of a COUNTER or DERIVE, rate_to_value() returns
+       * EAGAIN. There's nothing to emit yet in that case. */
+      if (status != 0) {
+        if (status != EAGAIN)
+          WARNING("rollup plugin: rate_to_value failed with status %i.",
+                  status);
+        complete = false;
+      }
+    }
+
+    if (!complete)
+      continue;
+
+    if (s->vl.plugin_instance[0] != 0)
+      ssnprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "%s-%s-%s",
+                s->vl.plugin_instance, ru_func_names[func],
+                ru->resolution_name[resolution_index]);
+    else
+      ssnprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "%s-%s",
+                ru_func_names[func], ru->resolution_name[resolution_index]);
+
+    meta_data_add_string(vl.meta, "rollup:function", ru_func_names[func]);
+
+    plugin_dispatch_values(&vl);
+  }
+
+  meta_data_destroy(vl.meta);
+  sfree(values);
+  ru_window_reset(w, s->ds_num);
+} /* }}} void ru_window_emit */
+
+static void ru_series_update(rollup_t const *ru, ru_series_t *s, /* {{{ */
+                             gauge_t const *rates, cdtime_t t) {
+  for (size_t r = 0; r < ru->resolution_num; r++) {
+    ru_window_t *w = s->window + r;
+    cdtime_t resolution = ru->resolution[r];
+
+    /* The window of this value has been emitted, possibly by ru_flush()
+     * before the next window was opened. */
+    if ((t < w->emitted_end) || ((w->start != 0) && (t < w->start))) {
+      DEBUG("rollup plugin: Ignoring a late value of \"%s/%s\".",
+            s->vl.host, s->vl.plugin);
+      continue;
+    }
+
+    if ((w->start != 0) && (t >= w->start + resolution))
+      ru_window_emit(ru, s, r);
+
+    if (w->start == 0)
+      w->start = t - (t % resolution);
+
+    for (size_t i = 0; i < s->ds_num; i++) {
+      if (isnan(rates[i]))
+        continue;
+
+      w->num[i]++;
+      w->sum[i] += rates[i];
+      if (isnan(w->min[i]) || (w->min[i] > rates[i]))
+        w->min[i] = rates[i];
+      if (isnan(w->max[i]) || (w->max[i] < rates[i]))
+        w->max[i] = rates[i];
+      w->last[i] = rates[i];
+    }
+  }
+
+  s->last_update = cdtime();
+} /* }}} void ru_series_update */
+
+static int ru_update(rollup_t *ru, data_set_t const *ds, /* {{{ */
+                     value_list_t const *vl) {
+  char name[6 * DATA_MAX_NAME_LEN];
+  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
+    ERROR("rollup plugin: FORMAT_VL failed.");
+    return -1;
+  }
+
+  /* Use the rates computed when this value list was added to the cache. If
+   * the value list did not come through plugin_dispatch_values(), look them
+   * up in the cache. */
+  gauge_t rates_static[RU_RATES_STATIC];
+  gauge_t *rates = rates_static;
+  gauge_t *rates_cached = NULL;
+  if ((ds->ds_num > RU_RATES_STATIC) ||
+      (uc_get_rate_dispatched(vl, rates, ds->ds_num) != 0)) {
+    rates_cached = uc_get_rate(ds, vl);
+    if (rates_cached == NULL) {
+      ERROR("rollup plugin: Unable to read the current rate of \"%s\".", name);
+      return ENOENT;
+    }
+    rates = rates_cached;
+  }
+
+  pthread_mutex_lock(&ru->lock);
+
+  ru_series_t *s = NULL;
+  if (c_avl_get(ru->series, name, (void *)&s) != 0) {
+    s = ru_series_create(ru, ds, vl);
+    char *key = strdup(name);
+    if ((s == NULL) || (key == NULL) ||
+        (c_avl_insert(ru->series, key, s) != 0)) {
+      pthread_mutex_unlock(&ru->lock);
+      ERROR("rollup plugin: Creating the rollup of \"%s\" failed.", name);
+      ru_series_destroy(s, ru->resolution_num);
+      sfree(key);
+      sfree(rates_cached);
+      return ENOMEM;
+    }
+  }
+
+  /* Lock the series before releasing the tree, so that ru_flush() cannot
+   * remove it in between. */
+  pthread_mutex_lock(&s->lock);
+  pthread_mutex_unlock(&ru->lock);
+
+  if (s->ds_num == ds->ds_num) {
+    s->vl.interval = vl->interval;
+    ru_series_update(ru, s, rates, vl->time);
+  }
+
+  pthread_mutex_unlock(&s->lock);
+
+  sfree(rates_cached);
+  return 0;
+} /* }}} int ru_update */
+
+/* Emits all windows that ended at least one interval ago, i.e. windows that
+ * will not receive any more values in time, and removes series that have not
+ * been updated for two of the largest windows. */
+static void ru_flush(rollup_t *ru, cdtime_t now) /* {{{ */
+{
+  cdtime_t max_resolution = ru->resolution[ru->resolution_num - 1];
+
+  pthread_mutex_lock(&ru->lock);
+
+  c_avl_iterator_t *iter = c_avl_get_iterator(ru->series);
+  char *key = NULL;
+  ru_series_t *s = NULL;
+  char **expired = NULL;
+  size_t expired_num = 0;
+
+  while (c_avl_iterator_next(iter, (void *)&key, (void *)&s) == 0) {
+    pthread_mutex_lock(&s->lock);
+
+    cdtime_t grace = s->vl.interval;
+    if (grace == 0)
+      grace = plugin_get_interval();
+
+    for (size_t r = 0; r < ru->resolution_num; r++) {
+      ru_window_t *w = s->window + r;
+      if ((w->start != 0) && (now >= w->start + ru->resolution[r] + grace))
+        ru_window_emit(ru, s, r);
+    }
+
+    if ((now > s->last_update) &&
+        (now - s->last_update > 2 * max_resolution)) {
+      char **tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
+      if (tmp != NULL) {
+        expired = tmp;
+        expired[expired_num] = key;
+        expired_num++;
+      }
+    }
+
+    pthread_mutex_unlock(&s->lock);
+  }
+  c_avl_iterator_destroy(iter);
+
+  for (size_t i = 0; i < expired_num; i++) {
+    if (c_avl_remove(ru->series, expired[i], (void *)&key, (void *)&s) != 0)
+      continue;
+    DEBUG("rollup plugin: Removing expired series \"%s\".", key);
+    ru_series_destroy(s, ru->resolution_num);
+    sfree(key);
+  }
+  sfree(expired);
+
+  pthread_mutex_unlock(&ru->lock);
+} /* }}} void ru_flush */
+
+/* lookup_class_callback_t for utils_vl_lookup. Rollups don't group value
+ * lists, so there is only one object per rollup and the rollup itself keeps
+ * track of the individual series. */
+static void *ru_lookup_class_callback(/* {{{ */
+                                      __attribute__((unused))
+                                      data_set_t const *ds,
+                                      __attribute__((unused))
+                                      value_list_t const *vl,
+                                      void *user_class) {
+  return user_class;
+} /* }}} void *ru_lookup_class_callback */
+
+/* lookup_obj_callback_t for utils_vl_lookup */
+static int ru_lookup_obj_callback(data_set_t const *ds, /* {{{ */
+                                  value_list_t const *vl,
+                                  __attribute__((unused)) void *user_class,
+                                  void *user_obj) {
+  return ru_update((rollup_t *)user_obj, ds, vl);
+} /* }}} int ru_lookup_obj_callback */
+
+/* lookup_free_class_callback_t for utils_vl_lookup */
+static void ru_lookup_free_class_callback(void *user_class) /* {{{ */
+{
+  ru_destroy((rollup_t *)user_class);
+} /* }}} void ru_lookup_free_class_callback */
+
+static int ru_compare_cdtime(void const *a, void const *b) /* {{{ */
+{
+  cdtime_t x = *(cdtime_t const *)a;
+  cdtime_t y = *(cdtime_t const *)b;
+
+  if (x < y)
+    return -1;
+  else if (x > y)
+    return 1;
+  return 0;
+} /* }}} int ru_compare_cdtime */
+
+/*
+ * <Plugin "rollup">
+ *   <Rollup>
+ *     Plugin "interface"
+ *     Type "if_octets"
+ *
+ *     Resolution 60 300 3600
+ *
+ *     CalculateMinimum true
+ *     CalculateMaximum true
+ *     CalculateAverage true
+ *     CalculateSum false
+ *     CalculateCount false
+ *     CalculateLast false
+ *   </Rollup>
+ * </Plugin>
+ */
+static int ru_config_handle_resolution(oconfig_item_t const *ci, /* {{{ */
+                                       rollup_t *ru) {
+  if (ci->values_num < 1) {
+    ERROR("rollup plugin: The \"%s\" option requires at least one argument.",
+          ci->key);
+    return EINVAL;
+  }
+
+  for (int i = 0; i < ci->values_num; i++) {
+    if ((ci->values[i].type != OCONFIG_TYPE_NUMBER) ||
+        !(ci->values[i].value.number > 0.0)) {
+      ERROR("rollup plugin: Argument %i of the \"%s\" option must be a "
+            "positive number.",
+            i + 1, ci->key);
+      return EINVAL;
+    }
+  }
+
+  size_t new_num = ru->resolution_num + (size_t)ci->values_num;
+  cdtime_t *tmp = realloc(ru->resolution, new_num * sizeof(*ru->resolution));
+  if (tmp == NULL) {
+    ERROR("rollup plugin: realloc failed.");
+    return ENOMEM;
+  }
+  ru->resolution = tmp;
+
+  for (int i = 0; i < ci->values_num; i++) {
+    ru->resolution[ru->resolution_num] =
+        DOUBLE_TO_CDTIME_T(ci->values[i].value.number);
+    ru->resolution_num++;
+  }
+
+  return 0;
+} /* }}} int ru_config_handle_resolution */
+
+static int ru_config_rollup(oconfig_item_t *ci) /* {{{ */
+{
+  rollup_t *ru = calloc(1, sizeof(*ru));
+  if (ru == NULL) {
+    ERROR("rollup plugin: calloc failed.");
+    return -1;
+  }
+  pthread_mutex_init(&ru->lock, /* attr = */ NULL);
+
+  sstrncpy(ru->ident.host, "/.*/", sizeof(ru->ident.host));
+  sstrncpy(ru->ident.plugin, "/.*/", sizeof(ru->ident.plugin));
+  sstrncpy(ru->ident.plugin_instance, "/.*/",
+           sizeof(ru->ident.plugin_instance));
+  sstrncpy(ru->ident.type, "/.*/", sizeof(ru->ident.type));
+  sstrncpy(ru->ident.type_instance, "/.*/", sizeof(ru->ident.type_instance));
+
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+    int status = 0;
+
+    if (strcasecmp("Host", child->key) == 0)
+      status = cf_util_get_string_buffer(child, ru->ident.host,
+                                         sizeof(ru->ident.host));
+    else if (strcasecmp("Plugin", child->key) == 0)
+      status = cf_util_get_string_buffer(child, ru->ident.plugin,
+                                         sizeof(ru->ident.plugin));
+    else if (strcasecmp("PluginInstance", child->key) == 0)
+      status = cf_util_get_string_buffer(child, ru->ident.plugin_instance,
+                                         sizeof(ru->ident.plugin_instance));
+    else if (strcasecmp("Type", child->key) == 0)
+      status = cf_util_get_string_buffer(child, ru->ident.type,
+                                         sizeof(ru->ident.type));
+    else if (strcasecmp("TypeInstance", child->key) == 0)
+      status = cf_util_get_string_buffer(child, ru->ident.type_instance,
+                                         sizeof(ru->ident.type_instance));
+    else if (strcasecmp("Resolution", child->key) == 0)
+      status = ru_config_handle_resolution(child, ru);
+    else if (strcasecmp("CalculateMinimum", child->key) == 0)
+      status = cf_util_get_boolean(child, &ru->calc[RU_MIN]);
+    else if (strcasecmp("CalculateMaximum", child->key) == 0)
+      status = cf_util_get_boolean(child, &ru->calc[RU_MAX]);
+    else if (strcasecmp("CalculateAverage", child->key) == 0)
+      status = cf_util_get_boolean(child, &ru->calc[RU_AVERAGE]);
+    else if (strcasecmp("CalculateSum", child->key) == 0)
+      status = cf_util_get_boolean(child, &ru->calc[RU_SUM]);
+    else if (strcasecmp("CalculateCount", child->key) == 0)
+      status = cf_util_get_boolean(child, &ru->calc[RU_COUNT]);
+    else if (strcasecmp("CalculateLast", child->key) == 0)
+      status = cf_util_get_boolean(child, &ru->calc[RU_LAST]);
+    else
+      WARNING("rollup plugin: The \"%s\" key is not allowed inside "
+              "<Rollup /> blocks and will be ignored.",
+              child->key);
+
+    if (status != 0) {
+      ru_destroy(ru);
+      return status;
+    }
+  } /* for (int i = 0; i < ci->children_num; i++) */
+
+  /* Sanity checking */
+  bool is_valid = true;
+  if (strcmp("/.*/", ru->ident.type) == 0) /* {{{ */
+  {
+    ERROR("rollup plugin: It appears you did not specify the required "
+          "\"Type\" option in this rollup. "
+          "(Host \"%s\", Plugin \"%s\", PluginInstance \"%s\", "
+          "Type \"%s\", TypeInstance \"%s\")",
+          ru->ident.host, ru->ident.plugin, ru->ident.plugin_instance,
+          ru->ident.type, ru->ident.type_instance);
+    is_valid = false;
+  } else if (strchr(ru->ident.type, '/') != NULL) {
+    ERROR("rollup plugin: The \"Type\" may not contain the '/' "
+          "character. Especially, it may not be a regex. The current "
+          "value is \"%s\".",
+          ru->ident.type);
+    is_valid = false;
+  } /* }}} */
+
+  if (ru->resolution_num == 0) {
+    ERROR("rollup plugin: At least one \"Resolution\" is required. "
+          "(Host \"%s\", Plugin \"%s\", PluginInstance \"%s\", "
+          "Type \"%s\", TypeInstance \"%s\")",
+          ru->ident.host, ru->ident.plugin, ru->ident.plugin_instance,
+          ru->ident.type, ru->ident.type_instance);
+    is_valid = false;
+  }
+
+  bool calc_any = false;
+  for (int func = 0; func < RU_FUNC_NUM; func++)
+    calc_any = calc_any || ru->calc[func];
+  if (!calc_any) {
+    ERROR("rollup plugin: No rollup function has been specified. "
+          "(Host \"%s\", Plugin \"%s\", PluginInstance \"%s\", "
+          "Type \"%s\", TypeInstance \"%s\")",
+          ru->ident.host, ru->ident.plugin, ru->ident.plugin_instance,
+          ru->ident.type, ru->ident.type_instance);
+    is_valid = false;
+  }
+
+  qsort(ru->resolution, ru->resolution_num, sizeof(*ru->resolution),
+        ru_compare_cdtime);
+  for (size_t i = 1; i < ru->resolution_num; i++) {
+    if (ru->resolution[i] != ru->resolution[i - 1])
+      continue;
+    ERROR("rollup plugin: The resolution %.3f is given more than once. "
+          "(Host \"%s\", Plugin \"%s\", PluginInstance \"%s\", "
+          "Type \"%s\", TypeInstance \"%s\")",
+          CDTIME_T_TO_DOUBLE(ru->resolution[i]), ru->ident.host,
+          ru->ident.plugin, ru->ident.plugin_instance, ru->ident.type,
+          ru->ident.type_instance);
+    is_valid = false;
+    break;
+  }
+
+  if (!is_valid) {
+    ru_destroy(ru);
+    return -1;
+  }
+
+  ru->resolution_name =
+      calloc(ru->resolution_num, sizeof(*ru->resolution_name));
+  ru->series = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if ((ru->resolution_name == NULL) || (ru->series == NULL)) {
+    ERROR("rollup plugin: calloc failed.");
+    ru_destroy(ru);
+    return -1;
+  }
+
+  for (size_t i = 0; i < ru->resolution_num; i++)
+    ru_resolution_name(ru->resolution_name[i], sizeof(ru->resolution_name[i]),
+                       ru->resolution[i]);
+
+  int status = lookup_add(lookup, &ru->ident, /* group_by = */ 0, ru);
+  if (status != 0) {
+    ERROR("rollup plugin: lookup_add failed with status %i.", status);
+    ru_destroy(ru);
+    return -1;
+  }
+
+  ru->next = rollup_list_head;
+  rollup_list_head = ru;
+
+  DEBUG("rollup plugin: Successfully added rollup: "
+        "(Host \"%s\", Plugin \"%s\", PluginInstance \"%s\", "
+        "Type \"%s\", TypeInstance \"%s\")",
+        ru->ident.host, ru->ident.plugin, ru->ident.plugin_instance,
+        ru->ident.type, ru->ident.type_instance);
+  return 0;
+} /* }}} int ru_config_rollup */
+
+static int ru_config(oconfig_item_t *ci) /* {{{ */
+{
+  pthread_mutex_lock(&rollup_list_lock);
+
+  if (lookup == NULL) {
+    lookup = lookup_create(ru_lookup_class_callback, ru_lookup_obj_callback,
+                           ru_lookup_free_class_callback,
+                           /* free_obj = */ NULL);
+    if (lookup == NULL) {
+      pthread_mutex_unlock(&rollup_list_lock);
+      ERROR("rollup plugin: lookup_create failed.");
+      return -1;
+    }
+  }
+
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("Rollup", child->key) == 0)
+      ru_config_rollup(child);
+    else
+      WARNING("rollup plugin: The \"%s\" key is not allowed inside "
+              "<Plugin rollup /> blocks and will be ignored.",
+              child->key);
+  }
+
+  pthread_mutex_unlock(&rollup_list_lock);
+
+  return 0;
+} /* }}} int ru_config */
+
+static int ru_read(void) /* {{{ */
+{
+  cdtime_t now = cdtime();
+
+  /* Rollups are only added while reading the configuration. */
+  for (rollup_t *ru = rollup_list_head; ru != NULL; ru = ru->next)
+    ru_flush(ru, now);
+
+  return 0;
+} /* }}} int ru_read */
+
+static int ru_write(data_set_t const *ds, value_list_t const *vl, /* {{{ */
+                    __attribute__((unused)) user_data_t *user_data) {
+  bool created_by_rollup = false;
+  /* Ignore values that were created by the rollup plugin, so that rollups are
+   * not rolled up again. */
+  (void)meta_data_get_boolean(vl->meta, "rollup:created", &created_by_rollup);
+  if (created_by_rollup)
+    return 0;
+
+  int status;
+
+  if (lookup == NULL)
+    status = ENOENT;
+  else {
+    status = lookup_search(lookup, ds, vl);
+    if (status > 0)
+      status = 0;
+  }
+
+  return status;
+} /* }}} int ru_write */
+
+static int ru_shutdown(void) /* {{{ */
+{
+  pthread_mutex_lock(&rollup_list_lock);
+
+  /* The rollups themselves are freed by the lookup. */
+  lookup_destroy(lookup);
+  lookup = NULL;
+  rollup_list_head = NULL;
+
+  pthread_mutex_unlock(&rollup_list_lock);
+
+  return 0;
+} /* }}} int ru_shutdown */
+
+void module_register(void) {
+  plugin_register_complex_config("rollup", ru_config);
+  plugin_register_read("rollup", ru_read);
+  plugin_register_write("rollup", ru_write, /* user_data = */ NULL);
+  plugin_register_shutdown("rollup", ru_shutdown);
+}
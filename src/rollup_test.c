@@ -0,0 +1,289 @@
+/**
+ * collectd - src/rollup_test.c
+ * Copyright (C) 2026 The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#define plugin_dispatch_values plugin_dispatch_values_rollup_test
+#define uc_get_rate_dispatched uc_get_rate_dispatched_rollup_test
+
+/* testing.h has to be included first for the declaration of cdtime_mock. */
+#include "testing.h"
+
+#include "rollup.c" /* sic */
+
+typedef struct {
+  char plugin_instance[DATA_MAX_NAME_LEN];
+  cdtime_t time;
+  cdtime_t interval;
+  gauge_t value;
+} dispatched_t;
+
+static dispatched_t dispatched[16];
+static size_t dispatched_num;
+
+/* mock functions */
+int plugin_dispatch_values_rollup_test(value_list_t const *vl) {
+  if (dispatched_num >= STATIC_ARRAY_SIZE(dispatched))
+    return ENOMEM;
+
+  dispatched_t *d = dispatched + dispatched_num;
+  sstrncpy(d->plugin_instance, vl->plugin_instance,
+           sizeof(d->plugin_instance));
+  d->time = vl->time;
+  d->interval = vl->interval;
+  d->value = vl->values[0].gauge;
+  dispatched_num++;
+  return 0;
+}
+
+/* All test values are gauges, so the rates are the values themselves. */
+int uc_get_rate_dispatched_rollup_test(value_list_t const *vl,
+                                       gauge_t *ret_values,
+                                       size_t values_num) {
+  if (vl->values_len != values_num)
+    return EINVAL;
+
+  for (size_t i = 0; i < values_num; i++)
+    ret_values[i] = vl->values[i].gauge;
+  return 0;
+}
+/* end mock functions */
+
+static data_source_t test_ds_source[] = {
+    {"value", DS_TYPE_GAUGE, NAN, NAN},
+};
+static data_set_t test_ds = {"gauge", 1, test_ds_source};
+
+static int test_write(time_t t, gauge_t v) {
+  value_list_t vl = {
+      .values = &(value_t){.gauge = v},
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T(t),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "gauge",
+  };
+
+  /* The time of the last update is used to expire series. */
+  cdtime_mock = vl.time;
+  return ru_write(&test_ds, &vl, /* user_data = */ NULL);
+}
+
+static dispatched_t const *find_dispatched(char const *plugin_instance) {
+  for (size_t i = 0; i < dispatched_num; i++)
+    if (strcmp(plugin_instance, dispatched[i].plugin_instance) == 0)
+      return dispatched + i;
+  return NULL;
+}
+
+static oconfig_value_t number(double n) {
+  return (oconfig_value_t){.value.number = n, .type = OCONFIG_TYPE_NUMBER};
+}
+
+static oconfig_value_t string(char *s) {
+  return (oconfig_value_t){.value.string = s, .type = OCONFIG_TYPE_STRING};
+}
+
+static oconfig_value_t boolean(bool b) {
+  return (oconfig_value_t){.value.boolean = b, .type = OCONFIG_TYPE_BOOLEAN};
+}
+
+DEF_TEST(config) {
+  oconfig_value_t type = string("gauge");
+  oconfig_value_t calc = boolean(true);
+  oconfig_value_t resolutions[] = {number(60), number(10)};
+  oconfig_value_t duplicate = number(60);
+
+  oconfig_item_t children[] = {
+      {.key = "Type", .values = &type, .values_num = 1},
+      {.key = "CalculateAverage", .values = &calc, .values_num = 1},
+      {.key = "Resolution", .values = resolutions, .values_num = 2},
+      {.key = "Resolution", .values = &duplicate, .values_num = 1},
+  };
+  oconfig_item_t ci = {.key = "Rollup", .children = children};
+
+  CHECK_ZERO(ru_config(&(oconfig_item_t){.key = "Plugin"}));
+
+  /* The same resolution given twice, in the same or in different options. */
+  children[2].values = (oconfig_value_t[]){number(10), number(10)};
+  ci.children_num = 3;
+  EXPECT_EQ_INT(-1, ru_config_rollup(&ci));
+
+  children[2].values = resolutions;
+  ci.children_num = 4;
+  EXPECT_EQ_INT(-1, ru_config_rollup(&ci));
+  OK(rollup_list_head == NULL);
+
+  /* The resolutions are sorted. */
+  ci.children_num = 3;
+  CHECK_ZERO(ru_config_rollup(&ci));
+  OK(rollup_list_head != NULL);
+  EXPECT_EQ_UINT64(2, rollup_list_head->resolution_num);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(10), rollup_list_head->resolution[0]);
+  EXPECT_EQ_STR("10s", rollup_list_head->resolution_name[0]);
+  EXPECT_EQ_STR("1m", rollup_list_head->resolution_name[1]);
+
+  CHECK_ZERO(ru_shutdown());
+  return 0;
+}
+
+DEF_TEST(write_and_flush) {
+  oconfig_value_t type = string("gauge");
+  oconfig_value_t calc = boolean(true);
+  oconfig_value_t resolutions[] = {number(10), number(60)};
+
+  oconfig_item_t children[] = {
+      {.key = "Type", .values = &type, .values_num = 1},
+      {.key = "CalculateAverage", .values = &calc, .values_num = 1},
+      {.key = "CalculateMaximum", .values = &calc, .values_num = 1},
+      {.key = "Resolution", .values = resolutions, .values_num = 2},
+  };
+  oconfig_item_t rollup_ci = {
+      .key = "Rollup",
+      .children = children,
+      .children_num = STATIC_ARRAY_SIZE(children),
+  };
+
+  CHECK_ZERO(ru_config(&(oconfig_item_t){
+      .key = "Plugin", .children = &rollup_ci, .children_num = 1}));
+  rollup_t *ru = rollup_list_head;
+  OK(ru != NULL);
+
+  dispatched_num = 0;
+  CHECK_ZERO(test_write(100, 1.0));
+  CHECK_ZERO(test_write(105, 3.0));
+  EXPECT_EQ_UINT64(0, dispatched_num);
+
+  /* The first value of the next window completes the 10s window. */
+  CHECK_ZERO(test_write(110, 5.0));
+  EXPECT_EQ_UINT64(2, dispatched_num);
+  dispatched_t const *d = find_dispatched("average-10s");
+  OK(d != NULL);
+  EXPECT_EQ_DOUBLE(2.0, d->value);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(110), d->time);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(10), d->interval);
+  d = find_dispatched("max-10s");
+  OK(d != NULL);
+  EXPECT_EQ_DOUBLE(3.0, d->value);
+
+  /* Values created by the rollup plugin are not rolled up again. */
+  value_list_t vl = {
+      .values = &(value_t){.gauge = 42.0},
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T(111),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "gauge",
+      .meta = meta_data_create(),
+  };
+  meta_data_add_boolean(vl.meta, "rollup:created", true);
+  CHECK_ZERO(ru_write(&test_ds, &vl, /* user_data = */ NULL));
+  meta_data_destroy(vl.meta);
+
+  /* Windows are only flushed once they can't receive values in time. */
+  dispatched_num = 0;
+  ru_flush(ru, TIME_T_TO_CDTIME_T(125));
+  EXPECT_EQ_UINT64(0, dispatched_num);
+
+  ru_flush(ru, TIME_T_TO_CDTIME_T(130));
+  EXPECT_EQ_UINT64(4, dispatched_num);
+  d = find_dispatched("average-10s");
+  OK(d != NULL);
+  EXPECT_EQ_DOUBLE(5.0, d->value);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(120), d->time);
+  d = find_dispatched("average-1m");
+  OK(d != NULL);
+  EXPECT_EQ_DOUBLE(3.0, d->value);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(120), d->time);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(60), d->interval);
+  d = find_dispatched("max-1m");
+  OK(d != NULL);
+  EXPECT_EQ_DOUBLE(5.0, d->value);
+
+  /* Emitted windows are not emitted again. */
+  dispatched_num = 0;
+  ru_flush(ru, TIME_T_TO_CDTIME_T(200));
+  EXPECT_EQ_UINT64(0, dispatched_num);
+
+  /* Series are removed after two of the largest windows without updates. */
+  EXPECT_EQ_INT(1, c_avl_size(ru->series));
+  ru_flush(ru, TIME_T_TO_CDTIME_T(110 + 121));
+  EXPECT_EQ_INT(0, c_avl_size(ru->series));
+
+  CHECK_ZERO(ru_shutdown());
+  return 0;
+}
+
+DEF_TEST(late_values) {
+  oconfig_value_t type = string("gauge");
+  oconfig_value_t calc = boolean(true);
+  oconfig_value_t resolution = number(10);
+
+  oconfig_item_t children[] = {
+      {.key = "Type", .values = &type, .values_num = 1},
+      {.key = "CalculateAverage", .values = &calc, .values_num = 1},
+      {.key = "Resolution", .values = &resolution, .values_num = 1},
+  };
+  oconfig_item_t rollup_ci = {
+      .key = "Rollup",
+      .children = children,
+      .children_num = STATIC_ARRAY_SIZE(children),
+  };
+
+  CHECK_ZERO(ru_config(&(oconfig_item_t){
+      .key = "Plugin", .children = &rollup_ci, .children_num = 1}));
+  rollup_t *ru = rollup_list_head;
+  OK(ru != NULL);
+
+  dispatched_num = 0;
+  CHECK_ZERO(test_write(100, 1.0));
+  ru_flush(ru, TIME_T_TO_CDTIME_T(120));
+  EXPECT_EQ_UINT64(1, dispatched_num);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(110), dispatched[0].time);
+
+  /* A late value doesn't re-open the window emitted by the flush. */
+  dispatched_num = 0;
+  CHECK_ZERO(test_write(105, 7.0));
+  CHECK_ZERO(test_write(115, 3.0));
+  CHECK_ZERO(test_write(125, 5.0));
+  EXPECT_EQ_UINT64(1, dispatched_num);
+  EXPECT_EQ_DOUBLE(3.0, dispatched[0].value);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(120), dispatched[0].time);
+
+  /* Neither does a value which is late for the current window. */
+  CHECK_ZERO(test_write(112, 7.0));
+  ru_flush(ru, TIME_T_TO_CDTIME_T(140));
+  EXPECT_EQ_UINT64(2, dispatched_num);
+  EXPECT_EQ_DOUBLE(5.0, dispatched[1].value);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(130), dispatched[1].time);
+
+  CHECK_ZERO(ru_shutdown());
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(config);
+  RUN_TEST(write_and_flush);
+  RUN_TEST(late_values);
+
+  END_TEST;
+}
@@ -24,11 +24,15 @@
  *   Florian octo Forster <octo at collectd.org>
  */
 
+/* _GNU_SOURCE is needed in Linux to use recvmmsg */
+#define _GNU_SOURCE
+
 #include "collectd.h"
 
 #include "plugin.h"
 #include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/hll/hll.h"
 #include "utils/latency/latency.h"
 
 #include <netdb.h>
@@ -48,6 +52,27 @@
 #define STATSD_DEFAULT_SERVICE "8125"
 #endif
 
+/* Large enough for any UDP datagram. */
+#ifndef STATSD_DEFAULT_PACKET_SIZE
+#define STATSD_DEFAULT_PACKET_SIZE 65536
+#endif
+
+/* Number of datagrams received with a single recvmmsg(2) call. */
+#ifndef STATSD_RECV_BATCH
+#define STATSD_RECV_BATCH 16
+#endif
+
+/* Maximum number of recvmmsg(2) calls per socket and poll(2) wakeup. */
+#ifndef STATSD_RECV_ROUNDS
+#define STATSD_RECV_ROUNDS 8
+#endif
+
+/* Metrics are spread over this many trees, each with its own lock, so that
+ * receive threads rarely contend. */
+#ifndef STATSD_SHARDS
+#define STATSD_SHARDS 16
+#endif
+
 enum metric_type_e { STATSD_COUNTER, STATSD_TIMER, STATSD_GAUGE, STATSD_SET };
 typedef enum metric_type_e metric_type_t;
 
@@ -57,25 +82,59 @@ struct statsd_metric_s {
   derive_t counter;
   latency_counter_t *latency;
   c_avl_tree_t *set;
+  hll_t *hll;
   unsigned long updates_num;
 };
 typedef struct statsd_metric_s statsd_metric_t;
 
-static c_avl_tree_t *metrics_tree;
+struct statsd_shard_s {
+  c_avl_tree_t *tree;
+  pthread_mutex_t lock;
+};
+typedef struct statsd_shard_s statsd_shard_t;
+
+/* Per-thread receive buffers. */
+struct statsd_receiver_s {
+  char *buffer;
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[STATSD_RECV_BATCH];
+  struct iovec iovs[STATSD_RECV_BATCH];
+#endif
+};
+typedef struct statsd_receiver_s statsd_receiver_t;
+
+static statsd_shard_t metrics_shards[STATSD_SHARDS];
+static bool metrics_initialized;
+/* Protects metrics_initialized and the network threads. */
 static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static pthread_t network_thread;
-static bool network_thread_running;
+static pthread_t *network_threads;
+static size_t network_threads_num;
 static bool network_thread_shutdown;
 
 static char *conf_node;
 static char *conf_service;
+static int conf_receive_threads = 1;
+static size_t conf_packet_size = STATSD_DEFAULT_PACKET_SIZE;
 
 static bool conf_delete_counters;
 static bool conf_delete_timers;
 static bool conf_delete_gauges;
 static bool conf_delete_sets;
 
+/* Zero means sets are counted exactly. */
+static int conf_set_precision;
+
+/* Sets with a precision other than "conf_set_precision". */
+struct statsd_set_precision_s {
+  char *name;
+  int precision;
+};
+typedef struct statsd_set_precision_s statsd_set_precision_t;
+
+static statsd_set_precision_t *conf_set_precisions;
+static size_t conf_set_precisions_num;
+
 static double *conf_timer_percentile;
 static size_t conf_timer_percentile_num;
 
@@ -86,12 +145,28 @@ static bool conf_timer_upper;
 static bool conf_timer_sum;
 static bool conf_timer_count;
 
-/* Must hold metrics_lock when calling this function. */
-static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
-                                                    metric_type_t type) {
+static statsd_shard_t *statsd_shard_get(char const *key) /* {{{ */
+{
+  /* FNV-1a */
+  uint32_t hash = 2166136261U;
+  for (char const *ptr = key; *ptr != 0; ptr++) {
+    hash ^= (uint32_t)(unsigned char)*ptr;
+    hash *= 16777619U;
+  }
+
+  return metrics_shards + (hash % STATSD_SHARDS);
+} /* }}} statsd_shard_t *statsd_shard_get */
+
+/* statsd_metric_lookup looks up the metric, creating it if necessary, and
+ * returns it with its shard locked. The caller must unlock "ret_shard->lock"
+ * when done with the metric. */
+static statsd_metric_t *statsd_metric_lookup(char const *name, /* {{{ */
+                                             metric_type_t type,
+                                             statsd_shard_t **ret_shard) {
   char key[DATA_MAX_NAME_LEN + 2];
   char *key_copy;
   statsd_metric_t *metric;
+  statsd_shard_t *shard;
   int status;
 
   switch (type) {
@@ -114,18 +189,25 @@ static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
   key[1] = ':';
   sstrncpy(&key[2], name, sizeof(key) - 2);
 
-  status = c_avl_get(metrics_tree, key, (void *)&metric);
-  if (status == 0)
+  shard = statsd_shard_get(key);
+  pthread_mutex_lock(&shard->lock);
+
+  status = c_avl_get(shard->tree, key, (void *)&metric);
+  if (status == 0) {
+    *ret_shard = shard;
     return metric;
+  }
 
   key_copy = strdup(key);
   if (key_copy == NULL) {
+    pthread_mutex_unlock(&shard->lock);
     ERROR("statsd plugin: strdup failed.");
     return NULL;
   }
 
   metric = calloc(1, sizeof(*metric));
   if (metric == NULL) {
+    pthread_mutex_unlock(&shard->lock);
     ERROR("statsd plugin: calloc failed.");
     sfree(key_copy);
     return NULL;
@@ -135,33 +217,32 @@ static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
   metric->latency = NULL;
   metric->set = NULL;
 
-  status = c_avl_insert(metrics_tree, key_copy, metric);
+  status = c_avl_insert(shard->tree, key_copy, metric);
   if (status != 0) {
+    pthread_mutex_unlock(&shard->lock);
     ERROR("statsd plugin: c_avl_insert failed.");
     sfree(key_copy);
     sfree(metric);
     return NULL;
   }
 
+  *ret_shard = shard;
   return metric;
-} /* }}} statsd_metric_lookup_unsafe */
+} /* }}} statsd_metric_lookup */
 
 static int statsd_metric_set(char const *name, double value, /* {{{ */
                              metric_type_t type) {
   statsd_metric_t *metric;
+  statsd_shard_t *shard;
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, type);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  metric = statsd_metric_lookup(name, type, &shard);
+  if (metric == NULL)
     return -1;
-  }
 
   metric->value = value;
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return 0;
 } /* }}} int statsd_metric_set */
@@ -169,19 +250,16 @@ static int statsd_metric_set(char const *name, double value, /* {{{ */
 static int statsd_metric_add(char const *name, double delta, /* {{{ */
                              metric_type_t type) {
   statsd_metric_t *metric;
+  statsd_shard_t *shard;
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, type);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  metric = statsd_metric_lookup(name, type, &shard);
+  if (metric == NULL)
     return -1;
-  }
 
   metric->value += delta;
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return 0;
 } /* }}} int statsd_metric_add */
@@ -209,6 +287,9 @@ static void statsd_metric_free(statsd_metric_t *metric) /* {{{ */
     metric->set = NULL;
   }
 
+  hll_destroy(metric->hll);
+  metric->hll = NULL;
+
   sfree(metric);
 } /* }}} void statsd_metric_free */
 
@@ -272,6 +353,7 @@ static int statsd_handle_gauge(char const *name, /* {{{ */
 static int statsd_handle_timer(char const *name, /* {{{ */
                                char const *value_str, char const *extra) {
   statsd_metric_t *metric;
+  statsd_shard_t *shard;
   value_t value_ms;
   value_t scale;
   cdtime_t value;
@@ -297,40 +379,72 @@ static int statsd_handle_timer(char const *name, /* {{{ */
 
   value = MS_TO_CDTIME_T(value_ms.gauge / scale.gauge);
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, STATSD_TIMER);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  metric = statsd_metric_lookup(name, STATSD_TIMER, &shard);
+  if (metric == NULL)
     return -1;
-  }
 
   if (metric->latency == NULL)
     metric->latency = latency_counter_create();
   if (metric->latency == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+    pthread_mutex_unlock(&shard->lock);
     return -1;
   }
 
   latency_counter_add(metric->latency, value);
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
+  pthread_mutex_unlock(&shard->lock);
   return 0;
 } /* }}} int statsd_handle_timer */
 
+/* Returns the HyperLogLog precision of the set "name", or zero if the set is
+ * counted exactly. */
+static int statsd_set_precision(char const *name) /* {{{ */
+{
+  for (size_t i = 0; i < conf_set_precisions_num; i++)
+    if (strcmp(name, conf_set_precisions[i].name) == 0)
+      return conf_set_precisions[i].precision;
+
+  return conf_set_precision;
+} /* }}} int statsd_set_precision */
+
 static int statsd_handle_set(char const *name, /* {{{ */
                              char const *set_key_orig) {
   statsd_metric_t *metric = NULL;
+  statsd_shard_t *shard;
   char *set_key;
   int status;
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, STATSD_SET);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  metric = statsd_metric_lookup(name, STATSD_SET, &shard);
+  if (metric == NULL)
     return -1;
+
+  /* The counting method is chosen when the set is created. */
+  if ((metric->hll == NULL) && (metric->set == NULL)) {
+    int precision = statsd_set_precision(name);
+    if (precision > 0) {
+      metric->hll = hll_create(precision);
+      if (metric->hll == NULL) {
+        pthread_mutex_unlock(&shard->lock);
+        ERROR("statsd plugin: hll_create failed.");
+        return -1;
+      }
+    }
+  }
+
+  if (metric->hll != NULL) {
+    status = hll_add(metric->hll, set_key_orig, strlen(set_key_orig));
+    if (status != 0) {
+      pthread_mutex_unlock(&shard->lock);
+      ERROR("statsd plugin: hll_add (\"%s\") failed with status %i.",
+            set_key_orig, status);
+      return -1;
+    }
+
+    metric->updates_num++;
+
+    pthread_mutex_unlock(&shard->lock);
+    return 0;
   }
 
   /* Make sure metric->set exists. */
@@ -338,21 +452,21 @@ static int statsd_handle_set(char const *name, /* {{{ */
     metric->set = c_avl_create((int (*)(const void *, const void *))strcmp);
 
   if (metric->set == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+    pthread_mutex_unlock(&shard->lock);
     ERROR("statsd plugin: c_avl_create failed.");
     return -1;
   }
 
   set_key = strdup(set_key_orig);
   if (set_key == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+    pthread_mutex_unlock(&shard->lock);
     ERROR("statsd plugin: strdup failed.");
     return -1;
   }
 
   status = c_avl_insert(metric->set, set_key, /* value = */ NULL);
   if (status < 0) {
-    pthread_mutex_unlock(&metrics_lock);
+    pthread_mutex_unlock(&shard->lock);
     ERROR("statsd plugin: c_avl_insert (\"%s\") failed with status %i.",
           set_key, status);
     sfree(set_key);
@@ -364,7 +478,7 @@ static int statsd_handle_set(char const *name, /* {{{ */
 
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
+  pthread_mutex_unlock(&shard->lock);
   return 0;
 } /* }}} int statsd_handle_set */
 
@@ -438,13 +552,43 @@ static void statsd_parse_buffer(char *buffer) /* {{{ */
   }
 } /* }}} void statsd_parse_buffer */
 
-static void statsd_network_read(int fd) /* {{{ */
+static void statsd_network_read(statsd_receiver_t *r, int fd) /* {{{ */
 {
-  char buffer[4096];
+#if HAVE_RECVMMSG
+  int status;
+  int rounds = 0;
+
+  /* Keep reading while full batches are returned, but go back to poll(2)
+   * eventually, so that a busy socket doesn't starve the other sockets of
+   * this thread and the shutdown flag is checked. */
+  do {
+    status = recvmmsg(fd, r->msgs, STATSD_RECV_BATCH,
+                      /* flags = */ MSG_DONTWAIT, /* timeout = */ NULL);
+    if (status < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        return;
+
+      ERROR("statsd plugin: recvmmsg(2) failed: %s", STRERRNO);
+      return;
+    }
+
+    for (int i = 0; i < status; i++) {
+      char *buffer = r->iovs[i].iov_base;
+      size_t buffer_size = (size_t)r->msgs[i].msg_len;
+
+      if (buffer_size > conf_packet_size)
+        buffer_size = conf_packet_size;
+      buffer[buffer_size] = 0;
+
+      statsd_parse_buffer(buffer);
+    }
+    rounds++;
+  } while ((status == STATSD_RECV_BATCH) && (rounds < STATSD_RECV_ROUNDS));
+#else
   size_t buffer_size;
   ssize_t status;
 
-  status = recv(fd, buffer, sizeof(buffer), /* flags = */ MSG_DONTWAIT);
+  status = recv(fd, r->buffer, conf_packet_size, /* flags = */ MSG_DONTWAIT);
   if (status < 0) {
 
     if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
@@ -455,13 +599,46 @@ static void statsd_network_read(int fd) /* {{{ */
   }
 
   buffer_size = (size_t)status;
-  if (buffer_size >= sizeof(buffer))
-    buffer_size = sizeof(buffer) - 1;
-  buffer[buffer_size] = 0;
+  r->buffer[buffer_size] = 0;
 
-  statsd_parse_buffer(buffer);
+  statsd_parse_buffer(r->buffer);
+#endif
 } /* }}} void statsd_network_read */
 
+static int statsd_receiver_init(statsd_receiver_t *r) /* {{{ */
+{
+#if HAVE_RECVMMSG
+  size_t buffers_num = STATSD_RECV_BATCH;
+#else
+  size_t buffers_num = 1;
+#endif
+
+  /* One extra byte per buffer for the terminating null byte. */
+  r->buffer = malloc(buffers_num * (conf_packet_size + 1));
+  if (r->buffer == NULL) {
+    ERROR("statsd plugin: malloc failed.");
+    return ENOMEM;
+  }
+
+#if HAVE_RECVMMSG
+  for (size_t i = 0; i < STATSD_RECV_BATCH; i++) {
+    r->iovs[i] = (struct iovec){
+        .iov_base = r->buffer + i * (conf_packet_size + 1),
+        .iov_len = conf_packet_size,
+    };
+    r->msgs[i] = (struct mmsghdr){
+        .msg_hdr =
+            {
+                .msg_iov = r->iovs + i,
+                .msg_iovlen = 1,
+            },
+    };
+  }
+#endif
+
+  return 0;
+} /* }}} int statsd_receiver_init */
+
 static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
                                size_t *ret_fds_num) {
   struct pollfd *fds = NULL;
@@ -507,6 +684,17 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
       continue;
     }
 
+#ifdef SO_REUSEPORT
+    /* Each receive thread binds its own socket; the kernel distributes the
+     * datagrams between them. */
+    if ((conf_receive_threads > 1) &&
+        (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == -1)) {
+      ERROR("statsd plugin: setsockopt (reuseport): %s", STRERRNO);
+      close(fd);
+      continue;
+    }
+#endif
+
     getnameinfo(ai_ptr->ai_addr, ai_ptr->ai_addrlen, str_node, sizeof(str_node),
                 str_service, sizeof(str_service),
                 NI_DGRAM | NI_NUMERICHOST | NI_NUMERICSERV);
@@ -554,11 +742,17 @@ static void *statsd_network_thread(__attribute__((unused)) void *args) /* {{{ */
 {
   struct pollfd *fds = NULL;
   size_t fds_num = 0;
+  statsd_receiver_t receiver = {0};
   int status;
 
+  status = statsd_receiver_init(&receiver);
+  if (status != 0)
+    pthread_exit((void *)0);
+
   status = statsd_network_init(&fds, &fds_num);
   if (status != 0) {
     ERROR("statsd plugin: Unable to open listening sockets.");
+    sfree(receiver.buffer);
     pthread_exit((void *)0);
   }
 
@@ -577,7 +771,7 @@ static void *statsd_network_thread(__attribute__((unused)) void *args) /* {{{ */
       if ((fds[i].revents & (POLLIN | POLLPRI)) == 0)
         continue;
 
-      statsd_network_read(fds[i].fd);
+      statsd_network_read(&receiver, fds[i].fd);
       fds[i].revents = 0;
     }
   } /* while (!network_thread_shutdown) */
@@ -586,6 +780,7 @@ static void *statsd_network_thread(__attribute__((unused)) void *args) /* {{{ */
   for (size_t i = 0; i < fds_num; i++)
     close(fds[i].fd);
   sfree(fds);
+  sfree(receiver.buffer);
 
   return (void *)0;
 } /* }}} void *statsd_network_thread */
@@ -620,6 +815,111 @@ static int statsd_config_timer_percentile(oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} int statsd_config_timer_percentile */
 
+static int statsd_config_receive_threads(oconfig_item_t *ci) /* {{{ */
+{
+  int threads = 0;
+  int status;
+
+  status = cf_util_get_int(ci, &threads);
+  if (status != 0)
+    return status;
+
+  if (threads < 1) {
+    ERROR("statsd plugin: \"%s\" must be at least 1.", ci->key);
+    return ERANGE;
+  }
+
+#ifndef SO_REUSEPORT
+  if (threads > 1) {
+    WARNING("statsd plugin: \"%s\" requires SO_REUSEPORT, which is not "
+            "available on this system. Using a single thread.",
+            ci->key);
+    threads = 1;
+  }
+#endif
+
+  conf_receive_threads = threads;
+  return 0;
+} /* }}} int statsd_config_receive_threads */
+
+static int statsd_config_packet_size(oconfig_item_t *ci) /* {{{ */
+{
+  int size = 0;
+  int status;
+
+  status = cf_util_get_int(ci, &size);
+  if (status != 0)
+    return status;
+
+  if ((size < 1024) || (size > STATSD_DEFAULT_PACKET_SIZE)) {
+    ERROR("statsd plugin: \"%s\" must be between 1024 and %d.", ci->key,
+          STATSD_DEFAULT_PACKET_SIZE);
+    return ERANGE;
+  }
+
+  conf_packet_size = (size_t)size;
+  return 0;
+} /* }}} int statsd_config_packet_size */
+
+/* SetPrecision <precision> [<set> ...]
+ * Without set names, sets the default precision of all sets. */
+static int statsd_config_set_precision(oconfig_item_t *ci) /* {{{ */
+{
+  if ((ci->values_num < 1) || (ci->values[0].type != OCONFIG_TYPE_NUMBER)) {
+    ERROR("statsd plugin: \"%s\" requires a precision, optionally followed "
+          "by set names.",
+          ci->key);
+    return EINVAL;
+  }
+
+  for (int i = 1; i < ci->values_num; i++) {
+    if (ci->values[i].type != OCONFIG_TYPE_STRING) {
+      ERROR("statsd plugin: The set names of \"%s\" must be strings.",
+            ci->key);
+      return EINVAL;
+    }
+  }
+
+  int precision = (int)ci->values[0].value.number;
+  if ((precision != 0) &&
+      ((precision < HLL_PRECISION_MIN) || (precision > HLL_PRECISION_MAX))) {
+    ERROR("statsd plugin: \"%s\" must be zero or between %d and %d.",
+          ci->key, HLL_PRECISION_MIN, HLL_PRECISION_MAX);
+    return ERANGE;
+  }
+
+  if (ci->values_num == 1) {
+    conf_set_precision = precision;
+    return 0;
+  }
+
+  statsd_set_precision_t *tmp =
+      realloc(conf_set_precisions,
+              sizeof(*conf_set_precisions) *
+                  (conf_set_precisions_num + (size_t)ci->values_num - 1));
+  if (tmp == NULL) {
+    ERROR("statsd plugin: realloc failed.");
+    return ENOMEM;
+  }
+  conf_set_precisions = tmp;
+
+  for (int i = 1; i < ci->values_num; i++) {
+    char *name = strdup(ci->values[i].value.string);
+    if (name == NULL) {
+      ERROR("statsd plugin: strdup failed.");
+      return ENOMEM;
+    }
+
+    conf_set_precisions[conf_set_precisions_num] = (statsd_set_precision_t){
+        .name = name,
+        .precision = precision,
+    };
+    conf_set_precisions_num++;
+  }
+
+  return 0;
+} /* }}} int statsd_config_set_precision */
+
 static int statsd_config(oconfig_item_t *ci) /* {{{ */
 {
   for (int i = 0; i < ci->children_num; i++) {
@@ -629,6 +929,10 @@ static int statsd_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_string(child, &conf_node);
     else if (strcasecmp("Port", child->key) == 0)
       cf_util_get_service(child, &conf_service);
+    else if (strcasecmp("ReceiveThreads", child->key) == 0)
+      statsd_config_receive_threads(child);
+    else if (strcasecmp("MaxPacketSize", child->key) == 0)
+      statsd_config_packet_size(child);
     else if (strcasecmp("DeleteCounters", child->key) == 0)
       cf_util_get_boolean(child, &conf_delete_counters);
     else if (strcasecmp("DeleteTimers", child->key) == 0)
@@ -637,6 +941,8 @@ static int statsd_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_boolean(child, &conf_delete_gauges);
     else if (strcasecmp("DeleteSets", child->key) == 0)
       cf_util_get_boolean(child, &conf_delete_sets);
+    else if (strcasecmp("SetPrecision", child->key) == 0)
+      statsd_config_set_precision(child);
     else if (strcasecmp("CounterGauge", child->key) == 0)
       cf_util_get_boolean(child, &conf_counter_gauge);
     else if (strcasecmp("CounterSum", child->key) == 0)
@@ -662,29 +968,51 @@ static int statsd_config(oconfig_item_t *ci) /* {{{ */
 static int statsd_init(void) /* {{{ */
 {
   pthread_mutex_lock(&metrics_lock);
-  if (metrics_tree == NULL)
-    metrics_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (!metrics_initialized) {
+    for (size_t i = 0; i < STATSD_SHARDS; i++) {
+      metrics_shards[i].tree =
+          c_avl_create((int (*)(const void *, const void *))strcmp);
+      pthread_mutex_init(&metrics_shards[i].lock, /* attr = */ NULL);
+    }
+    metrics_initialized = true;
+  }
 
-  if (!network_thread_running) {
-    int status;
+  if (network_threads == NULL) {
+    network_thread_shutdown = false;
+    network_threads = calloc((size_t)conf_receive_threads,
+                             sizeof(*network_threads));
+    if (network_threads == NULL) {
+      pthread_mutex_unlock(&metrics_lock);
+      ERROR("statsd plugin: calloc failed.");
+      return ENOMEM;
+    }
 
-    status = pthread_create(&network_thread,
-                            /* attr = */ NULL, statsd_network_thread,
-                            /* args = */ NULL);
-    if (status != 0) {
+    for (int i = 0; i < conf_receive_threads; i++) {
+      int status;
+
+      status = pthread_create(&network_threads[network_threads_num],
+                              /* attr = */ NULL, statsd_network_thread,
+                              /* args = */ NULL);
+      if (status != 0) {
+        ERROR("statsd plugin: pthread_create failed: %s", STRERROR(status));
+        break;
+      }
+      network_threads_num++;
+    }
+
+    if (network_threads_num == 0) {
+      sfree(network_threads);
       pthread_mutex_unlock(&metrics_lock);
-      ERROR("statsd plugin: pthread_create failed: %s", STRERRNO);
-      return status;
+      return -1;
     }
   }
-  network_thread_running = true;
 
   pthread_mutex_unlock(&metrics_lock);
 
   return 0;
 } /* }}} int statsd_init */
 
-/* Must hold metrics_lock when calling this function. */
+/* Must hold the shard's lock when calling this function. */
 static int statsd_metric_clear_set_unsafe(statsd_metric_t *metric) /* {{{ */
 {
   void *key;
@@ -693,6 +1021,8 @@ static int statsd_metric_clear_set_unsafe(statsd_metric_t *metric) /* {{{ */
   if ((metric == NULL) || (metric->type != STATSD_SET))
     return EINVAL;
 
+  hll_reset(metric->hll);
+
   if (metric->set == NULL)
     return 0;
 
@@ -704,7 +1034,7 @@ static int statsd_metric_clear_set_unsafe(statsd_metric_t *metric) /* {{{ */
   return 0;
 } /* }}} int statsd_metric_clear_set_unsafe */
 
-/* Must hold metrics_lock when calling this function. */
+/* Must hold the shard's lock when calling this function. */
 static int statsd_metric_submit_unsafe(char const *name,
                                        statsd_metric_t *metric) /* {{{ */
 {
@@ -768,8 +1098,8 @@ static int statsd_metric_submit_unsafe(char const *name,
     }
 
     for (size_t i = 0; i < conf_timer_percentile_num; i++) {
-      snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-percentile-%.0f",
-               name, conf_timer_percentile[i]);
+      snprintf(vl.type_instance, sizeof(vl.type_instance),
+               "%s-percentile-%.5g", name, conf_timer_percentile[i]);
       vl.values[0].gauge =
           have_events ? CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(
                             metric->latency, conf_timer_percentile[i]))
@@ -789,7 +1119,9 @@ static int statsd_metric_submit_unsafe(char const *name,
     latency_counter_reset(metric->latency);
     return 0;
   } else if (metric->type == STATSD_SET) {
-    if (metric->set == NULL)
+    if (metric->hll != NULL)
+      vl.values[0].gauge = (gauge_t)hll_count(metric->hll);
+    else if (metric->set == NULL)
       vl.values[0].gauge = 0.0;
     else
       vl.values[0].gauge = (gauge_t)c_avl_size(metric->set);
@@ -857,7 +1189,7 @@ static int statsd_metric_submit_unsafe(char const *name,
   return plugin_dispatch_values(&vl);
 } /* }}} int statsd_metric_submit_unsafe */
 
-static int statsd_read(void) /* {{{ */
+static void statsd_read_shard(statsd_shard_t *shard) /* {{{ */
 {
   c_avl_iterator_t *iter;
   char *name;
@@ -866,14 +1198,9 @@ static int statsd_read(void) /* {{{ */
   char **to_be_deleted = NULL;
   size_t to_be_deleted_num = 0;
 
-  pthread_mutex_lock(&metrics_lock);
-
-  if (metrics_tree == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
-    return 0;
-  }
+  pthread_mutex_lock(&shard->lock);
 
-  iter = c_avl_get_iterator(metrics_tree);
+  iter = c_avl_get_iterator(shard->tree);
   while (c_avl_iterator_next(iter, (void *)&name, (void *)&metric) == 0) {
     if ((metric->updates_num == 0) &&
         ((conf_delete_counters && (metric->type == STATSD_COUNTER)) ||
@@ -899,7 +1226,7 @@ static int statsd_read(void) /* {{{ */
   for (size_t i = 0; i < to_be_deleted_num; i++) {
     int status;
 
-    status = c_avl_remove(metrics_tree, to_be_deleted[i], (void *)&name,
+    status = c_avl_remove(shard->tree, to_be_deleted[i], (void *)&name,
                           (void *)&metric);
     if (status != 0) {
       ERROR("stats plugin: c_avl_remove (\"%s\") failed with status %i.",
@@ -911,9 +1238,24 @@ static int statsd_read(void) /* {{{ */
     statsd_metric_free(metric);
   }
 
-  pthread_mutex_unlock(&metrics_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   strarray_free(to_be_deleted, to_be_deleted_num);
+} /* }}} void statsd_read_shard */
+
+static int statsd_read(void) /* {{{ */
+{
+  pthread_mutex_lock(&metrics_lock);
+  bool initialized = metrics_initialized;
+  pthread_mutex_unlock(&metrics_lock);
+
+  if (!initialized)
+    return 0;
+
+  /* Only one shard is locked at a time, so receive threads are blocked for
+   * a fraction of the interval only. */
+  for (size_t i = 0; i < STATSD_SHARDS; i++)
+    statsd_read_shard(metrics_shards + i);
 
   return 0;
 } /* }}} int statsd_read */
@@ -923,25 +1265,41 @@ static int statsd_shutdown(void) /* {{{ */
   void *key;
   void *value;
 
-  if (network_thread_running) {
-    network_thread_shutdown = true;
-    pthread_kill(network_thread, SIGTERM);
-    pthread_join(network_thread, /* retval = */ NULL);
-  }
-  network_thread_running = false;
-
   pthread_mutex_lock(&metrics_lock);
 
-  while (c_avl_pick(metrics_tree, &key, &value) == 0) {
-    sfree(key);
-    statsd_metric_free(value);
+  if (network_threads_num > 0) {
+    network_thread_shutdown = true;
+    for (size_t i = 0; i < network_threads_num; i++)
+      pthread_kill(network_threads[i], SIGTERM);
+    for (size_t i = 0; i < network_threads_num; i++)
+      pthread_join(network_threads[i], /* retval = */ NULL);
+  }
+  sfree(network_threads);
+  network_threads_num = 0;
+
+  if (metrics_initialized) {
+    for (size_t i = 0; i < STATSD_SHARDS; i++) {
+      statsd_shard_t *shard = metrics_shards + i;
+
+      while (c_avl_pick(shard->tree, &key, &value) == 0) {
+        sfree(key);
+        statsd_metric_free(value);
+      }
+      c_avl_destroy(shard->tree);
+      shard->tree = NULL;
+      pthread_mutex_destroy(&shard->lock);
+    }
+    metrics_initialized = false;
   }
-  c_avl_destroy(metrics_tree);
-  metrics_tree = NULL;
 
   sfree(conf_node);
   sfree(conf_service);
 
+  for (size_t i = 0; i < conf_set_precisions_num; i++)
+    sfree(conf_set_precisions[i].name);
+  sfree(conf_set_precisions);
+  conf_set_precisions_num = 0;
+
   pthread_mutex_unlock(&metrics_lock);
 
   return 0;
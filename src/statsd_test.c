@@ -0,0 +1,249 @@
+/**
+ * collectd - src/statsd_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#define plugin_dispatch_values plugin_dispatch_values_statsd_test
+
+#include "statsd.c" /* sic */
+#include "testing.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+
+#define TEST_SENDERS 4
+#define TEST_DATAGRAMS 50
+
+static size_t dispatched_num;
+static derive_t dispatched_sum;
+
+/* mock functions */
+int plugin_dispatch_values_statsd_test(value_list_t const *vl) {
+  dispatched_num++;
+  dispatched_sum += vl->values[0].derive;
+  return 0;
+}
+/* end mock functions */
+
+/* Returns the value of a counter, or NAN if it doesn't exist. */
+static double counter_value(char const *name) {
+  char key[DATA_MAX_NAME_LEN + 2];
+  snprintf(key, sizeof(key), "c:%s", name);
+
+  statsd_shard_t *shard = statsd_shard_get(key);
+  statsd_metric_t *metric = NULL;
+  double value = NAN;
+
+  pthread_mutex_lock(&shard->lock);
+  if (c_avl_get(shard->tree, key, (void *)&metric) == 0)
+    value = metric->value;
+  pthread_mutex_unlock(&shard->lock);
+
+  return value;
+}
+
+/* Returns a UDP port on the loopback interface which is currently unused. */
+static int unused_port(void) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0)
+    return -1;
+
+  struct sockaddr_in sa = {
+      .sin_family = AF_INET,
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  socklen_t sa_len = sizeof(sa);
+  if ((bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) ||
+      (getsockname(fd, (struct sockaddr *)&sa, &sa_len) != 0)) {
+    close(fd);
+    return -1;
+  }
+
+  close(fd);
+  return (int)ntohs(sa.sin_port);
+}
+
+static int port;
+
+/* Returns true once a receive thread has bound "port". */
+static bool port_bound(void) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0)
+    return false;
+
+  struct sockaddr_in sa = {
+      .sin_family = AF_INET,
+      .sin_port = htons((uint16_t)port),
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  bool bound = (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0);
+  close(fd);
+  return bound;
+}
+
+DEF_TEST(shards) {
+  char buffer[4096];
+  size_t buffer_len = 0;
+  size_t names_num = 64;
+
+  for (size_t i = 0; i < names_num; i++)
+    buffer_len += snprintf(buffer + buffer_len, sizeof(buffer) - buffer_len,
+                           "shard%" PRIsz ":1|c\n", i);
+  snprintf(buffer + buffer_len, sizeof(buffer) - buffer_len, "shard0:2|c\n");
+  statsd_parse_buffer(buffer);
+
+  /* Each metric is stored in exactly one shard, and the metrics are spread
+   * over several shards. */
+  size_t total = 0;
+  size_t used = 0;
+  for (size_t i = 0; i < STATSD_SHARDS; i++) {
+    int size = c_avl_size(metrics_shards[i].tree);
+    total += (size_t)size;
+    if (size > 0)
+      used++;
+  }
+  EXPECT_EQ_UINT64(names_num, total);
+  OK(used > 1);
+
+  EXPECT_EQ_DOUBLE(3.0, counter_value("shard0"));
+  EXPECT_EQ_DOUBLE(1.0, counter_value("shard63"));
+
+  /* Reading visits every shard. */
+  dispatched_num = 0;
+  dispatched_sum = 0;
+  CHECK_ZERO(statsd_read());
+  EXPECT_EQ_UINT64(names_num, dispatched_num);
+  EXPECT_EQ_UINT64(names_num + 2, dispatched_sum);
+  EXPECT_EQ_DOUBLE(0.0, counter_value("shard0"));
+
+  return 0;
+}
+
+DEF_TEST(network_read) {
+#if HAVE_RECVMMSG
+  size_t burst = STATSD_RECV_ROUNDS * STATSD_RECV_BATCH;
+#else
+  size_t burst = 1;
+#endif
+  statsd_receiver_t receiver = {0};
+  int fds[2];
+
+  CHECK_ZERO(statsd_receiver_init(&receiver));
+  CHECK_ZERO(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds));
+
+  char const *datagram = "burst:1|c";
+  size_t sent = 0;
+  for (size_t i = 0; i < burst + 5; i++)
+    if (send(fds[1], datagram, strlen(datagram), 0) > 0)
+      sent++;
+  EXPECT_EQ_UINT64(burst + 5, sent);
+
+  /* A single wakeup reads a limited number of datagrams. */
+  statsd_network_read(&receiver, fds[0]);
+  EXPECT_EQ_DOUBLE((double)burst, counter_value("burst"));
+
+  while (counter_value("burst") < (double)(burst + 5))
+    statsd_network_read(&receiver, fds[0]);
+
+  /* Nothing left to read. */
+  statsd_network_read(&receiver, fds[0]);
+  EXPECT_EQ_DOUBLE((double)(burst + 5), counter_value("burst"));
+
+  close(fds[0]);
+  close(fds[1]);
+  sfree(receiver.buffer);
+  return 0;
+}
+
+DEF_TEST(receive_threads) {
+  EXPECT_EQ_UINT64((size_t)conf_receive_threads, network_threads_num);
+
+  struct sockaddr_in sa = {
+      .sin_family = AF_INET,
+      .sin_port = htons((uint16_t)port),
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+
+  /* Datagrams sent before any thread has bound its socket are lost. */
+  for (int i = 0; (i < 500) && !port_bound(); i++)
+    usleep(10000);
+  OK(port_bound());
+
+  /* Several senders, so that the datagrams are distributed over the
+   * sockets of the receive threads. */
+  char const *datagram = "threads:1|c";
+  int sent = 0;
+  for (int i = 0; i < TEST_SENDERS; i++) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    OK(fd >= 0);
+    CHECK_ZERO(connect(fd, (struct sockaddr *)&sa, sizeof(sa)));
+    for (int j = 0; j < TEST_DATAGRAMS; j++) {
+      if (send(fd, datagram, strlen(datagram), 0) > 0)
+        sent++;
+      /* Don't overflow the receive buffers. */
+      if ((j % 10) == 9)
+        usleep(1000);
+    }
+    close(fd);
+  }
+  EXPECT_EQ_INT(TEST_SENDERS * TEST_DATAGRAMS, sent);
+
+  /* Wait up to five seconds for all datagrams to be parsed. */
+  double want = (double)(TEST_SENDERS * TEST_DATAGRAMS);
+  for (int i = 0; (i < 500) && !(counter_value("threads") >= want); i++)
+    usleep(10000);
+  EXPECT_EQ_DOUBLE(want, counter_value("threads"));
+
+  return 0;
+}
+
+static void signal_handler(__attribute__((unused)) int signal) {}
+
+int main(void) {
+  /* statsd_shutdown() interrupts the receive threads with SIGTERM. */
+  struct sigaction sa = {.sa_handler = signal_handler};
+  sigaction(SIGTERM, &sa, NULL);
+
+  port = unused_port();
+  if (port < 0)
+    return 1;
+
+  char service[16];
+  snprintf(service, sizeof(service), "%d", port);
+  conf_node = strdup("127.0.0.1");
+  conf_service = strdup(service);
+#ifdef SO_REUSEPORT
+  conf_receive_threads = 4;
+#endif
+  if (statsd_init() != 0)
+    return 1;
+
+  RUN_TEST(shards);
+  RUN_TEST(network_read);
+  RUN_TEST(receive_threads);
+
+  statsd_shutdown();
+  END_TEST;
+}
@@ -31,6 +31,50 @@
 #include "utils_cache.h"
 #include "utils_threshold.h"
 
+/*
+ * Threshold index
+ * ===============
+ * Thresholds are only configured at startup. The first time a value list is
+ * checked, the result of threshold_search() is stored in an index keyed by the
+ * value list's identifier, together with the limits prepared for evaluation.
+ * Identifiers without a threshold are stored, too, so that each value list is
+ * searched for only once. The index also holds the state and hit counter of
+ * each identifier, so checking a value doesn't need to access the value cache
+ * unless the state changes. Entries are removed when the value goes missing.
+ */
+
+/* A threshold with its limits prepared for evaluation: limits that are not
+ * set are replaced by infinity, so they never match. */
+typedef struct {
+  const threshold_t *th;
+  /* Index of the checked data source, UT_DS_ALL or UT_DS_NONE. */
+  int ds_index;
+  gauge_t warning_min;
+  gauge_t warning_max;
+  gauge_t failure_min;
+  gauge_t failure_max;
+} ut_compiled_t;
+
+#define UT_DS_ALL -1
+#define UT_DS_NONE -2
+
+typedef struct {
+  /* Matching thresholds, in the order of the threshold's "next" list. If
+   * th_num is zero, no threshold has been configured for this identifier. */
+  ut_compiled_t *th;
+  size_t th_num;
+
+  int state;
+  int hits;
+} ut_entry_t;
+
+/* Types for which at least one threshold has been configured. Only modified
+ * while reading the configuration. */
+static c_avl_tree_t *ut_types;
+
+static pthread_mutex_t ut_index_lock = PTHREAD_MUTEX_INITIALIZER;
+static c_avl_tree_t *ut_index;
+
 /*
  * Threshold management
  * ====================
@@ -98,11 +142,116 @@ static int ut_threshold_add(const threshold_t *th) { /* {{{ */
     ERROR("ut_threshold_add: c_avl_insert (%s) failed.", name);
     sfree(name_copy);
     sfree(th_copy);
+    return status;
   }
 
-  return status;
+  if (c_avl_get(ut_types, th->type, NULL) != 0) {
+    char *type_copy = strdup(th->type);
+    if ((type_copy == NULL) || (c_avl_insert(ut_types, type_copy, NULL) != 0)) {
+      ERROR("ut_threshold_add: Adding type \"%s\" failed.", th->type);
+      sfree(type_copy);
+      return -1;
+    }
+  }
+
+  return 0;
 } /* }}} int ut_threshold_add */
 
+/*
+ * ut_entry_t *ut_entry_create
+ *
+ * Searches the thresholds matching a value list and prepares them for
+ * evaluation. Returns an entry with th_num set to zero if there is no
+ * matching threshold.
+ */
+static ut_entry_t *ut_entry_create(const data_set_t *ds,
+                                   const value_list_t *vl) { /* {{{ */
+  ut_entry_t *e = calloc(1, sizeof(*e));
+  if (e == NULL)
+    return NULL;
+  e->state = STATE_UNKNOWN;
+
+  pthread_mutex_lock(&threshold_lock);
+  const threshold_t *th = threshold_search(vl);
+  pthread_mutex_unlock(&threshold_lock);
+
+  for (const threshold_t *t = th; t != NULL; t = t->next)
+    e->th_num++;
+  if (e->th_num == 0)
+    return e;
+
+  e->th = calloc(e->th_num, sizeof(*e->th));
+  if (e->th == NULL) {
+    sfree(e);
+    return NULL;
+  }
+
+  size_t i = 0;
+  for (const threshold_t *t = th; t != NULL; t = t->next, i++) {
+    ut_compiled_t *ct = e->th + i;
+
+    ct->th = t;
+    ct->warning_min = isnan(t->warning_min) ? -INFINITY : t->warning_min;
+    ct->warning_max = isnan(t->warning_max) ? INFINITY : t->warning_max;
+    ct->failure_min = isnan(t->failure_min) ? -INFINITY : t->failure_min;
+    ct->failure_max = isnan(t->failure_max) ? INFINITY : t->failure_max;
+
+    ct->ds_index = UT_DS_ALL;
+    if (t->data_source[0] != 0) {
+      ct->ds_index = UT_DS_NONE;
+      for (size_t j = 0; j < ds->ds_num; j++) {
+        if (strcmp(ds->ds[j].name, t->data_source) == 0) {
+          ct->ds_index = (int)j;
+          break;
+        }
+      }
+    }
+  }
+
+  return e;
+} /* }}} ut_entry_t *ut_entry_create */
+
+/*
+ * void ut_entry_destroy
+ *
+ * Frees an index entry.
+ */
+static void ut_entry_destroy(ut_entry_t *e) { /* {{{ */
+  if (e == NULL)
+    return;
+
+  sfree(e->th);
+  sfree(e);
+} /* }}} void ut_entry_destroy */
+
+/*
+ * ut_entry_t *ut_entry_get
+ *
+ * Returns the index entry of a value list, creating it if necessary. Must be
+ * called with ut_index_lock held. Entries are removed when the value goes
+ * missing, so the returned pointer is only valid while the lock is held.
+ * Returns NULL on failure.
+ */
+static ut_entry_t *ut_entry_get(const data_set_t *ds, const value_list_t *vl,
+                                const char *name) { /* {{{ */
+  ut_entry_t *e = NULL;
+
+  if (c_avl_get(ut_index, name, (void *)&e) == 0)
+    return e;
+
+  e = ut_entry_create(ds, vl);
+  char *name_copy = strdup(name);
+  if ((e == NULL) || (name_copy == NULL) ||
+      (c_avl_insert(ut_index, name_copy, e) != 0)) {
+    ERROR("ut_entry_get: Adding \"%s\" to the threshold index failed.", name);
+    ut_entry_destroy(e);
+    sfree(name_copy);
+    return NULL;
+  }
+
+  return e;
+} /* }}} ut_entry_t *ut_entry_get */
+
 /*
  * Configuration
  * =============
@@ -270,54 +419,66 @@ static int ut_config_host(const threshold_t *th_orig, oconfig_item_t *ci) {
 /* }}} */
 
 /*
- * int ut_report_state
+ * bool ut_update_state
  *
- * Checks if the `state' differs from the old state and creates a notification
- * if appropriate.
- * Does not fail.
+ * Updates the hit counter and state of an index entry and returns true if the
+ * `state' should be reported. Must be called with ut_index_lock held.
  */
-static int ut_report_state(const data_set_t *ds, const value_list_t *vl,
-                           const threshold_t *th, const gauge_t *values,
-                           int ds_index, int state) { /* {{{ */
-  int state_old;
-  notification_t n;
-
-  char *buf;
-  size_t bufsize;
-
-  int status;
-
+static bool ut_update_state(ut_entry_t *e, const threshold_t *th, int state,
+                            int *ret_state_old) { /* {{{ */
   /* Check if hits matched */
   if ((th->hits != 0)) {
-    int hits = uc_get_hits(vl);
     /* STATE_OKAY resets hits unless PERSIST_OK flag is set. Hits resets if
      * threshold is hit. */
     if (((state == STATE_OKAY) && ((th->flags & UT_FLAG_PERSIST_OK) == 0)) ||
-        (hits > th->hits)) {
-      DEBUG("ut_report_state: reset uc_get_hits = 0");
-      uc_set_hits(vl, 0); /* reset hit counter and notify */
+        (e->hits > th->hits)) {
+      DEBUG("ut_update_state: reset hits = 0");
+      e->hits = 0; /* reset hit counter and notify */
     } else {
-      DEBUG("ut_report_state: th->hits = %d, uc_get_hits = %d", th->hits,
-            uc_get_hits(vl));
-      (void)uc_inc_hits(vl, 1); /* increase hit counter */
-      return 0;
+      DEBUG("ut_update_state: th->hits = %d, hits = %d", th->hits, e->hits);
+      e->hits++; /* increase hit counter */
+      return false;
     }
   } /* end check hits */
 
-  state_old = uc_get_state(vl);
+  int state_old = e->state;
+  *ret_state_old = state_old;
 
   /* If the state didn't change, report if `persistent' is specified. If the
    * state is `okay', then only report if `persist_ok` flag is set. */
   if (state == state_old) {
     if (state == STATE_UNKNOWN) {
       /* From UNKNOWN to UNKNOWN. Persist doesn't apply here. */
-      return 0;
+      return false;
     } else if ((th->flags & UT_FLAG_PERSIST) == 0)
-      return 0;
+      return false;
     else if ((state == STATE_OKAY) && ((th->flags & UT_FLAG_PERSIST_OK) == 0))
-      return 0;
+      return false;
   }
 
+  e->state = state;
+  return true;
+} /* }}} bool ut_update_state */
+
+/*
+ * int ut_report_state
+ *
+ * Creates a notification for a state which ut_update_state() decided to
+ * report.
+ * Does not fail.
+ */
+static int ut_report_state(const data_set_t *ds, const value_list_t *vl,
+                           const threshold_t *th, const gauge_t *values,
+                           int ds_index, int state,
+                           int state_old) { /* {{{ */
+  notification_t n;
+
+  char *buf;
+  size_t bufsize;
+
+  int status;
+
+  /* Other plugins, e.g. write_riemann, read the state from the cache. */
   if (state != state_old)
     uc_set_state(vl, state);
 
@@ -443,110 +604,29 @@ static int ut_report_state(const data_set_t *ds, const value_list_t *vl,
   return 0;
 } /* }}} int ut_report_state */
 
-/*
- * int ut_check_one_data_source
- *
- * Checks one data source against the given threshold configuration. If the
- * `DataSource' option is set in the threshold, and the name does NOT match,
- * `okay' is returned. If the threshold does match, its failure and warning
- * min and max values are checked and `failure' or `warning' is returned if
- * appropriate.
- * Does not fail.
- */
-static int ut_check_one_data_source(
-    const data_set_t *ds, const value_list_t __attribute__((unused)) * vl,
-    const threshold_t *th, const gauge_t *values, int ds_index) { /* {{{ */
-  const char *ds_name;
-  int is_warning = 0;
-  int is_failure = 0;
-  int prev_state = STATE_OKAY;
-
-  /* check if this threshold applies to this data source */
-  if (ds != NULL) {
-    ds_name = ds->ds[ds_index].name;
-    if ((th->data_source[0] != 0) && (strcmp(ds_name, th->data_source) != 0))
-      return STATE_UNKNOWN;
-  }
-
-  if ((th->flags & UT_FLAG_INVERT) != 0) {
-    is_warning--;
-    is_failure--;
-  }
-
-  /* XXX: This is an experimental code, not optimized, not fast, not reliable,
-   * and probably, do not work as you expect. Enjoy! :D */
-  if (th->hysteresis > 0) {
-    prev_state = uc_get_state(vl);
-    /* The purpose of hysteresis is elliminating flapping state when the value
-     * oscilates around the thresholds. In other words, what is important is
-     * the previous state; if the new value would trigger a transition, make
-     * sure that we artificially widen the range which is considered to apply
-     * for the previous state, and only trigger the notification if the value
-     * is outside of this expanded range.
-     *
-     * There is no hysteresis for the OKAY state.
-     * */
-    gauge_t hysteresis_for_warning = 0, hysteresis_for_failure = 0;
-    switch (prev_state) {
-    case STATE_ERROR:
-      hysteresis_for_failure = th->hysteresis;
-      break;
-    case STATE_WARNING:
-      hysteresis_for_warning = th->hysteresis;
-      break;
-    case STATE_UNKNOWN:
-    case STATE_OKAY:
-      /* do nothing -- the hysteresis only applies to the non-normal states */
-      break;
-    }
-
-    if ((!isnan(th->failure_min) &&
-         (th->failure_min + hysteresis_for_failure > values[ds_index])) ||
-        (!isnan(th->failure_max) &&
-         (th->failure_max - hysteresis_for_failure < values[ds_index])))
-      is_failure++;
-
-    if ((!isnan(th->warning_min) &&
-         (th->warning_min + hysteresis_for_warning > values[ds_index])) ||
-        (!isnan(th->warning_max) &&
-         (th->warning_max - hysteresis_for_warning < values[ds_index])))
-      is_warning++;
-
-  } else { /* no hysteresis */
-    if ((!isnan(th->failure_min) && (th->failure_min > values[ds_index])) ||
-        (!isnan(th->failure_max) && (th->failure_max < values[ds_index])))
-      is_failure++;
-
-    if ((!isnan(th->warning_min) && (th->warning_min > values[ds_index])) ||
-        (!isnan(th->warning_max) && (th->warning_max < values[ds_index])))
-      is_warning++;
-  }
-
-  if (is_failure != 0)
-    return STATE_ERROR;
-
-  if (is_warning != 0)
-    return STATE_WARNING;
-
-  return STATE_OKAY;
-} /* }}} int ut_check_one_data_source */
-
 /*
  * int ut_check_one_threshold
  *
- * Checks all data sources of a value list against the given threshold, using
- * the ut_check_one_data_source function above. Returns the worst status,
- * which is `okay' if nothing has failed or `unknown' if no valid datasource was
- * defined.
- * Returns less than zero if the data set doesn't have any data sources.
+ * Checks the data sources of a value list against the given threshold. If the
+ * `DataSource' option is set in the threshold, only that data source is
+ * checked. The failure and warning min and max values are checked and
+ * `failure' or `warning' is returned if appropriate. Returns the worst
+ * status, which is `okay' if nothing has failed or `unknown' if no valid
+ * datasource was defined.
+ * Does not fail.
  */
-static int ut_check_one_threshold(const data_set_t *ds, const value_list_t *vl,
-                                  const threshold_t *th, const gauge_t *values,
+static int ut_check_one_threshold(const data_set_t *ds,
+                                  const ut_compiled_t *ct, int prev_state,
+                                  const gauge_t *values,
                                   int *ret_ds_index) { /* {{{ */
-  int ret = -1;
-  int ds_index = -1;
+  const threshold_t *th = ct->th;
   gauge_t values_copy[ds->ds_num];
 
+  if (ct->ds_index == UT_DS_NONE) {
+    *ret_ds_index = 0;
+    return STATE_UNKNOWN;
+  }
+
   memcpy(values_copy, values, sizeof(values_copy));
 
   if ((th->flags & UT_FLAG_PERCENTAGE) != 0) {
@@ -581,19 +661,58 @@ static int ut_check_one_threshold(const data_set_t *ds, const value_list_t *vl,
     }
   } /* if (UT_FLAG_PERCENTAGE) */
 
-  for (size_t i = 0; i < ds->ds_num; i++) {
-    int status;
+  /* The purpose of hysteresis is eliminating flapping state when the value
+   * oscillates around the thresholds. In other words, what is important is
+   * the previous state; if the new value would trigger a transition, make
+   * sure that we artificially widen the range which is considered to apply
+   * for the previous state, and only trigger the notification if the value
+   * is outside of this expanded range.
+   *
+   * There is no hysteresis for the OKAY state. */
+  gauge_t failure_min = ct->failure_min;
+  gauge_t failure_max = ct->failure_max;
+  gauge_t warning_min = ct->warning_min;
+  gauge_t warning_max = ct->warning_max;
+  if ((th->hysteresis > 0) && (prev_state == STATE_ERROR)) {
+    failure_min += th->hysteresis;
+    failure_max -= th->hysteresis;
+  } else if ((th->hysteresis > 0) && (prev_state == STATE_WARNING)) {
+    warning_min += th->hysteresis;
+    warning_max -= th->hysteresis;
+  }
+
+  bool invert = (th->flags & UT_FLAG_INVERT) != 0;
+
+  size_t begin = 0;
+  size_t end = ds->ds_num;
+  if (ct->ds_index >= 0) {
+    begin = (size_t)ct->ds_index;
+    end = begin + 1;
+  }
+
+  /* Comparisons with NaN are false, so undefined values are within range.
+   * The state of each data source is at least STATE_OKAY, so the first data
+   * source with the worst state is reported. */
+  int ret = STATE_OKAY;
+  int ds_index = (int)begin;
+  for (size_t i = begin; i < end; i++) {
+    gauge_t v = values_copy[i];
+    bool is_failure = (v < failure_min) || (v > failure_max);
+    bool is_warning = (v < warning_min) || (v > warning_max);
+
+    int status = STATE_OKAY;
+    if (is_failure != invert)
+      status = STATE_ERROR;
+    else if (is_warning != invert)
+      status = STATE_WARNING;
 
-    status = ut_check_one_data_source(ds, vl, th, values_copy, i);
     if (ret < status) {
       ret = status;
-      ds_index = i;
+      ds_index = (int)i;
     }
   } /* for (ds->ds_num) */
 
-  if (ret_ds_index != NULL)
-    *ret_ds_index = ds_index;
-
+  *ret_ds_index = ds_index;
   return ret;
 } /* }}} int ut_check_one_threshold */
 
@@ -609,60 +728,72 @@ static int ut_check_one_threshold(const data_set_t *ds, const value_list_t *vl,
 static int ut_check_threshold(const data_set_t *ds, const value_list_t *vl,
                               __attribute__((unused))
                               user_data_t *ud) { /* {{{ */
-  threshold_t *th;
-  gauge_t *values;
-  int status;
-
-  int worst_state = -1;
-  threshold_t *worst_th = NULL;
-  int worst_ds_index = -1;
+  char name[6 * DATA_MAX_NAME_LEN];
 
-  if (threshold_tree == NULL)
+  if (ut_index == NULL)
     return 0;
 
-  /* Is this lock really necessary? So far, thresholds are only inserted at
-   * startup. -octo */
-  pthread_mutex_lock(&threshold_lock);
-  th = threshold_search(vl);
-  pthread_mutex_unlock(&threshold_lock);
-  if (th == NULL)
+  /* Most value lists have a type no threshold has been configured for. */
+  if (c_avl_get(ut_types, vl->type, NULL) != 0)
     return 0;
 
-  DEBUG("ut_check_threshold: Found matching threshold(s)");
+  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
+    ERROR("ut_check_threshold: FORMAT_VL failed.");
+    return -1;
+  }
 
-  values = uc_get_rate(ds, vl);
-  if (values == NULL)
-    return 0;
+  pthread_mutex_lock(&ut_index_lock);
 
-  while (th != NULL) {
-    int ds_index = -1;
+  ut_entry_t *e = ut_entry_get(ds, vl, name);
+  if ((e == NULL) || (e->th_num == 0)) {
+    pthread_mutex_unlock(&ut_index_lock);
+    return (e == NULL) ? -1 : 0;
+  }
 
-    status = ut_check_one_threshold(ds, vl, th, values, &ds_index);
-    if (status < 0) {
-      ERROR("ut_check_threshold: ut_check_one_threshold failed.");
-      sfree(values);
-      return -1;
+  DEBUG("ut_check_threshold: Found matching threshold(s)");
+
+  gauge_t values[ds->ds_num];
+  if (uc_get_rate_dispatched(vl, values, ds->ds_num) != 0) {
+    gauge_t *cached = uc_get_rate(ds, vl);
+    if (cached == NULL) {
+      pthread_mutex_unlock(&ut_index_lock);
+      return 0;
     }
+    memcpy(values, cached, sizeof(values));
+    sfree(cached);
+  }
+
+  int worst_state = -1;
+  const threshold_t *worst_th = NULL;
+  int worst_ds_index = -1;
+  int state_old = STATE_UNKNOWN;
+
+  for (size_t i = 0; i < e->th_num; i++) {
+    int ds_index = -1;
 
+    int status =
+        ut_check_one_threshold(ds, e->th + i, e->state, values, &ds_index);
     if (worst_state < status) {
       worst_state = status;
-      worst_th = th;
+      worst_th = e->th[i].th;
       worst_ds_index = ds_index;
     }
+  }
+
+  bool report = ut_update_state(e, worst_th, worst_state, &state_old);
 
-    th = th->next;
-  } /* while (th) */
+  pthread_mutex_unlock(&ut_index_lock);
 
-  status =
-      ut_report_state(ds, vl, worst_th, values, worst_ds_index, worst_state);
+  if (!report)
+    return 0;
+
+  int status = ut_report_state(ds, vl, worst_th, values, worst_ds_index,
+                               worst_state, state_old);
   if (status != 0) {
     ERROR("ut_check_threshold: ut_report_state failed.");
-    sfree(values);
     return -1;
   }
 
-  sfree(values);
-
   return 0;
 } /* }}} int ut_check_threshold */
 
@@ -682,6 +813,23 @@ static int ut_missing(const value_list_t *vl,
   if (threshold_tree == NULL)
     return 0;
 
+  if (c_avl_get(ut_types, vl->type, NULL) != 0)
+    return 0;
+
+  FORMAT_VL(identifier, sizeof(identifier), vl);
+
+  /* The value is removed from the cache, which forgets its state. Do the
+   * same in the index, so that it doesn't grow with every identifier ever
+   * seen. */
+  char *key = NULL;
+  ut_entry_t *e = NULL;
+  pthread_mutex_lock(&ut_index_lock);
+  if (c_avl_remove(ut_index, identifier, (void *)&key, (void *)&e) == 0) {
+    sfree(key);
+    ut_entry_destroy(e);
+  }
+  pthread_mutex_unlock(&ut_index_lock);
+
   th = threshold_search(vl);
   /* dispatch notifications for "interesting" values only */
   if ((th == NULL) || ((th->flags & UT_FLAG_INTERESTING) == 0))
@@ -689,7 +837,6 @@ static int ut_missing(const value_list_t *vl,
 
   now = cdtime();
   missing_time = now - vl->time;
-  FORMAT_VL(identifier, sizeof(identifier), vl);
 
   NOTIFICATION_INIT_VL(&n, vl);
   ssnprintf(n.message, sizeof(n.message),
@@ -714,6 +861,15 @@ static int ut_config(oconfig_item_t *ci) { /* {{{ */
     }
   }
 
+  if (ut_types == NULL) {
+    ut_types = c_avl_create((int (*)(const void *, const void *))strcmp);
+    ut_index = c_avl_create((int (*)(const void *, const void *))strcmp);
+    if ((ut_types == NULL) || (ut_index == NULL)) {
+      ERROR("ut_config: c_avl_create failed.");
+      return -1;
+    }
+  }
+
   threshold_t th = {
       .warning_min = NAN,
       .warning_max = NAN,
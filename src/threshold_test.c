@@ -0,0 +1,297 @@
+/**
+ * collectd - src/threshold_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#define plugin_dispatch_notification plugin_dispatch_notification_ut_test
+#define uc_get_rate_dispatched uc_get_rate_dispatched_ut_test
+#define uc_set_state uc_set_state_ut_test
+
+/* testing.h has to be included first for the declaration of cdtime_mock. */
+#include "testing.h"
+
+#include "threshold.c" /* sic */
+
+static int notification_severity;
+static char notification_message[NOTIF_MAX_MSG_LEN];
+static size_t notification_num;
+
+/* mock functions */
+int plugin_dispatch_notification_ut_test(notification_t const *n) {
+  notification_severity = n->severity;
+  sstrncpy(notification_message, n->message, sizeof(notification_message));
+  notification_num++;
+  return 0;
+}
+
+/* All test values are gauges, so the rates are the values themselves. */
+int uc_get_rate_dispatched_ut_test(value_list_t const *vl,
+                                   gauge_t *ret_values, size_t values_num) {
+  if (vl->values_len != values_num)
+    return EINVAL;
+
+  for (size_t i = 0; i < values_num; i++)
+    ret_values[i] = vl->values[i].gauge;
+  return 0;
+}
+
+int uc_set_state_ut_test(__attribute__((unused)) value_list_t const *vl,
+                         __attribute__((unused)) int state) {
+  return 0;
+}
+/* end mock functions */
+
+static data_source_t gauge_ds_source[] = {
+    {"value", DS_TYPE_GAUGE, NAN, NAN},
+};
+static data_set_t gauge_ds = {"gauge", 1, gauge_ds_source};
+
+static data_source_t memory_ds_source[] = {
+    {"used", DS_TYPE_GAUGE, NAN, NAN},
+    {"free", DS_TYPE_GAUGE, NAN, NAN},
+};
+static data_set_t memory_ds = {"memory", 2, memory_ds_source};
+
+static cdtime_t last_time;
+
+static value_list_t make_value_list(char const *type, value_t *values,
+                                    size_t values_num) {
+  last_time += TIME_T_TO_CDTIME_T(10);
+  value_list_t vl = {
+      .values = values,
+      .values_len = values_num,
+      .time = last_time,
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+  };
+  sstrncpy(vl.type, type, sizeof(vl.type));
+  return vl;
+}
+
+/* Checks a single value against the thresholds of "type". Returns the
+ * severity of the dispatched notification or zero if there was none. */
+static int check(char const *type, gauge_t value) {
+  value_list_t vl = make_value_list(type, &(value_t){.gauge = value}, 1);
+
+  notification_num = 0;
+  if (ut_check_threshold(&gauge_ds, &vl, NULL) != 0)
+    return -1;
+  return (notification_num > 0) ? notification_severity : 0;
+}
+
+/* Returns a threshold for "type" with the defaults of the configuration. */
+static threshold_t new_threshold(char const *type) {
+  threshold_t th = {
+      .warning_min = NAN,
+      .warning_max = NAN,
+      .failure_min = NAN,
+      .failure_max = NAN,
+      .flags = UT_FLAG_INTERESTING,
+  };
+  sstrncpy(th.type, type, sizeof(th.type));
+  return th;
+}
+
+DEF_TEST(simple) {
+  threshold_t th = new_threshold("simple");
+  th.warning_max = 10.0;
+  th.failure_max = 20.0;
+  CHECK_ZERO(ut_threshold_add(&th));
+
+  EXPECT_EQ_INT(NOTIF_OKAY, check("simple", 5.0));
+  EXPECT_EQ_INT(0, check("simple", 6.0));
+  EXPECT_EQ_INT(NOTIF_WARNING, check("simple", 15.0));
+  EXPECT_EQ_STR("Host example.com, plugin test type simple: Data source "
+                "\"value\" is currently 15.000000. That is above the warning "
+                "threshold of 10.000000.",
+                notification_message);
+  EXPECT_EQ_INT(NOTIF_FAILURE, check("simple", 25.0));
+  EXPECT_EQ_INT(NOTIF_OKAY, check("simple", 5.0));
+
+  /* Undefined values are within range. */
+  EXPECT_EQ_INT(0, check("simple", NAN));
+
+  /* Values without a matching threshold are ignored. */
+  EXPECT_EQ_INT(0, check("other", 25.0));
+  return 0;
+}
+
+DEF_TEST(invert) {
+  /* Values within the ranges are reported. */
+  threshold_t th = new_threshold("invert");
+  th.warning_min = 10.0;
+  th.warning_max = 20.0;
+  th.failure_min = 12.0;
+  th.failure_max = 18.0;
+  th.flags |= UT_FLAG_INVERT;
+  CHECK_ZERO(ut_threshold_add(&th));
+
+  EXPECT_EQ_INT(NOTIF_OKAY, check("invert", 5.0));
+  EXPECT_EQ_INT(NOTIF_WARNING, check("invert", 11.0));
+  EXPECT_EQ_STR("Host example.com, plugin test type invert: Data source "
+                "\"value\" is currently 11.000000. That is within the warning "
+                "region of 10.000000 and 20.000000.",
+                notification_message);
+  EXPECT_EQ_INT(NOTIF_FAILURE, check("invert", 15.0));
+  EXPECT_EQ_INT(NOTIF_OKAY, check("invert", 25.0));
+  return 0;
+}
+
+DEF_TEST(hysteresis) {
+  threshold_t th = new_threshold("hysteresis");
+  th.warning_max = 10.0;
+  th.hysteresis = 2.0;
+  CHECK_ZERO(ut_threshold_add(&th));
+
+  EXPECT_EQ_INT(NOTIF_OKAY, check("hysteresis", 5.0));
+  EXPECT_EQ_INT(NOTIF_WARNING, check("hysteresis", 11.0));
+  /* The warning range is widened to 8 until the state changes. */
+  EXPECT_EQ_INT(0, check("hysteresis", 9.0));
+  EXPECT_EQ_INT(NOTIF_OKAY, check("hysteresis", 7.0));
+  /* There is no hysteresis for the okay state. */
+  EXPECT_EQ_INT(0, check("hysteresis", 9.0));
+  EXPECT_EQ_INT(NOTIF_WARNING, check("hysteresis", 10.5));
+  return 0;
+}
+
+DEF_TEST(hits) {
+  threshold_t th = new_threshold("hits");
+  th.failure_max = 10.0;
+  th.hits = 2;
+  CHECK_ZERO(ut_threshold_add(&th));
+
+  /* The state is only reported once the counter exceeds "hits". */
+  EXPECT_EQ_INT(0, check("hits", 11.0));
+  EXPECT_EQ_INT(0, check("hits", 11.0));
+  EXPECT_EQ_INT(0, check("hits", 11.0));
+  EXPECT_EQ_INT(NOTIF_FAILURE, check("hits", 11.0));
+
+  /* An okay value resets the counter. */
+  EXPECT_EQ_INT(NOTIF_OKAY, check("hits", 5.0));
+  EXPECT_EQ_INT(0, check("hits", 11.0));
+  EXPECT_EQ_INT(0, check("hits", 5.0));
+  EXPECT_EQ_INT(0, check("hits", 11.0));
+  EXPECT_EQ_INT(0, check("hits", 11.0));
+  EXPECT_EQ_INT(0, check("hits", 11.0));
+  EXPECT_EQ_INT(NOTIF_FAILURE, check("hits", 11.0));
+  return 0;
+}
+
+DEF_TEST(persist) {
+  threshold_t th_persist = new_threshold("persist");
+  th_persist.warning_max = 10.0;
+  th_persist.flags |= UT_FLAG_PERSIST;
+  CHECK_ZERO(ut_threshold_add(&th_persist));
+  threshold_t th_persist_ok = new_threshold("persist_ok");
+  th_persist_ok.warning_max = 10.0;
+  th_persist_ok.flags |= UT_FLAG_PERSIST | UT_FLAG_PERSIST_OK;
+  CHECK_ZERO(ut_threshold_add(&th_persist_ok));
+
+  EXPECT_EQ_INT(NOTIF_WARNING, check("simple", 15.0));
+  EXPECT_EQ_INT(0, check("simple", 15.0));
+
+  EXPECT_EQ_INT(NOTIF_WARNING, check("persist", 15.0));
+  EXPECT_EQ_INT(NOTIF_WARNING, check("persist", 15.0));
+  EXPECT_EQ_INT(NOTIF_OKAY, check("persist", 5.0));
+  EXPECT_EQ_INT(0, check("persist", 5.0));
+
+  EXPECT_EQ_INT(NOTIF_OKAY, check("persist_ok", 5.0));
+  EXPECT_EQ_INT(NOTIF_OKAY, check("persist_ok", 5.0));
+  EXPECT_EQ_INT(NOTIF_WARNING, check("persist_ok", 15.0));
+  EXPECT_EQ_INT(NOTIF_WARNING, check("persist_ok", 15.0));
+  return 0;
+}
+
+DEF_TEST(percentage) {
+  threshold_t th = new_threshold("memory");
+  sstrncpy(th.data_source, "used", sizeof(th.data_source));
+  th.warning_max = 80.0;
+  th.flags |= UT_FLAG_PERCENTAGE;
+  CHECK_ZERO(ut_threshold_add(&th));
+
+  value_t values[] = {{.gauge = 900.0}, {.gauge = 100.0}};
+  value_list_t vl = make_value_list("memory", values, 2);
+
+  notification_num = 0;
+  CHECK_ZERO(ut_check_threshold(&memory_ds, &vl, NULL));
+  EXPECT_EQ_UINT64(1, notification_num);
+  EXPECT_EQ_INT(NOTIF_WARNING, notification_severity);
+  EXPECT_EQ_STR("Host example.com, plugin test type memory: Data source "
+                "\"used\" is currently 900 (90.00%). That is above the warning "
+                "threshold of 80.00%.",
+                notification_message);
+
+  /* Only the configured data source is checked. */
+  values[0].gauge = 100.0;
+  values[1].gauge = 900.0;
+  vl = make_value_list("memory", values, 2);
+
+  notification_num = 0;
+  CHECK_ZERO(ut_check_threshold(&memory_ds, &vl, NULL));
+  EXPECT_EQ_UINT64(1, notification_num);
+  EXPECT_EQ_INT(NOTIF_OKAY, notification_severity);
+  return 0;
+}
+
+DEF_TEST(missing) {
+  threshold_t th = new_threshold("missing");
+  th.warning_max = 10.0;
+  CHECK_ZERO(ut_threshold_add(&th));
+
+  EXPECT_EQ_INT(NOTIF_WARNING, check("missing", 15.0));
+  int index_size = c_avl_size(ut_index);
+
+  value_list_t vl = make_value_list("missing", NULL, 0);
+  notification_num = 0;
+  CHECK_ZERO(ut_missing(&vl, NULL));
+  EXPECT_EQ_UINT64(1, notification_num);
+  OK(strstr(notification_message, "has not been updated") != NULL);
+
+  /* The entry is removed from the index, which forgets its state. */
+  EXPECT_EQ_INT(index_size - 1, c_avl_size(ut_index));
+  EXPECT_EQ_INT(NOTIF_WARNING, check("missing", 15.0));
+  EXPECT_EQ_INT(index_size, c_avl_size(ut_index));
+
+  /* Values of types without thresholds are not in the index. */
+  vl = make_value_list("unknown", NULL, 0);
+  notification_num = 0;
+  CHECK_ZERO(ut_missing(&vl, NULL));
+  EXPECT_EQ_UINT64(0, notification_num);
+  EXPECT_EQ_INT(index_size, c_avl_size(ut_index));
+  return 0;
+}
+
+int main(void) {
+  threshold_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
+  ut_types = c_avl_create((int (*)(const void *, const void *))strcmp);
+  ut_index = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if ((threshold_tree == NULL) || (ut_types == NULL) || (ut_index == NULL))
+    return 1;
+
+  RUN_TEST(simple);
+  RUN_TEST(invert);
+  RUN_TEST(hysteresis);
+  RUN_TEST(hits);
+  RUN_TEST(persist);
+  RUN_TEST(percentage);
+  RUN_TEST(missing);
+
+  END_TEST;
+}
@@ -33,12 +33,19 @@
 #include "utils/cmds/getthreshold.h"
 #include "utils/cmds/getval.h"
 #include "utils/cmds/listval.h"
+#include "utils/cmds/parse_option.h"
 #include "utils/cmds/putnotif.h"
 #include "utils/cmds/putval.h"
 
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/un.h>
 
+#if HAVE_SYS_EPOLL_H
+#include <fcntl.h>
+#include <sys/epoll.h>
+#endif
+
 #include <grp.h>
 
 #ifndef UNIX_PATH_MAX
@@ -47,12 +54,20 @@
 
 #define US_DEFAULT_PATH LOCALSTATEDIR "/run/" PACKAGE_NAME "-unixsock"
 
+/* Size of the per-connection read buffer; also the maximum line length. */
+#define US_BUFFER_SIZE 65536
+/* Maximum number of value lists collected before they are dispatched. */
+#define US_BATCH_SIZE 1024
+/* Maximum number of reads from one connection before other connections are
+ * served. */
+#define US_READS_PER_EVENT 16
+
 /*
  * Private variables
  */
 /* valid configuration file keys */
 static const char *config_keys[] = {"SocketFile", "SocketGroup", "SocketPerms",
-                                    "DeleteSocket"};
+                                    "DeleteSocket", "WorkerThreads"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static int loop;
@@ -64,7 +79,58 @@ static char *sock_group;
 static int sock_perms = S_IRWXU | S_IRWXG;
 static bool delete_socket;
 
+#if HAVE_SYS_EPOLL_H
+static int epoll_fd = -1;
+static int wakeup_fd[2] = {-1, -1};
+
+static pthread_t *workers;
+static size_t workers_num = 4;
+static size_t workers_started;
+#else
+static size_t workers_num;
 static pthread_t listen_thread = (pthread_t)0;
+#endif
+
+typedef struct us_conn_s us_conn_t;
+struct us_conn_s {
+  int fd;
+  /* Responses are written to "fh", a memory stream backed by "out", and sent
+   * from there. "out_sent" bytes of "out" have been sent so far. */
+  FILE *fh;
+  char *out;
+  size_t out_size;
+  size_t out_sent;
+  /* No more commands are read; the connection is closed once all responses
+   * have been sent. */
+  bool closing;
+  /* Successful PUTVAL commands are not answered. Set with the OPTION
+   * command by clients which don't read these responses. */
+  bool suppress_putval_responses;
+
+  char buffer[US_BUFFER_SIZE];
+  size_t buffer_fill;
+
+  /* Value lists received with PUTVAL, not yet dispatched. */
+  value_list_t *batch;
+  size_t batch_num;
+  size_t batch_size;
+  /* Number of value lists of each of these PUTVAL commands. The commands are
+   * answered once the values have been dispatched. */
+  size_t *putvals;
+  size_t putvals_num;
+  size_t putvals_size;
+
+#if HAVE_SYS_EPOLL_H
+  us_conn_t *prev;
+  us_conn_t *next;
+#endif
+};
+
+#if HAVE_SYS_EPOLL_H
+/* Open connections, closed by us_server_stop(). */
+static us_conn_t *conns;
+static pthread_mutex_t conns_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 /*
  * Functions
@@ -158,113 +224,561 @@ static int us_open_socket(void) {
   return 0;
 } /* int us_open_socket */
 
-static void *us_handle_client(void *arg) {
-  int fdin;
-  int fdout;
-  FILE *fhin, *fhout;
+/*
+ * Connection handling
+ *
+ * Commands are read into a per-connection buffer and handled in place, one
+ * line at a time. Values received with PUTVAL are collected and dispatched
+ * as one batch, and responses are written to a memory stream that is sent
+ * once all commands read so far have been handled. Clients can thus pipeline
+ * commands without waiting for each response. No more commands are read from
+ * a connection until its pending responses have been sent.
+ */
+static us_conn_t *us_conn_create(int fd) {
+  us_conn_t *conn = calloc(1, sizeof(*conn));
+  if (conn == NULL) {
+    ERROR("unixsock plugin: calloc failed.");
+    close(fd);
+    return NULL;
+  }
+  conn->fd = fd;
+
+  conn->fh = open_memstream(&conn->out, &conn->out_size);
+  if (conn->fh == NULL) {
+    ERROR("unixsock plugin: open_memstream failed: %s", STRERRNO);
+    close(fd);
+    sfree(conn);
+    return NULL;
+  }
 
-  fdin = *((int *)arg);
-  free(arg);
-  arg = NULL;
+  return conn;
+} /* us_conn_t *us_conn_create */
 
-  DEBUG("unixsock plugin: us_handle_client: Reading from fd #%i", fdin);
+static void us_conn_destroy(us_conn_t *conn) {
+  if (conn == NULL)
+    return;
 
-  fdout = dup(fdin);
-  if (fdout < 0) {
-    ERROR("unixsock plugin: dup failed: %s", STRERRNO);
-    close(fdin);
-    pthread_exit((void *)1);
+  for (size_t i = 0; i < conn->batch_num; i++) {
+    sfree(conn->batch[i].values);
+    meta_data_destroy(conn->batch[i].meta);
+  }
+  sfree(conn->batch);
+  sfree(conn->putvals);
+  fclose(conn->fh);
+  sfree(conn->out);
+  close(conn->fd);
+  sfree(conn);
+} /* void us_conn_destroy */
+
+/* Returns true if responses are waiting to be sent. */
+static bool us_conn_pending(us_conn_t const *conn) {
+  return conn->out_sent < conn->out_size;
+} /* bool us_conn_pending */
+
+/* Sends the buffered responses. With MSG_DONTWAIT in "flags", sends as much as
+ * possible without blocking and keeps the rest for later. Returns non-zero if
+ * the connection should be closed. */
+static int us_conn_send(us_conn_t *conn, int flags) {
+  if (fflush(conn->fh) != 0) {
+    ERROR("unixsock plugin: fflush failed: %s", STRERRNO);
+    return -1;
   }
 
-  fhin = fdopen(fdin, "r");
-  if (fhin == NULL) {
-    ERROR("unixsock plugin: fdopen failed: %s", STRERRNO);
-    close(fdin);
-    close(fdout);
-    pthread_exit((void *)1);
-    return (void *)1;
+  while (us_conn_pending(conn)) {
+    ssize_t len = send(conn->fd, conn->out + conn->out_sent,
+                       conn->out_size - conn->out_sent, flags);
+    if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        return 0;
+      WARNING("unixsock plugin: failed to write to socket #%i: %s", conn->fd,
+              STRERRNO);
+      return -1;
+    }
+    conn->out_sent += (size_t)len;
   }
 
-  fhout = fdopen(fdout, "w");
-  if (fhout == NULL) {
-    ERROR("unixsock plugin: fdopen failed: %s", STRERRNO);
-    fclose(fhin); /* this closes fdin as well */
-    close(fdout);
-    pthread_exit((void *)1);
-    return (void *)1;
+  /* Everything has been sent: write the next responses from the start. */
+  rewind(conn->fh);
+  conn->out_size = 0;
+  conn->out_sent = 0;
+  return 0;
+} /* int us_conn_send */
+
+/* Answers a PUTVAL command with "vl_num" value lists, which have been
+ * dispatched with "status". */
+static void us_putval_reply(us_conn_t *conn, size_t vl_num, int status) {
+  if (status != 0)
+    fprintf(conn->fh, "-1 Dispatching values failed: %s\n", STRERROR(status));
+  else if (!conn->suppress_putval_responses)
+    fprintf(conn->fh, "0 Success: %zu %s been dispatched.\n", vl_num,
+            (vl_num == 1) ? "value has" : "values have");
+} /* void us_putval_reply */
+
+/* Dispatches the values collected from PUTVAL commands and answers these
+ * commands. */
+static void us_conn_dispatch(us_conn_t *conn) {
+  if (conn->putvals_num == 0)
+    return;
+
+  int status = 0;
+  if (conn->batch_num > 0)
+    status = plugin_dispatch_values_batch(conn->batch, conn->batch_num);
+
+  for (size_t i = 0; i < conn->putvals_num; i++)
+    us_putval_reply(conn, conn->putvals[i], status);
+  conn->putvals_num = 0;
+
+  for (size_t i = 0; i < conn->batch_num; i++) {
+    sfree(conn->batch[i].values);
+    meta_data_destroy(conn->batch[i].meta);
   }
+  conn->batch_num = 0;
+} /* void us_conn_dispatch */
+
+/* Like cmd_error_fh(), but leaves flushing the response to the caller. The
+ * PUTVAL commands received before are answered first, so that responses are
+ * sent in the order of the commands. */
+static void us_error_cb(void *ud, cmd_status_t status, const char *format,
+                        va_list ap) {
+  us_conn_t *conn = ud;
+
+  us_conn_dispatch(conn);
+
+  fprintf(conn->fh, "%i ", (status == CMD_OK) ? 0 : -1);
+  vfprintf(conn->fh, format, ap);
+  fputc('\n', conn->fh);
+} /* void us_error_cb */
 
-  /* change output buffer to line buffered mode */
-  if (setvbuf(fhout, NULL, _IOLBF, 0) != 0) {
-    ERROR("unixsock plugin: setvbuf failed: %s", STRERRNO);
-    fclose(fhin);
-    fclose(fhout);
-    pthread_exit((void *)1);
-    return (void *)0;
+static void us_handle_putval(us_conn_t *conn, char *line) {
+  cmd_error_handler_t err = {us_error_cb, conn};
+  cmd_t cmd;
+
+  if (cmd_parse(line, &cmd, NULL, &err) != CMD_OK)
+    return;
+
+  cmd_putval_t *putval = &cmd.cmd.putval;
+  size_t vl_num = putval->vl_num;
+
+  if (conn->batch_num + vl_num > US_BATCH_SIZE)
+    us_conn_dispatch(conn);
+
+  if (conn->batch_num + vl_num > conn->batch_size) {
+    size_t size = (conn->batch_size == 0) ? 16 : conn->batch_size;
+    while (size < conn->batch_num + vl_num)
+      size *= 2;
+
+    value_list_t *tmp = realloc(conn->batch, size * sizeof(*tmp));
+    if (tmp != NULL) {
+      conn->batch = tmp;
+      conn->batch_size = size;
+    }
   }
 
-  while (42) {
-    char buffer[1024];
-    char buffer_copy[1024];
-    char *fields[128];
-    int fields_num;
+  if (conn->putvals_num == conn->putvals_size) {
+    size_t size = (conn->putvals_size == 0) ? 16 : 2 * conn->putvals_size;
 
-    errno = 0;
-    if (fgets(buffer, sizeof(buffer), fhin) == NULL) {
-      if ((errno == EINTR) || (errno == EAGAIN))
-        continue;
+    size_t *tmp = realloc(conn->putvals, size * sizeof(*tmp));
+    if (tmp != NULL) {
+      conn->putvals = tmp;
+      conn->putvals_size = size;
+    }
+  }
+
+  if ((conn->batch_num + vl_num > conn->batch_size) ||
+      (conn->putvals_num == conn->putvals_size)) {
+    /* Out of memory: dispatch the values on their own, after the values
+     * received before. */
+    us_conn_dispatch(conn);
+    us_putval_reply(conn, vl_num,
+                    plugin_dispatch_values_batch(putval->vl, vl_num));
+  } else {
+    /* Move the value lists to the batch. cmd_destroy() will then only free
+     * the (now empty) array. */
+    memcpy(conn->batch + conn->batch_num, putval->vl,
+           vl_num * sizeof(*putval->vl));
+    conn->batch_num += vl_num;
+    conn->putvals[conn->putvals_num++] = vl_num;
+    putval->vl_num = 0;
+  }
+
+  cmd_destroy(&cmd);
+} /* void us_handle_putval */
+
+/* OPTION <key>=<value> [...]
+ * Sets options of this connection. */
+static void us_handle_option(us_conn_t *conn, char *line) {
+  char *command = NULL;
+  if (parse_string(&line, &command) != 0) {
+    fprintf(conn->fh, "-1 Cannot parse command.\n");
+    return;
+  }
+
+  while (*line != 0) {
+    char *key;
+    char *value;
+
+    if (parse_option(&line, &key, &value) != 0) {
+      fprintf(conn->fh, "-1 Malformed option.\n");
+      return;
+    }
+
+    if (strcasecmp("suppress_putval_responses", key) == 0) {
+      conn->suppress_putval_responses = IS_TRUE(value);
+    } else {
+      fprintf(conn->fh, "-1 Unknown option: %s\n", key);
+      return;
+    }
+  }
 
-      if (errno != 0) {
-        WARNING("unixsock plugin: failed to read from socket #%i: %s",
-                fileno(fhin), STRERRNO);
+  fprintf(conn->fh, "0 Success\n");
+} /* void us_handle_option */
+
+/* Returns true if "line" starts with the command "name". */
+static bool us_is_command(char const *line, char const *name) {
+  size_t len = strlen(name);
+
+  if (strncasecmp(line, name, len) != 0)
+    return false;
+  return (line[len] == 0) || isspace((int)line[len]);
+} /* bool us_is_command */
+
+static void us_handle_line(us_conn_t *conn, char *line) {
+  while (isspace((int)line[0]))
+    line++;
+  if (line[0] == 0)
+    return;
+
+  if (us_is_command(line, "putval")) {
+    us_handle_putval(conn, line);
+    return;
+  }
+
+  /* Other commands may depend on the values received so far. */
+  us_conn_dispatch(conn);
+
+  if (us_is_command(line, "getval")) {
+    cmd_handle_getval(conn->fh, line);
+  } else if (us_is_command(line, "getthreshold")) {
+    handle_getthreshold(conn->fh, line);
+  } else if (us_is_command(line, "listval")) {
+    cmd_handle_listval(conn->fh, line);
+  } else if (us_is_command(line, "putnotif")) {
+    handle_putnotif(conn->fh, line);
+  } else if (us_is_command(line, "flush")) {
+    cmd_handle_flush(conn->fh, line);
+  } else if (us_is_command(line, "option")) {
+    us_handle_option(conn, line);
+  } else {
+    size_t len = 0;
+    while ((line[len] != 0) && !isspace((int)line[len]))
+      len++;
+    fprintf(conn->fh, "-1 Unknown command: %.*s\n", (int)len, line);
+  }
+} /* void us_handle_line */
+
+/* Handles all complete lines in the connection's buffer and moves a trailing
+ * partial line to the beginning of the buffer. */
+static void us_conn_handle_lines(us_conn_t *conn) {
+  char *line = conn->buffer;
+  char *end = conn->buffer + conn->buffer_fill;
+
+  while (line < end) {
+    char *eol = memchr(line, '\n', end - line);
+    if (eol == NULL)
+      break;
+
+    *eol = 0;
+    if ((eol > line) && (eol[-1] == '\r'))
+      eol[-1] = 0;
+
+    us_handle_line(conn, line);
+    line = eol + 1;
+  }
+
+  conn->buffer_fill = end - line;
+  if ((conn->buffer_fill > 0) && (line != conn->buffer))
+    memmove(conn->buffer, line, conn->buffer_fill);
+} /* void us_conn_handle_lines */
+
+/* Reads from the connection, handles the received commands and sends the
+ * responses. With MSG_DONTWAIT in "flags", reads until no more data is
+ * available (up to US_READS_PER_EVENT times) and sends without blocking,
+ * otherwise reads once and sends all responses. Sets "closing" once the
+ * client has closed the connection. Returns non-zero if the connection should
+ * be closed immediately. */
+static int us_conn_read(us_conn_t *conn, int flags) {
+  int status = 0;
+
+  for (int i = 0; i < US_READS_PER_EVENT; i++) {
+    /* Leave room for terminating the last line at end of file. */
+    size_t free_size = sizeof(conn->buffer) - conn->buffer_fill - 1;
+    if (free_size == 0) {
+      fprintf(conn->fh, "-1 Line too long\n");
+      conn->closing = true;
+      break;
+    }
+
+    ssize_t len =
+        recv(conn->fd, conn->buffer + conn->buffer_fill, free_size, flags);
+    if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        break;
+      WARNING("unixsock plugin: failed to read from socket #%i: %s",
+              conn->fd, STRERRNO);
+      status = -1;
+      break;
+    } else if (len == 0) {
+      /* End of file: handle a final line without line break. */
+      if (conn->buffer_fill > 0) {
+        conn->buffer[conn->buffer_fill] = 0;
+        us_handle_line(conn, conn->buffer);
+        conn->buffer_fill = 0;
       }
+      conn->closing = true;
+      break;
+    }
+
+    conn->buffer_fill += (size_t)len;
+    us_conn_handle_lines(conn);
+
+    if (!(flags & MSG_DONTWAIT))
+      break;
+  }
+
+  us_conn_dispatch(conn);
+  if (us_conn_send(conn, flags & MSG_DONTWAIT) != 0)
+    status = -1;
+
+  return status;
+} /* int us_conn_read */
+
+#if HAVE_SYS_EPOLL_H
+/*
+ * Event-driven server
+ *
+ * The listening socket and all client connections are registered with one
+ * epoll instance, which is polled by a fixed number of worker threads. All
+ * descriptors use EPOLLONESHOT, so each connection is handled by at most one
+ * worker at a time and is re-armed once its pending input has been handled.
+ * Client connections are non-blocking; a connection with unsent responses
+ * waits for EPOLLOUT instead of EPOLLIN.
+ */
+static int us_set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)) {
+    ERROR("unixsock plugin: fcntl failed: %s", STRERRNO);
+    return -1;
+  }
+  return 0;
+} /* int us_set_nonblocking */
+
+static int us_epoll_rearm(int fd, void *ptr, int op, uint32_t events) {
+  struct epoll_event ev = {
+      .events = events | EPOLLONESHOT,
+      .data.ptr = ptr,
+  };
+
+  if (epoll_ctl(epoll_fd, op, fd, &ev) != 0) {
+    ERROR("unixsock plugin: epoll_ctl failed: %s", STRERRNO);
+    return -1;
+  }
+  return 0;
+} /* int us_epoll_rearm */
+
+static void us_conn_close(us_conn_t *conn) {
+  pthread_mutex_lock(&conns_lock);
+  if (conn->prev != NULL)
+    conn->prev->next = conn->next;
+  else
+    conns = conn->next;
+  if (conn->next != NULL)
+    conn->next->prev = conn->prev;
+  pthread_mutex_unlock(&conns_lock);
+
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+  us_conn_destroy(conn);
+} /* void us_conn_close */
+
+static void us_accept(void) {
+  while (42) {
+    int fd = accept(sock_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR)
+        continue;
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+        ERROR("unixsock plugin: accept failed: %s", STRERRNO);
       break;
     }
 
-    size_t len = strlen(buffer);
-    while ((len > 0) &&
-           ((buffer[len - 1] == '\n') || (buffer[len - 1] == '\r')))
-      buffer[--len] = '\0';
+    DEBUG("unixsock plugin: Accepted connection on fd #%i", fd);
 
-    if (len == 0)
+    if (us_set_nonblocking(fd) != 0) {
+      close(fd);
       continue;
+    }
 
-    sstrncpy(buffer_copy, buffer, sizeof(buffer_copy));
+    us_conn_t *conn = us_conn_create(fd);
+    if (conn == NULL)
+      continue;
 
-    fields_num =
-        strsplit(buffer_copy, fields, sizeof(fields) / sizeof(fields[0]));
-    if (fields_num < 1) {
-      fprintf(fhout, "-1 Internal error\n");
-      fclose(fhin);
-      fclose(fhout);
-      pthread_exit((void *)1);
-      return (void *)1;
+    pthread_mutex_lock(&conns_lock);
+    conn->next = conns;
+    if (conns != NULL)
+      conns->prev = conn;
+    conns = conn;
+    pthread_mutex_unlock(&conns_lock);
+
+    if (us_epoll_rearm(fd, conn, EPOLL_CTL_ADD, EPOLLIN) != 0)
+      us_conn_close(conn);
+  }
+
+  us_epoll_rearm(sock_fd, &sock_fd, EPOLL_CTL_MOD, EPOLLIN);
+} /* void us_accept */
+
+/* Handles an event on a client connection. Returns non-zero if the
+ * connection should be closed. */
+static int us_conn_handle_event(us_conn_t *conn) {
+  int status;
+
+  if (us_conn_pending(conn))
+    status = us_conn_send(conn, MSG_DONTWAIT);
+  else
+    status = us_conn_read(conn, MSG_DONTWAIT);
+  if (status != 0)
+    return status;
+
+  if (us_conn_pending(conn))
+    return us_epoll_rearm(conn->fd, conn, EPOLL_CTL_MOD, EPOLLOUT);
+  if (conn->closing)
+    return -1;
+  return us_epoll_rearm(conn->fd, conn, EPOLL_CTL_MOD, EPOLLIN);
+} /* int us_conn_handle_event */
+
+static void *us_worker_thread(void __attribute__((unused)) * arg) {
+  while (loop != 0) {
+    struct epoll_event ev;
+
+    int status = epoll_wait(epoll_fd, &ev, 1, -1);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      ERROR("unixsock plugin: epoll_wait failed: %s", STRERRNO);
+      break;
+    } else if (status == 0) {
+      continue;
     }
 
-    if (strcasecmp(fields[0], "getval") == 0) {
-      cmd_handle_getval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "getthreshold") == 0) {
-      handle_getthreshold(fhout, buffer);
-    } else if (strcasecmp(fields[0], "putval") == 0) {
-      cmd_handle_putval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "listval") == 0) {
-      cmd_handle_listval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "putnotif") == 0) {
-      handle_putnotif(fhout, buffer);
-    } else if (strcasecmp(fields[0], "flush") == 0) {
-      cmd_handle_flush(fhout, buffer);
-    } else {
-      if (fprintf(fhout, "-1 Unknown command: %s\n", fields[0]) < 0) {
-        WARNING("unixsock plugin: failed to write to socket #%i: %s",
-                fileno(fhout), STRERRNO);
-        break;
-      }
+    if (ev.data.ptr == &wakeup_fd[0]) {
+      /* Shutting down. The pipe stays readable and wakes all workers. */
+      break;
+    } else if (ev.data.ptr == &sock_fd) {
+      us_accept();
+      continue;
+    }
+
+    us_conn_t *conn = ev.data.ptr;
+    if (us_conn_handle_event(conn) != 0) {
+      DEBUG("unixsock plugin: Closing connection on fd #%i", conn->fd);
+      us_conn_close(conn);
+    }
+  }
+
+  return (void *)0;
+} /* void *us_worker_thread */
+
+static int us_server_start(void) {
+  if (us_open_socket() != 0)
+    return -1;
+
+  if (us_set_nonblocking(sock_fd) != 0)
+    return -1;
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    ERROR("unixsock plugin: epoll_create1 failed: %s", STRERRNO);
+    return -1;
+  }
+
+  if (pipe(wakeup_fd) != 0) {
+    ERROR("unixsock plugin: pipe failed: %s", STRERRNO);
+    return -1;
+  }
+
+  struct epoll_event ev = {
+      .events = EPOLLIN,
+      .data.ptr = &wakeup_fd[0],
+  };
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd[0], &ev) != 0) {
+    ERROR("unixsock plugin: epoll_ctl failed: %s", STRERRNO);
+    return -1;
+  }
+
+  if (us_epoll_rearm(sock_fd, &sock_fd, EPOLL_CTL_ADD, EPOLLIN) != 0)
+    return -1;
+
+  workers = calloc(workers_num, sizeof(*workers));
+  if (workers == NULL) {
+    ERROR("unixsock plugin: calloc failed.");
+    return -1;
+  }
+
+  for (size_t i = 0; i < workers_num; i++) {
+    int status = plugin_thread_create(&workers[i], us_worker_thread, NULL,
+                                      "unixsock worker");
+    if (status != 0) {
+      ERROR("unixsock plugin: pthread_create failed: %s", STRERROR(status));
+      break;
     }
-  } /* while (fgets) */
+    workers_started++;
+  }
+
+  return (workers_started > 0) ? 0 : -1;
+} /* int us_server_start */
+
+static void us_server_stop(void) {
+  if (wakeup_fd[1] >= 0) {
+    char c = 0;
+    if (write(wakeup_fd[1], &c, sizeof(c)) < 0)
+      ERROR("unixsock plugin: write failed: %s", STRERRNO);
+  }
+
+  for (size_t i = 0; i < workers_started; i++)
+    pthread_join(workers[i], NULL);
+  sfree(workers);
+  workers_started = 0;
+
+  /* All workers have exited, so the remaining connections are idle. */
+  while (conns != NULL)
+    us_conn_close(conns);
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(wakeup_fd); i++) {
+    if (wakeup_fd[i] >= 0)
+      close(wakeup_fd[i]);
+    wakeup_fd[i] = -1;
+  }
+  if (epoll_fd >= 0)
+    close(epoll_fd);
+  epoll_fd = -1;
+} /* void us_server_stop */
+
+#else /* !HAVE_SYS_EPOLL_H */
+/*
+ * Thread-per-connection server, used where epoll is not available.
+ */
+static void *us_handle_client(void *arg) {
+  us_conn_t *conn = arg;
+
+  DEBUG("unixsock plugin: us_handle_client: Reading from fd #%i", conn->fd);
+
+  while ((us_conn_read(conn, /* flags = */ 0) == 0) && !conn->closing)
+    /* continue */;
 
   DEBUG("unixsock plugin: us_handle_client: Exiting..");
-  fclose(fhin);
-  fclose(fhout);
+  us_conn_destroy(conn);
 
   pthread_exit((void *)0);
   return (void *)0;
@@ -272,12 +786,8 @@ static void *us_handle_client(void *arg) {
 
 static void *us_server_thread(void __attribute__((unused)) * arg) {
   int status;
-  int *remote_fd;
   pthread_t th;
 
-  if (us_open_socket() != 0)
-    pthread_exit((void *)1);
-
   while (loop != 0) {
     DEBUG("unixsock plugin: Calling accept..");
     status = accept(sock_fd, NULL, NULL);
@@ -292,39 +802,47 @@ static void *us_server_thread(void __attribute__((unused)) * arg) {
       pthread_exit((void *)1);
     }
 
-    remote_fd = malloc(sizeof(*remote_fd));
-    if (remote_fd == NULL) {
-      WARNING("unixsock plugin: malloc failed: %s", STRERRNO);
-      close(status);
+    us_conn_t *conn = us_conn_create(status);
+    if (conn == NULL)
       continue;
-    }
-    *remote_fd = status;
 
-    DEBUG("Spawning child to handle connection on fd #%i", *remote_fd);
+    DEBUG("Spawning child to handle connection on fd #%i", conn->fd);
 
-    status = plugin_thread_create(&th, us_handle_client, (void *)remote_fd,
-                                  "unixsock conn");
+    status = plugin_thread_create(&th, us_handle_client, conn, "unixsock conn");
     if (status == 0) {
       pthread_detach(th);
     } else {
       WARNING("unixsock plugin: pthread_create failed: %s", STRERRNO);
-      close(*remote_fd);
-      free(remote_fd);
+      us_conn_destroy(conn);
       continue;
     }
   } /* while (loop) */
 
-  close(sock_fd);
-  sock_fd = -1;
+  return (void *)0;
+} /* void *us_server_thread */
+
+static int us_server_start(void) {
+  if (us_open_socket() != 0)
+    return -1;
 
-  status = unlink((sock_file != NULL) ? sock_file : US_DEFAULT_PATH);
+  int status = plugin_thread_create(&listen_thread, us_server_thread, NULL,
+                                    "unixsock listen");
   if (status != 0) {
-    NOTICE("unixsock plugin: unlink (%s) failed: %s",
-           (sock_file != NULL) ? sock_file : US_DEFAULT_PATH, STRERRNO);
+    ERROR("unixsock plugin: pthread_create failed: %s", STRERRNO);
+    return -1;
   }
 
-  return (void *)0;
-} /* void *us_server_thread */
+  return 0;
+} /* int us_server_start */
+
+static void us_server_stop(void) {
+  if (listen_thread != (pthread_t)0) {
+    pthread_kill(listen_thread, SIGTERM);
+    pthread_join(listen_thread, NULL);
+    listen_thread = (pthread_t)0;
+  }
+} /* void us_server_stop */
+#endif /* HAVE_SYS_EPOLL_H */
 
 static int us_config(const char *key, const char *val) {
   if (strcasecmp(key, "SocketFile") == 0) {
@@ -348,6 +866,13 @@ static int us_config(const char *key, const char *val) {
       delete_socket = true;
     else
       delete_socket = false;
+  } else if (strcasecmp(key, "WorkerThreads") == 0) {
+    int num = atoi(val);
+    if (num < 1) {
+      ERROR("unixsock plugin: WorkerThreads must be a positive integer.");
+      return 1;
+    }
+    workers_num = (size_t)num;
   } else {
     return -1;
   }
@@ -358,8 +883,6 @@ static int us_config(const char *key, const char *val) {
 static int us_init(void) {
   static int have_init;
 
-  int status;
-
   /* Initialize only once. */
   if (have_init != 0)
     return 0;
@@ -367,10 +890,8 @@ static int us_init(void) {
 
   loop = 1;
 
-  status = plugin_thread_create(&listen_thread, us_server_thread, NULL,
-                                "unixsock listen");
-  if (status != 0) {
-    ERROR("unixsock plugin: pthread_create failed: %s", STRERRNO);
+  if (us_server_start() != 0) {
+    us_server_stop();
     return -1;
   }
 
@@ -378,14 +899,17 @@ static int us_init(void) {
 } /* int us_init */
 
 static int us_shutdown(void) {
-  void *ret;
-
   loop = 0;
 
-  if (listen_thread != (pthread_t)0) {
-    pthread_kill(listen_thread, SIGTERM);
-    pthread_join(listen_thread, &ret);
-    listen_thread = (pthread_t)0;
+  us_server_stop();
+
+  if (sock_fd >= 0) {
+    close(sock_fd);
+    sock_fd = -1;
+
+    char const *path = (sock_file != NULL) ? sock_file : US_DEFAULT_PATH;
+    if (unlink(path) != 0)
+      NOTICE("unixsock plugin: unlink (%s) failed: %s", path, STRERRNO);
   }
 
   plugin_unregister_init("unixsock");
@@ -0,0 +1,171 @@
+/**
+ * collectd - src/unixsock_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#define plugin_dispatch_values_batch plugin_dispatch_values_batch_us_test
+
+#include "testing.h"
+#include "unixsock.c" /* sic */
+#include "utils/avltree/avltree.h"
+#include "utils_threshold.h"
+
+static size_t dispatched_num;
+static size_t batches_num;
+
+/* mock functions */
+int plugin_dispatch_values_batch_us_test(value_list_t const *vl,
+                                         size_t vl_num) {
+  dispatched_num += vl_num;
+  batches_num++;
+  return 0;
+}
+
+int ut_search_threshold(__attribute__((unused)) const value_list_t *vl,
+                        __attribute__((unused)) threshold_t *ret_threshold) {
+  return ENOENT;
+}
+/* end mock functions */
+
+/* Sends "input" over a socket pair, handles it with us_conn_read() and
+ * returns the responses in "output". */
+static int roundtrip(us_conn_t **conn, int *peer, char const *input,
+                     char *output, size_t output_size) {
+  if (*conn == NULL) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+      return -1;
+    *conn = us_conn_create(fds[0]);
+    *peer = fds[1];
+    if (*conn == NULL)
+      return -1;
+  }
+
+  size_t input_len = strlen(input);
+  if (write(*peer, input, input_len) != (ssize_t)input_len)
+    return -1;
+
+  if (us_conn_read(*conn, /* flags = */ 0) != 0)
+    return -1;
+
+  ssize_t len = recv(*peer, output, output_size - 1, MSG_DONTWAIT);
+  if (len < 0)
+    return -1;
+  output[len] = 0;
+  return 0;
+}
+
+DEF_TEST(pipelined_error) {
+  us_conn_t *conn = NULL;
+  int peer = -1;
+  char output[4096];
+
+  dispatched_num = 0;
+  batches_num = 0;
+
+  /* The malformed command is answered after the first PUTVAL, although the
+   * values of both valid PUTVALs are only dispatched at the end. */
+  CHECK_ZERO(roundtrip(&conn, &peer,
+                       "PUTVAL example.com/test/MAGIC N:1\n"
+                       "PUTVAL example.com/test/MAGIC\n"
+                       "PUTVAL example.com/test/MAGIC N:2\n"
+                       "PUTVAL example.com/test/MAGIC N:3\n",
+                       output, sizeof(output)));
+
+  char *lines[4] = {NULL};
+  size_t lines_num = 0;
+  char *saveptr = NULL;
+  for (char *line = strtok_r(output, "\n", &saveptr);
+       (line != NULL) && (lines_num < STATIC_ARRAY_SIZE(lines));
+       line = strtok_r(NULL, "\n", &saveptr))
+    lines[lines_num++] = line;
+
+  EXPECT_EQ_UINT64(4, lines_num);
+  EXPECT_EQ_STR("0 Success: 1 value has been dispatched.", lines[0]);
+  OK(strncmp("-1 ", lines[1], strlen("-1 ")) == 0);
+  EXPECT_EQ_STR("0 Success: 1 value has been dispatched.", lines[2]);
+  EXPECT_EQ_STR("0 Success: 1 value has been dispatched.", lines[3]);
+
+  EXPECT_EQ_UINT64(3, dispatched_num);
+  EXPECT_EQ_UINT64(2, batches_num);
+
+  us_conn_destroy(conn);
+  close(peer);
+  return 0;
+}
+
+DEF_TEST(suppress_putval_responses) {
+  us_conn_t *conn = NULL;
+  int peer = -1;
+  char output[4096];
+
+  CHECK_ZERO(roundtrip(&conn, &peer, "OPTION foo=bar\n", output,
+                       sizeof(output)));
+  EXPECT_EQ_STR("-1 Unknown option: foo\n", output);
+
+  CHECK_ZERO(roundtrip(&conn, &peer,
+                       "OPTION suppress_putval_responses=true\n", output,
+                       sizeof(output)));
+  EXPECT_EQ_STR("0 Success\n", output);
+
+  /* Only errors are reported. */
+  CHECK_ZERO(roundtrip(&conn, &peer,
+                       "PUTVAL example.com/test/MAGIC N:1\n"
+                       "PUTVAL example.com/test/MAGIC N:x\n"
+                       "PUTVAL example.com/test/MAGIC N:2\n"
+                       "GETVAL example.com/test/MAGIC\n",
+                       output, sizeof(output)));
+  OK(strncmp("-1 ", output, strlen("-1 ")) == 0);
+  /* The GETVAL is answered with an error, because the cache is mocked. */
+  OK(strchr(output, '\n') != NULL);
+  OK(strncmp("-1 ", strchr(output, '\n') + 1, strlen("-1 ")) == 0);
+
+  /* Other connections are not affected. */
+  us_conn_t *other = NULL;
+  int other_peer = -1;
+  CHECK_ZERO(roundtrip(&other, &other_peer,
+                       "PUTVAL example.com/test/MAGIC N:1\n", output,
+                       sizeof(output)));
+  EXPECT_EQ_STR("0 Success: 1 value has been dispatched.\n", output);
+
+  CHECK_ZERO(roundtrip(&conn, &peer,
+                       "OPTION suppress_putval_responses=false\n"
+                       "PUTVAL example.com/test/MAGIC N:3\n",
+                       output, sizeof(output)));
+  EXPECT_EQ_STR("0 Success\n0 Success: 1 value has been dispatched.\n",
+                output);
+
+  us_conn_destroy(other);
+  close(other_peer);
+  us_conn_destroy(conn);
+  close(peer);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(pipelined_error);
+  RUN_TEST(suppress_putval_responses);
+
+  END_TEST;
+}
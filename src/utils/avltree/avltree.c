@@ -639,6 +639,40 @@ int c_avl_iterator_prev(c_avl_iterator_t *iter, void **key, void **value) {
   return 0;
 } /* int c_avl_iterator_prev */
 
+int c_avl_iterator_seek(c_avl_iterator_t *iter, const void *key) {
+  if ((iter == NULL) || (key == NULL))
+    return -1;
+
+  /* Find the smallest node not smaller than key. */
+  c_avl_node_t *lower_bound = NULL;
+  c_avl_node_t *n = iter->tree->root;
+  while (n != NULL) {
+    int cmp = iter->tree->compare(key, n->key);
+    if (cmp == 0) {
+      lower_bound = n;
+      break;
+    } else if (cmp < 0) {
+      lower_bound = n;
+      n = n->left;
+    } else {
+      n = n->right;
+    }
+  }
+
+  /* c_avl_iterator_next() returns the node following iter->node, or the
+   * first node if iter->node is NULL. */
+  if (lower_bound != NULL) {
+    iter->node = c_avl_node_prev(lower_bound);
+  } else {
+    for (n = iter->tree->root; n != NULL; n = n->right)
+      if (n->right == NULL)
+        break;
+    iter->node = n;
+  }
+
+  return 0;
+} /* int c_avl_iterator_seek */
+
 void c_avl_iterator_destroy(c_avl_iterator_t *iter) { free(iter); }
 
 int c_avl_size(c_avl_tree_t *t) {
@@ -151,6 +151,25 @@ int c_avl_iterator_next(c_avl_iterator_t *iter, void **key, void **value);
 int c_avl_iterator_prev(c_avl_iterator_t *iter, void **key, void **value);
 void c_avl_iterator_destroy(c_avl_iterator_t *iter);
 
+/*
+ * NAME
+ *   c_avl_iterator_seek
+ *
+ * DESCRIPTION
+ *   Positions the iterator so that the next call to `c_avl_iterator_next'
+ *   returns the smallest key that is greater than or equal to `key'. This
+ *   allows to iterate over a range of keys, e.g. all strings with a given
+ *   prefix, without visiting the keys before it.
+ *
+ * PARAMETERS
+ *   `iter'     Iterator to position.
+ *   `key'      Key to seek to. It does not need to be stored in the tree.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if `iter' or `key' is NULL.
+ */
+int c_avl_iterator_seek(c_avl_iterator_t *iter, const void *key);
+
 /*
  * NAME
  *   c_avl_size
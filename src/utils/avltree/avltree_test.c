@@ -133,6 +133,35 @@ DEF_TEST(success) {
     EXPECT_EQ_INT(i, STATIC_ARRAY_SIZE(cases));
   }
 
+  /* seek */
+  for (size_t i = 0; i <= STATIC_ARRAY_SIZE(cases); i++) {
+    c_avl_iterator_t *iter = c_avl_get_iterator(t);
+    char *key;
+    char *value;
+
+    /* Seek to an existing key and to the position right before it. */
+    char seek_key[16] = "\x7f";
+    if (i < STATIC_ARRAY_SIZE(cases))
+      snprintf(seek_key, sizeof(seek_key), "%s", sorted_cases[i].key);
+
+    CHECK_ZERO(c_avl_iterator_seek(iter, seek_key));
+    for (size_t j = i; j < STATIC_ARRAY_SIZE(cases); j++) {
+      CHECK_ZERO(c_avl_iterator_next(iter, (void **)&key, (void **)&value));
+      EXPECT_EQ_STR(sorted_cases[j].key, key);
+    }
+    EXPECT_EQ_INT(-1,
+                  c_avl_iterator_next(iter, (void **)&key, (void **)&value));
+
+    if (i < STATIC_ARRAY_SIZE(cases)) {
+      seek_key[strlen(seek_key) - 1]--;
+      CHECK_ZERO(c_avl_iterator_seek(iter, seek_key));
+      CHECK_ZERO(c_avl_iterator_next(iter, (void **)&key, (void **)&value));
+      EXPECT_EQ_STR(sorted_cases[i].key, key);
+    }
+
+    c_avl_iterator_destroy(iter);
+  }
+
   /* remove half */
   for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases) / 2; i++) {
     char *key = NULL;
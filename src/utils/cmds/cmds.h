@@ -30,6 +30,7 @@
 #include "plugin.h"
 
 #include <stdarg.h>
+#include <string.h>
 
 typedef enum {
   CMD_UNKNOWN = 0,
@@ -59,8 +60,20 @@ typedef struct {
 typedef struct {
   char *raw_identifier;
   identifier_t identifier;
+
+  /* Set if more than one identifier, or an identifier containing shell
+   * wildcards, was given. Identifiers are in their canonical form, patterns
+   * as provided by the user. */
+  char **names;
+  size_t names_num;
 } cmd_getval_t;
 
+typedef struct {
+  /* Optional shell wildcard pattern (see fnmatch(3)) the identifiers have to
+   * match. */
+  char *pattern;
+} cmd_listval_t;
+
 typedef struct {
   /* The raw identifier as provided by the user. */
   char *raw_identifier;
@@ -83,10 +96,15 @@ typedef struct {
   union {
     cmd_flush_t flush;
     cmd_getval_t getval;
+    cmd_listval_t listval;
     cmd_putval_t putval;
   } cmd;
 } cmd_t;
 
+/* CMD_IS_PATTERN returns true if the identifier "s" contains shell wildcard
+ * characters. */
+#define CMD_IS_PATTERN(s) (strpbrk((s), "*?[") != NULL)
+
 /*
  * NAME
  *   cmd_options_t
@@ -130,6 +130,18 @@ static struct {
         CMD_OK,
         CMD_GETVAL,
     },
+    {
+        "GETVAL myhost/magic/MAGIC myhost/magic/MAGIC-2",
+        NULL,
+        CMD_OK,
+        CMD_GETVAL,
+    },
+    {
+        "GETVAL myhost/*/MAGIC",
+        NULL,
+        CMD_OK,
+        CMD_GETVAL,
+    },
 
     /* Invalid GETVAL commands. */
     {
@@ -150,6 +162,12 @@ static struct {
         CMD_PARSE_ERROR,
         CMD_UNKNOWN,
     },
+    {
+        "GETVAL myhost/magic/MAGIC invalid",
+        NULL,
+        CMD_PARSE_ERROR,
+        CMD_UNKNOWN,
+    },
 
     /* Valid LISTVAL commands. */
     {
@@ -158,6 +176,12 @@ static struct {
         CMD_OK,
         CMD_LISTVAL,
     },
+    {
+        "LISTVAL pattern=myhost/cpu-*/*",
+        NULL,
+        CMD_OK,
+        CMD_LISTVAL,
+    },
 
     /* Invalid LISTVAL commands. */
     {
@@ -166,6 +190,12 @@ static struct {
         CMD_PARSE_ERROR,
         CMD_UNKNOWN,
     },
+    {
+        "LISTVAL invalid=option",
+        NULL,
+        CMD_PARSE_ERROR,
+        CMD_UNKNOWN,
+    },
 
     /* Valid PUTVAL commands. */
     {
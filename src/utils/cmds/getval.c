@@ -31,8 +31,57 @@
 
 #include "utils/cmds/getval.h"
 #include "utils/cmds/parse_option.h"
+#include "utils/strbuf/strbuf.h"
 #include "utils_cache.h"
 
+#include <fnmatch.h>
+
+/* Number of cache entries visited while holding the cache lock. */
+#define GETVAL_BATCH_SIZE 1024
+
+/* Adds "name", the canonical form of the identifier or a pattern, to the
+ * names of a multi-identifier GETVAL. */
+static cmd_status_t getval_add_name(cmd_getval_t *getval, char const *arg,
+                                    const cmd_options_t *opts,
+                                    cmd_error_handler_t *err) {
+  char name[6 * DATA_MAX_NAME_LEN];
+
+  if (CMD_IS_PATTERN(arg)) {
+    sstrncpy(name, arg, sizeof(name));
+  } else {
+    char *host, *plugin, *plugin_instance, *type, *type_instance;
+    char *copy = sstrdup(arg);
+    int status =
+        parse_identifier(copy, &host, &plugin, &plugin_instance, &type,
+                         &type_instance, opts->identifier_default_host);
+    if (status == 0)
+      status = format_name(name, sizeof(name), host, plugin, plugin_instance,
+                           type, type_instance);
+    sfree(copy);
+    if (status != 0) {
+      cmd_error(CMD_PARSE_ERROR, err, "Cannot parse identifier `%s'.", arg);
+      return CMD_PARSE_ERROR;
+    }
+  }
+
+  char **tmp =
+      realloc(getval->names, (getval->names_num + 1) * sizeof(*getval->names));
+  if (tmp == NULL) {
+    cmd_error(CMD_ERROR, err, "realloc failed.");
+    return CMD_ERROR;
+  }
+  getval->names = tmp;
+
+  getval->names[getval->names_num] = sstrdup(name);
+  if (getval->names[getval->names_num] == NULL) {
+    cmd_error(CMD_ERROR, err, "strdup failed.");
+    return CMD_ERROR;
+  }
+  getval->names_num++;
+
+  return CMD_OK;
+} /* cmd_status_t getval_add_name */
+
 cmd_status_t cmd_parse_getval(size_t argc, char **argv,
                               cmd_getval_t *ret_getval,
                               const cmd_options_t *opts,
@@ -46,15 +95,24 @@ cmd_status_t cmd_parse_getval(size_t argc, char **argv,
     return CMD_ERROR;
   }
 
-  if (argc != 1) {
-    if (argc == 0)
-      cmd_error(CMD_PARSE_ERROR, err, "Missing identifier.");
-    else
-      cmd_error(CMD_PARSE_ERROR, err, "Garbage after identifier: `%s'.",
-                argv[1]);
+  if (argc == 0) {
+    cmd_error(CMD_PARSE_ERROR, err, "Missing identifier.");
     return CMD_PARSE_ERROR;
   }
 
+  /* Several identifiers or patterns: the values of all matching value lists
+   * are returned. */
+  if ((argc > 1) || CMD_IS_PATTERN(argv[0])) {
+    for (size_t i = 0; i < argc; i++) {
+      cmd_status_t ret = getval_add_name(ret_getval, argv[i], opts, err);
+      if (ret != CMD_OK) {
+        cmd_destroy_getval(ret_getval);
+        return ret;
+      }
+    }
+    return CMD_OK;
+  }
+
   /* parse_identifier() modifies its first argument,
    * returning pointers into it */
   identifier_copy = sstrdup(argv[0]);
@@ -75,6 +133,128 @@ cmd_status_t cmd_parse_getval(size_t argc, char **argv,
   return CMD_OK;
 } /* cmd_status_t cmd_parse_getval */
 
+/* Appends "<name> <ds>=<value> ..." for one value list to "buf". */
+static int getval_print(strbuf_t *buf, char const *name, gauge_t *values,
+                        size_t values_num) {
+  char const *type = strrchr(name, '/');
+  if (type == NULL)
+    return EINVAL;
+  type++;
+
+  char type_name[DATA_MAX_NAME_LEN];
+  sstrncpy(type_name, type, sizeof(type_name));
+  char *type_instance = strchr(type_name, '-');
+  if (type_instance != NULL)
+    *type_instance = 0;
+
+  data_set_t const *ds = plugin_get_ds(type_name);
+  if ((ds == NULL) || (ds->ds_num != values_num))
+    return EINVAL;
+
+  int status = strbuf_print(buf, name);
+  for (size_t i = 0; (status == 0) && (i < values_num); i++) {
+    status = strbuf_printf(buf, " %s=", ds->ds[i].name);
+    if (status == 0)
+      status = isnan(values[i]) ? strbuf_print(buf, "NaN")
+                                : strbuf_printf(buf, "%e", values[i]);
+  }
+  if (status == 0)
+    status = strbuf_print(buf, "\n");
+
+  return status;
+} /* int getval_print */
+
+typedef struct {
+  char const *pattern;
+  strbuf_t *buf;
+  size_t number;
+} getval_ctx_t;
+
+static int getval_callback(uc_iter_t *iter, char const *name,
+                           void *user_data) {
+  getval_ctx_t *ctx = user_data;
+  gauge_t *values = NULL;
+  size_t values_num = 0;
+
+  if (fnmatch(ctx->pattern, name, 0) != 0)
+    return 0;
+  if (uc_iterator_get_rates(iter, &values, &values_num) != 0)
+    return ENOMEM;
+
+  size_t pos = ctx->buf->pos;
+  int status = getval_print(ctx->buf, name, values, values_num);
+  sfree(values);
+  if (status == ENOMEM)
+    return status;
+  if (status != 0) {
+    strbuf_truncate(ctx->buf, pos);
+    return 0;
+  }
+
+  ctx->number++;
+  return 0;
+} /* int getval_callback */
+
+/* Handles a GETVAL command with several identifiers or patterns. */
+static cmd_status_t getval_handle_names(FILE *fh, cmd_getval_t *getval,
+                                        cmd_error_handler_t *err) {
+  getval_ctx_t ctx = {
+      .buf = STRBUF_CREATE,
+  };
+
+  int status = 0;
+  for (size_t i = 0; (status == 0) && (i < getval->names_num); i++) {
+    char const *name = getval->names[i];
+
+    if (!CMD_IS_PATTERN(name)) {
+      gauge_t *values = NULL;
+      size_t values_num = 0;
+
+      if (uc_get_rate_by_name(name, &values, &values_num) != 0)
+        continue;
+
+      size_t pos = ctx.buf->pos;
+      status = getval_print(ctx.buf, name, values, values_num);
+      sfree(values);
+      if (status == 0)
+        ctx.number++;
+      else if (status != ENOMEM) {
+        strbuf_truncate(ctx.buf, pos);
+        status = 0;
+      }
+      continue;
+    }
+
+    /* Only the part of the cache sharing the pattern's literal prefix is
+     * visited, holding the cache lock for GETVAL_BATCH_SIZE entries at a
+     * time. */
+    char *prefix = sstrndup(name, strcspn(name, "*?[\\"));
+    ctx.pattern = name;
+    status = uc_iterate(prefix, GETVAL_BATCH_SIZE, getval_callback, &ctx);
+    sfree(prefix);
+  }
+
+  if (status != 0) {
+    cmd_error(CMD_ERROR, err, "Error reading values from cache.");
+    STRBUF_DESTROY(ctx.buf);
+    return CMD_ERROR;
+  }
+
+  cmd_status_t ret = CMD_OK;
+  if ((fprintf(fh, "%" PRIsz " Value%s found\n", ctx.number,
+               (ctx.number == 1) ? "" : "s") < 0) ||
+      ((ctx.buf->pos > 0) &&
+       (fwrite(ctx.buf->ptr, 1, ctx.buf->pos, fh) != ctx.buf->pos)) ||
+      (fflush(fh) != 0)) {
+    WARNING("cmd_handle_getval: failed to write to socket #%i: %s",
+            fileno(fh), STRERRNO);
+    ret = CMD_ERROR;
+  }
+
+  STRBUF_DESTROY(ctx.buf);
+  return ret;
+} /* cmd_status_t getval_handle_names */
+
 #define print_to_socket(fh, ...)                                               \
   do {                                                                         \
     if (fprintf(fh, __VA_ARGS__) < 0) {                                        \
@@ -82,7 +262,6 @@ cmd_status_t cmd_parse_getval(size_t argc, char **argv,
               fileno(fh), STRERRNO);                                           \
       return -1;                                                               \
     }                                                                          \
-    fflush(fh);                                                                \
   } while (0)
 
 cmd_status_t cmd_handle_getval(FILE *fh, char *buffer) {
@@ -110,6 +289,12 @@ cmd_status_t cmd_handle_getval(FILE *fh, char *buffer) {
     return CMD_UNKNOWN_COMMAND;
   }
 
+  if (cmd.cmd.getval.names_num > 0) {
+    status = getval_handle_names(fh, &cmd.cmd.getval, &err);
+    cmd_destroy(&cmd);
+    return status;
+  }
+
   ds = plugin_get_ds(cmd.cmd.getval.identifier.type);
   if (ds == NULL) {
     DEBUG("cmd_handle_getval: plugin_get_ds (%s) == NULL;",
@@ -150,6 +335,7 @@ cmd_status_t cmd_handle_getval(FILE *fh, char *buffer) {
       print_to_socket(fh, "%12e\n", values[i]);
     }
   }
+  fflush(fh);
 
   sfree(values);
   cmd_destroy(&cmd);
@@ -162,4 +348,9 @@ void cmd_destroy_getval(cmd_getval_t *getval) {
     return;
 
   sfree(getval->raw_identifier);
+
+  for (size_t i = 0; i < getval->names_num; i++)
+    sfree(getval->names[i]);
+  sfree(getval->names);
+  getval->names_num = 0;
 } /* void cmd_destroy_getval */
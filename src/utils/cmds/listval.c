@@ -31,51 +31,77 @@
 
 #include "utils/cmds/listval.h"
 #include "utils/cmds/parse_option.h"
+#include "utils/strbuf/strbuf.h"
 #include "utils_cache.h"
 
+#include <fnmatch.h>
+
+/* Number of cache entries visited while holding the cache lock. */
+#define LISTVAL_BATCH_SIZE 1024
+
 cmd_status_t cmd_parse_listval(size_t argc, char **argv,
+                               cmd_listval_t *ret_listval,
                                const cmd_options_t *opts
                                __attribute__((unused)),
                                cmd_error_handler_t *err) {
-  if (argc != 0) {
-    cmd_error(CMD_PARSE_ERROR, err, "Garbage after end of command: `%s'.",
-              argv[0]);
-    return CMD_PARSE_ERROR;
+  for (size_t i = 0; i < argc; i++) {
+    char *key = NULL;
+    char *value = NULL;
+
+    cmd_status_t status = cmd_parse_option(argv[i], &key, &value, err);
+    if (status != CMD_OK) {
+      if (status == CMD_NO_OPTION)
+        cmd_error(CMD_PARSE_ERROR, err, "Garbage after end of command: `%s'.",
+                  argv[i]);
+      cmd_destroy_listval(ret_listval);
+      return CMD_PARSE_ERROR;
+    }
+
+    if (strcasecmp("pattern", key) == 0) {
+      sfree(ret_listval->pattern);
+      ret_listval->pattern = sstrdup(value);
+    } else {
+      cmd_error(CMD_PARSE_ERROR, err, "Cannot parse option `%s'.", key);
+      cmd_destroy_listval(ret_listval);
+      return CMD_PARSE_ERROR;
+    }
   }
 
   return CMD_OK;
 } /* cmd_status_t cmd_parse_listval */
 
-#define free_everything_and_return(status)                                     \
-  do {                                                                         \
-    for (size_t j = 0; j < number; j++) {                                      \
-      sfree(names[j]);                                                         \
-      names[j] = NULL;                                                         \
-    }                                                                          \
-    sfree(names);                                                              \
-    sfree(times);                                                              \
-    return status;                                                             \
-  } while (0)
-
-#define print_to_socket(fh, ...)                                               \
-  do {                                                                         \
-    if (fprintf(fh, __VA_ARGS__) < 0) {                                        \
-      WARNING("handle_listval: failed to write to socket #%i: %s", fileno(fh), \
-              STRERRNO);                                                       \
-      free_everything_and_return(CMD_ERROR);                                   \
-    }                                                                          \
-    fflush(fh);                                                                \
-  } while (0)
+typedef struct {
+  char const *pattern;
+  strbuf_t *buf;
+  size_t number;
+} listval_ctx_t;
+
+static int listval_callback(uc_iter_t *iter, char const *name,
+                            void *user_data) {
+  listval_ctx_t *ctx = user_data;
+  cdtime_t t = 0;
+
+  if ((ctx->pattern != NULL) && (fnmatch(ctx->pattern, name, 0) != 0))
+    return 0;
+
+  uc_iterator_get_time(iter, &t);
+
+  int status = strbuf_print_fixed(ctx->buf, CDTIME_T_TO_DOUBLE(t), 3);
+  status = status || strbuf_print(ctx->buf, " ");
+  status = status || strbuf_print(ctx->buf, name);
+  status = status || strbuf_print(ctx->buf, "\n");
+  if (status != 0)
+    return ENOMEM;
+
+  ctx->number++;
+  return 0;
+} /* int listval_callback */
 
 cmd_status_t cmd_handle_listval(FILE *fh, char *buffer) {
   cmd_error_handler_t err = {cmd_error_fh, fh};
   cmd_status_t status;
   cmd_t cmd;
 
-  char **names = NULL;
-  cdtime_t *times = NULL;
-  size_t number = 0;
-
   DEBUG("utils_cmd_listval: handle_listval (fh = %p, buffer = %s);", (void *)fh,
         buffer);
 
@@ -84,20 +110,51 @@ cmd_status_t cmd_handle_listval(FILE *fh, char *buffer) {
   if (cmd.type != CMD_LISTVAL) {
     cmd_error(CMD_UNKNOWN_COMMAND, &err, "Unexpected command: `%s'.",
               CMD_TO_STRING(cmd.type));
-    free_everything_and_return(CMD_UNKNOWN_COMMAND);
+    cmd_destroy(&cmd);
+    return CMD_UNKNOWN_COMMAND;
   }
 
-  status = uc_get_names(&names, &times, &number);
-  if (status != 0) {
-    DEBUG("command listval: uc_get_names failed with status %i", status);
-    cmd_error(CMD_ERROR, &err, "uc_get_names failed.");
-    free_everything_and_return(CMD_ERROR);
+  /* The response starts with the number of identifiers, so the list is
+   * formatted into a buffer first. The cache is walked in batches, holding
+   * the cache lock only for LISTVAL_BATCH_SIZE entries at a time. Only the
+   * part of the cache sharing the pattern's literal prefix is visited. */
+  listval_ctx_t ctx = {
+      .pattern = cmd.cmd.listval.pattern,
+      .buf = STRBUF_CREATE,
+  };
+  char *prefix = NULL;
+  if (ctx.pattern != NULL)
+    prefix = sstrndup(ctx.pattern, strcspn(ctx.pattern, "*?[\\"));
+
+  int ret = uc_iterate(prefix, LISTVAL_BATCH_SIZE, listval_callback, &ctx);
+  sfree(prefix);
+  if (ret != 0) {
+    DEBUG("command listval: uc_iterate failed with status %i", ret);
+    cmd_error(CMD_ERROR, &err, "uc_iterate failed.");
+    STRBUF_DESTROY(ctx.buf);
+    cmd_destroy(&cmd);
+    return CMD_ERROR;
   }
 
-  print_to_socket(fh, "%i Value%s found\n", (int)number,
-                  (number == 1) ? "" : "s");
-  for (size_t i = 0; i < number; i++)
-    print_to_socket(fh, "%.3f %s\n", CDTIME_T_TO_DOUBLE(times[i]), names[i]);
+  status = CMD_OK;
+  if ((fprintf(fh, "%" PRIsz " Value%s found\n", ctx.number,
+               (ctx.number == 1) ? "" : "s") < 0) ||
+      ((ctx.buf->pos > 0) &&
+       (fwrite(ctx.buf->ptr, 1, ctx.buf->pos, fh) != ctx.buf->pos)) ||
+      (fflush(fh) != 0)) {
+    WARNING("handle_listval: failed to write to socket #%i: %s", fileno(fh),
+            STRERRNO);
+    status = CMD_ERROR;
+  }
 
-  free_everything_and_return(CMD_OK);
+  STRBUF_DESTROY(ctx.buf);
+  cmd_destroy(&cmd);
+  return status;
 } /* cmd_status_t cmd_handle_listval */
+
+void cmd_destroy_listval(cmd_listval_t *listval) {
+  if (listval == NULL)
+    return;
+
+  sfree(listval->pattern);
+} /* void cmd_destroy_listval */
@@ -91,14 +91,13 @@ static int set_option(value_list_t *vl, const char *key, const char *value,
   return CMD_OK;
 } /* int set_option */
 
-/*
- * public API
- */
-
-cmd_status_t cmd_parse_putval(size_t argc, char **argv,
-                              cmd_putval_t *ret_putval,
-                              const cmd_options_t *opts,
-                              cmd_error_handler_t *err) {
+/* Parses one identifier and the options and values following it, appending
+ * the value lists to "ret_putval". On error, the caller has to destroy
+ * "ret_putval". */
+static cmd_status_t parse_putval_group(size_t argc, char **argv,
+                                       cmd_putval_t *ret_putval,
+                                       const cmd_options_t *opts,
+                                       cmd_error_handler_t *err) {
   cmd_status_t result;
 
   char *hostname;
@@ -111,12 +110,6 @@ cmd_status_t cmd_parse_putval(size_t argc, char **argv,
   const data_set_t *ds;
   value_list_t vl = VALUE_LIST_INIT;
 
-  if ((ret_putval == NULL) || (opts == NULL)) {
-    errno = EINVAL;
-    cmd_error(CMD_ERROR, err, "Invalid arguments to cmd_parse_putval.");
-    return CMD_ERROR;
-  }
-
   if (argc < 2) {
     cmd_error(CMD_PARSE_ERROR, err, "Missing identifier and/or value-list.");
     return CMD_PARSE_ERROR;
@@ -172,12 +165,12 @@ cmd_status_t cmd_parse_putval(size_t argc, char **argv,
   type = NULL;
   type_instance = NULL;
 
-  ret_putval->raw_identifier = sstrdup(identifier);
   if (ret_putval->raw_identifier == NULL) {
-    cmd_error(CMD_ERROR, err, "malloc failed.");
-    cmd_destroy_putval(ret_putval);
-    sfree(vl.values);
-    return CMD_ERROR;
+    ret_putval->raw_identifier = sstrdup(identifier);
+    if (ret_putval->raw_identifier == NULL) {
+      cmd_error(CMD_ERROR, err, "malloc failed.");
+      return CMD_ERROR;
+    }
   }
 
   /* All the remaining fields are part of the option list. */
@@ -238,7 +231,6 @@ cmd_status_t cmd_parse_putval(size_t argc, char **argv,
                   (ret_putval->vl_num + 1) * sizeof(*ret_putval->vl));
     if (tmp == NULL) {
       cmd_error(CMD_ERROR, err, "realloc failed.");
-      cmd_destroy_putval(ret_putval);
       result = CMD_ERROR;
       vl.values_len = 0;
       sfree(vl.values);
@@ -255,10 +247,42 @@ cmd_status_t cmd_parse_putval(size_t argc, char **argv,
   } /* while (*buffer != 0) */
   /* Done parsing the options. */
 
-  if (result != CMD_OK)
-    cmd_destroy_putval(ret_putval);
-
   return result;
+} /* cmd_status_t parse_putval_group */
+
+/*
+ * public API
+ */
+
+cmd_status_t cmd_parse_putval(size_t argc, char **argv,
+                              cmd_putval_t *ret_putval,
+                              const cmd_options_t *opts,
+                              cmd_error_handler_t *err) {
+  if ((ret_putval == NULL) || (opts == NULL)) {
+    errno = EINVAL;
+    cmd_error(CMD_ERROR, err, "Invalid arguments to cmd_parse_putval.");
+    return CMD_ERROR;
+  }
+
+  /* Several identifiers, each followed by its options and values, may be
+   * given in one command, separated by ";" fields. */
+  size_t start = 0;
+  do {
+    size_t end = start;
+    while ((end < argc) && (strcmp(argv[end], ";") != 0))
+      end++;
+
+    cmd_status_t status = parse_putval_group(end - start, argv + start,
+                                             ret_putval, opts, err);
+    if (status != CMD_OK) {
+      cmd_destroy_putval(ret_putval);
+      return status;
+    }
+
+    start = end + 1;
+  } while (start < argc);
+
+  return CMD_OK;
 } /* cmd_status_t cmd_parse_putval */
 
 void cmd_destroy_putval(cmd_putval_t *putval) {
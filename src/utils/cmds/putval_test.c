@@ -113,6 +113,41 @@ DEF_TEST(cmd_parse_putval) {
                   },
               },
       },
+      {
+          .argc = 7,
+          .argv =
+              (char *[]){
+                  "/MAGIC",
+                  "interval=1",
+                  "1685945973:281000",
+                  ";",
+                  "other.example.com/test/MAGIC-two",
+                  "interval=2",
+                  "1685945974:562000",
+              },
+          .want_num = 2,
+          .want =
+              (value_list_t[]){
+                  {
+                      .host = "example.com",
+                      .type = "MAGIC",
+                      .time = TIME_T_TO_CDTIME_T_STATIC(1685945973),
+                      .interval = TIME_T_TO_CDTIME_T_STATIC(1),
+                      .values_len = 1,
+                      .values = &(value_t){.derive = 281000},
+                  },
+                  {
+                      .host = "other.example.com",
+                      .plugin = "test",
+                      .type = "MAGIC",
+                      .type_instance = "two",
+                      .time = TIME_T_TO_CDTIME_T_STATIC(1685945974),
+                      .interval = TIME_T_TO_CDTIME_T_STATIC(2),
+                      .values_len = 1,
+                      .values = &(value_t){.derive = 562000},
+                  },
+              },
+      },
   };
 
   for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
@@ -0,0 +1,718 @@
+/**
+ * collectd - src/utils/container/btree.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/container/btree.h"
+
+/* All nodes but the root hold between BTREE_KEYS_MIN and BTREE_KEYS_MAX
+ * entries. With 31 entries, the key and value arrays of a node span eight
+ * cache lines. */
+#define BTREE_DEGREE 16
+#define BTREE_KEYS_MAX (2 * BTREE_DEGREE - 1)
+#define BTREE_KEYS_MIN (BTREE_DEGREE - 1)
+
+/* Every node but the root has at least BTREE_DEGREE children, so this is
+ * enough for any number of entries that fits into memory. */
+#define BTREE_DEPTH_MAX 20
+
+/*
+ * private data types
+ */
+struct c_btree_node_s {
+  int keys_num;
+  bool leaf;
+  void *keys[BTREE_KEYS_MAX];
+  void *values[BTREE_KEYS_MAX];
+  /* BTREE_KEYS_MAX + 1 children, only allocated for inner nodes. */
+  struct c_btree_node_s *children[];
+};
+typedef struct c_btree_node_s c_btree_node_t;
+
+struct c_btree_s {
+  c_btree_node_t *root;
+  int (*compare)(const void *, const void *);
+  int size;
+  /* Incremented on every modification, so that iterators can tell when they
+   * need to look up their position again. */
+  uint64_t version;
+};
+
+/* One step of the path from the root to an iterator's entry. For the last
+ * step, "index" is the index of the entry within "node". For all other steps,
+ * it is the index of the child the path continues in. */
+struct c_btree_step_s {
+  c_btree_node_t *node;
+  int index;
+};
+typedef struct c_btree_step_s c_btree_step_t;
+
+enum c_btree_iterator_state_e {
+  /* c_btree_iterator_next() returns the first entry and
+   * c_btree_iterator_prev() the last one. */
+  ITER_NEW,
+  /* Positioned before the first or after the last entry. */
+  ITER_BEFORE,
+  ITER_AFTER,
+  /* Positioned on an entry, which has been returned already. */
+  ITER_ENTRY,
+  /* Positioned on an entry, which c_btree_iterator_next() returns next. */
+  ITER_PENDING,
+};
+
+struct c_btree_iterator_s {
+  c_btree_t *tree;
+  uint64_t version;
+  enum c_btree_iterator_state_e state;
+
+  c_btree_step_t path[BTREE_DEPTH_MAX];
+  int depth;
+  /* Key of the entry the iterator is positioned on. */
+  void *key;
+};
+
+/*
+ * private functions
+ */
+static c_btree_node_t *node_alloc(bool leaf) {
+  size_t size = sizeof(c_btree_node_t);
+  if (!leaf)
+    size += (BTREE_KEYS_MAX + 1) * sizeof(c_btree_node_t *);
+
+  c_btree_node_t *n = malloc(size);
+  if (n == NULL)
+    return NULL;
+
+  n->keys_num = 0;
+  n->leaf = leaf;
+  return n;
+} /* c_btree_node_t *node_alloc */
+
+static void node_free(c_btree_node_t *n) {
+  if (n == NULL)
+    return;
+
+  if (!n->leaf)
+    for (int i = 0; i <= n->keys_num; i++)
+      node_free(n->children[i]);
+
+  free(n);
+} /* void node_free */
+
+/* Returns the index of the first key in "n" that is not smaller than "key"
+ * and sets "found" if that key is equal to "key". */
+static int node_search(c_btree_t *t, c_btree_node_t *n, const void *key,
+                       bool *found) {
+  int lo = 0;
+  int hi = n->keys_num;
+
+  *found = false;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    int cmp = t->compare(key, n->keys[mid]);
+    if (cmp == 0) {
+      *found = true;
+      return mid;
+    } else if (cmp < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+
+  return lo;
+} /* int node_search */
+
+/* Moves the entries and children of "n" starting at "index" by "offset"
+ * positions. Children are moved starting at "index + child_offset". */
+static void node_shift(c_btree_node_t *n, int index, int offset,
+                       int child_offset) {
+  int num = n->keys_num - index;
+  if (num > 0) {
+    memmove(n->keys + index + offset, n->keys + index, num * sizeof(void *));
+    memmove(n->values + index + offset, n->values + index,
+            num * sizeof(void *));
+  }
+
+  if (n->leaf)
+    return;
+
+  int child = index + child_offset;
+  num = n->keys_num + 1 - child;
+  if (num > 0)
+    memmove(n->children + child + offset, n->children + child,
+            num * sizeof(c_btree_node_t *));
+} /* void node_shift */
+
+/* Splits the full child "i" of "parent", which must not be full itself. The
+ * median entry moves up into "parent". */
+static int split_child(c_btree_node_t *parent, int i) {
+  c_btree_node_t *left = parent->children[i];
+  c_btree_node_t *right = node_alloc(left->leaf);
+  if (right == NULL)
+    return -1;
+
+  right->keys_num = BTREE_KEYS_MIN;
+  memcpy(right->keys, left->keys + BTREE_DEGREE,
+         BTREE_KEYS_MIN * sizeof(void *));
+  memcpy(right->values, left->values + BTREE_DEGREE,
+         BTREE_KEYS_MIN * sizeof(void *));
+  if (!left->leaf)
+    memcpy(right->children, left->children + BTREE_DEGREE,
+           BTREE_DEGREE * sizeof(c_btree_node_t *));
+  left->keys_num = BTREE_KEYS_MIN;
+
+  node_shift(parent, i, 1, 1);
+  parent->keys[i] = left->keys[BTREE_KEYS_MIN];
+  parent->values[i] = left->values[BTREE_KEYS_MIN];
+  parent->children[i + 1] = right;
+  parent->keys_num++;
+
+  return 0;
+} /* int split_child */
+
+/* Merges child "i + 1" of "n" and the entry separating it from child "i" into
+ * child "i". */
+static void merge_children(c_btree_node_t *n, int i) {
+  c_btree_node_t *left = n->children[i];
+  c_btree_node_t *right = n->children[i + 1];
+
+  left->keys[left->keys_num] = n->keys[i];
+  left->values[left->keys_num] = n->values[i];
+  memcpy(left->keys + left->keys_num + 1, right->keys,
+         right->keys_num * sizeof(void *));
+  memcpy(left->values + left->keys_num + 1, right->values,
+         right->keys_num * sizeof(void *));
+  if (!left->leaf)
+    memcpy(left->children + left->keys_num + 1, right->children,
+           (right->keys_num + 1) * sizeof(c_btree_node_t *));
+  left->keys_num += right->keys_num + 1;
+
+  node_shift(n, i + 1, -1, 1);
+  n->keys_num--;
+
+  free(right);
+} /* void merge_children */
+
+/* Makes sure child "i" of "n" has more than BTREE_KEYS_MIN entries, so that
+ * one can be removed from it, by moving an entry over from a sibling or by
+ * merging it with one. Returns the index of the child that holds the entries
+ * of child "i" afterwards. */
+static int fill_child(c_btree_node_t *n, int i) {
+  c_btree_node_t *child = n->children[i];
+  if (child->keys_num > BTREE_KEYS_MIN)
+    return i;
+
+  if ((i > 0) && (n->children[i - 1]->keys_num > BTREE_KEYS_MIN)) {
+    c_btree_node_t *left = n->children[i - 1];
+
+    node_shift(child, 0, 1, 0);
+    child->keys[0] = n->keys[i - 1];
+    child->values[0] = n->values[i - 1];
+    if (!child->leaf)
+      child->children[0] = left->children[left->keys_num];
+    child->keys_num++;
+
+    n->keys[i - 1] = left->keys[left->keys_num - 1];
+    n->values[i - 1] = left->values[left->keys_num - 1];
+    left->keys_num--;
+    return i;
+  }
+
+  if ((i < n->keys_num) && (n->children[i + 1]->keys_num > BTREE_KEYS_MIN)) {
+    c_btree_node_t *right = n->children[i + 1];
+
+    child->keys[child->keys_num] = n->keys[i];
+    child->values[child->keys_num] = n->values[i];
+    if (!child->leaf)
+      child->children[child->keys_num + 1] = right->children[0];
+    child->keys_num++;
+
+    n->keys[i] = right->keys[0];
+    n->values[i] = right->values[0];
+    node_shift(right, 1, -1, 0);
+    right->keys_num--;
+    return i;
+  }
+
+  if (i < n->keys_num) {
+    merge_children(n, i);
+    return i;
+  }
+
+  merge_children(n, i - 1);
+  return i - 1;
+} /* int fill_child */
+
+/* Removes "key" from the subtree rooted at "n". Every node this descends into
+ * is filled first, so that removing an entry never leaves a node with fewer
+ * than BTREE_KEYS_MIN entries. */
+static int node_remove(c_btree_t *t, c_btree_node_t *n, const void *key,
+                       void **rkey, void **rvalue) {
+  while (42) {
+    bool found;
+    int i = node_search(t, n, key, &found);
+
+    if (n->leaf) {
+      if (!found)
+        return -1;
+
+      if (rkey != NULL)
+        *rkey = n->keys[i];
+      if (rvalue != NULL)
+        *rvalue = n->values[i];
+
+      node_shift(n, i + 1, -1, 0);
+      n->keys_num--;
+      return 0;
+    }
+
+    if (!found) {
+      i = fill_child(n, i);
+      n = n->children[i];
+      continue;
+    }
+
+    if (rkey != NULL)
+      *rkey = n->keys[i];
+    if (rvalue != NULL)
+      *rvalue = n->values[i];
+
+    /* Replace the entry with its predecessor or successor and remove that
+     * from the subtree it is stored in. */
+    c_btree_node_t *left = n->children[i];
+    c_btree_node_t *right = n->children[i + 1];
+    c_btree_node_t *p;
+    if (left->keys_num > BTREE_KEYS_MIN) {
+      for (p = left; !p->leaf; p = p->children[p->keys_num])
+        ;
+      n->keys[i] = p->keys[p->keys_num - 1];
+      n->values[i] = p->values[p->keys_num - 1];
+      key = n->keys[i];
+      n = left;
+    } else if (right->keys_num > BTREE_KEYS_MIN) {
+      for (p = right; !p->leaf; p = p->children[0])
+        ;
+      n->keys[i] = p->keys[0];
+      n->values[i] = p->values[0];
+      key = n->keys[i];
+      n = right;
+    } else {
+      /* Both children are minimal: the entry moves down into the merged
+       * child and is removed from there. */
+      merge_children(n, i);
+      n = left;
+      continue;
+    }
+
+    /* The removed entry has been returned already. */
+    rkey = NULL;
+    rvalue = NULL;
+  }
+} /* int node_remove */
+
+/* Appends the path from "n" down to its first or last entry. */
+static void iter_descend(c_btree_iterator_t *iter, c_btree_node_t *n,
+                         bool last) {
+  while (!n->leaf) {
+    int i = last ? n->keys_num : 0;
+    assert(iter->depth < BTREE_DEPTH_MAX);
+    iter->path[iter->depth++] = (c_btree_step_t){n, i};
+    n = n->children[i];
+  }
+
+  assert(iter->depth < BTREE_DEPTH_MAX);
+  iter->path[iter->depth++] = (c_btree_step_t){n, last ? n->keys_num - 1 : 0};
+} /* void iter_descend */
+
+/* Moves the iterator to the following entry. Returns false if there is
+ * none. */
+static bool iter_step_next(c_btree_iterator_t *iter) {
+  c_btree_step_t *s = iter->path + iter->depth - 1;
+
+  if (!s->node->leaf) {
+    s->index++;
+    iter_descend(iter, s->node->children[s->index], /* last = */ false);
+    return true;
+  }
+
+  if (s->index + 1 < s->node->keys_num) {
+    s->index++;
+    return true;
+  }
+
+  /* Go up until the path continued left of an entry. */
+  for (iter->depth--; iter->depth > 0; iter->depth--) {
+    s = iter->path + iter->depth - 1;
+    if (s->index < s->node->keys_num)
+      return true;
+  }
+
+  return false;
+} /* bool iter_step_next */
+
+/* Moves the iterator to the preceding entry. Returns false if there is
+ * none. */
+static bool iter_step_prev(c_btree_iterator_t *iter) {
+  c_btree_step_t *s = iter->path + iter->depth - 1;
+
+  if (!s->node->leaf) {
+    iter_descend(iter, s->node->children[s->index], /* last = */ true);
+    return true;
+  }
+
+  if (s->index > 0) {
+    s->index--;
+    return true;
+  }
+
+  /* Go up until the path continued right of an entry. */
+  for (iter->depth--; iter->depth > 0; iter->depth--) {
+    s = iter->path + iter->depth - 1;
+    if (s->index > 0) {
+      s->index--;
+      return true;
+    }
+  }
+
+  return false;
+} /* bool iter_step_prev */
+
+static void iter_entry(c_btree_iterator_t *iter, void **key, void **value) {
+  c_btree_step_t *s = iter->path + iter->depth - 1;
+
+  iter->key = s->node->keys[s->index];
+  if (key != NULL)
+    *key = iter->key;
+  if (value != NULL)
+    *value = s->node->values[s->index];
+} /* void iter_entry */
+
+/* Positions the iterator on the smallest entry not smaller than "key". */
+static void iter_seek(c_btree_iterator_t *iter, const void *key) {
+  c_btree_t *t = iter->tree;
+  c_btree_node_t *n = t->root;
+
+  iter->version = t->version;
+  iter->depth = 0;
+  iter->state = ITER_AFTER;
+  if (n == NULL)
+    return;
+
+  while (42) {
+    bool found;
+    int i = node_search(t, n, key, &found);
+
+    assert(iter->depth < BTREE_DEPTH_MAX);
+    iter->path[iter->depth++] = (c_btree_step_t){n, i};
+    if (found || (n->leaf && (i < n->keys_num)))
+      break;
+
+    if (n->leaf) {
+      /* All entries in this leaf are smaller than "key". Go up until the
+       * path continued left of an entry. */
+      for (iter->depth--; iter->depth > 0; iter->depth--) {
+        c_btree_step_t *s = iter->path + iter->depth - 1;
+        if (s->index < s->node->keys_num)
+          break;
+      }
+      if (iter->depth == 0)
+        return;
+      break;
+    }
+
+    n = n->children[i];
+  }
+
+  iter->state = ITER_PENDING;
+  iter_entry(iter, NULL, NULL);
+} /* void iter_seek */
+
+/* Looks up the iterator's position again if the tree has been modified since
+ * it was last used. */
+static void iter_revalidate(c_btree_iterator_t *iter) {
+  c_btree_t *t = iter->tree;
+
+  if (iter->version == t->version)
+    return;
+  iter->version = t->version;
+
+  if ((iter->state != ITER_ENTRY) && (iter->state != ITER_PENDING))
+    return;
+
+  void *key = iter->key;
+  enum c_btree_iterator_state_e state = iter->state;
+
+  iter_seek(iter, key);
+  /* If the entry still exists, the iterator is still positioned on it.
+   * Otherwise it is positioned on the following entry, which is yet to be
+   * returned. */
+  if ((state == ITER_ENTRY) && (iter->state == ITER_PENDING) &&
+      (t->compare(key, iter->key) == 0))
+    iter->state = ITER_ENTRY;
+} /* void iter_revalidate */
+
+/*
+ * public functions
+ */
+c_btree_t *c_btree_create(int (*compare)(const void *, const void *)) {
+  c_btree_t *t;
+
+  if (compare == NULL)
+    return NULL;
+
+  if ((t = calloc(1, sizeof(*t))) == NULL)
+    return NULL;
+
+  t->compare = compare;
+
+  return t;
+} /* c_btree_t *c_btree_create */
+
+void c_btree_destroy(c_btree_t *t) {
+  if (t == NULL)
+    return;
+
+  node_free(t->root);
+  free(t);
+} /* void c_btree_destroy */
+
+int c_btree_insert(c_btree_t *t, void *key, void *value) {
+  assert(t != NULL);
+
+  /* Splitting nodes moves entries around, even if the key turns out to
+   * exist already. */
+  t->version++;
+
+  if (t->root == NULL) {
+    if ((t->root = node_alloc(/* leaf = */ true)) == NULL)
+      return -1;
+  }
+
+  if (t->root->keys_num == BTREE_KEYS_MAX) {
+    c_btree_node_t *root = node_alloc(/* leaf = */ false);
+    if (root == NULL)
+      return -1;
+
+    root->children[0] = t->root;
+    if (split_child(root, 0) != 0) {
+      free(root);
+      return -1;
+    }
+    t->root = root;
+  }
+
+  /* Full nodes are split on the way down, so there is always room for the
+   * new entry. */
+  c_btree_node_t *n = t->root;
+  while (42) {
+    bool found;
+    int i = node_search(t, n, key, &found);
+    if (found)
+      return 1;
+
+    if (n->leaf) {
+      node_shift(n, i, 1, 0);
+      n->keys[i] = key;
+      n->values[i] = value;
+      n->keys_num++;
+      break;
+    }
+
+    if (n->children[i]->keys_num == BTREE_KEYS_MAX) {
+      if (split_child(n, i) != 0)
+        return -1;
+
+      int cmp = t->compare(key, n->keys[i]);
+      if (cmp == 0)
+        return 1;
+      else if (cmp > 0)
+        i++;
+    }
+
+    n = n->children[i];
+  }
+
+  t->size++;
+  return 0;
+} /* int c_btree_insert */
+
+int c_btree_remove(c_btree_t *t, const void *key, void **rkey,
+                   void **rvalue) {
+  assert(t != NULL);
+
+  if (t->root == NULL)
+    return -1;
+
+  t->version++;
+  int status = node_remove(t, t->root, key, rkey, rvalue);
+
+  /* Merging the last two children of the root leaves it empty. */
+  if (t->root->keys_num == 0) {
+    c_btree_node_t *root = t->root;
+    t->root = root->leaf ? NULL : root->children[0];
+    free(root);
+  }
+
+  if (status != 0)
+    return status;
+
+  t->size--;
+  return 0;
+} /* int c_btree_remove */
+
+int c_btree_get(c_btree_t *t, const void *key, void **value) {
+  assert(t != NULL);
+
+  c_btree_node_t *n = t->root;
+  while (n != NULL) {
+    bool found;
+    int i = node_search(t, n, key, &found);
+    if (found) {
+      if (value != NULL)
+        *value = n->values[i];
+      return 0;
+    }
+
+    n = n->leaf ? NULL : n->children[i];
+  }
+
+  return -1;
+} /* int c_btree_get */
+
+int c_btree_pick(c_btree_t *t, void **key, void **value) {
+  assert(t != NULL);
+
+  if ((key == NULL) || (value == NULL))
+    return -1;
+  if (t->root == NULL)
+    return -1;
+
+  /* The biggest key is stored in a leaf, so removing it moves the fewest
+   * entries. */
+  c_btree_node_t *n = t->root;
+  while (!n->leaf)
+    n = n->children[n->keys_num];
+
+  return c_btree_remove(t, n->keys[n->keys_num - 1], key, value);
+} /* int c_btree_pick */
+
+c_btree_iterator_t *c_btree_get_iterator(c_btree_t *t) {
+  c_btree_iterator_t *iter;
+
+  if (t == NULL)
+    return NULL;
+
+  iter = calloc(1, sizeof(*iter));
+  if (iter == NULL)
+    return NULL;
+  iter->tree = t;
+  iter->version = t->version;
+  iter->state = ITER_NEW;
+
+  return iter;
+} /* c_btree_iterator_t *c_btree_get_iterator */
+
+int c_btree_iterator_next(c_btree_iterator_t *iter, void **key, void **value) {
+  if ((iter == NULL) || (key == NULL) || (value == NULL))
+    return -1;
+
+  iter_revalidate(iter);
+
+  switch (iter->state) {
+  case ITER_NEW:
+  case ITER_BEFORE:
+    if (iter->tree->root == NULL)
+      return -1;
+    iter->depth = 0;
+    iter_descend(iter, iter->tree->root, /* last = */ false);
+    break;
+  case ITER_AFTER:
+    return -1;
+  case ITER_ENTRY:
+    if (!iter_step_next(iter)) {
+      iter->state = ITER_AFTER;
+      return -1;
+    }
+    break;
+  case ITER_PENDING:
+    break;
+  }
+
+  iter->state = ITER_ENTRY;
+  iter_entry(iter, key, value);
+  return 0;
+} /* int c_btree_iterator_next */
+
+int c_btree_iterator_prev(c_btree_iterator_t *iter, void **key, void **value) {
+  if ((iter == NULL) || (key == NULL) || (value == NULL))
+    return -1;
+
+  iter_revalidate(iter);
+
+  switch (iter->state) {
+  case ITER_NEW:
+  case ITER_AFTER:
+    if (iter->tree->root == NULL)
+      return -1;
+    iter->depth = 0;
+    iter_descend(iter, iter->tree->root, /* last = */ true);
+    break;
+  case ITER_BEFORE:
+    return -1;
+  case ITER_ENTRY:
+  case ITER_PENDING:
+    if (!iter_step_prev(iter)) {
+      iter->state = ITER_BEFORE;
+      return -1;
+    }
+    break;
+  }
+
+  iter->state = ITER_ENTRY;
+  iter_entry(iter, key, value);
+  return 0;
+} /* int c_btree_iterator_prev */
+
+int c_btree_iterator_seek(c_btree_iterator_t *iter, const void *key) {
+  if ((iter == NULL) || (key == NULL))
+    return -1;
+
+  iter_seek(iter, key);
+  return 0;
+} /* int c_btree_iterator_seek */
+
+void c_btree_iterator_destroy(c_btree_iterator_t *iter) { free(iter); }
+
+int c_btree_size(c_btree_t *t) {
+  if (t == NULL)
+    return 0;
+  return t->size;
+}
@@ -0,0 +1,175 @@
+/**
+ * collectd - src/utils/container/btree.h
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#ifndef UTILS_CONTAINER_BTREE_H
+#define UTILS_CONTAINER_BTREE_H 1
+
+/*
+ * The B-tree is an ordered map with the same interface and semantics as the
+ * AVL-tree in "utils/avltree/avltree.h". Each node stores up to 31 entries in
+ * arrays, so lookups touch far fewer cache lines and inserts do far fewer
+ * allocations than with the AVL-tree. Callers can be migrated by replacing
+ * the "c_avl_" prefix with "c_btree_".
+ *
+ * Unlike with the AVL-tree, iterators survive insertions and removals: an
+ * iterator continues with the key following the one it returned last. The
+ * key returned last must not be freed while the iterator is in use, though.
+ */
+
+struct c_btree_s;
+typedef struct c_btree_s c_btree_t;
+
+struct c_btree_iterator_s;
+typedef struct c_btree_iterator_s c_btree_iterator_t;
+
+/*
+ * NAME
+ *   c_btree_create
+ *
+ * DESCRIPTION
+ *   Allocates a new B-tree.
+ *
+ * PARAMETERS
+ *   `compare'  The function-pointer `compare' is used to compare two keys. It
+ *              has to return less than zero if its first argument is smaller
+ *              then the second argument, more than zero if the first argument
+ *              is bigger than the second argument and zero if they are equal.
+ *              If your keys are char-pointers, you can use the `strcmp'
+ *              function from the libc here.
+ *
+ * RETURN VALUE
+ *   A c_btree_t-pointer upon success or NULL upon failure.
+ */
+c_btree_t *c_btree_create(int (*compare)(const void *, const void *));
+
+/*
+ * NAME
+ *   c_btree_destroy
+ *
+ * DESCRIPTION
+ *   Deallocates a B-tree. Stored value- and key-pointer are lost, but of
+ *   course not freed.
+ */
+void c_btree_destroy(c_btree_t *t);
+
+/*
+ * NAME
+ *   c_btree_insert
+ *
+ * DESCRIPTION
+ *   Stores the key-value-pair in the B-tree pointed to by `t'.
+ *
+ * PARAMETERS
+ *   `t'        B-tree to store the data in.
+ *   `key'      Key used to store the value under. The pointer is stored and
+ *              _not_ copied, so the memory pointed to may _not_ be freed
+ *              before this entry is removed.
+ *   `value'    Value to be stored.
+ *
+ * RETURN VALUE
+ *   Zero upon success, non-zero otherwise. It's less than zero if an error
+ *   occurred or greater than zero if the key is already stored in the tree.
+ */
+int c_btree_insert(c_btree_t *t, void *key, void *value);
+
+/*
+ * NAME
+ *   c_btree_remove
+ *
+ * DESCRIPTION
+ *   Removes a key-value-pair from the tree t. The stored key and value may be
+ *   returned in `rkey' and `rvalue'.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the key isn't found in the tree.
+ */
+int c_btree_remove(c_btree_t *t, const void *key, void **rkey, void **rvalue);
+
+/*
+ * NAME
+ *   c_btree_get
+ *
+ * DESCRIPTION
+ *   Retrieve the `value' belonging to `key'. `value' may be NULL.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the key isn't found in the tree.
+ */
+int c_btree_get(c_btree_t *t, const void *key, void **value);
+
+/*
+ * NAME
+ *   c_btree_pick
+ *
+ * DESCRIPTION
+ *   Remove an element from the tree and return its `key' and `value'. This
+ *   function is intended for cache-flushes that don't care about the order
+ *   but simply want to remove all elements, one at a time.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the tree is empty or key or value is
+ *   NULL.
+ */
+int c_btree_pick(c_btree_t *t, void **key, void **value);
+
+/*
+ * NAME
+ *   c_btree_get_iterator, c_btree_iterator_next, c_btree_iterator_prev
+ *
+ * DESCRIPTION
+ *   A new iterator returns the smallest key on the first call to
+ *   `c_btree_iterator_next' and the biggest key on the first call to
+ *   `c_btree_iterator_prev'. Both return non-zero when there are no more
+ *   entries.
+ */
+c_btree_iterator_t *c_btree_get_iterator(c_btree_t *t);
+int c_btree_iterator_next(c_btree_iterator_t *iter, void **key, void **value);
+int c_btree_iterator_prev(c_btree_iterator_t *iter, void **key, void **value);
+void c_btree_iterator_destroy(c_btree_iterator_t *iter);
+
+/*
+ * NAME
+ *   c_btree_iterator_seek
+ *
+ * DESCRIPTION
+ *   Positions the iterator so that the next call to `c_btree_iterator_next'
+ *   returns the smallest key that is greater than or equal to `key'.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if `iter' or `key' is NULL.
+ */
+int c_btree_iterator_seek(c_btree_iterator_t *iter, const void *key);
+
+/*
+ * NAME
+ *   c_btree_size
+ *
+ * RETURN VALUE
+ *   Number of entries in the tree, 0 if the tree is empty or NULL.
+ */
+int c_btree_size(c_btree_t *t);
+
+#endif /* UTILS_CONTAINER_BTREE_H */
@@ -0,0 +1,316 @@
+/**
+ * collectd - src/utils/container/btree_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include "collectd.h"
+#include "utils/common/common.h" /* STATIC_ARRAY_SIZE */
+
+#include "testing.h"
+#include "utils/container/btree.h"
+
+static int compare_total_count;
+
+#define RESET_COUNTS()                                                         \
+  do {                                                                         \
+    compare_total_count = 0;                                                   \
+  } while (0)
+
+static int compare_callback(void const *v0, void const *v1) {
+  assert(v0 != NULL);
+  assert(v1 != NULL);
+
+  compare_total_count++;
+  return strcmp(v0, v1);
+}
+
+struct kv_t {
+  char *key;
+  char *value;
+};
+
+static int kv_compare(const void *a_ptr, const void *b_ptr) {
+  return strcmp(((struct kv_t *)a_ptr)->key, ((struct kv_t *)b_ptr)->key);
+}
+
+DEF_TEST(success) {
+  struct kv_t cases[] = {
+      {"Eeph7chu", "vai1reiV"}, {"igh3Paiz", "teegh1Ee"},
+      {"caip6Uu8", "ooteQu8n"}, {"Aech6vah", "AijeeT0l"},
+      {"Xah0et2L", "gah8Taep"}, {"BocaeB8n", "oGaig8io"},
+      {"thai8AhM", "ohjeFo3f"}, {"ohth6ieC", "hoo8ieWo"},
+      {"aej7Woow", "phahuC2s"}, {"Hai8ier2", "Yie6eimi"},
+      {"phuXi3Li", "JaiF7ieb"}, {"Shaig5ef", "aihi5Zai"},
+      {"voh6Aith", "Oozaeto0"}, {"zaiP5kie", "seep5veM"},
+      {"pae7ba7D", "chie8Ojo"}, {"Gou2ril3", "ouVoo0ha"},
+      {"lo3Thee3", "ahDu4Zuj"}, {"Rah8kohv", "ieShoc7E"},
+      {"ieN5engi", "Aevou1ah"}, {"ooTe4OhP", "aingai5Y"},
+  };
+
+  struct kv_t sorted_cases[STATIC_ARRAY_SIZE(cases)];
+  memcpy(sorted_cases, cases, sizeof(cases));
+  qsort(sorted_cases, STATIC_ARRAY_SIZE(cases), sizeof(struct kv_t),
+        kv_compare);
+
+  c_btree_t *t;
+
+  RESET_COUNTS();
+  CHECK_NOT_NULL(t = c_btree_create(compare_callback));
+
+  /* insert */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    char *key;
+    char *value;
+
+    CHECK_NOT_NULL(key = strdup(cases[i].key));
+    CHECK_NOT_NULL(value = strdup(cases[i].value));
+
+    CHECK_ZERO(c_btree_insert(t, key, value));
+    EXPECT_EQ_INT((int)(i + 1), c_btree_size(t));
+  }
+
+  /* Key already exists. */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++)
+    EXPECT_EQ_INT(1, c_btree_insert(t, cases[i].key, cases[i].value));
+
+  /* get */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    char *value_ret = NULL;
+
+    CHECK_ZERO(c_btree_get(t, cases[i].key, (void *)&value_ret));
+    EXPECT_EQ_STR(cases[i].value, value_ret);
+  }
+
+  /* iterate forward */
+  {
+    c_btree_iterator_t *iter = c_btree_get_iterator(t);
+    char *key;
+    char *value;
+    size_t i = 0;
+    while (c_btree_iterator_next(iter, (void **)&key, (void **)&value) == 0) {
+      EXPECT_EQ_STR(sorted_cases[i].key, key);
+      EXPECT_EQ_STR(sorted_cases[i].value, value);
+      i++;
+    }
+    c_btree_iterator_destroy(iter);
+    EXPECT_EQ_INT(i, STATIC_ARRAY_SIZE(cases));
+  }
+
+  /* iterate backward */
+  {
+    c_btree_iterator_t *iter = c_btree_get_iterator(t);
+    char *key;
+    char *value;
+    size_t i = 0;
+    while (c_btree_iterator_prev(iter, (void **)&key, (void **)&value) == 0) {
+      EXPECT_EQ_STR(sorted_cases[STATIC_ARRAY_SIZE(cases) - 1 - i].key, key);
+      EXPECT_EQ_STR(sorted_cases[STATIC_ARRAY_SIZE(cases) - 1 - i].value,
+                    value);
+      i++;
+    }
+    c_btree_iterator_destroy(iter);
+    EXPECT_EQ_INT(i, STATIC_ARRAY_SIZE(cases));
+  }
+
+  /* seek */
+  for (size_t i = 0; i <= STATIC_ARRAY_SIZE(cases); i++) {
+    c_btree_iterator_t *iter = c_btree_get_iterator(t);
+    char *key;
+    char *value;
+
+    /* Seek to an existing key and to the position right before it. */
+    char seek_key[16] = "\x7f";
+    if (i < STATIC_ARRAY_SIZE(cases))
+      snprintf(seek_key, sizeof(seek_key), "%s", sorted_cases[i].key);
+
+    CHECK_ZERO(c_btree_iterator_seek(iter, seek_key));
+    for (size_t j = i; j < STATIC_ARRAY_SIZE(cases); j++) {
+      CHECK_ZERO(c_btree_iterator_next(iter, (void **)&key, (void **)&value));
+      EXPECT_EQ_STR(sorted_cases[j].key, key);
+    }
+    EXPECT_EQ_INT(-1,
+                  c_btree_iterator_next(iter, (void **)&key, (void **)&value));
+
+    if (i < STATIC_ARRAY_SIZE(cases)) {
+      seek_key[strlen(seek_key) - 1]--;
+      CHECK_ZERO(c_btree_iterator_seek(iter, seek_key));
+      CHECK_ZERO(c_btree_iterator_next(iter, (void **)&key, (void **)&value));
+      EXPECT_EQ_STR(sorted_cases[i].key, key);
+    }
+
+    c_btree_iterator_destroy(iter);
+  }
+
+  /* remove half */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases) / 2; i++) {
+    char *key = NULL;
+    char *value = NULL;
+
+    int expected_size = (int)(STATIC_ARRAY_SIZE(cases) - (i + 1));
+
+    CHECK_ZERO(c_btree_remove(t, cases[i].key, (void *)&key, (void *)&value));
+
+    EXPECT_EQ_STR(cases[i].key, key);
+    EXPECT_EQ_STR(cases[i].value, value);
+
+    free(key);
+    free(value);
+
+    EXPECT_EQ_INT(expected_size, c_btree_size(t));
+  }
+
+  /* pick the other half */
+  for (size_t i = STATIC_ARRAY_SIZE(cases) / 2; i < STATIC_ARRAY_SIZE(cases);
+       i++) {
+    char *key = NULL;
+    char *value = NULL;
+
+    int expected_size = (int)(STATIC_ARRAY_SIZE(cases) - (i + 1));
+
+    EXPECT_EQ_INT(expected_size + 1, c_btree_size(t));
+    EXPECT_EQ_INT(0, c_btree_pick(t, (void *)&key, (void *)&value));
+
+    free(key);
+    free(value);
+
+    EXPECT_EQ_INT(expected_size, c_btree_size(t));
+  }
+
+  c_btree_destroy(t);
+
+  return 0;
+}
+
+static int compare_int(void const *a, void const *b) {
+  int x = *(int const *)a;
+  int y = *(int const *)b;
+  return (x > y) - (x < y);
+}
+
+#define RANDOM_KEYS 20000
+
+/* Inserts and removes keys in random order, so that nodes are split, merged
+ * and entries are moved between nodes, and checks the tree against a bitmap
+ * of the keys that are expected to be present. Failures are counted rather
+ * than reported one by one to keep the output short. */
+DEF_TEST(random) {
+  static int keys[RANDOM_KEYS];
+  static bool present[RANDOM_KEYS];
+  int size = 0;
+  int errors = 0;
+
+  for (int i = 0; i < RANDOM_KEYS; i++)
+    keys[i] = i;
+
+  c_btree_t *t;
+  CHECK_NOT_NULL(t = c_btree_create(compare_int));
+
+  srand(42);
+  for (int round = 0; round < 10 * RANDOM_KEYS; round++) {
+    int k = rand() % RANDOM_KEYS;
+    void *rkey = NULL;
+
+    if (present[k]) {
+      if ((c_btree_remove(t, keys + k, &rkey, NULL) != 0) || (rkey != keys + k))
+        errors++;
+      size--;
+    } else {
+      if (c_btree_insert(t, keys + k, keys + k) != 0)
+        errors++;
+      size++;
+    }
+    present[k] = !present[k];
+
+    if (c_btree_size(t) != size)
+      errors++;
+  }
+  EXPECT_EQ_INT(0, errors);
+
+  for (int i = 0; i < RANDOM_KEYS; i++) {
+    void *value = NULL;
+    int status = c_btree_get(t, keys + i, &value);
+    if (present[i] ? ((status != 0) || (value != keys + i)) : (status == 0))
+      errors++;
+  }
+  EXPECT_EQ_INT(0, errors);
+
+  /* Remove every other entry while iterating: the iterator has to continue
+   * with the following key. */
+  c_btree_iterator_t *iter = c_btree_get_iterator(t);
+  int *key;
+  void *value;
+  int last = -1;
+  int visited = 0;
+  while (c_btree_iterator_next(iter, (void *)&key, &value) == 0) {
+    if ((*key <= last) || !present[*key])
+      errors++;
+    last = *key;
+
+    if ((visited % 2) == 1) {
+      if (c_btree_remove(t, key, NULL, NULL) != 0)
+        errors++;
+      present[*key] = false;
+      size--;
+    }
+    visited++;
+  }
+  c_btree_iterator_destroy(iter);
+  EXPECT_EQ_INT(0, errors);
+  EXPECT_EQ_INT(visited - visited / 2, size);
+  EXPECT_EQ_INT(size, c_btree_size(t));
+
+  /* iterate backward */
+  CHECK_NOT_NULL(iter = c_btree_get_iterator(t));
+  last = RANDOM_KEYS;
+  visited = 0;
+  while (c_btree_iterator_prev(iter, (void *)&key, &value) == 0) {
+    if ((*key >= last) || !present[*key])
+      errors++;
+    last = *key;
+    visited++;
+  }
+  c_btree_iterator_destroy(iter);
+  EXPECT_EQ_INT(0, errors);
+  EXPECT_EQ_INT(size, visited);
+
+  while (c_btree_pick(t, (void *)&key, &value) == 0) {
+    if (!present[*key])
+      errors++;
+    present[*key] = false;
+    size--;
+  }
+  EXPECT_EQ_INT(0, errors);
+  EXPECT_EQ_INT(0, size);
+  EXPECT_EQ_INT(0, c_btree_size(t));
+
+  c_btree_destroy(t);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(success);
+  RUN_TEST(random);
+
+  END_TEST;
+}
@@ -0,0 +1,248 @@
+/**
+ * collectd - src/utils/container/container_bench.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+/* container_bench compares the AVL-tree with the B-tree and the hash map for
+ * string keys that look like value list identifiers. For each size, keys are
+ * inserted and looked up in random order, iterated over and removed. It is
+ * not run as part of "make check"; build it with "make bench_containers" and
+ * run "./bench_containers [max_keys]". Sizes grow by a factor of ten from
+ * 1000 up to "max_keys", which defaults to one million. */
+
+#include "collectd.h"
+
+#include "utils/avltree/avltree.h"
+#include "utils/common/common.h" /* STATIC_ARRAY_SIZE */
+#include "utils/container/btree.h"
+#include "utils/container/hashmap.h"
+
+#include <time.h>
+
+typedef struct {
+  char const *name;
+  void *(*create)(void);
+  void (*destroy)(void *);
+  int (*insert)(void *, void *, void *);
+  int (*get)(void *, const void *, void **);
+  int (*remove)(void *, const void *, void **, void **);
+  /* Returns the number of entries visited. */
+  size_t (*iterate)(void *);
+} container_t;
+
+static int compare_string(const void *a, const void *b) { return strcmp(a, b); }
+
+static void *avl_create(void) { return c_avl_create(compare_string); }
+static void avl_destroy(void *c) { c_avl_destroy(c); }
+static int avl_insert(void *c, void *k, void *v) {
+  return c_avl_insert(c, k, v);
+}
+static int avl_get(void *c, const void *k, void **v) {
+  return c_avl_get(c, k, v);
+}
+static int avl_remove(void *c, const void *k, void **rk, void **rv) {
+  return c_avl_remove(c, k, rk, rv);
+}
+static size_t avl_iterate(void *c) {
+  c_avl_iterator_t *iter = c_avl_get_iterator(c);
+  void *key;
+  void *value;
+  size_t n = 0;
+  while (c_avl_iterator_next(iter, &key, &value) == 0)
+    n++;
+  c_avl_iterator_destroy(iter);
+  return n;
+}
+
+static void *btree_create(void) { return c_btree_create(compare_string); }
+static void btree_destroy(void *c) { c_btree_destroy(c); }
+static int btree_insert(void *c, void *k, void *v) {
+  return c_btree_insert(c, k, v);
+}
+static int btree_get(void *c, const void *k, void **v) {
+  return c_btree_get(c, k, v);
+}
+static int btree_remove(void *c, const void *k, void **rk, void **rv) {
+  return c_btree_remove(c, k, rk, rv);
+}
+static size_t btree_iterate(void *c) {
+  c_btree_iterator_t *iter = c_btree_get_iterator(c);
+  void *key;
+  void *value;
+  size_t n = 0;
+  while (c_btree_iterator_next(iter, &key, &value) == 0)
+    n++;
+  c_btree_iterator_destroy(iter);
+  return n;
+}
+
+static void *hashmap_create(void) {
+  return c_hashmap_create(c_hashmap_hash_string, compare_string);
+}
+static void hashmap_destroy(void *c) { c_hashmap_destroy(c); }
+static int hashmap_insert(void *c, void *k, void *v) {
+  return c_hashmap_insert(c, k, v);
+}
+static int hashmap_get(void *c, const void *k, void **v) {
+  return c_hashmap_get(c, k, v);
+}
+static int hashmap_remove(void *c, const void *k, void **rk, void **rv) {
+  return c_hashmap_remove(c, k, rk, rv);
+}
+static size_t hashmap_iterate(void *c) {
+  c_hashmap_iterator_t *iter = c_hashmap_get_iterator(c);
+  void *key;
+  void *value;
+  size_t n = 0;
+  while (c_hashmap_iterator_next(iter, &key, &value) == 0)
+    n++;
+  c_hashmap_iterator_destroy(iter);
+  return n;
+}
+
+static container_t containers[] = {
+    {"avltree", avl_create, avl_destroy, avl_insert, avl_get, avl_remove,
+     avl_iterate},
+    {"btree", btree_create, btree_destroy, btree_insert, btree_get,
+     btree_remove, btree_iterate},
+    {"hashmap", hashmap_create, hashmap_destroy, hashmap_insert, hashmap_get,
+     hashmap_remove, hashmap_iterate},
+};
+
+static double monotonic_seconds(void) {
+  struct timespec ts = {0};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+static uint64_t random_state = 42;
+
+/* xorshift64*, so that the results do not depend on the libc. */
+static uint64_t random_next(void) {
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return random_state * 2685821657736338717ULL;
+}
+
+static void shuffle(char **keys, size_t keys_num) {
+  for (size_t i = keys_num - 1; i > 0; i--) {
+    size_t j = (size_t)(random_next() % (i + 1));
+    char *tmp = keys[i];
+    keys[i] = keys[j];
+    keys[j] = tmp;
+  }
+}
+
+/* Runs all operations for "keys_num" keys. "lookup" holds the same keys as
+ * "keys" in a different order. */
+static int bench_one(container_t *c, char **keys, char **lookup,
+                     size_t keys_num) {
+  void *m = c->create();
+  if (m == NULL)
+    return ENOMEM;
+
+  double t0 = monotonic_seconds();
+  for (size_t i = 0; i < keys_num; i++)
+    if (c->insert(m, keys[i], keys[i]) != 0)
+      return EINVAL;
+
+  double t1 = monotonic_seconds();
+  for (size_t i = 0; i < keys_num; i++) {
+    void *value = NULL;
+    if ((c->get(m, lookup[i], &value) != 0) || (value != lookup[i]))
+      return EINVAL;
+  }
+
+  double t2 = monotonic_seconds();
+  if (c->iterate(m) != keys_num)
+    return EINVAL;
+
+  double t3 = monotonic_seconds();
+  for (size_t i = 0; i < keys_num; i++)
+    if (c->remove(m, keys[i], NULL, NULL) != 0)
+      return EINVAL;
+
+  double t4 = monotonic_seconds();
+  c->destroy(m);
+
+  double n = (double)keys_num;
+  printf("%-8s %9zu %10.1f %10.1f %10.1f %10.1f\n", c->name, keys_num,
+         1e9 * (t1 - t0) / n, 1e9 * (t2 - t1) / n, 1e9 * (t3 - t2) / n,
+         1e9 * (t4 - t3) / n);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  size_t max_keys = 1000000;
+  if (argc > 1)
+    max_keys = (size_t)strtoull(argv[1], NULL, 10);
+  if (max_keys < 1000) {
+    fprintf(stderr, "Usage: %s [max_keys >= 1000]\n", argv[0]);
+    return 1;
+  }
+
+  char **keys = calloc(max_keys, sizeof(*keys));
+  char **lookup = calloc(max_keys, sizeof(*lookup));
+  if ((keys == NULL) || (lookup == NULL)) {
+    fprintf(stderr, "calloc failed\n");
+    return 1;
+  }
+
+  printf("%-8s %9s %10s %10s %10s %10s\n", "", "keys", "insert", "lookup",
+         "iterate", "remove");
+  printf("%-8s %9s %10s %10s %10s %10s\n", "", "", "ns/key", "ns/key",
+         "ns/key", "ns/key");
+
+  for (size_t keys_num = 1000; keys_num <= max_keys; keys_num *= 10) {
+    for (size_t i = 0; i < keys_num; i++) {
+      char buffer[128];
+      snprintf(buffer, sizeof(buffer),
+               "host%06zu.example.com/cpu-%zu/cpu-idle", i / 64, i % 64);
+      if ((keys[i] = strdup(buffer)) == NULL) {
+        fprintf(stderr, "strdup failed\n");
+        return 1;
+      }
+    }
+    shuffle(keys, keys_num);
+    memcpy(lookup, keys, keys_num * sizeof(*keys));
+    shuffle(lookup, keys_num);
+
+    for (size_t i = 0; i < STATIC_ARRAY_SIZE(containers); i++) {
+      int status = bench_one(containers + i, keys, lookup, keys_num);
+      if (status != 0) {
+        fprintf(stderr, "%s failed with status %d\n", containers[i].name,
+                status);
+        return 1;
+      }
+    }
+
+    for (size_t i = 0; i < keys_num; i++)
+      free(keys[i]);
+  }
+
+  free(keys);
+  free(lookup);
+  return 0;
+}
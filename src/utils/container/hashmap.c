@@ -0,0 +1,310 @@
+/**
+ * collectd - src/utils/container/hashmap.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/container/hashmap.h"
+
+#define HASHMAP_SIZE_INIT 16
+
+/*
+ * private data types
+ */
+struct c_hashmap_entry_s {
+  /* NULL marks an empty slot. */
+  void *key;
+  void *value;
+  uint64_t hash;
+};
+typedef struct c_hashmap_entry_s c_hashmap_entry_t;
+
+struct c_hashmap_s {
+  /* "entries_size" is a power of two and the table is kept at most 3/4
+   * full, so that probe sequences stay short. */
+  c_hashmap_entry_t *entries;
+  size_t entries_size;
+  size_t entries_num;
+
+  uint64_t (*hash)(const void *);
+  int (*compare)(const void *, const void *);
+
+  /* Where c_hashmap_pick() continues searching for an entry. */
+  size_t pick_position;
+};
+
+struct c_hashmap_iterator_s {
+  c_hashmap_t *map;
+  size_t position;
+};
+
+/*
+ * private functions
+ */
+static c_hashmap_entry_t *hashmap_lookup(c_hashmap_t *h, const void *key,
+                                         uint64_t hash) {
+  if (h->entries_num == 0)
+    return NULL;
+
+  size_t mask = h->entries_size - 1;
+  for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask) {
+    c_hashmap_entry_t *e = h->entries + i;
+    if (e->key == NULL)
+      return NULL;
+    if ((e->hash == hash) && (h->compare(key, e->key) == 0))
+      return e;
+  }
+} /* c_hashmap_entry_t *hashmap_lookup */
+
+/* Stores an entry which is known not to exist yet. */
+static void hashmap_store(c_hashmap_t *h, void *key, void *value,
+                          uint64_t hash) {
+  size_t mask = h->entries_size - 1;
+  size_t i = (size_t)hash & mask;
+
+  while (h->entries[i].key != NULL)
+    i = (i + 1) & mask;
+
+  h->entries[i] = (c_hashmap_entry_t){
+      .key = key,
+      .value = value,
+      .hash = hash,
+  };
+  h->entries_num++;
+} /* void hashmap_store */
+
+static int hashmap_resize(c_hashmap_t *h, size_t size) {
+  c_hashmap_entry_t *old = h->entries;
+  size_t old_size = h->entries_size;
+
+  c_hashmap_entry_t *entries = calloc(size, sizeof(*entries));
+  if (entries == NULL)
+    return -1;
+
+  h->entries = entries;
+  h->entries_size = size;
+  h->entries_num = 0;
+  h->pick_position = 0;
+
+  for (size_t i = 0; i < old_size; i++)
+    if (old[i].key != NULL)
+      hashmap_store(h, old[i].key, old[i].value, old[i].hash);
+
+  free(old);
+  return 0;
+} /* int hashmap_resize */
+
+/* Removes the entry in slot "i". The following entries of the probe sequence
+ * are moved back, so that no "deleted" markers are needed. */
+static void hashmap_delete(c_hashmap_t *h, size_t i) {
+  size_t mask = h->entries_size - 1;
+
+  for (size_t j = (i + 1) & mask; h->entries[j].key != NULL;
+       j = (j + 1) & mask) {
+    size_t home = (size_t)h->entries[j].hash & mask;
+
+    /* The entry in slot "j" may only move to slot "i" if its home slot is not
+     * in the (cyclic) range (i, j]. */
+    bool in_range = (i <= j) ? ((i < home) && (home <= j))
+                             : ((i < home) || (home <= j));
+    if (in_range)
+      continue;
+
+    h->entries[i] = h->entries[j];
+    i = j;
+  }
+
+  h->entries[i] = (c_hashmap_entry_t){0};
+  h->entries_num--;
+} /* void hashmap_delete */
+
+/*
+ * public functions
+ */
+c_hashmap_t *c_hashmap_create(uint64_t (*hash)(const void *),
+                              int (*compare)(const void *, const void *)) {
+  c_hashmap_t *h;
+
+  if ((hash == NULL) || (compare == NULL))
+    return NULL;
+
+  if ((h = calloc(1, sizeof(*h))) == NULL)
+    return NULL;
+
+  h->hash = hash;
+  h->compare = compare;
+
+  return h;
+} /* c_hashmap_t *c_hashmap_create */
+
+/* FNV-1a, followed by the finalizer of MurmurHash3 so that the low bits,
+ * which select the slot, depend on all bytes of the string. */
+uint64_t c_hashmap_hash_string(const void *key) {
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (const unsigned char *ptr = key; *ptr != 0; ptr++) {
+    hash ^= (uint64_t)*ptr;
+    hash *= 1099511628211ULL;
+  }
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+
+  return hash;
+} /* uint64_t c_hashmap_hash_string */
+
+void c_hashmap_destroy(c_hashmap_t *h) {
+  if (h == NULL)
+    return;
+
+  free(h->entries);
+  free(h);
+} /* void c_hashmap_destroy */
+
+int c_hashmap_insert(c_hashmap_t *h, void *key, void *value) {
+  assert(h != NULL);
+
+  if (key == NULL)
+    return -1;
+
+  uint64_t hash = h->hash(key);
+  if (hashmap_lookup(h, key, hash) != NULL)
+    return 1;
+
+  if (4 * (h->entries_num + 1) > 3 * h->entries_size) {
+    size_t size = (h->entries_size == 0) ? HASHMAP_SIZE_INIT
+                                         : 2 * h->entries_size;
+    if (hashmap_resize(h, size) != 0)
+      return -1;
+  }
+
+  hashmap_store(h, key, value, hash);
+  return 0;
+} /* int c_hashmap_insert */
+
+int c_hashmap_remove(c_hashmap_t *h, const void *key, void **rkey,
+                     void **rvalue) {
+  assert(h != NULL);
+
+  if (key == NULL)
+    return -1;
+
+  c_hashmap_entry_t *e = hashmap_lookup(h, key, h->hash(key));
+  if (e == NULL)
+    return -1;
+
+  if (rkey != NULL)
+    *rkey = e->key;
+  if (rvalue != NULL)
+    *rvalue = e->value;
+
+  hashmap_delete(h, (size_t)(e - h->entries));
+  return 0;
+} /* int c_hashmap_remove */
+
+int c_hashmap_get(c_hashmap_t *h, const void *key, void **value) {
+  assert(h != NULL);
+
+  if (key == NULL)
+    return -1;
+
+  c_hashmap_entry_t *e = hashmap_lookup(h, key, h->hash(key));
+  if (e == NULL)
+    return -1;
+
+  if (value != NULL)
+    *value = e->value;
+  return 0;
+} /* int c_hashmap_get */
+
+int c_hashmap_pick(c_hashmap_t *h, void **key, void **value) {
+  assert(h != NULL);
+
+  if ((key == NULL) || (value == NULL))
+    return -1;
+  if (h->entries_num == 0)
+    return -1;
+
+  /* Continue where the previous call stopped, so that emptying the map one
+   * entry at a time does not scan the start of the table over and over. */
+  size_t i = h->pick_position;
+  while (h->entries[i].key == NULL)
+    i = (i + 1) & (h->entries_size - 1);
+
+  *key = h->entries[i].key;
+  *value = h->entries[i].value;
+  hashmap_delete(h, i);
+  h->pick_position = i;
+
+  return 0;
+} /* int c_hashmap_pick */
+
+c_hashmap_iterator_t *c_hashmap_get_iterator(c_hashmap_t *h) {
+  c_hashmap_iterator_t *iter;
+
+  if (h == NULL)
+    return NULL;
+
+  iter = calloc(1, sizeof(*iter));
+  if (iter == NULL)
+    return NULL;
+  iter->map = h;
+
+  return iter;
+} /* c_hashmap_iterator_t *c_hashmap_get_iterator */
+
+int c_hashmap_iterator_next(c_hashmap_iterator_t *iter, void **key,
+                            void **value) {
+  if ((iter == NULL) || (key == NULL) || (value == NULL))
+    return -1;
+
+  c_hashmap_t *h = iter->map;
+  while (iter->position < h->entries_size) {
+    c_hashmap_entry_t *e = h->entries + iter->position;
+    iter->position++;
+
+    if (e->key != NULL) {
+      *key = e->key;
+      *value = e->value;
+      return 0;
+    }
+  }
+
+  return -1;
+} /* int c_hashmap_iterator_next */
+
+void c_hashmap_iterator_destroy(c_hashmap_iterator_t *iter) { free(iter); }
+
+int c_hashmap_size(c_hashmap_t *h) {
+  if (h == NULL)
+    return 0;
+  return (int)h->entries_num;
+}
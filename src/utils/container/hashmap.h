@@ -0,0 +1,164 @@
+/**
+ * collectd - src/utils/container/hashmap.h
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#ifndef UTILS_CONTAINER_HASHMAP_H
+#define UTILS_CONTAINER_HASHMAP_H 1
+
+#include <stdint.h>
+
+/*
+ * The hash map is an unordered map with the same interface as the AVL-tree in
+ * "utils/avltree/avltree.h", minus the functions that depend on the order of
+ * keys. It uses open addressing with linear probing, so a lookup usually
+ * touches a single cache line of the table and calls `compare' once. It is
+ * the better choice for maps that are never iterated in order, such as
+ * lookups by name.
+ *
+ * Keys must not be NULL.
+ */
+
+struct c_hashmap_s;
+typedef struct c_hashmap_s c_hashmap_t;
+
+struct c_hashmap_iterator_s;
+typedef struct c_hashmap_iterator_s c_hashmap_iterator_t;
+
+/*
+ * NAME
+ *   c_hashmap_create
+ *
+ * DESCRIPTION
+ *   Allocates a new hash map.
+ *
+ * PARAMETERS
+ *   `hash'     Function returning the hash of a key. Keys that compare equal
+ *              must have the same hash. For char-pointer keys, use
+ *              `c_hashmap_hash_string'.
+ *   `compare'  Function comparing two keys. It has to return zero if and only
+ *              if the keys are equal, so `strcmp' can be used for strings.
+ *
+ * RETURN VALUE
+ *   A c_hashmap_t-pointer upon success or NULL upon failure.
+ */
+c_hashmap_t *c_hashmap_create(uint64_t (*hash)(const void *),
+                              int (*compare)(const void *, const void *));
+
+/*
+ * NAME
+ *   c_hashmap_hash_string
+ *
+ * DESCRIPTION
+ *   Hash function for null-terminated strings.
+ */
+uint64_t c_hashmap_hash_string(const void *key);
+
+/*
+ * NAME
+ *   c_hashmap_destroy
+ *
+ * DESCRIPTION
+ *   Deallocates a hash map. Stored value- and key-pointer are lost, but of
+ *   course not freed.
+ */
+void c_hashmap_destroy(c_hashmap_t *h);
+
+/*
+ * NAME
+ *   c_hashmap_insert
+ *
+ * DESCRIPTION
+ *   Stores the key-value-pair in the hash map. The key pointer is stored and
+ *   _not_ copied.
+ *
+ * RETURN VALUE
+ *   Zero upon success, non-zero otherwise. It's less than zero if an error
+ *   occurred or greater than zero if the key is already stored in the map.
+ */
+int c_hashmap_insert(c_hashmap_t *h, void *key, void *value);
+
+/*
+ * NAME
+ *   c_hashmap_remove
+ *
+ * DESCRIPTION
+ *   Removes a key-value-pair from the hash map. The stored key and value may
+ *   be returned in `rkey' and `rvalue'.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the key isn't found in the map.
+ */
+int c_hashmap_remove(c_hashmap_t *h, const void *key, void **rkey,
+                     void **rvalue);
+
+/*
+ * NAME
+ *   c_hashmap_get
+ *
+ * DESCRIPTION
+ *   Retrieve the `value' belonging to `key'. `value' may be NULL.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the key isn't found in the map.
+ */
+int c_hashmap_get(c_hashmap_t *h, const void *key, void **value);
+
+/*
+ * NAME
+ *   c_hashmap_pick
+ *
+ * DESCRIPTION
+ *   Remove an arbitrary element from the map and return its `key' and
+ *   `value'.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the map is empty or key or value is
+ *   NULL.
+ */
+int c_hashmap_pick(c_hashmap_t *h, void **key, void **value);
+
+/*
+ * NAME
+ *   c_hashmap_get_iterator, c_hashmap_iterator_next
+ *
+ * DESCRIPTION
+ *   Iterates over all entries in no particular order. The map must not be
+ *   modified while an iterator is in use.
+ */
+c_hashmap_iterator_t *c_hashmap_get_iterator(c_hashmap_t *h);
+int c_hashmap_iterator_next(c_hashmap_iterator_t *iter, void **key,
+                            void **value);
+void c_hashmap_iterator_destroy(c_hashmap_iterator_t *iter);
+
+/*
+ * NAME
+ *   c_hashmap_size
+ *
+ * RETURN VALUE
+ *   Number of entries in the map, 0 if the map is empty or NULL.
+ */
+int c_hashmap_size(c_hashmap_t *h);
+
+#endif /* UTILS_CONTAINER_HASHMAP_H */
@@ -0,0 +1,211 @@
+/**
+ * collectd - src/utils/container/hashmap_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include "collectd.h"
+#include "utils/common/common.h" /* STATIC_ARRAY_SIZE */
+
+#include "testing.h"
+#include "utils/container/hashmap.h"
+
+DEF_TEST(success) {
+  struct {
+    char *key;
+    char *value;
+  } cases[] = {
+      {"Eeph7chu", "vai1reiV"}, {"igh3Paiz", "teegh1Ee"},
+      {"caip6Uu8", "ooteQu8n"}, {"Aech6vah", "AijeeT0l"},
+      {"Xah0et2L", "gah8Taep"}, {"BocaeB8n", "oGaig8io"},
+      {"thai8AhM", "ohjeFo3f"}, {"ohth6ieC", "hoo8ieWo"},
+      {"aej7Woow", "phahuC2s"}, {"Hai8ier2", "Yie6eimi"},
+      {"phuXi3Li", "JaiF7ieb"}, {"Shaig5ef", "aihi5Zai"},
+      {"voh6Aith", "Oozaeto0"}, {"zaiP5kie", "seep5veM"},
+      {"pae7ba7D", "chie8Ojo"}, {"Gou2ril3", "ouVoo0ha"},
+      {"lo3Thee3", "ahDu4Zuj"}, {"Rah8kohv", "ieShoc7E"},
+      {"ieN5engi", "Aevou1ah"}, {"ooTe4OhP", "aingai5Y"},
+  };
+
+  c_hashmap_t *h;
+  CHECK_NOT_NULL(h = c_hashmap_create(c_hashmap_hash_string,
+                                      (int (*)(const void *,
+                                               const void *))strcmp));
+
+  /* insert */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    char *key;
+    char *value;
+
+    CHECK_NOT_NULL(key = strdup(cases[i].key));
+    CHECK_NOT_NULL(value = strdup(cases[i].value));
+
+    CHECK_ZERO(c_hashmap_insert(h, key, value));
+    EXPECT_EQ_INT((int)(i + 1), c_hashmap_size(h));
+  }
+
+  /* Key already exists. */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++)
+    EXPECT_EQ_INT(1, c_hashmap_insert(h, cases[i].key, cases[i].value));
+
+  /* get */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    char *value_ret = NULL;
+
+    CHECK_ZERO(c_hashmap_get(h, cases[i].key, (void *)&value_ret));
+    EXPECT_EQ_STR(cases[i].value, value_ret);
+  }
+  EXPECT_EQ_INT(-1, c_hashmap_get(h, "doesnt exist", NULL));
+
+  /* iterate */
+  {
+    c_hashmap_iterator_t *iter = c_hashmap_get_iterator(h);
+    char *key;
+    char *value;
+    size_t i = 0;
+    while (c_hashmap_iterator_next(iter, (void **)&key, (void **)&value) ==
+           0) {
+      char *want = NULL;
+      CHECK_ZERO(c_hashmap_get(h, key, (void *)&want));
+      EXPECT_EQ_STR(want, value);
+      i++;
+    }
+    c_hashmap_iterator_destroy(iter);
+    EXPECT_EQ_INT(STATIC_ARRAY_SIZE(cases), i);
+  }
+
+  /* remove half */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases) / 2; i++) {
+    char *key = NULL;
+    char *value = NULL;
+
+    int expected_size = (int)(STATIC_ARRAY_SIZE(cases) - (i + 1));
+
+    CHECK_ZERO(c_hashmap_remove(h, cases[i].key, (void *)&key, (void *)&value));
+
+    EXPECT_EQ_STR(cases[i].key, key);
+    EXPECT_EQ_STR(cases[i].value, value);
+
+    free(key);
+    free(value);
+
+    EXPECT_EQ_INT(expected_size, c_hashmap_size(h));
+    EXPECT_EQ_INT(-1, c_hashmap_remove(h, cases[i].key, NULL, NULL));
+  }
+
+  /* pick the other half */
+  for (size_t i = STATIC_ARRAY_SIZE(cases) / 2; i < STATIC_ARRAY_SIZE(cases);
+       i++) {
+    char *key = NULL;
+    char *value = NULL;
+
+    int expected_size = (int)(STATIC_ARRAY_SIZE(cases) - (i + 1));
+
+    EXPECT_EQ_INT(0, c_hashmap_pick(h, (void *)&key, (void *)&value));
+
+    free(key);
+    free(value);
+
+    EXPECT_EQ_INT(expected_size, c_hashmap_size(h));
+  }
+  EXPECT_EQ_INT(-1, c_hashmap_pick(h, (void *)&cases[0].key,
+                                   (void *)&cases[0].value));
+
+  c_hashmap_destroy(h);
+
+  return 0;
+}
+
+static uint64_t hash_int(void const *key) {
+  /* A bad hash function causes long probe sequences, which exercises moving
+   * entries back on removal. */
+  return (uint64_t)(*(int const *)key / 16);
+}
+
+static int compare_int(void const *a, void const *b) {
+  return *(int const *)a != *(int const *)b;
+}
+
+#define RANDOM_KEYS 5000
+
+DEF_TEST(random) {
+  static int keys[RANDOM_KEYS];
+  static bool present[RANDOM_KEYS];
+  int size = 0;
+  int errors = 0;
+
+  for (int i = 0; i < RANDOM_KEYS; i++)
+    keys[i] = i;
+
+  c_hashmap_t *h;
+  CHECK_NOT_NULL(h = c_hashmap_create(hash_int, compare_int));
+
+  srand(42);
+  for (int round = 0; round < 10 * RANDOM_KEYS; round++) {
+    int k = rand() % RANDOM_KEYS;
+    void *rkey = NULL;
+
+    if (present[k]) {
+      if ((c_hashmap_remove(h, keys + k, &rkey, NULL) != 0) ||
+          (rkey != keys + k))
+        errors++;
+      size--;
+    } else {
+      if (c_hashmap_insert(h, keys + k, keys + k) != 0)
+        errors++;
+      size++;
+    }
+    present[k] = !present[k];
+  }
+  EXPECT_EQ_INT(0, errors);
+  EXPECT_EQ_INT(size, c_hashmap_size(h));
+
+  for (int i = 0; i < RANDOM_KEYS; i++) {
+    void *value = NULL;
+    int status = c_hashmap_get(h, keys + i, &value);
+    if (present[i] ? ((status != 0) || (value != keys + i)) : (status == 0))
+      errors++;
+  }
+  EXPECT_EQ_INT(0, errors);
+
+  int *key;
+  void *value;
+  while (c_hashmap_pick(h, (void *)&key, &value) == 0) {
+    if (!present[*key])
+      errors++;
+    present[*key] = false;
+    size--;
+  }
+  EXPECT_EQ_INT(0, errors);
+  EXPECT_EQ_INT(0, size);
+
+  c_hashmap_destroy(h);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(success);
+  RUN_TEST(random);
+
+  END_TEST;
+}
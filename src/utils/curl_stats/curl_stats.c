@@ -50,6 +50,10 @@ struct curl_stats_s {
   bool redirect_count;
   bool num_connects;
   bool appconnect_time;
+
+  /* Statistics about asynchronous requests, see curl_stats_dispatch_queue. */
+  bool in_flight;
+  bool queue_time;
 };
 
 /*
@@ -211,6 +215,16 @@ static struct {
 #undef SPEC
 };
 
+/* Fields not backed by curl_easy_getinfo(). */
+static struct {
+  const char *name;
+  const char *config_key;
+  size_t offset;
+} queue_field_specs[] = {
+    {"in_flight", "InFlight", offsetof(curl_stats_t, in_flight)},
+    {"queue_time", "QueueTime", offsetof(curl_stats_t, queue_time)},
+};
+
 static void enable_field(curl_stats_t *s, size_t offset) {
   *(bool *)((char *)s + offset) = true;
 } /* enable_field */
@@ -244,10 +258,22 @@ curl_stats_t *curl_stats_from_config(oconfig_item_t *ci) {
       if (!strcasecmp(c->key, field_specs[field].name))
         break;
     }
-    if (field >= STATIC_ARRAY_SIZE(field_specs)) {
-      ERROR("curl stats: Unknown field name %s", c->key);
-      free(s);
-      return NULL;
+    size_t offset = 0;
+    if (field < STATIC_ARRAY_SIZE(field_specs)) {
+      offset = field_specs[field].offset;
+    } else {
+      for (field = 0; field < STATIC_ARRAY_SIZE(queue_field_specs); ++field) {
+        if (!strcasecmp(c->key, queue_field_specs[field].config_key))
+          break;
+        if (!strcasecmp(c->key, queue_field_specs[field].name))
+          break;
+      }
+      if (field >= STATIC_ARRAY_SIZE(queue_field_specs)) {
+        ERROR("curl stats: Unknown field name %s", c->key);
+        free(s);
+        return NULL;
+      }
+      offset = queue_field_specs[field].offset;
     }
 
     if (cf_util_get_boolean(c, &enabled) != 0) {
@@ -255,7 +281,7 @@ curl_stats_t *curl_stats_from_config(oconfig_item_t *ci) {
       return NULL;
     }
     if (enabled)
-      enable_field(s, field_specs[field].offset);
+      enable_field(s, offset);
   }
 
   return s;
@@ -304,3 +330,47 @@ int curl_stats_dispatch(curl_stats_t *s, CURL *curl, const char *hostname,
 
   return 0;
 } /* curl_stats_dispatch */
+
+int curl_stats_dispatch_queue(curl_stats_t *s, size_t in_flight,
+                              cdtime_t queue_time, const char *hostname,
+                              const char *plugin,
+                              const char *plugin_instance) {
+  value_list_t vl = VALUE_LIST_INIT;
+
+  if (s == NULL)
+    return 0;
+  if (plugin == NULL) {
+    ERROR("curl stats: dispatch_queue() called with missing arguments "
+          "(plugin=<NULL>)");
+    return -1;
+  }
+
+  if (hostname != NULL)
+    sstrncpy(vl.host, hostname, sizeof(vl.host));
+  sstrncpy(vl.plugin, plugin, sizeof(vl.plugin));
+  if (plugin_instance != NULL)
+    sstrncpy(vl.plugin_instance, plugin_instance, sizeof(vl.plugin_instance));
+  vl.values_len = 1;
+
+  if (s->in_flight) {
+    vl.values = &(value_t){.gauge = (gauge_t)in_flight};
+    sstrncpy(vl.type, "queue_length", sizeof(vl.type));
+    sstrncpy(vl.type_instance, "in_flight", sizeof(vl.type_instance));
+
+    int status = plugin_dispatch_values(&vl);
+    if (status < 0)
+      return status;
+  }
+
+  if (s->queue_time) {
+    vl.values = &(value_t){.gauge = CDTIME_T_TO_DOUBLE(queue_time)};
+    sstrncpy(vl.type, "duration", sizeof(vl.type));
+    sstrncpy(vl.type_instance, "queue_time", sizeof(vl.type_instance));
+
+    int status = plugin_dispatch_values(&vl);
+    if (status < 0)
+      return status;
+  }
+
+  return 0;
+} /* curl_stats_dispatch_queue */
@@ -53,4 +53,13 @@ void curl_stats_destroy(curl_stats_t *s);
 int curl_stats_dispatch(curl_stats_t *s, CURL *curl, const char *hostname,
                         const char *plugin, const char *plugin_instance);
 
+/*
+ * curl_stats_dispatch_queue dispatches statistics of plugins sending requests
+ * asynchronously: the number of requests in flight ("InFlight") and the time
+ * between queuing a request and its completion ("QueueTime").
+ */
+int curl_stats_dispatch_queue(curl_stats_t *s, size_t in_flight,
+                              cdtime_t queue_time, const char *hostname,
+                              const char *plugin, const char *plugin_instance);
+
 #endif /* UTILS_CURL_STATS_H */
@@ -0,0 +1,219 @@
+/**
+ * collectd - src/utils/format_cache/format_bench.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+/* format_bench compares the legacy formatting interface, which formats each
+ * value list into a temporary buffer that is then copied into the send
+ * buffer, with formatting directly into the send buffer using a format
+ * cache. It is not run as part of "make check"; build it with
+ * "make bench_format" and run "./bench_format [iterations]". */
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "utils/format_cache/format_cache.h"
+#include "utils/format_graphite/format_graphite.h"
+#include "utils/format_influxdb/format_influxdb.h"
+#include "utils/format_json/format_json.h"
+#include "utils/strbuf/strbuf.h"
+
+#include <time.h>
+
+#define BENCH_IDENTIFIERS 1000
+#define BENCH_SEND_BUFFER_SIZE 65536
+
+static data_set_t ds_bench = {
+    .type = "bench",
+    .ds_num = 2,
+    .ds =
+        (data_source_t[]){
+            {"rx", DS_TYPE_GAUGE, NAN, NAN},
+            {"tx", DS_TYPE_GAUGE, NAN, NAN},
+        },
+};
+
+static value_list_t vl_bench[BENCH_IDENTIFIERS];
+static value_t values_bench[BENCH_IDENTIFIERS][2];
+
+static char send_buffer[BENCH_SEND_BUFFER_SIZE];
+
+typedef int (*bench_func_t)(strbuf_t *buf, value_list_t const *vl,
+                            format_cache_t *cache);
+
+static int bench_graphite_legacy(strbuf_t *buf, value_list_t const *vl,
+                                 __attribute__((unused))
+                                 format_cache_t *cache) {
+  char tmp[1024];
+  int status = format_graphite(tmp, sizeof(tmp), &ds_bench, vl, NULL, NULL,
+                               '_', 0);
+  if (status != 0)
+    return status;
+  return -strbuf_print(buf, tmp);
+}
+
+static int bench_graphite(strbuf_t *buf, value_list_t const *vl,
+                          format_cache_t *cache) {
+  return format_graphite_strbuf(buf, &ds_bench, vl, NULL, NULL, '_', 0, cache);
+}
+
+static int bench_json_legacy(strbuf_t *buf, value_list_t const *vl,
+                             __attribute__((unused)) format_cache_t *cache) {
+  char tmp[1024];
+  size_t tmp_fill = 0;
+  size_t tmp_free = sizeof(tmp);
+
+  format_json_initialize(tmp, &tmp_fill, &tmp_free);
+  int status = format_json_value_list(tmp, &tmp_fill, &tmp_free, &ds_bench, vl,
+                                      /* store_rates = */ false);
+  if (status != 0)
+    return status;
+  return -strbuf_print(buf, tmp);
+}
+
+static int bench_json(strbuf_t *buf, value_list_t const *vl,
+                      format_cache_t *cache) {
+  return format_json_value_list_strbuf(buf, &ds_bench, vl,
+                                       /* store_rates = */ false, cache);
+}
+
+static int bench_influxdb_legacy(strbuf_t *buf, value_list_t const *vl,
+                                 __attribute__((unused))
+                                 format_cache_t *cache) {
+  char tmp[1024];
+  int status = format_influxdb_value_list(tmp, sizeof(tmp), &ds_bench, vl, NS,
+                                          /* store_rates = */ false,
+                                          /* write_meta = */ false);
+  if (status < 0)
+    return status;
+  return -strbuf_printn(buf, tmp, (size_t)status);
+}
+
+static int bench_influxdb(strbuf_t *buf, value_list_t const *vl,
+                          format_cache_t *cache) {
+  return format_influxdb_value_list_strbuf(buf, &ds_bench, vl, NS,
+                                           /* store_rates = */ false,
+                                           /* write_meta = */ false, cache);
+}
+
+static double monotonic_seconds(void) {
+  struct timespec ts = {0};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+static int run_bench(char const *name, bench_func_t func, bool use_cache,
+                     size_t iterations) {
+  format_cache_t *cache = NULL;
+  if (use_cache) {
+    cache = format_cache_create(0);
+    if (cache == NULL) {
+      fprintf(stderr, "format_cache_create failed\n");
+      return ENOMEM;
+    }
+  }
+
+  strbuf_t *buf = STRBUF_CREATE_STATIC(send_buffer);
+  size_t bytes = 0;
+
+  double start = monotonic_seconds();
+  for (size_t i = 0; i < iterations; i++) {
+    value_list_t *vl = vl_bench + (i % BENCH_IDENTIFIERS);
+    vl->values[0].gauge = (gauge_t)i;
+    vl->values[1].gauge = (gauge_t)i / 3.0;
+
+    size_t pos = buf->pos;
+    int status = func(buf, vl, cache);
+    if (status == -ENOSPC) {
+      /* "Send" the buffer. */
+      bytes += buf->pos;
+      strbuf_reset(buf);
+      status = func(buf, vl, cache);
+    } else if (status == 0 && buf->pos == pos) {
+      status = EINVAL;
+    }
+    if (status != 0) {
+      fprintf(stderr, "%s: formatting failed with status %d\n", name, status);
+      format_cache_destroy(cache);
+      return -1;
+    }
+  }
+  bytes += buf->pos;
+  double elapsed = monotonic_seconds() - start;
+
+  printf("%-18s %8.1f ns/op %8.1f MB/s\n", name,
+         1e9 * elapsed / (double)iterations, (double)bytes / elapsed / 1e6);
+
+  format_cache_destroy(cache);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  size_t iterations = 1000000;
+  if (argc > 1)
+    iterations = (size_t)strtoull(argv[1], NULL, 10);
+  if (iterations == 0) {
+    fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  for (size_t i = 0; i < BENCH_IDENTIFIERS; i++) {
+    value_list_t *vl = vl_bench + i;
+    *vl = (value_list_t){
+        .values = values_bench[i],
+        .values_len = 2,
+        .time = TIME_T_TO_CDTIME_T_STATIC(1480063672),
+        .interval = TIME_T_TO_CDTIME_T_STATIC(10),
+        .plugin = "interface",
+        .type = "bench",
+    };
+    ssnprintf(vl->host, sizeof(vl->host), "host%03zu.example.com", i % 100);
+    ssnprintf(vl->plugin_instance, sizeof(vl->plugin_instance), "eth%zu",
+              i / 100);
+  }
+
+  struct {
+    char const *name;
+    bench_func_t func;
+    bool use_cache;
+  } benchmarks[] = {
+      {"graphite/legacy", bench_graphite_legacy, false},
+      {"graphite/strbuf", bench_graphite, false},
+      {"graphite/cache", bench_graphite, true},
+      {"json/legacy", bench_json_legacy, false},
+      {"json/strbuf", bench_json, false},
+      {"json/cache", bench_json, true},
+      {"influxdb/legacy", bench_influxdb_legacy, false},
+      {"influxdb/strbuf", bench_influxdb, false},
+      {"influxdb/cache", bench_influxdb, true},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(benchmarks); i++) {
+    if (run_bench(benchmarks[i].name, benchmarks[i].func,
+                  benchmarks[i].use_cache, iterations) != 0)
+      return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,218 @@
+/**
+ * collectd - src/utils/format_cache/format_cache.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include "collectd.h"
+
+#include "utils/avltree/avltree.h"
+#include "utils/common/common.h"
+#include "utils/format_cache/format_cache.h"
+
+/* The lookup key is the concatenation of the five identifier fields, each
+ * prefixed with its length. Unlike the "host/plugin-instance/..." string
+ * this is unambiguous and can be built without calling snprintf(). A hash of
+ * the key is computed alongside, so that most comparisons in the tree are
+ * decided without touching the key itself. */
+#define FORMAT_CACHE_KEY_SIZE (5 * DATA_MAX_NAME_LEN)
+
+typedef struct {
+  uint64_t hash;
+  size_t key_len;
+
+  char *fragment;
+  size_t fragment_len;
+
+  char key[];
+} format_cache_entry_t;
+
+struct format_cache_s {
+  c_avl_tree_t *tree;
+  size_t max_entries;
+};
+
+static int format_cache_compare(void const *a, void const *b) {
+  format_cache_entry_t const *ea = a;
+  format_cache_entry_t const *eb = b;
+
+  if (ea->hash != eb->hash)
+    return (ea->hash < eb->hash) ? -1 : 1;
+  if (ea->key_len != eb->key_len)
+    return (ea->key_len < eb->key_len) ? -1 : 1;
+  return memcmp(ea->key, eb->key, ea->key_len);
+}
+
+/* format_cache_key builds the key for "vl" in "e", which must have room for
+ * FORMAT_CACHE_KEY_SIZE bytes of key. */
+static void format_cache_key(format_cache_entry_t *e, value_list_t const *vl) {
+  char const *fields[] = {vl->host, vl->plugin, vl->plugin_instance, vl->type,
+                          vl->type_instance};
+  /* FNV-1a */
+  uint64_t hash = 14695981039346656037ULL;
+  size_t len = 0;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++) {
+    char const *field = fields[i];
+    size_t field_start = len++;
+
+    /* Fields are null terminated within DATA_MAX_NAME_LEN bytes, so the
+     * length fits into a single byte. */
+    for (size_t j = 0; (j < DATA_MAX_NAME_LEN - 1) && (field[j] != 0); j++) {
+      e->key[len++] = field[j];
+      hash = (hash ^ (uint8_t)field[j]) * 1099511628211ULL;
+    }
+
+    e->key[field_start] = (char)(len - field_start - 1);
+    hash = (hash ^ (uint8_t)e->key[field_start]) * 1099511628211ULL;
+  }
+
+  e->hash = hash;
+  e->key_len = len;
+}
+
+static void format_cache_entry_free(format_cache_entry_t *e) {
+  if (e == NULL)
+    return;
+
+  free(e->fragment);
+  free(e);
+}
+
+static void format_cache_clear(format_cache_t *cache) {
+  void *key;
+  void *value;
+
+  while (c_avl_pick(cache->tree, &key, &value) == 0)
+    format_cache_entry_free(value);
+}
+
+format_cache_t *format_cache_create(size_t max_entries) {
+  format_cache_t *cache = calloc(1, sizeof(*cache));
+  if (cache == NULL)
+    return NULL;
+
+  cache->tree = c_avl_create(format_cache_compare);
+  if (cache->tree == NULL) {
+    free(cache);
+    return NULL;
+  }
+
+  cache->max_entries =
+      (max_entries > 0) ? max_entries : FORMAT_CACHE_DEFAULT_SIZE;
+  return cache;
+}
+
+void format_cache_destroy(format_cache_t *cache) {
+  if (cache == NULL)
+    return;
+
+  format_cache_clear(cache);
+  c_avl_destroy(cache->tree);
+  free(cache);
+}
+
+/* format_cache_search_t holds a lookup key on the stack. */
+typedef union {
+  format_cache_entry_t entry;
+  char buffer[sizeof(format_cache_entry_t) + FORMAT_CACHE_KEY_SIZE];
+} format_cache_search_t;
+
+static format_cache_entry_t *format_cache_lookup(format_cache_t *cache,
+                                                 format_cache_entry_t *search) {
+  format_cache_entry_t *e = NULL;
+  if (c_avl_get(cache->tree, search, (void *)&e) != 0)
+    return NULL;
+  return e;
+}
+
+int format_cache_get(format_cache_t *cache, value_list_t const *vl,
+                     char const **ret_fragment, size_t *ret_fragment_len) {
+  if ((cache == NULL) || (vl == NULL) || (ret_fragment == NULL) ||
+      (ret_fragment_len == NULL))
+    return EINVAL;
+
+  format_cache_search_t search;
+  format_cache_key(&search.entry, vl);
+
+  format_cache_entry_t *e = format_cache_lookup(cache, &search.entry);
+  if (e == NULL)
+    return ENOENT;
+
+  *ret_fragment = e->fragment;
+  *ret_fragment_len = e->fragment_len;
+  return 0;
+}
+
+int format_cache_put(format_cache_t *cache, value_list_t const *vl,
+                     char const *fragment, size_t fragment_len) {
+  if ((cache == NULL) || (vl == NULL) || (fragment == NULL))
+    return EINVAL;
+
+  char *copy = malloc(fragment_len + 1);
+  if (copy == NULL)
+    return ENOMEM;
+  memcpy(copy, fragment, fragment_len);
+  copy[fragment_len] = 0;
+
+  format_cache_search_t search;
+  format_cache_key(&search.entry, vl);
+
+  format_cache_entry_t *e = format_cache_lookup(cache, &search.entry);
+  if (e != NULL) {
+    free(e->fragment);
+    e->fragment = copy;
+    e->fragment_len = fragment_len;
+    return 0;
+  }
+
+  /* Identifiers come and go; rather than tracking usage per entry, start
+   * over once the cache is full. Active identifiers are re-added within one
+   * interval. */
+  if ((size_t)c_avl_size(cache->tree) >= cache->max_entries)
+    format_cache_clear(cache);
+
+  e = malloc(sizeof(*e) + search.entry.key_len);
+  if (e == NULL) {
+    free(copy);
+    return ENOMEM;
+  }
+  memcpy(e, &search.entry, sizeof(*e) + search.entry.key_len);
+  e->fragment = copy;
+  e->fragment_len = fragment_len;
+
+  int status = c_avl_insert(cache->tree, e, e);
+  if (status != 0) {
+    format_cache_entry_free(e);
+    return (status < 0) ? ENOMEM : EEXIST;
+  }
+
+  return 0;
+}
+
+size_t format_cache_size(format_cache_t *cache) {
+  if (cache == NULL)
+    return 0;
+
+  return (size_t)c_avl_size(cache->tree);
+}
@@ -0,0 +1,69 @@
+/**
+ * collectd - src/utils/format_cache/format_cache.h
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#ifndef UTILS_FORMAT_CACHE_H
+#define UTILS_FORMAT_CACHE_H 1
+
+#include "collectd.h"
+
+#include "plugin.h"
+
+/* The format cache stores the escaped, formatter specific representation of
+ * a value list's identifier ("fragment"), so that the escaping and
+ * concatenation is done once per identifier instead of once per value list.
+ *
+ * A cache must only be used with a single formatter and a single set of
+ * formatting options. It is not thread-safe; callers serialize access, for
+ * example with the lock protecting the send buffer. */
+struct format_cache_s;
+typedef struct format_cache_s format_cache_t;
+
+#ifndef FORMAT_CACHE_DEFAULT_SIZE
+#define FORMAT_CACHE_DEFAULT_SIZE 65536
+#endif
+
+/* format_cache_create allocates a new cache holding at most "max_entries"
+ * identifiers. When the limit is reached, the cache is emptied. */
+format_cache_t *format_cache_create(size_t max_entries);
+
+void format_cache_destroy(format_cache_t *cache);
+
+/* format_cache_get looks up the fragment cached for "vl". On success,
+ * "ret_fragment" points to memory owned by the cache which stays valid until
+ * the next call to format_cache_put(). Returns ENOENT if the identifier is
+ * not cached. */
+int format_cache_get(format_cache_t *cache, value_list_t const *vl,
+                     char const **ret_fragment, size_t *ret_fragment_len);
+
+/* format_cache_put stores a copy of "fragment" for "vl", replacing a
+ * previously cached fragment. */
+int format_cache_put(format_cache_t *cache, value_list_t const *vl,
+                     char const *fragment, size_t fragment_len);
+
+/* format_cache_size returns the number of cached identifiers. */
+size_t format_cache_size(format_cache_t *cache);
+
+#endif /* UTILS_FORMAT_CACHE_H */
@@ -63,46 +63,24 @@ void reverse_hostname(char *r_host, char const *orig_host) {
   reverse_string(&r_host[p], len_host - p);
 }
 
-static int gr_format_values(char *ret, size_t ret_len, int ds_num,
-                            const data_set_t *ds, const value_list_t *vl,
-                            gauge_t const *rates) {
-  size_t offset = 0;
-  int status;
-
+static int gr_format_values(strbuf_t *buf, int ds_num, const data_set_t *ds,
+                            const value_list_t *vl, gauge_t const *rates) {
   assert(0 == strcmp(ds->type, vl->type));
 
-  memset(ret, 0, ret_len);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    status = snprintf(ret + offset, ret_len - offset, __VA_ARGS__);            \
-    if (status < 1) {                                                          \
-      return -1;                                                               \
-    } else if (((size_t)status) >= (ret_len - offset)) {                       \
-      return -1;                                                               \
-    } else                                                                     \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
   if (ds->ds[ds_num].type == DS_TYPE_GAUGE)
-    BUFFER_ADD(GAUGE_FORMAT, vl->values[ds_num].gauge);
+    return strbuf_print_gauge(buf, vl->values[ds_num].gauge);
   else if (rates != NULL)
-    BUFFER_ADD("%f", rates[ds_num]);
+    return strbuf_print_fixed(buf, rates[ds_num], 6);
   else if (ds->ds[ds_num].type == DS_TYPE_COUNTER)
-    BUFFER_ADD("%" PRIu64, (uint64_t)vl->values[ds_num].counter);
+    return strbuf_print_uint64(buf, (uint64_t)vl->values[ds_num].counter);
   else if (ds->ds[ds_num].type == DS_TYPE_DERIVE)
-    BUFFER_ADD("%" PRIi64, vl->values[ds_num].derive);
+    return strbuf_print_int64(buf, vl->values[ds_num].derive);
   else if (ds->ds[ds_num].type == DS_TYPE_ABSOLUTE)
-    BUFFER_ADD("%" PRIu64, vl->values[ds_num].absolute);
-  else {
-    P_ERROR("gr_format_values: Unknown data source type: %i",
-            ds->ds[ds_num].type);
-    return -1;
-  }
-
-#undef BUFFER_ADD
+    return strbuf_print_uint64(buf, vl->values[ds_num].absolute);
 
-  return 0;
+  P_ERROR("gr_format_values: Unknown data source type: %i",
+          ds->ds[ds_num].type);
+  return -1;
 }
 
 static void gr_copy_escape_part(char *dst, const char *src, size_t dst_len,
@@ -294,28 +272,17 @@ static void escape_graphite_string(char *buffer, char escape_char) {
     *head = escape_char;
 }
 
-int format_graphite(char *buffer, size_t buffer_size, data_set_t const *ds,
-                    value_list_t const *vl, char const *prefix,
-                    char const *postfix, char const escape_char,
-                    unsigned int flags) {
-  int status = 0;
-  int buffer_pos = 0;
-
-  gauge_t *rates = NULL;
-  if (flags & GRAPHITE_STORE_RATES) {
-    rates = uc_get_rate(ds, vl);
-    if (rates == NULL) {
-      P_ERROR("format_graphite: error with uc_get_rate");
-      return -1;
-    }
-  }
-
+/* gr_format_keys appends the escaped metric names of all data sources to
+ * "buf", each one terminated by a null byte. This is the fragment stored in
+ * the format cache. */
+static int gr_format_keys(strbuf_t *buf, data_set_t const *ds,
+                          value_list_t const *vl, char const *prefix,
+                          char const *postfix, char const escape_char,
+                          unsigned int flags) {
   for (size_t i = 0; i < ds->ds_num; i++) {
     char const *ds_name = NULL;
     char key[10 * DATA_MAX_NAME_LEN];
-    char values[512];
-    size_t message_len;
-    char message[1024];
+    int status;
 
     if ((flags & GRAPHITE_ALWAYS_APPEND_DS) || (ds->ds_num > 1))
       ds_name = ds->ds[i].name;
@@ -326,7 +293,6 @@ int format_graphite(char *buffer, size_t buffer_size, data_set_t const *ds,
                                      postfix, escape_char, flags);
       if (status != 0) {
         P_ERROR("format_graphite: error with gr_format_name_tagged");
-        sfree(rates);
         return status;
       }
     } else {
@@ -334,44 +300,115 @@ int format_graphite(char *buffer, size_t buffer_size, data_set_t const *ds,
                               escape_char, flags);
       if (status != 0) {
         P_ERROR("format_graphite: error with gr_format_name");
-        sfree(rates);
         return status;
       }
     }
 
     escape_graphite_string(key, escape_char);
 
-    /* Convert the values to an ASCII representation and put that into
-     * `values'. */
-    status = gr_format_values(values, sizeof(values), i, ds, vl, rates);
+    /* Include the null byte as separator. */
+    status = strbuf_printn(buf, key, strlen(key) + 1);
+    if (status != 0)
+      return -status;
+  }
+
+  return 0;
+}
+
+int format_graphite_strbuf(strbuf_t *buf, data_set_t const *ds,
+                           value_list_t const *vl, char const *prefix,
+                           char const *postfix, char const escape_char,
+                           unsigned int flags, format_cache_t *cache) {
+  strbuf_t *keys_buf = STRBUF_CREATE;
+  char const *keys = NULL;
+  size_t keys_len = 0;
+  int status;
+
+  if ((buf == NULL) || (ds == NULL) || (vl == NULL))
+    return -EINVAL;
+
+  if ((cache == NULL) ||
+      (format_cache_get(cache, vl, &keys, &keys_len) != 0)) {
+    status = gr_format_keys(keys_buf, ds, vl, prefix, postfix, escape_char,
+                            flags);
     if (status != 0) {
-      P_ERROR("format_graphite: error with gr_format_values");
-      sfree(rates);
+      STRBUF_DESTROY(keys_buf);
       return status;
     }
 
-    /* Compute the graphite command */
-    message_len =
-        (size_t)snprintf(message, sizeof(message), "%s %s %u\r\n", key, values,
-                         (unsigned int)CDTIME_T_TO_TIME_T(vl->time));
-    if (message_len >= sizeof(message)) {
-      P_ERROR("format_graphite: message buffer too small: "
-              "Need %" PRIsz " bytes.",
-              message_len + 1);
-      sfree(rates);
-      return -ENOMEM;
+    keys = keys_buf->ptr;
+    keys_len = keys_buf->pos;
+    if (cache != NULL)
+      format_cache_put(cache, vl, keys, keys_len);
+  }
+
+  gauge_t *rates = NULL;
+  if (flags & GRAPHITE_STORE_RATES) {
+    rates = uc_get_rate(ds, vl);
+    if (rates == NULL) {
+      P_ERROR("format_graphite: error with uc_get_rate");
+      STRBUF_DESTROY(keys_buf);
+      return -1;
     }
+  }
 
-    /* Append it in case we got multiple data set */
-    if ((buffer_pos + message_len) >= buffer_size) {
-      P_ERROR("format_graphite: target buffer too small");
-      sfree(rates);
-      return -ENOMEM;
+  uint64_t time = (uint64_t)CDTIME_T_TO_TIME_T(vl->time);
+  size_t orig_pos = buf->pos;
+  char const *key = keys;
+
+  status = 0;
+  for (size_t i = 0; (i < ds->ds_num) && (status == 0); i++) {
+    size_t key_len = strlen(key);
+
+    /* Append the graphite line "<key> <value> <time>\r\n" straight to the
+     * output buffer. */
+    status = strbuf_printn(buf, key, key_len);
+    if (status == 0)
+      status = strbuf_printn(buf, " ", 1);
+    if (status == 0) {
+      status = gr_format_values(buf, i, ds, vl, rates);
+      if (status < 0) {
+        P_ERROR("format_graphite: error with gr_format_values");
+        break;
+      }
     }
-    memcpy((void *)(buffer + buffer_pos), message, message_len);
-    buffer_pos += message_len;
-    buffer[buffer_pos] = '\0';
+    if (status == 0)
+      status = strbuf_printn(buf, " ", 1);
+    if (status == 0)
+      status = strbuf_print_uint64(buf, time);
+    if (status == 0)
+      status = strbuf_printn(buf, "\r\n", 2);
+
+    key += key_len + 1;
   }
+
   sfree(rates);
+  STRBUF_DESTROY(keys_buf);
+
+  if (status != 0) {
+    strbuf_truncate(buf, orig_pos);
+    return (status < 0) ? status : -status;
+  }
+
+  assert(key <= keys + keys_len);
+  return 0;
+} /* int format_graphite_strbuf */
+
+int format_graphite(char *buffer, size_t buffer_size, data_set_t const *ds,
+                    value_list_t const *vl, char const *prefix,
+                    char const *postfix, char const escape_char,
+                    unsigned int flags) {
+  if ((buffer == NULL) || (buffer_size == 0))
+    return -EINVAL;
+  buffer[0] = 0;
+
+  int status =
+      format_graphite_strbuf(STRBUF_CREATE_FIXED(buffer, buffer_size), ds, vl,
+                             prefix, postfix, escape_char, flags, NULL);
+  if (status == -ENOSPC) {
+    P_ERROR("format_graphite: target buffer too small");
+    return -ENOMEM;
+  }
+
   return status;
 } /* int format_graphite */
@@ -25,6 +25,8 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/format_cache/format_cache.h"
+#include "utils/strbuf/strbuf.h"
 
 #define GRAPHITE_STORE_RATES 0x01
 #define GRAPHITE_SEPARATE_INSTANCES 0x02
@@ -34,6 +36,15 @@
 #define GRAPHITE_USE_TAGS 0x20
 #define GRAPHITE_REVERSE_HOST 0x40
 
+/* format_graphite_strbuf appends one graphite line per data source to "buf".
+ * If "cache" is not NULL, the escaped metric names are looked up in and added
+ * to the cache. Returns zero on success and a negative errno value on
+ * failure, in which case "buf" is left unchanged. */
+int format_graphite_strbuf(strbuf_t *buf, const data_set_t *ds,
+                           const value_list_t *vl, const char *prefix,
+                           const char *postfix, const char escape_char,
+                           unsigned int flags, format_cache_t *cache);
+
 int format_graphite(char *buffer, size_t buffer_size, const data_set_t *ds,
                     const value_list_t *vl, const char *prefix,
                     const char *postfix, const char escape_char,
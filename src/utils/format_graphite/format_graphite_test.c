@@ -205,9 +205,56 @@ DEF_TEST(null_termination) {
   return 0;
 }
 
+DEF_TEST(cache) {
+  value_list_t vl = {
+      .values = &(value_t){.gauge = 42},
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T_STATIC(1480063672),
+      .interval = TIME_T_TO_CDTIME_T_STATIC(10),
+      .host = "example.com",
+      .plugin = "test",
+      .plugin_instance = "foo",
+      .type = "single",
+  };
+
+  format_cache_t *cache;
+  CHECK_NOT_NULL(cache = format_cache_create(0));
+
+  strbuf_t *buf = STRBUF_CREATE;
+  for (size_t i = 0; i < 3; i++) {
+    /* The second iteration is served from the cache, the third uses a
+     * different identifier and must not be. */
+    if (i == 2)
+      sstrncpy(vl.host, "example.org", sizeof(vl.host));
+
+    EXPECT_EQ_INT(0, format_graphite_strbuf(buf, &ds_single, &vl, NULL, NULL,
+                                            '_', 0, cache));
+  }
+  EXPECT_EQ_INT(2, (int)format_cache_size(cache));
+  EXPECT_EQ_STR("example_com.test-foo.single 42 1480063672\r\n"
+                "example_com.test-foo.single 42 1480063672\r\n"
+                "example_org.test-foo.single 42 1480063672\r\n",
+                buf->ptr);
+
+  /* Output that does not fit must not leave a partial line behind. */
+  char buffer[64];
+  strbuf_t *fixed = STRBUF_CREATE_STATIC(buffer);
+  buffer[0] = 0;
+  EXPECT_EQ_INT(0, format_graphite_strbuf(fixed, &ds_single, &vl, NULL, NULL,
+                                          '_', 0, cache));
+  EXPECT_EQ_INT(-ENOSPC, format_graphite_strbuf(fixed, &ds_single, &vl, NULL,
+                                                NULL, '_', 0, cache));
+  EXPECT_EQ_STR("example_org.test-foo.single 42 1480063672\r\n", buffer);
+
+  STRBUF_DESTROY(buf);
+  format_cache_destroy(cache);
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(metric_name);
   RUN_TEST(null_termination);
+  RUN_TEST(cache);
 
   END_TEST;
 }
@@ -34,161 +34,149 @@
 
 #include "utils/format_influxdb/format_influxdb.h"
 
-static int format_influxdb_escape_string(char *buffer, size_t buffer_size,
-                                         const char *string) {
-
-  if ((buffer == NULL) || (string == NULL))
+static int format_influxdb_escape_string(strbuf_t *buf, const char *string) {
+  if ((buf == NULL) || (string == NULL))
     return -EINVAL;
 
-  if (buffer_size < 3)
-    return -ENOMEM;
-
-  int dst_pos = 0;
+  /* Copy runs of characters that need no escaping in one go. */
+  for (const char *ptr = string; *ptr != 0;) {
+    size_t len = strcspn(ptr, "\\ ,=\"");
+    int status;
 
-#define BUFFER_ADD(c)                                                          \
-  do {                                                                         \
-    if (dst_pos >= (buffer_size - 1)) {                                        \
-      buffer[buffer_size - 1] = '\0';                                          \
-      return -ENOMEM;                                                          \
-    }                                                                          \
-    buffer[dst_pos] = (c);                                                     \
-    dst_pos++;                                                                 \
-  } while (0)
+    if (len > 0) {
+      status = strbuf_printn(buf, ptr, len);
+      if (status != 0)
+        return -status;
+      ptr += len;
+      continue;
+    }
 
-  /* Escape special characters */
-  for (int src_pos = 0; string[src_pos] != 0; src_pos++) {
-    if ((string[src_pos] == '\\') || (string[src_pos] == ' ') ||
-        (string[src_pos] == ',') || (string[src_pos] == '=') ||
-        (string[src_pos] == '"')) {
-      BUFFER_ADD('\\');
-      BUFFER_ADD(string[src_pos]);
-    } else
-      BUFFER_ADD(string[src_pos]);
+    /* Escape special characters */
+    char escaped[2] = {'\\', *ptr};
+    status = strbuf_printn(buf, escaped, sizeof(escaped));
+    if (status != 0)
+      return -status;
+    ptr++;
   } /* for */
-  buffer[dst_pos] = 0;
 
-#undef BUFFER_ADD
-
-  return dst_pos;
+  return 0;
 } /* int format_influxdb_escape_string */
 
-int format_influxdb_value_list(char *buffer, int buffer_len,
-                               const data_set_t *ds, const value_list_t *vl,
-                               format_influxdb_time_precision_t time_precision,
-                               bool store_rates, bool write_meta) {
-  int status;
-  int offset = 0;
-  gauge_t *rates = NULL;
-  bool have_values = false;
-
-  assert(0 == strcmp(ds->type, vl->type));
-
-#define BUFFER_ADD_ESCAPE(...)                                                 \
-  do {                                                                         \
-    status = format_influxdb_escape_string(buffer + offset,                    \
-                                           buffer_len - offset, __VA_ARGS__);  \
-    if (status < 0)                                                            \
-      return status;                                                           \
-    offset += status;                                                          \
-  } while (0)
-
-#define BUFFER_ADD(...)                                                        \
+#define BUFFER_ADD(f, ...)                                                     \
   do {                                                                         \
-    status = snprintf(buffer + offset, buffer_len - offset, __VA_ARGS__);      \
-    if ((status < 0) || (status >= (buffer_len - offset))) {                   \
-      sfree(rates);                                                            \
-      return -ENOMEM;                                                          \
-    }                                                                          \
-    offset += status;                                                          \
+    int status_ = f(buf, __VA_ARGS__);                                         \
+    if (status_ != 0)                                                          \
+      return (status_ < 0) ? status_ : -status_;                               \
   } while (0)
 
-  BUFFER_ADD_ESCAPE(vl->plugin);
-  BUFFER_ADD(",host=");
-  BUFFER_ADD_ESCAPE(vl->host);
+/* format_influxdb_identifier formats the measurement name and the tags
+ * derived from the identifier. This is the part stored in the format cache. */
+static int format_influxdb_identifier(strbuf_t *buf, const value_list_t *vl) {
+  BUFFER_ADD(format_influxdb_escape_string, vl->plugin);
+  BUFFER_ADD(strbuf_print, ",host=");
+  BUFFER_ADD(format_influxdb_escape_string, vl->host);
   if (strcmp(vl->plugin_instance, "") != 0) {
-    BUFFER_ADD(",instance=");
-    BUFFER_ADD_ESCAPE(vl->plugin_instance);
+    BUFFER_ADD(strbuf_print, ",instance=");
+    BUFFER_ADD(format_influxdb_escape_string, vl->plugin_instance);
   }
   if (strcmp(vl->type, "") != 0) {
-    BUFFER_ADD(",type=");
-    BUFFER_ADD_ESCAPE(vl->type);
+    BUFFER_ADD(strbuf_print, ",type=");
+    BUFFER_ADD(format_influxdb_escape_string, vl->type);
   }
   if (strcmp(vl->type_instance, "") != 0) {
-    BUFFER_ADD(",type_instance=");
-    BUFFER_ADD_ESCAPE(vl->type_instance);
+    BUFFER_ADD(strbuf_print, ",type_instance=");
+    BUFFER_ADD(format_influxdb_escape_string, vl->type_instance);
   }
-  if (write_meta && vl->meta) {
-    for (meta_entry_t *it = meta_data_iter(vl->meta); it != NULL;
-         it = meta_data_iter_next(it)) {
-      const char *key = meta_data_iter_key(it);
-      char *value;
 
-      if (meta_data_iter_type(it) != MD_TYPE_STRING ||
-          meta_data_iter_get_string(vl->meta, it, &value) != 0)
-        continue;
+  return 0;
+} /* int format_influxdb_identifier */
 
-      BUFFER_ADD(",");
-      BUFFER_ADD_ESCAPE(key);
-      BUFFER_ADD("=");
-      BUFFER_ADD_ESCAPE(value);
-      free(value);
-    }
+static int format_influxdb_meta(strbuf_t *buf, meta_data_t *meta) {
+  for (meta_entry_t *it = meta_data_iter(meta); it != NULL;
+       it = meta_data_iter_next(it)) {
+    const char *key = meta_data_iter_key(it);
+    char *value;
+
+    if (meta_data_iter_type(it) != MD_TYPE_STRING ||
+        meta_data_iter_get_string(meta, it, &value) != 0)
+      continue;
+
+    int status = strbuf_print(buf, ",");
+    status = (status != 0) ? -status : format_influxdb_escape_string(buf, key);
+    if (status == 0)
+      status = -strbuf_print(buf, "=");
+    if (status == 0)
+      status = format_influxdb_escape_string(buf, value);
+    free(value);
+    if (status != 0)
+      return status;
   }
 
-  BUFFER_ADD(" ");
+  return 0;
+} /* int format_influxdb_meta */
+
+static int format_influxdb_values(strbuf_t *buf, const data_set_t *ds,
+                                  const value_list_t *vl,
+                                  gauge_t const *rates, bool *have_values) {
   for (size_t i = 0; i < ds->ds_num; i++) {
     if ((ds->ds[i].type != DS_TYPE_COUNTER) &&
         (ds->ds[i].type != DS_TYPE_GAUGE) &&
         (ds->ds[i].type != DS_TYPE_DERIVE) &&
-        (ds->ds[i].type != DS_TYPE_ABSOLUTE)) {
-      sfree(rates);
+        (ds->ds[i].type != DS_TYPE_ABSOLUTE))
       return -EINVAL;
-    }
 
-    if (ds->ds[i].type == DS_TYPE_GAUGE) {
-      if (isnan(vl->values[i].gauge))
-        continue;
-      if (have_values)
-        BUFFER_ADD(",");
-      BUFFER_ADD("%s=%lf", ds->ds[i].name, vl->values[i].gauge);
-      have_values = true;
-    } else if (store_rates) {
-      if (rates == NULL)
-        rates = uc_get_rate(ds, vl);
-      if (rates == NULL) {
-        WARNING("format_influxdb: "
-                "uc_get_rate failed.");
-        return -EINVAL;
-      }
-      if (isnan(rates[i]))
-        continue;
-      if (have_values)
-        BUFFER_ADD(",");
-      BUFFER_ADD("%s=%lf", ds->ds[i].name, rates[i]);
-      have_values = true;
-    } else if (ds->ds[i].type == DS_TYPE_COUNTER) {
-      if (have_values)
-        BUFFER_ADD(",");
-      BUFFER_ADD("%s=%" PRIu64 "i", ds->ds[i].name,
-                 (uint64_t)vl->values[i].counter);
-      have_values = true;
+    if ((ds->ds[i].type == DS_TYPE_GAUGE) && isnan(vl->values[i].gauge))
+      continue;
+    if ((ds->ds[i].type != DS_TYPE_GAUGE) && (rates != NULL) &&
+        isnan(rates[i]))
+      continue;
+
+    if (*have_values)
+      BUFFER_ADD(strbuf_print, ",");
+    BUFFER_ADD(strbuf_print, ds->ds[i].name);
+    BUFFER_ADD(strbuf_print, "=");
+
+    if (ds->ds[i].type == DS_TYPE_GAUGE)
+      BUFFER_ADD(strbuf_print_fixed, vl->values[i].gauge, 6);
+    else if (rates != NULL)
+      BUFFER_ADD(strbuf_print_fixed, rates[i], 6);
+    else if (ds->ds[i].type == DS_TYPE_COUNTER) {
+      BUFFER_ADD(strbuf_print_uint64, (uint64_t)vl->values[i].counter);
+      BUFFER_ADD(strbuf_print, "i");
     } else if (ds->ds[i].type == DS_TYPE_DERIVE) {
-      if (have_values)
-        BUFFER_ADD(",");
-      BUFFER_ADD("%s=%" PRIi64 "i", ds->ds[i].name, vl->values[i].derive);
-      have_values = true;
+      BUFFER_ADD(strbuf_print_int64, vl->values[i].derive);
+      BUFFER_ADD(strbuf_print, "i");
     } else if (ds->ds[i].type == DS_TYPE_ABSOLUTE) {
-      if (have_values)
-        BUFFER_ADD(",");
-      BUFFER_ADD("%s=%" PRIu64 "i", ds->ds[i].name, vl->values[i].absolute);
-      have_values = true;
+      BUFFER_ADD(strbuf_print_uint64, vl->values[i].absolute);
+      BUFFER_ADD(strbuf_print, "i");
     }
-
+    *have_values = true;
   } /* for ds->ds_num */
-  sfree(rates);
 
+  return 0;
+} /* int format_influxdb_values */
+
+static int format_influxdb_line(strbuf_t *buf, const data_set_t *ds,
+                                const value_list_t *vl,
+                                char const *identifier, gauge_t const *rates,
+                                format_influxdb_time_precision_t time_precision,
+                                bool write_meta) {
+  int status;
+
+  BUFFER_ADD(strbuf_print, identifier);
+  if (write_meta && vl->meta) {
+    status = format_influxdb_meta(buf, vl->meta);
+    if (status != 0)
+      return status;
+  }
+
+  BUFFER_ADD(strbuf_print, " ");
+  bool have_values = false;
+  status = format_influxdb_values(buf, ds, vl, rates, &have_values);
+  if (status != 0)
+    return status;
   if (!have_values)
-    return 0;
+    return ENOENT;
 
   uint64_t influxdb_time = 0;
   switch (time_precision) {
@@ -203,10 +191,91 @@ int format_influxdb_value_list(char *buffer, int buffer_len,
     break;
   }
 
-  BUFFER_ADD(" %" PRIu64 "\n", influxdb_time);
+  BUFFER_ADD(strbuf_print, " ");
+  BUFFER_ADD(strbuf_print_uint64, influxdb_time);
+  BUFFER_ADD(strbuf_print, "\n");
+
+  return 0;
+} /* int format_influxdb_line */
 
-#undef BUFFER_ADD_ESCAPE
 #undef BUFFER_ADD
 
-  return offset;
+int format_influxdb_value_list_strbuf(
+    strbuf_t *buf, const data_set_t *ds, const value_list_t *vl,
+    format_influxdb_time_precision_t time_precision, bool store_rates,
+    bool write_meta, format_cache_t *cache) {
+  strbuf_t *id_buf = STRBUF_CREATE;
+  char const *identifier = NULL;
+  size_t identifier_len = 0;
+  gauge_t *rates = NULL;
+  int status;
+
+  if ((buf == NULL) || (ds == NULL) || (vl == NULL))
+    return -EINVAL;
+
+  assert(0 == strcmp(ds->type, vl->type));
+
+  if ((cache == NULL) ||
+      (format_cache_get(cache, vl, &identifier, &identifier_len) != 0)) {
+    status = format_influxdb_identifier(id_buf, vl);
+    if (status != 0) {
+      STRBUF_DESTROY(id_buf);
+      return status;
+    }
+
+    identifier = id_buf->ptr;
+    if (cache != NULL)
+      format_cache_put(cache, vl, id_buf->ptr, id_buf->pos);
+  }
+
+  if (store_rates) {
+    for (size_t i = 0; i < ds->ds_num; i++) {
+      if (ds->ds[i].type == DS_TYPE_GAUGE)
+        continue;
+
+      rates = uc_get_rate(ds, vl);
+      if (rates == NULL) {
+        WARNING("format_influxdb: "
+                "uc_get_rate failed.");
+        STRBUF_DESTROY(id_buf);
+        return -EINVAL;
+      }
+      break;
+    }
+  }
+
+  size_t orig_pos = buf->pos;
+  status = format_influxdb_line(buf, ds, vl, identifier, rates, time_precision,
+                                write_meta);
+  sfree(rates);
+  STRBUF_DESTROY(id_buf);
+
+  if (status != 0) {
+    strbuf_truncate(buf, orig_pos);
+    /* A value list without any (non-NaN) values is not an error. */
+    if (status == ENOENT)
+      return 0;
+    return status;
+  }
+
+  return 0;
+} /* int format_influxdb_value_list_strbuf */
+
+int format_influxdb_value_list(char *buffer, int buffer_len,
+                               const data_set_t *ds, const value_list_t *vl,
+                               format_influxdb_time_precision_t time_precision,
+                               bool store_rates, bool write_meta) {
+  if ((buffer == NULL) || (buffer_len <= 0))
+    return -EINVAL;
+  buffer[0] = 0;
+
+  strbuf_t *buf = STRBUF_CREATE_FIXED(buffer, (size_t)buffer_len);
+  int status = format_influxdb_value_list_strbuf(
+      buf, ds, vl, time_precision, store_rates, write_meta, /* cache = */ NULL);
+  if (status == -ENOSPC)
+    return -ENOMEM;
+  if (status != 0)
+    return status;
+
+  return (int)buf->pos;
 } /* int format_influxdb_value_list */
@@ -31,6 +31,8 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/format_cache/format_cache.h"
+#include "utils/strbuf/strbuf.h"
 
 typedef enum {
   NS,
@@ -43,4 +45,13 @@ int format_influxdb_value_list(char *buffer, int buffer_len,
                                format_influxdb_time_precision_t time_precision,
                                bool store_rates, bool write_meta);
 
+/* format_influxdb_value_list_strbuf appends the line protocol representation
+ * of "vl" to "buf". "cache", if not NULL, caches the measurement and tags
+ * derived from the identifier. On failure a negative errno value is returned
+ * and "buf" is left unchanged. */
+int format_influxdb_value_list_strbuf(
+    strbuf_t *buf, const data_set_t *ds, const value_list_t *vl,
+    format_influxdb_time_precision_t time_precision, bool store_rates,
+    bool write_meta, format_cache_t *cache);
+
 #endif /* UTILS_FORMAT_INFLUXDB_H */
@@ -43,194 +43,126 @@
 #endif
 #endif
 
-static int json_escape_string(char *buffer, size_t buffer_size, /* {{{ */
-                              const char *string) {
-  size_t dst_pos;
-
-  if ((buffer == NULL) || (string == NULL))
+static int json_escape_string(strbuf_t *buf, const char *string) /* {{{ */
+{
+  if ((buf == NULL) || (string == NULL))
     return -EINVAL;
 
-  if (buffer_size < 3)
-    return -ENOMEM;
-
-  dst_pos = 0;
-
-#define BUFFER_ADD(c)                                                          \
-  do {                                                                         \
-    if (dst_pos >= (buffer_size - 1)) {                                        \
-      buffer[buffer_size - 1] = '\0';                                          \
-      return -ENOMEM;                                                          \
-    }                                                                          \
-    buffer[dst_pos] = (c);                                                     \
-    dst_pos++;                                                                 \
-  } while (0)
+  int status = strbuf_printn(buf, "\"", 1);
+  if (status != 0)
+    return -status;
+
+  /* Copy runs of characters that need no escaping in one go. */
+  for (const char *ptr = string; *ptr != 0;) {
+    size_t len = 0;
+    while ((ptr[len] != 0) && (ptr[len] != '"') && (ptr[len] != '\\') &&
+           (ptr[len] > 0x001F))
+      len++;
+
+    if (len > 0) {
+      status = strbuf_printn(buf, ptr, len);
+      if (status != 0)
+        return -status;
+      ptr += len;
+      continue;
+    }
 
-  /* Escape special characters */
-  BUFFER_ADD('"');
-  for (size_t src_pos = 0; string[src_pos] != 0; src_pos++) {
-    if ((string[src_pos] == '"') || (string[src_pos] == '\\')) {
-      BUFFER_ADD('\\');
-      BUFFER_ADD(string[src_pos]);
-    } else if (string[src_pos] <= 0x001F)
-      BUFFER_ADD('?');
-    else
-      BUFFER_ADD(string[src_pos]);
+    if ((*ptr == '"') || (*ptr == '\\')) {
+      char escaped[2] = {'\\', *ptr};
+      status = strbuf_printn(buf, escaped, sizeof(escaped));
+    } else
+      status = strbuf_printn(buf, "?", 1);
+    if (status != 0)
+      return -status;
+    ptr++;
   } /* for */
-  BUFFER_ADD('"');
-  buffer[dst_pos] = 0;
 
-#undef BUFFER_ADD
-
-  return 0;
+  status = strbuf_printn(buf, "\"", 1);
+  return -status;
 } /* }}} int json_escape_string */
 
-static int values_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                          const data_set_t *ds, const value_list_t *vl,
-                          int store_rates) {
-  size_t offset = 0;
-  gauge_t *rates = NULL;
-
-  memset(buffer, 0, buffer_size);
+static int json_print_gauge(strbuf_t *buf, gauge_t v) /* {{{ */
+{
+#if JSON_GAUGE_FORMAT_DEFAULT
+  return strbuf_print_gauge(buf, v);
+#else
+  return strbuf_printf(buf, JSON_GAUGE_FORMAT, v);
+#endif
+} /* }}} int json_print_gauge */
 
-#define BUFFER_ADD(...)                                                        \
+#define BUFFER_ADD(f, ...)                                                     \
   do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1) {                                                          \
-      sfree(rates);                                                            \
-      return -1;                                                               \
-    } else if (((size_t)status) >= (buffer_size - offset)) {                   \
-      sfree(rates);                                                            \
-      return -ENOMEM;                                                          \
-    } else                                                                     \
-      offset += ((size_t)status);                                              \
+    int status_ = f(buf, __VA_ARGS__);                                         \
+    if (status_ != 0)                                                          \
+      return (status_ < 0) ? status_ : -status_;                               \
   } while (0)
 
-  BUFFER_ADD("[");
+static int values_to_json(strbuf_t *buf, /* {{{ */
+                          const data_set_t *ds, const value_list_t *vl,
+                          gauge_t const *rates) {
+  BUFFER_ADD(strbuf_print, "[");
   for (size_t i = 0; i < ds->ds_num; i++) {
     if (i > 0)
-      BUFFER_ADD(",");
+      BUFFER_ADD(strbuf_print, ",");
 
     if (ds->ds[i].type == DS_TYPE_GAUGE) {
       if (isfinite(vl->values[i].gauge))
-        BUFFER_ADD(JSON_GAUGE_FORMAT, vl->values[i].gauge);
+        BUFFER_ADD(json_print_gauge, vl->values[i].gauge);
       else
-        BUFFER_ADD("null");
-    } else if (store_rates) {
-      if (rates == NULL)
-        rates = uc_get_rate(ds, vl);
-      if (rates == NULL) {
-        WARNING("utils_format_json: uc_get_rate failed.");
-        sfree(rates);
-        return -1;
-      }
-
+        BUFFER_ADD(strbuf_print, "null");
+    } else if (rates != NULL) {
       if (isfinite(rates[i]))
-        BUFFER_ADD(JSON_GAUGE_FORMAT, rates[i]);
+        BUFFER_ADD(json_print_gauge, rates[i]);
       else
-        BUFFER_ADD("null");
+        BUFFER_ADD(strbuf_print, "null");
     } else if (ds->ds[i].type == DS_TYPE_COUNTER)
-      BUFFER_ADD("%" PRIu64, (uint64_t)vl->values[i].counter);
+      BUFFER_ADD(strbuf_print_uint64, (uint64_t)vl->values[i].counter);
     else if (ds->ds[i].type == DS_TYPE_DERIVE)
-      BUFFER_ADD("%" PRIi64, vl->values[i].derive);
+      BUFFER_ADD(strbuf_print_int64, vl->values[i].derive);
     else if (ds->ds[i].type == DS_TYPE_ABSOLUTE)
-      BUFFER_ADD("%" PRIu64, vl->values[i].absolute);
+      BUFFER_ADD(strbuf_print_uint64, vl->values[i].absolute);
     else {
       ERROR("format_json: Unknown data source type: %i", ds->ds[i].type);
-      sfree(rates);
       return -1;
     }
   } /* for ds->ds_num */
-  BUFFER_ADD("]");
+  BUFFER_ADD(strbuf_print, "]");
 
-#undef BUFFER_ADD
-
-  sfree(rates);
   return 0;
 } /* }}} int values_to_json */
 
-static int dstypes_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                           const data_set_t *ds) {
-  size_t offset = 0;
-
-  memset(buffer, 0, buffer_size);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  BUFFER_ADD("[");
+static int dstypes_to_json(strbuf_t *buf, const data_set_t *ds) /* {{{ */
+{
+  BUFFER_ADD(strbuf_print, "[");
   for (size_t i = 0; i < ds->ds_num; i++) {
     if (i > 0)
-      BUFFER_ADD(",");
+      BUFFER_ADD(strbuf_print, ",");
 
-    BUFFER_ADD("\"%s\"", DS_TYPE_TO_STRING(ds->ds[i].type));
+    BUFFER_ADD(strbuf_printf, "\"%s\"", DS_TYPE_TO_STRING(ds->ds[i].type));
   } /* for ds->ds_num */
-  BUFFER_ADD("]");
-
-#undef BUFFER_ADD
+  BUFFER_ADD(strbuf_print, "]");
 
   return 0;
 } /* }}} int dstypes_to_json */
 
-static int dsnames_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                           const data_set_t *ds) {
-  size_t offset = 0;
-
-  memset(buffer, 0, buffer_size);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  BUFFER_ADD("[");
+static int dsnames_to_json(strbuf_t *buf, const data_set_t *ds) /* {{{ */
+{
+  BUFFER_ADD(strbuf_print, "[");
   for (size_t i = 0; i < ds->ds_num; i++) {
     if (i > 0)
-      BUFFER_ADD(",");
+      BUFFER_ADD(strbuf_print, ",");
 
-    BUFFER_ADD("\"%s\"", ds->ds[i].name);
+    BUFFER_ADD(strbuf_printf, "\"%s\"", ds->ds[i].name);
   } /* for ds->ds_num */
-  BUFFER_ADD("]");
-
-#undef BUFFER_ADD
+  BUFFER_ADD(strbuf_print, "]");
 
   return 0;
 } /* }}} int dsnames_to_json */
 
-static int meta_data_keys_to_json(char *buffer, size_t buffer_size, /* {{{ */
+static int meta_data_keys_to_json(strbuf_t *buf, /* {{{ */
                                   meta_data_t *meta, char **keys,
                                   size_t keys_num) {
-  size_t offset = 0;
-  int status;
-
-  buffer[0] = 0;
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
+  size_t orig_pos = buf->pos;
 
   for (size_t i = 0; i < keys_num; ++i) {
     int type;
@@ -240,52 +172,47 @@ static int meta_data_keys_to_json(char *buffer, size_t buffer_size, /* {{{ */
     if (type == MD_TYPE_STRING) {
       char *value = NULL;
       if (meta_data_get_string(meta, key, &value) == 0) {
-        char temp[512] = "";
-
-        status = json_escape_string(temp, sizeof(temp), value);
+        int status = strbuf_printf(buf, ",\"%s\":", key);
+        status = (status != 0) ? -status : json_escape_string(buf, value);
         sfree(value);
         if (status != 0)
           return status;
-
-        BUFFER_ADD(",\"%s\":%s", key, temp);
       }
     } else if (type == MD_TYPE_SIGNED_INT) {
       int64_t value = 0;
       if (meta_data_get_signed_int(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%" PRIi64, key, value);
+        BUFFER_ADD(strbuf_printf, ",\"%s\":%" PRIi64, key, value);
     } else if (type == MD_TYPE_UNSIGNED_INT) {
       uint64_t value = 0;
       if (meta_data_get_unsigned_int(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%" PRIu64, key, value);
+        BUFFER_ADD(strbuf_printf, ",\"%s\":%" PRIu64, key, value);
     } else if (type == MD_TYPE_DOUBLE) {
       double value = 0.0;
       if (meta_data_get_double(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%f", key, value);
+        BUFFER_ADD(strbuf_printf, ",\"%s\":%f", key, value);
     } else if (type == MD_TYPE_BOOLEAN) {
       bool value = false;
       if (meta_data_get_boolean(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%s", key, value ? "true" : "false");
+        BUFFER_ADD(strbuf_printf, ",\"%s\":%s", key, value ? "true" : "false");
     }
   } /* for (keys) */
 
-  if (offset == 0)
+  if (buf->pos == orig_pos)
     return ENOENT;
 
-  buffer[0] = '{'; /* replace leading ',' */
-  BUFFER_ADD("}");
-
-#undef BUFFER_ADD
+  buf->ptr[orig_pos] = '{'; /* replace leading ',' */
+  BUFFER_ADD(strbuf_print, "}");
 
   return 0;
 } /* }}} int meta_data_keys_to_json */
 
-static int meta_data_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                             meta_data_t *meta) {
+static int meta_data_to_json(strbuf_t *buf, meta_data_t *meta) /* {{{ */
+{
   char **keys = NULL;
   size_t keys_num;
   int status;
 
-  if ((buffer == NULL) || (buffer_size == 0) || (meta == NULL))
+  if ((buf == NULL) || (meta == NULL))
     return EINVAL;
 
   status = meta_data_toc(meta, &keys);
@@ -293,7 +220,7 @@ static int meta_data_to_json(char *buffer, size_t buffer_size, /* {{{ */
     return status;
   keys_num = (size_t)status;
 
-  status = meta_data_keys_to_json(buffer, buffer_size, meta, keys, keys_num);
+  status = meta_data_keys_to_json(buf, meta, keys, keys_num);
 
   for (size_t i = 0; i < keys_num; ++i)
     sfree(keys[i]);
@@ -302,54 +229,30 @@ static int meta_data_to_json(char *buffer, size_t buffer_size, /* {{{ */
   return status;
 } /* }}} int meta_data_to_json */
 
-static int value_list_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                              const data_set_t *ds, const value_list_t *vl,
-                              int store_rates) {
-  char temp[512];
-  size_t offset = 0;
+/* identifier_to_json formats the parts of a value list that only depend on
+ * its identifier, i.e. the data source types and names and the identifier
+ * fields themselves. The two fragments are separated by a null byte so they
+ * can be cached as one blob. */
+static int identifier_to_json(strbuf_t *buf, /* {{{ */
+                              const data_set_t *ds, const value_list_t *vl) {
   int status;
 
-  memset(buffer, 0, buffer_size);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  /* All value lists have a leading comma. The first one will be replaced with
-   * a square bracket in `format_json_finalize'. */
-  BUFFER_ADD(",{");
-
-  status = values_to_json(temp, sizeof(temp), ds, vl, store_rates);
-  if (status != 0)
-    return status;
-  BUFFER_ADD("\"values\":%s", temp);
-
-  status = dstypes_to_json(temp, sizeof(temp), ds);
-  if (status != 0)
+  BUFFER_ADD(strbuf_print, ",\"dstypes\":");
+  if ((status = dstypes_to_json(buf, ds)) != 0)
     return status;
-  BUFFER_ADD(",\"dstypes\":%s", temp);
 
-  status = dsnames_to_json(temp, sizeof(temp), ds);
-  if (status != 0)
+  BUFFER_ADD(strbuf_print, ",\"dsnames\":");
+  if ((status = dsnames_to_json(buf, ds)) != 0)
     return status;
-  BUFFER_ADD(",\"dsnames\":%s", temp);
 
-  BUFFER_ADD(",\"time\":%.3f", CDTIME_T_TO_DOUBLE(vl->time));
-  BUFFER_ADD(",\"interval\":%.3f", CDTIME_T_TO_DOUBLE(vl->interval));
+  BUFFER_ADD(strbuf_printn, "", 1);
 
 #define BUFFER_ADD_KEYVAL(key, value)                                          \
   do {                                                                         \
-    status = json_escape_string(temp, sizeof(temp), (value));                  \
+    BUFFER_ADD(strbuf_print, ",\"" key "\":");                                 \
+    status = json_escape_string(buf, (value));                                 \
     if (status != 0)                                                           \
       return status;                                                           \
-    BUFFER_ADD(",\"%s\":%s", (key), temp);                                     \
   } while (0)
 
   BUFFER_ADD_KEYVAL("host", vl->host);
@@ -358,44 +261,112 @@ static int value_list_to_json(char *buffer, size_t buffer_size, /* {{{ */
   BUFFER_ADD_KEYVAL("type", vl->type);
   BUFFER_ADD_KEYVAL("type_instance", vl->type_instance);
 
+#undef BUFFER_ADD_KEYVAL
+
+  BUFFER_ADD(strbuf_printn, "", 1);
+
+  return 0;
+} /* }}} int identifier_to_json */
+
+static int value_list_to_json(strbuf_t *buf, /* {{{ */
+                              const data_set_t *ds, const value_list_t *vl,
+                              gauge_t const *rates, char const *id_fragment) {
+  int status;
+
+  /* All value lists have a leading comma. The first one will be replaced with
+   * a square bracket in `format_json_finalize'. */
+  BUFFER_ADD(strbuf_print, ",{\"values\":");
+  if ((status = values_to_json(buf, ds, vl, rates)) != 0)
+    return status;
+
+  char const *types_names = id_fragment;
+  char const *identifier = types_names + strlen(types_names) + 1;
+
+  BUFFER_ADD(strbuf_print, types_names);
+  BUFFER_ADD(strbuf_printf, ",\"time\":%.3f,\"interval\":%.3f",
+             CDTIME_T_TO_DOUBLE(vl->time), CDTIME_T_TO_DOUBLE(vl->interval));
+  BUFFER_ADD(strbuf_print, identifier);
+
   if (vl->meta != NULL) {
-    char meta_buffer[buffer_size];
-    memset(meta_buffer, 0, sizeof(meta_buffer));
-    status = meta_data_to_json(meta_buffer, sizeof(meta_buffer), vl->meta);
+    BUFFER_ADD(strbuf_print, ",\"meta\":");
+
+    status = meta_data_to_json(buf, vl->meta);
     if (status != 0)
       return status;
-
-    BUFFER_ADD(",\"meta\":%s", meta_buffer);
   } /* if (vl->meta != NULL) */
 
-  BUFFER_ADD("}");
-
-#undef BUFFER_ADD_KEYVAL
-#undef BUFFER_ADD
+  BUFFER_ADD(strbuf_print, "}");
 
   return 0;
 } /* }}} int value_list_to_json */
 
-static int format_json_value_list_nocheck(char *buffer, /* {{{ */
-                                          size_t *ret_buffer_fill,
-                                          size_t *ret_buffer_free,
-                                          const data_set_t *ds,
-                                          const value_list_t *vl,
-                                          int store_rates, size_t temp_size) {
-  char temp[temp_size];
+int format_json_value_list_strbuf(strbuf_t *buf, /* {{{ */
+                                  const data_set_t *ds, const value_list_t *vl,
+                                  bool store_rates, format_cache_t *cache) {
+  strbuf_t *id_buf = STRBUF_CREATE;
+  char const *id_fragment = NULL;
+  size_t id_fragment_len = 0;
+  gauge_t *rates = NULL;
   int status;
 
-  status = value_list_to_json(temp, sizeof(temp), ds, vl, store_rates);
+  if ((buf == NULL) || (ds == NULL) || (vl == NULL))
+    return -EINVAL;
+
+  if ((cache == NULL) ||
+      (format_cache_get(cache, vl, &id_fragment, &id_fragment_len) != 0)) {
+    status = identifier_to_json(id_buf, ds, vl);
+    if (status != 0) {
+      STRBUF_DESTROY(id_buf);
+      return status;
+    }
+
+    id_fragment = id_buf->ptr;
+    if (cache != NULL)
+      format_cache_put(cache, vl, id_buf->ptr, id_buf->pos);
+  }
+
+  if (store_rates) {
+    for (size_t i = 0; i < ds->ds_num; i++) {
+      if (ds->ds[i].type == DS_TYPE_GAUGE)
+        continue;
+
+      rates = uc_get_rate(ds, vl);
+      if (rates == NULL) {
+        WARNING("utils_format_json: uc_get_rate failed.");
+        STRBUF_DESTROY(id_buf);
+        return -1;
+      }
+      break;
+    }
+  }
+
+  size_t orig_pos = buf->pos;
+  status = value_list_to_json(buf, ds, vl, rates, id_fragment);
   if (status != 0)
-    return status;
-  temp_size = strlen(temp);
+    strbuf_truncate(buf, orig_pos);
+
+  sfree(rates);
+  STRBUF_DESTROY(id_buf);
+  return status;
+} /* }}} int format_json_value_list_strbuf */
+
+int format_json_finalize_strbuf(strbuf_t *buf) /* {{{ */
+{
+  if (buf == NULL)
+    return -EINVAL;
+
+  /* Replace the leading comma added in `value_list_to_json' with a square
+   * bracket. */
+  if ((buf->pos == 0) || (buf->ptr[0] != ','))
+    return -EINVAL;
 
-  memcpy(buffer + (*ret_buffer_fill), temp, temp_size + 1);
-  (*ret_buffer_fill) += temp_size;
-  (*ret_buffer_free) -= temp_size;
+  BUFFER_ADD(strbuf_print, "]");
+  buf->ptr[0] = '[';
 
   return 0;
-} /* }}} int format_json_value_list_nocheck */
+} /* }}} int format_json_finalize_strbuf */
+
+#undef BUFFER_ADD
 
 int format_json_initialize(char *buffer, /* {{{ */
                            size_t *ret_buffer_fill, size_t *ret_buffer_free) {
@@ -460,9 +431,27 @@ int format_json_value_list(char *buffer, /* {{{ */
   if (*ret_buffer_free < 3)
     return -ENOMEM;
 
-  return format_json_value_list_nocheck(buffer, ret_buffer_fill,
-                                        ret_buffer_free, ds, vl, store_rates,
-                                        (*ret_buffer_free) - 2);
+  /* Format directly into the caller's buffer, keeping two bytes in reserve
+   * for the closing bracket added by format_json_finalize(). */
+  strbuf_t buf = {
+      .ptr = buffer,
+      .pos = *ret_buffer_fill,
+      .size = *ret_buffer_fill + *ret_buffer_free - 2,
+      .fixed = true,
+  };
+
+  int status = format_json_value_list_strbuf(&buf, ds, vl, store_rates != 0,
+                                             /* cache = */ NULL);
+  if (status == -ENOSPC)
+    return -ENOMEM;
+  if (status != 0)
+    return status;
+
+  size_t len = buf.pos - *ret_buffer_fill;
+  (*ret_buffer_fill) += len;
+  (*ret_buffer_free) -= len;
+
+  return 0;
 } /* }}} int format_json_value_list */
 
 #if HAVE_LIBYAJL
@@ -30,9 +30,12 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/format_cache/format_cache.h"
+#include "utils/strbuf/strbuf.h"
 
 #ifndef JSON_GAUGE_FORMAT
 #define JSON_GAUGE_FORMAT GAUGE_FORMAT
+#define JSON_GAUGE_FORMAT_DEFAULT GAUGE_FORMAT_DEFAULT
 #endif
 
 int format_json_initialize(char *buffer, size_t *ret_buffer_fill,
@@ -42,6 +45,17 @@ int format_json_value_list(char *buffer, size_t *ret_buffer_fill,
                            const value_list_t *vl, int store_rates);
 int format_json_finalize(char *buffer, size_t *ret_buffer_fill,
                          size_t *ret_buffer_free);
+
+/* format_json_value_list_strbuf appends the JSON object describing "vl" to
+ * "buf", preceded by a comma. "cache", if not NULL, caches the identifier
+ * dependent parts of the object. On failure a negative errno value is
+ * returned and "buf" is left unchanged. */
+int format_json_value_list_strbuf(strbuf_t *buf, const data_set_t *ds,
+                                  const value_list_t *vl, bool store_rates,
+                                  format_cache_t *cache);
+/* format_json_finalize_strbuf turns the value lists appended with
+ * format_json_value_list_strbuf() into a JSON array. */
+int format_json_finalize_strbuf(strbuf_t *buf);
 int format_json_notification(char *buffer, size_t buffer_size,
                              notification_t const *n);
 
@@ -0,0 +1,283 @@
+/**
+ * collectd - src/utils/hll/hll.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include "collectd.h"
+
+#include "utils/hll/hll.h"
+
+#include <math.h>
+
+/* Smallest number of slots of the sparse hash table. */
+#define HLL_SPARSE_MIN_SIZE 16
+
+struct hll_s {
+  int precision;
+
+  /* Dense representation: 2^precision registers. Kept allocated after a
+   * reset, so high-cardinality sets do not reallocate every interval. */
+  uint8_t *registers;
+  bool dense;
+
+  /* Sparse representation: open addressing hash table of element hashes.
+   * Zero marks an empty slot, so a hash of zero is stored as one. */
+  uint64_t *sparse;
+  size_t sparse_size;
+  size_t sparse_num;
+};
+
+static size_t hll_registers_num(hll_t const *h) {
+  return ((size_t)1) << h->precision;
+}
+
+/* The sparse table never uses more memory than the registers. With a maximum
+ * load factor of 1/2 this allows 2^precision / 16 exact elements. */
+static size_t hll_sparse_max_size(hll_t const *h) {
+  size_t max_size = hll_registers_num(h) / sizeof(uint64_t);
+  return (max_size < HLL_SPARSE_MIN_SIZE) ? HLL_SPARSE_MIN_SIZE : max_size;
+}
+
+/* FNV-1a followed by the MurmurHash3 finalizer, which is needed to get
+ * well-distributed high bits. */
+uint64_t hll_hash(void const *data, size_t data_size) {
+  uint8_t const *ptr = data;
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < data_size; i++) {
+    hash ^= (uint64_t)ptr[i];
+    hash *= 1099511628211ULL;
+  }
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+
+  return hash;
+}
+
+hll_t *hll_create(int precision) {
+  if ((precision < HLL_PRECISION_MIN) || (precision > HLL_PRECISION_MAX))
+    return NULL;
+
+  hll_t *h = calloc(1, sizeof(*h));
+  if (h == NULL)
+    return NULL;
+
+  h->precision = precision;
+  return h;
+}
+
+void hll_destroy(hll_t *h) {
+  if (h == NULL)
+    return;
+
+  free(h->registers);
+  free(h->sparse);
+  free(h);
+}
+
+static void hll_dense_add(hll_t *h, uint64_t hash) {
+  size_t index = (size_t)(hash >> (64 - h->precision));
+
+  /* Position of the first set bit in the remaining bits. The sentinel bit
+   * limits the result to 64 - precision + 1. */
+  uint64_t w = (hash << h->precision) | (((uint64_t)1) << (h->precision - 1));
+  uint8_t rank = 1;
+  while ((w & (((uint64_t)1) << 63)) == 0) {
+    w <<= 1;
+    rank++;
+  }
+
+  if (h->registers[index] < rank)
+    h->registers[index] = rank;
+}
+
+static int hll_to_dense(hll_t *h) {
+  if (h->dense)
+    return 0;
+
+  if (h->registers == NULL) {
+    h->registers = calloc(hll_registers_num(h), sizeof(*h->registers));
+    if (h->registers == NULL)
+      return ENOMEM;
+  }
+
+  h->dense = true;
+  for (size_t i = 0; i < h->sparse_size; i++)
+    if (h->sparse[i] != 0)
+      hll_dense_add(h, h->sparse[i]);
+
+  /* The sparse table is not needed until the next reset. */
+  free(h->sparse);
+  h->sparse = NULL;
+  h->sparse_size = 0;
+  h->sparse_num = 0;
+  return 0;
+}
+
+/* Returns true if "hash" was not in the table yet. The table must have a
+ * free slot. */
+static bool hll_sparse_insert(uint64_t *table, size_t size, uint64_t hash) {
+  size_t mask = size - 1;
+
+  for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask) {
+    if (table[i] == hash)
+      return false;
+    if (table[i] == 0) {
+      table[i] = hash;
+      return true;
+    }
+  }
+}
+
+static int hll_sparse_grow(hll_t *h) {
+  size_t new_size = (h->sparse_size == 0) ? HLL_SPARSE_MIN_SIZE
+                                          : 2 * h->sparse_size;
+  uint64_t *new_table = calloc(new_size, sizeof(*new_table));
+  if (new_table == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < h->sparse_size; i++)
+    if (h->sparse[i] != 0)
+      hll_sparse_insert(new_table, new_size, h->sparse[i]);
+
+  free(h->sparse);
+  h->sparse = new_table;
+  h->sparse_size = new_size;
+  return 0;
+}
+
+int hll_add_hash(hll_t *h, uint64_t hash) {
+  if (h == NULL)
+    return EINVAL;
+
+  if (h->dense) {
+    hll_dense_add(h, hash);
+    return 0;
+  }
+
+  if (hash == 0)
+    hash = 1;
+
+  /* Keep the load factor at or below 1/2. */
+  if (2 * (h->sparse_num + 1) > h->sparse_size) {
+    int status = (h->sparse_size < hll_sparse_max_size(h)) ? hll_sparse_grow(h)
+                                                           : hll_to_dense(h);
+    if (status != 0)
+      return status;
+
+    if (h->dense) {
+      hll_dense_add(h, hash);
+      return 0;
+    }
+  }
+
+  if (hll_sparse_insert(h->sparse, h->sparse_size, hash))
+    h->sparse_num++;
+  return 0;
+}
+
+int hll_add(hll_t *h, void const *data, size_t data_size) {
+  return hll_add_hash(h, hll_hash(data, data_size));
+}
+
+uint64_t hll_count(hll_t const *h) {
+  if (h == NULL)
+    return 0;
+
+  if (!h->dense)
+    return (uint64_t)h->sparse_num;
+
+  size_t m = hll_registers_num(h);
+  double sum = 0.0;
+  size_t zeros = 0;
+  for (size_t i = 0; i < m; i++) {
+    sum += ldexp(1.0, -(int)h->registers[i]);
+    if (h->registers[i] == 0)
+      zeros++;
+  }
+
+  double alpha;
+  if (m == 16)
+    alpha = 0.673;
+  else if (m == 32)
+    alpha = 0.697;
+  else if (m == 64)
+    alpha = 0.709;
+  else
+    alpha = 0.7213 / (1.0 + 1.079 / (double)m);
+
+  double estimate = alpha * (double)m * (double)m / sum;
+
+  /* Small range correction ("linear counting"). With 64 bit hashes, no
+   * large range correction is required. */
+  if ((estimate <= 2.5 * (double)m) && (zeros != 0))
+    estimate = (double)m * log((double)m / (double)zeros);
+
+  return (uint64_t)(estimate + 0.5);
+}
+
+int hll_merge(hll_t *dst, hll_t const *src) {
+  if ((dst == NULL) || (src == NULL) || (dst->precision != src->precision))
+    return EINVAL;
+
+  if (!src->dense) {
+    for (size_t i = 0; i < src->sparse_size; i++) {
+      if (src->sparse[i] == 0)
+        continue;
+
+      int status = hll_add_hash(dst, src->sparse[i]);
+      if (status != 0)
+        return status;
+    }
+    return 0;
+  }
+
+  int status = hll_to_dense(dst);
+  if (status != 0)
+    return status;
+
+  size_t m = hll_registers_num(dst);
+  for (size_t i = 0; i < m; i++)
+    if (dst->registers[i] < src->registers[i])
+      dst->registers[i] = src->registers[i];
+
+  return 0;
+}
+
+void hll_reset(hll_t *h) {
+  if (h == NULL)
+    return;
+
+  if (h->registers != NULL)
+    memset(h->registers, 0, hll_registers_num(h) * sizeof(*h->registers));
+  if (h->sparse != NULL)
+    memset(h->sparse, 0, h->sparse_size * sizeof(*h->sparse));
+
+  h->dense = false;
+  h->sparse_num = 0;
+}
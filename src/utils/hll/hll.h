@@ -0,0 +1,74 @@
+/**
+ * collectd - src/utils/hll/hll.h
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#ifndef UTILS_HLL_H
+#define UTILS_HLL_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HLL_PRECISION_MIN 4
+#define HLL_PRECISION_MAX 18
+
+/* hll_t estimates the number of distinct elements of a multiset
+ * ("cardinality") using the HyperLogLog algorithm. With a precision of "p",
+ * 2^p one-byte registers are used and the standard error is 1.04/sqrt(2^p),
+ * e.g. 0.8% with p=14 (16 KiB).
+ *
+ * As long as few elements have been added, the 64 bit hashes of the elements
+ * are stored instead ("sparse" representation). The count is exact in this
+ * mode, apart from hash collisions, which are extremely unlikely. Once the
+ * hashes would use more memory than the registers, the counter switches to
+ * the "dense" representation. */
+struct hll_s;
+typedef struct hll_s hll_t;
+
+/* hll_create allocates a new counter with the given precision, which must be
+ * between HLL_PRECISION_MIN and HLL_PRECISION_MAX. Returns NULL on error. */
+hll_t *hll_create(int precision);
+void hll_destroy(hll_t *h);
+
+/* hll_add adds an element to the set. Adding an element more than once does
+ * not change the count. */
+int hll_add(hll_t *h, void const *data, size_t data_size);
+
+/* hll_add_hash adds an element by its hash, which must be a well-distributed
+ * 64 bit hash, e.g. as returned by hll_hash(). */
+int hll_add_hash(hll_t *h, uint64_t hash);
+
+uint64_t hll_hash(void const *data, size_t data_size);
+
+/* hll_count returns the (estimated) number of distinct elements. */
+uint64_t hll_count(hll_t const *h);
+
+/* hll_merge adds all elements of "src" to "dst". Both counters must have the
+ * same precision. "src" is not modified. */
+int hll_merge(hll_t *dst, hll_t const *src);
+
+/* hll_reset removes all elements. Allocated memory is kept for reuse. */
+void hll_reset(hll_t *h);
+
+#endif /* UTILS_HLL_H */
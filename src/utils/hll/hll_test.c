@@ -0,0 +1,134 @@
+/**
+ * collectd - src/utils/hll/hll_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include "collectd.h"
+#include "utils/common/common.h" /* for STATIC_ARRAY_SIZE */
+
+#include "testing.h"
+#include "utils/hll/hll.h"
+
+static int add_range(hll_t *h, size_t first, size_t num) {
+  for (size_t i = first; i < first + num; i++) {
+    char key[32];
+    snprintf(key, sizeof(key), "user%zu", i);
+
+    int status = hll_add(h, key, strlen(key));
+    if (status != 0)
+      return status;
+  }
+  return 0;
+}
+
+DEF_TEST(invalid_precision) {
+  OK(hll_create(HLL_PRECISION_MIN - 1) == NULL);
+  OK(hll_create(HLL_PRECISION_MAX + 1) == NULL);
+  return 0;
+}
+
+DEF_TEST(sparse_is_exact) {
+  hll_t *h;
+  CHECK_NOT_NULL(h = hll_create(14));
+
+  EXPECT_EQ_UINT64(0, hll_count(h));
+
+  /* 2^14 / 16 = 1024 elements fit into the sparse representation. */
+  CHECK_ZERO(add_range(h, 0, 1000));
+  CHECK_ZERO(add_range(h, 0, 1000));
+  EXPECT_EQ_UINT64(1000, hll_count(h));
+
+  hll_reset(h);
+  EXPECT_EQ_UINT64(0, hll_count(h));
+  CHECK_ZERO(add_range(h, 500, 10));
+  EXPECT_EQ_UINT64(10, hll_count(h));
+
+  hll_destroy(h);
+  return 0;
+}
+
+DEF_TEST(dense_estimate) {
+  size_t cases[] = {2000, 20000, 200000, 1000000};
+
+  hll_t *h;
+  CHECK_NOT_NULL(h = hll_create(14));
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    hll_reset(h);
+    CHECK_ZERO(add_range(h, 0, cases[i]));
+    /* Adding elements again must not change the estimate. */
+    uint64_t count = hll_count(h);
+    CHECK_ZERO(add_range(h, 0, cases[i] / 2));
+    EXPECT_EQ_UINT64(count, hll_count(h));
+
+    double error = fabs((double)count - (double)cases[i]) / (double)cases[i];
+    printf("# %zu elements: estimate %" PRIu64 ", error %.4f\n", cases[i],
+           count, error);
+    /* The standard error with p=14 is 0.8%. */
+    OK(error < 0.03);
+  }
+
+  hll_destroy(h);
+  return 0;
+}
+
+DEF_TEST(merge) {
+  hll_t *a;
+  hll_t *b;
+  hll_t *c;
+  CHECK_NOT_NULL(a = hll_create(12));
+  CHECK_NOT_NULL(b = hll_create(12));
+  CHECK_NOT_NULL(c = hll_create(12));
+
+  /* sparse into sparse */
+  CHECK_ZERO(add_range(a, 0, 100));
+  CHECK_ZERO(add_range(b, 50, 100));
+  CHECK_ZERO(hll_merge(a, b));
+  EXPECT_EQ_UINT64(150, hll_count(a));
+
+  /* dense into sparse */
+  CHECK_ZERO(add_range(c, 0, 50000));
+  CHECK_ZERO(hll_merge(a, c));
+  double error = fabs((double)hll_count(a) - 50000.0) / 50000.0;
+  OK(error < 0.06);
+
+  hll_t *other;
+  CHECK_NOT_NULL(other = hll_create(13));
+  OK(hll_merge(a, other) == EINVAL);
+  hll_destroy(other);
+
+  hll_destroy(a);
+  hll_destroy(b);
+  hll_destroy(c);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(invalid_precision);
+  RUN_TEST(sparse_is_exact);
+  RUN_TEST(dense_estimate);
+  RUN_TEST(merge);
+
+  END_TEST;
+}
@@ -37,11 +37,30 @@
 #define LLONG_MAX 9223372036854775807LL
 #endif
 
-#ifndef HISTOGRAM_DEFAULT_BIN_WIDTH
-/* 1048576 = 2^20 ^= 1/1024 s */
-#define HISTOGRAM_DEFAULT_BIN_WIDTH 1048576
-#endif
+#define LATENCY_SUB_BUCKETS ((size_t)1 << LATENCY_SUB_BUCKET_BITS)
+
+/* Latencies are limited to LLONG_MAX, i.e. 63 bits. */
+#define LATENCY_BUCKETS_MAX                                                    \
+  ((63 - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
 
+#define LATENCY_SERIALIZE_VERSION 1
+
+/*
+ * The histogram is "log-linear": every power of two ("octave") is split into
+ * LATENCY_SUB_BUCKETS buckets of equal width. The width of a bucket is
+ * therefore at most 1/LATENCY_SUB_BUCKETS of its lower bound, i.e. the
+ * relative error of any percentile is bounded, no matter how wide the
+ * distribution is. Values smaller than LATENCY_SUB_BUCKETS (in cdtime_t
+ * units) are stored exactly.
+ *
+ * Like before, buckets have an exclusive lower and an inclusive upper bound:
+ * a latency "l" is sorted into the bucket of "l - 1".
+ *
+ * Only the range of buckets between the smallest and the largest latency seen
+ * so far is allocated ("counts_offset" to "counts_offset + counts_num"), so a
+ * counter of typical latencies, spanning a few octaves, uses a few KiB. The
+ * memory is kept when the counter is reset.
+ */
 struct latency_counter_s {
   cdtime_t start_time;
 
@@ -51,67 +70,98 @@ struct latency_counter_s {
   cdtime_t min;
   cdtime_t max;
 
-  cdtime_t bin_width;
-  int histogram[HISTOGRAM_NUM_BINS];
+  uint32_t *counts;
+  size_t counts_offset;
+  size_t counts_num;
 };
 
-/*
- * Histogram represents the distribution of data, it has a list of "bins".
- * Each bin represents an interval and has a count (frequency) of
- * number of values fall within its interval.
- *
- * Histogram's range is determined by the number of bins and the bin width,
- * There are 1000 bins and all bins have the same width of default 1
- * millisecond. When a value above this range is added, Histogram's range is
- * increased by increasing the bin width (note that number of bins remains
- * always at 1000). This operation of increasing bin width is little expensive
- * as each bin need to be visited to update its count. To reduce frequent change
- * of bin width, new bin width will be the next nearest power of 2. Example: 2,
- * 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 5086, ...
- *
- * So, if the required bin width is 300, then new bin width will be 512 as it is
- * the next nearest power of 2.
- */
-static void change_bin_width(latency_counter_t *lc, cdtime_t latency) /* {{{ */
+static int latency_msb(uint64_t v) /* {{{ */
 {
-  /* This function is called because the new value is above histogram's range.
-   * First find the required bin width:
-   *           requiredBinWidth = (value + 1) / numBins
-   * then get the next nearest power of 2
-   *           newBinWidth = 2^(ceil(log2(requiredBinWidth)))
-   */
-  double required_bin_width =
-      ((double)(latency + 1)) / ((double)HISTOGRAM_NUM_BINS);
-  double required_bin_width_logbase2 = log(required_bin_width) / log(2.0);
-  cdtime_t new_bin_width =
-      (cdtime_t)(pow(2.0, ceil(required_bin_width_logbase2)) + .5);
-  cdtime_t old_bin_width = lc->bin_width;
-
-  lc->bin_width = new_bin_width;
-
-  /* bin_width has been increased, now iterate through all bins and move the
-   * old bin's count to new bin. */
-  if (lc->num > 0) // if the histogram has data then iterate else skip
-  {
-    double width_change_ratio =
-        ((double)old_bin_width) / ((double)new_bin_width);
-
-    for (size_t i = 0; i < HISTOGRAM_NUM_BINS; i++) {
-      size_t new_bin = (size_t)(((double)i) * width_change_ratio);
-      if (i == new_bin)
-        continue;
-      assert(new_bin < i);
-
-      lc->histogram[new_bin] += lc->histogram[i];
-      lc->histogram[i] = 0;
-    }
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll((unsigned long long)v);
+#else
+  int msb = 0;
+  while (v >>= 1)
+    msb++;
+  return msb;
+#endif
+} /* }}} int latency_msb */
+
+static size_t bucket_index(cdtime_t latency) /* {{{ */
+{
+  uint64_t v = (uint64_t)(latency - 1);
+  if (v < LATENCY_SUB_BUCKETS)
+    return (size_t)v;
+
+  int shift = latency_msb(v) - LATENCY_SUB_BUCKET_BITS;
+  return ((size_t)shift + 1) * LATENCY_SUB_BUCKETS +
+         (size_t)(v >> shift) - LATENCY_SUB_BUCKETS;
+} /* }}} size_t bucket_index */
+
+/* bucket_lower returns the exclusive lower bound of a bucket. */
+static cdtime_t bucket_lower(size_t index) /* {{{ */
+{
+  if (index < LATENCY_SUB_BUCKETS)
+    return (cdtime_t)index;
+
+  size_t shift = (index / LATENCY_SUB_BUCKETS) - 1;
+  uint64_t mantissa = LATENCY_SUB_BUCKETS + (index % LATENCY_SUB_BUCKETS);
+  return (cdtime_t)(mantissa << shift);
+} /* }}} cdtime_t bucket_lower */
+
+static cdtime_t bucket_width(size_t index) /* {{{ */
+{
+  if (index < LATENCY_SUB_BUCKETS)
+    return 1;
+
+  return ((cdtime_t)1) << ((index / LATENCY_SUB_BUCKETS) - 1);
+} /* }}} cdtime_t bucket_width */
+
+static uint32_t bucket_get(latency_counter_t const *lc, size_t index) /* {{{ */
+{
+  if ((lc->counts == NULL) || (index < lc->counts_offset) ||
+      (index >= lc->counts_offset + lc->counts_num))
+    return 0;
+
+  return lc->counts[index - lc->counts_offset];
+} /* }}} uint32_t bucket_get */
+
+/* counts_reserve makes sure the buckets [first, last] are allocated. The
+ * range is extended to whole octaves to avoid frequent reallocations. */
+static int counts_reserve(latency_counter_t *lc, size_t first, /* {{{ */
+                          size_t last) {
+  if ((lc->counts != NULL) && (first >= lc->counts_offset) &&
+      (last < lc->counts_offset + lc->counts_num))
+    return 0;
+
+  if (lc->counts != NULL) {
+    if (first > lc->counts_offset)
+      first = lc->counts_offset;
+    if (last < lc->counts_offset + lc->counts_num - 1)
+      last = lc->counts_offset + lc->counts_num - 1;
+  }
+
+  first -= first % LATENCY_SUB_BUCKETS;
+  last += LATENCY_SUB_BUCKETS - 1 - (last % LATENCY_SUB_BUCKETS);
+  assert(last < LATENCY_BUCKETS_MAX);
+
+  size_t counts_num = last - first + 1;
+  uint32_t *counts = calloc(counts_num, sizeof(*counts));
+  if (counts == NULL) {
+    P_ERROR("latency_counter: calloc failed.");
+    return ENOMEM;
   }
 
-  DEBUG("utils_latency: change_bin_width: latency = %.3f; "
-        "old_bin_width = %.3f; new_bin_width = %.3f;",
-        CDTIME_T_TO_DOUBLE(latency), CDTIME_T_TO_DOUBLE(old_bin_width),
-        CDTIME_T_TO_DOUBLE(new_bin_width));
-} /* }}} void change_bin_width */
+  if (lc->counts != NULL)
+    memcpy(counts + (lc->counts_offset - first), lc->counts,
+           lc->counts_num * sizeof(*counts));
+
+  sfree(lc->counts);
+  lc->counts = counts;
+  lc->counts_offset = first;
+  lc->counts_num = counts_num;
+  return 0;
+} /* }}} int counts_reserve */
 
 latency_counter_t *latency_counter_create(void) /* {{{ */
 {
@@ -121,23 +171,29 @@ latency_counter_t *latency_counter_create(void) /* {{{ */
   if (lc == NULL)
     return NULL;
 
-  lc->bin_width = HISTOGRAM_DEFAULT_BIN_WIDTH;
   latency_counter_reset(lc);
   return lc;
 } /* }}} latency_counter_t *latency_counter_create */
 
 void latency_counter_destroy(latency_counter_t *lc) /* {{{ */
 {
+  if (lc == NULL)
+    return;
+
+  sfree(lc->counts);
   sfree(lc);
 } /* }}} void latency_counter_destroy */
 
 void latency_counter_add(latency_counter_t *lc, cdtime_t latency) /* {{{ */
 {
-  cdtime_t bin;
-
   if ((lc == NULL) || (latency == 0) || (latency > ((cdtime_t)LLONG_MAX)))
     return;
 
+  size_t index = bucket_index(latency);
+  if (counts_reserve(lc, index, index) != 0)
+    return;
+  lc->counts[index - lc->counts_offset]++;
+
   lc->sum += latency;
   lc->num++;
 
@@ -147,20 +203,6 @@ void latency_counter_add(latency_counter_t *lc, cdtime_t latency) /* {{{ */
     lc->min = latency;
   if (lc->max < latency)
     lc->max = latency;
-
-  /* A latency of _exactly_ 1.0 ms is stored in the buffer 0, so
-   * subtract one from the cdtime_t value so that exactly 1.0 ms get sorted
-   * accordingly. */
-  bin = (latency - 1) / lc->bin_width;
-  if (bin >= HISTOGRAM_NUM_BINS) {
-    change_bin_width(lc, latency);
-    bin = (latency - 1) / lc->bin_width;
-    if (bin >= HISTOGRAM_NUM_BINS) {
-      P_ERROR("latency_counter_add: Invalid bin: %" PRIu64, bin);
-      return;
-    }
-  }
-  lc->histogram[bin]++;
 } /* }}} void latency_counter_add */
 
 void latency_counter_reset(latency_counter_t *lc) /* {{{ */
@@ -168,33 +210,49 @@ void latency_counter_reset(latency_counter_t *lc) /* {{{ */
   if (lc == NULL)
     return;
 
-  cdtime_t bin_width = lc->bin_width;
-  cdtime_t max_bin = (lc->max - 1) / lc->bin_width;
-
-/*
-  If max latency is REDUCE_THRESHOLD times less than histogram's range,
-  then cut it in half. REDUCE_THRESHOLD must be >= 2.
-  Value of 4 is selected to reduce frequent changes of bin width.
-*/
-#define REDUCE_THRESHOLD 4
-  if ((lc->num > 0) && (lc->bin_width >= HISTOGRAM_DEFAULT_BIN_WIDTH * 2) &&
-      (max_bin < HISTOGRAM_NUM_BINS / REDUCE_THRESHOLD)) {
-    /* new bin width will be the previous power of 2 */
-    bin_width = bin_width / 2;
-
-    DEBUG("utils_latency: latency_counter_reset: max_latency = %.3f; "
-          "max_bin = %" PRIu64 "; old_bin_width = %.3f; new_bin_width = %.3f;",
-          CDTIME_T_TO_DOUBLE(lc->max), max_bin,
-          CDTIME_T_TO_DOUBLE(lc->bin_width), CDTIME_T_TO_DOUBLE(bin_width));
-  }
-
-  memset(lc, 0, sizeof(*lc));
+  /* Keep the allocated buckets: the next interval will most likely see
+   * latencies in the same range. */
+  if (lc->counts != NULL)
+    memset(lc->counts, 0, lc->counts_num * sizeof(*lc->counts));
 
-  /* preserve bin width */
-  lc->bin_width = bin_width;
+  lc->sum = 0;
+  lc->num = 0;
+  lc->min = 0;
+  lc->max = 0;
   lc->start_time = cdtime();
 } /* }}} void latency_counter_reset */
 
+int latency_counter_merge(latency_counter_t *dst, /* {{{ */
+                          latency_counter_t const *src) {
+  if ((dst == NULL) || (src == NULL))
+    return EINVAL;
+
+  if (src->num == 0)
+    return 0;
+
+  /* Only reserve the buckets actually used by "src". */
+  size_t first = bucket_index(src->min);
+  size_t last = bucket_index(src->max);
+  int status = counts_reserve(dst, first, last);
+  if (status != 0)
+    return status;
+
+  for (size_t i = first; i <= last; i++)
+    dst->counts[i - dst->counts_offset] += src->counts[i - src->counts_offset];
+
+  if ((dst->num == 0) || (dst->min > src->min))
+    dst->min = src->min;
+  if (dst->max < src->max)
+    dst->max = src->max;
+  dst->sum += src->sum;
+  dst->num += src->num;
+
+  if (dst->start_time > src->start_time)
+    dst->start_time = src->start_time;
+
+  return 0;
+} /* }}} int latency_counter_merge */
+
 cdtime_t latency_counter_get_min(latency_counter_t *lc) /* {{{ */
 {
   if (lc == NULL)
@@ -236,51 +294,42 @@ cdtime_t latency_counter_get_average(latency_counter_t *lc) /* {{{ */
 
 cdtime_t latency_counter_get_percentile(latency_counter_t *lc, /* {{{ */
                                         double percent) {
-  double percent_upper;
-  double percent_lower;
-  double p;
-  cdtime_t latency_lower;
-  cdtime_t latency_interpolated;
-  int sum;
-  size_t i;
-
   if ((lc == NULL) || (lc->num == 0) || !((percent > 0.0) && (percent < 100.0)))
     return 0;
 
-  /* Find index i so that at least "percent" events are within i+1 ms. */
-  percent_upper = 0.0;
-  percent_lower = 0.0;
-  sum = 0;
-  for (i = 0; i < HISTOGRAM_NUM_BINS; i++) {
-    percent_lower = percent_upper;
-    sum += lc->histogram[i];
-    if (sum == 0)
-      percent_upper = 0.0;
-    else
-      percent_upper = 100.0 * ((double)sum) / ((double)lc->num);
-
-    if (percent_upper >= percent)
-      break;
-  }
+  /* Number of events that are smaller than or equal to the percentile. */
+  double rank = percent * ((double)lc->num) / 100.0;
 
-  if (i >= HISTOGRAM_NUM_BINS)
-    return 0;
+  /* The buckets holding the smallest and largest latency are the first and
+   * last ones with a non-zero count. */
+  size_t first = bucket_index(lc->min) - lc->counts_offset;
+  size_t last = bucket_index(lc->max) - lc->counts_offset;
 
-  assert(percent_upper >= percent);
-  assert(percent_lower < percent);
+  double sum = 0.0;
+  size_t i;
+  for (i = first; i < last; i++) {
+    if ((sum + (double)lc->counts[i]) >= rank)
+      break;
+    sum += (double)lc->counts[i];
+  }
 
-  if (i == 0)
-    return lc->bin_width;
+  /* Interpolate linearly within the bucket. */
+  size_t index = i + lc->counts_offset;
+  double p = (rank - sum) / ((double)lc->counts[i]);
+  if (p > 1.0)
+    p = 1.0;
 
-  latency_lower = ((cdtime_t)i) * lc->bin_width;
-  p = (percent - percent_lower) / (percent_upper - percent_lower);
+  cdtime_t latency =
+      bucket_lower(index) + (cdtime_t)(p * (double)bucket_width(index) + .5);
 
-  latency_interpolated =
-      latency_lower + DOUBLE_TO_CDTIME_T(p * CDTIME_T_TO_DOUBLE(lc->bin_width));
+  if (latency < lc->min)
+    latency = lc->min;
+  if (latency > lc->max)
+    latency = lc->max;
 
   DEBUG("latency_counter_get_percentile: latency_interpolated = %.3f",
-        CDTIME_T_TO_DOUBLE(latency_interpolated));
-  return latency_interpolated;
+        CDTIME_T_TO_DOUBLE(latency));
+  return latency;
 } /* }}} cdtime_t latency_counter_get_percentile */
 
 double latency_counter_get_rate(const latency_counter_t *lc, /* {{{ */
@@ -294,51 +343,174 @@ double latency_counter_get_rate(const latency_counter_t *lc, /* {{{ */
   if (lower == upper)
     return 0;
 
-  /* Buckets have an exclusive lower bound and an inclusive upper bound. That
-   * means that the first bucket, index 0, represents (0-bin_width]. That means
-   * that latency==bin_width needs to result in bin=0, that's why we need to
-   * subtract one before dividing by bin_width. */
-  cdtime_t lower_bin = 0;
-  if (lower)
-    /* lower is *exclusive* => determine bucket for lower+1 */
-    lower_bin = ((lower + 1) - 1) / lc->bin_width;
-
-  /* lower is greater than the longest latency observed => rate is zero. */
-  if (lower_bin >= HISTOGRAM_NUM_BINS)
+  /* Both ends of the interval are rounded to bucket boundaries; the counts of
+   * buckets only partially within (lower, upper] are scaled accordingly. */
+  double sum = 0;
+  for (size_t i = 0; i < lc->counts_num; i++) {
+    if (lc->counts[i] == 0)
+      continue;
+
+    cdtime_t bucket_lower_bound = bucket_lower(i + lc->counts_offset);
+    cdtime_t bucket_upper_bound =
+        bucket_lower_bound + bucket_width(i + lc->counts_offset);
+
+    if (upper && (bucket_lower_bound >= upper))
+      break;
+    if (bucket_upper_bound <= lower)
+      continue;
+
+    cdtime_t from = (lower > bucket_lower_bound) ? lower : bucket_lower_bound;
+    cdtime_t to = (upper && (upper < bucket_upper_bound)) ? upper
+                                                          : bucket_upper_bound;
+
+    sum += ((double)lc->counts[i]) * ((double)(to - from)) /
+           ((double)(bucket_upper_bound - bucket_lower_bound));
+  }
+
+  return sum / (CDTIME_T_TO_DOUBLE(now - lc->start_time));
+} /* }}} double latency_counter_get_rate */
+
+/* The serialized form is a sequence of unsigned LEB128 encoded integers:
+ *
+ *   version, sub-bucket bits, start time, sum, num, min, max, buckets num,
+ *   followed by (index delta, count) for each non-empty bucket.
+ *
+ * The index delta is the distance to the previous non-empty bucket (or to
+ * zero for the first one). */
+static void varint_write(uint8_t *buffer, size_t buffer_size, /* {{{ */
+                         size_t *pos, uint64_t v) {
+  do {
+    uint8_t b = (uint8_t)(v & 0x7f);
+    v >>= 7;
+    if (v != 0)
+      b |= 0x80;
+
+    if (*pos < buffer_size)
+      buffer[*pos] = b;
+    (*pos)++;
+  } while (v != 0);
+} /* }}} void varint_write */
+
+static int varint_read(uint8_t const *buffer, size_t buffer_size, /* {{{ */
+                       size_t *pos, uint64_t *ret_v) {
+  uint64_t v = 0;
+
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*pos >= buffer_size)
+      return EILSEQ;
+
+    uint8_t b = buffer[*pos];
+    (*pos)++;
+
+    v |= ((uint64_t)(b & 0x7f)) << shift;
+    if ((b & 0x80) == 0) {
+      *ret_v = v;
+      return 0;
+    }
+  }
+
+  return EILSEQ;
+} /* }}} int varint_read */
+
+size_t latency_counter_serialize(latency_counter_t const *lc, /* {{{ */
+                                 void *buffer, size_t buffer_size) {
+  if (lc == NULL)
     return 0;
 
-  cdtime_t upper_bin = HISTOGRAM_NUM_BINS - 1;
-  if (upper)
-    upper_bin = (upper - 1) / lc->bin_width;
+  size_t buckets_num = 0;
+  for (size_t i = 0; i < lc->counts_num; i++)
+    if (lc->counts[i] != 0)
+      buckets_num++;
+
+  size_t pos = 0;
+  varint_write(buffer, buffer_size, &pos, LATENCY_SERIALIZE_VERSION);
+  varint_write(buffer, buffer_size, &pos, LATENCY_SUB_BUCKET_BITS);
+  varint_write(buffer, buffer_size, &pos, lc->start_time);
+  varint_write(buffer, buffer_size, &pos, lc->sum);
+  varint_write(buffer, buffer_size, &pos, (uint64_t)lc->num);
+  varint_write(buffer, buffer_size, &pos, lc->min);
+  varint_write(buffer, buffer_size, &pos, lc->max);
+  varint_write(buffer, buffer_size, &pos, (uint64_t)buckets_num);
+
+  size_t prev = 0;
+  for (size_t i = 0; i < lc->counts_num; i++) {
+    if (lc->counts[i] == 0)
+      continue;
+
+    size_t index = i + lc->counts_offset;
+    varint_write(buffer, buffer_size, &pos, (uint64_t)(index - prev));
+    varint_write(buffer, buffer_size, &pos, lc->counts[i]);
+    prev = index;
+  }
+
+  return pos;
+} /* }}} size_t latency_counter_serialize */
+
+latency_counter_t *latency_counter_deserialize(void const *buffer, /* {{{ */
+                                               size_t buffer_size) {
+  uint64_t header[8];
+  size_t pos = 0;
+
+  if (buffer == NULL)
+    return NULL;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(header); i++)
+    if (varint_read(buffer, buffer_size, &pos, header + i) != 0)
+      return NULL;
 
-  if (upper_bin >= HISTOGRAM_NUM_BINS) {
-    upper_bin = HISTOGRAM_NUM_BINS - 1;
-    upper = 0;
+  if ((header[0] != LATENCY_SERIALIZE_VERSION) ||
+      (header[1] != LATENCY_SUB_BUCKET_BITS)) {
+    P_ERROR("latency_counter_deserialize: Unsupported format (version %" PRIu64
+            ", %" PRIu64 " sub-bucket bits).",
+            header[0], header[1]);
+    return NULL;
   }
 
-  double sum = 0;
-  for (size_t i = lower_bin; i <= upper_bin; i++)
-    sum += lc->histogram[i];
-
-  if (lower) {
-    /* Approximate ratio of requests in lower_bin, that fall between
-     * lower_bin_boundary and lower. This ratio is then subtracted from sum to
-     * increase accuracy. */
-    cdtime_t lower_bin_boundary = lower_bin * lc->bin_width;
-    assert(lower >= lower_bin_boundary);
-    double lower_ratio =
-        (double)(lower - lower_bin_boundary) / ((double)lc->bin_width);
-    sum -= lower_ratio * lc->histogram[lower_bin];
+  latency_counter_t *lc = latency_counter_create();
+  if (lc == NULL)
+    return NULL;
+
+  lc->start_time = (cdtime_t)header[2];
+  lc->sum = (cdtime_t)header[3];
+  lc->num = (size_t)header[4];
+  lc->min = (cdtime_t)header[5];
+  lc->max = (cdtime_t)header[6];
+
+  uint64_t buckets_num = header[7];
+  uint64_t total = 0;
+  size_t index = 0;
+  for (uint64_t i = 0; i < buckets_num; i++) {
+    uint64_t delta;
+    uint64_t count;
+
+    if ((varint_read(buffer, buffer_size, &pos, &delta) != 0) ||
+        (varint_read(buffer, buffer_size, &pos, &count) != 0) ||
+        (delta >= LATENCY_BUCKETS_MAX) ||
+        (index + delta >= LATENCY_BUCKETS_MAX) || (count > UINT32_MAX)) {
+      latency_counter_destroy(lc);
+      return NULL;
+    }
+
+    index += (size_t)delta;
+    if (counts_reserve(lc, index, index) != 0) {
+      latency_counter_destroy(lc);
+      return NULL;
+    }
+    lc->counts[index - lc->counts_offset] += (uint32_t)count;
+    total += count;
   }
 
-  if (upper) {
-    /* As above: approximate ratio of requests in upper_bin, that fall between
-     * upper and upper_bin_boundary. */
-    cdtime_t upper_bin_boundary = (upper_bin + 1) * lc->bin_width;
-    assert(upper <= upper_bin_boundary);
-    double ratio = (double)(upper_bin_boundary - upper) / (double)lc->bin_width;
-    sum -= ratio * lc->histogram[upper_bin];
+  /* The percentile and merge code relies on min and max being within the
+   * populated buckets. */
+  if ((total != lc->num) ||
+      ((lc->num > 0) &&
+       ((lc->min == 0) || (lc->min > lc->max) ||
+        (lc->max > (cdtime_t)LLONG_MAX) ||
+        (bucket_get(lc, bucket_index(lc->min)) == 0) ||
+        (bucket_get(lc, bucket_index(lc->max)) == 0)))) {
+    latency_counter_destroy(lc);
+    return NULL;
   }
 
-  return sum / (CDTIME_T_TO_DOUBLE(now - lc->start_time));
-} /* }}} double latency_counter_get_rate */
+  return lc;
+} /* }}} latency_counter_t *latency_counter_deserialize */
@@ -31,8 +31,11 @@
 
 #include "utils_time.h"
 
-#ifndef HISTOGRAM_NUM_BINS
-#define HISTOGRAM_NUM_BINS 1000
+/* Each power of two is split into 2^LATENCY_SUB_BUCKET_BITS buckets. The
+ * relative error of percentiles is bounded by 2^-LATENCY_SUB_BUCKET_BITS,
+ * i.e. 0.8% with the default of 7. */
+#ifndef LATENCY_SUB_BUCKET_BITS
+#define LATENCY_SUB_BUCKET_BITS 7
 #endif
 
 struct latency_counter_s;
@@ -44,6 +47,10 @@ void latency_counter_destroy(latency_counter_t *lc);
 void latency_counter_add(latency_counter_t *lc, cdtime_t latency);
 void latency_counter_reset(latency_counter_t *lc);
 
+/* latency_counter_merge adds all latencies recorded by "src" to "dst", e.g. to
+ * combine per-thread counters. "src" is not modified. */
+int latency_counter_merge(latency_counter_t *dst, latency_counter_t const *src);
+
 cdtime_t latency_counter_get_min(latency_counter_t *lc);
 cdtime_t latency_counter_get_max(latency_counter_t *lc);
 cdtime_t latency_counter_get_sum(latency_counter_t *lc);
@@ -65,4 +72,29 @@ cdtime_t latency_counter_get_percentile(latency_counter_t *lc, double percent);
 double latency_counter_get_rate(const latency_counter_t *lc, cdtime_t lower,
                                 cdtime_t upper, const cdtime_t now);
 
+/*
+ * NAME
+ *  latency_counter_serialize(counter,buffer,buffer_size)
+ *
+ * DESCRIPTION
+ *   Writes a compact, architecture independent representation of the counter
+ *   to "buffer". Only non-empty buckets are stored. Returns the number of
+ *   bytes required; if this is larger than "buffer_size", the output has been
+ *   truncated. Call with a NULL buffer to determine the required size.
+ */
+size_t latency_counter_serialize(latency_counter_t const *lc, void *buffer,
+                                 size_t buffer_size);
+
+/*
+ * NAME
+ *  latency_counter_deserialize(buffer,buffer_size)
+ *
+ * DESCRIPTION
+ *   Creates a counter from the output of latency_counter_serialize(). Returns
+ *   NULL if the data is malformed. The returned counter must be freed with
+ *   latency_counter_destroy().
+ */
+latency_counter_t *latency_counter_deserialize(void const *buffer,
+                                               size_t buffer_size);
+
 #endif /* UTILS_LATENCY_LATENCY_H */
@@ -102,15 +102,10 @@ DEF_TEST(percentile) {
 }
 
 DEF_TEST(get_rate) {
-  /* We re-declare the struct here so we can inspect its content. */
+  /* We re-declare the start of the struct here so we can inspect its
+   * content. */
   struct {
     cdtime_t start_time;
-    cdtime_t sum;
-    size_t num;
-    cdtime_t min;
-    cdtime_t max;
-    cdtime_t bin_width;
-    int histogram[HISTOGRAM_NUM_BINS];
   } * peek;
   latency_counter_t *l;
 
@@ -121,77 +116,47 @@ DEF_TEST(get_rate) {
     latency_counter_add(l, TIME_T_TO_CDTIME_T(i));
   }
 
-  /* We expect a bucket width of 125ms. */
-  EXPECT_EQ_UINT64(DOUBLE_TO_CDTIME_T(0.125), peek->bin_width);
-
-  struct {
-    size_t index;
-    int want;
-  } bucket_cases[] = {
-      {0, 0},  /* (0.000-0.125] */
-      {1, 0},  /* (0.125-0.250] */
-      {2, 0},  /* (0.250-0.375] */
-      {3, 0},  /* (0.375-0.500] */
-      {4, 0},  /* (0.500-0.625] */
-      {5, 0},  /* (0.625-0.750] */
-      {6, 0},  /* (0.750-0.875] */
-      {7, 1},  /* (0.875-1.000] */
-      {8, 0},  /* (1.000-1.125] */
-      {9, 0},  /* (1.125-1.250] */
-      {10, 0}, /* (1.250-1.375] */
-      {11, 0}, /* (1.375-1.500] */
-      {12, 0}, /* (1.500-1.625] */
-      {13, 0}, /* (1.625-1.750] */
-      {14, 0}, /* (1.750-1.875] */
-      {15, 1}, /* (1.875-2.000] */
-      {16, 0}, /* (2.000-2.125] */
-  };
-
-  for (size_t i = 0; i < STATIC_ARRAY_SIZE(bucket_cases); i++) {
-    size_t index = bucket_cases[i].index;
-    EXPECT_EQ_INT(bucket_cases[i].want, peek->histogram[index]);
-  }
-
   struct {
     cdtime_t lower_bound;
     cdtime_t upper_bound;
     double want;
   } cases[] = {
       {
-          // bucket 6 is zero
+          // no updates in (0.750, 0.875]
           DOUBLE_TO_CDTIME_T_STATIC(0.750),
           DOUBLE_TO_CDTIME_T_STATIC(0.875),
           0.00,
       },
       {
-          // bucket 7 contains the t=1 update
+          // contains the t=1 update
           DOUBLE_TO_CDTIME_T_STATIC(0.875),
           DOUBLE_TO_CDTIME_T_STATIC(1.000),
           1.00,
       },
       {
-          // range: bucket 7 - bucket 15; contains the t=1 and t=2 updates
+          // contains the t=1 and t=2 updates
           DOUBLE_TO_CDTIME_T_STATIC(0.875),
           DOUBLE_TO_CDTIME_T_STATIC(2.000),
           2.00,
       },
       {
-          // lower bucket is only partially applied
-          DOUBLE_TO_CDTIME_T_STATIC(0.875 + (0.125 / 4)),
+          // lower bucket is only partially applied; the t=1 update is in the
+          // bucket (1-1/256, 1], the t=2 update in (2-1/128, 2].
+          DOUBLE_TO_CDTIME_T_STATIC(1.000 - (1.0 / 1024)),
           DOUBLE_TO_CDTIME_T_STATIC(2.000),
-          1.75,
+          1.25,
       },
       {
           // upper bucket is only partially applied
           DOUBLE_TO_CDTIME_T_STATIC(0.875),
-          DOUBLE_TO_CDTIME_T_STATIC(2.000 - (0.125 / 4)),
+          DOUBLE_TO_CDTIME_T_STATIC(2.000 - (1.0 / 512)),
           1.75,
       },
       {
           // both buckets are only partially applied
-          DOUBLE_TO_CDTIME_T_STATIC(0.875 + (0.125 / 4)),
-          DOUBLE_TO_CDTIME_T_STATIC(2.000 - (0.125 / 4)),
-          1.50,
+          DOUBLE_TO_CDTIME_T_STATIC(1.000 - (1.0 / 1024)),
+          DOUBLE_TO_CDTIME_T_STATIC(2.000 - (1.0 / 512)),
+          1.00,
       },
       {
           // lower bound is unspecified
@@ -201,7 +166,7 @@ DEF_TEST(get_rate) {
       },
       {
           // upper bound is unspecified
-          DOUBLE_TO_CDTIME_T_STATIC(125.000 - 0.125),
+          DOUBLE_TO_CDTIME_T_STATIC(125.000 - 0.5),
           0,
           1.00,
       },
@@ -242,10 +207,105 @@ DEF_TEST(get_rate) {
   return 0;
 }
 
+DEF_TEST(relative_error) {
+  latency_counter_t *l;
+
+  CHECK_NOT_NULL(l = latency_counter_create());
+
+  /* Log-uniform distribution from 1 µs to 100 s. */
+  size_t num = 100000;
+  for (size_t i = 0; i < num; i++) {
+    double v = 1e-6 * pow(1e8, ((double)i) / ((double)num));
+    latency_counter_add(l, DOUBLE_TO_CDTIME_T(v));
+  }
+
+  double percentiles[] = {1.0, 50.0, 90.0, 99.0, 99.9, 99.99};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(percentiles); i++) {
+    double want = 1e-6 * pow(1e8, percentiles[i] / 100.0);
+    double got =
+        CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(l, percentiles[i]));
+    printf("# p%g: want %g, got %g\n", percentiles[i], want, got);
+    OK(fabs(got - want) / want < 1.0 / 128.0);
+  }
+
+  latency_counter_destroy(l);
+  return 0;
+}
+
+DEF_TEST(merge) {
+  latency_counter_t *all;
+  latency_counter_t *even;
+  latency_counter_t *odd;
+
+  CHECK_NOT_NULL(all = latency_counter_create());
+  CHECK_NOT_NULL(even = latency_counter_create());
+  CHECK_NOT_NULL(odd = latency_counter_create());
+
+  for (size_t i = 1; i <= 1000; i++) {
+    cdtime_t v = MS_TO_CDTIME_T(i * i);
+    latency_counter_add(all, v);
+    latency_counter_add((i % 2) ? odd : even, v);
+  }
+
+  CHECK_ZERO(latency_counter_merge(even, odd));
+
+  EXPECT_EQ_UINT64(latency_counter_get_num(all),
+                   latency_counter_get_num(even));
+  EXPECT_EQ_UINT64(latency_counter_get_sum(all),
+                   latency_counter_get_sum(even));
+  EXPECT_EQ_UINT64(latency_counter_get_min(all),
+                   latency_counter_get_min(even));
+  EXPECT_EQ_UINT64(latency_counter_get_max(all),
+                   latency_counter_get_max(even));
+  for (double p = 10.0; p < 100.0; p += 10.0) {
+    EXPECT_EQ_UINT64(latency_counter_get_percentile(all, p),
+                     latency_counter_get_percentile(even, p));
+  }
+
+  latency_counter_destroy(all);
+  latency_counter_destroy(even);
+  latency_counter_destroy(odd);
+  return 0;
+}
+
+DEF_TEST(serialize) {
+  latency_counter_t *l;
+  latency_counter_t *copy;
+
+  CHECK_NOT_NULL(l = latency_counter_create());
+
+  for (size_t i = 1; i <= 1000; i++)
+    latency_counter_add(l, US_TO_CDTIME_T(i * 37));
+
+  size_t size = latency_counter_serialize(l, NULL, 0);
+  OK(size > 0);
+
+  uint8_t buffer[size];
+  EXPECT_EQ_UINT64(size, latency_counter_serialize(l, buffer, sizeof(buffer)));
+
+  CHECK_NOT_NULL(copy = latency_counter_deserialize(buffer, sizeof(buffer)));
+  EXPECT_EQ_UINT64(latency_counter_get_num(l), latency_counter_get_num(copy));
+  EXPECT_EQ_UINT64(latency_counter_get_sum(l), latency_counter_get_sum(copy));
+  EXPECT_EQ_UINT64(latency_counter_get_min(l), latency_counter_get_min(copy));
+  EXPECT_EQ_UINT64(latency_counter_get_max(l), latency_counter_get_max(copy));
+  EXPECT_EQ_UINT64(latency_counter_get_percentile(l, 99.9),
+                   latency_counter_get_percentile(copy, 99.9));
+  latency_counter_destroy(copy);
+
+  /* Truncated input must be rejected. */
+  OK(latency_counter_deserialize(buffer, sizeof(buffer) - 1) == NULL);
+
+  latency_counter_destroy(l);
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(simple);
   RUN_TEST(percentile);
   RUN_TEST(get_rate);
+  RUN_TEST(relative_error);
+  RUN_TEST(merge);
+  RUN_TEST(serialize);
 
   END_TEST;
 }
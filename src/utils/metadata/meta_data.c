@@ -32,6 +32,11 @@
 
 #define MD_MAX_NONSTRING_CHARS 128
 
+/* Initial capacity of a block. Most value lists carry only a handful of meta
+ * data entries, so these are usually the only allocation ever made. */
+#define MD_ENTRIES_INIT 4
+#define MD_DATA_INIT 128
+
 /*
  * Data types
  */
@@ -47,13 +52,32 @@ typedef union meta_value_u meta_value_t;
 struct meta_entry_s {
   char *key;
   meta_value_t value;
+  uint32_t hash;
+  /* A type of zero marks the end of the entries array. */
   int type;
-  meta_entry_t *next;
 };
 
+/* All entries, keys and string values of a meta data object live in a single
+ * allocation. The entries array holds "entries_size" entries plus a
+ * terminating one; the "data" area for keys and strings follows directly
+ * after it.
+ *
+ * Blocks are reference counted and shared between clones. A block is only
+ * ever modified while its reference count is one; otherwise it is copied
+ * first. Cloning is therefore a reference count increment and blocks that
+ * have been cloned (e.g. when a value list is dispatched) are immutable. */
+struct md_block_s {
+  uint32_t refcount;
+  size_t entries_num;
+  size_t entries_size;
+  size_t data_len;
+  size_t data_size;
+  meta_entry_t entries[];
+};
+typedef struct md_block_s md_block_t;
+
 struct meta_data_s {
-  meta_entry_t *head;
-  pthread_mutex_t lock;
+  md_block_t *block;
 };
 
 /*
@@ -77,204 +101,208 @@ static char *md_strdup(const char *orig) /* {{{ */
   return dest;
 } /* }}} char *md_strdup */
 
-static meta_entry_t *md_entry_alloc(const char *key) /* {{{ */
+/* Case insensitive FNV-1a hash, so that lookups only need to call strcasecmp()
+ * for entries which are very likely to match. */
+static uint32_t md_hash(const char *key) /* {{{ */
 {
-  meta_entry_t *e;
+  uint32_t hash = 2166136261u;
 
-  e = calloc(1, sizeof(*e));
-  if (e == NULL) {
-    ERROR("md_entry_alloc: calloc failed.");
-    return NULL;
+  for (const char *ptr = key; *ptr != 0; ptr++) {
+    hash ^= (uint32_t)tolower((unsigned char)*ptr);
+    hash *= 16777619u;
   }
 
-  e->key = md_strdup(key);
-  if (e->key == NULL) {
-    free(e);
-    ERROR("md_entry_alloc: md_strdup failed.");
-    return NULL;
-  }
-
-  e->type = 0;
-  e->next = NULL;
-
-  return e;
-} /* }}} meta_entry_t *md_entry_alloc */
+  return hash;
+} /* }}} uint32_t md_hash */
 
-/* XXX: The lock on md must be held while calling this function! */
-static meta_entry_t *md_entry_clone_contents(const meta_entry_t *orig) /* {{{ */
+static char *md_block_data(md_block_t *b) /* {{{ */
 {
-  meta_entry_t *copy;
-
-  /* WARNINGS :
-   *  - we do not check that orig != NULL here. You should have done it before.
-   *  - we do not set copy->next. DO NOT FORGET TO SET copy->next IN YOUR
-   * FUNCTION
-   */
-
-  copy = md_entry_alloc(orig->key);
-  if (copy == NULL)
+  return (char *)(b->entries + b->entries_size + 1);
+} /* }}} char *md_block_data */
+
+static md_block_t *md_block_alloc(size_t entries_size, /* {{{ */
+                                  size_t data_size) {
+  md_block_t *b = malloc(sizeof(*b) +
+                         (entries_size + 1) * sizeof(b->entries[0]) +
+                         data_size);
+  if (b == NULL) {
+    ERROR("md_block_alloc: malloc failed.");
     return NULL;
-  copy->type = orig->type;
-  if (copy->type == MD_TYPE_STRING)
-    copy->value.mv_string = strdup(orig->value.mv_string);
-  else
-    copy->value = orig->value;
-
-  return copy;
-} /* }}} meta_entry_t *md_entry_clone_contents */
-
-static meta_entry_t *md_entry_clone(const meta_entry_t *orig) /* {{{ */
-{
-  meta_entry_t *copy;
+  }
 
-  if (orig == NULL)
-    return NULL;
+  b->refcount = 1;
+  b->entries_num = 0;
+  b->entries_size = entries_size;
+  b->data_len = 0;
+  b->data_size = data_size;
+  b->entries[0] = (meta_entry_t){0};
 
-  copy = md_entry_clone_contents(orig);
+  return b;
+} /* }}} md_block_t *md_block_alloc */
 
-  copy->next = md_entry_clone(orig->next);
-  return copy;
-} /* }}} meta_entry_t *md_entry_clone */
+static md_block_t *md_block_ref(md_block_t *b) /* {{{ */
+{
+  if (b != NULL)
+    __atomic_add_fetch(&b->refcount, 1, __ATOMIC_RELAXED);
+  return b;
+} /* }}} md_block_t *md_block_ref */
 
-static void md_entry_free(meta_entry_t *e) /* {{{ */
+static void md_block_release(md_block_t *b) /* {{{ */
 {
-  if (e == NULL)
+  if (b == NULL)
     return;
 
-  free(e->key);
-
-  if (e->type == MD_TYPE_STRING)
-    free(e->value.mv_string);
+  if (__atomic_sub_fetch(&b->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+    free(b);
+} /* }}} void md_block_release */
 
-  if (e->next != NULL)
-    md_entry_free(e->next);
-
-  free(e);
-} /* }}} void md_entry_free */
-
-static int md_entry_insert(meta_data_t *md, meta_entry_t *e) /* {{{ */
+/* Returns true if "b" is referenced by the calling meta data object only and
+ * may therefore be modified in place. */
+static bool md_block_exclusive(md_block_t *b) /* {{{ */
 {
-  meta_entry_t *this;
-  meta_entry_t *prev;
-
-  if ((md == NULL) || (e == NULL))
-    return -EINVAL;
-
-  pthread_mutex_lock(&md->lock);
+  return __atomic_load_n(&b->refcount, __ATOMIC_ACQUIRE) == 1;
+} /* }}} bool md_block_exclusive */
 
-  prev = NULL;
-  this = md->head;
-  while (this != NULL) {
-    if (strcasecmp(e->key, this->key) == 0)
-      break;
+/* The caller must make sure there is enough room in the data area. */
+static char *md_block_strdup(md_block_t *b, const char *orig) /* {{{ */
+{
+  size_t sz = strlen(orig) + 1;
+  char *dest = md_block_data(b) + b->data_len;
 
-    prev = this;
-    this = this->next;
-  }
+  memcpy(dest, orig, sz);
+  b->data_len += sz;
 
-  if (this == NULL) {
-    /* This key does not exist yet. */
-    if (md->head == NULL)
-      md->head = e;
-    else {
-      assert(prev != NULL);
-      prev->next = e;
+  return dest;
+} /* }}} char *md_block_strdup */
+
+/* Copies "orig" (which may be NULL) into a new block that has room for
+ * "extra_entries" more entries and "extra_data" more bytes of keys and
+ * strings. Space left behind by deleted or replaced entries is not copied. */
+static md_block_t *md_block_copy(md_block_t *orig, /* {{{ */
+                                 size_t extra_entries, size_t extra_data) {
+  size_t entries_size = MD_ENTRIES_INIT;
+  size_t data_size = MD_DATA_INIT;
+  size_t entries_need = extra_entries;
+  size_t data_need = extra_data;
+
+  if (orig != NULL) {
+    entries_size = orig->entries_size;
+    data_size = orig->data_size;
+    entries_need += orig->entries_num;
+    for (size_t i = 0; i < orig->entries_num; i++) {
+      meta_entry_t *e = orig->entries + i;
+      data_need += strlen(e->key) + 1;
+      if (e->type == MD_TYPE_STRING)
+        data_need += strlen(e->value.mv_string) + 1;
     }
-
-    e->next = NULL;
-  } else /* (this != NULL) */
-  {
-    if (prev == NULL)
-      md->head = e;
-    else
-      prev->next = e;
-
-    e->next = this->next;
   }
 
-  pthread_mutex_unlock(&md->lock);
+  while (entries_size < entries_need)
+    entries_size *= 2;
+  while (data_size < data_need)
+    data_size *= 2;
 
-  if (this != NULL) {
-    this->next = NULL;
-    md_entry_free(this);
-  }
+  md_block_t *b = md_block_alloc(entries_size, data_size);
+  if ((b == NULL) || (orig == NULL))
+    return b;
 
-  return 0;
-} /* }}} int md_entry_insert */
+  for (size_t i = 0; i < orig->entries_num; i++) {
+    meta_entry_t *e = b->entries + i;
 
-/* XXX: The lock on md must be held while calling this function! */
-static int md_entry_insert_clone(meta_data_t *md, meta_entry_t *orig) /* {{{ */
-{
-  meta_entry_t *e;
-  meta_entry_t *this;
-  meta_entry_t *prev;
-
-  /* WARNINGS :
-   *  - we do not check that md and e != NULL here. You should have done it
-   * before.
-   *  - we do not use the lock. You should have set it before.
-   */
-
-  e = md_entry_clone_contents(orig);
-
-  prev = NULL;
-  this = md->head;
-  while (this != NULL) {
-    if (strcasecmp(e->key, this->key) == 0)
-      break;
-
-    prev = this;
-    this = this->next;
-  }
-
-  if (this == NULL) {
-    /* This key does not exist yet. */
-    if (md->head == NULL)
-      md->head = e;
-    else {
-      assert(prev != NULL);
-      prev->next = e;
-    }
-
-    e->next = NULL;
-  } else /* (this != NULL) */
-  {
-    if (prev == NULL)
-      md->head = e;
-    else
-      prev->next = e;
-
-    e->next = this->next;
+    *e = orig->entries[i];
+    e->key = md_block_strdup(b, e->key);
+    if (e->type == MD_TYPE_STRING)
+      e->value.mv_string = md_block_strdup(b, e->value.mv_string);
   }
-
-  if (this != NULL) {
-    this->next = NULL;
-    md_entry_free(this);
+  b->entries_num = orig->entries_num;
+  b->entries[b->entries_num] = (meta_entry_t){0};
+
+  return b;
+} /* }}} md_block_t *md_block_copy */
+
+/* Returns the index of "key" in "b" or -1 if it does not exist. */
+static ssize_t md_block_lookup(md_block_t *b, const char *key, /* {{{ */
+                               uint32_t hash) {
+  if (b == NULL)
+    return -1;
+
+  for (size_t i = 0; i < b->entries_num; i++) {
+    meta_entry_t *e = b->entries + i;
+    if ((e->hash == hash) && (strcasecmp(key, e->key) == 0))
+      return (ssize_t)i;
   }
 
-  return 0;
-} /* }}} int md_entry_insert_clone */
+  return -1;
+} /* }}} ssize_t md_block_lookup */
 
-/* XXX: The lock on md must be held while calling this function! */
 static meta_entry_t *md_entry_lookup(meta_data_t *md, /* {{{ */
                                      const char *key) {
-  meta_entry_t *e;
-
   if ((md == NULL) || (key == NULL))
     return NULL;
 
-  for (e = md->head; e != NULL; e = e->next)
-    if (strcasecmp(key, e->key) == 0)
-      break;
+  ssize_t i = md_block_lookup(md->block, key, md_hash(key));
+  if (i < 0)
+    return NULL;
 
-  return e;
+  return md->block->entries + i;
 } /* }}} meta_entry_t *md_entry_lookup */
 
+/* Sets "key" to "value", replacing any existing entry with the same key. If
+ * "type" is MD_TYPE_STRING, the string is copied into the block. The block is
+ * copied first if it is shared with a clone or too small. */
+static int md_entry_set(meta_data_t *md, const char *key, /* {{{ */
+                        int type, meta_value_t value) {
+  md_block_t *old = md->block;
+  md_block_t *b = old;
+  uint32_t hash = md_hash(key);
+  ssize_t i = md_block_lookup(b, key, hash);
+
+  size_t extra_entries = (i < 0) ? 1 : 0;
+  size_t extra_data = (i < 0) ? strlen(key) + 1 : 0;
+  if (type == MD_TYPE_STRING)
+    extra_data += strlen(value.mv_string) + 1;
+
+  if ((b == NULL) || !md_block_exclusive(b) ||
+      (b->entries_num + extra_entries > b->entries_size) ||
+      (b->data_len + extra_data > b->data_size)) {
+    b = md_block_copy(old, extra_entries, extra_data);
+    if (b == NULL)
+      return -ENOMEM;
+  }
+
+  /* "key" and "value" may point into the old block, so it is released only
+   * after they have been copied. */
+  meta_entry_t *e;
+  if (i < 0) {
+    e = b->entries + b->entries_num;
+    e->key = md_block_strdup(b, key);
+    e->hash = hash;
+    b->entries_num++;
+    b->entries[b->entries_num] = (meta_entry_t){0};
+  } else {
+    e = b->entries + i;
+  }
+
+  e->type = type;
+  if (type == MD_TYPE_STRING)
+    e->value.mv_string = md_block_strdup(b, value.mv_string);
+  else
+    e->value = value;
+
+  md->block = b;
+  if (b != old)
+    md_block_release(old);
+
+  return 0;
+} /* }}} int md_entry_set */
+
 /*
  * Each value_list_t*, as it is going through the system, is handled by exactly
  * one thread. Plugins which pass a value_list_t* to another thread, e.g. the
  * rrdtool plugin, must create a copy first. The meta data within a
- * value_list_t* is not thread safe and doesn't need to be.
+ * value_list_t* is not thread safe and doesn't need to be. Clones share their
+ * data, but since shared data is never modified, different threads may use
+ * different clones at the same time.
  *
  * The meta data associated with cache entries are a different story. There, we
  * need to ensure exclusive locking to prevent leaks and other funky business.
@@ -294,8 +322,6 @@ meta_data_t *meta_data_create(void) /* {{{ */
     return NULL;
   }
 
-  pthread_mutex_init(&md->lock, /* attr = */ NULL);
-
   return md;
 } /* }}} meta_data_t *meta_data_create */
 
@@ -310,9 +336,7 @@ meta_data_t *meta_data_clone(meta_data_t *orig) /* {{{ */
   if (copy == NULL)
     return NULL;
 
-  pthread_mutex_lock(&orig->lock);
-  copy->head = md_entry_clone(orig->head);
-  pthread_mutex_unlock(&orig->lock);
+  copy->block = md_block_ref(orig->block);
 
   return copy;
 } /* }}} meta_data_t *meta_data_clone */
@@ -327,13 +351,20 @@ int meta_data_clone_merge(meta_data_t **dest, meta_data_t *orig) /* {{{ */
     return 0;
   }
 
-  pthread_mutex_lock(&orig->lock);
-  for (meta_entry_t *e = orig->head; e != NULL; e = e->next) {
-    md_entry_insert_clone((*dest), e);
+  /* Holding a reference makes sure the entries stay valid, even if "dest" and
+   * "orig" are the same object. */
+  md_block_t *b = md_block_ref(orig->block);
+  if (b == NULL)
+    return 0;
+
+  int status = 0;
+  for (size_t i = 0; (i < b->entries_num) && (status == 0); i++) {
+    meta_entry_t *e = b->entries + i;
+    status = md_entry_set(*dest, e->key, e->type, e->value);
   }
-  pthread_mutex_unlock(&orig->lock);
 
-  return 0;
+  md_block_release(b);
+  return status;
 } /* }}} int meta_data_clone_merge */
 
 void meta_data_destroy(meta_data_t *md) /* {{{ */
@@ -341,8 +372,7 @@ void meta_data_destroy(meta_data_t *md) /* {{{ */
   if (md == NULL)
     return;
 
-  md_entry_free(md->head);
-  pthread_mutex_destroy(&md->lock);
+  md_block_release(md->block);
   free(md);
 } /* }}} void meta_data_destroy */
 
@@ -351,17 +381,7 @@ int meta_data_exists(meta_data_t *md, const char *key) /* {{{ */
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next) {
-    if (strcasecmp(key, e->key) == 0) {
-      pthread_mutex_unlock(&md->lock);
-      return 1;
-    }
-  }
-
-  pthread_mutex_unlock(&md->lock);
-  return 0;
+  return (md_entry_lookup(md, key) != NULL) ? 1 : 0;
 } /* }}} int meta_data_exists */
 
 int meta_data_type(meta_data_t *md, const char *key) /* {{{ */
@@ -369,78 +389,55 @@ int meta_data_type(meta_data_t *md, const char *key) /* {{{ */
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next) {
-    if (strcasecmp(key, e->key) == 0) {
-      pthread_mutex_unlock(&md->lock);
-      return e->type;
-    }
-  }
+  meta_entry_t *e = md_entry_lookup(md, key);
+  if (e == NULL)
+    return 0;
 
-  pthread_mutex_unlock(&md->lock);
-  return 0;
+  return e->type;
 } /* }}} int meta_data_type */
 
 int meta_data_toc(meta_data_t *md, char ***toc) /* {{{ */
 {
-  int i = 0, count = 0;
-
   if ((md == NULL) || (toc == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next)
-    ++count;
+  md_block_t *b = md->block;
+  if ((b == NULL) || (b->entries_num == 0))
+    return 0;
 
-  if (count == 0) {
-    pthread_mutex_unlock(&md->lock);
-    return count;
-  }
+  *toc = calloc(b->entries_num, sizeof(**toc));
+  if (*toc == NULL)
+    return -ENOMEM;
 
-  *toc = calloc(count, sizeof(**toc));
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next)
-    (*toc)[i++] = strdup(e->key);
+  for (size_t i = 0; i < b->entries_num; i++)
+    (*toc)[i] = strdup(b->entries[i].key);
 
-  pthread_mutex_unlock(&md->lock);
-  return count;
+  return (int)b->entries_num;
 } /* }}} int meta_data_toc */
 
 int meta_data_delete(meta_data_t *md, const char *key) /* {{{ */
 {
-  meta_entry_t *this;
-  meta_entry_t *prev;
-
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
-  prev = NULL;
-  this = md->head;
-  while (this != NULL) {
-    if (strcasecmp(key, this->key) == 0)
-      break;
-
-    prev = this;
-    this = this->next;
-  }
-
-  if (this == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  ssize_t i = md_block_lookup(md->block, key, md_hash(key));
+  if (i < 0)
     return -ENOENT;
-  }
-
-  if (prev == NULL)
-    md->head = this->next;
-  else
-    prev->next = this->next;
 
-  pthread_mutex_unlock(&md->lock);
+  if (!md_block_exclusive(md->block)) {
+    md_block_t *b = md_block_copy(md->block, 0, 0);
+    if (b == NULL)
+      return -ENOMEM;
+    md_block_release(md->block);
+    md->block = b;
+  }
 
-  this->next = NULL;
-  md_entry_free(this);
+  /* Also moves the terminating entry. The key and string of the deleted entry
+   * are left in the data area until the block is copied. */
+  md_block_t *b = md->block;
+  memmove(b->entries + i, b->entries + i + 1,
+          (b->entries_num - (size_t)i) * sizeof(b->entries[0]));
+  b->entries_num--;
 
   return 0;
 } /* }}} int meta_data_delete */
@@ -450,98 +447,54 @@ int meta_data_delete(meta_data_t *md, const char *key) /* {{{ */
  */
 int meta_data_add_string(meta_data_t *md, /* {{{ */
                          const char *key, const char *value) {
-  meta_entry_t *e;
-
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
-    return -ENOMEM;
-
-  e->value.mv_string = md_strdup(value);
-  if (e->value.mv_string == NULL) {
-    ERROR("meta_data_add_string: md_strdup failed.");
-    md_entry_free(e);
-    return -ENOMEM;
-  }
-  e->type = MD_TYPE_STRING;
-
-  return md_entry_insert(md, e);
+  return md_entry_set(md, key, MD_TYPE_STRING,
+                      (meta_value_t){.mv_string = (char *)value});
 } /* }}} int meta_data_add_string */
 
 int meta_data_add_signed_int(meta_data_t *md, /* {{{ */
                              const char *key, int64_t value) {
-  meta_entry_t *e;
-
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
-    return -ENOMEM;
-
-  e->value.mv_signed_int = value;
-  e->type = MD_TYPE_SIGNED_INT;
-
-  return md_entry_insert(md, e);
+  return md_entry_set(md, key, MD_TYPE_SIGNED_INT,
+                      (meta_value_t){.mv_signed_int = value});
 } /* }}} int meta_data_add_signed_int */
 
 int meta_data_add_unsigned_int(meta_data_t *md, /* {{{ */
                                const char *key, uint64_t value) {
-  meta_entry_t *e;
-
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
-    return -ENOMEM;
-
-  e->value.mv_unsigned_int = value;
-  e->type = MD_TYPE_UNSIGNED_INT;
-
-  return md_entry_insert(md, e);
+  return md_entry_set(md, key, MD_TYPE_UNSIGNED_INT,
+                      (meta_value_t){.mv_unsigned_int = value});
 } /* }}} int meta_data_add_unsigned_int */
 
 int meta_data_add_double(meta_data_t *md, /* {{{ */
                          const char *key, double value) {
-  meta_entry_t *e;
-
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
-    return -ENOMEM;
-
-  e->value.mv_double = value;
-  e->type = MD_TYPE_DOUBLE;
-
-  return md_entry_insert(md, e);
+  return md_entry_set(md, key, MD_TYPE_DOUBLE,
+                      (meta_value_t){.mv_double = value});
 } /* }}} int meta_data_add_double */
 
 int meta_data_add_boolean(meta_data_t *md, /* {{{ */
                           const char *key, bool value) {
-  meta_entry_t *e;
-
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
-    return -ENOMEM;
-
-  e->value.mv_boolean = value;
-  e->type = MD_TYPE_BOOLEAN;
-
-  return md_entry_insert(md, e);
+  return md_entry_set(md, key, MD_TYPE_BOOLEAN,
+                      (meta_value_t){.mv_boolean = value});
 } /* }}} int meta_data_add_boolean */
 
 /*
  * Get functions
  */
-int _meta_data_get_string(meta_data_t *md, meta_entry_t *e, char **value) {
+static int md_entry_get_string(meta_entry_t *e, char **value) /* {{{ */
+{
   char *temp;
 
   if (e->type != MD_TYPE_STRING) {
@@ -558,28 +511,20 @@ int _meta_data_get_string(meta_data_t *md, meta_entry_t *e, char **value) {
   *value = temp;
 
   return 0;
-}
+} /* }}} int md_entry_get_string */
 
 int meta_data_get_string(meta_data_t *md, /* {{{ */
                          const char *key, char **value) {
   meta_entry_t *e;
-  int res = 0;
 
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
-
-  res = _meta_data_get_string(md, e, value);
 
-  pthread_mutex_unlock(&md->lock);
-  return res;
+  return md_entry_get_string(e, value);
 } /* }}} int meta_data_get_string */
 
 int meta_data_get_signed_int(meta_data_t *md, /* {{{ */
@@ -589,23 +534,16 @@ int meta_data_get_signed_int(meta_data_t *md, /* {{{ */
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
 
   if (e->type != MD_TYPE_SIGNED_INT) {
     ERROR("meta_data_get_signed_int: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock(&md->lock);
     return -ENOENT;
   }
 
   *value = e->value.mv_signed_int;
-
-  pthread_mutex_unlock(&md->lock);
   return 0;
 } /* }}} int meta_data_get_signed_int */
 
@@ -616,23 +554,16 @@ int meta_data_get_unsigned_int(meta_data_t *md, /* {{{ */
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
 
   if (e->type != MD_TYPE_UNSIGNED_INT) {
     ERROR("meta_data_get_unsigned_int: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock(&md->lock);
     return -ENOENT;
   }
 
   *value = e->value.mv_unsigned_int;
-
-  pthread_mutex_unlock(&md->lock);
   return 0;
 } /* }}} int meta_data_get_unsigned_int */
 
@@ -643,23 +574,16 @@ int meta_data_get_double(meta_data_t *md, /* {{{ */
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
 
   if (e->type != MD_TYPE_DOUBLE) {
     ERROR("meta_data_get_double: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock(&md->lock);
     return -ENOENT;
   }
 
   *value = e->value.mv_double;
-
-  pthread_mutex_unlock(&md->lock);
   return 0;
 } /* }}} int meta_data_get_double */
 
@@ -670,23 +594,16 @@ int meta_data_get_boolean(meta_data_t *md, /* {{{ */
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
 
   if (e->type != MD_TYPE_BOOLEAN) {
     ERROR("meta_data_get_boolean: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock(&md->lock);
     return -ENOENT;
   }
 
   *value = e->value.mv_boolean;
-
-  pthread_mutex_unlock(&md->lock);
   return 0;
 } /* }}} int meta_data_get_boolean */
 
@@ -701,13 +618,9 @@ int meta_data_as_string(meta_data_t *md, /* {{{ */
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
 
   type = e->type;
 
@@ -731,13 +644,10 @@ int meta_data_as_string(meta_data_t *md, /* {{{ */
     actual = e->value.mv_boolean ? "true" : "false";
     break;
   default:
-    pthread_mutex_unlock(&md->lock);
     ERROR("meta_data_as_string: unknown type %d for key `%s'", type, key);
     return -ENOENT;
   }
 
-  pthread_mutex_unlock(&md->lock);
-
   temp = md_strdup(actual);
   if (temp == NULL) {
     ERROR("meta_data_as_string: md_strdup failed for key `%s'.", key);
@@ -749,9 +659,17 @@ int meta_data_as_string(meta_data_t *md, /* {{{ */
   return 0;
 } /* }}} int meta_data_as_string */
 
-meta_entry_t *meta_data_iter(meta_data_t *md) { return md->head; }
+meta_entry_t *meta_data_iter(meta_data_t *md) {
+  if ((md == NULL) || (md->block == NULL) || (md->block->entries_num == 0))
+    return NULL;
+  return md->block->entries;
+}
 
-meta_entry_t *meta_data_iter_next(meta_entry_t *iter) { return iter->next; }
+/* The entries array is terminated by an entry with a type of zero. */
+meta_entry_t *meta_data_iter_next(meta_entry_t *iter) {
+  iter++;
+  return (iter->type != 0) ? iter : NULL;
+}
 
 int meta_data_iter_type(meta_entry_t *iter) { return iter->type; }
 
@@ -759,15 +677,8 @@ const char *meta_data_iter_key(meta_entry_t *iter) { return iter->key; }
 
 int meta_data_iter_get_string(meta_data_t *md, meta_entry_t *iter,
                               char **value) {
-  int res = 0;
-
   if ((md == NULL) || (iter == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
-  res = _meta_data_get_string(md, iter, value);
-
-  pthread_mutex_unlock(&md->lock);
-  return res;
+  return md_entry_get_string(iter, value);
 }
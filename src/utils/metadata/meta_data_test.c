@@ -110,8 +110,105 @@ DEF_TEST(base) {
   return 0;
 }
 
+DEF_TEST(clone) {
+  meta_data_t *orig;
+  meta_data_t *copy;
+  char *s;
+  int64_t si;
+
+  CHECK_NOT_NULL(orig = meta_data_create());
+  CHECK_ZERO(meta_data_add_string(orig, "string", "foobar"));
+  CHECK_ZERO(meta_data_add_signed_int(orig, "signed_int", -1));
+
+  CHECK_NOT_NULL(copy = meta_data_clone(orig));
+
+  /* modifying the clone must not change the original and vice versa */
+  CHECK_ZERO(meta_data_add_string(copy, "string", "barqux"));
+  CHECK_ZERO(meta_data_delete(orig, "signed_int"));
+  CHECK_ZERO(meta_data_add_boolean(orig, "boolean", true));
+
+  CHECK_ZERO(meta_data_get_string(orig, "string", &s));
+  EXPECT_EQ_STR("foobar", s);
+  sfree(s);
+  CHECK_ZERO(meta_data_get_string(copy, "string", &s));
+  EXPECT_EQ_STR("barqux", s);
+  sfree(s);
+
+  EXPECT_EQ_INT(0, meta_data_exists(orig, "signed_int"));
+  CHECK_ZERO(meta_data_get_signed_int(copy, "signed_int", &si));
+  EXPECT_EQ_INT(-1, (int)si);
+  EXPECT_EQ_INT(0, meta_data_exists(copy, "boolean"));
+
+  /* keys are case insensitive */
+  OK(meta_data_exists(copy, "STRING"));
+
+  /* merging replaces existing keys and keeps the order of the destination */
+  CHECK_ZERO(meta_data_clone_merge(&copy, orig));
+  char const *want_keys[] = {"string", "signed_int", "boolean"};
+  size_t i = 0;
+  for (meta_entry_t *e = meta_data_iter(copy); e != NULL;
+       e = meta_data_iter_next(e)) {
+    OK(i < STATIC_ARRAY_SIZE(want_keys));
+    EXPECT_EQ_STR(want_keys[i], meta_data_iter_key(e));
+    i++;
+  }
+  EXPECT_EQ_INT(3, (int)i);
+  CHECK_ZERO(meta_data_get_string(copy, "string", &s));
+  EXPECT_EQ_STR("foobar", s);
+  sfree(s);
+
+  meta_data_destroy(orig);
+  meta_data_destroy(copy);
+  return 0;
+}
+
+DEF_TEST(grow) {
+  meta_data_t *m;
+  char key[32];
+  char value[64];
+  char **toc = NULL;
+
+  CHECK_NOT_NULL(m = meta_data_create());
+
+  for (int i = 0; i < 100; i++) {
+    snprintf(key, sizeof(key), "key%d", i);
+    snprintf(value, sizeof(value), "value%d", i);
+    CHECK_ZERO(meta_data_add_string(m, key, value));
+  }
+
+  /* replacing strings over and over must not grow without bound */
+  for (int i = 0; i < 1000; i++) {
+    snprintf(value, sizeof(value), "replaced%d", i);
+    CHECK_ZERO(meta_data_add_string(m, "key42", value));
+  }
+
+  for (int i = 0; i < 100; i += 2) {
+    snprintf(key, sizeof(key), "key%d", i);
+    CHECK_ZERO(meta_data_delete(m, key));
+  }
+
+  EXPECT_EQ_INT(50, meta_data_toc(m, &toc));
+  for (int i = 0; i < 50; i++) {
+    char *s;
+
+    snprintf(key, sizeof(key), "key%d", 2 * i + 1);
+    EXPECT_EQ_STR(key, toc[i]);
+    CHECK_ZERO(meta_data_as_string(m, key, &s));
+    snprintf(value, sizeof(value), "value%d", 2 * i + 1);
+    EXPECT_EQ_STR(value, s);
+    sfree(s);
+    sfree(toc[i]);
+  }
+  sfree(toc);
+
+  meta_data_destroy(m);
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(base);
+  RUN_TEST(clone);
+  RUN_TEST(grow);
 
   END_TEST;
 }
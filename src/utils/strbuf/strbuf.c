@@ -0,0 +1,253 @@
+/**
+ * collectd - src/utils/strbuf/strbuf.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include "collectd.h"
+
+#include "utils/strbuf/strbuf.h"
+
+#include <math.h>
+
+#ifndef STRBUF_MIN_SIZE
+#define STRBUF_MIN_SIZE 256
+#endif
+
+/* Largest double for which all integral values are exactly representable and
+ * "%.15g" does not switch to exponential notation. */
+#define STRBUF_GAUGE_INT_MAX 1e15
+
+/* Largest double that can be converted to int64_t without overflow. */
+#define STRBUF_FIXED_INT_MAX 9.2e18
+
+static char const digit_pairs[201] = "00010203040506070809"
+                                     "10111213141516171819"
+                                     "20212223242526272829"
+                                     "30313233343536373839"
+                                     "40414243444546474849"
+                                     "50515253545556575859"
+                                     "60616263646566676869"
+                                     "70717273747576777879"
+                                     "80818283848586878889"
+                                     "90919293949596979899";
+
+strbuf_t *strbuf_create(void) {
+  strbuf_t *buf = calloc(1, sizeof(*buf));
+  if (buf == NULL)
+    return NULL;
+
+  return buf;
+}
+
+void strbuf_destroy(strbuf_t *buf) {
+  if (buf == NULL)
+    return;
+
+  STRBUF_DESTROY(buf);
+  free(buf);
+}
+
+void strbuf_reset(strbuf_t *buf) { strbuf_truncate(buf, 0); }
+
+void strbuf_truncate(strbuf_t *buf, size_t pos) {
+  if ((buf == NULL) || (pos >= buf->pos))
+    return;
+
+  buf->pos = pos;
+  buf->ptr[pos] = 0;
+}
+
+int strbuf_resize(strbuf_t *buf, size_t need) {
+  if (buf == NULL)
+    return EINVAL;
+
+  /* +1 for the terminating null byte. */
+  if ((buf->pos + need + 1) <= buf->size)
+    return 0;
+
+  if (buf->fixed)
+    return ENOSPC;
+
+  size_t new_size = (buf->size < STRBUF_MIN_SIZE) ? STRBUF_MIN_SIZE : buf->size;
+  while (new_size < (buf->pos + need + 1))
+    new_size *= 2;
+
+  char *new_ptr = realloc(buf->ptr, new_size);
+  if (new_ptr == NULL)
+    return ENOMEM;
+
+  if (buf->ptr == NULL)
+    new_ptr[0] = 0;
+
+  buf->ptr = new_ptr;
+  buf->size = new_size;
+  return 0;
+}
+
+int strbuf_printn(strbuf_t *buf, char const *s, size_t n) {
+  int status = strbuf_resize(buf, n);
+  if (status != 0)
+    return status;
+
+  memcpy(buf->ptr + buf->pos, s, n);
+  buf->pos += n;
+  buf->ptr[buf->pos] = 0;
+  return 0;
+}
+
+int strbuf_print(strbuf_t *buf, char const *s) {
+  if (s == NULL)
+    return EINVAL;
+
+  return strbuf_printn(buf, s, strlen(s));
+}
+
+static int strbuf_vprintf(strbuf_t *buf, char const *format, va_list ap) {
+  va_list ap_copy;
+
+  /* Try with the available space first; only fall back to a second pass
+   * if the output did not fit. */
+  size_t avail = (buf->size > buf->pos) ? buf->size - buf->pos : 0;
+  char dummy[1];
+  char *dst = (avail > 0) ? buf->ptr + buf->pos : dummy;
+  if (avail == 0)
+    avail = sizeof(dummy);
+
+  va_copy(ap_copy, ap);
+  int status = vsnprintf(dst, avail, format, ap_copy);
+  va_end(ap_copy);
+  if (status < 0)
+    return errno ? errno : EINVAL;
+
+  size_t len = (size_t)status;
+  if (len < avail) {
+    if (dst != dummy)
+      buf->pos += len;
+    return 0;
+  }
+
+  /* Restore the null termination overwritten by the truncated output. */
+  if (buf->ptr != NULL)
+    buf->ptr[buf->pos] = 0;
+
+  status = strbuf_resize(buf, len);
+  if (status != 0)
+    return status;
+
+  va_copy(ap_copy, ap);
+  vsnprintf(buf->ptr + buf->pos, buf->size - buf->pos, format, ap_copy);
+  va_end(ap_copy);
+
+  buf->pos += len;
+  return 0;
+}
+
+int strbuf_printf(strbuf_t *buf, char const *format, ...) {
+  va_list ap;
+
+  if ((buf == NULL) || (format == NULL))
+    return EINVAL;
+
+  va_start(ap, format);
+  int status = strbuf_vprintf(buf, format, ap);
+  va_end(ap);
+
+  return status;
+}
+
+/* uint64_to_string writes the decimal representation of "v" to the end of
+ * "buffer" and returns a pointer to the first digit. */
+static char *uint64_to_string(char buffer[static 20], uint64_t v) {
+  char *ptr = buffer + 20;
+
+  while (v >= 100) {
+    uint64_t idx = 2 * (v % 100);
+    v /= 100;
+    ptr -= 2;
+    memcpy(ptr, digit_pairs + idx, 2);
+  }
+
+  if (v >= 10) {
+    ptr -= 2;
+    memcpy(ptr, digit_pairs + 2 * v, 2);
+  } else {
+    ptr--;
+    *ptr = (char)('0' + v);
+  }
+
+  return ptr;
+}
+
+int strbuf_print_uint64(strbuf_t *buf, uint64_t v) {
+  char tmp[20];
+  char *ptr = uint64_to_string(tmp, v);
+
+  return strbuf_printn(buf, ptr, (size_t)(tmp + sizeof(tmp) - ptr));
+}
+
+int strbuf_print_int64(strbuf_t *buf, int64_t v) {
+  char tmp[21];
+  bool negative = (v < 0);
+  /* Negate in the unsigned domain so INT64_MIN does not overflow. */
+  uint64_t abs = negative ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+
+  char *ptr = uint64_to_string(tmp + 1, abs);
+  if (negative) {
+    ptr--;
+    *ptr = '-';
+  }
+
+  return strbuf_printn(buf, ptr, (size_t)(tmp + sizeof(tmp) - ptr));
+}
+
+int strbuf_print_gauge(strbuf_t *buf, double v) {
+#if GAUGE_FORMAT_DEFAULT
+  /* "%.15g" prints integral values below 1e15 without exponent, decimal
+   * point or trailing zeros, i.e. exactly like "%" PRIi64. Negative zero is
+   * printed as "-0", so leave that one to snprintf(). */
+  if ((v > -STRBUF_GAUGE_INT_MAX) && (v < STRBUF_GAUGE_INT_MAX) &&
+      (v == (double)(int64_t)v) && !((v == 0.0) && signbit(v)))
+    return strbuf_print_int64(buf, (int64_t)v);
+#endif
+
+  return strbuf_printf(buf, GAUGE_FORMAT, v);
+}
+
+int strbuf_print_fixed(strbuf_t *buf, double v, int precision) {
+  if ((precision < 0) || (precision > 20) || !isfinite(v) ||
+      (v <= -STRBUF_FIXED_INT_MAX) || (v >= STRBUF_FIXED_INT_MAX) ||
+      (v != (double)(int64_t)v) || ((v == 0.0) && signbit(v)))
+    return strbuf_printf(buf, "%.*f", precision, v);
+
+  size_t orig_pos = (buf != NULL) ? buf->pos : 0;
+  int status = strbuf_print_int64(buf, (int64_t)v);
+  if ((status != 0) || (precision == 0))
+    return status;
+
+  char zeros[22] = ".00000000000000000000";
+  status = strbuf_printn(buf, zeros, (size_t)precision + 1);
+  if (status != 0)
+    strbuf_truncate(buf, orig_pos);
+  return status;
+}
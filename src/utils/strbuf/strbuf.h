@@ -0,0 +1,110 @@
+/**
+ * collectd - src/utils/strbuf/strbuf.h
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#ifndef UTILS_STRBUF_H
+#define UTILS_STRBUF_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* strbuf_t is a string buffer that formatters append to. A buffer is either
+ * "growable", i.e. memory is allocated (and re-allocated) as needed, or
+ * "fixed", i.e. it wraps memory provided by the caller and appending fails
+ * with ENOSPC once that memory is exhausted. The content is always null
+ * terminated. */
+typedef struct {
+  char *ptr;
+  size_t pos;
+  size_t size;
+  bool fixed;
+} strbuf_t;
+
+/* STRBUF_CREATE allocates a growable buffer on the stack. The memory it
+ * points to must be freed with STRBUF_DESTROY. */
+#define STRBUF_CREATE (&(strbuf_t){.ptr = NULL})
+
+/* STRBUF_CREATE_FIXED wraps the caller provided buffer "b" of size "sz". */
+#define STRBUF_CREATE_FIXED(b, sz)                                             \
+  (&(strbuf_t){.ptr = (b), .size = (sz), .fixed = true})
+
+/* STRBUF_CREATE_STATIC wraps the char array "b". */
+#define STRBUF_CREATE_STATIC(b) STRBUF_CREATE_FIXED(b, sizeof(b))
+
+/* STRBUF_DESTROY frees the memory of a buffer created with STRBUF_CREATE. */
+#define STRBUF_DESTROY(buf)                                                    \
+  do {                                                                         \
+    if ((buf) != NULL && !(buf)->fixed) {                                      \
+      free((buf)->ptr);                                                        \
+      *(buf) = (strbuf_t){.ptr = NULL};                                        \
+    }                                                                          \
+  } while (0)
+
+/* strbuf_create allocates a new growable buffer on the heap. */
+strbuf_t *strbuf_create(void);
+
+/* strbuf_destroy frees a buffer allocated with strbuf_create. */
+void strbuf_destroy(strbuf_t *buf);
+
+/* strbuf_reset empties the buffer. Allocated memory is kept for reuse. */
+void strbuf_reset(strbuf_t *buf);
+
+/* strbuf_truncate shrinks the content to "pos" bytes. Used to roll back a
+ * partially formatted entry. */
+void strbuf_truncate(strbuf_t *buf, size_t pos);
+
+/* strbuf_resize makes sure that at least "need" bytes (excluding the
+ * terminating null byte) can be appended without further allocations.
+ * Returns ENOSPC for fixed buffers that are too small. */
+int strbuf_resize(strbuf_t *buf, size_t need);
+
+/* strbuf_print appends the string "s" to the buffer. */
+int strbuf_print(strbuf_t *buf, char const *s);
+
+/* strbuf_printn appends the first "n" bytes of "s" to the buffer. */
+int strbuf_printn(strbuf_t *buf, char const *s, size_t n);
+
+/* strbuf_printf appends a formatted string to the buffer. */
+int strbuf_printf(strbuf_t *buf, char const *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* strbuf_print_uint64 and strbuf_print_int64 append the decimal
+ * representation of an integer, i.e. the same as "%" PRIu64 and "%" PRIi64,
+ * without going through the printf machinery. */
+int strbuf_print_uint64(strbuf_t *buf, uint64_t v);
+int strbuf_print_int64(strbuf_t *buf, int64_t v);
+
+/* strbuf_print_gauge appends "v" formatted with GAUGE_FORMAT ("%.15g").
+ * Unless GAUGE_FORMAT has been overridden at compile time, integral values,
+ * which make up the bulk of the collected data, are converted without calling
+ * snprintf(). */
+int strbuf_print_gauge(strbuf_t *buf, double v);
+
+/* strbuf_print_fixed appends "v" formatted with "%.*f" using "precision"
+ * decimal digits. Integral values are converted without calling snprintf(). */
+int strbuf_print_fixed(strbuf_t *buf, double v, int precision);
+
+#endif /* UTILS_STRBUF_H */
@@ -0,0 +1,129 @@
+/**
+ * collectd - src/utils/strbuf/strbuf_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils/strbuf/strbuf.h"
+
+DEF_TEST(growable) {
+  strbuf_t *buf = STRBUF_CREATE;
+
+  CHECK_ZERO(strbuf_print(buf, "foo"));
+  CHECK_ZERO(strbuf_printf(buf, "%s=%d", "bar", 42));
+  CHECK_ZERO(strbuf_printn(buf, "qux", 2));
+  EXPECT_EQ_STR("foobar=42qu", buf->ptr);
+
+  /* force at least one re-allocation */
+  char big[1000];
+  memset(big, 'x', sizeof(big) - 1);
+  big[sizeof(big) - 1] = 0;
+  CHECK_ZERO(strbuf_printf(buf, "[%s]", big));
+  EXPECT_EQ_INT(11 + 2 + sizeof(big) - 1, buf->pos);
+  EXPECT_EQ_INT(strlen(buf->ptr), buf->pos);
+
+  strbuf_truncate(buf, 3);
+  EXPECT_EQ_STR("foo", buf->ptr);
+
+  strbuf_reset(buf);
+  EXPECT_EQ_STR("", buf->ptr);
+
+  STRBUF_DESTROY(buf);
+  return 0;
+}
+
+DEF_TEST(fixed) {
+  char buffer[8];
+  strbuf_t *buf = STRBUF_CREATE_STATIC(buffer);
+
+  CHECK_ZERO(strbuf_print(buf, "1234"));
+  EXPECT_EQ_INT(ENOSPC, strbuf_print(buf, "5678"));
+  EXPECT_EQ_STR("1234", buffer);
+  EXPECT_EQ_INT(ENOSPC, strbuf_printf(buf, "%d", 5678));
+  EXPECT_EQ_STR("1234", buffer);
+  CHECK_ZERO(strbuf_printf(buf, "%d", 567));
+  EXPECT_EQ_STR("1234567", buffer);
+  EXPECT_EQ_INT(ENOSPC, strbuf_print_uint64(buf, 8));
+
+  return 0;
+}
+
+DEF_TEST(numbers) {
+  double gauges[] = {
+      0,         -0.0,     1,        -1,   42,     0.5,
+      -1.25,     1e14,     1e15 - 1, 1e15, 1e300,  -123456789,
+      1e-300,    NAN,      INFINITY, -INFINITY,    3.141592653589793,
+      4294967296.0,
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(gauges); i++) {
+    /* "%f" of 1e300 needs more than 300 characters. */
+    char want[512];
+    snprintf(want, sizeof(want), GAUGE_FORMAT, gauges[i]);
+
+    strbuf_t *buf = STRBUF_CREATE;
+    CHECK_ZERO(strbuf_print_gauge(buf, gauges[i]));
+    EXPECT_EQ_STR(want, buf->ptr);
+    strbuf_reset(buf);
+
+    snprintf(want, sizeof(want), "%f", gauges[i]);
+    CHECK_ZERO(strbuf_print_fixed(buf, gauges[i], 6));
+    EXPECT_EQ_STR(want, buf->ptr);
+    strbuf_reset(buf);
+
+    snprintf(want, sizeof(want), "%.0f", gauges[i]);
+    CHECK_ZERO(strbuf_print_fixed(buf, gauges[i], 0));
+    EXPECT_EQ_STR(want, buf->ptr);
+    STRBUF_DESTROY(buf);
+  }
+
+  int64_t ints[] = {0, 1, -1, 9, 10, 99, 100, -100, INT64_MAX, INT64_MIN};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(ints); i++) {
+    char want[32];
+    snprintf(want, sizeof(want), "%" PRIi64, ints[i]);
+
+    strbuf_t *buf = STRBUF_CREATE;
+    CHECK_ZERO(strbuf_print_int64(buf, ints[i]));
+    EXPECT_EQ_STR(want, buf->ptr);
+    strbuf_reset(buf);
+
+    snprintf(want, sizeof(want), "%" PRIu64, (uint64_t)ints[i]);
+    CHECK_ZERO(strbuf_print_uint64(buf, (uint64_t)ints[i]));
+    EXPECT_EQ_STR(want, buf->ptr);
+    STRBUF_DESTROY(buf);
+  }
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(growable);
+  RUN_TEST(fixed);
+  RUN_TEST(numbers);
+
+  END_TEST;
+}
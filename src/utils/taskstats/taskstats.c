@@ -285,7 +285,7 @@ ts_t *ts_create(void) {
   return ts;
 }
 
-int ts_delay_by_tgid(ts_t *ts, uint32_t tgid, ts_delay_t *out) {
+int ts_stats_by_tgid(ts_t *ts, uint32_t tgid, ts_stats_t *out) {
   if ((ts == NULL) || (out == NULL)) {
     return EINVAL;
   }
@@ -297,11 +297,32 @@ int ts_delay_by_tgid(ts_t *ts, uint32_t tgid, ts_delay_t *out) {
     return status;
   }
 
-  *out = (ts_delay_t){
-      .cpu_ns = raw.cpu_delay_total,
-      .blkio_ns = raw.blkio_delay_total,
-      .swapin_ns = raw.swapin_delay_total,
-      .freepages_ns = raw.freepages_delay_total,
+  *out = (ts_stats_t){
+      .delay =
+          {
+              .cpu_ns = raw.cpu_delay_total,
+              .blkio_ns = raw.blkio_delay_total,
+              .swapin_ns = raw.swapin_delay_total,
+              .freepages_ns = raw.freepages_delay_total,
+          },
+      .cswitch_vol = raw.nvcsw,
+      .cswitch_invol = raw.nivcsw,
   };
   return 0;
 }
+
+int ts_delay_by_tgid(ts_t *ts, uint32_t tgid, ts_delay_t *out) {
+  if (out == NULL) {
+    return EINVAL;
+  }
+
+  ts_stats_t stats = {0};
+
+  int status = ts_stats_by_tgid(ts, tgid, &stats);
+  if (status != 0) {
+    return status;
+  }
+
+  *out = stats.delay;
+  return 0;
+}
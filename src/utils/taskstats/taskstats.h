@@ -37,6 +37,12 @@ typedef struct {
   uint64_t freepages_ns;
 } ts_delay_t;
 
+typedef struct {
+  ts_delay_t delay;
+  uint64_t cswitch_vol;
+  uint64_t cswitch_invol;
+} ts_stats_t;
+
 ts_t *ts_create(void);
 void ts_destroy(ts_t *);
 
@@ -44,4 +50,10 @@ void ts_destroy(ts_t *);
  * identified by tgid. Returns zero on success and an errno otherwise. */
 int ts_delay_by_tgid(ts_t *ts, uint32_t tgid, ts_delay_t *out);
 
+/* ts_stats_by_tgid returns the delay accounting information and the number of
+ * voluntary and involuntary context switches, summed up over all threads of
+ * the task identified by tgid. Returns zero on success and an errno
+ * otherwise. */
+int ts_stats_by_tgid(ts_t *ts, uint32_t tgid, ts_stats_t *out);
+
 #endif /* UTILS_TASKSTATS_H */
@@ -106,6 +106,9 @@ struct wg_callback {
   size_t send_buf_fill;
   cdtime_t send_buf_init_time;
 
+  /* Escaped metric names, protected by send_lock. */
+  format_cache_t *format_cache;
+
   pthread_mutex_t send_lock;
   c_complain_t init_complaint;
   cdtime_t last_connect_time;
@@ -142,7 +145,7 @@ static void wg_force_reconnect_check(struct wg_callback *cb) {
  * Functions
  */
 static void wg_reset_buffer(struct wg_callback *cb) {
-  memset(cb->send_buf, 0, sizeof(cb->send_buf));
+  cb->send_buf[0] = 0;
   cb->send_buf_free = sizeof(cb->send_buf);
   cb->send_buf_fill = 0;
   cb->send_buf_init_time = cdtime();
@@ -154,7 +157,7 @@ static int wg_send_buffer(struct wg_callback *cb) {
   if (cb->sock_fd < 0)
     return -1;
 
-  status = swrite(cb->sock_fd, cb->send_buf, strlen(cb->send_buf));
+  status = swrite(cb->sock_fd, cb->send_buf, cb->send_buf_fill);
   if (status != 0) {
     if (cb->log_send_errors) {
       ERROR("write_graphite plugin: send to %s:%s (%s) failed with status %zi "
@@ -304,6 +307,9 @@ static void wg_callback_free(void *data) {
   sfree(cb->prefix);
   sfree(cb->postfix);
 
+  format_cache_destroy(cb->format_cache);
+  cb->format_cache = NULL;
+
   pthread_mutex_unlock(&cb->send_lock);
   pthread_mutex_destroy(&cb->send_lock);
 
@@ -338,39 +344,25 @@ static int wg_flush(cdtime_t timeout,
   return status;
 }
 
-static int wg_send_message(char const *message, struct wg_callback *cb) {
-  int status;
-  size_t message_len;
-
-  message_len = strlen(message);
-
-  pthread_mutex_lock(&cb->send_lock);
-
-  wg_force_reconnect_check(cb);
-
-  if (cb->sock_fd < 0) {
-    status = wg_callback_init(cb);
-    if (status != 0) {
-      /* An error message has already been printed. */
-      pthread_mutex_unlock(&cb->send_lock);
-      return -1;
-    }
-  }
-
-  if (message_len >= cb->send_buf_free) {
-    status = wg_flush_nolock(/* timeout = */ 0, cb);
-    if (status != 0) {
-      pthread_mutex_unlock(&cb->send_lock);
-      return status;
-    }
-  }
-
-  /* Assert that we have enough space for this message. */
-  assert(message_len < cb->send_buf_free);
+/* wg_format_nolock appends the graphite lines for "vl" directly to the send
+ * buffer. Returns ENOSPC if the lines do not fit into the remaining space.
+ * NOTE: You must hold cb->send_lock when calling this function! */
+static int wg_format_nolock(const data_set_t *ds, const value_list_t *vl,
+                            struct wg_callback *cb) {
+  strbuf_t buf = {
+      .ptr = cb->send_buf,
+      .pos = cb->send_buf_fill,
+      .size = sizeof(cb->send_buf),
+      .fixed = true,
+  };
+
+  int status = format_graphite_strbuf(&buf, ds, vl, cb->prefix, cb->postfix,
+                                      cb->escape_char, cb->format_flags,
+                                      cb->format_cache);
+  if (status != 0)
+    return -status;
 
-  /* `message_len + 1' because `message_len' does not include the
-   * trailing null byte. Neither does `send_buffer_fill'. */
-  memcpy(cb->send_buf + cb->send_buf_fill, message, message_len + 1);
+  size_t message_len = buf.pos - cb->send_buf_fill;
   cb->send_buf_fill += message_len;
   cb->send_buf_free -= message_len;
 
@@ -379,16 +371,13 @@ static int wg_send_message(char const *message, struct wg_callback *cb) {
         cb->node, cb->service, cb->protocol, cb->send_buf_fill,
         sizeof(cb->send_buf),
         100.0 * ((double)cb->send_buf_fill) / ((double)sizeof(cb->send_buf)),
-        message);
-
-  pthread_mutex_unlock(&cb->send_lock);
+        cb->send_buf + cb->send_buf_fill - message_len);
 
   return 0;
 }
 
 static int wg_write_messages(const data_set_t *ds, const value_list_t *vl,
                              struct wg_callback *cb) {
-  char buffer[WG_SEND_BUF_SIZE] = {0};
   int status;
 
   if (0 != strcmp(ds->type, vl->type)) {
@@ -397,17 +386,36 @@ static int wg_write_messages(const data_set_t *ds, const value_list_t *vl,
     return -1;
   }
 
-  status = format_graphite(buffer, sizeof(buffer), ds, vl, cb->prefix,
-                           cb->postfix, cb->escape_char, cb->format_flags);
-  if (status != 0) /* error message has been printed already. */
-    return status;
+  pthread_mutex_lock(&cb->send_lock);
 
-  /* Send the message to graphite */
-  status = wg_send_message(buffer, cb);
-  if (status != 0) /* error message has been printed already. */
-    return status;
+  wg_force_reconnect_check(cb);
 
-  return 0;
+  if (cb->sock_fd < 0) {
+    status = wg_callback_init(cb);
+    if (status != 0) {
+      /* An error message has already been printed. */
+      pthread_mutex_unlock(&cb->send_lock);
+      return -1;
+    }
+  }
+
+  /* Format straight into the send buffer. If the message does not fit, send
+   * what has been buffered so far and try again with an empty buffer. */
+  status = wg_format_nolock(ds, vl, cb);
+  if ((status == ENOSPC) && (cb->send_buf_fill > 0)) {
+    status = wg_flush_nolock(/* timeout = */ 0, cb);
+    if (status == 0)
+      status = wg_format_nolock(ds, vl, cb);
+  }
+
+  if (status == ENOSPC)
+    ERROR("write_graphite plugin: message for \"%s\" does not fit into the "
+          "send buffer (%" PRIsz " bytes).",
+          vl->plugin, sizeof(cb->send_buf));
+  /* Other errors have been printed already. */
+
+  pthread_mutex_unlock(&cb->send_lock);
+  return status;
 } /* int wg_write_messages */
 
 static int wg_write(const data_set_t *ds, const value_list_t *vl,
@@ -486,6 +494,13 @@ static int wg_config_node(oconfig_item_t *ci) {
   pthread_mutex_init(&cb->send_lock, /* attr = */ NULL);
   C_COMPLAIN_INIT(&cb->init_complaint);
 
+  cb->format_cache = format_cache_create(FORMAT_CACHE_DEFAULT_SIZE);
+  if (cb->format_cache == NULL) {
+    ERROR("write_graphite plugin: format_cache_create failed.");
+    wg_callback_free(cb);
+    return -1;
+  }
+
   for (int i = 0; i < ci->children_num; i++) {
     oconfig_item_t *child = ci->children + i;
 
@@ -34,6 +34,10 @@
 
 #include <curl/curl.h>
 
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #ifndef WRITE_HTTP_DEFAULT_BUFFER_SIZE
 #define WRITE_HTTP_DEFAULT_BUFFER_SIZE 4096
 #endif
@@ -46,9 +50,43 @@
 #define WRITE_HTTP_RESPONSE_BUFFER_SIZE 1024
 #endif
 
+/* Without curl_multi_wakeup(), the sender thread checks for new requests at
+ * this interval while other requests are in flight. */
+#define WH_SENDER_POLL_MS 100
+
 /*
  * Private variables
  */
+typedef enum {
+  WH_REQUEST_IDLE = 0,
+  WH_REQUEST_QUEUED,
+  WH_REQUEST_ACTIVE,
+} wh_request_state_t;
+
+/* A request owns a curl handle and the body being posted. Write threads fill
+ * the send buffer and swap it with the buffer of an idle request; the sender
+ * thread posts queued requests. */
+struct wh_request_s {
+  wh_request_state_t state;
+
+  CURL *curl;
+  char curl_errbuf[CURL_ERROR_SIZE];
+
+  char *data;
+  size_t data_size;
+  size_t data_len;
+
+  char *gz_buffer;
+  size_t gz_buffer_size;
+  size_t gz_len;
+
+  cdtime_t submit_time;
+
+  char response_buffer[WRITE_HTTP_RESPONSE_BUFFER_SIZE];
+  unsigned int response_buffer_pos;
+};
+typedef struct wh_request_s wh_request_t;
+
 struct wh_callback_s {
   char *name;
 
@@ -78,10 +116,25 @@ struct wh_callback_s {
   bool send_metrics;
   bool send_notifications;
 
-  CURL *curl;
   curl_stats_t *curl_stats;
   struct curl_slist *headers;
-  char curl_errbuf[CURL_ERROR_SIZE];
+  bool headers_initialized;
+  bool compress;
+
+  CURLM *multi;
+  wh_request_t *requests;
+  size_t requests_num;
+  size_t max_in_flight;
+
+  pthread_t sender_thread;
+  bool sender_running;
+  bool sender_shutdown;
+  /* Protects the request states and sender_shutdown. */
+  pthread_mutex_t queue_lock;
+  /* Signalled when a request becomes idle. */
+  pthread_cond_t queue_cond;
+  /* Signalled when a request is queued and on shutdown. */
+  pthread_cond_t sender_cond;
 
   char *send_buffer;
   size_t send_buffer_size;
@@ -89,10 +142,10 @@ struct wh_callback_s {
   size_t send_buffer_fill;
   cdtime_t send_buffer_init_time;
 
-  pthread_mutex_t send_lock;
+  /* Escaped identifier fragments, protected by send_lock. */
+  format_cache_t *format_cache;
 
-  char response_buffer[WRITE_HTTP_RESPONSE_BUFFER_SIZE];
-  unsigned int response_buffer_pos;
+  pthread_mutex_t send_lock;
 
   int data_ttl;
   char *metrics_prefix;
@@ -110,21 +163,21 @@ static size_t http_attrs_num;
 static size_t wh_curl_write_callback(char *ptr, size_t size, size_t nmemb,
                                      void *userdata) {
 
-  wh_callback_t *cb = (wh_callback_t *)userdata;
+  wh_request_t *r = (wh_request_t *)userdata;
   unsigned int len = 0;
 
-  if ((cb->response_buffer_pos + nmemb) > sizeof(cb->response_buffer))
-    len = sizeof(cb->response_buffer) - cb->response_buffer_pos;
+  if ((r->response_buffer_pos + nmemb) > sizeof(r->response_buffer))
+    len = sizeof(r->response_buffer) - r->response_buffer_pos;
   else
     len = nmemb;
 
   DEBUG(
       "write_http plugin: curl callback nmemb=%zu buffer_pos=%u write_len=%u ",
-      nmemb, cb->response_buffer_pos, len);
+      nmemb, r->response_buffer_pos, len);
 
-  memcpy(cb->response_buffer + cb->response_buffer_pos, ptr, len);
-  cb->response_buffer_pos += len;
-  cb->response_buffer[sizeof(cb->response_buffer) - 1] = '\0';
+  memcpy(r->response_buffer + r->response_buffer_pos, ptr, len);
+  r->response_buffer_pos += len;
+  r->response_buffer[sizeof(r->response_buffer) - 1] = '\0';
 
   /* Always return nmemb even if we write less so libcurl won't throw an error
    */
@@ -132,13 +185,13 @@ static size_t wh_curl_write_callback(char *ptr, size_t size, size_t nmemb,
 
 } /* }}} wh_curl_write_callback */
 
-static void wh_log_http_error(wh_callback_t *cb) {
+static void wh_log_http_error(wh_callback_t *cb, CURL *curl) {
   if (!cb->log_http_error)
     return;
 
   long http_code = 0;
 
-  curl_easy_getinfo(cb->curl, CURLINFO_RESPONSE_CODE, &http_code);
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
 
   if (http_code != 200)
     INFO("write_http plugin: HTTP Error code: %lu", http_code);
@@ -149,39 +202,178 @@ static void wh_reset_buffer(wh_callback_t *cb) /* {{{ */
   if ((cb == NULL) || (cb->send_buffer == NULL))
     return;
 
-  memset(cb->send_buffer, 0, cb->send_buffer_size);
+  /* The JSON and InfluxDB formatters keep the buffer null terminated, so
+   * there is no need to clear all of it. */
+  cb->send_buffer[0] = 0;
   cb->send_buffer_free = cb->send_buffer_size;
   cb->send_buffer_fill = 0;
   cb->send_buffer_init_time = cdtime();
 
-  if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB) {
+  if (cb->format == WH_FORMAT_KAIROSDB) {
     format_json_initialize(cb->send_buffer, &cb->send_buffer_fill,
                            &cb->send_buffer_free);
   }
+} /* }}} wh_reset_buffer */
 
-  memset(cb->response_buffer, 0, sizeof(cb->response_buffer));
-  cb->response_buffer_pos = 0;
+static CURL *wh_curl_create(wh_callback_t *cb, wh_request_t *r) /* {{{ */
+{
+  CURL *curl = curl_easy_init();
+  if (curl == NULL) {
+    ERROR("write_http plugin: curl_easy_init failed.");
+    return NULL;
+  }
 
-} /* }}} wh_reset_buffer */
+  if (cb->low_speed_limit > 0 && cb->low_speed_time > 0) {
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT,
+                     (long)(cb->low_speed_limit * cb->low_speed_time));
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)cb->low_speed_time);
+  }
 
-/* must hold cb->send_lock when calling */
-static int wh_post_nolock(wh_callback_t *cb, char const *data,
-                          long size) /* {{{ */
+#ifdef HAVE_CURLOPT_TIMEOUT_MS
+  if (cb->timeout > 0)
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)cb->timeout);
+#endif
+
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, cb->headers);
+
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, r->curl_errbuf);
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 50L);
+  curl_easy_setopt(curl, CURLOPT_URL, cb->location);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &wh_curl_write_callback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)r);
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *)r);
+
+  if (cb->user != NULL) {
+#ifdef HAVE_CURLOPT_USERNAME
+    curl_easy_setopt(curl, CURLOPT_USERNAME, cb->user);
+    curl_easy_setopt(curl, CURLOPT_PASSWORD,
+                     (cb->pass == NULL) ? "" : cb->pass);
+#else
+    curl_easy_setopt(curl, CURLOPT_USERPWD, cb->credentials);
+#endif
+    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
+  }
+
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, (long)cb->verify_peer);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, cb->verify_host ? 2L : 0L);
+  curl_easy_setopt(curl, CURLOPT_SSLVERSION, cb->sslversion);
+  if (cb->cacert != NULL)
+    curl_easy_setopt(curl, CURLOPT_CAINFO, cb->cacert);
+  if (cb->capath != NULL)
+    curl_easy_setopt(curl, CURLOPT_CAPATH, cb->capath);
+
+  if (cb->clientkey != NULL && cb->clientcert != NULL) {
+    curl_easy_setopt(curl, CURLOPT_SSLKEY, cb->clientkey);
+    curl_easy_setopt(curl, CURLOPT_SSLCERT, cb->clientcert);
+
+    if (cb->clientkeypass != NULL)
+      curl_easy_setopt(curl, CURLOPT_SSLKEYPASSWD, cb->clientkeypass);
+  }
+#ifdef CURL_VERSION_UNIX_SOCKETS
+  if (cb->unix_socket_path) {
+    curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, cb->unix_socket_path);
+  }
+#endif // CURL_VERSION_UNIX_SOCKETS
+
+  return curl;
+} /* }}} CURL *wh_curl_create */
+
+#if HAVE_ZLIB
+/* wh_request_compress gzips the request body into r->gz_buffer. */
+static int wh_request_compress(wh_request_t *r) /* {{{ */
 {
-  int status = 0;
+  z_stream zs = {0};
+
+  /* 16 + MAX_WBITS: write a gzip header and trailer. */
+  int status = deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                            16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+  if (status != Z_OK) {
+    ERROR("write_http plugin: deflateInit2 failed with status %d.", status);
+    return -1;
+  }
+
+  size_t need = (size_t)deflateBound(&zs, (uLong)r->data_len);
+  if (r->gz_buffer_size < need) {
+    char *tmp = realloc(r->gz_buffer, need);
+    if (tmp == NULL) {
+      ERROR("write_http plugin: realloc(%" PRIsz ") failed.", need);
+      deflateEnd(&zs);
+      return -1;
+    }
+    r->gz_buffer = tmp;
+    r->gz_buffer_size = need;
+  }
+
+  zs.next_in = (Bytef *)r->data;
+  zs.avail_in = (uInt)r->data_len;
+  zs.next_out = (Bytef *)r->gz_buffer;
+  zs.avail_out = (uInt)r->gz_buffer_size;
+
+  status = deflate(&zs, Z_FINISH);
+  size_t gz_len = (size_t)zs.total_out;
+  deflateEnd(&zs);
+  if (status != Z_STREAM_END) {
+    ERROR("write_http plugin: deflate failed with status %d.", status);
+    return -1;
+  }
 
-  curl_easy_setopt(cb->curl, CURLOPT_URL, cb->location);
-  curl_easy_setopt(cb->curl, CURLOPT_POSTFIELDSIZE, size);
-  curl_easy_setopt(cb->curl, CURLOPT_POSTFIELDS, data);
-  curl_easy_setopt(cb->curl, CURLOPT_WRITEFUNCTION, &wh_curl_write_callback);
-  curl_easy_setopt(cb->curl, CURLOPT_WRITEDATA, (void *)cb);
-  status = curl_easy_perform(cb->curl);
+  r->gz_len = gz_len;
+  return 0;
+} /* }}} int wh_request_compress */
+#endif
 
-  wh_log_http_error(cb);
+/* wh_request_start hands a queued request to the multi handle. Runs in the
+ * sender thread without holding any locks. */
+static int wh_request_start(wh_callback_t *cb, wh_request_t *r) /* {{{ */
+{
+  char const *body = r->data;
+  size_t body_len = r->data_len;
+
+#if HAVE_ZLIB
+  if (cb->compress) {
+    /* The "Content-Encoding" header is set, so drop the data rather than
+     * sending it uncompressed. */
+    if (wh_request_compress(r) != 0)
+      return -1;
+    body = r->gz_buffer;
+    body_len = r->gz_len;
+  }
+#endif
+
+  r->response_buffer[0] = 0;
+  r->response_buffer_pos = 0;
+  r->curl_errbuf[0] = 0;
+
+  curl_easy_setopt(r->curl, CURLOPT_POSTFIELDSIZE, (long)body_len);
+  curl_easy_setopt(r->curl, CURLOPT_POSTFIELDS, body);
+
+  CURLMcode status = curl_multi_add_handle(cb->multi, r->curl);
+  if (status != CURLM_OK) {
+    ERROR("write_http plugin: curl_multi_add_handle failed: %s",
+          curl_multi_strerror(status));
+    return -1;
+  }
+
+  return 0;
+} /* }}} int wh_request_start */
+
+/* wh_request_done reports the result of a request. Runs in the sender thread
+ * without holding any locks. */
+static void wh_request_done(wh_callback_t *cb, wh_request_t *r, /* {{{ */
+                            CURLcode result, size_t in_flight) {
+  cdtime_t queue_time = cdtime() - r->submit_time;
+
+  wh_log_http_error(cb, r->curl);
 
   if (cb->curl_stats != NULL) {
-    int rc = curl_stats_dispatch(cb->curl_stats, cb->curl, NULL, "write_http",
+    int rc = curl_stats_dispatch(cb->curl_stats, r->curl, NULL, "write_http",
                                  cb->name);
+    if (rc == 0)
+      rc = curl_stats_dispatch_queue(cb->curl_stats, in_flight, queue_time,
+                                     NULL, "write_http", cb->name);
     if (rc != 0) {
       ERROR("write_http plugin: curl_stats_dispatch failed with "
             "status %i",
@@ -189,64 +381,187 @@ static int wh_post_nolock(wh_callback_t *cb, char const *data,
     }
   }
 
-  if (status != CURLE_OK) {
-    ERROR("write_http plugin: curl_easy_perform failed with "
+  if (result != CURLE_OK) {
+    ERROR("write_http plugin: posting to %s failed with "
           "status %i: %s",
-          status, cb->curl_errbuf);
-    if (strlen(cb->response_buffer) > 0) {
-      ERROR("write_http plugin: curl_response=%s", cb->response_buffer);
+          cb->location, result,
+          (r->curl_errbuf[0] != 0) ? r->curl_errbuf
+                                   : curl_easy_strerror(result));
+    if (strlen(r->response_buffer) > 0) {
+      ERROR("write_http plugin: curl_response=%s", r->response_buffer);
     }
   } else {
-    DEBUG("write_http plugin: curl_response=%s", cb->response_buffer);
+    DEBUG("write_http plugin: curl_response=%s", r->response_buffer);
   }
-  return status;
-} /* }}} wh_post_nolock */
+} /* }}} void wh_request_done */
 
-static int wh_callback_init(wh_callback_t *cb) /* {{{ */
+/* wh_sender_thread posts queued requests concurrently using a curl multi
+ * handle, so that write threads are only blocked when all requests are in
+ * flight. */
+static void *wh_sender_thread(void *arg) /* {{{ */
 {
-  if (cb->curl != NULL)
-    return 0;
+  wh_callback_t *cb = arg;
+  size_t active = 0;
+
+  pthread_mutex_lock(&cb->queue_lock);
+  while (true) {
+    /* Start queued requests. The lock is released while starting a request,
+     * so repeat until no queued request is left. */
+    bool started;
+    do {
+      started = false;
+      for (size_t i = 0; i < cb->requests_num; i++) {
+        wh_request_t *r = cb->requests + i;
+        if (r->state != WH_REQUEST_QUEUED)
+          continue;
+
+        r->state = WH_REQUEST_ACTIVE;
+        started = true;
+
+        pthread_mutex_unlock(&cb->queue_lock);
+        int status = wh_request_start(cb, r);
+        pthread_mutex_lock(&cb->queue_lock);
+
+        if (status == 0) {
+          active++;
+        } else {
+          ERROR("write_http plugin: Dropping %" PRIsz " bytes for %s.",
+                r->data_len, cb->location);
+          r->state = WH_REQUEST_IDLE;
+          pthread_cond_broadcast(&cb->queue_cond);
+        }
+      }
+    } while (started);
 
-  cb->curl = curl_easy_init();
-  if (cb->curl == NULL) {
-    ERROR("curl plugin: curl_easy_init failed.");
-    return -1;
+    if (active == 0) {
+      if (cb->sender_shutdown)
+        break;
+      pthread_cond_wait(&cb->sender_cond, &cb->queue_lock);
+      continue;
+    }
+    pthread_mutex_unlock(&cb->queue_lock);
+
+    int running = 0;
+    curl_multi_perform(cb->multi, &running);
+
+    CURLMsg *msg;
+    int msgs_left = 0;
+    while ((msg = curl_multi_info_read(cb->multi, &msgs_left)) != NULL) {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      wh_request_t *r = NULL;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&r);
+      CURLcode result = msg->data.result;
+      curl_multi_remove_handle(cb->multi, msg->easy_handle);
+
+      wh_request_done(cb, r, result, active);
+      active--;
+
+      pthread_mutex_lock(&cb->queue_lock);
+      r->state = WH_REQUEST_IDLE;
+      pthread_cond_broadcast(&cb->queue_cond);
+      pthread_mutex_unlock(&cb->queue_lock);
+    }
+
+    if (active > 0) {
+#if CURL_AT_LEAST_VERSION(7, 68, 0)
+      /* Woken up by curl_multi_wakeup() when new requests are queued. */
+      curl_multi_poll(cb->multi, NULL, 0, 1000, NULL);
+#else
+      /* New requests are picked up after at most WH_SENDER_POLL_MS. */
+      curl_multi_wait(cb->multi, NULL, 0, WH_SENDER_POLL_MS, NULL);
+#endif
+    }
+
+    pthread_mutex_lock(&cb->queue_lock);
+  }
+  pthread_mutex_unlock(&cb->queue_lock);
+
+  return NULL;
+} /* }}} void *wh_sender_thread */
+
+/* wh_submit_nolock queues the content of the send buffer, or "data" if not
+ * NULL, for posting. If all requests are in flight, this blocks until one
+ * finishes.
+ * must hold cb->send_lock when calling */
+static int wh_submit_nolock(wh_callback_t *cb, char const *data, /* {{{ */
+                            size_t data_len) {
+  pthread_mutex_lock(&cb->queue_lock);
+
+  wh_request_t *r = NULL;
+  while (r == NULL) {
+    for (size_t i = 0; i < cb->requests_num; i++) {
+      if (cb->requests[i].state == WH_REQUEST_IDLE) {
+        r = cb->requests + i;
+        break;
+      }
+    }
+    if (r == NULL)
+      pthread_cond_wait(&cb->queue_cond, &cb->queue_lock);
   }
 
-  if (cb->low_speed_limit > 0 && cb->low_speed_time > 0) {
-    curl_easy_setopt(cb->curl, CURLOPT_LOW_SPEED_LIMIT,
-                     (long)(cb->low_speed_limit * cb->low_speed_time));
-    curl_easy_setopt(cb->curl, CURLOPT_LOW_SPEED_TIME,
-                     (long)cb->low_speed_time);
+  if (data != NULL) {
+    if (r->data_size < data_len + 1) {
+      char *tmp = realloc(r->data, data_len + 1);
+      if (tmp == NULL) {
+        pthread_mutex_unlock(&cb->queue_lock);
+        ERROR("write_http plugin: realloc(%" PRIsz ") failed.", data_len + 1);
+        return ENOMEM;
+      }
+      r->data = tmp;
+      r->data_size = data_len + 1;
+    }
+    memcpy(r->data, data, data_len);
+    r->data[data_len] = 0;
+    r->data_len = data_len;
+  } else {
+    /* Swap buffers: the request takes the filled send buffer and the write
+     * threads continue with the request's previous buffer. */
+    char *tmp = r->data;
+    size_t tmp_size = r->data_size;
+    r->data = cb->send_buffer;
+    r->data_size = cb->send_buffer_size;
+    r->data_len = cb->send_buffer_fill;
+    cb->send_buffer = tmp;
+    assert(tmp_size >= cb->send_buffer_size);
   }
 
-#ifdef HAVE_CURLOPT_TIMEOUT_MS
-  if (cb->timeout > 0)
-    curl_easy_setopt(cb->curl, CURLOPT_TIMEOUT_MS, (long)cb->timeout);
+  r->submit_time = cdtime();
+  r->state = WH_REQUEST_QUEUED;
+  pthread_cond_signal(&cb->sender_cond);
+  pthread_mutex_unlock(&cb->queue_lock);
+
+#if CURL_AT_LEAST_VERSION(7, 68, 0)
+  curl_multi_wakeup(cb->multi);
 #endif
 
-  curl_easy_setopt(cb->curl, CURLOPT_NOSIGNAL, 1L);
-  curl_easy_setopt(cb->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
+  if (data == NULL)
+    wh_reset_buffer(cb);
+  return 0;
+} /* }}} int wh_submit_nolock */
 
-  cb->headers = curl_slist_append(cb->headers, "Accept:  */*");
-  if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB)
-    cb->headers =
-        curl_slist_append(cb->headers, "Content-Type: application/json");
-  else
-    cb->headers = curl_slist_append(cb->headers, "Content-Type: text/plain");
-  cb->headers = curl_slist_append(cb->headers, "Expect:");
-  curl_easy_setopt(cb->curl, CURLOPT_HTTPHEADER, cb->headers);
+/* must hold cb->send_lock when calling */
+static int wh_callback_init(wh_callback_t *cb) /* {{{ */
+{
+  if (cb->sender_running)
+    return 0;
 
-  curl_easy_setopt(cb->curl, CURLOPT_ERRORBUFFER, cb->curl_errbuf);
-  curl_easy_setopt(cb->curl, CURLOPT_FOLLOWLOCATION, 1L);
-  curl_easy_setopt(cb->curl, CURLOPT_MAXREDIRS, 50L);
+  if (!cb->headers_initialized) {
+    cb->headers = curl_slist_append(cb->headers, "Accept:  */*");
+    if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB)
+      cb->headers =
+          curl_slist_append(cb->headers, "Content-Type: application/json");
+    else
+      cb->headers = curl_slist_append(cb->headers, "Content-Type: text/plain");
+    cb->headers = curl_slist_append(cb->headers, "Expect:");
+    if (cb->compress)
+      cb->headers = curl_slist_append(cb->headers, "Content-Encoding: gzip");
+    cb->headers_initialized = true;
+  }
 
-  if (cb->user != NULL) {
-#ifdef HAVE_CURLOPT_USERNAME
-    curl_easy_setopt(cb->curl, CURLOPT_USERNAME, cb->user);
-    curl_easy_setopt(cb->curl, CURLOPT_PASSWORD,
-                     (cb->pass == NULL) ? "" : cb->pass);
-#else
+#ifndef HAVE_CURLOPT_USERNAME
+  if ((cb->user != NULL) && (cb->credentials == NULL)) {
     size_t credentials_size;
 
     credentials_size = strlen(cb->user) + 2;
@@ -261,31 +576,54 @@ static int wh_callback_init(wh_callback_t *cb) /* {{{ */
 
     snprintf(cb->credentials, credentials_size, "%s:%s", cb->user,
              (cb->pass == NULL) ? "" : cb->pass);
-    curl_easy_setopt(cb->curl, CURLOPT_USERPWD, cb->credentials);
+  }
 #endif
-    curl_easy_setopt(cb->curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
+
+  if (cb->multi == NULL) {
+    cb->multi = curl_multi_init();
+    if (cb->multi == NULL) {
+      ERROR("write_http plugin: curl_multi_init failed.");
+      return -1;
+    }
   }
 
-  curl_easy_setopt(cb->curl, CURLOPT_SSL_VERIFYPEER, (long)cb->verify_peer);
-  curl_easy_setopt(cb->curl, CURLOPT_SSL_VERIFYHOST, cb->verify_host ? 2L : 0L);
-  curl_easy_setopt(cb->curl, CURLOPT_SSLVERSION, cb->sslversion);
-  if (cb->cacert != NULL)
-    curl_easy_setopt(cb->curl, CURLOPT_CAINFO, cb->cacert);
-  if (cb->capath != NULL)
-    curl_easy_setopt(cb->curl, CURLOPT_CAPATH, cb->capath);
+  if (cb->requests == NULL) {
+    cb->requests = calloc(cb->max_in_flight, sizeof(*cb->requests));
+    if (cb->requests == NULL) {
+      ERROR("write_http plugin: calloc failed.");
+      return -1;
+    }
+    cb->requests_num = cb->max_in_flight;
+  }
 
-  if (cb->clientkey != NULL && cb->clientcert != NULL) {
-    curl_easy_setopt(cb->curl, CURLOPT_SSLKEY, cb->clientkey);
-    curl_easy_setopt(cb->curl, CURLOPT_SSLCERT, cb->clientcert);
+  for (size_t i = 0; i < cb->requests_num; i++) {
+    wh_request_t *r = cb->requests + i;
 
-    if (cb->clientkeypass != NULL)
-      curl_easy_setopt(cb->curl, CURLOPT_SSLKEYPASSWD, cb->clientkeypass);
+    if (r->data == NULL) {
+      r->data = malloc(cb->send_buffer_size);
+      if (r->data == NULL) {
+        ERROR("write_http plugin: malloc(%" PRIsz ") failed.",
+              cb->send_buffer_size);
+        return -1;
+      }
+      r->data_size = cb->send_buffer_size;
+    }
+
+    if (r->curl == NULL) {
+      r->curl = wh_curl_create(cb, r);
+      if (r->curl == NULL)
+        return -1;
+    }
   }
-#ifdef CURL_VERSION_UNIX_SOCKETS
-  if (cb->unix_socket_path) {
-    curl_easy_setopt(cb->curl, CURLOPT_UNIX_SOCKET_PATH, cb->unix_socket_path);
+
+  int status = plugin_thread_create(&cb->sender_thread, wh_sender_thread, cb,
+                                    "write_http send");
+  if (status != 0) {
+    ERROR("write_http plugin: plugin_thread_create failed with status %i.",
+          status);
+    return -1;
   }
-#endif // CURL_VERSION_UNIX_SOCKETS
+  cb->sender_running = true;
 
   wh_reset_buffer(cb);
 
@@ -315,8 +653,7 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
       return 0;
     }
 
-    status = wh_post_nolock(cb, cb->send_buffer, cb->send_buffer_fill);
-    wh_reset_buffer(cb);
+    status = wh_submit_nolock(cb, /* data = */ NULL, 0);
   } else if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB) {
     if (cb->send_buffer_fill <= 2) {
       cb->send_buffer_init_time = cdtime();
@@ -332,16 +669,14 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
       return status;
     }
 
-    status = wh_post_nolock(cb, cb->send_buffer, cb->send_buffer_fill);
-    wh_reset_buffer(cb);
+    status = wh_submit_nolock(cb, /* data = */ NULL, 0);
   } else if (cb->format == WH_FORMAT_INFLUXDB) {
     if (cb->send_buffer_fill == 0) {
       cb->send_buffer_init_time = cdtime();
       return 0;
     }
 
-    status = wh_post_nolock(cb, cb->send_buffer, cb->send_buffer_fill);
-    wh_reset_buffer(cb);
+    status = wh_submit_nolock(cb, /* data = */ NULL, 0);
   } else {
     ERROR("write_http: wh_flush_nolock: "
           "Unknown format: %i",
@@ -349,6 +684,8 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
     return -1;
   }
 
+  if (status != 0)
+    wh_reset_buffer(cb);
   return status;
 } /* }}} wh_flush_nolock */
 
@@ -386,12 +723,34 @@ static void wh_callback_free(void *data) /* {{{ */
 
   cb = data;
 
-  if (cb->send_buffer != NULL)
-    wh_flush_nolock(/* timeout = */ 0, cb);
+  if (cb->sender_running) {
+    if (cb->send_buffer != NULL)
+      wh_flush_nolock(/* timeout = */ 0, cb);
+
+    /* Let the sender thread finish the requests in flight. */
+    pthread_mutex_lock(&cb->queue_lock);
+    cb->sender_shutdown = true;
+    pthread_cond_signal(&cb->sender_cond);
+    pthread_mutex_unlock(&cb->queue_lock);
+
+    pthread_join(cb->sender_thread, /* retval = */ NULL);
+    cb->sender_running = false;
+  }
+
+  for (size_t i = 0; i < cb->requests_num; i++) {
+    wh_request_t *r = cb->requests + i;
+
+    if (r->curl != NULL)
+      curl_easy_cleanup(r->curl);
+    sfree(r->data);
+    sfree(r->gz_buffer);
+  }
+  sfree(cb->requests);
+  cb->requests_num = 0;
 
-  if (cb->curl != NULL) {
-    curl_easy_cleanup(cb->curl);
-    cb->curl = NULL;
+  if (cb->multi != NULL) {
+    curl_multi_cleanup(cb->multi);
+    cb->multi = NULL;
   }
 
   curl_stats_destroy(cb->curl_stats);
@@ -402,6 +761,10 @@ static void wh_callback_free(void *data) /* {{{ */
     cb->headers = NULL;
   }
 
+  pthread_cond_destroy(&cb->sender_cond);
+  pthread_cond_destroy(&cb->queue_cond);
+  pthread_mutex_destroy(&cb->queue_lock);
+
   sfree(cb->name);
   sfree(cb->location);
   sfree(cb->user);
@@ -414,6 +777,7 @@ static void wh_callback_free(void *data) /* {{{ */
   sfree(cb->clientkeypass);
   sfree(cb->send_buffer);
   sfree(cb->metrics_prefix);
+  format_cache_destroy(cb->format_cache);
 
   sfree(cb);
 } /* }}} void wh_callback_free */
@@ -501,6 +865,28 @@ static int wh_write_command(const data_set_t *ds,
   return 0;
 } /* }}} int wh_write_command */
 
+/* wh_format_json_nolock appends "vl" to the send buffer, leaving room for
+ * the closing bracket added by format_json_finalize().
+ * must hold cb->send_lock when calling */
+static int wh_format_json_nolock(const data_set_t *ds, /* {{{ */
+                                 const value_list_t *vl, wh_callback_t *cb) {
+  strbuf_t buf = {
+      .ptr = cb->send_buffer,
+      .pos = cb->send_buffer_fill,
+      .size = cb->send_buffer_size - 1,
+      .fixed = true,
+  };
+
+  int status = format_json_value_list_strbuf(&buf, ds, vl, cb->store_rates,
+                                             cb->format_cache);
+  if (status != 0)
+    return status;
+
+  cb->send_buffer_free -= buf.pos - cb->send_buffer_fill;
+  cb->send_buffer_fill = buf.pos;
+  return 0;
+} /* }}} int wh_format_json_nolock */
+
 static int wh_write_json(const data_set_t *ds, const value_list_t *vl, /* {{{ */
                          wh_callback_t *cb) {
   int status;
@@ -512,10 +898,8 @@ static int wh_write_json(const data_set_t *ds, const value_list_t *vl, /* {{{ */
     return -1;
   }
 
-  status =
-      format_json_value_list(cb->send_buffer, &cb->send_buffer_fill,
-                             &cb->send_buffer_free, ds, vl, cb->store_rates);
-  if (status == -ENOMEM) {
+  status = wh_format_json_nolock(ds, vl, cb);
+  if (status == -ENOSPC) {
     status = wh_flush_nolock(/* timeout = */ 0, cb);
     if (status != 0) {
       wh_reset_buffer(cb);
@@ -523,9 +907,7 @@ static int wh_write_json(const data_set_t *ds, const value_list_t *vl, /* {{{ */
       return status;
     }
 
-    status =
-        format_json_value_list(cb->send_buffer, &cb->send_buffer_fill,
-                               &cb->send_buffer_free, ds, vl, cb->store_rates);
+    status = wh_format_json_nolock(ds, vl, cb);
   }
   if (status != 0) {
     pthread_mutex_unlock(&cb->send_lock);
@@ -550,13 +932,11 @@ static int wh_write_kairosdb(const data_set_t *ds,
 
   pthread_mutex_lock(&cb->send_lock);
 
-  if (cb->curl == NULL) {
-    status = wh_callback_init(cb);
-    if (status != 0) {
-      ERROR("write_http plugin: wh_callback_init failed.");
-      pthread_mutex_unlock(&cb->send_lock);
-      return -1;
-    }
+  status = wh_callback_init(cb);
+  if (status != 0) {
+    ERROR("write_http plugin: wh_callback_init failed.");
+    pthread_mutex_unlock(&cb->send_lock);
+    return -1;
   }
 
   status = format_kairosdb_value_list(
@@ -592,6 +972,27 @@ static int wh_write_kairosdb(const data_set_t *ds,
   return 0;
 } /* }}} int wh_write_kairosdb */
 
+/* must hold cb->send_lock when calling */
+static int wh_format_influxdb_nolock(const data_set_t *ds, /* {{{ */
+                                     const value_list_t *vl,
+                                     wh_callback_t *cb) {
+  strbuf_t buf = {
+      .ptr = cb->send_buffer,
+      .pos = cb->send_buffer_fill,
+      .size = cb->send_buffer_size,
+      .fixed = true,
+  };
+
+  int status = format_influxdb_value_list_strbuf(
+      &buf, ds, vl, NS, cb->store_rates, true, cb->format_cache);
+  if (status != 0)
+    return status;
+
+  cb->send_buffer_free -= buf.pos - cb->send_buffer_fill;
+  cb->send_buffer_fill = buf.pos;
+  return 0;
+} /* }}} int wh_format_influxdb_nolock */
+
 static int wh_write_influxdb(const data_set_t *ds,
                              const value_list_t *vl, /* {{{ */
                              wh_callback_t *cb) {
@@ -604,10 +1005,8 @@ static int wh_write_influxdb(const data_set_t *ds,
     return -1;
   }
 
-  status = format_influxdb_value_list(cb->send_buffer + cb->send_buffer_fill,
-                                      cb->send_buffer_free, ds, vl, NS,
-                                      cb->store_rates, true);
-  if (status == -ENOMEM) {
+  status = wh_format_influxdb_nolock(ds, vl, cb);
+  if (status == -ENOSPC) {
     status = wh_flush_nolock(/* timeout = */ 0, cb);
     if (status != 0) {
       wh_reset_buffer(cb);
@@ -615,18 +1014,13 @@ static int wh_write_influxdb(const data_set_t *ds,
       return status;
     }
 
-    status = format_influxdb_value_list(cb->send_buffer + cb->send_buffer_fill,
-                                        cb->send_buffer_free, ds, vl, NS,
-                                        cb->store_rates, true);
+    status = wh_format_influxdb_nolock(ds, vl, cb);
   }
-  if (status < 0) {
+  if (status != 0) {
     pthread_mutex_unlock(&cb->send_lock);
     return status;
   }
 
-  cb->send_buffer_fill += status;
-  cb->send_buffer_free -= status;
-
   /* Check if we have enough space for this command. */
   pthread_mutex_unlock(&cb->send_lock);
 
@@ -686,7 +1080,7 @@ static int wh_notify(notification_t const *n, user_data_t *ud) /* {{{ */
     return -1;
   }
 
-  status = wh_post_nolock(cb, alert, -1);
+  status = wh_submit_nolock(cb, alert, strlen(alert));
   pthread_mutex_unlock(&cb->send_lock);
 
   return status;
@@ -771,7 +1165,12 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
     return -1;
   }
 
+  cb->max_in_flight = 1;
+
   pthread_mutex_init(&cb->send_lock, /* attr = */ NULL);
+  pthread_mutex_init(&cb->queue_lock, /* attr = */ NULL);
+  pthread_cond_init(&cb->queue_cond, /* attr = */ NULL);
+  pthread_cond_init(&cb->sender_cond, /* attr = */ NULL);
 
   cf_util_get_string(ci, &cb->name);
 
@@ -887,6 +1286,22 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_int(child, &cb->data_ttl);
     } else if (strcasecmp("Prefix", child->key) == 0) {
       status = cf_util_get_string(child, &cb->metrics_prefix);
+    } else if (strcasecmp("MaxInFlight", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if ((status == 0) && (tmp < 1)) {
+        ERROR("write_http plugin: MaxInFlight must be positive.");
+        status = EINVAL;
+      }
+      if (status == 0)
+        cb->max_in_flight = (size_t)tmp;
+    } else if (strcasecmp("Compress", child->key) == 0) {
+#if HAVE_ZLIB
+      status = cf_util_get_boolean(child, &cb->compress);
+#else
+      WARNING("write_http plugin: zlib support is not compiled in, "
+              "the Compress option is ignored.");
+#endif
     } else if (strcasecmp("UnixSocket", child->key) == 0) {
 #ifdef CURL_VERSION_UNIX_SOCKETS
       status = cf_util_get_string(child, &cb->unix_socket_path);
@@ -946,6 +1361,15 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
     return -1;
   }
 
+  if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_INFLUXDB) {
+    cb->format_cache = format_cache_create(FORMAT_CACHE_DEFAULT_SIZE);
+    if (cb->format_cache == NULL) {
+      ERROR("write_http plugin: format_cache_create failed.");
+      wh_callback_free(cb);
+      return -1;
+    }
+  }
+
   /* Nulls the buffer and sets ..._free and ..._fill. */
   wh_reset_buffer(cb);
 
@@ -0,0 +1,338 @@
+/**
+ * collectd - src/write_http_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#define plugin_register_write plugin_register_write_wh_test
+#define plugin_register_flush plugin_register_flush_wh_test
+#define plugin_thread_create plugin_thread_create_wh_test
+
+#include "testing.h"
+
+#include "write_http.c" /* sic */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define TEST_MAX_CONNECTIONS 8
+
+/* A minimal HTTP server on the loopback interface which records the bodies
+ * of the requests it receives. */
+static int server_fd = -1;
+static char server_url[64];
+static pthread_t server_thread;
+
+static pthread_t connection_threads[TEST_MAX_CONNECTIONS];
+static size_t connection_threads_num;
+
+static pthread_mutex_t received_lock = PTHREAD_MUTEX_INITIALIZER;
+static char received[65536];
+static size_t received_len;
+static size_t requests_num;
+static size_t concurrent;
+static size_t concurrent_max;
+
+/* Delay before each response, so that requests overlap. */
+static unsigned int response_delay_us;
+
+static user_data_t registered;
+
+/* mock functions */
+int plugin_register_write_wh_test(__attribute__((unused)) const char *name,
+                                  __attribute__((unused)) plugin_write_cb cb,
+                                  user_data_t const *ud) {
+  registered = *ud;
+  return 0;
+}
+
+int plugin_register_flush_wh_test(__attribute__((unused)) const char *name,
+                                  __attribute__((unused)) plugin_flush_cb cb,
+                                  __attribute__((unused))
+                                  user_data_t const *ud) {
+  return 0;
+}
+
+int plugin_thread_create_wh_test(pthread_t *thread,
+                                 void *(*start_routine)(void *), void *arg,
+                                 __attribute__((unused)) char const *name) {
+  return pthread_create(thread, NULL, start_routine, arg);
+}
+/* end mock functions */
+
+/* Reads one request and returns its body in "body", or returns non-zero when
+ * the client closed the connection. */
+static int read_request(int fd, char *buffer, size_t buffer_size,
+                        char **body, size_t *body_len) {
+  size_t len = 0;
+  char *end = NULL;
+
+  while (end == NULL) {
+    if (len >= buffer_size - 1)
+      return -1;
+    ssize_t status = recv(fd, buffer + len, buffer_size - 1 - len, 0);
+    if (status <= 0)
+      return -1;
+    len += (size_t)status;
+    buffer[len] = 0;
+    end = strstr(buffer, "\r\n\r\n");
+  }
+
+  size_t content_length = 0;
+  for (char *ptr = buffer; (ptr != NULL) && (ptr < end);
+       ptr = strstr(ptr, "\r\n")) {
+    if (*ptr == '\r')
+      ptr += 2;
+    if (strncasecmp("Content-Length:", ptr, strlen("Content-Length:")) == 0)
+      content_length = (size_t)atol(ptr + strlen("Content-Length:"));
+  }
+
+  *body = end + strlen("\r\n\r\n");
+  size_t need = (size_t)(*body - buffer) + content_length;
+  if (need >= buffer_size)
+    return -1;
+  while (len < need) {
+    ssize_t status = recv(fd, buffer + len, need - len, 0);
+    if (status <= 0)
+      return -1;
+    len += (size_t)status;
+  }
+
+  *body_len = content_length;
+  return 0;
+}
+
+static void *connection_thread(void *arg) {
+  int fd = (int)(intptr_t)arg;
+  static char const response[] = "HTTP/1.1 200 OK\r\n"
+                                 "Content-Length: 0\r\n"
+                                 "\r\n";
+  char *buffer = malloc(65536);
+
+  char *body;
+  size_t body_len;
+  while ((buffer != NULL) &&
+         (read_request(fd, buffer, 65536, &body, &body_len) == 0)) {
+    pthread_mutex_lock(&received_lock);
+    if (received_len + body_len < sizeof(received)) {
+      memcpy(received + received_len, body, body_len);
+      received_len += body_len;
+      received[received_len] = 0;
+    }
+    requests_num++;
+    concurrent++;
+    if (concurrent_max < concurrent)
+      concurrent_max = concurrent;
+    pthread_mutex_unlock(&received_lock);
+
+    usleep(response_delay_us);
+
+    pthread_mutex_lock(&received_lock);
+    concurrent--;
+    pthread_mutex_unlock(&received_lock);
+
+    if (send(fd, response, strlen(response), MSG_NOSIGNAL) < 0)
+      break;
+  }
+
+  free(buffer);
+  close(fd);
+  return NULL;
+}
+
+static void *accept_thread(__attribute__((unused)) void *arg) {
+  while (true) {
+    int fd = accept(server_fd, NULL, NULL);
+    if (fd < 0)
+      break;
+
+    if ((connection_threads_num >= TEST_MAX_CONNECTIONS) ||
+        (pthread_create(connection_threads + connection_threads_num, NULL,
+                        connection_thread, (void *)(intptr_t)fd) != 0)) {
+      close(fd);
+      continue;
+    }
+    connection_threads_num++;
+  }
+  return NULL;
+}
+
+static int server_start(void) {
+  server_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (server_fd < 0)
+    return -1;
+
+  struct sockaddr_in sa = {
+      .sin_family = AF_INET,
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  socklen_t sa_len = sizeof(sa);
+  if ((bind(server_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) ||
+      (getsockname(server_fd, (struct sockaddr *)&sa, &sa_len) != 0) ||
+      (listen(server_fd, TEST_MAX_CONNECTIONS) != 0))
+    return -1;
+
+  snprintf(server_url, sizeof(server_url), "http://127.0.0.1:%d/",
+           (int)ntohs(sa.sin_port));
+  return pthread_create(&server_thread, NULL, accept_thread, NULL);
+}
+
+/* Closes the listening socket and waits for the clients to disconnect. */
+static void server_stop(void) {
+  shutdown(server_fd, SHUT_RDWR);
+  close(server_fd);
+  pthread_join(server_thread, NULL);
+  for (size_t i = 0; i < connection_threads_num; i++)
+    pthread_join(connection_threads[i], NULL);
+  connection_threads_num = 0;
+}
+
+static void server_reset(void) {
+  pthread_mutex_lock(&received_lock);
+  received[0] = 0;
+  received_len = 0;
+  requests_num = 0;
+  concurrent_max = 0;
+  pthread_mutex_unlock(&received_lock);
+}
+
+static oconfig_value_t string(char *s) {
+  return (oconfig_value_t){.value.string = s, .type = OCONFIG_TYPE_STRING};
+}
+
+static oconfig_value_t number(double n) {
+  return (oconfig_value_t){.value.number = n, .type = OCONFIG_TYPE_NUMBER};
+}
+
+/* Configures a node posting to the test server and returns its callback. */
+static wh_callback_t *configure(char *format, int max_in_flight) {
+  oconfig_value_t name = string("test");
+  oconfig_value_t url = string(server_url);
+  oconfig_value_t fmt = string(format);
+  oconfig_value_t buffer_size = number(1024);
+  oconfig_value_t in_flight = number(max_in_flight);
+
+  oconfig_item_t children[] = {
+      {.key = "URL", .values = &url, .values_num = 1},
+      {.key = "Format", .values = &fmt, .values_num = 1},
+      {.key = "BufferSize", .values = &buffer_size, .values_num = 1},
+      {.key = "MaxInFlight", .values = &in_flight, .values_num = 1},
+  };
+  oconfig_item_t ci = {
+      .key = "Node",
+      .values = &name,
+      .values_num = 1,
+      .children = children,
+      .children_num = STATIC_ARRAY_SIZE(children),
+  };
+
+  memset(&registered, 0, sizeof(registered));
+  if (wh_config_node(&ci) != 0)
+    return NULL;
+  return registered.data;
+}
+
+static int write_value(wh_callback_t *cb, int i) {
+  value_list_t vl = {
+      .values = &(value_t){.derive = i},
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T(1),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "MAGIC",
+  };
+  snprintf(vl.type_instance, sizeof(vl.type_instance), "%d", i);
+
+  return wh_write(plugin_get_ds("MAGIC"), &vl, &(user_data_t){.data = cb});
+}
+
+DEF_TEST(concurrent_posts) {
+  server_reset();
+  response_delay_us = 200000;
+
+  wh_callback_t *cb = configure("Command", /* max_in_flight = */ 3);
+  CHECK_NOT_NULL(cb);
+
+  /* About 20 commands fit into the 1 kB buffer. */
+  int values_num = 200;
+  for (int i = 0; i < values_num; i++)
+    CHECK_ZERO(write_value(cb, i));
+
+  /* Posts the rest and waits for the requests in flight. */
+  wh_callback_free(cb);
+
+  pthread_mutex_lock(&received_lock);
+  OK(requests_num > 3);
+  OK(concurrent_max > 1);
+  OK(concurrent_max <= 3);
+
+  /* Every value list has been posted exactly once. */
+  int posted_once = 0;
+  for (int i = 0; i < values_num; i++) {
+    char needle[128];
+    snprintf(needle, sizeof(needle), "PUTVAL example.com/test/MAGIC-%d ", i);
+    char *found = strstr(received, needle);
+    if ((found != NULL) && (strstr(found + 1, needle) == NULL))
+      posted_once++;
+  }
+  EXPECT_EQ_INT(values_num, posted_once);
+  pthread_mutex_unlock(&received_lock);
+
+  return 0;
+}
+
+DEF_TEST(json) {
+  server_reset();
+  response_delay_us = 0;
+
+  wh_callback_t *cb = configure("JSON", /* max_in_flight = */ 1);
+  CHECK_NOT_NULL(cb);
+
+  CHECK_ZERO(write_value(cb, 42));
+  CHECK_ZERO(wh_flush(/* timeout = */ 0, /* identifier = */ NULL,
+                      &(user_data_t){.data = cb}));
+  wh_callback_free(cb);
+
+  pthread_mutex_lock(&received_lock);
+  EXPECT_EQ_UINT64(1, requests_num);
+  OK((received_len > 0) && (received[0] == '['));
+  OK((received_len > 0) && (received[received_len - 1] == ']'));
+  OK(strstr(received, "\"type_instance\":\"42\"") != NULL);
+  pthread_mutex_unlock(&received_lock);
+
+  return 0;
+}
+
+int main(void) {
+  if ((wh_init() != 0) || (server_start() != 0))
+    return 1;
+
+  RUN_TEST(concurrent_posts);
+  RUN_TEST(json);
+
+  server_stop();
+  curl_global_cleanup();
+  END_TEST;
+}
@@ -31,12 +31,21 @@
 #include "utils/common/common.h"
 #include "utils/format_graphite/format_graphite.h"
 #include "utils/format_json/format_json.h"
+#include "utils/strbuf/strbuf.h"
 #include "utils_random.h"
 
 #include <errno.h>
 #include <librdkafka/rdkafka.h>
 #include <stdint.h>
 
+/* 31 bit -> 4 byte -> 8 byte hex string + null byte */
+#define KAFKA_RANDOM_KEY_SIZE 9
+#define KAFKA_RANDOM_KEY_BUFFER                                                \
+  (char[KAFKA_RANDOM_KEY_SIZE]) { "" }
+
+/* Space reserved for a single PUTVAL command. */
+#define KAFKA_PUTVAL_SIZE 8192
+
 struct kafka_topic_context {
 #define KAFKA_FORMAT_JSON 0
 #define KAFKA_FORMAT_COMMAND 1
@@ -53,6 +62,27 @@ struct kafka_topic_context {
   char *postfix;
   char escape_char;
   char *topic_name;
+
+  /* Number of value lists packed into one message. */
+  size_t pack_values;
+  /* Number of messages handed to rd_kafka_produce_batch() at once. */
+  size_t batch_size;
+
+  /* The message currently being filled. Its memory is handed over to
+   * librdkafka (RD_KAFKA_MSG_F_FREE) once the message is complete. */
+  strbuf_t message;
+  size_t message_values;
+  /* Size of the previous message, used to allocate the next one. */
+  size_t message_size_hint;
+
+  rd_kafka_message_t *batch;
+  char (*batch_keys)[KAFKA_RANDOM_KEY_SIZE];
+  size_t batch_num;
+
+  /* Time the oldest value list not yet handed to librdkafka was added. */
+  cdtime_t pending_since;
+
+  /* Protects the handles, the message and the batch. */
   pthread_mutex_t lock;
 };
 
@@ -92,10 +122,6 @@ static uint32_t kafka_hash(const char *keydata, size_t keylen) {
   return hash;
 }
 
-/* 31 bit -> 4 byte -> 8 byte hex string + null byte */
-#define KAFKA_RANDOM_KEY_SIZE 9
-#define KAFKA_RANDOM_KEY_BUFFER                                                \
-  (char[KAFKA_RANDOM_KEY_SIZE]) { "" }
 static char *kafka_random_key(char buffer[static KAFKA_RANDOM_KEY_SIZE]) {
   ssnprintf(buffer, KAFKA_RANDOM_KEY_SIZE, "%08" PRIX32, cdrand_u());
   return buffer;
@@ -170,70 +196,229 @@ static int kafka_handle(struct kafka_topic_context *ctx) /* {{{ */
 
 } /* }}} int kafka_handle */
 
-static int kafka_write(const data_set_t *ds, /* {{{ */
-                       const value_list_t *vl, user_data_t *ud) {
+/* kafka_produce_nolock hands all queued messages to librdkafka.
+ * must hold ctx->lock when calling */
+static int kafka_produce_nolock(struct kafka_topic_context *ctx) /* {{{ */
+{
+  if (ctx->batch_num == 0)
+    return 0;
+
+  int sent = rd_kafka_produce_batch(ctx->topic, RD_KAFKA_PARTITION_UA,
+                                    RD_KAFKA_MSG_F_FREE, ctx->batch,
+                                    (int)ctx->batch_num);
+
   int status = 0;
-  void *key;
-  size_t keylen = 0;
-  char buffer[8192];
-  size_t bfree = sizeof(buffer);
-  size_t bfill = 0;
-  size_t blen = 0;
-  struct kafka_topic_context *ctx = ud->data;
+  if (sent < (int)ctx->batch_num) {
+    rd_kafka_resp_err_t err = RD_KAFKA_RESP_ERR_NO_ERROR;
 
-  if ((ds == NULL) || (vl == NULL) || (ctx == NULL))
-    return EINVAL;
+    /* librdkafka only takes ownership of messages it accepted. */
+    for (size_t i = 0; i < ctx->batch_num; i++) {
+      if (ctx->batch[i].err == RD_KAFKA_RESP_ERR_NO_ERROR)
+        continue;
+      err = ctx->batch[i].err;
+      free(ctx->batch[i].payload);
+    }
 
-  pthread_mutex_lock(&ctx->lock);
-  status = kafka_handle(ctx);
-  pthread_mutex_unlock(&ctx->lock);
-  if (status != 0)
-    return status;
+    ERROR("write_kafka plugin: rd_kafka_produce_batch failed for %d of "
+          "%" PRIsz " messages: %s",
+          (int)ctx->batch_num - ((sent < 0) ? 0 : sent), ctx->batch_num,
+          rd_kafka_err2str(err));
+    status = -1;
+  }
+
+  ctx->batch_num = 0;
+  return status;
+} /* }}} int kafka_produce_nolock */
+
+/* kafka_finish_message_nolock moves the current message to the batch and
+ * produces the batch once it is full.
+ * must hold ctx->lock when calling */
+static int
+kafka_finish_message_nolock(struct kafka_topic_context *ctx) /* {{{ */
+{
+  if (ctx->message_values == 0)
+    return 0;
+
+  if (ctx->format == KAFKA_FORMAT_JSON) {
+    int status = format_json_finalize_strbuf(&ctx->message);
+    if (status != 0) {
+      ERROR("write_kafka plugin: format_json_finalize failed with status %i.",
+            status);
+      STRBUF_DESTROY(&ctx->message);
+      ctx->message_values = 0;
+      return status;
+    }
+  }
+
+  char *key = ctx->key;
+  if (key == NULL)
+    key = kafka_random_key(ctx->batch_keys[ctx->batch_num]);
+
+  ctx->batch[ctx->batch_num] = (rd_kafka_message_t){
+      .payload = ctx->message.ptr,
+      .len = ctx->message.pos,
+      .key = key,
+      .key_len = strlen(key),
+  };
+  ctx->batch_num++;
+
+  /* The memory now belongs to the batch. */
+  ctx->message_size_hint = ctx->message.size;
+  ctx->message = (strbuf_t){.ptr = NULL};
+  ctx->message_values = 0;
+
+  if (ctx->batch_num < ctx->batch_size)
+    return 0;
 
-  bzero(buffer, sizeof(buffer));
+  return kafka_produce_nolock(ctx);
+} /* }}} int kafka_finish_message_nolock */
+
+/* kafka_format formats "vl" into "buf". Only the configuration of "ctx" is
+ * read, so this is called without holding ctx->lock. */
+static int kafka_format(struct kafka_topic_context const *ctx, /* {{{ */
+                        strbuf_t *buf, const data_set_t *ds,
+                        const value_list_t *vl) {
+  int status;
 
   switch (ctx->format) {
   case KAFKA_FORMAT_COMMAND:
-    status = cmd_create_putval(buffer, sizeof(buffer), ds, vl);
+    status = strbuf_resize(buf, KAFKA_PUTVAL_SIZE);
+    if (status != 0)
+      return status;
+
+    status = cmd_create_putval(buf->ptr, KAFKA_PUTVAL_SIZE, ds, vl);
     if (status != 0) {
       ERROR("write_kafka plugin: cmd_create_putval failed with status %i.",
             status);
       return status;
     }
-    blen = strlen(buffer);
+    buf->pos = strlen(buf->ptr);
     break;
   case KAFKA_FORMAT_JSON:
-    format_json_initialize(buffer, &bfill, &bfree);
-    format_json_value_list(buffer, &bfill, &bfree, ds, vl, ctx->store_rates);
-    format_json_finalize(buffer, &bfill, &bfree);
-    blen = strlen(buffer);
+    status = format_json_value_list_strbuf(buf, ds, vl, ctx->store_rates,
+                                           /* cache = */ NULL);
+    if (status != 0) {
+      ERROR("write_kafka plugin: format_json_value_list failed with status "
+            "%i.",
+            status);
+      return status;
+    }
     break;
   case KAFKA_FORMAT_GRAPHITE:
-    status =
-        format_graphite(buffer, sizeof(buffer), ds, vl, ctx->prefix,
-                        ctx->postfix, ctx->escape_char, ctx->graphite_flags);
+    status = format_graphite_strbuf(buf, ds, vl, ctx->prefix, ctx->postfix,
+                                    ctx->escape_char, ctx->graphite_flags,
+                                    /* cache = */ NULL);
     if (status != 0) {
       ERROR("write_kafka plugin: format_graphite failed with status %i.",
             status);
       return status;
     }
-    blen = strlen(buffer);
     break;
   default:
     ERROR("write_kafka plugin: invalid format %i.", ctx->format);
     return -1;
   }
 
-  key =
-      (ctx->key != NULL) ? ctx->key : kafka_random_key(KAFKA_RANDOM_KEY_BUFFER);
-  keylen = strlen(key);
+  return 0;
+} /* }}} int kafka_format */
+
+/* kafka_append_nolock appends a value list formatted by kafka_format() to the
+ * current message. The memory of "buf" may be taken over.
+ * must hold ctx->lock when calling */
+static int kafka_append_nolock(struct kafka_topic_context *ctx, /* {{{ */
+                               strbuf_t *buf) {
+  if ((ctx->message_values == 0) && (ctx->batch_num == 0))
+    ctx->pending_since = cdtime();
+
+  if (ctx->message_values == 0) {
+    /* Start a new message with the formatted value list. When packing value
+     * lists, reserve the size of the previous message to avoid
+     * re-allocations. */
+    STRBUF_DESTROY(&ctx->message);
+    ctx->message = *buf;
+    *buf = (strbuf_t){.ptr = NULL};
+
+    if ((ctx->pack_values > 1) &&
+        (ctx->message_size_hint > ctx->message.pos + 1))
+      strbuf_resize(&ctx->message,
+                    ctx->message_size_hint - ctx->message.pos - 1);
+
+    ctx->message_values++;
+    return 0;
+  }
+
+  size_t orig_pos = ctx->message.pos;
+  int status = 0;
+  if (ctx->format == KAFKA_FORMAT_COMMAND)
+    status = strbuf_print(&ctx->message, "\n");
+  if (status == 0)
+    status = strbuf_printn(&ctx->message, buf->ptr, buf->pos);
+  if (status != 0) {
+    strbuf_truncate(&ctx->message, orig_pos);
+    return status;
+  }
+
+  ctx->message_values++;
+  return 0;
+} /* }}} int kafka_append_nolock */
+
+static int kafka_write(const data_set_t *ds, /* {{{ */
+                       const value_list_t *vl, user_data_t *ud) {
+  struct kafka_topic_context *ctx = ud->data;
+
+  if ((ds == NULL) || (vl == NULL) || (ctx == NULL))
+    return EINVAL;
 
-  rd_kafka_produce(ctx->topic, RD_KAFKA_PARTITION_UA, RD_KAFKA_MSG_F_COPY,
-                   buffer, blen, key, keylen, NULL);
+  /* Format outside of the lock, so that write threads only serialize on
+   * copying the result into the message. */
+  strbuf_t buf = {.ptr = NULL};
+  int status = kafka_format(ctx, &buf, ds, vl);
+  if (status != 0) {
+    STRBUF_DESTROY(&buf);
+    return status;
+  }
+
+  pthread_mutex_lock(&ctx->lock);
+  status = kafka_handle(ctx);
+  if (status == 0)
+    status = kafka_append_nolock(ctx, &buf);
+  if ((status == 0) && (ctx->message_values >= ctx->pack_values))
+    status = kafka_finish_message_nolock(ctx);
+  pthread_mutex_unlock(&ctx->lock);
 
+  STRBUF_DESTROY(&buf);
   return status;
 } /* }}} int kafka_write */
 
+static int kafka_flush(cdtime_t timeout, /* {{{ */
+                       const char *identifier __attribute__((unused)),
+                       user_data_t *ud) {
+  struct kafka_topic_context *ctx = ud->data;
+
+  pthread_mutex_lock(&ctx->lock);
+
+  /* timeout == 0  => flush unconditionally */
+  if ((timeout > 0) && ((ctx->pending_since + timeout) > cdtime())) {
+    pthread_mutex_unlock(&ctx->lock);
+    return 0;
+  }
+
+  int status = 0;
+  if ((ctx->message_values > 0) || (ctx->batch_num > 0)) {
+    status = kafka_handle(ctx);
+    if (status == 0) {
+      /* Finishing the message produces the batch if it is full, in which
+       * case kafka_produce_nolock() has nothing left to do. */
+      status = kafka_finish_message_nolock(ctx);
+      if (status == 0)
+        status = kafka_produce_nolock(ctx);
+    }
+  }
+
+  pthread_mutex_unlock(&ctx->lock);
+  return status;
+} /* }}} int kafka_flush */
+
 static void kafka_topic_context_free(void *p) /* {{{ */
 {
   struct kafka_topic_context *ctx = p;
@@ -241,6 +426,16 @@ static void kafka_topic_context_free(void *p) /* {{{ */
   if (ctx == NULL)
     return;
 
+  if (ctx->topic != NULL) {
+    kafka_finish_message_nolock(ctx);
+    kafka_produce_nolock(ctx);
+  }
+  for (size_t i = 0; i < ctx->batch_num; i++)
+    free(ctx->batch[i].payload);
+  sfree(ctx->batch);
+  sfree(ctx->batch_keys);
+  STRBUF_DESTROY(&ctx->message);
+
   if (ctx->topic_name != NULL)
     sfree(ctx->topic_name);
   if (ctx->topic != NULL)
@@ -276,6 +471,8 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
   tctx->store_rates = true;
   tctx->format = KAFKA_FORMAT_JSON;
   tctx->key = NULL;
+  tctx->pack_values = 1;
+  tctx->batch_size = 1;
 
   if ((tctx->kafka_conf = rd_kafka_conf_dup(conf)) == NULL) {
     sfree(tctx);
@@ -399,6 +596,24 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
                 "only one character. Others will be ignored.");
       tctx->escape_char = tmp_buff[0];
       sfree(tmp_buff);
+    } else if (strcasecmp("PackValues", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if ((status == 0) && (tmp < 1)) {
+        ERROR("write_kafka plugin: PackValues must be positive.");
+        status = -1;
+      }
+      if (status == 0)
+        tctx->pack_values = (size_t)tmp;
+    } else if (strcasecmp("BatchSize", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if ((status == 0) && (tmp < 1)) {
+        ERROR("write_kafka plugin: BatchSize must be positive.");
+        status = -1;
+      }
+      if (status == 0)
+        tctx->batch_size = (size_t)tmp;
     } else {
       WARNING("write_kafka plugin: Invalid directive: %s.", child->key);
     }
@@ -407,12 +622,21 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
       break;
   }
 
+  tctx->batch = calloc(tctx->batch_size, sizeof(*tctx->batch));
+  tctx->batch_keys = calloc(tctx->batch_size, sizeof(*tctx->batch_keys));
+  if ((tctx->batch == NULL) || (tctx->batch_keys == NULL)) {
+    ERROR("write_kafka plugin: calloc failed.");
+    goto errout;
+  }
+
   rd_kafka_topic_conf_set_partitioner_cb(tctx->conf, kafka_partition);
   rd_kafka_topic_conf_set_opaque(tctx->conf, tctx);
 
   ssnprintf(callback_name, sizeof(callback_name), "write_kafka/%s",
             tctx->topic_name);
 
+  pthread_mutex_init(&tctx->lock, /* attr = */ NULL);
+
   status = plugin_register_write(callback_name, kafka_write,
                                  &(user_data_t){
                                      .data = tctx,
@@ -422,10 +646,12 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
     WARNING("write_kafka plugin: plugin_register_write (\"%s\") "
             "failed with status %i.",
             callback_name, status);
+    pthread_mutex_destroy(&tctx->lock);
     goto errout;
   }
 
-  pthread_mutex_init(&tctx->lock, /* attr = */ NULL);
+  plugin_register_flush(callback_name, kafka_flush,
+                        &(user_data_t){.data = tctx});
 
   return;
 errout:
@@ -435,6 +661,8 @@ errout:
     rd_kafka_topic_conf_destroy(tctx->conf);
   if (tctx->kafka_conf != NULL)
     rd_kafka_conf_destroy(tctx->kafka_conf);
+  sfree(tctx->batch);
+  sfree(tctx->batch_keys);
   sfree(tctx);
 } /* }}} int kafka_config_topic */
 
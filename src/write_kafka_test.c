@@ -0,0 +1,229 @@
+/**
+ * collectd - src/write_kafka_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#define rd_kafka_produce_batch rd_kafka_produce_batch_kafka_test
+#define rd_kafka_topic_destroy rd_kafka_topic_destroy_kafka_test
+#define rd_kafka_destroy rd_kafka_destroy_kafka_test
+
+/* testing.h has to be included first for the declaration of cdtime_mock. */
+#include "testing.h"
+
+#include "write_kafka.c" /* sic */
+
+typedef struct {
+  char payload[1024];
+  char key[KAFKA_RANDOM_KEY_SIZE];
+} produced_t;
+
+static produced_t produced[16];
+static size_t produced_num;
+static size_t batches_num;
+/* If true, the last message of the next batch is rejected. */
+static bool reject_next;
+
+/* mock functions */
+int rd_kafka_produce_batch_kafka_test(
+    __attribute__((unused)) rd_kafka_topic_t *rkt,
+    __attribute__((unused)) int32_t partition, int msgflags,
+    rd_kafka_message_t *rkmessages, int message_cnt) {
+  if (msgflags != RD_KAFKA_MSG_F_FREE)
+    return -1;
+
+  int accepted = message_cnt;
+  if (reject_next) {
+    accepted--;
+    rkmessages[accepted].err = RD_KAFKA_RESP_ERR__QUEUE_FULL;
+    reject_next = false;
+  }
+
+  for (int i = 0; i < accepted; i++) {
+    if (produced_num < STATIC_ARRAY_SIZE(produced)) {
+      produced_t *p = produced + produced_num;
+      snprintf(p->payload, sizeof(p->payload), "%.*s", (int)rkmessages[i].len,
+               (char *)rkmessages[i].payload);
+      snprintf(p->key, sizeof(p->key), "%.*s", (int)rkmessages[i].key_len,
+               (char *)rkmessages[i].key);
+      produced_num++;
+    }
+    /* librdkafka owns the accepted messages. */
+    free(rkmessages[i].payload);
+  }
+
+  batches_num++;
+  return accepted;
+}
+
+void rd_kafka_topic_destroy_kafka_test(
+    __attribute__((unused)) rd_kafka_topic_t *rkt) { /* nop */
+}
+
+void rd_kafka_destroy_kafka_test(__attribute__((unused)) rd_kafka_t *rk) {
+  /* nop */
+}
+/* end mock functions */
+
+/* Returns a context with fake handles, so that kafka_handle() succeeds. */
+static struct kafka_topic_context *new_context(uint8_t format,
+                                               size_t pack_values,
+                                               size_t batch_size) {
+  static char handle;
+
+  struct kafka_topic_context *ctx = calloc(1, sizeof(*ctx));
+  if (ctx == NULL)
+    return NULL;
+
+  ctx->format = format;
+  ctx->key = "key";
+  ctx->kafka = (rd_kafka_t *)&handle;
+  ctx->topic = (rd_kafka_topic_t *)&handle;
+  ctx->pack_values = pack_values;
+  ctx->batch_size = batch_size;
+  ctx->batch = calloc(batch_size, sizeof(*ctx->batch));
+  ctx->batch_keys = calloc(batch_size, sizeof(*ctx->batch_keys));
+  pthread_mutex_init(&ctx->lock, /* attr = */ NULL);
+
+  produced_num = 0;
+  batches_num = 0;
+  return ctx;
+}
+
+static int write_value(struct kafka_topic_context *ctx, derive_t value) {
+  value_list_t vl = {
+      .values = &(value_t){.derive = value},
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T(1),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "MAGIC",
+  };
+
+  return kafka_write(plugin_get_ds("MAGIC"), &vl, &(user_data_t){.data = ctx});
+}
+
+static int flush(struct kafka_topic_context *ctx, cdtime_t timeout) {
+  return kafka_flush(timeout, /* identifier = */ NULL,
+                     &(user_data_t){.data = ctx});
+}
+
+DEF_TEST(pack_and_batch) {
+  struct kafka_topic_context *ctx =
+      new_context(KAFKA_FORMAT_COMMAND, /* pack_values = */ 2,
+                  /* batch_size = */ 2);
+  CHECK_NOT_NULL(ctx);
+
+  /* Two messages of two value lists each fill a batch. */
+  for (derive_t i = 0; i < 3; i++)
+    CHECK_ZERO(write_value(ctx, i));
+  EXPECT_EQ_UINT64(0, batches_num);
+
+  CHECK_ZERO(write_value(ctx, 3));
+  EXPECT_EQ_UINT64(1, batches_num);
+  EXPECT_EQ_UINT64(2, produced_num);
+  EXPECT_EQ_STR("PUTVAL example.com/test/MAGIC interval=10.000 1.000:0\n"
+                "PUTVAL example.com/test/MAGIC interval=10.000 1.000:1",
+                produced[0].payload);
+  EXPECT_EQ_STR("PUTVAL example.com/test/MAGIC interval=10.000 1.000:2\n"
+                "PUTVAL example.com/test/MAGIC interval=10.000 1.000:3",
+                produced[1].payload);
+  EXPECT_EQ_STR("key", produced[0].key);
+
+  /* Incomplete messages are only sent when they are old enough. */
+  CHECK_ZERO(write_value(ctx, 4));
+  CHECK_ZERO(flush(ctx, TIME_T_TO_CDTIME_T(10)));
+  EXPECT_EQ_UINT64(1, batches_num);
+
+  cdtime_mock += TIME_T_TO_CDTIME_T(10);
+  CHECK_ZERO(flush(ctx, TIME_T_TO_CDTIME_T(10)));
+  EXPECT_EQ_UINT64(2, batches_num);
+  EXPECT_EQ_UINT64(3, produced_num);
+  EXPECT_EQ_STR("PUTVAL example.com/test/MAGIC interval=10.000 1.000:4",
+                produced[2].payload);
+
+  /* Nothing is pending. */
+  CHECK_ZERO(flush(ctx, 0));
+  EXPECT_EQ_UINT64(2, batches_num);
+
+  /* Pending value lists are sent when the plugin shuts down. */
+  CHECK_ZERO(write_value(ctx, 5));
+  kafka_topic_context_free(ctx);
+  EXPECT_EQ_UINT64(3, batches_num);
+  EXPECT_EQ_UINT64(4, produced_num);
+  return 0;
+}
+
+DEF_TEST(json) {
+  struct kafka_topic_context *ctx = new_context(
+      KAFKA_FORMAT_JSON, /* pack_values = */ 3, /* batch_size = */ 1);
+  CHECK_NOT_NULL(ctx);
+
+  for (derive_t i = 0; i < 3; i++)
+    CHECK_ZERO(write_value(ctx, i));
+  EXPECT_EQ_UINT64(1, produced_num);
+
+  /* The packed value lists form one JSON array. */
+  char const *payload = produced[0].payload;
+  OK(strncmp("[{\"values\":[0]", payload, strlen("[{\"values\":[0]")) == 0);
+  OK(strstr(payload, "},{\"values\":[1]") != NULL);
+  OK(strstr(payload, "},{\"values\":[2]") != NULL);
+  EXPECT_EQ_INT('}', payload[strlen(payload) - 2]);
+  EXPECT_EQ_INT(']', payload[strlen(payload) - 1]);
+
+  kafka_topic_context_free(ctx);
+  EXPECT_EQ_UINT64(1, batches_num);
+  return 0;
+}
+
+DEF_TEST(rejected) {
+  struct kafka_topic_context *ctx =
+      new_context(KAFKA_FORMAT_COMMAND, /* pack_values = */ 1,
+                  /* batch_size = */ 2);
+  CHECK_NOT_NULL(ctx);
+
+  /* The rejected message is freed by the plugin. */
+  reject_next = true;
+  CHECK_ZERO(write_value(ctx, 0));
+  EXPECT_EQ_INT(-1, write_value(ctx, 1));
+  EXPECT_EQ_UINT64(1, produced_num);
+
+  /* The batch is usable afterwards. */
+  CHECK_ZERO(write_value(ctx, 2));
+  CHECK_ZERO(write_value(ctx, 3));
+  EXPECT_EQ_UINT64(3, produced_num);
+  EXPECT_EQ_STR("PUTVAL example.com/test/MAGIC interval=10.000 1.000:3",
+                produced[2].payload);
+
+  kafka_topic_context_free(ctx);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(pack_and_batch);
+  RUN_TEST(json);
+  RUN_TEST(rejected);
+
+  END_TEST;
+}
@@ -27,7 +27,10 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/strbuf/strbuf.h"
+#include "utils_cache.h"
 
 #include <hiredis/hiredis.h>
 #include <sys/time.h>
@@ -36,6 +39,15 @@
 #define REDIS_DEFAULT_PREFIX "collectd/"
 #endif
 
+/* Space reserved in front of the TS.MADD arguments for the command header,
+ * i.e. "*<argc>\r\n$7\r\nTS.MADD\r\n". */
+#define WR_MADD_HEADER_SIZE 48
+
+/* Number of keys remembered per connection. Once exceeded, the keys are
+ * forgotten, so that they are added to the "values" set or created as time
+ * series once more, which is harmless. */
+#define WR_KNOWN_KEYS_MAX 100000
+
 struct wr_node_s {
   char name[DATA_MAX_NAME_LEN];
 
@@ -47,8 +59,24 @@ struct wr_node_s {
   int max_set_size;
   int max_set_duration;
   bool store_rates;
+  int batch_size;
+  bool use_multi;
+  bool use_timeseries;
 
   redisContext *conn;
+  /* Keys that have been added to the "values" set, or created as time
+   * series, since connecting. */
+  c_avl_tree_t *known_keys;
+
+  /* Number of replies to read, and value lists in the current batch. */
+  size_t pending_commands;
+  size_t pending_values;
+  cdtime_t pending_since;
+
+  /* RESP encoded arguments of the TS.MADD command being built. */
+  strbuf_t madd;
+  size_t madd_args;
+
   pthread_mutex_t lock;
 };
 typedef struct wr_node_s wr_node_t;
@@ -56,108 +84,453 @@ typedef struct wr_node_s wr_node_t;
 /*
  * Functions
  */
-static int wr_write(const data_set_t *ds, /* {{{ */
-                    const value_list_t *vl, user_data_t *ud) {
-  wr_node_t *node = ud->data;
-  char ident[512];
-  char key[512];
-  char value[512] = {0};
-  char time[24];
-  size_t value_size;
-  char *value_ptr;
-  int status;
-  redisReply *rr;
+static void wr_known_keys_clear(wr_node_t *node) /* {{{ */
+{
+  void *key;
+  void *value;
 
-  status = FORMAT_VL(ident, sizeof(ident), vl);
-  if (status != 0)
-    return status;
-  ssnprintf(key, sizeof(key), "%s%s",
-            (node->prefix != NULL) ? node->prefix : REDIS_DEFAULT_PREFIX,
-            ident);
-  ssnprintf(time, sizeof(time), "%.9f", CDTIME_T_TO_DOUBLE(vl->time));
+  if (node->known_keys == NULL)
+    return;
 
-  value_size = sizeof(value);
-  value_ptr = &value[0];
-  status = format_values(value_ptr, value_size, ds, vl, node->store_rates);
-  if (status != 0)
-    return status;
+  while (c_avl_pick(node->known_keys, &key, &value) == 0)
+    sfree(key);
+} /* }}} void wr_known_keys_clear */
 
-  pthread_mutex_lock(&node->lock);
+/* wr_key_is_new returns true the first time it is called for "key". */
+static bool wr_key_is_new(wr_node_t *node, const char *key) /* {{{ */
+{
+  if (c_avl_get(node->known_keys, key, NULL) == 0)
+    return false;
+
+  if (c_avl_size(node->known_keys) >= WR_KNOWN_KEYS_MAX)
+    wr_known_keys_clear(node);
+
+  char *key_copy = strdup(key);
+  if (key_copy == NULL)
+    return true;
+
+  if (c_avl_insert(node->known_keys, key_copy, NULL) != 0)
+    sfree(key_copy);
+
+  return true;
+} /* }}} bool wr_key_is_new */
+
+static void wr_disconnect(wr_node_t *node) /* {{{ */
+{
+  if (node->conn != NULL) {
+    redisFree(node->conn);
+    node->conn = NULL;
+  }
+
+  wr_known_keys_clear(node);
+  node->pending_commands = 0;
+  node->pending_values = 0;
+  node->madd_args = 0;
+  strbuf_reset(&node->madd);
+} /* }}} void wr_disconnect */
 
+static int wr_connect(wr_node_t *node) /* {{{ */
+{
+  redisReply *rr;
+
+  if (node->conn != NULL)
+    return 0;
+
+  node->conn =
+      redisConnectWithTimeout((char *)node->host, node->port, node->timeout);
   if (node->conn == NULL) {
-    node->conn =
-        redisConnectWithTimeout((char *)node->host, node->port, node->timeout);
-    if (node->conn == NULL) {
-      ERROR("write_redis plugin: Connecting to host \"%s\" (port %i) failed: "
-            "Unknown reason",
-            (node->host != NULL) ? node->host : "localhost",
-            (node->port != 0) ? node->port : 6379);
-      pthread_mutex_unlock(&node->lock);
-      return -1;
-    } else if (node->conn->err) {
-      ERROR(
-          "write_redis plugin: Connecting to host \"%s\" (port %i) failed: %s",
+    ERROR("write_redis plugin: Connecting to host \"%s\" (port %i) failed: "
+          "Unknown reason",
+          (node->host != NULL) ? node->host : "localhost",
+          (node->port != 0) ? node->port : 6379);
+    return -1;
+  } else if (node->conn->err) {
+    ERROR("write_redis plugin: Connecting to host \"%s\" (port %i) failed: %s",
           (node->host != NULL) ? node->host : "localhost",
           (node->port != 0) ? node->port : 6379, node->conn->errstr);
-      pthread_mutex_unlock(&node->lock);
-      return -1;
-    }
-
-    rr = redisCommand(node->conn, "SELECT %d", node->database);
-    if (rr == NULL)
-      WARNING("SELECT command error. database:%d message:%s", node->database,
-              node->conn->errstr);
-    else
-      freeReplyObject(rr);
+    wr_disconnect(node);
+    return -1;
   }
 
-  rr = redisCommand(node->conn, "ZADD %s %s %s", key, time, value);
+  rr = redisCommand(node->conn, "SELECT %d", node->database);
   if (rr == NULL)
-    WARNING("ZADD command error. key:%s message:%s", key, node->conn->errstr);
+    WARNING("SELECT command error. database:%d message:%s", node->database,
+            node->conn->errstr);
   else
     freeReplyObject(rr);
 
-  if (node->max_set_size >= 0) {
-    rr = redisCommand(node->conn, "ZREMRANGEBYRANK %s %d %d", key, 0,
-                      (-1 * node->max_set_size) - 1);
-    if (rr == NULL)
-      WARNING("ZREMRANGEBYRANK command error. key:%s message:%s", key,
-              node->conn->errstr);
-    else
-      freeReplyObject(rr);
+  return 0;
+} /* }}} int wr_connect */
+
+/* wr_begin opens a transaction before the first command of a batch. */
+static int wr_begin(wr_node_t *node) /* {{{ */
+{
+  if (!node->use_multi || (node->pending_commands != 0))
+    return 0;
+
+  if (redisAppendCommand(node->conn, "MULTI") != REDIS_OK) {
+    ERROR("write_redis plugin: Queueing MULTI failed: %s",
+          node->conn->errstr);
+    return -1;
+  }
+  node->pending_commands++;
+  return 0;
+} /* }}} int wr_begin */
+
+/* wr_append adds a command to the pipeline. It is sent with the next call to
+ * wr_send. */
+static int wr_append(wr_node_t *node, const char *format, ...) /* {{{ */
+{
+  va_list ap;
+
+  if (wr_begin(node) != 0)
+    return -1;
+
+  va_start(ap, format);
+  int status = redisvAppendCommand(node->conn, format, ap);
+  va_end(ap);
+
+  if (status != REDIS_OK) {
+    ERROR("write_redis plugin: Queueing command \"%s\" failed: %s", format,
+          node->conn->errstr);
+    return -1;
   }
 
-  if (node->max_set_duration > 0) {
+  node->pending_commands++;
+  return 0;
+} /* }}} int wr_append */
+
+static void wr_check_reply(wr_node_t *node, redisReply *rr) /* {{{ */
+{
+  if (rr->type == REDIS_REPLY_ARRAY) {
+    for (size_t i = 0; i < rr->elements; i++)
+      wr_check_reply(node, rr->element[i]);
+    return;
+  }
+
+  if (rr->type != REDIS_REPLY_ERROR)
+    return;
+
+  /* TS.CREATE is sent for every key not seen since connecting. */
+  if (node->use_timeseries && (strstr(rr->str, "already exists") != NULL))
+    return;
+
+  WARNING("write_redis plugin: Node \"%s\": command error: %s", node->name,
+          rr->str);
+} /* }}} void wr_check_reply */
+
+/* wr_send sends all pending commands and reads their replies. */
+static int wr_send(wr_node_t *node) /* {{{ */
+{
+  if (node->conn == NULL)
+    return 0;
+
+  if (node->madd_args > 0) {
+    if (wr_begin(node) != 0) {
+      wr_disconnect(node);
+      return -1;
+    }
+
+    /* Write the header right in front of the arguments. */
+    char header[WR_MADD_HEADER_SIZE];
+    int len =
+        ssnprintf(header, sizeof(header), "*%" PRIsz "\r\n$7\r\nTS.MADD\r\n",
+                  node->madd_args + 1);
+    char *cmd = node->madd.ptr + WR_MADD_HEADER_SIZE - len;
+    memcpy(cmd, header, (size_t)len);
+
+    int status = redisAppendFormattedCommand(
+        node->conn, cmd, node->madd.pos - WR_MADD_HEADER_SIZE + (size_t)len);
+    node->madd_args = 0;
+    strbuf_reset(&node->madd);
+    if (status != REDIS_OK) {
+      ERROR("write_redis plugin: Queueing TS.MADD failed: %s",
+            node->conn->errstr);
+      wr_disconnect(node);
+      return -1;
+    }
+    node->pending_commands++;
+  }
+
+  if (node->pending_commands == 0)
+    return 0;
+
+  if (node->use_multi) {
+    if (redisAppendCommand(node->conn, "EXEC") != REDIS_OK) {
+      ERROR("write_redis plugin: Queueing EXEC failed: %s",
+            node->conn->errstr);
+      wr_disconnect(node);
+      return -1;
+    }
+    node->pending_commands++;
+  }
+
+  /* The first call to redisGetReply() writes the output buffer. */
+  while (node->pending_commands > 0) {
+    redisReply *rr = NULL;
+    if (redisGetReply(node->conn, (void **)&rr) != REDIS_OK) {
+      ERROR("write_redis plugin: Node \"%s\": %" PRIsz
+            " commands failed: %s",
+            node->name, node->pending_commands, node->conn->errstr);
+      wr_disconnect(node);
+      return -1;
+    }
+    node->pending_commands--;
+
+    wr_check_reply(node, rr);
+    freeReplyObject(rr);
+  }
+
+  node->pending_values = 0;
+  return 0;
+} /* }}} int wr_send */
+
+static int wr_resp_print_arg(strbuf_t *buf, const char *arg) /* {{{ */
+{
+  size_t len = strlen(arg);
+
+  int status = strbuf_printf(buf, "$%" PRIsz "\r\n", len);
+  if (status == 0)
+    status = strbuf_printn(buf, arg, len);
+  if (status == 0)
+    status = strbuf_print(buf, "\r\n");
+  return status;
+} /* }}} int wr_resp_print_arg */
+
+/* The wr_write_* functions return a negative value if queueing a command
+ * failed, leaving the pipeline in an unknown state, and a positive errno if
+ * only the value list itself could not be written. */
+static int wr_write_sorted_set(wr_node_t *node, /* {{{ */
+                               const data_set_t *ds, const value_list_t *vl,
+                               const char *ident, const char *key) {
+  char value[512] = {0};
+  char time[24];
+  int status;
+
+  ssnprintf(time, sizeof(time), "%.9f", CDTIME_T_TO_DOUBLE(vl->time));
+
+  status = format_values(value, sizeof(value), ds, vl, node->store_rates);
+  if (status != 0)
+    return EINVAL;
+
+  status = wr_append(node, "ZADD %s %s %s", key, time, value);
+
+  if ((status == 0) && (node->max_set_size >= 0))
+    status = wr_append(node, "ZREMRANGEBYRANK %s %d %d", key, 0,
+                       (-1 * node->max_set_size) - 1);
+
+  if ((status == 0) && (node->max_set_duration > 0)) {
     /*
      * remove element, scored less than 'current-max_set_duration'
      * '(...' indicates 'less than' in redis CLI.
      */
-    rr = redisCommand(node->conn, "ZREMRANGEBYSCORE %s -1 (%.9f", key,
-                      (CDTIME_T_TO_DOUBLE(vl->time) - node->max_set_duration));
-    if (rr == NULL)
-      WARNING("ZREMRANGEBYSCORE command error. key:%s message:%s", key,
-              node->conn->errstr);
+    status = wr_append(node, "ZREMRANGEBYSCORE %s -1 (%.9f", key,
+                       (CDTIME_T_TO_DOUBLE(vl->time) - node->max_set_duration));
+  }
+
+  /* The set of identifiers only needs to be updated for new metrics. */
+  if ((status == 0) && wr_key_is_new(node, key))
+    status = wr_append(
+        node, "SADD %svalues %s",
+        (node->prefix != NULL) ? node->prefix : REDIS_DEFAULT_PREFIX, ident);
+
+  return status;
+} /* }}} int wr_write_sorted_set */
+
+static int wr_create_time_series(wr_node_t *node, /* {{{ */
+                                 const value_list_t *vl, const char *key,
+                                 const char *ds_name) {
+  const char *argv[20];
+  size_t argv_len[20];
+  size_t argc = 0;
+  char retention[32];
+
+#define WR_ADD_ARG(s)                                                          \
+  do {                                                                         \
+    argv[argc] = (s);                                                          \
+    argv_len[argc] = strlen(s);                                                \
+    argc++;                                                                    \
+  } while (0)
+#define WR_ADD_LABEL(l, v)                                                     \
+  do {                                                                         \
+    if ((v)[0] != 0) {                                                         \
+      WR_ADD_ARG(l);                                                           \
+      WR_ADD_ARG(v);                                                           \
+    }                                                                          \
+  } while (0)
+
+  WR_ADD_ARG("TS.CREATE");
+  WR_ADD_ARG(key);
+  if (node->max_set_duration > 0) {
+    ssnprintf(retention, sizeof(retention), "%d",
+              node->max_set_duration * 1000);
+    WR_ADD_ARG("RETENTION");
+    WR_ADD_ARG(retention);
+  }
+  WR_ADD_ARG("LABELS");
+  WR_ADD_LABEL("host", vl->host);
+  WR_ADD_LABEL("plugin", vl->plugin);
+  WR_ADD_LABEL("plugin_instance", vl->plugin_instance);
+  WR_ADD_LABEL("type", vl->type);
+  WR_ADD_LABEL("type_instance", vl->type_instance);
+  WR_ADD_LABEL("ds", ds_name);
+
+#undef WR_ADD_LABEL
+#undef WR_ADD_ARG
+
+  if (wr_begin(node) != 0)
+    return -1;
+
+  if (redisAppendCommandArgv(node->conn, (int)argc, argv, argv_len) !=
+      REDIS_OK) {
+    ERROR("write_redis plugin: Queueing TS.CREATE failed: %s",
+          node->conn->errstr);
+    return -1;
+  }
+
+  node->pending_commands++;
+  return 0;
+} /* }}} int wr_create_time_series */
+
+/* wr_write_time_series adds one sample per data source to the TS.MADD
+ * command, creating the time series first if necessary. */
+static int wr_write_time_series(wr_node_t *node, /* {{{ */
+                                const data_set_t *ds, const value_list_t *vl,
+                                const char *key) {
+  gauge_t *rates = NULL;
+  char time[24];
+  int status = 0;
+
+  /* Used to remove the samples of this value list from the TS.MADD command
+   * if one of them can not be added. */
+  size_t orig_pos = node->madd.pos;
+  size_t orig_args = node->madd_args;
+
+  ssnprintf(time, sizeof(time), "%" PRIu64, CDTIME_T_TO_MS(vl->time));
+
+  if (node->store_rates) {
+    rates = uc_get_rate(ds, vl);
+    if (rates == NULL)
+      return ENOENT;
+  }
+
+  for (size_t i = 0; (status == 0) && (i < ds->ds_num); i++) {
+    char ts_key[512];
+    char value[64];
+
+    if (ds->ds_num > 1)
+      ssnprintf(ts_key, sizeof(ts_key), "%s:%s", key, ds->ds[i].name);
     else
-      freeReplyObject(rr);
+      sstrncpy(ts_key, key, sizeof(ts_key));
+
+    if ((ds->ds[i].type == DS_TYPE_GAUGE) || (rates != NULL)) {
+      gauge_t g =
+          (ds->ds[i].type == DS_TYPE_GAUGE) ? vl->values[i].gauge : rates[i];
+      if (isnan(g))
+        continue;
+      ssnprintf(value, sizeof(value), GAUGE_FORMAT, g);
+    } else if (ds->ds[i].type == DS_TYPE_COUNTER) {
+      ssnprintf(value, sizeof(value), "%" PRIu64,
+                (uint64_t)vl->values[i].counter);
+    } else if (ds->ds[i].type == DS_TYPE_DERIVE) {
+      ssnprintf(value, sizeof(value), "%" PRIi64, vl->values[i].derive);
+    } else {
+      ssnprintf(value, sizeof(value), "%" PRIu64, vl->values[i].absolute);
+    }
+
+    if (wr_key_is_new(node, ts_key))
+      status = wr_create_time_series(
+          node, vl, ts_key, (ds->ds_num > 1) ? ds->ds[i].name : "");
+
+    if ((status == 0) && (node->madd_args == 0))
+      status = strbuf_printf(&node->madd, "%*s", WR_MADD_HEADER_SIZE, "");
+    if (status == 0)
+      status = wr_resp_print_arg(&node->madd, ts_key);
+    if (status == 0)
+      status = wr_resp_print_arg(&node->madd, time);
+    if (status == 0)
+      status = wr_resp_print_arg(&node->madd, value);
+    if (status == 0)
+      node->madd_args += 3;
+    else if (status > 0)
+      strbuf_truncate(&node->madd, orig_pos);
   }
 
-  /* TODO(octo): This is more overhead than necessary. Use the cache and
-   * metadata to determine if it is a new metric and call SADD only once for
-   * each metric. */
-  rr = redisCommand(
-      node->conn, "SADD %svalues %s",
-      (node->prefix != NULL) ? node->prefix : REDIS_DEFAULT_PREFIX, ident);
-  if (rr == NULL)
-    WARNING("SADD command error. ident:%s message:%s", ident,
-            node->conn->errstr);
+  if (status > 0)
+    node->madd_args = orig_args;
+
+  sfree(rates);
+  return status;
+} /* }}} int wr_write_time_series */
+
+static int wr_write(const data_set_t *ds, /* {{{ */
+                    const value_list_t *vl, user_data_t *ud) {
+  wr_node_t *node = ud->data;
+  char ident[512];
+  char key[512];
+  int status;
+
+  status = FORMAT_VL(ident, sizeof(ident), vl);
+  if (status != 0)
+    return status;
+  ssnprintf(key, sizeof(key), "%s%s",
+            (node->prefix != NULL) ? node->prefix : REDIS_DEFAULT_PREFIX,
+            ident);
+
+  pthread_mutex_lock(&node->lock);
+
+  if (wr_connect(node) != 0) {
+    pthread_mutex_unlock(&node->lock);
+    return -1;
+  }
+
+  if (node->use_timeseries)
+    status = wr_write_time_series(node, ds, vl, key);
   else
-    freeReplyObject(rr);
+    status = wr_write_sorted_set(node, ds, vl, ident, key);
+  if (status < 0) {
+    /* The pipeline may hold a partial batch, start over. */
+    wr_disconnect(node);
+    pthread_mutex_unlock(&node->lock);
+    return -1;
+  } else if (status > 0) {
+    /* Only this value list is lost, keep the rest of the batch. */
+    WARNING("write_redis plugin: Node \"%s\": Writing \"%s\" failed: %s",
+            node->name, ident, STRERROR(status));
+    pthread_mutex_unlock(&node->lock);
+    return status;
+  }
+
+  cdtime_t now = cdtime();
+  if (node->pending_values == 0)
+    node->pending_since = now;
+  node->pending_values++;
+
+  /* Send once the batch is full, or has been waiting for an interval. */
+  if ((node->pending_values >= (size_t)node->batch_size) ||
+      ((node->pending_since + plugin_get_interval()) <= now))
+    status = wr_send(node);
 
   pthread_mutex_unlock(&node->lock);
 
-  return 0;
+  return status;
 } /* }}} int wr_write */
 
+static int wr_flush(cdtime_t timeout, /* {{{ */
+                    const char *identifier __attribute__((unused)),
+                    user_data_t *ud) {
+  wr_node_t *node = ud->data;
+  int status = 0;
+
+  pthread_mutex_lock(&node->lock);
+  if ((node->pending_values > 0) &&
+      ((timeout == 0) || ((node->pending_since + timeout) <= cdtime())))
+    status = wr_send(node);
+  pthread_mutex_unlock(&node->lock);
+
+  return status;
+} /* }}} int wr_flush */
+
 static void wr_config_free(void *ptr) /* {{{ */
 {
   wr_node_t *node = ptr;
@@ -165,10 +538,12 @@ static void wr_config_free(void *ptr) /* {{{ */
   if (node == NULL)
     return;
 
-  if (node->conn != NULL) {
-    redisFree(node->conn);
-    node->conn = NULL;
-  }
+  wr_send(node);
+  wr_disconnect(node);
+
+  if (node->known_keys != NULL)
+    c_avl_destroy(node->known_keys);
+  STRBUF_DESTROY(&node->madd);
 
   pthread_mutex_destroy(&node->lock);
   sfree(node->host);
@@ -195,11 +570,20 @@ static int wr_config_node(oconfig_item_t *ci) /* {{{ */
   node->max_set_size = -1;
   node->max_set_duration = -1;
   node->store_rates = true;
+  node->batch_size = 1;
+  node->use_multi = false;
+  node->use_timeseries = false;
   pthread_mutex_init(&node->lock, /* attr = */ NULL);
 
+  node->known_keys = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (node->known_keys == NULL) {
+    wr_config_free(node);
+    return ENOMEM;
+  }
+
   status = cf_util_get_string_buffer(ci, node->name, sizeof(node->name));
   if (status != 0) {
-    sfree(node);
+    wr_config_free(node);
     return status;
   }
 
@@ -231,6 +615,16 @@ static int wr_config_node(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_int(child, &node->max_set_duration);
     } else if (strcasecmp("StoreRates", child->key) == 0) {
       status = cf_util_get_boolean(child, &node->store_rates);
+    } else if (strcasecmp("BatchSize", child->key) == 0) {
+      status = cf_util_get_int(child, &node->batch_size);
+      if ((status == 0) && (node->batch_size < 1)) {
+        ERROR("write_redis plugin: BatchSize must be positive.");
+        status = -1;
+      }
+    } else if (strcasecmp("Transaction", child->key) == 0) {
+      status = cf_util_get_boolean(child, &node->use_multi);
+    } else if (strcasecmp("TimeSeries", child->key) == 0) {
+      status = cf_util_get_boolean(child, &node->use_timeseries);
     } else
       WARNING("write_redis plugin: Ignoring unknown config option \"%s\".",
               child->key);
@@ -249,6 +643,11 @@ static int wr_config_node(oconfig_item_t *ci) /* {{{ */
                                        .data = node,
                                        .free_func = wr_config_free,
                                    });
+    if (status == 0)
+      plugin_register_flush(cb_name, wr_flush,
+                            &(user_data_t){
+                                .data = node,
+                            });
   }
 
   if (status != 0)
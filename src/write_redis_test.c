@@ -0,0 +1,395 @@
+/**
+ * collectd - src/write_redis_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#define plugin_register_write plugin_register_write_wr_test
+#define plugin_register_flush plugin_register_flush_wr_test
+
+#include "testing.h"
+
+#include "write_redis.c" /* sic */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define TEST_MAX_CONNECTIONS 8
+#define TEST_MAX_COMMANDS 64
+
+/* A minimal Redis server on the loopback interface which records the
+ * commands it receives, with their arguments separated by spaces. */
+static int server_fd = -1;
+static int server_port;
+static pthread_t server_thread;
+
+static pthread_t connection_threads[TEST_MAX_CONNECTIONS];
+static size_t connection_threads_num;
+
+static pthread_mutex_t received_lock = PTHREAD_MUTEX_INITIALIZER;
+static char commands[TEST_MAX_COMMANDS][512];
+static size_t commands_num;
+
+/* When set, the next command is not answered and the connection closed. */
+static bool drop_connection;
+
+static user_data_t registered;
+
+/* mock functions */
+int plugin_register_write_wr_test(__attribute__((unused)) const char *name,
+                                  __attribute__((unused)) plugin_write_cb cb,
+                                  user_data_t const *ud) {
+  registered = *ud;
+  return 0;
+}
+
+int plugin_register_flush_wr_test(__attribute__((unused)) const char *name,
+                                  __attribute__((unused)) plugin_flush_cb cb,
+                                  __attribute__((unused))
+                                  user_data_t const *ud) {
+  return 0;
+}
+/* end mock functions */
+
+static int read_exactly(int fd, char *buffer, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t status = recv(fd, buffer + done, len - done, 0);
+    if (status <= 0)
+      return -1;
+    done += (size_t)status;
+  }
+  return 0;
+}
+
+/* Reads a "<type><number>\r\n" line, e.g. "*3\r\n", and returns the number. */
+static int read_number(int fd, char type, long *ret) {
+  char line[32];
+  size_t len = 0;
+
+  while ((len < 2) || (line[len - 2] != '\r') || (line[len - 1] != '\n')) {
+    if ((len >= sizeof(line) - 1) || (read_exactly(fd, line + len, 1) != 0))
+      return -1;
+    len++;
+  }
+  line[len] = 0;
+
+  if (line[0] != type)
+    return -1;
+  *ret = atol(line + 1);
+  return 0;
+}
+
+/* Reads one command, which clients send as an array of bulk strings, into
+ * "buffer". */
+static int read_command(int fd, char *buffer, size_t buffer_size) {
+  long argc;
+  if (read_number(fd, '*', &argc) != 0)
+    return -1;
+
+  size_t len = 0;
+  for (long i = 0; i < argc; i++) {
+    long arg_len;
+    if ((read_number(fd, '$', &arg_len) != 0) || (arg_len < 0) ||
+        (len + (size_t)arg_len + 2 >= buffer_size))
+      return -1;
+    if (i > 0)
+      buffer[len++] = ' ';
+    if (read_exactly(fd, buffer + len, (size_t)arg_len + 2) != 0)
+      return -1;
+    len += (size_t)arg_len;
+  }
+
+  buffer[len] = 0;
+  return 0;
+}
+
+static void *connection_thread(void *arg) {
+  int fd = (int)(intptr_t)arg;
+  char command[512];
+
+  while (read_command(fd, command, sizeof(command)) == 0) {
+    pthread_mutex_lock(&received_lock);
+    bool drop = drop_connection;
+    drop_connection = false;
+    if (!drop && (commands_num < TEST_MAX_COMMANDS))
+      sstrncpy(commands[commands_num++], command, sizeof(commands[0]));
+    pthread_mutex_unlock(&received_lock);
+
+    if (drop)
+      break;
+
+    /* The commands of a transaction are answered as part of EXEC. */
+    char const *reply = "+OK\r\n";
+    if (strcmp("EXEC", command) == 0)
+      reply = "*0\r\n";
+
+    if (send(fd, reply, strlen(reply), MSG_NOSIGNAL) < 0)
+      break;
+  }
+
+  close(fd);
+  return NULL;
+}
+
+static void *accept_thread(__attribute__((unused)) void *arg) {
+  while (true) {
+    int fd = accept(server_fd, NULL, NULL);
+    if (fd < 0)
+      break;
+
+    if ((connection_threads_num >= TEST_MAX_CONNECTIONS) ||
+        (pthread_create(connection_threads + connection_threads_num, NULL,
+                        connection_thread, (void *)(intptr_t)fd) != 0)) {
+      close(fd);
+      continue;
+    }
+    connection_threads_num++;
+  }
+  return NULL;
+}
+
+static int server_start(void) {
+  server_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (server_fd < 0)
+    return -1;
+
+  struct sockaddr_in sa = {
+      .sin_family = AF_INET,
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  socklen_t sa_len = sizeof(sa);
+  if ((bind(server_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) ||
+      (getsockname(server_fd, (struct sockaddr *)&sa, &sa_len) != 0) ||
+      (listen(server_fd, TEST_MAX_CONNECTIONS) != 0))
+    return -1;
+
+  server_port = (int)ntohs(sa.sin_port);
+  return pthread_create(&server_thread, NULL, accept_thread, NULL);
+}
+
+/* Closes the listening socket and waits for the clients to disconnect. */
+static void server_stop(void) {
+  shutdown(server_fd, SHUT_RDWR);
+  close(server_fd);
+  pthread_join(server_thread, NULL);
+  for (size_t i = 0; i < connection_threads_num; i++)
+    pthread_join(connection_threads[i], NULL);
+  connection_threads_num = 0;
+}
+
+static void server_reset(void) {
+  pthread_mutex_lock(&received_lock);
+  commands_num = 0;
+  drop_connection = false;
+  pthread_mutex_unlock(&received_lock);
+}
+
+/* Returns the number of received commands starting with "prefix". */
+static size_t count_commands(char const *prefix) {
+  size_t num = 0;
+
+  pthread_mutex_lock(&received_lock);
+  for (size_t i = 0; i < commands_num; i++)
+    if (strncmp(prefix, commands[i], strlen(prefix)) == 0)
+      num++;
+  pthread_mutex_unlock(&received_lock);
+
+  return num;
+}
+
+static oconfig_value_t string(char *s) {
+  return (oconfig_value_t){.value.string = s, .type = OCONFIG_TYPE_STRING};
+}
+
+static oconfig_value_t number(double n) {
+  return (oconfig_value_t){.value.number = n, .type = OCONFIG_TYPE_NUMBER};
+}
+
+static oconfig_value_t boolean(bool b) {
+  return (oconfig_value_t){.value.boolean = b, .type = OCONFIG_TYPE_BOOLEAN};
+}
+
+/* Configures a node writing to the test server and returns it. */
+static wr_node_t *configure(int batch_size, bool transaction,
+                            bool time_series) {
+  oconfig_value_t name = string("test");
+  oconfig_value_t host = string("127.0.0.1");
+  oconfig_value_t port = number(server_port);
+  oconfig_value_t store_rates = boolean(false);
+  oconfig_value_t batch = number(batch_size);
+  oconfig_value_t multi = boolean(transaction);
+  oconfig_value_t ts = boolean(time_series);
+
+  oconfig_item_t children[] = {
+      {.key = "Host", .values = &host, .values_num = 1},
+      {.key = "Port", .values = &port, .values_num = 1},
+      {.key = "StoreRates", .values = &store_rates, .values_num = 1},
+      {.key = "BatchSize", .values = &batch, .values_num = 1},
+      {.key = "Transaction", .values = &multi, .values_num = 1},
+      {.key = "TimeSeries", .values = &ts, .values_num = 1},
+  };
+  oconfig_item_t ci = {
+      .key = "Node",
+      .values = &name,
+      .values_num = 1,
+      .children = children,
+      .children_num = STATIC_ARRAY_SIZE(children),
+  };
+
+  memset(&registered, 0, sizeof(registered));
+  if (wr_config_node(&ci) != 0)
+    return NULL;
+  return registered.data;
+}
+
+static int write_value(wr_node_t *node, int i) {
+  value_list_t vl = {
+      .values = &(value_t){.derive = i},
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T(1),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "MAGIC",
+  };
+  snprintf(vl.type_instance, sizeof(vl.type_instance), "%d", i);
+
+  return wr_write(plugin_get_ds("MAGIC"), &vl, &(user_data_t){.data = node});
+}
+
+DEF_TEST(pipeline) {
+  server_reset();
+
+  wr_node_t *node = configure(/* batch_size = */ 3, /* transaction = */ false,
+                              /* time_series = */ false);
+  CHECK_NOT_NULL(node);
+
+  /* Nothing but the SELECT is sent until the batch is full. */
+  CHECK_ZERO(write_value(node, 0));
+  CHECK_ZERO(write_value(node, 1));
+  EXPECT_EQ_UINT64(1, commands_num);
+  EXPECT_EQ_STR("SELECT 0", commands[0]);
+
+  CHECK_ZERO(write_value(node, 2));
+  EXPECT_EQ_UINT64(7, commands_num);
+  EXPECT_EQ_STR("ZADD collectd/example.com/test/MAGIC-0 1.000000000 1.000:0",
+                commands[1]);
+  EXPECT_EQ_STR("SADD collectd/values example.com/test/MAGIC-0", commands[2]);
+  EXPECT_EQ_STR("ZADD collectd/example.com/test/MAGIC-2 1.000000000 1.000:2",
+                commands[5]);
+
+  /* Known keys are not added to the "values" set again. */
+  for (int i = 0; i < 3; i++)
+    CHECK_ZERO(write_value(node, i));
+  EXPECT_EQ_UINT64(10, commands_num);
+  EXPECT_EQ_UINT64(6, count_commands("ZADD "));
+  EXPECT_EQ_UINT64(3, count_commands("SADD "));
+
+  /* A flush sends an incomplete batch. */
+  CHECK_ZERO(write_value(node, 3));
+  EXPECT_EQ_UINT64(10, commands_num);
+  CHECK_ZERO(wr_flush(/* timeout = */ 0, /* identifier = */ NULL,
+                      &(user_data_t){.data = node}));
+  EXPECT_EQ_UINT64(12, commands_num);
+
+  wr_config_free(node);
+  return 0;
+}
+
+DEF_TEST(transaction_time_series) {
+  server_reset();
+
+  wr_node_t *node = configure(/* batch_size = */ 2, /* transaction = */ true,
+                              /* time_series = */ true);
+  CHECK_NOT_NULL(node);
+
+  CHECK_ZERO(write_value(node, 0));
+  CHECK_ZERO(write_value(node, 1));
+
+  /* The samples of a batch are added with a single TS.MADD. */
+  EXPECT_EQ_UINT64(6, commands_num);
+  EXPECT_EQ_STR("MULTI", commands[1]);
+  EXPECT_EQ_STR("TS.CREATE collectd/example.com/test/MAGIC-0 LABELS "
+                "host example.com plugin test type MAGIC type_instance 0",
+                commands[2]);
+  EXPECT_EQ_STR("TS.CREATE collectd/example.com/test/MAGIC-1 LABELS "
+                "host example.com plugin test type MAGIC type_instance 1",
+                commands[3]);
+  EXPECT_EQ_STR("TS.MADD collectd/example.com/test/MAGIC-0 1000 0 "
+                "collectd/example.com/test/MAGIC-1 1000 1",
+                commands[4]);
+  EXPECT_EQ_STR("EXEC", commands[5]);
+
+  /* Existing time series are not created again. */
+  CHECK_ZERO(write_value(node, 0));
+  CHECK_ZERO(wr_flush(/* timeout = */ 0, /* identifier = */ NULL,
+                      &(user_data_t){.data = node}));
+  EXPECT_EQ_UINT64(9, commands_num);
+  EXPECT_EQ_STR("MULTI", commands[6]);
+  EXPECT_EQ_STR("TS.MADD collectd/example.com/test/MAGIC-0 1000 0",
+                commands[7]);
+  EXPECT_EQ_STR("EXEC", commands[8]);
+
+  wr_config_free(node);
+  return 0;
+}
+
+DEF_TEST(reconnect) {
+  server_reset();
+
+  wr_node_t *node = configure(/* batch_size = */ 1, /* transaction = */ false,
+                              /* time_series = */ false);
+  CHECK_NOT_NULL(node);
+
+  CHECK_ZERO(write_value(node, 0));
+  EXPECT_EQ_UINT64(3, commands_num);
+
+  pthread_mutex_lock(&received_lock);
+  drop_connection = true;
+  pthread_mutex_unlock(&received_lock);
+  OK(write_value(node, 0) != 0);
+
+  /* The next write connects again and, having forgotten the known keys,
+   * adds the key to the "values" set once more. */
+  CHECK_ZERO(write_value(node, 0));
+  EXPECT_EQ_UINT64(6, commands_num);
+  EXPECT_EQ_UINT64(2, count_commands("SELECT "));
+  EXPECT_EQ_UINT64(2, count_commands("SADD "));
+
+  wr_config_free(node);
+  return 0;
+}
+
+int main(void) {
+  if (server_start() != 0)
+    return 1;
+
+  RUN_TEST(pipeline);
+  RUN_TEST(transaction_time_series);
+  RUN_TEST(reconnect);
+
+  server_stop();
+  END_TEST;
+}
@@ -37,6 +37,8 @@
  *     Host "localhost"
  *     Port "4242"
  *     HostTags "status=production deviceclass=www"
+ *     Protocol "Telnet"
+ *     Connections 1
  *   </Node>
  * </Plugin>
  */
@@ -45,10 +47,12 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/strbuf/strbuf.h"
 #include "utils_cache.h"
 #include "utils_random.h"
 
 #include <netdb.h>
+#include <sys/uio.h>
 
 #ifndef WT_DEFAULT_NODE
 #define WT_DEFAULT_NODE "localhost"
@@ -67,13 +71,56 @@
 #define WT_SEND_BUF_SIZE 1428
 #endif
 
+/* Default batch size when posting to the HTTP API. */
+#ifndef WT_HTTP_BATCH_SIZE
+#define WT_HTTP_BATCH_SIZE 65536
+#endif
+
+#ifndef WT_DEFAULT_MAX_QUEUED
+#define WT_DEFAULT_MAX_QUEUED 16
+#endif
+
+#ifndef WT_HTTP_PATH
+#define WT_HTTP_PATH "/api/put"
+#endif
+
+/* Space reserved in front of each HTTP batch for the request header, so that
+ * header and body are sent with a single write. */
+#define WT_HTTP_HEADER_SIZE 512
+
+#define WT_HTTP_RESPONSE_SIZE 4096
+
 /*
  * Private variables
  */
+typedef enum {
+  WT_PROTOCOL_TELNET = 0,
+  WT_PROTOCOL_HTTP,
+} wt_protocol_t;
+
+/* A batch of "put" lines (telnet) or a JSON array of data points (HTTP). */
+typedef struct wt_batch_s wt_batch_t;
+struct wt_batch_s {
+  strbuf_t buf;
+  size_t values_num;
+  cdtime_t init_time;
+  wt_batch_t *next;
+};
+
+struct wt_callback;
+
+typedef struct {
+  struct wt_callback *cb;
+  int sock_fd;
+  pthread_t thread;
+  bool thread_running;
+} wt_connection_t;
+
 struct wt_callback {
+  char *name;
+
   struct addrinfo *ai;
   cdtime_t ai_last_update;
-  int sock_fd;
 
   char *node;
   char *service;
@@ -81,17 +128,46 @@ struct wt_callback {
 
   bool store_rates;
   bool always_append_ds;
+  bool report_stats;
+
+  wt_protocol_t protocol;
+  cdtime_t timeout;
+  size_t batch_size;
+  size_t max_queued;
+
+  /* The batch currently being filled by the write threads. */
+  wt_batch_t *batch;
+
+  /* Batches waiting for a sender thread, and spare batches for reuse. */
+  wt_batch_t *queue_head;
+  wt_batch_t *queue_tail;
+  size_t queue_length;
+  wt_batch_t *spare;
+  size_t spare_num;
+  bool shutdown;
 
-  char send_buf[WT_SEND_BUF_SIZE];
-  size_t send_buf_free;
-  size_t send_buf_fill;
-  cdtime_t send_buf_init_time;
+  wt_connection_t *connections;
+  size_t connections_num;
+  bool connections_started;
 
+  /* Protects everything above except the connection sockets. */
   pthread_mutex_t send_lock;
+  /* Signalled when a batch is queued and on shutdown. */
+  pthread_cond_t queue_cond;
+  /* Signalled when a batch is removed from the queue. */
+  pthread_cond_t space_cond;
 
+  /* Protects "ai" and the fields below, shared by all connections. */
+  pthread_mutex_t resolve_lock;
   bool connect_failed_log_enabled;
   int connect_dns_failed_attempts_remaining;
   cdtime_t next_random_ttl;
+
+  /* Statistics, protected by send_lock. */
+  derive_t stats_values_sent;
+  derive_t stats_values_dropped;
+  derive_t stats_bytes_sent;
+  cdtime_t stats_blocked_time;
 };
 
 static cdtime_t resolve_interval;
@@ -100,75 +176,40 @@ static cdtime_t resolve_jitter;
 /*
  * Functions
  */
-static void wt_reset_buffer(struct wt_callback *cb) {
-  memset(cb->send_buf, 0, sizeof(cb->send_buf));
-  cb->send_buf_free = sizeof(cb->send_buf);
-  cb->send_buf_fill = 0;
-  cb->send_buf_init_time = cdtime();
-}
-
-static int wt_send_buffer(struct wt_callback *cb) {
-  ssize_t status = 0;
+static cdtime_t new_random_ttl(void) {
+  if (resolve_jitter == 0)
+    return 0;
 
-  status = swrite(cb->sock_fd, cb->send_buf, strlen(cb->send_buf));
-  if (status != 0) {
-    ERROR("write_tsdb plugin: send failed with status %zi (%s)", status,
-          STRERRNO);
+  return (cdtime_t)cdrand_range(0, (long)resolve_jitter);
+}
 
-    close(cb->sock_fd);
-    cb->sock_fd = -1;
+/* wt_set_timeout limits the time sending and receiving on "fd" may block.
+ * Blocked calls fail with EAGAIN once the timeout expires. */
+static int wt_set_timeout(int fd, cdtime_t timeout) {
+  struct timeval tv = CDTIME_T_TO_TIMEVAL(timeout);
 
+  if ((setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0) ||
+      (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) != 0)) {
+    ERROR("write_tsdb plugin: setsockopt failed: %s", STRERRNO);
     return -1;
   }
 
   return 0;
 }
 
-/* NOTE: You must hold cb->send_lock when calling this function! */
-static int wt_flush_nolock(cdtime_t timeout, struct wt_callback *cb) {
-  int status;
-
-  DEBUG("write_tsdb plugin: wt_flush_nolock: timeout = %.3f; "
-        "send_buf_fill = %" PRIsz ";",
-        (double)timeout, cb->send_buf_fill);
-
-  /* timeout == 0  => flush unconditionally */
-  if (timeout > 0) {
-    cdtime_t now;
-
-    now = cdtime();
-    if ((cb->send_buf_init_time + timeout) > now)
-      return 0;
-  }
-
-  if (cb->send_buf_fill == 0) {
-    cb->send_buf_init_time = cdtime();
-    return 0;
-  }
-
-  status = wt_send_buffer(cb);
-  wt_reset_buffer(cb);
-
-  return status;
-}
-
-static cdtime_t new_random_ttl(void) {
-  if (resolve_jitter == 0)
-    return 0;
-
-  return (cdtime_t)cdrand_range(0, (long)resolve_jitter);
-}
-
-static int wt_callback_init(struct wt_callback *cb) {
+static int wt_connect(wt_connection_t *conn) {
+  struct wt_callback *cb = conn->cb;
   int status;
   cdtime_t now;
 
   const char *node = cb->node ? cb->node : WT_DEFAULT_NODE;
   const char *service = cb->service ? cb->service : WT_DEFAULT_SERVICE;
 
-  if (cb->sock_fd > 0)
+  if (conn->sock_fd >= 0)
     return 0;
 
+  pthread_mutex_lock(&cb->resolve_lock);
+
   now = cdtime();
   if (cb->ai) {
     /* When we are here, we still have the IP in cache.
@@ -180,9 +221,6 @@ static int wt_callback_init(struct wt_callback *cb) {
     if ((cb->ai_last_update + resolve_interval + cb->next_random_ttl) < now) {
       cb->next_random_ttl = new_random_ttl();
       if (cb->connect_dns_failed_attempts_remaining > 0) {
-        /* Warning : this is run under send_lock mutex.
-         * This is why we do not use another mutex here.
-         * */
         cb->ai_last_update = now;
         cb->connect_dns_failed_attempts_remaining--;
       } else {
@@ -196,6 +234,7 @@ static int wt_callback_init(struct wt_callback *cb) {
     if ((cb->ai_last_update + resolve_interval + cb->next_random_ttl) >= now) {
       DEBUG("write_tsdb plugin: too many getaddrinfo(%s, %s) failures", node,
             service);
+      pthread_mutex_unlock(&cb->resolve_lock);
       return -1;
     }
     cb->ai_last_update = now;
@@ -218,32 +257,40 @@ static int wt_callback_init(struct wt_callback *cb) {
               service, gai_strerror(status));
         cb->connect_failed_log_enabled = 0;
       }
+      pthread_mutex_unlock(&cb->resolve_lock);
       return -1;
     }
   }
 
   assert(cb->ai != NULL);
   for (struct addrinfo *ai = cb->ai; ai != NULL; ai = ai->ai_next) {
-    cb->sock_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
-    if (cb->sock_fd < 0)
+    conn->sock_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (conn->sock_fd < 0)
       continue;
 
-    set_sock_opts(cb->sock_fd);
+    set_sock_opts(conn->sock_fd);
+    if ((cb->protocol == WT_PROTOCOL_HTTP) &&
+        (wt_set_timeout(conn->sock_fd, cb->timeout) != 0)) {
+      close(conn->sock_fd);
+      conn->sock_fd = -1;
+      continue;
+    }
 
-    status = connect(cb->sock_fd, ai->ai_addr, ai->ai_addrlen);
+    status = connect(conn->sock_fd, ai->ai_addr, ai->ai_addrlen);
     if (status != 0) {
-      close(cb->sock_fd);
-      cb->sock_fd = -1;
+      close(conn->sock_fd);
+      conn->sock_fd = -1;
       continue;
     }
 
     break;
   }
 
-  if (cb->sock_fd < 0) {
+  if (conn->sock_fd < 0) {
     ERROR("write_tsdb plugin: Connecting to %s:%s failed. "
           "The last error was: %s",
           node, service, STRERRNO);
+    pthread_mutex_unlock(&cb->resolve_lock);
     return -1;
   }
 
@@ -253,8 +300,506 @@ static int wt_callback_init(struct wt_callback *cb) {
   }
   cb->connect_dns_failed_attempts_remaining = 1;
 
-  wt_reset_buffer(cb);
+  pthread_mutex_unlock(&cb->resolve_lock);
+  return 0;
+}
+
+static void wt_disconnect(wt_connection_t *conn) {
+  if (conn->sock_fd < 0)
+    return;
+
+  close(conn->sock_fd);
+  conn->sock_fd = -1;
+}
+
+/* wt_writev writes all of "iov", retrying after partial writes. */
+static int wt_writev(int fd, struct iovec *iov, int iovcnt) {
+  while (iovcnt > 0) {
+    ssize_t status = writev(fd, iov, iovcnt);
+    if ((status < 0) && (errno == EINTR))
+      continue;
+    if (status < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        errno = ETIMEDOUT;
+      return -1;
+    }
+
+    size_t n = (size_t)status;
+    while ((iovcnt > 0) && (n >= iov->iov_len)) {
+      n -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = (char *)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+
+  return 0;
+}
+
+/* Buffered reader for HTTP responses. */
+typedef struct {
+  int fd;
+  char buffer[WT_HTTP_RESPONSE_SIZE];
+  size_t pos;
+  size_t fill;
+} wt_http_reader_t;
+
+/* wt_http_fill reads more data into the reader's buffer. Returns the number of
+ * bytes read, zero if the connection was closed and -1 on error. */
+static ssize_t wt_http_fill(wt_http_reader_t *r) {
+  if (r->pos > 0) {
+    memmove(r->buffer, r->buffer + r->pos, r->fill - r->pos);
+    r->fill -= r->pos;
+    r->pos = 0;
+  }
+
+  if (r->fill >= sizeof(r->buffer) - 1) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  while (true) {
+    ssize_t status =
+        read(r->fd, r->buffer + r->fill, sizeof(r->buffer) - 1 - r->fill);
+    if ((status < 0) && (errno == EINTR))
+      continue;
+    if (status < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        errno = ETIMEDOUT;
+      return -1;
+    }
+
+    r->fill += (size_t)status;
+    r->buffer[r->fill] = 0;
+    return status;
+  }
+}
+
+/* wt_http_read_line returns the next CRLF terminated line, without the line
+ * terminator, or NULL if the connection failed. */
+static char *wt_http_read_line(wt_http_reader_t *r) {
+  while (true) {
+    r->buffer[r->fill] = 0;
+    char *line = r->buffer + r->pos;
+    char *end = strstr(line, "\r\n");
+    if (end != NULL) {
+      *end = 0;
+      r->pos = (size_t)(end + 2 - r->buffer);
+      return line;
+    }
+
+    ssize_t status = wt_http_fill(r);
+    if (status <= 0) {
+      if (status == 0)
+        errno = ECONNRESET;
+      return NULL;
+    }
+  }
+}
+
+/* wt_http_read_body reads "size" bytes of the body, or up to the end of the
+ * connection if "size" is SIZE_MAX, and appends them to "body". */
+static int wt_http_read_body(wt_http_reader_t *r, size_t size, char *body,
+                             size_t *body_len, size_t body_size) {
+  while (size > 0) {
+    if (r->pos == r->fill) {
+      ssize_t status = wt_http_fill(r);
+      if ((status == 0) && (size == SIZE_MAX))
+        return 0;
+      if (status <= 0) {
+        if (status == 0)
+          errno = ECONNRESET;
+        return -1;
+      }
+    }
+
+    size_t n = r->fill - r->pos;
+    if (n > size)
+      n = size;
+
+    if (*body_len < body_size - 1) {
+      size_t copy = body_size - 1 - *body_len;
+      if (copy > n)
+        copy = n;
+      memcpy(body + *body_len, r->buffer + r->pos, copy);
+      *body_len += copy;
+      body[*body_len] = 0;
+    }
+
+    r->pos += n;
+    if (size != SIZE_MAX)
+      size -= n;
+  }
+
+  return 0;
+}
+
+/* wt_http_read_chunks reads a body sent with the "chunked" transfer coding,
+ * including the trailer. */
+static int wt_http_read_chunks(wt_http_reader_t *r, char *body,
+                               size_t *body_len, size_t body_size) {
+  while (true) {
+    char *line = wt_http_read_line(r);
+    if (line == NULL)
+      return -1;
+
+    char *endptr = NULL;
+    errno = 0;
+    unsigned long long size = strtoull(line, &endptr, 16);
+    if ((endptr == line) || (errno != 0) ||
+        ((*endptr != 0) && (*endptr != ';') && !isspace((int)*endptr))) {
+      ERROR("write_tsdb plugin: Malformed HTTP chunk size \"%s\".", line);
+      errno = EPROTO;
+      return -1;
+    }
+
+    if (size == 0)
+      break;
+
+    if (wt_http_read_body(r, (size_t)size, body, body_len, body_size) != 0)
+      return -1;
+
+    /* Each chunk is followed by an empty line. */
+    line = wt_http_read_line(r);
+    if (line == NULL)
+      return -1;
+    if (line[0] != 0) {
+      ERROR("write_tsdb plugin: Malformed HTTP chunk.");
+      errno = EPROTO;
+      return -1;
+    }
+  }
+
+  /* Skip the trailer fields, up to the empty line ending the message. */
+  while (true) {
+    char *line = wt_http_read_line(r);
+    if (line == NULL)
+      return -1;
+    if (line[0] == 0)
+      return 0;
+  }
+}
+
+/* wt_http_header_value returns the value of "line" if it is the header field
+ * "name", and NULL otherwise. */
+static char *wt_http_header_value(char *line, char const *name) {
+  size_t name_len = strlen(name);
+  if ((strncasecmp(name, line, name_len) != 0) || (line[name_len] != ':'))
+    return NULL;
+
+  char *value = line + name_len + 1;
+  while (isspace((int)*value))
+    value++;
+  return value;
+}
+
+/* wt_http_read_response reads the response to a request and returns the HTTP
+ * status code, or -1 if the connection failed. "body" receives the start of
+ * the response body, which OpenTSDB uses for error details. The body is
+ * delimited by its Content-Length, by the "chunked" transfer coding or, if the
+ * server closes the connection after the response, by the end of the
+ * connection. */
+static int wt_http_read_response(wt_connection_t *conn, char *body,
+                                 size_t body_size) {
+  wt_http_reader_t r = {.fd = conn->sock_fd};
+  size_t body_len = 0;
+
+  body[0] = 0;
+
+  char *line = wt_http_read_line(&r);
+  if (line == NULL) {
+    ERROR("write_tsdb plugin: Reading HTTP response failed: %s", STRERRNO);
+    return -1;
+  }
+
+  int major = 0;
+  int minor = 0;
+  int code = 0;
+  if (sscanf(line, "HTTP/%d.%d %d", &major, &minor, &code) != 3) {
+    ERROR("write_tsdb plugin: Malformed HTTP response.");
+    return -1;
+  }
+
+  /* HTTP/1.1 connections are persistent unless the server says otherwise. */
+  bool keep_alive = (major > 1) || ((major == 1) && (minor >= 1));
+  bool have_length = false;
+  bool chunked = false;
+  size_t content_length = 0;
+
+  while (true) {
+    line = wt_http_read_line(&r);
+    if (line == NULL) {
+      ERROR("write_tsdb plugin: Reading HTTP response failed: %s", STRERRNO);
+      return -1;
+    }
+    if (line[0] == 0)
+      break;
+
+    char *value;
+    if ((value = wt_http_header_value(line, "Content-Length")) != NULL) {
+      content_length = (size_t)strtoull(value, NULL, 10);
+      have_length = true;
+    } else if ((value = wt_http_header_value(line, "Transfer-Encoding")) !=
+               NULL) {
+      chunked = (strncasecmp("chunked", value, strlen("chunked")) == 0);
+    } else if ((value = wt_http_header_value(line, "Connection")) != NULL) {
+      if (strncasecmp("close", value, strlen("close")) == 0)
+        keep_alive = false;
+      else if (strncasecmp("keep-alive", value, strlen("keep-alive")) == 0)
+        keep_alive = true;
+    }
+  }
+
+  int status = 0;
+  if ((code == 204) || (code == 304) || ((code >= 100) && (code < 200))) {
+    /* No body. */
+  } else if (chunked) {
+    status = wt_http_read_chunks(&r, body, &body_len, body_size);
+  } else if (have_length) {
+    status = wt_http_read_body(&r, content_length, body, &body_len, body_size);
+  } else if (!keep_alive) {
+    status = wt_http_read_body(&r, SIZE_MAX, body, &body_len, body_size);
+  } else {
+    /* The end of the body could not be found without waiting for the server
+     * to close the connection. */
+    ERROR("write_tsdb plugin: HTTP response without Content-Length on a "
+          "persistent connection.");
+    return -1;
+  }
+  if (status != 0) {
+    ERROR("write_tsdb plugin: Reading HTTP response failed: %s", STRERRNO);
+    return -1;
+  }
+
+  if (!keep_alive)
+    wt_disconnect(conn);
+
+  return code;
+}
+
+/* wt_http_post posts the JSON batch to the HTTP API. The request header is
+ * written into the space reserved in front of the batch. */
+static int wt_http_post(wt_connection_t *conn, wt_batch_t *b) {
+  struct wt_callback *cb = conn->cb;
+  char header[WT_HTTP_HEADER_SIZE];
+  size_t body_len = b->buf.pos - WT_HTTP_HEADER_SIZE;
+
+  int status = snprintf(header, sizeof(header),
+                        "POST " WT_HTTP_PATH " HTTP/1.1\r\n"
+                        "Host: %s:%s\r\n"
+                        "User-Agent: " COLLECTD_USERAGENT "\r\n"
+                        "Content-Type: application/json\r\n"
+                        "Content-Length: %" PRIsz "\r\n"
+                        "\r\n",
+                        cb->node ? cb->node : WT_DEFAULT_NODE,
+                        cb->service ? cb->service : WT_DEFAULT_SERVICE,
+                        body_len);
+  if ((status < 0) || ((size_t)status >= sizeof(header))) {
+    ERROR("write_tsdb plugin: HTTP request header too long.");
+    return -1;
+  }
+
+  size_t header_len = (size_t)status;
+  char *request = b->buf.ptr + WT_HTTP_HEADER_SIZE - header_len;
+  memcpy(request, header, header_len);
+
+  struct iovec iov = {.iov_base = request, .iov_len = header_len + body_len};
+  if (wt_writev(conn->sock_fd, &iov, 1) != 0) {
+    ERROR("write_tsdb plugin: send failed: %s", STRERRNO);
+    wt_disconnect(conn);
+    return -1;
+  }
+
+  char body[256];
+  int code = wt_http_read_response(conn, body, sizeof(body));
+  if (code < 0) {
+    wt_disconnect(conn);
+    return -1;
+  }
+
+  if ((code < 200) || (code >= 300)) {
+    ERROR("write_tsdb plugin: %s:%s responded with HTTP status %d: %s",
+          cb->node ? cb->node : WT_DEFAULT_NODE,
+          cb->service ? cb->service : WT_DEFAULT_SERVICE, code, body);
+    return -1;
+  }
+
+  return 0;
+}
+
+static int wt_send_batch(wt_connection_t *conn, wt_batch_t *b) {
+  if (conn->cb->protocol == WT_PROTOCOL_HTTP) {
+    /* Keep-alive connections may have been closed by the server in the
+     * meantime, so retry once on a fresh connection. */
+    bool reused = (conn->sock_fd >= 0);
+    if (wt_connect(conn) != 0)
+      return -1;
+    if (wt_http_post(conn, b) == 0)
+      return 0;
+    if (!reused || (conn->sock_fd >= 0) || (wt_connect(conn) != 0))
+      return -1;
+    return wt_http_post(conn, b);
+  }
+
+  if (wt_connect(conn) != 0)
+    return -1;
+
+  ssize_t status = swrite(conn->sock_fd, b->buf.ptr, b->buf.pos);
+  if (status != 0) {
+    ERROR("write_tsdb plugin: send failed with status %zi (%s)", status,
+          STRERRNO);
+    wt_disconnect(conn);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* NOTE: You must hold cb->send_lock when calling this function! */
+static wt_batch_t *wt_batch_get_nolock(struct wt_callback *cb) {
+  wt_batch_t *b = cb->spare;
+  if (b != NULL) {
+    cb->spare = b->next;
+    cb->spare_num--;
+  } else {
+    b = calloc(1, sizeof(*b));
+    if (b == NULL) {
+      ERROR("write_tsdb plugin: calloc failed.");
+      return NULL;
+    }
+  }
+
+  b->next = NULL;
+  b->values_num = 0;
+  b->init_time = cdtime();
+  strbuf_reset(&b->buf);
+
+  int status = strbuf_resize(&b->buf, cb->batch_size);
+  if ((status == 0) && (cb->protocol == WT_PROTOCOL_HTTP))
+    status = strbuf_printf(&b->buf, "%*s[", WT_HTTP_HEADER_SIZE, "");
+  if (status != 0) {
+    ERROR("write_tsdb plugin: Allocating batch buffer failed.");
+    STRBUF_DESTROY(&b->buf);
+    sfree(b);
+    return NULL;
+  }
+
+  return b;
+}
+
+/* NOTE: You must hold cb->send_lock when calling this function! */
+static void wt_batch_put_nolock(struct wt_callback *cb, wt_batch_t *b) {
+  if (cb->spare_num >= cb->max_queued) {
+    STRBUF_DESTROY(&b->buf);
+    sfree(b);
+    return;
+  }
 
+  b->next = cb->spare;
+  cb->spare = b;
+  cb->spare_num++;
+}
+
+/* wt_queue_batch_nolock hands the current batch to the sender threads. If
+ * the queue is full, blocks until a sender has made room.
+ * NOTE: You must hold cb->send_lock when calling this function! */
+static int wt_queue_batch_nolock(struct wt_callback *cb) {
+  wt_batch_t *b = cb->batch;
+  if (b == NULL)
+    return 0;
+  cb->batch = NULL;
+
+  if ((cb->protocol == WT_PROTOCOL_HTTP) && (strbuf_print(&b->buf, "]") != 0)) {
+    ERROR("write_tsdb plugin: Finalizing batch failed.");
+    cb->stats_values_dropped += (derive_t)b->values_num;
+    wt_batch_put_nolock(cb, b);
+    return -1;
+  }
+
+  if (cb->queue_length >= cb->max_queued) {
+    cdtime_t start = cdtime();
+    while (cb->queue_length >= cb->max_queued)
+      pthread_cond_wait(&cb->space_cond, &cb->send_lock);
+    cb->stats_blocked_time += cdtime() - start;
+  }
+
+  if (cb->queue_tail == NULL)
+    cb->queue_head = b;
+  else
+    cb->queue_tail->next = b;
+  cb->queue_tail = b;
+  cb->queue_length++;
+
+  pthread_cond_signal(&cb->queue_cond);
+  return 0;
+}
+
+static void *wt_sender_thread(void *arg) {
+  wt_connection_t *conn = arg;
+  struct wt_callback *cb = conn->cb;
+
+  pthread_mutex_lock(&cb->send_lock);
+  while (true) {
+    while ((cb->queue_head == NULL) && !cb->shutdown)
+      pthread_cond_wait(&cb->queue_cond, &cb->send_lock);
+
+    /* Drain the queue before exiting. */
+    wt_batch_t *b = cb->queue_head;
+    if (b == NULL)
+      break;
+
+    cb->queue_head = b->next;
+    if (cb->queue_head == NULL)
+      cb->queue_tail = NULL;
+    cb->queue_length--;
+    pthread_cond_signal(&cb->space_cond);
+    pthread_mutex_unlock(&cb->send_lock);
+
+    int status = wt_send_batch(conn, b);
+
+    pthread_mutex_lock(&cb->send_lock);
+    if (status == 0) {
+      cb->stats_values_sent += (derive_t)b->values_num;
+      cb->stats_bytes_sent += (derive_t)b->buf.pos;
+    } else {
+      cb->stats_values_dropped += (derive_t)b->values_num;
+    }
+    wt_batch_put_nolock(cb, b);
+  }
+  pthread_mutex_unlock(&cb->send_lock);
+
+  wt_disconnect(conn);
+  return NULL;
+}
+
+/* wt_callback_init starts the sender threads, one per connection.
+ * NOTE: You must hold cb->send_lock when calling this function! */
+static int wt_callback_init(struct wt_callback *cb) {
+  if (cb->connections_started)
+    return 0;
+
+  size_t running = 0;
+  for (size_t i = 0; i < cb->connections_num; i++) {
+    wt_connection_t *conn = cb->connections + i;
+
+    int status = plugin_thread_create(&conn->thread, wt_sender_thread, conn,
+                                      "write_tsdb send");
+    if (status != 0) {
+      ERROR("write_tsdb plugin: Starting sender thread failed: %s",
+            STRERROR(status));
+      continue;
+    }
+    conn->thread_running = true;
+    running++;
+  }
+
+  if (running == 0)
+    return -1;
+
+  cb->connections_started = true;
   return 0;
 }
 
@@ -267,17 +812,45 @@ static void wt_callback_free(void *data) {
   cb = data;
 
   pthread_mutex_lock(&cb->send_lock);
+  if (cb->connections_started)
+    wt_queue_batch_nolock(cb);
+  cb->shutdown = true;
+  pthread_cond_broadcast(&cb->queue_cond);
+  pthread_mutex_unlock(&cb->send_lock);
 
-  wt_flush_nolock(0, cb);
+  for (size_t i = 0; i < cb->connections_num; i++) {
+    if (cb->connections[i].thread_running)
+      pthread_join(cb->connections[i].thread, NULL);
+  }
+
+  /* Batches left over if no sender thread could be started. */
+  if (cb->batch != NULL)
+    wt_batch_put_nolock(cb, cb->batch);
+  while (cb->queue_head != NULL) {
+    wt_batch_t *b = cb->queue_head;
+    cb->queue_head = b->next;
+    STRBUF_DESTROY(&b->buf);
+    sfree(b);
+  }
+  while (cb->spare != NULL) {
+    wt_batch_t *b = cb->spare;
+    cb->spare = b->next;
+    STRBUF_DESTROY(&b->buf);
+    sfree(b);
+  }
 
-  close(cb->sock_fd);
-  cb->sock_fd = -1;
+  if (cb->ai != NULL)
+    freeaddrinfo(cb->ai);
 
+  sfree(cb->connections);
+  sfree(cb->name);
   sfree(cb->node);
   sfree(cb->service);
   sfree(cb->host_tags);
 
-  pthread_mutex_unlock(&cb->send_lock);
+  pthread_cond_destroy(&cb->space_cond);
+  pthread_cond_destroy(&cb->queue_cond);
+  pthread_mutex_destroy(&cb->resolve_lock);
   pthread_mutex_destroy(&cb->send_lock);
 
   sfree(cb);
@@ -296,21 +869,76 @@ static int wt_flush(cdtime_t timeout,
 
   pthread_mutex_lock(&cb->send_lock);
 
-  if (cb->sock_fd < 0) {
-    status = wt_callback_init(cb);
-    if (status != 0) {
-      ERROR("write_tsdb plugin: wt_callback_init failed.");
-      pthread_mutex_unlock(&cb->send_lock);
-      return -1;
-    }
+  status = wt_callback_init(cb);
+  if (status != 0) {
+    ERROR("write_tsdb plugin: wt_callback_init failed.");
+    pthread_mutex_unlock(&cb->send_lock);
+    return -1;
   }
 
-  status = wt_flush_nolock(timeout, cb);
+  DEBUG("write_tsdb plugin: wt_flush: timeout = %.3f; queue_length = %" PRIsz
+        ";",
+        CDTIME_T_TO_DOUBLE(timeout), cb->queue_length);
+
+  /* timeout == 0  => flush unconditionally */
+  if ((cb->batch != NULL) &&
+      ((timeout == 0) || ((cb->batch->init_time + timeout) <= cdtime())))
+    status = wt_queue_batch_nolock(cb);
+
   pthread_mutex_unlock(&cb->send_lock);
 
   return status;
 }
 
+static int wt_stats_read(user_data_t *user_data) {
+  struct wt_callback *cb = user_data->data;
+
+  pthread_mutex_lock(&cb->send_lock);
+  gauge_t queue_length = (gauge_t)cb->queue_length;
+  derive_t values_sent = cb->stats_values_sent;
+  derive_t values_dropped = cb->stats_values_dropped;
+  derive_t bytes_sent = cb->stats_bytes_sent;
+  derive_t blocked_time = (derive_t)CDTIME_T_TO_MS(cb->stats_blocked_time);
+  pthread_mutex_unlock(&cb->send_lock);
+
+  value_list_t vl = VALUE_LIST_INIT;
+  value_t values[1];
+
+  vl.values = values;
+  vl.values_len = 1;
+  sstrncpy(vl.plugin, "write_tsdb", sizeof(vl.plugin));
+  sstrncpy(vl.plugin_instance, cb->name, sizeof(vl.plugin_instance));
+
+  /* Batches waiting for a connection */
+  vl.values[0].gauge = queue_length;
+  sstrncpy(vl.type, "queue_length", sizeof(vl.type));
+  plugin_dispatch_values(&vl);
+
+  /* Values sent / dropped */
+  sstrncpy(vl.type, "total_values", sizeof(vl.type));
+  vl.values[0].derive = values_sent;
+  sstrncpy(vl.type_instance, "send-accepted", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  vl.values[0].derive = values_dropped;
+  sstrncpy(vl.type_instance, "send-rejected", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  /* Bytes sent */
+  vl.values[0].derive = bytes_sent;
+  sstrncpy(vl.type, "total_bytes", sizeof(vl.type));
+  vl.type_instance[0] = 0;
+  plugin_dispatch_values(&vl);
+
+  /* Time write threads were blocked because the queue was full */
+  vl.values[0].derive = blocked_time;
+  sstrncpy(vl.type, "total_time_in_ms", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "blocked", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  return 0;
+}
+
 static int wt_format_values(char *ret, size_t ret_len, int ds_num,
                             const data_set_t *ds, const value_list_t *vl,
                             bool store_rates) {
@@ -425,21 +1053,103 @@ static int wt_format_name(char *ret, int ret_len, const value_list_t *vl,
   return 0;
 }
 
+/* wt_json_print_string appends "s" as a quoted JSON string. */
+static int wt_json_print_string(strbuf_t *buf, const char *s, size_t len) {
+  int status = strbuf_print(buf, "\"");
+
+  for (size_t i = 0; (status == 0) && (i < len); i++) {
+    unsigned char c = (unsigned char)s[i];
+    if ((c == '"') || (c == '\\'))
+      status = strbuf_printf(buf, "\\%c", c);
+    else if (c < 0x20)
+      status = strbuf_printf(buf, "\\u%04x", (unsigned int)c);
+    else
+      status = strbuf_printn(buf, s + i, 1);
+  }
+
+  if (status == 0)
+    status = strbuf_print(buf, "\"");
+  return status;
+}
+
+/* wt_json_print_tags converts space separated "key=value" pairs, as used by
+ * the telnet interface, to members of a JSON object. */
+static int wt_json_print_tags(strbuf_t *buf, const char *tags) {
+  const char *ptr = tags;
+
+  while (*ptr != 0) {
+    while (*ptr == ' ')
+      ptr++;
+
+    size_t len = strcspn(ptr, " ");
+    const char *eq = memchr(ptr, '=', len);
+    if ((len > 0) && (eq != NULL) && (eq != ptr)) {
+      int status = strbuf_print(buf, ",");
+      if (status == 0)
+        status = wt_json_print_string(buf, ptr, (size_t)(eq - ptr));
+      if (status == 0)
+        status = strbuf_print(buf, ":");
+      if (status == 0)
+        status = wt_json_print_string(buf, eq + 1,
+                                      len - (size_t)(eq - ptr) - 1);
+      if (status != 0)
+        return status;
+    }
+    ptr += len;
+  }
+
+  return 0;
+}
+
+/* wt_format_message formats a single data point, either as a "put" line or
+ * as a JSON object for the HTTP API. */
+static int wt_format_message(strbuf_t *buf, struct wt_callback *cb,
+                             const char *key, const char *value, cdtime_t time,
+                             const char *host, const char *tags) {
+  const char *host_tags = cb->host_tags ? cb->host_tags : "";
+
+  if (cb->protocol == WT_PROTOCOL_TELNET)
+    return strbuf_printf(buf, "put %s %.0f %s fqdn=%s %s %s\r\n", key,
+                         CDTIME_T_TO_DOUBLE(time), value, host, tags,
+                         host_tags);
+
+  int status = strbuf_print(buf, "{\"metric\":");
+  if (status == 0)
+    status = wt_json_print_string(buf, key, strlen(key));
+  if (status == 0)
+    status = strbuf_printf(buf, ",\"timestamp\":%.0f,\"value\":%s,\"tags\":{",
+                           CDTIME_T_TO_DOUBLE(time), value);
+  if (status == 0)
+    status = strbuf_print(buf, "\"fqdn\":");
+  if (status == 0)
+    status = wt_json_print_string(buf, host, strlen(host));
+  if (status == 0)
+    status = wt_json_print_tags(buf, tags);
+  if (status == 0)
+    status = wt_json_print_tags(buf, host_tags);
+  if (status == 0)
+    status = strbuf_print(buf, "}}");
+  return status;
+}
+
 static int wt_send_message(const char *key, const char *value, cdtime_t time,
                            struct wt_callback *cb, const char *host,
                            meta_data_t *md) {
   int status;
-  size_t message_len;
   char *temp = NULL;
   const char *tags = "";
   char message[1024];
-  const char *host_tags = cb->host_tags ? cb->host_tags : "";
+  strbuf_t *buf = STRBUF_CREATE_STATIC(message);
   const char *meta_tsdb = "tsdb_tags";
 
   /* skip if value is NaN */
   if (value[0] == 'n')
     return 0;
 
+  /* JSON has no representation for infinity. */
+  if ((cb->protocol == WT_PROTOCOL_HTTP) && (strchr(value, 'i') != NULL))
+    return 0;
+
   if (md) {
     status = meta_data_get_string(md, meta_tsdb, &temp);
     if (status == -ENOENT) {
@@ -447,60 +1157,67 @@ static int wt_send_message(const char *key, const char *value, cdtime_t time,
     } else if (status < 0) {
       ERROR("write_tsdb plugin: tags metadata get failure");
       sfree(temp);
-      pthread_mutex_unlock(&cb->send_lock);
       return status;
     } else {
       tags = temp;
     }
   }
 
-  status =
-      snprintf(message, sizeof(message), "put %s %.0f %s fqdn=%s %s %s\r\n",
-               key, CDTIME_T_TO_DOUBLE(time), value, host, tags, host_tags);
+  status = wt_format_message(buf, cb, key, value, time, host, tags);
   sfree(temp);
-  if (status < 0)
-    return -1;
-  message_len = (size_t)status;
-
-  if (message_len >= sizeof(message)) {
+  if (status == ENOSPC) {
     ERROR("write_tsdb plugin: message buffer too small: "
-          "Need %" PRIsz " bytes.",
-          message_len + 1);
+          "Need more than %" PRIsz " bytes.",
+          sizeof(message));
+    return -1;
+  } else if (status != 0) {
     return -1;
   }
 
   pthread_mutex_lock(&cb->send_lock);
 
-  if (cb->sock_fd < 0) {
-    status = wt_callback_init(cb);
-    if (status != 0) {
-      ERROR("write_tsdb plugin: wt_callback_init failed.");
-      pthread_mutex_unlock(&cb->send_lock);
-      return -1;
-    }
+  status = wt_callback_init(cb);
+  if (status != 0) {
+    ERROR("write_tsdb plugin: wt_callback_init failed.");
+    pthread_mutex_unlock(&cb->send_lock);
+    return -1;
   }
 
-  if (message_len >= cb->send_buf_free) {
-    status = wt_flush_nolock(0, cb);
+  /* Leave room for the separating comma and closing bracket of the JSON
+   * array. */
+  if ((cb->batch != NULL) && (cb->batch->values_num > 0) &&
+      ((cb->batch->buf.pos + buf->pos + 2) > cb->batch_size)) {
+    status = wt_queue_batch_nolock(cb);
     if (status != 0) {
       pthread_mutex_unlock(&cb->send_lock);
       return status;
     }
   }
 
-  /* Assert that we have enough space for this message. */
-  assert(message_len < cb->send_buf_free);
+  if (cb->batch == NULL) {
+    cb->batch = wt_batch_get_nolock(cb);
+    if (cb->batch == NULL) {
+      pthread_mutex_unlock(&cb->send_lock);
+      return -1;
+    }
+  }
 
-  /* `message_len + 1' because `message_len' does not include the
-   * trailing null byte. Neither does `send_buffer_fill'. */
-  memcpy(cb->send_buf + cb->send_buf_fill, message, message_len + 1);
-  cb->send_buf_fill += message_len;
-  cb->send_buf_free -= message_len;
+  wt_batch_t *b = cb->batch;
+  status = 0;
+  if ((cb->protocol == WT_PROTOCOL_HTTP) && (b->values_num > 0))
+    status = strbuf_print(&b->buf, ",");
+  if (status == 0)
+    status = strbuf_printn(&b->buf, buf->ptr, buf->pos);
+  if (status != 0) {
+    ERROR("write_tsdb plugin: Appending to batch failed: %s",
+          STRERROR(status));
+    pthread_mutex_unlock(&cb->send_lock);
+    return -1;
+  }
+  b->values_num++;
 
-  DEBUG("write_tsdb plugin: [%s]:%s buf %" PRIsz "/%" PRIsz " (%.1f %%) \"%s\"",
-        cb->node, cb->service, cb->send_buf_fill, sizeof(cb->send_buf),
-        100.0 * ((double)cb->send_buf_fill) / ((double)sizeof(cb->send_buf)),
-        message);
+  DEBUG("write_tsdb plugin: [%s]:%s batch %" PRIsz "/%" PRIsz " \"%s\"",
+        cb->node, cb->service, b->buf.pos, cb->batch_size, message);
 
   pthread_mutex_unlock(&cb->send_lock);
 
@@ -533,7 +1250,9 @@ static int wt_write_messages(const data_set_t *ds, const value_list_t *vl,
       return status;
     }
 
-    escape_string(key, sizeof(key));
+    /* JSON strings are escaped when formatting the message. */
+    if (cb->protocol == WT_PROTOCOL_TELNET)
+      escape_string(key, sizeof(key));
     /* Convert the values to an ASCII representation and put that into
      * 'values'. */
     status =
@@ -571,20 +1290,46 @@ static int wt_write(const data_set_t *ds, const value_list_t *vl,
   return status;
 }
 
+static int wt_config_protocol(oconfig_item_t *ci, wt_protocol_t *ret) {
+  char *protocol = NULL;
+  int status = cf_util_get_string(ci, &protocol);
+  if (status != 0)
+    return status;
+
+  if (strcasecmp("Telnet", protocol) == 0)
+    *ret = WT_PROTOCOL_TELNET;
+  else if (strcasecmp("HTTP", protocol) == 0)
+    *ret = WT_PROTOCOL_HTTP;
+  else {
+    ERROR("write_tsdb plugin: Invalid Protocol \"%s\". "
+          "Expected \"Telnet\" or \"HTTP\".",
+          protocol);
+    status = -1;
+  }
+
+  sfree(protocol);
+  return status;
+}
+
 static int wt_config_tsd(oconfig_item_t *ci) {
   struct wt_callback *cb;
   char callback_name[DATA_MAX_NAME_LEN];
+  int batch_size = 0;
+  int max_queued = WT_DEFAULT_MAX_QUEUED;
+  int connections = 1;
 
   cb = calloc(1, sizeof(*cb));
   if (cb == NULL) {
     ERROR("write_tsdb plugin: calloc failed.");
     return -1;
   }
-  cb->sock_fd = -1;
   cb->connect_failed_log_enabled = 1;
   cb->next_random_ttl = new_random_ttl();
 
   pthread_mutex_init(&cb->send_lock, NULL);
+  pthread_mutex_init(&cb->resolve_lock, NULL);
+  pthread_cond_init(&cb->queue_cond, NULL);
+  pthread_cond_init(&cb->space_cond, NULL);
 
   for (int i = 0; i < ci->children_num; i++) {
     oconfig_item_t *child = ci->children + i;
@@ -599,6 +1344,18 @@ static int wt_config_tsd(oconfig_item_t *ci) {
       cf_util_get_boolean(child, &cb->store_rates);
     else if (strcasecmp("AlwaysAppendDS", child->key) == 0)
       cf_util_get_boolean(child, &cb->always_append_ds);
+    else if (strcasecmp("Protocol", child->key) == 0)
+      wt_config_protocol(child, &cb->protocol);
+    else if (strcasecmp("Timeout", child->key) == 0)
+      cf_util_get_cdtime(child, &cb->timeout);
+    else if (strcasecmp("BatchSize", child->key) == 0)
+      cf_util_get_int(child, &batch_size);
+    else if (strcasecmp("Connections", child->key) == 0)
+      cf_util_get_int(child, &connections);
+    else if (strcasecmp("MaxQueuedBatches", child->key) == 0)
+      cf_util_get_int(child, &max_queued);
+    else if (strcasecmp("ReportStats", child->key) == 0)
+      cf_util_get_boolean(child, &cb->report_stats);
     else {
       ERROR("write_tsdb plugin: Invalid configuration "
             "option: %s.",
@@ -606,6 +1363,44 @@ static int wt_config_tsd(oconfig_item_t *ci) {
     }
   }
 
+  if (batch_size <= 0)
+    batch_size = (cb->protocol == WT_PROTOCOL_HTTP) ? WT_HTTP_BATCH_SIZE
+                                                    : WT_SEND_BUF_SIZE;
+  cb->batch_size = (size_t)batch_size;
+
+  if (cb->timeout == 0)
+    cb->timeout = plugin_get_interval();
+
+  if (max_queued < 1) {
+    WARNING("write_tsdb plugin: MaxQueuedBatches must be positive. "
+            "Using %d.",
+            WT_DEFAULT_MAX_QUEUED);
+    max_queued = WT_DEFAULT_MAX_QUEUED;
+  }
+  cb->max_queued = (size_t)max_queued;
+
+  if (connections < 1) {
+    WARNING("write_tsdb plugin: Connections must be positive. Using 1.");
+    connections = 1;
+  }
+  cb->connections = calloc((size_t)connections, sizeof(*cb->connections));
+  if (cb->connections == NULL) {
+    ERROR("write_tsdb plugin: calloc failed.");
+    wt_callback_free(cb);
+    return -1;
+  }
+  cb->connections_num = (size_t)connections;
+  for (size_t i = 0; i < cb->connections_num; i++) {
+    cb->connections[i].cb = cb;
+    cb->connections[i].sock_fd = -1;
+  }
+
+  char name[DATA_MAX_NAME_LEN];
+  snprintf(name, sizeof(name), "%s_%s",
+           cb->node != NULL ? cb->node : WT_DEFAULT_NODE,
+           cb->service != NULL ? cb->service : WT_DEFAULT_SERVICE);
+  cb->name = strdup(name);
+
   snprintf(callback_name, sizeof(callback_name), "write_tsdb/%s/%s",
            cb->node != NULL ? cb->node : WT_DEFAULT_NODE,
            cb->service != NULL ? cb->service : WT_DEFAULT_SERVICE);
@@ -617,6 +1412,11 @@ static int wt_config_tsd(oconfig_item_t *ci) {
   user_data.free_func = NULL;
   plugin_register_flush(callback_name, wt_flush, &user_data);
 
+  if (cb->report_stats)
+    plugin_register_complex_read(/* group = */ NULL, callback_name,
+                                 wt_stats_read, /* interval = */ 0,
+                                 &user_data);
+
   return 0;
 }
 
@@ -0,0 +1,185 @@
+/**
+ * collectd - src/write_tsdb_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * Authors:
+ *   The collectd authors
+ **/
+
+#include "testing.h"
+#include "write_tsdb.c" /* sic */
+
+/* Writes "response" to one end of a socket pair and reads it back from the
+ * other end with wt_http_read_response(). If "close_after" is true, the
+ * server side is closed after the response. */
+static int read_response(char const *response, bool close_after,
+                         wt_connection_t *conn, char *body, size_t body_size) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    return -1;
+
+  conn->sock_fd = fds[0];
+  if (wt_set_timeout(conn->sock_fd, MS_TO_CDTIME_T(100)) != 0)
+    return -1;
+
+  size_t len = strlen(response);
+  if (write(fds[1], response, len) != (ssize_t)len)
+    return -1;
+  if (close_after)
+    close(fds[1]);
+
+  int code = wt_http_read_response(conn, body, body_size);
+
+  if (!close_after)
+    close(fds[1]);
+  return code;
+}
+
+DEF_TEST(content_length) {
+  wt_connection_t conn = {.sock_fd = -1};
+  char body[256];
+
+  EXPECT_EQ_INT(400, read_response("HTTP/1.1 400 Bad Request\r\n"
+                                   "Content-Length: 5\r\n"
+                                   "\r\n"
+                                   "error",
+                                   false, &conn, body, sizeof(body)));
+  EXPECT_EQ_STR("error", body);
+  /* The connection is kept open. */
+  OK(conn.sock_fd >= 0);
+  wt_disconnect(&conn);
+
+  EXPECT_EQ_INT(204, read_response("HTTP/1.1 204 No Content\r\n"
+                                   "\r\n",
+                                   false, &conn, body, sizeof(body)));
+  EXPECT_EQ_STR("", body);
+  OK(conn.sock_fd >= 0);
+  wt_disconnect(&conn);
+
+  /* The body is truncated to the buffer size. */
+  EXPECT_EQ_INT(500, read_response("HTTP/1.1 500 Internal Server Error\r\n"
+                                   "content-length: 10\r\n"
+                                   "\r\n"
+                                   "0123456789",
+                                   false, &conn, body, 5));
+  EXPECT_EQ_STR("0123", body);
+  wt_disconnect(&conn);
+
+  /* Bodies larger than the read buffer are skipped. */
+  char response[3 * WT_HTTP_RESPONSE_SIZE];
+  size_t len = (size_t)snprintf(response, sizeof(response),
+                                "HTTP/1.1 413 Payload Too Large\r\n"
+                                "Transfer-Encoding: chunked\r\n"
+                                "\r\n"
+                                "%x\r\n",
+                                2 * WT_HTTP_RESPONSE_SIZE);
+  memset(response + len, 'x', 2 * WT_HTTP_RESPONSE_SIZE);
+  len += 2 * WT_HTTP_RESPONSE_SIZE;
+  sstrncpy(response + len, "\r\n0\r\n\r\n", sizeof(response) - len);
+  EXPECT_EQ_INT(413, read_response(response, false, &conn, body, 4));
+  EXPECT_EQ_STR("xxx", body);
+  wt_disconnect(&conn);
+
+  return 0;
+}
+
+DEF_TEST(chunked) {
+  wt_connection_t conn = {.sock_fd = -1};
+  char body[256];
+
+  EXPECT_EQ_INT(400, read_response("HTTP/1.1 400 Bad Request\r\n"
+                                   "Transfer-Encoding: chunked\r\n"
+                                   "\r\n"
+                                   "5\r\n"
+                                   "error\r\n"
+                                   "9;ext=1\r\n"
+                                   ": details\r\n"
+                                   "0\r\n"
+                                   "X-Trailer: 1\r\n"
+                                   "\r\n",
+                                   false, &conn, body, sizeof(body)));
+  EXPECT_EQ_STR("error: details", body);
+  OK(conn.sock_fd >= 0);
+  wt_disconnect(&conn);
+
+  EXPECT_EQ_INT(-1, read_response("HTTP/1.1 200 OK\r\n"
+                                  "Transfer-Encoding: chunked\r\n"
+                                  "\r\n"
+                                  "zz\r\n",
+                                  false, &conn, body, sizeof(body)));
+  wt_disconnect(&conn);
+
+  return 0;
+}
+
+DEF_TEST(connection_close) {
+  wt_connection_t conn = {.sock_fd = -1};
+  char body[256];
+
+  /* Without a length, the body extends to the end of the connection. */
+  EXPECT_EQ_INT(200, read_response("HTTP/1.1 200 OK\r\n"
+                                   "Connection: close\r\n"
+                                   "\r\n"
+                                   "body",
+                                   true, &conn, body, sizeof(body)));
+  EXPECT_EQ_STR("body", body);
+  EXPECT_EQ_INT(-1, conn.sock_fd);
+
+  EXPECT_EQ_INT(200, read_response("HTTP/1.0 200 OK\r\n"
+                                   "\r\n"
+                                   "body",
+                                   true, &conn, body, sizeof(body)));
+  EXPECT_EQ_STR("body", body);
+  EXPECT_EQ_INT(-1, conn.sock_fd);
+
+  /* A persistent connection needs a length. */
+  EXPECT_EQ_INT(-1, read_response("HTTP/1.1 200 OK\r\n"
+                                  "\r\n"
+                                  "body",
+                                  false, &conn, body, sizeof(body)));
+  wt_disconnect(&conn);
+
+  return 0;
+}
+
+DEF_TEST(timeout) {
+  wt_connection_t conn = {.sock_fd = -1};
+  char body[256];
+
+  /* The server never completes the response. Without the timeout, reading
+   * the response would block forever. */
+  EXPECT_EQ_INT(-1, read_response("HTTP/1.1 200 OK\r\n"
+                                  "Content-Length: 10\r\n"
+                                  "\r\n"
+                                  "01234",
+                                  false, &conn, body, sizeof(body)));
+  wt_disconnect(&conn);
+
+  EXPECT_EQ_INT(-1, read_response("HTTP/1.1 200 OK\r\n", false, &conn, body,
+                                  sizeof(body)));
+  wt_disconnect(&conn);
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(content_length);
+  RUN_TEST(chunked);
+  RUN_TEST(connection_close);
+  RUN_TEST(timeout);
+
+  END_TEST;
+}